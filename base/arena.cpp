@@ -0,0 +1,62 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include "base/arena.hpp"
+
+#include <algorithm>
+#include <iterator>
+
+#include <cstdint>
+
+namespace base {
+
+Arena::Arena(std::size_t chunkSize) noexcept
+	: chunkSize(std::max<std::size_t>(chunkSize, 64)) {
+}
+
+void *
+Arena::Allocate(std::size_t size, std::size_t alignment) noexcept {
+	if (!chunks.empty()) {
+		auto &chunk = chunks.back();
+		const auto address = reinterpret_cast<std::uintptr_t>(chunk.data.get()) + offset;
+		const auto padding = (alignment - address % alignment) % alignment;
+		if (offset + padding + size <= chunk.size) {
+			offset += padding + size;
+			return chunk.data.get() + offset - size;
+		}
+	}
+
+	// The chunks are allocated with new[], which aligns them for any type.
+	const auto newSize = std::max(chunkSize, size);
+	chunks.push_back({ std::make_unique<char[]>(newSize), newSize });
+	offset = size;
+	return chunks.back().data.get();
+}
+
+std::string_view
+Arena::Copy(std::string_view string) noexcept {
+	auto *copy = static_cast<char *>(Allocate(string.length(), 1));
+	std::copy(std::cbegin(string), std::cend(string), copy);
+	return { copy, string.length() };
+}
+
+void
+Arena::Reset() noexcept {
+	offset = 0;
+	if (chunks.size() <= 1) {
+		return;
+	}
+
+	std::size_t total = 0;
+	for (const auto &chunk : chunks) {
+		total += chunk.size;
+	}
+
+	chunks.clear();
+	chunkSize = std::max(chunkSize, total);
+}
+
+} // namespace base
@@ -0,0 +1,63 @@
+#pragma once
+
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include <cstddef>
+
+namespace base {
+
+// A bump allocator for data with the same lifetime, e.g. that of a request.
+// Allocating is advancing an offset in the current chunk, and everything is
+// freed at once with Reset.
+//
+// When the allocations didn't fit in the first chunk, Reset replaces the
+// chunks with one big enough for all of them, so the arena settles on a
+// single chunk that is reused without allocating.
+class Arena {
+public:
+	explicit Arena(std::size_t chunkSize = 4096) noexcept;
+
+	Arena(const Arena &) = delete;
+	Arena &operator=(const Arena &) = delete;
+
+	// Returns [size] octets aligned to [alignment], which is a power of two
+	// of at most alignof(std::max_align_t). They're valid until Reset.
+	[[nodiscard]] void *
+	Allocate(std::size_t size, std::size_t alignment = alignof(std::max_align_t)) noexcept;
+
+	// Copies [string] into the arena, returning the copy.
+	[[nodiscard]] std::string_view
+	Copy(std::string_view string) noexcept;
+
+	// The amount of chunks that have been allocated since the last reset.
+	[[nodiscard]] inline std::size_t
+	ChunkCount() const noexcept {
+		return chunks.size();
+	}
+
+	// Frees everything allocated from the arena.
+	void
+	Reset() noexcept;
+
+private:
+	struct Chunk {
+		std::unique_ptr<char[]> data;
+		std::size_t size;
+	};
+
+	std::size_t chunkSize;
+	std::vector<Chunk> chunks;
+
+	// The offset in the last chunk.
+	std::size_t offset{ 0 };
+};
+
+} // namespace base
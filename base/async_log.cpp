@@ -0,0 +1,300 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include "base/async_log.hpp"
+
+#include <algorithm>
+#include <array>
+#include <new>
+#include <utility>
+
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+// The maximum amount of buffers of a single writev(2).
+#ifdef IOV_MAX
+#define MAGIC_ASYNC_LOG_MAX_BUFFERS std::min(IOV_MAX, 1024)
+#else
+#define MAGIC_ASYNC_LOG_MAX_BUFFERS 1024
+#endif
+
+namespace base {
+
+struct AsyncLogRing {
+	explicit AsyncLogRing(std::size_t capacity) :
+		data(new char[capacity]), mask(capacity - 1) {
+	}
+
+	std::unique_ptr<char[]> data;
+	const std::size_t mask;
+
+	// The positions only increase, and are masked to index the data. The
+	// head is only stored by the appending thread, and the tail by the
+	// writer, on cache lines of their own.
+	alignas(64) std::atomic<std::size_t> head{ 0 };
+	alignas(64) std::atomic<std::size_t> tail{ 0 };
+
+	// Set when the thread has exited, so the ring can be forgotten once
+	// it's empty.
+	std::atomic<bool> orphaned{ false };
+
+	// Whether the writer has been woken up for this ring, since it was last
+	// drained.
+	std::atomic<bool> wakeRequested{ false };
+};
+
+namespace {
+
+// The rings of the calling thread, by the identifier of their log.
+struct ThreadRings {
+	std::vector<std::pair<std::uint64_t, std::shared_ptr<AsyncLogRing>>> rings;
+
+	~ThreadRings() noexcept {
+		for (const auto &entry : rings) {
+			entry.second->orphaned.store(true, std::memory_order_release);
+		}
+	}
+};
+
+thread_local ThreadRings threadRings;
+
+std::atomic<std::uint64_t> nextIdentifier{ 0 };
+
+[[nodiscard]] std::size_t
+RoundUpToPowerOfTwo(std::size_t value) noexcept {
+	std::size_t result = 1;
+	while (result < value) {
+		result <<= 1;
+	}
+	return result;
+}
+
+} // namespace
+
+AsyncLog::AsyncLog(std::size_t ringCapacity, std::chrono::milliseconds interval) noexcept :
+	ringCapacity(RoundUpToPowerOfTwo(std::max<std::size_t>(ringCapacity, 64))), interval(interval),
+	identifier(nextIdentifier.fetch_add(1, std::memory_order_relaxed)) {
+}
+
+AsyncLog::~AsyncLog() noexcept {
+	Stop();
+}
+
+bool
+AsyncLog::Start(const std::string &path) noexcept {
+	const int file = open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0640);
+	if (file == -1) {
+		return false;
+	}
+
+	if (!Start(file)) {
+		close(file);
+		return false;
+	}
+
+	ownsFD = true;
+	return true;
+}
+
+bool
+AsyncLog::Start(int file) noexcept {
+	std::lock_guard lock(wakeMutex);
+	if (running) {
+		return false;
+	}
+
+	fd = file;
+	running = true;
+	try {
+		writer = std::thread(&AsyncLog::Run, this);
+	} catch (...) {
+		running = false;
+		return false;
+	}
+
+	return true;
+}
+
+void
+AsyncLog::Stop() noexcept {
+	{
+		std::lock_guard lock(wakeMutex);
+		if (!running) {
+			return;
+		}
+		running = false;
+	}
+
+	wake.notify_one();
+	writer.join();
+
+	if (ownsFD) {
+		close(fd);
+		ownsFD = false;
+	}
+	fd = -1;
+}
+
+AsyncLogRing *
+AsyncLog::ThreadRing() noexcept {
+	for (const auto &entry : threadRings.rings) {
+		if (entry.first == identifier) {
+			return entry.second.get();
+		}
+	}
+
+	try {
+		auto ring = std::make_shared<AsyncLogRing>(ringCapacity);
+		threadRings.rings.emplace_back(identifier, ring);
+
+		std::lock_guard lock(ringsMutex);
+		rings.push_back(std::move(ring));
+		return rings.back().get();
+	} catch (const std::bad_alloc &) {
+		return nullptr;
+	}
+}
+
+bool
+AsyncLog::Append(std::string_view record) noexcept {
+	auto *ring = ThreadRing();
+	if (ring == nullptr) {
+		dropped.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	const auto capacity = ring->mask + 1;
+	const auto head = ring->head.load(std::memory_order_relaxed);
+	const auto used = head - ring->tail.load(std::memory_order_acquire);
+	if (record.length() > capacity - used) {
+		dropped.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	const auto offset = head & ring->mask;
+	const auto first = std::min(record.length(), capacity - offset);
+	std::memcpy(ring->data.get() + offset, record.data(), first);
+	std::memcpy(ring->data.get(), record.data() + first, record.length() - first);
+	ring->head.store(head + record.length(), std::memory_order_release);
+
+	// The writer wakes up by itself every interval, unless the ring fills
+	// up before that.
+	if (used + record.length() > capacity / 2 && !ring->wakeRequested.exchange(true, std::memory_order_relaxed)) {
+		{
+			std::lock_guard lock(wakeMutex);
+			wakeRequested = true;
+		}
+		wake.notify_one();
+	}
+
+	return true;
+}
+
+void
+AsyncLog::Drain() noexcept {
+	struct Batch {
+		AsyncLogRing *ring;
+		std::size_t length;
+	};
+
+	std::vector<std::shared_ptr<AsyncLogRing>> snapshot;
+	{
+		std::lock_guard lock(ringsMutex);
+		snapshot = rings;
+	}
+
+	std::array<struct iovec, MAGIC_ASYNC_LOG_MAX_BUFFERS> buffers;
+	std::vector<Batch> batches;
+	batches.reserve(snapshot.size());
+
+	auto ring = std::cbegin(snapshot);
+	while (ring != std::cend(snapshot)) {
+		std::size_t count = 0;
+		std::size_t total = 0;
+		batches.clear();
+
+		// Each ring takes one or two buffers, depending on whether its data
+		// wraps around.
+		for (; ring != std::cend(snapshot) && count + 2 <= buffers.size(); ++ring) {
+			auto &current = **ring;
+			current.wakeRequested.store(false, std::memory_order_relaxed);
+
+			const auto tail = current.tail.load(std::memory_order_relaxed);
+			const auto length = current.head.load(std::memory_order_acquire) - tail;
+			if (length == 0) {
+				continue;
+			}
+
+			const auto capacity = current.mask + 1;
+			const auto offset = tail & current.mask;
+			const auto first = std::min(length, capacity - offset);
+			buffers[count++] = { current.data.get() + offset, first };
+			if (first != length) {
+				buffers[count++] = { current.data.get(), length - first };
+			}
+
+			batches.push_back({ &current, length });
+			total += length;
+		}
+
+		// A partial write continues where it left off, and a failed write
+		// drops the batch, so a broken file doesn't stall the appenders.
+		std::size_t written = 0;
+		std::size_t index = 0;
+		while (written < total && index < count) {
+			const auto result = writev(fd, buffers.data() + index, static_cast<int>(count - index));
+			if (result < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+				dropped.fetch_add(1, std::memory_order_relaxed);
+				break;
+			}
+
+			auto remaining = static_cast<std::size_t>(result);
+			written += remaining;
+			while (index < count && remaining >= buffers[index].iov_len) {
+				remaining -= buffers[index++].iov_len;
+			}
+			if (remaining != 0) {
+				buffers[index].iov_base = static_cast<char *>(buffers[index].iov_base) + remaining;
+				buffers[index].iov_len -= remaining;
+			}
+		}
+
+		for (const auto &batch : batches) {
+			batch.ring->tail.fetch_add(batch.length, std::memory_order_release);
+		}
+	}
+
+	std::lock_guard lock(ringsMutex);
+	rings.erase(std::remove_if(std::begin(rings), std::end(rings), [](const auto &current) {
+		return current->orphaned.load(std::memory_order_acquire) &&
+			   current->head.load(std::memory_order_acquire) == current->tail.load(std::memory_order_relaxed);
+	}), std::end(rings));
+}
+
+void
+AsyncLog::Run() noexcept {
+	std::unique_lock lock(wakeMutex);
+	while (running) {
+		wake.wait_for(lock, interval, [this] { return !running || wakeRequested; });
+		wakeRequested = false;
+
+		lock.unlock();
+		Drain();
+		lock.lock();
+	}
+
+	lock.unlock();
+	Drain();
+}
+
+} // namespace base
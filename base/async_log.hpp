@@ -0,0 +1,113 @@
+#pragma once
+
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace base {
+
+// The ring buffer of a thread appending to an AsyncLog, see async_log.cpp.
+struct AsyncLogRing;
+
+// A log written by a thread of its own, e.g. the access log. Every thread that
+// appends records has a ring buffer of its own, with that thread as the only
+// producer and the writer as the only consumer, so appending neither locks nor
+// makes a system call. The writer drains the rings periodically, or when one
+// is half full, and writes the records of all rings with a single writev(2).
+//
+// When the ring of a thread is full, the record is dropped instead of blocking
+// the thread, see Dropped.
+class AsyncLog {
+public:
+	// [ringCapacity] is the amount of octets of the ring of every thread,
+	// rounded up to a power of two. The rings are drained every [interval].
+	explicit AsyncLog(std::size_t ringCapacity = 256 * 1024,
+					  std::chrono::milliseconds interval = std::chrono::milliseconds(100)) noexcept;
+
+	// Stops the log, see Stop.
+	~AsyncLog() noexcept;
+
+	AsyncLog(const AsyncLog &) = delete;
+	AsyncLog &operator=(const AsyncLog &) = delete;
+
+	// Opens [path] for appending, creating it if needed, and starts the
+	// writer.
+	//
+	// Returns success status
+	[[nodiscard]] bool
+	Start(const std::string &path) noexcept;
+
+	// Starts the writer on [fd], which isn't closed by the log.
+	//
+	// Returns success status
+	[[nodiscard]] bool
+	Start(int fd) noexcept;
+
+	// Writes the records that have been appended and joins the writer.
+	void
+	Stop() noexcept;
+
+	// Appends [record], which should end with a line feed. Returns false if
+	// the record was dropped.
+	bool
+	Append(std::string_view record) noexcept;
+
+	// The amount of records that have been dropped.
+	[[nodiscard]] inline std::size_t
+	Dropped() const noexcept {
+		return dropped.load(std::memory_order_relaxed);
+	}
+
+private:
+	const std::size_t ringCapacity;
+	const std::chrono::milliseconds interval;
+
+	// Distinguishes the log from the ones before it at the same address, in
+	// the list of rings of a thread.
+	const std::uint64_t identifier;
+
+	std::mutex ringsMutex;
+	std::vector<std::shared_ptr<AsyncLogRing>> rings;
+
+	std::mutex wakeMutex;
+	std::condition_variable wake;
+	bool running{ false };
+	bool wakeRequested{ false };
+
+	std::thread writer;
+	int fd{ -1 };
+	bool ownsFD{ false };
+
+	std::atomic<std::size_t> dropped{ 0 };
+
+	// Returns the ring of the calling thread, or nullptr if it couldn't be
+	// created.
+	[[nodiscard]] AsyncLogRing *
+	ThreadRing() noexcept;
+
+	// Writes the records of all rings, and forgets the rings of the threads
+	// that have exited once they're empty.
+	void
+	Drain() noexcept;
+
+	// The function of the writer.
+	void
+	Run() noexcept;
+};
+
+} // namespace base
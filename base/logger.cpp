@@ -6,11 +6,39 @@
 
 #include "logger.hpp"
 
+#include <string>
+
+#include <cerrno>
+#include <unistd.h>
+
 namespace LoggerInternals {
 
 	void
-	Perform(const LogLevel &level, const std::string &source, const std::string &message) {
-		std::cout << level.terminalPrefix << source << level.terminalInfix << message << "\x1b[0m\n";
+	Perform(const LogLevel &level, std::string_view source, std::string_view message) noexcept {
+		thread_local std::string line;
+
+		try {
+			line.clear();
+			line.append(level.terminalPrefix);
+			line.append(source);
+			line.append(level.terminalInfix);
+			line.append(message);
+			line.append("\x1b[0m\n");
+		} catch (...) {
+			return;
+		}
+
+		std::string_view rest(line);
+		while (!rest.empty()) {
+			const auto result = write(STDOUT_FILENO, rest.data(), rest.length());
+			if (result < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+				return;
+			}
+			rest.remove_prefix(static_cast<std::size_t>(result));
+		}
 	}
 
 } // namespace LoggerInternals
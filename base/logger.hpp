@@ -6,59 +6,78 @@
  * See the COPYING file for licensing information.
  */
 
-#include <iostream>
-#include <string>
+#include <string_view>
+
+// The least severe level of the messages that are logged, i.e. 0 (debug)
+// through 5 (severe). The calls for less severe messages compile to nothing.
+#ifndef WEBSERVER_LOG_LEVEL
+#define WEBSERVER_LOG_LEVEL 1
+#endif
 
 namespace LoggerInternals {
 
 	struct LogLevel {
+		int severity;
 		std::string_view name;
 		std::string_view terminalPrefix;
 		std::string_view terminalInfix;
 	};
 
-	const static LogLevel debug{ "debug", "[\x1b[34mDebug\x1b[0m] [\x1b[34m", "\x1b[0m] \x1b[35m" };
-	const static LogLevel error{ "error", "[\x1b[34mError\x1b[0m] [\x1b[34m", "\x1b[0m] \x1b[31m" };
-	const static LogLevel info{ "info", "[\x1b[34mInfo\x1b[0m] [\x1b[34m", "\x1b[0m] \x1b[32m" };
-	const static LogLevel log{ "log", "[\x1b[34mLog\x1b[0m] [\x1b[34m", "\x1b[0m] \x1b[37m" };
-	const static LogLevel severe{ "severe", "[\x1b[34mSevere\x1b[0m] [\x1b[34m", "\x1b[0m] \x1b[31m" };
-	const static LogLevel warning{ "warning", "[\x1b[34mWarning\x1b[0m] [\x1b[34m", "\x1b[0m] \x1b[33m" };
+	constexpr LogLevel debug{ 0, "debug", "[\x1b[34mDebug\x1b[0m] [\x1b[34m", "\x1b[0m] \x1b[35m" };
+	constexpr LogLevel info{ 1, "info", "[\x1b[34mInfo\x1b[0m] [\x1b[34m", "\x1b[0m] \x1b[32m" };
+	constexpr LogLevel log{ 2, "log", "[\x1b[34mLog\x1b[0m] [\x1b[34m", "\x1b[0m] \x1b[37m" };
+	constexpr LogLevel warning{ 3, "warning", "[\x1b[34mWarning\x1b[0m] [\x1b[34m", "\x1b[0m] \x1b[33m" };
+	constexpr LogLevel error{ 4, "error", "[\x1b[34mError\x1b[0m] [\x1b[34m", "\x1b[0m] \x1b[31m" };
+	constexpr LogLevel severe{ 5, "severe", "[\x1b[34mSevere\x1b[0m] [\x1b[34m", "\x1b[0m] \x1b[31m" };
 
+	// Writes the message with a single write(2) to the standard output, so
+	// the messages of threads don't interleave, without a lock.
 	void
-	Perform(const LogLevel &, const std::string &, const std::string &);
+	Perform(const LogLevel &, std::string_view source, std::string_view message) noexcept;
+
+	template <const LogLevel &level>
+	inline void
+	PerformIfEnabled(std::string_view source, std::string_view message) noexcept {
+		if constexpr (level.severity >= WEBSERVER_LOG_LEVEL) {
+			Perform(level, source, message);
+		} else {
+			static_cast<void>(source);
+			static_cast<void>(message);
+		}
+	}
 
 } // namespace LoggerInternals
 
 namespace Logger {
 
 inline void
-Debug(const std::string &source, const std::string &message) {
-	LoggerInternals::Perform(LoggerInternals::debug, source, message);
+Debug(std::string_view source, std::string_view message) noexcept {
+	LoggerInternals::PerformIfEnabled<LoggerInternals::debug>(source, message);
 }
 
 inline void
-Error(const std::string &source, const std::string &message) {
-	LoggerInternals::Perform(LoggerInternals::error, source, message);
+Error(std::string_view source, std::string_view message) noexcept {
+	LoggerInternals::PerformIfEnabled<LoggerInternals::error>(source, message);
 }
 
 inline void
-Info(const std::string &source, const std::string &message) {
-	LoggerInternals::Perform(LoggerInternals::info, source, message);
+Info(std::string_view source, std::string_view message) noexcept {
+	LoggerInternals::PerformIfEnabled<LoggerInternals::info>(source, message);
 }
 
 inline void
-Log(const std::string &source, const std::string &message) {
-	LoggerInternals::Perform(LoggerInternals::log, source, message);
+Log(std::string_view source, std::string_view message) noexcept {
+	LoggerInternals::PerformIfEnabled<LoggerInternals::log>(source, message);
 }
 
 inline void
-Severe(const std::string &source, const std::string &message) {
-	LoggerInternals::Perform(LoggerInternals::severe, source, message);
+Severe(std::string_view source, std::string_view message) noexcept {
+	LoggerInternals::PerformIfEnabled<LoggerInternals::severe>(source, message);
 }
 
 inline void
-Warning(const std::string &source, const std::string &message) {
-	LoggerInternals::Perform(LoggerInternals::warning, source, message);
+Warning(std::string_view source, std::string_view message) noexcept {
+	LoggerInternals::PerformIfEnabled<LoggerInternals::warning>(source, message);
 }
 
 } // namespace Logger
@@ -8,82 +8,129 @@
 
 #include "media_type.hpp"
 
-#include <iterator>
-#include <sstream>
-#include <utility>
+#include <array>
+
+#include <cstdint>
 
-#include "base/logger.hpp"
 #include "io/file.hpp"
 
-static MediaType genericType = { "application", "octet-stream" };
-
-namespace MediaTypes {
-	// NOTE When adding members to this namespace, make sure to register it in
-	// MediaTypeFinder::MediaTypeFinder (call MediaType::SetCompleteType()).
-
-	MediaType HTML { "text", "html" };
-	MediaType TEXT { "text", "plain" };
-
-} // namespace MediaTypes
-
-MediaTypeFinder::MediaTypeFinder()
-	: mediaTypes({
-		// NOTE This list must be kept minimal. There is no need to have every
-		//      extension in this list. Providing rarely used and obsolete
-		//      media types only causes overhead, because media type lookup
-		//      should be snappy.
-		// NOTE If you need to have an extension in this list, you can add it, but
-		//      keep the advice above in mind.
-		{ "css",   { "text", "css" } },                     // RFC 2318
-		{ "html",  { "text", "html" } },                    // https://html.spec.whatwg.org/#text/html
-		// Microsoft uses image/x-icon, which isn't approved by IANA. Most web
-		// servers use the correct media type (as seen below), except nginx.
-		{ "ico",   { "image", "vnd.microsoft.icon" } },     // https://www.iana.org/assignments/media-types/image/vnd.microsoft.icon
-		{ "js",    { "application", "javascript", true } }, // RFC 4329
-		{ "json",  { "application", "json" } },               // RFC 8259
-		{ "jpg",   { "image", "jpeg" } },                   // RFC 2046
-		{ "otf",   { "font", "otf" } },                     // RFC 8081
-		{ "png",   { "image", "png" } },                    // RFC 2083
-		{ "svg",   { "image", "svg+xml" } },                // https://www.w3.org/TR/SVG/mimereg.html
-		{ "ttf",   { "font", "ttf" } },                     // RFC 8081
-		{ "txt",   { "text", "plain" } },                   // RFC 2046, 3676 & 5147
-		{ "woff",  { "font", "woff" } },                    // RFC 8081
-		{ "woff2", { "font", "woff" } },                    // RFC 8081
-		// The debate of application/xml vs text/xml. As every UA knows about
-		// both of them, it isn't really necessary. Every server has their own
-		// opinion about it, so there isn't really a standard to follow. RFC
-		// 7303 doesn't specify a better one — as opposed to JSON — only that
-		// text/xml is for user-readable XML, and application/xml is for non-
-		// user-readable XML.
-		{ "xml",  { "application", "xml" } },               // RFC 7303
-		{ "zip",  { "application", "zip" } },               // https://www.iana.org/assignments/media-types/application/zip
-	}) {
-	genericType.SetCompleteType();
-	for (auto &pair : mediaTypes) {
-		pair.second.SetCompleteType();
+namespace {
+
+constexpr MediaType genericType{ "application/octet-stream" };
+
+struct Extension {
+	std::string_view name;
+	MediaType mediaType;
+};
+
+// NOTE This list must be kept minimal. There is no need to have every
+//      extension in this list. Providing rarely used and obsolete
+//      media types only causes overhead, because media type lookup
+//      should be snappy.
+// NOTE If you need to have an extension in this list, you can add it, but
+//      keep the advice above in mind.
+constexpr std::array<Extension, 15> extensions{{
+	{ "css",   MediaType("text/css;charset=utf-8") },                 // RFC 2318
+	{ "html",  MediaType("text/html;charset=utf-8") },                // https://html.spec.whatwg.org/#text/html
+	// Microsoft uses image/x-icon, which isn't approved by IANA. Most web
+	// servers use the correct media type (as seen below), except nginx.
+	{ "ico",   MediaType("image/vnd.microsoft.icon") },               // https://www.iana.org/assignments/media-types/image/vnd.microsoft.icon
+	{ "js",    MediaType("application/javascript;charset=utf-8") },   // RFC 4329
+	{ "json",  MediaType("application/json") },                       // RFC 8259
+	{ "jpg",   MediaType("image/jpeg") },                             // RFC 2046
+	{ "otf",   MediaType("font/otf") },                               // RFC 8081
+	{ "png",   MediaType("image/png") },                              // RFC 2083
+	{ "svg",   MediaType("image/svg+xml") },                          // https://www.w3.org/TR/SVG/mimereg.html
+	{ "ttf",   MediaType("font/ttf") },                               // RFC 8081
+	{ "txt",   MediaType("text/plain;charset=utf-8") },               // RFC 2046, 3676 & 5147
+	{ "woff",  MediaType("font/woff") },                              // RFC 8081
+	{ "woff2", MediaType("font/woff") },                              // RFC 8081
+	// The debate of application/xml vs text/xml. As every UA knows about
+	// both of them, it isn't really necessary. Every server has their own
+	// opinion about it, so there isn't really a standard to follow. RFC
+	// 7303 doesn't specify a better one — as opposed to JSON — only that
+	// text/xml is for user-readable XML, and application/xml is for non-
+	// user-readable XML.
+	{ "xml",   MediaType("application/xml") },                        // RFC 7303
+	{ "zip",   MediaType("application/zip") },                        // https://www.iana.org/assignments/media-types/application/zip
+}};
+
+// The extensions are found with a perfect hash: the seed below is searched at
+// compile time, such that every extension has a slot of its own.
+constexpr std::size_t tableSize = 64;
+constexpr std::uint8_t emptySlot = 0xFF;
+
+static_assert(extensions.size() < emptySlot);
+
+// FNV-1a, with the seed mixed into the offset basis.
+[[nodiscard]] constexpr std::size_t
+HashExtension(std::string_view extension, std::uint32_t seed) noexcept {
+	std::uint32_t hash = 2166136261U ^ seed;
+	for (char character : extension) {
+		hash ^= static_cast<unsigned char>(character);
+		hash *= 16777619U;
 	}
-	MediaTypes::HTML.SetCompleteType();
-	MediaTypes::TEXT.SetCompleteType();
+	return hash % tableSize;
 }
 
-const MediaType &
-MediaTypeFinder::DetectMediaType(
-	const std::unique_ptr<IO::File> &file) const noexcept {
-	std::string string(file->Path());
-
-	do {
-		auto dot = string.find_first_of('.');
-		if (dot == std::string::npos) {
-			std::stringstream info;
-			info << "Unrecognized extension: \"" << file->Path() << '"';
-			Logger::Debug("MediaTypeFinder", info.str());
-			return genericType;
+[[nodiscard]] constexpr bool
+IsPerfectSeed(std::uint32_t seed) noexcept {
+	std::array<bool, tableSize> used{};
+	for (const auto &extension : extensions) {
+		auto &slot = used[HashExtension(extension.name, seed)];
+		if (slot) {
+			return false;
 		}
-		string = string.substr(dot + 1);
+		slot = true;
+	}
+	return true;
+}
 
-		auto result = mediaTypes.find(string);
-		if (result != std::end(mediaTypes)) {
-			return result->second;
-		}
-	} while (true);
+[[nodiscard]] constexpr std::uint32_t
+FindPerfectSeed() noexcept {
+	std::uint32_t seed = 0;
+	while (!IsPerfectSeed(seed)) {
+		seed++;
+	}
+	return seed;
+}
+
+constexpr std::uint32_t seed = FindPerfectSeed();
+
+// The index into 'extensions' per slot.
+constexpr auto slots = [] {
+	std::array<std::uint8_t, tableSize> result{};
+	for (auto &slot : result) {
+		slot = emptySlot;
+	}
+	for (std::size_t i = 0; i < extensions.size(); i++) {
+		result[HashExtension(extensions[i].name, seed)] = static_cast<std::uint8_t>(i);
+	}
+	return result;
+}();
+
+} // namespace
+
+const MediaType &
+MediaTypeFinder::DetectMediaType(const std::unique_ptr<IO::File> &file) const noexcept {
+	return DetectMediaType(file->Path());
+}
+
+const MediaType &
+MediaTypeFinder::DetectMediaType(std::string_view path) const noexcept {
+	const auto dot = path.rfind('.');
+	const auto slash = path.rfind('/');
+
+	// Dots in the names of directories don't start an extension.
+	if (dot == std::string_view::npos || (slash != std::string_view::npos && dot < slash)) {
+		return genericType;
+	}
+
+	const auto extension = path.substr(dot + 1);
+	const auto slot = slots[HashExtension(extension, seed)];
+	if (slot == emptySlot || extensions[slot].name != extension) {
+		return genericType;
+	}
+
+	return extensions[slot].mediaType;
 }
@@ -6,79 +6,100 @@
  * See the COPYING file for licensing information.
  */
 
-#include <map>
+#include <algorithm>
 #include <memory>
-#include <optional>
-#include <string>
+#include <string_view>
 
-#include <cstring>
+#include <cstddef>
 
 // From io/file.hpp:
 namespace IO { class File; }
 
+// A media type, as sent in the Content-Type header field. The instances are
+// constant expressions, so that detection doesn't allocate.
+//
+// Spec: RFC 7231 § 3.1.1.1
 struct MediaType {
-	friend class MediaTypeFinder;
-
-	inline MediaType(const char *type, const char *subtype, bool includeCharset) noexcept
-		 : completeType(std::nullopt), type(type), subtype(subtype),
-		   includeCharset(includeCharset) {
+	// [contentType] is the value of the Content-Type header field, e.g.
+	// "text/html;charset=utf-8" or "image/png", which should outlive the
+	// media type, i.e. a string literal.
+	inline constexpr explicit
+	MediaType(std::string_view contentType) noexcept :
+		contentType(contentType),
+		parametersStart(std::min(contentType.find(';'), contentType.length())),
+		slash(contentType.find('/')) {
 	}
 
-	inline MediaType(const char *type, const char *subtype) noexcept
-		 : MediaType(type, subtype, strcmp(type, "text") == 0) {
+	// The type and subtype, without parameters.
+	[[nodiscard]] inline constexpr std::string_view
+	Complete() const noexcept {
+		return contentType.substr(0, parametersStart);
 	}
 
-	[[nodiscard]] const std::string &
-	Complete() const {
-		return completeType.value();
+	// The value of the Content-Type header field, i.e. the complete type
+	// followed by the charset parameter, if there is one.
+	[[nodiscard]] inline constexpr std::string_view
+	ContentType() const noexcept {
+		return contentType;
 	}
 
-	[[nodiscard]] bool
+	[[nodiscard]] inline constexpr bool
 	IncludeCharset() const noexcept {
-		return includeCharset;
+		return parametersStart != contentType.length();
 	}
 
-	[[nodiscard]] const std::string_view &
-	Subtype() const noexcept {
-		return subtype;
+	// Whether the representations of this type are worth compressing, i.e.
+	// they are textual, and not yet compressed like images or archives.
+	[[nodiscard]] constexpr bool
+	IsCompressible() const noexcept {
+		const auto type = Type();
+		if (type == "text") {
+			return true;
+		}
+
+		if (type != "application" && type != "image") {
+			return false;
+		}
+
+		const auto subtype = Subtype();
+		const auto endsWith = [subtype](std::string_view suffix) {
+			return subtype.length() >= suffix.length() &&
+				   subtype.compare(subtype.length() - suffix.length(), suffix.length(), suffix) == 0;
+		};
+
+		return subtype == "javascript" || subtype == "json" || subtype == "xml" || subtype == "wasm" ||
+			   endsWith("+xml") || endsWith("+json");
 	}
 
-	[[nodiscard]] const std::string_view &
-	Type() const noexcept {
-		return type;
+	[[nodiscard]] inline constexpr std::string_view
+	Subtype() const noexcept {
+		return contentType.substr(slash + 1, parametersStart - slash - 1);
 	}
 
-protected:
-	// Exception-safe completeType generation.
-	void
-	SetCompleteType() {
-		std::string s;
-		s.reserve(type.length() + 1 + subtype.length());
-		s += type;
-		s += '/';
-		s += subtype;
-		completeType = std::move(s);
+	[[nodiscard]] inline constexpr std::string_view
+	Type() const noexcept {
+		return contentType.substr(0, slash);
 	}
 
 private:
-	std::optional<std::string> completeType;
-	const std::string_view type;
-	const std::string_view subtype;
-	const bool includeCharset;
+	std::string_view contentType;
+	std::size_t parametersStart;
+	std::size_t slash;
 };
 
 namespace MediaTypes {
-	extern MediaType HTML;
-	extern MediaType TEXT;
+	inline constexpr MediaType HTML{ "text/html;charset=utf-8" };
+	inline constexpr MediaType TEXT{ "text/plain;charset=utf-8" };
 } // namespace MediaTypes
 
 class MediaTypeFinder {
 public:
-	MediaTypeFinder();
-
 	[[nodiscard]] const MediaType &
 	DetectMediaType(const std::unique_ptr<IO::File> &) const noexcept;
 
-private:
-	std::map<std::string, MediaType> mediaTypes;
+	// Detects the media type of [path] by the extension of its last segment,
+	// i.e. after the last dot. Returns application/octet-stream for unknown
+	// extensions.
+	[[nodiscard]] const MediaType &
+	DetectMediaType(std::string_view path) const noexcept;
 };
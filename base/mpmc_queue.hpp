@@ -0,0 +1,128 @@
+#pragma once
+
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include <atomic>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+#include <cstddef>
+
+namespace base {
+
+// A bounded queue of many producers and many consumers, which doesn't lock.
+// Every slot has a sequence number telling whether it is free for the
+// producer or filled for the consumer of the current lap, so producers and
+// consumers only contend on the position they claim.
+//
+// The capacity is rounded up to a power of two. See Dmitry Vyukov's bounded
+// MPMC queue.
+template <typename T>
+class MPMCQueue {
+public:
+	explicit MPMCQueue(std::size_t capacity)
+		: mask(RoundUp(capacity) - 1), slots(std::make_unique<Slot[]>(mask + 1)) {
+		for (std::size_t i = 0; i <= mask; i++) {
+			slots[i].sequence.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	MPMCQueue(const MPMCQueue &) = delete;
+	MPMCQueue &operator=(const MPMCQueue &) = delete;
+
+	[[nodiscard]] inline std::size_t
+	Capacity() const noexcept {
+		return mask + 1;
+	}
+
+	// The amount of values in the queue, which might be outdated by the time
+	// it is returned.
+	[[nodiscard]] inline std::size_t
+	ApproximateSize() const noexcept {
+		const auto tail = dequeuePosition.load(std::memory_order_relaxed);
+		const auto head = enqueuePosition.load(std::memory_order_relaxed);
+		return head > tail ? head - tail : 0;
+	}
+
+	// Moves [value] into the queue. Returns false if the queue is full, in
+	// which case [value] is left untouched.
+	[[nodiscard]] bool
+	TryPush(T &value) noexcept(std::is_nothrow_move_constructible_v<T>) {
+		auto position = enqueuePosition.load(std::memory_order_relaxed);
+		while (true) {
+			auto &slot = slots[position & mask];
+			const auto sequence = slot.sequence.load(std::memory_order_acquire);
+			const auto difference = static_cast<std::ptrdiff_t>(sequence - position);
+
+			if (difference == 0) {
+				if (enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+					slot.value.emplace(std::move(value));
+					slot.sequence.store(position + 1, std::memory_order_release);
+					return true;
+				}
+			} else if (difference < 0) {
+				// The slot of the previous lap hasn't been consumed.
+				return false;
+			} else {
+				position = enqueuePosition.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	// Moves the oldest value into [value]. Returns false if the queue is
+	// empty.
+	[[nodiscard]] bool
+	TryPop(T &value) noexcept(std::is_nothrow_move_assignable_v<T>) {
+		auto position = dequeuePosition.load(std::memory_order_relaxed);
+		while (true) {
+			auto &slot = slots[position & mask];
+			const auto sequence = slot.sequence.load(std::memory_order_acquire);
+			const auto difference = static_cast<std::ptrdiff_t>(sequence - (position + 1));
+
+			if (difference == 0) {
+				if (dequeuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+					value = std::move(*slot.value);
+					slot.value.reset();
+					slot.sequence.store(position + mask + 1, std::memory_order_release);
+					return true;
+				}
+			} else if (difference < 0) {
+				return false;
+			} else {
+				position = dequeuePosition.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+private:
+	// The size of a cache line, so the positions don't share one.
+	static constexpr std::size_t alignment = 64;
+
+	struct Slot {
+		std::atomic<std::size_t> sequence;
+		std::optional<T> value;
+	};
+
+	[[nodiscard]] static constexpr std::size_t
+	RoundUp(std::size_t capacity) noexcept {
+		std::size_t result = 2;
+		while (result < capacity) {
+			result <<= 1;
+		}
+		return result;
+	}
+
+	const std::size_t mask;
+	const std::unique_ptr<Slot[]> slots;
+
+	alignas(alignment) std::atomic<std::size_t> enqueuePosition{ 0 };
+	alignas(alignment) std::atomic<std::size_t> dequeuePosition{ 0 };
+};
+
+} // namespace base
@@ -0,0 +1,208 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include "base/numa.hpp"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include <fcntl.h>
+#include <pthread.h>
+
+#if defined(__linux__)
+#include <sched.h>
+#elif defined(__FreeBSD__)
+#include <pthread_np.h>
+#include <sys/cpuset.h>
+#endif
+
+#include "posix/unistd.hpp"
+
+// The nodes in the topology of Linux.
+#define MAGIC_NUMA_NODE_DIRECTORY "/sys/devices/system/node/"
+
+namespace base {
+
+namespace {
+
+thread_local std::size_t currentNode{ 0 };
+
+#if defined(__linux__)
+// Reads the small file at [path], e.g. a file in sysfs, into [contents].
+[[nodiscard]] bool
+ReadSmallFile(const std::string &path, std::string &contents) noexcept {
+	const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd == -1) {
+		return false;
+	}
+
+	std::array<char, 4096> buffer;
+	contents.clear();
+	while (true) {
+		const auto result = psx::read(fd, buffer.data(), buffer.size());
+		if (result < 0) {
+			psx::close(fd);
+			return false;
+		}
+		if (result == 0) {
+			break;
+		}
+		contents.append(buffer.data(), static_cast<std::size_t>(result));
+	}
+
+	psx::close(fd);
+	return true;
+}
+#endif
+
+} // namespace
+
+std::size_t
+CurrentNumaNode() noexcept {
+	return currentNode;
+}
+
+NumaTopology
+NumaTopology::Detect() noexcept {
+	NumaTopology topology;
+	std::vector<int> allowed;
+
+#if defined(__linux__)
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+		for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+			if (CPU_ISSET(cpu, &set)) {
+				allowed.push_back(cpu);
+			}
+		}
+	}
+
+	std::string contents;
+	std::vector<int> nodeIDs;
+	if (ReadSmallFile(MAGIC_NUMA_NODE_DIRECTORY "online", contents) && ParseCPUList(contents, nodeIDs)) {
+		for (const int id : nodeIDs) {
+			std::vector<int> cpus;
+			if (!ReadSmallFile(MAGIC_NUMA_NODE_DIRECTORY "node" + std::to_string(id) + "/cpulist", contents) ||
+				!ParseCPUList(contents, cpus)) {
+				continue;
+			}
+
+			if (!allowed.empty()) {
+				cpus.erase(std::remove_if(std::begin(cpus), std::end(cpus), [&allowed](int cpu) {
+					return !std::binary_search(std::cbegin(allowed), std::cend(allowed), cpu);
+				}), std::end(cpus));
+			}
+
+			// Nodes of memory only have nothing to run on.
+			if (!cpus.empty()) {
+				std::sort(std::begin(cpus), std::end(cpus));
+				topology.nodes.push_back(std::move(cpus));
+			}
+		}
+	}
+#endif
+
+	if (topology.nodes.empty()) {
+		if (allowed.empty()) {
+			const int count = static_cast<int>(std::max(std::thread::hardware_concurrency(), 1U));
+			for (int cpu = 0; cpu < count; cpu++) {
+				allowed.push_back(cpu);
+			}
+		}
+		topology.nodes.push_back(std::move(allowed));
+	}
+
+	return topology;
+}
+
+bool
+ParseCPUList(std::string_view list, std::vector<int> &cpus) noexcept {
+	while (!list.empty() && (list.back() == '\n' || list.back() == ' ')) {
+		list.remove_suffix(1);
+	}
+
+	const char *position = list.data();
+	const char *end = list.data() + list.length();
+	while (position != end) {
+		int first;
+		auto result = std::from_chars(position, end, first);
+		if (result.ec != std::errc{} || first < 0) {
+			return false;
+		}
+
+		int last = first;
+		if (result.ptr != end && *result.ptr == '-') {
+			result = std::from_chars(result.ptr + 1, end, last);
+			if (result.ec != std::errc{} || last < first) {
+				return false;
+			}
+		}
+
+		for (int cpu = first; cpu <= last; cpu++) {
+			cpus.push_back(cpu);
+		}
+
+		position = result.ptr;
+		if (position != end) {
+			if (*position != ',' || position + 1 == end) {
+				return false;
+			}
+			position++;
+		}
+	}
+
+	return true;
+}
+
+bool
+PinThread(const std::vector<int> &cpus) noexcept {
+#if defined(__linux__) || defined(__FreeBSD__)
+#ifdef __FreeBSD__
+	cpuset_t set;
+#else
+	cpu_set_t set;
+#endif
+	CPU_ZERO(&set);
+	for (const int cpu : cpus) {
+		if (cpu >= 0 && cpu < CPU_SETSIZE) {
+			CPU_SET(cpu, &set);
+		}
+	}
+
+	return !cpus.empty() && pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+	static_cast<void>(cpus);
+	return false;
+#endif
+}
+
+std::vector<NumaTopology::Placement>
+NumaTopology::Place(std::size_t count) const noexcept {
+	std::vector<Placement> placements;
+	if (nodes.empty()) {
+		return placements;
+	}
+
+	placements.reserve(count);
+	for (std::size_t i = 0; i < count; i++) {
+		const auto node = i % nodes.size();
+		const auto &cpus = nodes[node];
+		placements.push_back({ node, cpus[(i / nodes.size()) % cpus.size()] });
+	}
+	return placements;
+}
+
+void
+SetCurrentNumaNode(std::size_t node) noexcept {
+	currentNode = node;
+}
+
+} // namespace base
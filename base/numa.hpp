@@ -0,0 +1,63 @@
+#pragma once
+
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include <string_view>
+#include <vector>
+
+#include <cstddef>
+
+namespace base {
+
+// The NUMA nodes of the machine, restricted to the CPUs the process may run
+// on. Memory is placed on the node of the thread that first touches it, so a
+// thread that stays on the CPUs of a node allocates and uses memory local to
+// that node.
+struct NumaTopology {
+	// Where a worker runs, see Place.
+	struct Placement {
+		std::size_t node;
+		int cpu;
+	};
+
+	// The CPUs of the nodes that have any, in ascending order.
+	std::vector<std::vector<int>> nodes;
+
+	// Reads the topology from sysfs on Linux. Elsewhere, or when it can't be
+	// read, all CPUs form a single node.
+	[[nodiscard]] static NumaTopology
+	Detect() noexcept;
+
+	// Spreads [count] workers over the nodes: worker N runs on node N modulo
+	// the amount of nodes, and the workers of a node take turns on its CPUs.
+	// Empty when there are no nodes.
+	[[nodiscard]] std::vector<Placement>
+	Place(std::size_t count) const noexcept;
+};
+
+// Parses a list of CPUs as formatted by the kernel, e.g. "0-3,8,10-11", and
+// appends them to [cpus]. An empty list is valid.
+//
+// Returns false if the list is malformed.
+[[nodiscard]] bool
+ParseCPUList(std::string_view list, std::vector<int> &cpus) noexcept;
+
+// The node of the calling thread, as set by SetCurrentNumaNode; 0 for threads
+// that haven't.
+[[nodiscard]] std::size_t
+CurrentNumaNode() noexcept;
+
+void
+SetCurrentNumaNode(std::size_t node) noexcept;
+
+// Restricts the calling thread to [cpus].
+//
+// Returns success status
+[[nodiscard]] bool
+PinThread(const std::vector<int> &cpus) noexcept;
+
+} // namespace base
@@ -0,0 +1,121 @@
+#pragma once
+
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace base {
+
+// Refers to an element of a SlotMap. A handle of a removed element stays
+// invalid, even when its slot has been reused, since the generation of the
+// slot is incremented on removal.
+struct SlotHandle {
+	std::uint32_t index{ UINT32_MAX };
+	std::uint32_t generation{ 0 };
+
+	[[nodiscard]] inline bool
+	IsValid() const noexcept {
+		return index != UINT32_MAX;
+	}
+};
+
+// A container owning its elements, which are inserted, found and removed by
+// handle in O(1). The slots of removed elements are reused before the slots
+// grow, so the slots are as many as the elements have been at most.
+//
+// A slot map isn't thread-safe; it is meant to be owned by a single thread.
+template <typename T>
+class SlotMap {
+public:
+	// Returns the handle of [value], which is stored in a free slot.
+	SlotHandle
+	Insert(std::unique_ptr<T> value) {
+		std::uint32_t index;
+		if (freeSlots.empty()) {
+			index = static_cast<std::uint32_t>(slots.size());
+			slots.emplace_back();
+
+			// Remove can't fail to free the slot then.
+			freeSlots.reserve(slots.size());
+		} else {
+			index = freeSlots.back();
+			freeSlots.pop_back();
+		}
+
+		auto &slot = slots[index];
+		slot.value = std::move(value);
+		count++;
+		return { index, slot.generation };
+	}
+
+	// Returns the element of [handle], or nullptr if it has been removed.
+	[[nodiscard]] T *
+	Find(SlotHandle handle) const noexcept {
+		if (handle.index >= slots.size() || slots[handle.index].generation != handle.generation) {
+			return nullptr;
+		}
+
+		return slots[handle.index].value.get();
+	}
+
+	// Destroys the element of [handle]. Returns false if it has been removed
+	// already.
+	bool
+	Remove(SlotHandle handle) noexcept {
+		// The element is destroyed after the slot has been freed, so it can't
+		// be found anymore while it is being destroyed.
+		return Take(handle) != nullptr;
+	}
+
+	// Removes the element of [handle] without destroying it. Returns nullptr
+	// if it has been removed already.
+	[[nodiscard]] std::unique_ptr<T>
+	Take(SlotHandle handle) noexcept {
+		if (Find(handle) == nullptr) {
+			return nullptr;
+		}
+
+		auto &slot = slots[handle.index];
+		slot.generation++;
+		freeSlots.push_back(handle.index);
+		count--;
+		return std::move(slot.value);
+	}
+
+	// Calls [function] with each element.
+	template <typename Function>
+	void
+	ForEach(Function function) const {
+		for (const auto &slot : slots) {
+			if (slot.value != nullptr) {
+				function(*slot.value);
+			}
+		}
+	}
+
+	[[nodiscard]] inline std::size_t
+	Size() const noexcept {
+		return count;
+	}
+
+private:
+	struct Slot {
+		std::unique_ptr<T> value;
+		std::uint32_t generation{ 0 };
+	};
+
+	std::vector<Slot> slots;
+	std::vector<std::uint32_t> freeSlots;
+	std::size_t count{ 0 };
+};
+
+} // namespace base
@@ -8,6 +8,12 @@
 
 namespace Strings {
 
+const base::String BadGatewayPage =
+	"<!doctype html>"
+	"<html>"
+	"<head><title>Bad Gateway</title></head>"
+	"<body><h1>Bad Gateway</h1></body>"
+	"</html>";
 const base::String DefaultWebPage = "<!doctype html><html lang=\"en\"><head><meta name=\"author\" content=\"Tristan\"><meta charset=\"utf-8\"><meta name=\"description\" content=\"It works! This is a default webpage.\"><title>Wizard Web Server - Default Webpage</title><style>*{font-family:\"Noto Sans\",\"Calibri\",\"Roboto\",sans-serif}html{background-color:#ddd;margin:0;height:100%}body{height:100%;margin:0}main{margin:0 10%;height:100%;width:80%;background-color:#fff}h1{padding-top:10%;margin:0;text-align:center}div{margin:0 6%}</style></head><body><main><h1>Wizard Web Server</h1><div><h3>It works!</h3><p>The fact that you can read this means that the web server has been configured correctly!</p><p>Now go ahead and change this page to your personal homepage :)</p></div><div><h3>About</h3><p>This is a default page, served to you by the <a href=\"https://github.com/usadson/WebServer\">Wizard Web Server</a>, a free BSD-3-Clause licensed webserver.</p></div></main></body></html>";
 const base::String ForbiddenPage =
 	"<!doctype html>"
@@ -43,6 +49,12 @@ const base::String FileSystemOverloadPage =
 	"<p>Unfortunately, we're currently experiencing temporary outages. Sorry for the inconvenience!</p>"
 	"</body>"
 	"</html>";
+const base::String GatewayTimeoutPage =
+	"<!doctype html>"
+	"<html>"
+	"<head><title>Gateway Timeout</title></head>"
+	"<body><h1>Gateway Timeout</h1></body>"
+	"</html>";
 const base::String VersionNotSupportedPage =
 	R"(
 <!doctype html>
@@ -58,6 +70,7 @@ const base::String VersionNotSupportedPage =
 </html>)";
 
 namespace BadRequestMessages {
+const base::String BodyTooLarge = "request body too large";
 const base::String EmptyMethod =
 	"A method cannot be empty.\n"
 	"RFC 7230 section 3.1.1 specifies a method as follows:\n"
@@ -73,19 +86,31 @@ const base::String EmptyMethod =
 	"                    ; any VCHAR, except delimiters\n";
 const base::String HeaderFieldNameTooLong = "header field-name too long";
 const base::String HeaderFieldValueTooLong = "header field-value too long";
+const base::String MalformedBody = "malformed request body";
 const base::String MethodTooLong = "method too long";
+const base::String RequestHeadTooLarge = "request-line and header fields too large";
 const base::String RequestTargetTooLong = "request-target too long";
+const base::String TooManyHeaders = "too many header fields";
 const base::String TooManyOWSs = "too many ows's";
+const base::String UnsupportedTransferCoding = "unsupported transfer coding";
 } // namespace BadRequests
 
 namespace StatusLines {
+const base::String BadGateway = "HTTP/1.1 502 Bad Gateway";
 const base::String BadRequest = "HTTP/1.1 400 Bad Request";
+const base::String Continue = "HTTP/1.1 100 Continue";
 const base::String Forbidden = "HTTP/1.1 403 Forbidden";
+const base::String GatewayTimeout = "HTTP/1.1 504 Gateway Timeout";
 const base::String HTTPVersionNotSupported = "HTTP/1.1 505 HTTP Version Not Supported";
 const base::String MovedPermanently = "HTTP/1.1 301 Moved Permanently";
 const base::String NotFound = "HTTP/1.1 404 Not Found";
+const base::String NotImplemented = "HTTP/1.1 501 Not Implemented";
+const base::String NotModified = "HTTP/1.1 304 Not Modified";
 const base::String OK = "HTTP/1.1 200 OK";
+const base::String PartialContent = "HTTP/1.1 206 Partial Content";
 const base::String PayloadTooLarge = "HTTP/1.1 413 Payload Too Large";
+const base::String RangeNotSatisfiable = "HTTP/1.1 416 Range Not Satisfiable";
+const base::String RequestHeaderFieldsTooLarge = "HTTP/1.1 431 Request Header Fields Too Large";
 const base::String ServiceUnavailable = "HTTP/1.1 503 Service Unavailable";
 const base::String TooManyRequests = "HTTP/1.1 429 Too Many Requests";
 const base::String URITooLong = "HTTP/1.1 414 URI Too Long";
@@ -10,30 +10,45 @@
 
 namespace Strings {
 
+extern const base::String BadGatewayPage;
 extern const base::String DefaultWebPage;
 extern const base::String ForbiddenPage;
 extern const base::String NotFoundPage;
 extern const base::String TooManyRequestsPage;
 extern const base::String FileSystemOverloadPage;
+extern const base::String GatewayTimeoutPage;
 extern const base::String VersionNotSupportedPage;
 
 namespace BadRequestMessages {
+	extern const base::String BodyTooLarge;
 	extern const base::String EmptyMethod;
 	extern const base::String HeaderFieldNameTooLong;
 	extern const base::String HeaderFieldValueTooLong;
+	extern const base::String MalformedBody;
 	extern const base::String MethodTooLong;
+	extern const base::String RequestHeadTooLarge;
 	extern const base::String RequestTargetTooLong;
+	extern const base::String TooManyHeaders;
 	extern const base::String TooManyOWSs;
+	extern const base::String UnsupportedTransferCoding;
 } // namespace BadRequestMessages
 
 namespace StatusLines {
+	extern const base::String BadGateway;
 	extern const base::String BadRequest;
+	extern const base::String Continue;
 	extern const base::String Forbidden;
+	extern const base::String GatewayTimeout;
 	extern const base::String HTTPVersionNotSupported;
 	extern const base::String MovedPermanently;
 	extern const base::String NotFound;
+	extern const base::String NotImplemented;
+	extern const base::String NotModified;
 	extern const base::String OK;
+	extern const base::String PartialContent;
 	extern const base::String PayloadTooLarge;
+	extern const base::String RangeNotSatisfiable;
+	extern const base::String RequestHeaderFieldsTooLarge;
 	extern const base::String ServiceUnavailable;
 	extern const base::String TooManyRequests;
 	extern const base::String URITooLong;
@@ -0,0 +1,93 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include "base/thread_pool.hpp"
+
+#include <system_error>
+#include <utility>
+
+namespace base {
+
+ThreadPool::ThreadPool(std::size_t threadCount, std::size_t queueCapacity) noexcept
+	: threadCount(threadCount), queueCapacity(queueCapacity) {
+}
+
+ThreadPool::~ThreadPool() noexcept {
+	Stop();
+}
+
+void
+ThreadPool::Run() noexcept {
+	while (true) {
+		std::function<void()> task;
+
+		{
+			std::unique_lock lock(mutex);
+			condition.wait(lock, [this] { return !running || !tasks.empty(); });
+
+			if (!running) {
+				return;
+			}
+
+			task = std::move(tasks.front());
+			tasks.pop_front();
+		}
+
+		task();
+	}
+}
+
+bool
+ThreadPool::Start() noexcept {
+	{
+		const std::lock_guard lock(mutex);
+		running = true;
+	}
+
+	try {
+		threads.reserve(threadCount);
+		for (std::size_t i = 0; i < threadCount; i++) {
+			threads.emplace_back(&ThreadPool::Run, this);
+		}
+	} catch (const std::system_error &) {
+		Stop();
+		return false;
+	}
+
+	return true;
+}
+
+void
+ThreadPool::Stop() noexcept {
+	{
+		const std::lock_guard lock(mutex);
+		running = false;
+		tasks.clear();
+		condition.notify_all();
+	}
+
+	for (auto &thread : threads) {
+		thread.join();
+	}
+	threads.clear();
+}
+
+bool
+ThreadPool::TrySubmit(std::function<void()> &task) noexcept {
+	{
+		const std::lock_guard lock(mutex);
+		if (!running || tasks.size() >= queueCapacity) {
+			return false;
+		}
+
+		tasks.push_back(std::move(task));
+		condition.notify_one();
+	}
+
+	return true;
+}
+
+} // namespace base
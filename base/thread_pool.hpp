@@ -0,0 +1,65 @@
+#pragma once
+
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <cstddef>
+
+namespace base {
+
+// A fixed amount of threads running submitted tasks in order of submission.
+// The queue of tasks is bounded, so that a burst of work is pushed back on the
+// submitter instead of piling up.
+class ThreadPool {
+public:
+	ThreadPool(std::size_t threadCount, std::size_t queueCapacity) noexcept;
+
+	// Stops the pool, see Stop.
+	~ThreadPool() noexcept;
+
+	ThreadPool(const ThreadPool &) = delete;
+	ThreadPool &operator=(const ThreadPool &) = delete;
+
+	// Returns success status
+	[[nodiscard]] bool
+	Start() noexcept;
+
+	// Waits for the running tasks to finish and joins the threads. Tasks that
+	// haven't started yet are discarded.
+	void
+	Stop() noexcept;
+
+	// Queues [task] to run on one of the threads.
+	//
+	// Returns false if the queue is full or the pool isn't running, in which
+	// case [task] is left untouched.
+	[[nodiscard]] bool
+	TrySubmit(std::function<void()> &task) noexcept;
+
+private:
+	const std::size_t threadCount;
+	const std::size_t queueCapacity;
+
+	std::mutex mutex;
+	std::condition_variable condition;
+	std::deque<std::function<void()>> tasks;
+	bool running{ false };
+
+	std::vector<std::thread> threads;
+
+	// The function of each thread.
+	void
+	Run() noexcept;
+};
+
+} // namespace base
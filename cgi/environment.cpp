@@ -0,0 +1,117 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include "cgi/environment.hpp"
+
+#include <algorithm>
+#include <iterator>
+
+#include <cstdlib>
+
+#include "http/body_reader.hpp"
+#include "http/configuration.hpp"
+#include "http/request.hpp"
+
+namespace CGI {
+
+using HTTP::Utils::EqualsIgnoreCase;
+
+[[nodiscard]] static std::string
+Variable(std::string_view name, std::string_view value) {
+	std::string variable;
+	variable.reserve(name.length() + 1 + value.length());
+	variable.append(name);
+	variable.push_back('=');
+	variable.append(value);
+	return variable;
+}
+
+// Spec: RFC 3875 § 4.1.18
+[[nodiscard]] static std::string
+ProtocolVariableName(std::string_view fieldName) {
+	std::string name("HTTP_");
+	name.reserve(name.length() + fieldName.length());
+	std::transform(std::cbegin(fieldName), std::cend(fieldName), std::back_inserter(name), [](char character) {
+		if (character == '-') {
+			return '_';
+		}
+		return (character >= 'a' && character <= 'z') ? static_cast<char>(character - ('a' - 'A')) : character;
+	});
+	return name;
+}
+
+std::vector<std::string>
+CreateEnvironment(const Script &script, const HTTP::Request &request, const HTTP::Configuration &configuration,
+				  std::string_view remoteAddress, const HTTP::BodyReader &body) {
+	std::string_view serverName = configuration.hostname;
+	if (const auto *host = request.headers.Find(HTTP::HeaderID::HOST); host != nullptr && !host->value.empty()) {
+		serverName = host->value;
+		// A port, but not the colons of an IPv6 address.
+		if (const auto colon = serverName.rfind(':');
+			colon != std::string_view::npos && serverName.find(']', colon) == std::string_view::npos) {
+			serverName = serverName.substr(0, colon);
+		}
+	}
+
+	std::vector<std::string> environment{
+		"GATEWAY_INTERFACE=CGI/1.1",
+		Variable("REQUEST_METHOD", request.method),
+		Variable("SCRIPT_NAME", request.path),
+		"PATH_INFO=",
+		Variable("QUERY_STRING", request.query),
+		Variable("REMOTE_ADDR", remoteAddress),
+		Variable("SERVER_NAME", serverName),
+		Variable("SERVER_PORT", std::to_string(configuration.port)),
+		Variable("SERVER_PROTOCOL", request.versionMinor == 0 ? "HTTP/1.0" : "HTTP/1.1"),
+		Variable("SERVER_SOFTWARE", configuration.serverProductName),
+	};
+
+	if (configuration.useTransportSecurity) {
+		environment.emplace_back("HTTPS=on");
+	}
+
+	// Spec: RFC 3875 § 4.1.2 and § 4.1.3
+	// A chunked body has no length up front, so scripts read it until the
+	// end of their input.
+	if (body.Framing() == HTTP::BodyFraming::CONTENT_LENGTH) {
+		environment.push_back(Variable("CONTENT_LENGTH", std::to_string(body.ContentLength())));
+	}
+	if (const auto *type = request.headers.Find(HTTP::HeaderID::CONTENT_TYPE); type != nullptr) {
+		environment.push_back(Variable("CONTENT_TYPE", type->value));
+	}
+
+	if (script.Type == Protocol::FAST_CGI) {
+		environment.push_back(Variable("SCRIPT_FILENAME", script.Command));
+	} else if (const char *path = std::getenv("PATH"); path != nullptr) {
+		environment.push_back(Variable("PATH", path));
+	}
+
+	for (const auto &header : request.headers) {
+		if (EqualsIgnoreCase(header.name, "Proxy") || header.id == HTTP::HeaderID::CONTENT_LENGTH ||
+			header.id == HTTP::HeaderID::CONTENT_TYPE || header.id == HTTP::HeaderID::TRANSFER_ENCODING) {
+			continue;
+		}
+
+		// Spec: RFC 3875 § 4.1.18
+		// Fields with the same name are combined into one variable.
+		auto name = ProtocolVariableName(header.name);
+		name.push_back('=');
+		auto existing = std::find_if(std::begin(environment), std::end(environment), [&name](const auto &variable) {
+			return variable.compare(0, name.length(), name) == 0;
+		});
+
+		if (existing == std::end(environment)) {
+			environment.push_back(name.append(header.value));
+		} else {
+			existing->append(", ");
+			existing->append(header.value);
+		}
+	}
+
+	return environment;
+}
+
+} // namespace CGI
@@ -0,0 +1,36 @@
+#pragma once
+
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "cgi/script.hpp"
+
+namespace HTTP {
+// From http/body_reader.hpp:
+class BodyReader;
+// From http/configuration.hpp:
+struct Configuration;
+// From http/request.hpp:
+struct Request;
+} // namespace HTTP
+
+namespace CGI {
+
+// Creates the meta-variables for a request to [script], as "NAME=value"
+// strings. The request header fields are passed as HTTP_* variables, except
+// Proxy, which scripts would otherwise take as HTTP_PROXY, and the fields
+// framing the [body], which CONTENT_LENGTH describes instead.
+//
+// Spec: RFC 3875 § 4.1
+[[nodiscard]] std::vector<std::string>
+CreateEnvironment(const Script &script, const HTTP::Request &request, const HTTP::Configuration &configuration,
+				  std::string_view remoteAddress, const HTTP::BodyReader &body);
+
+} // namespace CGI
@@ -0,0 +1,963 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include "cgi/exchange.hpp"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <random>
+
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <spawn.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "base/logger.hpp"
+#include "cgi/fastcgi.hpp"
+#include "cgi/proxy.hpp"
+#include "http/body_reader.hpp"
+
+// The amount of octets read from a script at once.
+#define MAGIC_CGI_READ_SIZE 16384
+
+// The time an upstream is passed over after connecting to it failed.
+#define MAGIC_UPSTREAM_DOWN_TIME 10000
+
+// The request ID used on FastCGI connections, which carry one request at a
+// time.
+#define MAGIC_FASTCGI_REQUEST_ID 1
+
+namespace CGI {
+
+Backend::Backend(std::size_t maxConcurrency, const std::vector<std::string> &addresses) :
+		maxConcurrency(maxConcurrency) {
+	upstreams.reserve(addresses.size());
+	for (const auto &address : addresses) {
+		upstreams.push_back(std::make_unique<Upstream>(address, maxConcurrency));
+	}
+}
+
+bool
+Backend::Acquire() noexcept {
+	auto current = running.load(std::memory_order_relaxed);
+	do {
+		if (current >= maxConcurrency) {
+			return false;
+		}
+	} while (!running.compare_exchange_weak(current, current + 1, std::memory_order_acq_rel));
+	return true;
+}
+
+void
+Backend::Release() noexcept {
+	running.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+Upstream *
+Backend::SelectUpstream(const Upstream *excluded) noexcept {
+	const auto now = std::chrono::steady_clock::now();
+	thread_local std::minstd_rand random{ std::random_device{}() };
+
+	// The "power of two choices": two random candidates are compared, which
+	// balances nearly as well as comparing all of them. The second is drawn
+	// from the others, so they're distinct.
+	std::array<std::size_t, 2> indices{};
+	const std::size_t candidateCount = std::min<std::size_t>(2, upstreams.size());
+	if (candidateCount == 2) {
+		indices[0] = random() % upstreams.size();
+		indices[1] = random() % (upstreams.size() - 1);
+		if (indices[1] >= indices[0]) {
+			indices[1]++;
+		}
+	}
+
+	Upstream *selected = nullptr;
+	bool selectedDown = true;
+	for (std::size_t i = 0; i < candidateCount; i++) {
+		auto *candidate = upstreams[indices[i]].get();
+		if (candidate == excluded) {
+			continue;
+		}
+
+		const bool down = candidate->IsDown(now);
+		if (selected == nullptr || (selectedDown && !down) ||
+			(selectedDown == down && candidate->Active() < selected->Active())) {
+			selected = candidate;
+			selectedDown = down;
+		}
+	}
+
+	if (selected != nullptr && !selectedDown) {
+		return selected;
+	}
+
+	// The candidates are down, or were excluded, so any upstream that isn't
+	// is taken instead.
+	for (const auto &upstream : upstreams) {
+		if (upstream.get() != excluded && !upstream->IsDown(now)) {
+			return upstream.get();
+		}
+	}
+
+	if (selected == nullptr) {
+		for (const auto &upstream : upstreams) {
+			if (upstream.get() != excluded) {
+				return upstream.get();
+			}
+		}
+	}
+
+	return selected;
+}
+
+Upstream::~Upstream() noexcept {
+	for (int fd : idleConnections) {
+		close(fd);
+	}
+}
+
+bool
+Upstream::IsDown(std::chrono::steady_clock::time_point now) const noexcept {
+	return now.time_since_epoch().count() < downUntil.load(std::memory_order_relaxed);
+}
+
+int
+Upstream::TakeConnection() noexcept {
+	std::lock_guard guard(mutex);
+	if (idleConnections.empty()) {
+		return -1;
+	}
+
+	const int fd = idleConnections.back();
+	idleConnections.pop_back();
+	return fd;
+}
+
+void
+Upstream::ReturnConnection(int fd) noexcept {
+	{
+		std::lock_guard guard(mutex);
+		if (idleConnections.size() < maxIdleConnections) {
+			idleConnections.push_back(fd);
+			return;
+		}
+	}
+
+	close(fd);
+}
+
+Exchange::~Exchange() noexcept {
+	if (backend) {
+		backend->Release();
+	}
+}
+
+// Returns the milliseconds left until [deadline], for poll(2).
+[[nodiscard]] static int
+TimeLeft(std::chrono::steady_clock::time_point deadline) noexcept {
+	const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+	return static_cast<int>(std::max<std::chrono::milliseconds::rep>(0, left.count()));
+}
+
+bool
+Exchange::Wait() const noexcept {
+	const auto awaited = Awaiting();
+	std::array<struct pollfd, 2> descriptors{};
+	for (std::size_t i = 0; i < awaited.size(); i++) {
+		descriptors[i] = { awaited[i].fd, static_cast<short>(awaited[i].write ? POLLIN | POLLOUT : POLLIN), 0 };
+	}
+
+	while (true) {
+		const int result = poll(descriptors.data(), descriptors.size(), TimeLeft(deadline));
+		if (result == -1 && errno == EINTR) {
+			continue;
+		}
+		return result > 0;
+	}
+}
+
+class ProcessExchange : public Exchange {
+public:
+	// The body of the request is written to [input], unless it is -1.
+	inline
+	ProcessExchange(std::shared_ptr<Backend> backend, std::chrono::milliseconds timeout, pid_t pid, int fd,
+					int input) noexcept :
+		Exchange(std::move(backend), timeout), pid(pid), fd(fd), input(input) {
+	}
+
+	~ProcessExchange() noexcept override {
+		CloseInput();
+		close(fd);
+
+		// A script that is still running after its output was closed, or
+		// timed out, is stopped.
+		if (waitpid(pid, nullptr, WNOHANG) == 0) {
+			kill(pid, SIGKILL);
+			static_cast<void>(waitpid(pid, nullptr, 0));
+		}
+	}
+
+	// While the script doesn't accept more input, its output is still read,
+	// since it might write it before it has read all of its input.
+	[[nodiscard]] std::array<Readiness, 2>
+	Awaiting() const noexcept override {
+		if (inputOffset != inputQueue.length()) {
+			return { { { input, true }, { fd, false } } };
+		}
+		return { { { fd, false }, {} } };
+	}
+
+	[[nodiscard]] Status
+	Read(std::string &output) noexcept override {
+		if (!inputBlocked && WriteInput() == Status::FAILED) {
+			return Status::FAILED;
+		}
+
+		std::array<char, MAGIC_CGI_READ_SIZE> buffer{};
+		const auto result = read(fd, buffer.data(), buffer.size());
+		if (result == 0) {
+			return Status::END;
+		}
+
+		if (result == -1) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+				return Status::WOULD_BLOCK;
+			}
+			return Status::FAILED;
+		}
+
+		output.append(buffer.data(), static_cast<std::size_t>(result));
+		return Status::DATA;
+	}
+
+	[[nodiscard]] Status
+	WriteBody(std::string_view data) noexcept override {
+		if (input == -1) {
+			return Status::DATA;
+		}
+
+		inputQueue.append(data);
+		const auto status = WriteInput();
+		inputBlocked = status == Status::WOULD_BLOCK;
+		return status;
+	}
+
+	[[nodiscard]] Status
+	Flush() noexcept override {
+		const auto status = WriteInput();
+		if (status != Status::WOULD_BLOCK) {
+			inputBlocked = false;
+		}
+		return status;
+	}
+
+	[[nodiscard]] bool
+	EndBody() noexcept override {
+		inputEnded = true;
+		inputBlocked = false;
+		return WriteInput() != Status::FAILED;
+	}
+
+private:
+	const pid_t pid;
+	const int fd;
+	int input;
+
+	// The part of the body that the script hasn't accepted yet, of which the
+	// octets before the offset have been written. The input is closed once
+	// the queue is written after the body has ended.
+	std::string inputQueue;
+	std::size_t inputOffset{ 0 };
+	bool inputEnded{ false };
+
+	// Whether WriteBody left part of the body in the queue. Until Flush has
+	// written it, Read leaves it alone, so that the caller notices when the
+	// script accepts more.
+	bool inputBlocked{ false };
+
+	void
+	CloseInput() noexcept {
+		if (input != -1) {
+			close(input);
+			input = -1;
+		}
+	}
+
+	// Writes as much of the queued input as the script accepts. Returns DATA
+	// once all of it is written.
+	[[nodiscard]] Status
+	WriteInput() noexcept {
+		while (input != -1 && inputOffset != inputQueue.length()) {
+			const auto result = write(input, inputQueue.data() + inputOffset, inputQueue.length() - inputOffset);
+			if (result != -1) {
+				inputOffset += static_cast<std::size_t>(result);
+				continue;
+			}
+
+			if (errno == EINTR) {
+				continue;
+			}
+
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				return Status::WOULD_BLOCK;
+			}
+
+			// The script doesn't read the rest of the body, which is
+			// discarded.
+			if (errno == EPIPE) {
+				CloseInput();
+				break;
+			}
+
+			return Status::FAILED;
+		}
+
+		inputQueue.clear();
+		inputOffset = 0;
+		if (inputEnded) {
+			CloseInput();
+		}
+		return Status::DATA;
+	}
+};
+
+std::unique_ptr<Exchange>
+StartProcess(const Script &script, const std::vector<std::string> &environment, HTTP::BodyFraming framing) noexcept {
+	std::array<int, 2> pipes{};
+	if (pipe2(pipes.data(), O_CLOEXEC) == -1) {
+		script.State->Release();
+		return nullptr;
+	}
+
+	if (fcntl(pipes[0], F_SETFL, O_NONBLOCK) == -1) {
+		close(pipes[0]);
+		close(pipes[1]);
+		script.State->Release();
+		return nullptr;
+	}
+
+	std::array<int, 2> inputPipes{ -1, -1 };
+	if (framing != HTTP::BodyFraming::NONE &&
+		(pipe2(inputPipes.data(), O_CLOEXEC) == -1 || fcntl(inputPipes[1], F_SETFL, O_NONBLOCK) == -1)) {
+		for (const int pipe : { pipes[0], pipes[1], inputPipes[0], inputPipes[1] }) {
+			if (pipe != -1) {
+				close(pipe);
+			}
+		}
+		script.State->Release();
+		return nullptr;
+	}
+
+	std::vector<char *> variables;
+	variables.reserve(environment.size() + 1);
+	for (const auto &variable : environment) {
+		variables.push_back(const_cast<char *>(variable.c_str()));
+	}
+	variables.push_back(nullptr);
+
+	std::array<char *, 2> arguments{ const_cast<char *>(script.Command.c_str()), nullptr };
+
+	posix_spawn_file_actions_t actions;
+	posix_spawn_file_actions_init(&actions);
+	if (inputPipes[0] != -1) {
+		posix_spawn_file_actions_adddup2(&actions, inputPipes[0], STDIN_FILENO);
+	} else {
+		posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+	}
+	posix_spawn_file_actions_adddup2(&actions, pipes[1], STDOUT_FILENO);
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 34))
+	// The sockets of the other clients aren't opened with O_CLOEXEC.
+	posix_spawn_file_actions_addclosefrom_np(&actions, STDERR_FILENO + 1);
+#endif
+
+	// A CGI script handles a single request, with the environment and the
+	// standard streams of it, so a process can't be started ahead of the
+	// request or reused for the next one. Scripts that should stay running are
+	// served as FastCGI applications instead. posix_spawn(3) doesn't copy the
+	// page tables of the server, so the cost doesn't grow with its memory.
+	pid_t pid{};
+	const int result = posix_spawn(&pid, script.Command.c_str(), &actions, nullptr, arguments.data(), variables.data());
+	posix_spawn_file_actions_destroy(&actions);
+	close(pipes[1]);
+	if (inputPipes[0] != -1) {
+		close(inputPipes[0]);
+	}
+
+	if (result != 0) {
+		Logger::Warning("CGI", "Failed to start \"" + script.Command + "\": " + std::strerror(result));
+		close(pipes[0]);
+		if (inputPipes[1] != -1) {
+			close(inputPipes[1]);
+		}
+		script.State->Release();
+		return nullptr;
+	}
+
+	return std::make_unique<ProcessExchange>(script.State, script.Timeout, pid, pipes[0], inputPipes[1]);
+}
+
+// Starts connecting to [address] with a non-blocking socket, see
+// Upstream::Connect. Returns -1 on failure.
+[[nodiscard]] static int
+ConnectTo(const std::string &address, bool &inProgress) noexcept {
+	struct sockaddr_storage storage{};
+	socklen_t length{};
+
+	if (!address.empty() && address.front() == '/') {
+		auto *local = reinterpret_cast<struct sockaddr_un *>(&storage);
+		if (address.length() >= sizeof(local->sun_path)) {
+			return -1;
+		}
+		local->sun_family = AF_UNIX;
+		std::copy(std::cbegin(address), std::cend(address), local->sun_path);
+		length = sizeof(struct sockaddr_un);
+	} else {
+		const auto separator = address.rfind(':');
+		if (separator == std::string::npos) {
+			return -1;
+		}
+
+		std::uint16_t port{};
+		const char *portEnd = address.data() + address.length();
+		const auto portResult = std::from_chars(address.data() + separator + 1, portEnd, port);
+		if (portResult.ec != std::errc{} || portResult.ptr != portEnd) {
+			return -1;
+		}
+
+		auto host = address.substr(0, separator);
+		if (host.length() > 2 && host.front() == '[' && host.back() == ']') {
+			host = host.substr(1, host.length() - 2);
+		}
+
+		auto *ipv4 = reinterpret_cast<struct sockaddr_in *>(&storage);
+		auto *ipv6 = reinterpret_cast<struct sockaddr_in6 *>(&storage);
+		if (inet_pton(AF_INET, host.c_str(), &ipv4->sin_addr) == 1) {
+			ipv4->sin_family = AF_INET;
+			ipv4->sin_port = htons(port);
+			length = sizeof(struct sockaddr_in);
+		} else if (inet_pton(AF_INET6, host.c_str(), &ipv6->sin6_addr) == 1) {
+			ipv6->sin6_family = AF_INET6;
+			ipv6->sin6_port = htons(port);
+			length = sizeof(struct sockaddr_in6);
+		} else {
+			return -1;
+		}
+	}
+
+	const int fd = socket(storage.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd == -1) {
+		return -1;
+	}
+
+	inProgress = false;
+	if (connect(fd, reinterpret_cast<struct sockaddr *>(&storage), length) == 0) {
+		return fd;
+	}
+
+	// A UNIX socket with a full backlog fails with EAGAIN instead, which is
+	// treated as the upstream being down.
+	if (errno == EINPROGRESS) {
+		inProgress = true;
+		return fd;
+	}
+
+	close(fd);
+	return -1;
+}
+
+// Whether [fd] is writable, without waiting.
+[[nodiscard]] static bool
+IsWritable(int fd) noexcept {
+	struct pollfd descriptor{ fd, POLLOUT, 0 };
+	return poll(&descriptor, 1, 0) == 1;
+}
+
+int
+Upstream::Connect(bool &inProgress) noexcept {
+	const int fd = ConnectTo(address, inProgress);
+	if (fd == -1) {
+		MarkDown();
+	}
+	return fd;
+}
+
+void
+Upstream::MarkDown() noexcept {
+	const auto until = std::chrono::steady_clock::now() + std::chrono::milliseconds(MAGIC_UPSTREAM_DOWN_TIME);
+	downUntil.store(until.time_since_epoch().count(), std::memory_order_relaxed);
+	Logger::Warning("CGI", "Failed to connect to \"" + address + "\"");
+}
+
+// An exchange over a connection to an upstream. The connection is kept for
+// the next request if the response allows it, see Keep.
+//
+// The request and the body are queued, and sent as the connection accepts
+// them, see Send. Until they're sent, the exchange waits for the connection
+// to become writable, or readable, since the response is read meanwhile.
+class SocketExchange : public Exchange {
+public:
+	inline
+	SocketExchange(const Script &script, Upstream *upstream, std::string &&request) noexcept :
+		Exchange(script.State, script.Timeout), script(script), upstream(upstream), request(std::move(request)) {
+		upstream->Begin();
+	}
+
+	~SocketExchange() noexcept override {
+		// The upstream might still be sending the response, so the
+		// connection can't be used for another request.
+		if (fd != -1) {
+			close(fd);
+		}
+		upstream->End();
+	}
+
+	[[nodiscard]] std::array<Readiness, 2>
+	Awaiting() const noexcept override {
+		return { { { fd, connecting || pendingOffset != pending.length() }, {} } };
+	}
+
+	// Takes a kept connection, or starts connecting, and queues the request.
+	// If the upstream can't be reached, another one is tried.
+	//
+	// Returns false if no connection could be started
+	[[nodiscard]] bool
+	Start() noexcept {
+		if (!Open()) {
+			return false;
+		}
+
+		pending = request;
+		return true;
+	}
+
+	// The response is read while the request is still being sent, since the
+	// upstream might answer before it has received all of the body.
+	[[nodiscard]] Status
+	Read(std::string &output) noexcept override {
+		if (!bodyBlocked) {
+			if (const auto status = Send(); status == Status::FAILED) {
+				return status;
+			}
+		}
+
+		if (connecting) {
+			return Status::WOULD_BLOCK;
+		}
+
+		std::array<char, MAGIC_CGI_READ_SIZE> buffer{};
+		const auto outputLength = output.length();
+
+		while (true) {
+			const auto result = recv(fd, buffer.data(), buffer.size(), 0);
+			if (result == -1 && errno == EINTR) {
+				continue;
+			}
+
+			if (result == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+				return output.length() == outputLength ? Status::WOULD_BLOCK : Status::DATA;
+			}
+
+			if (result <= 0) {
+				// A kept connection might have been closed right before the
+				// request was sent.
+				if (reused && !received && Retry()) {
+					return Read(output);
+				}
+				return result == 0 ? OnClosed() : Status::FAILED;
+			}
+
+			received = true;
+			const auto status = Consume(std::string_view(buffer.data(), static_cast<std::size_t>(result)), output);
+			if (status != Status::DATA) {
+				return status;
+			}
+
+			if (output.length() - outputLength >= MAGIC_CGI_READ_SIZE) {
+				return Status::DATA;
+			}
+		}
+	}
+
+	[[nodiscard]] Status
+	Flush() noexcept override {
+		const auto status = Send();
+		if (status != Status::WOULD_BLOCK) {
+			bodyBlocked = false;
+		}
+		return status;
+	}
+
+protected:
+	const Script &script;
+
+	// Handles the next part of the response. Returns DATA if more is
+	// expected.
+	[[nodiscard]] virtual Status
+	Consume(std::string_view input, std::string &output) noexcept = 0;
+
+	// Called when the upstream has closed the connection.
+	[[nodiscard]] virtual Status
+	OnClosed() noexcept {
+		return Status::FAILED;
+	}
+
+	// Returns the connection to the upstream, once the response is
+	// complete.
+	void
+	Keep() noexcept {
+		upstream->ReturnConnection(fd);
+		fd = -1;
+	}
+
+	// Queues [data], a part of the body of the request, as encoded by the
+	// subclass, and sends as much of it as the connection accepts. See
+	// WriteBody.
+	[[nodiscard]] Status
+	SendBody(std::string_view data) noexcept {
+		pending.append(data);
+		const auto status = Send();
+		bodyBlocked = status == Status::WOULD_BLOCK;
+		return status;
+	}
+
+	// Queues [data], the end of the body, which Read sends with the rest of
+	// the queue.
+	//
+	// Returns success status
+	[[nodiscard]] bool
+	SendEnd(std::string_view data) noexcept {
+		pending.append(data);
+		bodyBlocked = false;
+		return Send() != Status::FAILED;
+	}
+
+private:
+	Upstream *upstream;
+	const std::string request;
+
+	int fd{ -1 };
+	bool connecting{ false };
+	bool reused{ false };
+	bool received{ false };
+
+	// Whether the request went to another upstream already, see Retry.
+	bool failedOver{ false };
+
+	// The octets of the request and the body that are queued, of which the
+	// ones before the offset have been sent. The amount of octets sent over
+	// the connection.
+	std::string pending;
+	std::size_t pendingOffset{ 0 };
+	std::size_t sent{ 0 };
+
+	// Whether SendBody left part of the body in the queue. Until Flush has
+	// sent it, Read leaves it alone, so that the caller notices when the
+	// upstream accepts more.
+	bool bodyBlocked{ false };
+
+	// Takes a kept connection to the upstream, or starts a new one.
+	[[nodiscard]] bool
+	Open() noexcept {
+		fd = upstream->TakeConnection();
+		reused = fd != -1;
+		return reused || Connect();
+	}
+
+	// Starts a new connection to the upstream, or opens one to another
+	// upstream if it can't be reached.
+	[[nodiscard]] bool
+	Connect() noexcept {
+		fd = upstream->Connect(connecting);
+		if (fd != -1) {
+			return true;
+		}
+
+		return FailOver() && Open();
+	}
+
+	// Selects another upstream, once.
+	[[nodiscard]] bool
+	FailOver() noexcept {
+		if (failedOver) {
+			return false;
+		}
+
+		auto *other = backend->SelectUpstream(upstream);
+		if (other == nullptr) {
+			return false;
+		}
+
+		failedOver = true;
+		upstream->End();
+		upstream = other;
+		upstream->Begin();
+		return true;
+	}
+
+	// Sends the queued octets. Returns DATA once all of them are sent.
+	[[nodiscard]] Status
+	Send() noexcept {
+		while (true) {
+			if (connecting) {
+				if (!IsWritable(fd)) {
+					return Status::WOULD_BLOCK;
+				}
+
+				int error{};
+				socklen_t errorLength = sizeof(error);
+				if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &errorLength) == -1 || error != 0) {
+					upstream->MarkDown();
+					if (!Retry()) {
+						return Status::FAILED;
+					}
+					continue;
+				}
+				connecting = false;
+			}
+
+			if (pendingOffset == pending.length()) {
+				pending.clear();
+				pendingOffset = 0;
+				return Status::DATA;
+			}
+
+			const auto result = send(fd, pending.data() + pendingOffset, pending.length() - pendingOffset, MSG_NOSIGNAL);
+			if (result == -1) {
+				if (errno == EINTR) {
+					continue;
+				}
+				if (errno == EAGAIN || errno == EWOULDBLOCK) {
+					return Status::WOULD_BLOCK;
+				}
+
+				// A kept connection might have been closed in the meantime.
+				if (!Retry()) {
+					return Status::FAILED;
+				}
+				continue;
+			}
+
+			pendingOffset += static_cast<std::size_t>(result);
+			sent += static_cast<std::size_t>(result);
+		}
+	}
+
+	// Sends the request over a new connection, after the kept one turned out
+	// to be closed, or to another upstream if the connection failed. This is
+	// only possible as long as none of the body has been sent.
+	[[nodiscard]] bool
+	Retry() noexcept {
+		if (sent > request.length()) {
+			return false;
+		}
+
+		// The body that is queued follows the rest of the request.
+		auto body = pending.substr(pendingOffset + (request.length() - sent));
+		close(fd);
+		fd = -1;
+		connecting = false;
+
+		if (reused) {
+			reused = false;
+			if (!Connect()) {
+				return false;
+			}
+		} else if (!FailOver() || !Open()) {
+			return false;
+		}
+
+		pending = request;
+		pending += body;
+		pendingOffset = 0;
+		sent = 0;
+		received = false;
+		return true;
+	}
+};
+
+class FastCGIExchange : public SocketExchange {
+public:
+	using SocketExchange::SocketExchange;
+
+	[[nodiscard]] Status
+	WriteBody(std::string_view data) noexcept override {
+		records.clear();
+		FastCGI::AppendStream(records, FastCGI::RecordType::STDIN, MAGIC_FASTCGI_REQUEST_ID, data);
+		return SendBody(records);
+	}
+
+	[[nodiscard]] bool
+	EndBody() noexcept override {
+		records.clear();
+		FastCGI::AppendRecord(records, FastCGI::RecordType::STDIN, MAGIC_FASTCGI_REQUEST_ID, {});
+		return SendEnd(records);
+	}
+
+private:
+	std::string input;
+
+	// The STDIN records of the body that are being sent.
+	std::string records;
+
+	// Handles the complete records that have been received.
+	[[nodiscard]] Status
+	Consume(std::string_view received, std::string &output) noexcept override {
+		input.append(received);
+
+		std::size_t offset = 0;
+		while (input.length() - offset >= FastCGI::headerSize) {
+			const auto header = FastCGI::ParseRecordHeader(input.data() + offset);
+			const std::size_t recordLength = FastCGI::headerSize + header.contentLength + header.paddingLength;
+			if (input.length() - offset < recordLength) {
+				break;
+			}
+
+			const std::string_view content(input.data() + offset + FastCGI::headerSize, header.contentLength);
+			offset += recordLength;
+
+			if (header.requestID != MAGIC_FASTCGI_REQUEST_ID) {
+				continue;
+			}
+
+			switch (header.type) {
+				case FastCGI::RecordType::STDOUT:
+					output.append(content);
+					break;
+				case FastCGI::RecordType::STDERR:
+					if (!content.empty()) {
+						Logger::Warning("CGI", script.Name + ": " + std::string(content));
+					}
+					break;
+				case FastCGI::RecordType::END_REQUEST:
+					// Spec: § 5.5
+					if (content.length() < 5 ||
+						static_cast<FastCGI::ProtocolStatus>(content[4]) != FastCGI::ProtocolStatus::REQUEST_COMPLETE) {
+						return Status::FAILED;
+					}
+
+					if (offset == input.length()) {
+						Keep();
+					}
+					return Status::END;
+				default:
+					break;
+			}
+		}
+
+		input.erase(0, offset);
+		return Status::DATA;
+	}
+};
+
+class ProxyExchange : public SocketExchange {
+public:
+	inline
+	ProxyExchange(const Script &script, Upstream *upstream, std::string &&request, bool headRequest,
+				  bool chunked) noexcept :
+		SocketExchange(script, upstream, std::move(request)), decoder(headRequest), chunked(chunked) {
+	}
+
+	// A body with chunked transfer coding is sent in chunks as it is
+	// received, and one with a Content-Length as it is.
+	//
+	// Spec: RFC 7230 § 4.1
+	[[nodiscard]] Status
+	WriteBody(std::string_view data) noexcept override {
+		if (!chunked || data.empty()) {
+			return SendBody(data);
+		}
+
+		std::array<char, 2 * sizeof(std::size_t)> size{};
+		const auto result = std::to_chars(size.data(), size.data() + size.size(), data.length(), 16);
+
+		chunk.assign(size.data(), result.ptr);
+		chunk += "\r\n";
+		chunk += data;
+		chunk += "\r\n";
+		return SendBody(chunk);
+	}
+
+	[[nodiscard]] bool
+	EndBody() noexcept override {
+		return !chunked || SendEnd("0\r\n\r\n");
+	}
+
+private:
+	ProxyDecoder decoder;
+	const bool chunked;
+
+	// The chunk of the body that is being sent.
+	std::string chunk;
+
+	[[nodiscard]] Status
+	Consume(std::string_view received, std::string &output) noexcept override {
+		switch (decoder.Feed(received, output)) {
+			case ProxyDecoder::Status::INCOMPLETE:
+				return Status::DATA;
+			case ProxyDecoder::Status::COMPLETE:
+				if (decoder.KeepAlive()) {
+					Keep();
+				}
+				return Status::END;
+			case ProxyDecoder::Status::FAILED:
+				break;
+		}
+
+		Logger::Warning("CGI", "The upstream of " + script.Name + " sent a malformed response");
+		return Status::FAILED;
+	}
+
+	[[nodiscard]] Status
+	OnClosed() noexcept override {
+		return decoder.Finish() == ProxyDecoder::Status::COMPLETE ? Status::END : Status::FAILED;
+	}
+};
+
+// Starts sending the request of [exchange], with the upstream given to it.
+[[nodiscard]] static std::unique_ptr<Exchange>
+Start(std::unique_ptr<SocketExchange> exchange) noexcept {
+	if (!exchange->Start()) {
+		return nullptr;
+	}
+	return exchange;
+}
+
+std::unique_ptr<Exchange>
+StartFastCGI(const Script &script, const std::vector<std::string> &environment, HTTP::BodyFraming framing) noexcept {
+	auto *upstream = script.State->SelectUpstream();
+	if (upstream == nullptr) {
+		script.State->Release();
+		return nullptr;
+	}
+
+	std::string request;
+	FastCGI::AppendRequest(request, MAGIC_FASTCGI_REQUEST_ID, environment, true, framing != HTTP::BodyFraming::NONE);
+	return Start(std::make_unique<FastCGIExchange>(script, upstream, std::move(request)));
+}
+
+std::unique_ptr<Exchange>
+StartProxy(const Script &script, std::string &&head, bool headRequest, HTTP::BodyFraming framing) noexcept {
+	auto *upstream = script.State->SelectUpstream();
+	if (upstream == nullptr) {
+		script.State->Release();
+		return nullptr;
+	}
+
+	const bool chunked = framing == HTTP::BodyFraming::CHUNKED;
+	return Start(std::make_unique<ProxyExchange>(script, upstream, std::move(head), headRequest, chunked));
+}
+
+} // namespace CGI
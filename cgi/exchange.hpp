@@ -0,0 +1,231 @@
+#pragma once
+
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <cstddef>
+
+#include "cgi/script.hpp"
+
+// From http/body_reader.hpp:
+namespace HTTP {
+	enum class BodyFraming;
+} // namespace HTTP
+
+namespace CGI {
+
+// An address of a script that requests are sent to: a FastCGI application,
+// or an HTTP server. The connections to it are kept open for the following
+// requests.
+class Upstream {
+public:
+	inline
+	Upstream(std::string address, std::size_t maxIdleConnections) noexcept :
+		address(std::move(address)), maxIdleConnections(maxIdleConnections) {
+	}
+
+	~Upstream() noexcept;
+
+	[[nodiscard]] inline const std::string &
+	Address() const noexcept {
+		return address;
+	}
+
+	// The amount of requests that are being sent to this upstream.
+	[[nodiscard]] inline std::size_t
+	Active() const noexcept {
+		return active.load(std::memory_order_relaxed);
+	}
+
+	inline void
+	Begin() noexcept {
+		active.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	inline void
+	End() noexcept {
+		active.fetch_sub(1, std::memory_order_relaxed);
+	}
+
+	// Opens a new non-blocking connection. [inProgress] is set if it is
+	// still being established, after which it becomes writable. Returns -1
+	// on failure, after which the upstream is considered down for a while.
+	[[nodiscard]] int
+	Connect(bool &inProgress) noexcept;
+
+	// Whether connecting failed recently. Once the time is up, the next
+	// request checks whether the upstream is back.
+	[[nodiscard]] bool
+	IsDown(std::chrono::steady_clock::time_point now) const noexcept;
+
+	// Returns an open connection, or -1 if there is none.
+	[[nodiscard]] int
+	TakeConnection() noexcept;
+
+	// Keeps the connection for the next request, or closes it if enough
+	// connections are kept already.
+	void
+	ReturnConnection(int fd) noexcept;
+
+	// Passes over the upstream for a while, since connecting to it failed.
+	void
+	MarkDown() noexcept;
+
+private:
+	const std::string address;
+	const std::size_t maxIdleConnections;
+
+	std::atomic<std::size_t> active{ 0 };
+	std::atomic<std::chrono::steady_clock::rep> downUntil{ 0 };
+
+	std::mutex mutex;
+	std::vector<int> idleConnections;
+};
+
+// The state shared by all requests to a script, which are handled by
+// different workers.
+class Backend {
+public:
+	Backend(std::size_t maxConcurrency, const std::vector<std::string> &addresses);
+
+	// Reserves a place for a request. Returns false if MaxConcurrency
+	// requests are already running.
+	[[nodiscard]] bool
+	Acquire() noexcept;
+
+	void
+	Release() noexcept;
+
+	// Selects the upstream for a request, of two random ones the one with
+	// the least active requests, passing over those that are down unless
+	// all of them are. Returns nullptr if there are no upstreams, or
+	// [excluded] is the only one.
+	[[nodiscard]] Upstream *
+	SelectUpstream(const Upstream *excluded = nullptr) noexcept;
+
+private:
+	const std::size_t maxConcurrency;
+	std::atomic<std::size_t> running{ 0 };
+
+	std::vector<std::unique_ptr<Upstream>> upstreams;
+};
+
+// A descriptor an exchange waits for, see Exchange::Awaiting.
+struct Readiness {
+	// -1 if there is no descriptor.
+	int fd{ -1 };
+
+	// Whether the descriptor should become writable, or readable, rather
+	// than only readable.
+	bool write{ false };
+};
+
+// A request being handled by a script, from which the output is read as it
+// comes in. The exchange never blocks: an operation that can't continue
+// returns WOULD_BLOCK, and is called again once a descriptor of Awaiting is
+// ready, e.g. from the event loop of a worker.
+class Exchange {
+public:
+	enum class Status {
+		// Output was appended.
+		DATA,
+
+		// No output is available yet, wait until Awaiting is ready.
+		WOULD_BLOCK,
+
+		// The script has finished its response. Output might have been
+		// appended.
+		END,
+
+		FAILED,
+	};
+
+	virtual ~Exchange() noexcept;
+
+	// The descriptors to wait for after an operation returned WOULD_BLOCK.
+	// The second one is only used by exchanges waiting for two at once.
+	[[nodiscard]] virtual std::array<Readiness, 2>
+	Awaiting() const noexcept = 0;
+
+	// Appends the output that is available, without blocking.
+	[[nodiscard]] virtual Status
+	Read(std::string &output) noexcept = 0;
+
+	// Sends [data], the next part of the body of the request, as far as the
+	// script accepts it, and queues the rest. Returns DATA if all of it was
+	// sent, or WOULD_BLOCK if part of it is queued, after which no more of
+	// the body is passed until Flush returns DATA. Only for exchanges that
+	// were started with a body.
+	[[nodiscard]] virtual Status
+	WriteBody(std::string_view data) noexcept = 0;
+
+	// Sends the queued part of the body, see WriteBody. Returns DATA once
+	// all of it is sent.
+	[[nodiscard]] virtual Status
+	Flush() noexcept = 0;
+
+	// Ends the body of the request, which is sent with the rest of the
+	// queue, before the output is read.
+	//
+	// Returns success status
+	[[nodiscard]] virtual bool
+	EndBody() noexcept = 0;
+
+	// The time at which the script should have finished.
+	[[nodiscard]] inline std::chrono::steady_clock::time_point
+	Deadline() const noexcept {
+		return deadline;
+	}
+
+	// Blocks until a descriptor of Awaiting is ready, for clients without an
+	// event loop. Returns false if the deadline passes first.
+	[[nodiscard]] bool
+	Wait() const noexcept;
+
+protected:
+	inline
+	Exchange(std::shared_ptr<Backend> backend, std::chrono::milliseconds timeout) noexcept :
+		backend(std::move(backend)), deadline(std::chrono::steady_clock::now() + timeout) {
+	}
+
+	std::shared_ptr<Backend> backend;
+	const std::chrono::steady_clock::time_point deadline;
+};
+
+// The functions below expect a place to be acquired in the Backend of
+// [script], which is released when the exchange is destroyed, or when they
+// fail.
+
+// Runs [script] as a new process with [environment], which are "NAME=value"
+// strings. The body of the request is the standard input, which is empty if
+// the request has no body, i.e. the [framing] is NONE.
+//
+// Spec: RFC 3875
+[[nodiscard]] std::unique_ptr<Exchange>
+StartProcess(const Script &script, const std::vector<std::string> &environment, HTTP::BodyFraming framing) noexcept;
+
+// Sends the request to the FastCGI application of [script], over a kept
+// connection if there is one. The body of the request is the STDIN stream.
+[[nodiscard]] std::unique_ptr<Exchange>
+StartFastCGI(const Script &script, const std::vector<std::string> &environment, HTTP::BodyFraming framing) noexcept;
+
+// Forwards the request with [head], see CreateUpstreamRequest, to an upstream
+// HTTP server of [script], over a kept connection if there is one. The body
+// is sent with the [framing] of the request. The response is read as the
+// output of a script.
+[[nodiscard]] std::unique_ptr<Exchange>
+StartProxy(const Script &script, std::string &&head, bool headRequest, HTTP::BodyFraming framing) noexcept;
+
+} // namespace CGI
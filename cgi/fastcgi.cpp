@@ -0,0 +1,115 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include "cgi/fastcgi.hpp"
+
+#include <algorithm>
+#include <array>
+
+namespace CGI::FastCGI {
+
+// The version of every record.
+constexpr std::uint8_t version = 1;
+
+// The role of a BEGIN_REQUEST record, and its flags.
+constexpr std::uint16_t roleResponder = 1;
+constexpr std::uint8_t flagKeepConnection = 1;
+
+RecordHeader
+ParseRecordHeader(const char *data) noexcept {
+	const auto *octets = reinterpret_cast<const unsigned char *>(data);
+	return {
+		static_cast<RecordType>(octets[1]),
+		static_cast<std::uint16_t>((octets[2] << 8) | octets[3]),
+		static_cast<std::uint16_t>((octets[4] << 8) | octets[5]),
+		octets[6]
+	};
+}
+
+void
+AppendRecord(std::string &output, RecordType type, std::uint16_t requestID, std::string_view content) noexcept {
+	// The content is padded to a multiple of eight octets, as recommended.
+	const auto length = static_cast<std::uint16_t>(content.length());
+	const auto padding = static_cast<std::uint8_t>((8 - (length % 8)) % 8);
+
+	const std::array<char, headerSize> header{
+		static_cast<char>(version),
+		static_cast<char>(type),
+		static_cast<char>(requestID >> 8),
+		static_cast<char>(requestID),
+		static_cast<char>(length >> 8),
+		static_cast<char>(length),
+		static_cast<char>(padding),
+		0
+	};
+
+	output.append(header.data(), header.size());
+	output.append(content);
+	output.append(padding, '\0');
+}
+
+// Lengths of at most 127 octets are encoded in a single octet, longer ones in
+// four with the high bit set.
+static void
+AppendLength(std::string &output, std::size_t length) noexcept {
+	if (length < 0x80) {
+		output.push_back(static_cast<char>(length));
+		return;
+	}
+
+	output.push_back(static_cast<char>(((length >> 24) & 0x7F) | 0x80));
+	output.push_back(static_cast<char>(length >> 16));
+	output.push_back(static_cast<char>(length >> 8));
+	output.push_back(static_cast<char>(length));
+}
+
+void
+AppendNameValuePair(std::string &output, std::string_view name, std::string_view value) noexcept {
+	AppendLength(output, name.length());
+	AppendLength(output, value.length());
+	output.append(name);
+	output.append(value);
+}
+
+void
+AppendStream(std::string &output, RecordType type, std::uint16_t requestID, std::string_view content) noexcept {
+	for (std::size_t offset = 0; offset < content.length(); offset += maxContentLength) {
+		AppendRecord(output, type, requestID, content.substr(offset, std::min(maxContentLength, content.length() - offset)));
+	}
+}
+
+void
+AppendRequest(std::string &output, std::uint16_t requestID, const std::vector<std::string> &environment,
+			  bool keepConnection, bool hasBody) noexcept {
+	const std::array<char, 8> begin{
+		static_cast<char>(roleResponder >> 8),
+		static_cast<char>(roleResponder),
+		static_cast<char>(keepConnection ? flagKeepConnection : 0),
+		0, 0, 0, 0, 0
+	};
+	AppendRecord(output, RecordType::BEGIN_REQUEST, requestID, std::string_view(begin.data(), begin.size()));
+
+	std::string params;
+	for (const auto &variable : environment) {
+		const auto separator = variable.find('=');
+		if (separator == std::string::npos) {
+			continue;
+		}
+		AppendNameValuePair(params, std::string_view(variable).substr(0, separator),
+							std::string_view(variable).substr(separator + 1));
+	}
+
+	// A pair may span two records.
+	AppendStream(output, RecordType::PARAMS, requestID, params);
+
+	// An empty record ends a stream.
+	AppendRecord(output, RecordType::PARAMS, requestID, {});
+	if (!hasBody) {
+		AppendRecord(output, RecordType::STDIN, requestID, {});
+	}
+}
+
+} // namespace CGI::FastCGI
@@ -0,0 +1,92 @@
+#pragma once
+
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+/**
+ * The records of the FastCGI protocol, as far as a web server needs them to
+ * talk to a responder.
+ *
+ * Spec: https://fastcgi-archives.github.io/FastCGI_Specification.html
+ */
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace CGI::FastCGI {
+
+// The length of the header of every record.
+constexpr std::size_t headerSize = 8;
+
+// The largest content a single record can have.
+constexpr std::size_t maxContentLength = 0xFFFF;
+
+// Spec: § 8
+enum class RecordType : std::uint8_t {
+	BEGIN_REQUEST = 1,
+	ABORT_REQUEST = 2,
+	END_REQUEST = 3,
+	PARAMS = 4,
+	STDIN = 5,
+	STDOUT = 6,
+	STDERR = 7,
+	DATA = 8,
+	GET_VALUES = 9,
+	GET_VALUES_RESULT = 10,
+	UNKNOWN_TYPE = 11,
+};
+
+// The protocolStatus of an END_REQUEST record.
+enum class ProtocolStatus : std::uint8_t {
+	REQUEST_COMPLETE = 0,
+	CANT_MPX_CONN = 1,
+	OVERLOADED = 2,
+	UNKNOWN_ROLE = 3,
+};
+
+struct RecordHeader {
+	RecordType type;
+	std::uint16_t requestID;
+	std::uint16_t contentLength;
+	std::uint8_t paddingLength;
+};
+
+// Parses the headerSize octets of [data].
+[[nodiscard]] RecordHeader
+ParseRecordHeader(const char *data) noexcept;
+
+// Appends a record of [type] with [content], which is at most
+// maxContentLength octets.
+void
+AppendRecord(std::string &output, RecordType type, std::uint16_t requestID, std::string_view content) noexcept;
+
+// Appends [content] as the next part of the stream of [type], split over
+// records of at most maxContentLength octets. Doesn't end the stream, which
+// an empty record does.
+void
+AppendStream(std::string &output, RecordType type, std::uint16_t requestID, std::string_view content) noexcept;
+
+// Appends the encoding of a name-value pair, as used in PARAMS streams.
+//
+// Spec: § 3.4
+void
+AppendNameValuePair(std::string &output, std::string_view name, std::string_view value) noexcept;
+
+// Appends the records that start a request to a responder: BEGIN_REQUEST,
+// and the PARAMS stream with the variables of [environment], which are
+// "NAME=value" strings. With [keepConnection], the application keeps the
+// connection open after the request. Without [hasBody], the STDIN stream is
+// ended right away by an empty record; with it, the stream is left open for
+// the body of the request, see AppendStream.
+void
+AppendRequest(std::string &output, std::uint16_t requestID, const std::vector<std::string> &environment,
+			  bool keepConnection, bool hasBody = false) noexcept;
+
+} // namespace CGI::FastCGI
@@ -9,21 +9,46 @@
 namespace CGI {
 
 bool
-Manager::Load() {
-	scripts.insert({ std::string("/cgi"), { "/opt/test.sh", "Test CGI Script" } });
-	return true;
+Manager::Register(std::string route, Script script) {
+	if (!router.Insert(route, nullptr)) {
+		return false;
+	}
+
+	script.State = std::make_shared<Backend>(script.MaxConcurrency, script.Addresses);
+	const auto result = scripts.insert_or_assign(std::move(route), std::move(script));
+	return router.Insert(result.first->first, &result.first->second);
 }
 
 const Script *
 Manager::Lookup(const HTTP::Request &request) const noexcept {
-	auto iterator = scripts.find(request.path);
+	return router.Lookup(request.path);
+}
 
-	if (iterator == std::end(scripts)) {
-		return nullptr;
+Manager::StartStatus
+Manager::Forward(const Script &script, std::string &&head, bool headRequest, HTTP::BodyFraming framing,
+				 std::unique_ptr<Exchange> &exchange) const noexcept {
+	if (!script.State->Acquire()) {
+		return StartStatus::LIMIT_REACHED;
 	}
 
-	return &iterator->second;
+	exchange = StartProxy(script, std::move(head), headRequest, framing);
+	return exchange ? StartStatus::STARTED : StartStatus::FAILED;
 }
 
-} // namespace CGI
+Manager::StartStatus
+Manager::Start(const Script &script, const std::vector<std::string> &environment, HTTP::BodyFraming framing,
+			   std::unique_ptr<Exchange> &exchange) const noexcept {
+	if (!script.State->Acquire()) {
+		return StartStatus::LIMIT_REACHED;
+	}
 
+	if (script.Type == Protocol::FAST_CGI) {
+		exchange = StartFastCGI(script, environment, framing);
+	} else {
+		exchange = StartProcess(script, environment, framing);
+	}
+
+	return exchange ? StartStatus::STARTED : StartStatus::FAILED;
+}
+
+} // namespace CGI
@@ -6,9 +6,14 @@
  * See the COPYING file for licensing information.
  */
 
+#include <functional>
 #include <map>
+#include <memory>
 #include <string>
+#include <vector>
 
+#include "cgi/exchange.hpp"
+#include "cgi/router.hpp"
 #include "cgi/script.hpp"
 #include "http/request.hpp"
 
@@ -16,15 +21,44 @@ namespace CGI {
 
 class Manager {
 public:
+	enum class StartStatus {
+		STARTED,
+
+		// The script is already handling MaxConcurrency requests.
+		LIMIT_REACHED,
+
+		// The process couldn't be started, or the FastCGI application or
+		// the HTTP server couldn't be reached.
+		FAILED,
+	};
+
+	// Serves [script] for requests matching [route], see Router. Returns
+	// false if the route is malformed.
 	[[nodiscard]] bool
-	Load();
+	Register(std::string route, Script script);
 
-	// If ptr is nullptr, no CGI script was found.
+	// If ptr is nullptr, no CGI script was found. Lookup happens before the
+	// file system is consulted, so routed paths shadow files.
 	[[nodiscard]] const Script *
 	Lookup(const HTTP::Request &) const noexcept;
 
+	// Starts handling a request by a script returned by Lookup. If STARTED
+	// is returned, [exchange] is the running request, to which the body of
+	// the request is written, unless the [framing] is NONE.
+	[[nodiscard]] StartStatus
+	Start(const Script &, const std::vector<std::string> &environment, HTTP::BodyFraming framing,
+		  std::unique_ptr<Exchange> &exchange) const noexcept;
+
+	// The counterpart of Start for Protocol::HTTP scripts, which forwards
+	// the request with [head]. See CreateUpstreamRequest.
+	[[nodiscard]] StartStatus
+	Forward(const Script &, std::string &&head, bool headRequest, HTTP::BodyFraming framing,
+			std::unique_ptr<Exchange> &exchange) const noexcept;
+
 private:
-	std::map<std::string, Script> scripts;
+	// Owns the scripts, which the router refers to by route.
+	std::map<std::string, Script, std::less<>> scripts;
+	Router router;
 };
 
 } // namespace CGI
@@ -0,0 +1,403 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include "cgi/proxy.hpp"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+
+#include "http/body_reader.hpp"
+#include "http/configuration.hpp"
+#include "http/request.hpp"
+#include "http/utils.hpp"
+
+namespace CGI {
+
+using HTTP::Utils::EqualsIgnoreCase;
+
+[[nodiscard]] static std::string_view
+TrimWhitespace(std::string_view value) noexcept {
+	while (!value.empty() && (value.front() == ' ' || value.front() == '\t')) {
+		value.remove_prefix(1);
+	}
+	while (!value.empty() && (value.back() == ' ' || value.back() == '\t')) {
+		value.remove_suffix(1);
+	}
+	return value;
+}
+
+// Whether [name] is listed by a Connection field of [request], which makes
+// it a hop-by-hop field as well.
+[[nodiscard]] static bool
+IsConnectionOption(const HTTP::Request &request, std::string_view name) noexcept {
+	for (const auto &header : request.headers) {
+		if (!EqualsIgnoreCase(header.name, "Connection")) {
+			continue;
+		}
+
+		std::string_view options(header.value);
+		while (!options.empty()) {
+			const auto comma = options.find(',');
+			if (EqualsIgnoreCase(TrimWhitespace(options.substr(0, comma)), name)) {
+				return true;
+			}
+			options = comma == std::string_view::npos ? std::string_view() : options.substr(comma + 1);
+		}
+	}
+	return false;
+}
+
+// The fields that only apply to a single connection, which aren't forwarded.
+//
+// Spec: RFC 9110 § 7.6.1
+[[nodiscard]] static bool
+IsHopByHopField(std::string_view name) noexcept {
+	constexpr std::array<std::string_view, 8> names{
+		"Connection", "Keep-Alive", "Proxy-Connection", "TE", "Trailer", "Transfer-Encoding", "Upgrade",
+		"Proxy-Authorization"
+	};
+
+	return std::any_of(std::cbegin(names), std::cend(names), [name](std::string_view hopByHop) {
+		return EqualsIgnoreCase(name, hopByHop);
+	});
+}
+
+// Including the fields listed by the Connection field of [request].
+[[nodiscard]] static bool
+IsHopByHopField(const HTTP::Request &request, std::string_view name) noexcept {
+	return IsHopByHopField(name) || IsConnectionOption(request, name);
+}
+
+std::string
+CreateUpstreamRequest(const HTTP::Request &request, const HTTP::Configuration &configuration,
+					  std::string_view remoteAddress, const HTTP::BodyReader &body) {
+	std::string head;
+	head.append(request.method);
+	head.push_back(' ');
+	head.append(request.path);
+	if (!request.query.empty()) {
+		head.push_back('?');
+		head.append(request.query);
+	}
+	head.append(" HTTP/1.1\r\n");
+
+	std::string forwardedFor;
+	for (const auto &header : request.headers) {
+		// The framing of the body is added below.
+		if (IsHopByHopField(request, header.name) || EqualsIgnoreCase(header.name, "Content-Length") ||
+			EqualsIgnoreCase(header.name, "Expect") || EqualsIgnoreCase(header.name, "X-Forwarded-Proto")) {
+			continue;
+		}
+
+		if (EqualsIgnoreCase(header.name, "X-Forwarded-For")) {
+			forwardedFor.append(header.value);
+			forwardedFor.append(", ");
+			continue;
+		}
+
+		head.append(header.name);
+		head.append(": ");
+		head.append(header.value);
+		head.append("\r\n");
+	}
+
+	if (request.headers.Find(HTTP::HeaderID::HOST) == nullptr) {
+		head.append("Host: ");
+		head.append(configuration.hostname);
+		head.append("\r\n");
+	}
+
+	if (!remoteAddress.empty()) {
+		head.append("X-Forwarded-For: ");
+		head.append(forwardedFor);
+		head.append(remoteAddress);
+		head.append("\r\n");
+	}
+
+	head.append(configuration.useTransportSecurity ? "X-Forwarded-Proto: https\r\n" : "X-Forwarded-Proto: http\r\n");
+
+	if (body.Framing() == HTTP::BodyFraming::CONTENT_LENGTH) {
+		head.append("Content-Length: ");
+		head.append(std::to_string(body.ContentLength()));
+		head.append("\r\n");
+	} else if (body.Framing() == HTTP::BodyFraming::CHUNKED) {
+		head.append("Transfer-Encoding: chunked\r\n");
+	}
+
+	head.append("\r\n");
+	return head;
+}
+
+bool
+ProxyDecoder::CollectLine(std::string_view &input) noexcept {
+	const auto lineFeed = input.find('\n');
+	if (lineFeed == std::string_view::npos) {
+		pending.append(input);
+		input = {};
+		return false;
+	}
+
+	pending.append(input.substr(0, lineFeed));
+	input.remove_prefix(lineFeed + 1);
+	if (!pending.empty() && pending.back() == '\r') {
+		pending.pop_back();
+	}
+	return true;
+}
+
+ProxyDecoder::Status
+ProxyDecoder::Feed(std::string_view input, std::string &output) noexcept {
+	// The remains of the head, after an interim response.
+	std::string carry;
+
+	while (!input.empty()) {
+		switch (state) {
+			case State::HEAD: {
+				const auto searchStart = pending.length() < 3 ? 0 : pending.length() - 3;
+				pending.append(input);
+				input = {};
+
+				std::size_t end = std::string::npos;
+				std::size_t length = 0;
+				for (std::size_t i = searchStart; i < pending.length(); i++) {
+					if (pending[i] != '\n') {
+						continue;
+					}
+					if (i + 1 < pending.length() && pending[i + 1] == '\n') {
+						end = i + 2;
+						length = i + 1;
+						break;
+					}
+					if (i + 2 < pending.length() && pending[i + 1] == '\r' && pending[i + 2] == '\n') {
+						end = i + 3;
+						length = i + 1;
+						break;
+					}
+				}
+
+				if (end == std::string::npos) {
+					return pending.length() > maxHeadSize ? Status::FAILED : Status::INCOMPLETE;
+				}
+
+				if (!ParseHead(std::string_view(pending).substr(0, length), output)) {
+					return Status::FAILED;
+				}
+
+				carry = pending.substr(end);
+				pending.clear();
+				input = carry;
+			} break;
+			case State::BODY:
+			case State::CHUNK_DATA: {
+				const auto length = std::min(remaining, input.length());
+				output.append(input.substr(0, length));
+				input.remove_prefix(length);
+				remaining -= length;
+				if (remaining == 0) {
+					state = state == State::BODY ? State::DONE : State::CHUNK_END;
+				}
+			} break;
+			case State::CHUNK_SIZE: {
+				if (!CollectLine(input)) {
+					if (pending.length() > maxHeadSize) {
+						return Status::FAILED;
+					}
+					break;
+				}
+
+				// Spec: RFC 7230 § 4.1
+				// Chunk extensions are ignored.
+				const auto sizeEnd = std::find_if(std::cbegin(pending), std::cend(pending), [](char character) {
+					return character == ';' || character == ' ' || character == '\t';
+				});
+				const char *begin = pending.data();
+				const char *end = begin + (sizeEnd - std::cbegin(pending));
+				const auto result = std::from_chars(begin, end, remaining, 16);
+				if (begin == end || result.ec != std::errc{} || result.ptr != end) {
+					return Status::FAILED;
+				}
+
+				pending.clear();
+				state = remaining == 0 ? State::TRAILERS : State::CHUNK_DATA;
+			} break;
+			case State::CHUNK_END:
+				if (!CollectLine(input)) {
+					if (pending.length() > 1) {
+						return Status::FAILED;
+					}
+					break;
+				}
+				if (!pending.empty()) {
+					return Status::FAILED;
+				}
+				state = State::CHUNK_SIZE;
+				break;
+			case State::TRAILERS:
+				// Trailer fields aren't passed on.
+				if (!CollectLine(input)) {
+					if (pending.length() > maxHeadSize) {
+						return Status::FAILED;
+					}
+					break;
+				}
+				if (pending.empty()) {
+					state = State::DONE;
+				}
+				pending.clear();
+				break;
+			case State::UNTIL_CLOSE:
+				output.append(input);
+				input = {};
+				break;
+			case State::DONE:
+				// The server sent more than the response.
+				keepAlive = false;
+				input = {};
+				break;
+		}
+	}
+
+	return state == State::DONE ? Status::COMPLETE : Status::INCOMPLETE;
+}
+
+ProxyDecoder::Status
+ProxyDecoder::Finish() noexcept {
+	keepAlive = false;
+	if (state == State::UNTIL_CLOSE || state == State::DONE) {
+		state = State::DONE;
+		return Status::COMPLETE;
+	}
+	return Status::FAILED;
+}
+
+bool
+ProxyDecoder::ParseHead(std::string_view head, std::string &output) noexcept {
+	// Spec: RFC 7230 § 3.1.2
+	const auto firstLineEnd = head.find('\n');
+	auto statusLine = head.substr(0, firstLineEnd);
+	if (!statusLine.empty() && statusLine.back() == '\r') {
+		statusLine.remove_suffix(1);
+	}
+
+	if (statusLine.length() < 12 || statusLine.substr(0, 7) != "HTTP/1." ||
+		!HTTP::Utils::IsNumericCharacter(statusLine[7]) || statusLine[8] != ' ' ||
+		!std::all_of(std::cbegin(statusLine) + 9, std::cbegin(statusLine) + 12, HTTP::Utils::IsNumericCharacter) ||
+		(statusLine.length() > 12 && statusLine[12] != ' ')) {
+		return false;
+	}
+
+	const auto code = statusLine.substr(9, 3);
+
+	// Interim responses are followed by the final response. Upgrades aren't
+	// requested, so 101 (Switching Protocols) isn't expected.
+	if (code.front() == '1') {
+		return code != "101";
+	}
+
+	const auto outputLength = output.length();
+	output.append("Status: ");
+	output.append(statusLine.substr(9));
+	output.append("\r\n");
+
+	keepAlive = statusLine[7] == '1';
+	bool chunked = false;
+	bool hasTransferEncoding = false;
+	std::size_t contentLength = std::string::npos;
+
+	std::size_t start = firstLineEnd + 1;
+	while (start < head.length()) {
+		auto lineEnd = head.find('\n', start);
+		auto line = head.substr(start, lineEnd - start);
+		start = lineEnd + 1;
+		if (!line.empty() && line.back() == '\r') {
+			line.remove_suffix(1);
+		}
+
+		const auto colon = line.find(':');
+		if (colon == 0 || colon == std::string_view::npos) {
+			output.resize(outputLength);
+			return false;
+		}
+
+		const auto name = line.substr(0, colon);
+		const auto value = TrimWhitespace(line.substr(colon + 1));
+		if (!std::all_of(std::cbegin(name), std::cend(name), HTTP::Utils::IsTokenCharacter)) {
+			output.resize(outputLength);
+			return false;
+		}
+
+		if (EqualsIgnoreCase(name, "Connection")) {
+			// Spec: RFC 7230 § 6.1
+			std::size_t optionStart = 0;
+			while (optionStart <= value.length()) {
+				const auto optionEnd = std::min(value.find(',', optionStart), value.length());
+				if (EqualsIgnoreCase(TrimWhitespace(value.substr(optionStart, optionEnd - optionStart)), "close")) {
+					keepAlive = false;
+				}
+				optionStart = optionEnd + 1;
+			}
+			continue;
+		}
+
+		if (EqualsIgnoreCase(name, "Transfer-Encoding")) {
+			// Spec: RFC 7230 § 3.3.3
+			// Only a final chunked coding frames the body.
+			hasTransferEncoding = true;
+			const auto lastComma = value.rfind(',');
+			const auto last = TrimWhitespace(lastComma == std::string_view::npos ? value : value.substr(lastComma + 1));
+			chunked = EqualsIgnoreCase(last, "chunked");
+			continue;
+		}
+
+		if (EqualsIgnoreCase(name, "Content-Length")) {
+			std::size_t parsed = 0;
+			const auto result = std::from_chars(value.data(), value.data() + value.length(), parsed);
+			if (value.empty() || result.ec != std::errc{} || result.ptr != value.data() + value.length() ||
+				(contentLength != std::string::npos && contentLength != parsed)) {
+				output.resize(outputLength);
+				return false;
+			}
+			contentLength = parsed;
+			continue;
+		}
+
+		if (IsHopByHopField(name)) {
+			continue;
+		}
+
+		output.append(name);
+		output.append(": ");
+		output.append(value);
+		output.append("\r\n");
+	}
+
+	// Spec: RFC 7230 § 3.3.3
+	if (headRequest || code == "204" || code == "304") {
+		if (contentLength != std::string::npos && !hasTransferEncoding) {
+			output.append("Content-Length: ");
+			output.append(std::to_string(contentLength));
+			output.append("\r\n");
+		}
+		state = State::DONE;
+	} else if (chunked) {
+		state = State::CHUNK_SIZE;
+	} else if (hasTransferEncoding || contentLength == std::string::npos) {
+		keepAlive = false;
+		state = State::UNTIL_CLOSE;
+	} else {
+		output.append("Content-Length: ");
+		output.append(std::to_string(contentLength));
+		output.append("\r\n");
+		remaining = contentLength;
+		state = contentLength == 0 ? State::DONE : State::BODY;
+	}
+
+	output.append("\r\n");
+	return true;
+}
+
+} // namespace CGI
@@ -0,0 +1,115 @@
+#pragma once
+
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+/**
+ * The translation of requests to, and responses from HTTP/1.1 servers that
+ * requests are forwarded to, i.e. Protocol::HTTP.
+ */
+
+#include <string>
+#include <string_view>
+
+#include <cstddef>
+
+namespace HTTP {
+// From http/body_reader.hpp:
+class BodyReader;
+// From http/configuration.hpp:
+struct Configuration;
+// From http/request.hpp:
+struct Request;
+} // namespace HTTP
+
+namespace CGI {
+
+// Creates the head of the request forwarded to an upstream server. The
+// hop-by-hop fields are left out, including the ones the Connection field
+// lists, and X-Forwarded-For and X-Forwarded-Proto
+// are added. The framing of the [body] is kept, but an Expect field isn't
+// forwarded, since the server continues the request itself.
+//
+// Spec: RFC 7230 § 5.7, RFC 9110 § 7.6.1
+[[nodiscard]] std::string
+CreateUpstreamRequest(const HTTP::Request &request, const HTTP::Configuration &configuration,
+					  std::string_view remoteAddress, const HTTP::BodyReader &body);
+
+// Decodes the response of an upstream server into the output of a script,
+// i.e. a header section with a Status field, followed by the body without
+// the transfer coding. Interim (1xx) responses are skipped.
+class ProxyDecoder {
+public:
+	enum class Status {
+		INCOMPLETE,
+
+		// The response is complete.
+		COMPLETE,
+
+		// The response is malformed, or its head too large.
+		FAILED,
+	};
+
+	// The maximum size of the head of the response, and of a line of the
+	// chunked transfer coding.
+	static constexpr std::size_t maxHeadSize = 16 * 1024;
+
+	inline explicit
+	ProxyDecoder(bool headRequest) noexcept :
+		headRequest(headRequest) {
+	}
+
+	// Decodes the next part of the response, appending the output to
+	// [output].
+	[[nodiscard]] Status
+	Feed(std::string_view input, std::string &output) noexcept;
+
+	// Called when the server has closed the connection, which ends a body
+	// without framing.
+	[[nodiscard]] Status
+	Finish() noexcept;
+
+	// Whether the connection can be used for another request, once the
+	// response is complete.
+	[[nodiscard]] inline bool
+	KeepAlive() const noexcept {
+		return keepAlive;
+	}
+
+private:
+	enum class State {
+		HEAD,
+		BODY,
+		CHUNK_SIZE,
+		CHUNK_DATA,
+		CHUNK_END,
+		TRAILERS,
+
+		// The body ends when the connection is closed.
+		UNTIL_CLOSE,
+		DONE,
+	};
+
+	const bool headRequest;
+	bool keepAlive{ false };
+	State state{ State::HEAD };
+
+	// The part of the head, or of a line, that has been received.
+	std::string pending;
+	std::size_t remaining{ 0 };
+
+	// Appends the header section for [head], and selects the framing of the
+	// body. Returns false if the head is malformed.
+	[[nodiscard]] bool
+	ParseHead(std::string_view head, std::string &output) noexcept;
+
+	// Collects a line in 'pending'. Returns false if the line isn't complete
+	// yet, and removes what was collected from [input].
+	[[nodiscard]] bool
+	CollectLine(std::string_view &input) noexcept;
+};
+
+} // namespace CGI
@@ -0,0 +1,161 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include "cgi/response.hpp"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+
+#include "http/utils.hpp"
+
+namespace CGI {
+
+using HTTP::Utils::EqualsIgnoreCase;
+
+ResponseParser::Status
+ResponseParser::Feed(std::string_view input) noexcept {
+	if (status != Status::INCOMPLETE) {
+		return status;
+	}
+
+	// The blank line might start in a previous part.
+	const auto searchStart = head.length() < 3 ? 0 : head.length() - 3;
+	head.append(input);
+
+	const std::string_view view(head);
+	std::size_t end = std::string_view::npos;
+	std::size_t length = 0;
+	for (std::size_t i = searchStart; i < view.length(); i++) {
+		if (view[i] != '\n') {
+			continue;
+		}
+
+		if (i + 1 < view.length() && view[i + 1] == '\n') {
+			end = i + 2;
+			length = i + 1;
+			break;
+		}
+
+		if (i + 2 < view.length() && view[i + 1] == '\r' && view[i + 2] == '\n') {
+			end = i + 3;
+			length = i + 1;
+			break;
+		}
+	}
+
+	if (end == std::string_view::npos) {
+		if (head.length() > maxHeadSize) {
+			status = Status::FAILED;
+		}
+		return status;
+	}
+
+	bodyOffset = end;
+	status = Parse(length) ? Status::COMPLETE : Status::FAILED;
+	return status;
+}
+
+bool
+ResponseParser::Parse(std::size_t length) noexcept {
+	const std::string_view section(head.data(), length);
+	bool hasLocation = false;
+
+	std::size_t start = 0;
+	while (start < section.length()) {
+		auto lineEnd = section.find('\n', start);
+		auto line = section.substr(start, lineEnd - start);
+		start = lineEnd + 1;
+
+		if (!line.empty() && line.back() == '\r') {
+			line.remove_suffix(1);
+		}
+
+		const auto colon = line.find(':');
+		if (colon == 0 || colon == std::string_view::npos) {
+			return false;
+		}
+
+		const auto name = line.substr(0, colon);
+		auto value = line.substr(colon + 1);
+		while (!value.empty() && (value.front() == ' ' || value.front() == '\t')) {
+			value.remove_prefix(1);
+		}
+		while (!value.empty() && (value.back() == ' ' || value.back() == '\t')) {
+			value.remove_suffix(1);
+		}
+
+		if (!std::all_of(std::cbegin(name), std::cend(name), HTTP::Utils::IsTokenCharacter) ||
+			!std::all_of(std::cbegin(value), std::cend(value), HTTP::Utils::IsFieldValueCharacter)) {
+			return false;
+		}
+
+		// Spec: RFC 3875 § 6.3.3
+		if (EqualsIgnoreCase(name, "Status")) {
+			if (value.length() < 3 || !std::all_of(std::cbegin(value), std::cbegin(value) + 3,
+													HTTP::Utils::IsNumericCharacter) ||
+				(value.length() > 3 && value[3] != ' ')) {
+				return false;
+			}
+			statusLine = "HTTP/1.1 ";
+			statusLine.append(value);
+
+			// The reason phrase is optional, but the space before it isn't.
+			//
+			// Spec: RFC 9112 § 4
+			if (value.length() == 3) {
+				statusLine += ' ';
+			}
+			continue;
+		}
+
+		if (EqualsIgnoreCase(name, "Content-Length")) {
+			std::size_t parsed = 0;
+			const auto result = std::from_chars(value.data(), value.data() + value.length(), parsed);
+			if (result.ec != std::errc{} || result.ptr != value.data() + value.length()) {
+				return false;
+			}
+			contentLength = parsed;
+			continue;
+		}
+
+		// The framing of the message is up to the server.
+		if (EqualsIgnoreCase(name, "Connection") || EqualsIgnoreCase(name, "Keep-Alive") ||
+			EqualsIgnoreCase(name, "Transfer-Encoding")) {
+			continue;
+		}
+
+		// The server sends its own, see HTTP::CurrentDateHeader.
+		if (EqualsIgnoreCase(name, "Date")) {
+			continue;
+		}
+
+		hasLocation |= EqualsIgnoreCase(name, "Location");
+		fields.append(name);
+		fields.append(": ");
+		fields.append(value);
+		fields.append("\r\n");
+	}
+
+	// Spec: RFC 3875 § 6.2.3 and § 6.2.4
+	if (statusLine.empty()) {
+		statusLine = hasLocation ? "HTTP/1.1 302 Found" : "HTTP/1.1 200 OK";
+	}
+
+	return true;
+}
+
+void
+ResponseParser::Reset() noexcept {
+	head.clear();
+	statusLine.clear();
+	fields.clear();
+	contentLength = unknownContentLength;
+	bodyOffset = 0;
+	status = Status::INCOMPLETE;
+}
+
+} // namespace CGI
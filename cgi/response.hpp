@@ -0,0 +1,88 @@
+#pragma once
+
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include <string>
+#include <string_view>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace CGI {
+
+// Parses the header section a script starts its response with, which is
+// translated into the head of the HTTP response. The lines may end with LF
+// or CRLF.
+//
+// Spec: RFC 3875 § 6
+class ResponseParser {
+public:
+	enum class Status {
+		INCOMPLETE,
+		COMPLETE,
+
+		// The header section is malformed, or too large.
+		FAILED,
+	};
+
+	// The maximum size of the header section.
+	static constexpr std::size_t maxHeadSize = 16 * 1024;
+
+	// The value of ContentLength when the script didn't send a
+	// Content-Length field.
+	static constexpr std::size_t unknownContentLength = SIZE_MAX;
+
+	// Feeds the next part of the output of the script. Once the header
+	// section is complete, the part of the body after it is in Body.
+	[[nodiscard]] Status
+	Feed(std::string_view input) noexcept;
+
+	void
+	Reset() noexcept;
+
+	// The status line for the Status field of the script, or 200 (OK).
+	// A Location field without a Status field is a 302 (Found).
+	[[nodiscard]] inline std::string_view
+	StatusLine() const noexcept {
+		return statusLine;
+	}
+
+	// The fields to pass on to the client, each followed by a CRLF. The
+	// fields the server sends itself, e.g. Status and the hop-by-hop
+	// fields, are left out.
+	[[nodiscard]] inline std::string_view
+	Fields() const noexcept {
+		return fields;
+	}
+
+	[[nodiscard]] inline std::size_t
+	ContentLength() const noexcept {
+		return contentLength;
+	}
+
+	// The start of the body, which was fed together with the end of the
+	// header section.
+	[[nodiscard]] inline std::string_view
+	Body() const noexcept {
+		return std::string_view(head).substr(bodyOffset);
+	}
+
+private:
+	std::string head;
+	std::string statusLine;
+	std::string fields;
+	std::size_t contentLength{ unknownContentLength };
+	std::size_t bodyOffset{ 0 };
+	Status status{ Status::INCOMPLETE };
+
+	// Interprets the header section, i.e. the first [length] octets of
+	// 'head'.
+	[[nodiscard]] bool
+	Parse(std::size_t length) noexcept;
+};
+
+} // namespace CGI
@@ -0,0 +1,137 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include "cgi/router.hpp"
+
+#include <algorithm>
+#include <iterator>
+
+namespace CGI {
+
+Router::Router() noexcept :
+	root(std::make_unique<Node>()) {
+}
+
+Router::~Router() noexcept = default;
+
+Router::Node &
+Router::InsertLiteral(Node &node, std::string_view text) {
+	if (text.empty()) {
+		return node;
+	}
+
+	auto iterator = std::lower_bound(std::begin(node.children), std::end(node.children), text.front(),
+									 [](const auto &child, char character) {
+		return child->label.front() < character;
+	});
+
+	if (iterator == std::end(node.children) || (*iterator)->label.front() != text.front()) {
+		auto child = std::make_unique<Node>();
+		child->label = text;
+		auto &inserted = *child;
+		node.children.insert(iterator, std::move(child));
+		return inserted;
+	}
+
+	auto &child = **iterator;
+	const auto common = static_cast<std::size_t>(std::mismatch(std::cbegin(child.label), std::cend(child.label),
+															   std::cbegin(text), std::cend(text)).first -
+												 std::cbegin(child.label));
+
+	// The child is split at the end of the common prefix.
+	if (common < child.label.length()) {
+		auto split = std::make_unique<Node>();
+		split->label = child.label.substr(0, common);
+		child.label.erase(0, common);
+		split->children.push_back(std::move(*iterator));
+		*iterator = std::move(split);
+	}
+
+	return InsertLiteral(**iterator, text.substr(common));
+}
+
+bool
+Router::Insert(std::string_view route, const Script *script) {
+	if (route.empty() || route.front() != '/') {
+		return false;
+	}
+
+	Node *node = root.get();
+	while (true) {
+		const auto star = route.find('*');
+		if (star == std::string_view::npos) {
+			InsertLiteral(*node, route).exact = script;
+			return true;
+		}
+
+		// A '*' must be a whole segment.
+		if (route[star - 1] != '/' || (star + 1 < route.length() && route[star + 1] != '/')) {
+			return false;
+		}
+
+		node = &InsertLiteral(*node, route.substr(0, star));
+		route.remove_prefix(star + 1);
+
+		if (route.empty()) {
+			node->rest = script;
+			return true;
+		}
+
+		if (node->wildcard == nullptr) {
+			node->wildcard = std::make_unique<Node>();
+		}
+		node = node->wildcard.get();
+	}
+}
+
+const Script *
+Router::Lookup(std::string_view path) const noexcept {
+	return Match(*root, path, false);
+}
+
+const Script *
+Router::Match(const Node &node, std::string_view path, bool atSegmentStart) noexcept {
+	if (path.empty() && node.exact != nullptr) {
+		return node.exact;
+	}
+
+	if (!path.empty()) {
+		const auto iterator = std::lower_bound(std::cbegin(node.children), std::cend(node.children), path.front(),
+											   [](const auto &child, char character) {
+			return child->label.front() < character;
+		});
+
+		if (iterator != std::cend(node.children)) {
+			const auto &label = (*iterator)->label;
+			if (path.compare(0, label.length(), label) == 0) {
+				if (const auto *script = Match(**iterator, path.substr(label.length()), label.back() == '/')) {
+					return script;
+				}
+			} else if (label.length() == path.length() + 1 && label.back() == '/' &&
+					   path.compare(0, path.length(), label, 0, path.length()) == 0) {
+				// "/path" is matched by "/path/*" too.
+				return (*iterator)->rest;
+			}
+		}
+	}
+
+	if (!atSegmentStart) {
+		return nullptr;
+	}
+
+	if (node.wildcard != nullptr) {
+		const auto segmentEnd = std::min(path.find('/'), path.length());
+		if (segmentEnd != 0) {
+			if (const auto *script = Match(*node.wildcard, path.substr(segmentEnd), false)) {
+				return script;
+			}
+		}
+	}
+
+	return node.rest;
+}
+
+} // namespace CGI
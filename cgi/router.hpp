@@ -0,0 +1,73 @@
+#pragma once
+
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "cgi/script.hpp"
+
+namespace CGI {
+
+// Finds the script for the path of a request, with a radix tree of the
+// routes. A route is one of:
+// - "/path", which matches the path exactly;
+// - "/path/*", which matches every path below "/path/", including itself;
+// - "/users/*/profile", where a "*" segment matches any single segment.
+//
+// When several routes match, literal segments are preferred over "*"
+// segments, which are preferred over a trailing "*".
+class Router {
+public:
+	Router() noexcept;
+	~Router() noexcept;
+
+	Router(const Router &) = delete;
+	Router &operator=(const Router &) = delete;
+
+	// Makes [route] refer to [script], replacing a script it referred to.
+	// Returns false if the route doesn't start with a '/', or has a '*'
+	// that isn't a whole segment.
+	[[nodiscard]] bool
+	Insert(std::string_view route, const Script *script);
+
+	// Returns nullptr if no route matches [path].
+	[[nodiscard]] const Script *
+	Lookup(std::string_view path) const noexcept;
+
+private:
+	struct Node {
+		// The part of the path that leads to this node from its parent.
+		std::string label;
+
+		// Sorted by the first character of their labels, which differ.
+		std::vector<std::unique_ptr<Node>> children;
+
+		// The node after a "*" segment, whose label is empty.
+		std::unique_ptr<Node> wildcard;
+
+		// The script of the route that ends at this node, and of the route
+		// that ends with a "*" after this node.
+		const Script *exact{ nullptr };
+		const Script *rest{ nullptr };
+	};
+
+	std::unique_ptr<Node> root;
+
+	// Returns the node the literal [text] leads to from [node], creating and
+	// splitting nodes where needed.
+	[[nodiscard]] static Node &
+	InsertLiteral(Node &node, std::string_view text);
+
+	// Matches [path], the part after [node].
+	[[nodiscard]] static const Script *
+	Match(const Node &node, std::string_view path, bool atSegmentStart) noexcept;
+};
+
+} // namespace CGI
@@ -6,13 +6,65 @@
  * See the COPYING file for licensing information.
  */
 
+#include <chrono>
+#include <memory>
 #include <string>
+#include <vector>
+
+#include <cstddef>
 
 namespace CGI {
 
+// Forward-decl from exchange.hpp
+class Backend;
+
+// How the server talks to a script.
+enum class Protocol {
+	// A process is started for every request, with the request metadata in
+	// its environment and the response on its standard output.
+	//
+	// Spec: RFC 3875
+	CGI,
+
+	// The requests are sent to a long-running application over a socket,
+	// which is kept open for the next requests.
+	//
+	// Spec: https://fastcgi-archives.github.io/FastCGI_Specification.html
+	FAST_CGI,
+
+	// The requests are forwarded to HTTP/1.1 servers, i.e. the server acts
+	// as a reverse proxy.
+	//
+	// Spec: RFC 7230 § 2.3
+	HTTP,
+};
+
 struct Script {
+	// The executable for Protocol::CGI, or the SCRIPT_FILENAME passed to the
+	// application for Protocol::FAST_CGI. Unused for Protocol::HTTP.
 	std::string Command;
 	std::string Name;
+
+	Protocol Type{ Protocol::CGI };
+
+	// The addresses of the FastCGI applications or the HTTP servers, the
+	// requests are balanced over: paths of UNIX domain sockets, or numeric
+	// "host:port"s, e.g. "127.0.0.1:9000".
+	std::vector<std::string> Addresses;
+
+	// The maximum amount of requests handled by the script at the same time.
+	// Requests over the limit are answered with 503 (Service Unavailable).
+	// This is the amount of connections kept open per address as well.
+	std::size_t MaxConcurrency{ 16 };
+
+	// The time the script may take to produce its whole response. Requests
+	// without a response head by then are answered with 504 (Gateway
+	// Timeout), otherwise the connection is closed.
+	std::chrono::milliseconds Timeout{ 30000 };
+
+	// The state shared by the requests to this script. Set by
+	// Manager::Register.
+	std::shared_ptr<Backend> State;
 };
 
 } // namespace CGI
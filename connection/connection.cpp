@@ -8,6 +8,9 @@
 
 #define TLS_LIBRARY_OPENSSL
 
+#include <algorithm>
+#include <chrono>
+#include <iterator>
 #include <sstream>
 
 #include <cerrno>
@@ -15,8 +18,9 @@
 
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <arpa/inet.h>
 #include <netinet/tcp.h>
-#include <sys/ioctl.h>
+#include <sys/time.h>
 
 #if defined(__FreeBSD__)
 #include <sys/types.h>
@@ -36,40 +40,176 @@
 #endif
 
 #include "base/logger.hpp"
+#include "connection/reaper.hpp"
 #include "connection/security_internals.hpp"
 #include "http/configuration.hpp"
 #include "posix/fcntl.hpp"
+#include "posix/uio.hpp"
 #include "posix/unistd.hpp"
 
+// The maximum amount of segments of a single WriteBaseStrings call.
+#define MAGIC_WRITE_MAX_SEGMENTS 8
+
+// The maximum size of the plaintext of a TLS record (RFC 8446 section 5.1),
+// and thus the maximum amount of octets WriteBaseStrings coalesces into a
+// single SSL_write.
+#define MAGIC_TLS_RECORD_SIZE 16384
+
+// The size of the first TLS records of file data: small enough to fit in a
+// single TCP segment (an MSS of 1460, minus the TCP options and the record
+// overhead), so the peer doesn't have to wait for the rest of a record.
+#define MAGIC_TLS_SMALL_RECORD_SIZE 1400
+
+// The amount of small records sent before switching to full records, which
+// covers the initial congestion window of ten segments (RFC 6928).
+#define MAGIC_TLS_SMALL_RECORD_COUNT 10
+
+// After this amount of milliseconds without file data, the congestion window
+// has probably been reset (RFC 5681 section 4.1), and the records start out
+// small again.
+#define MAGIC_TLS_RECORD_IDLE_RESET 1000
+
 Connection::~Connection() noexcept {
-	if (hasWriteFailed) {
-		// TODO Make sure if the socket can be viewed as void.
-		// ... <<< NOTE no close() call
+	Close();
+}
+
+void
+Connection::Close() noexcept {
+	if (internalSocket == -1) {
 		return;
 	}
 
+	const int socket = internalSocket;
+	internalSocket = -1;
+
 	if (useTransportSecurity && securityContext != nullptr) {
 		ConnectionSecureInternals::Destruct(this);
+		securityContext = nullptr;
+	}
+
+	if (hasWriteFailed) {
+		// The rest of the response won't arrive anyway, so reset the
+		// connection, which releases the socket right away instead of retrying
+		// to send the unacknowledged octets.
+		struct linger abort { 1, 0 };
+		/* ignore-return-value */ setsockopt(socket, SOL_SOCKET, SO_LINGER, &abort, sizeof(abort));
+		/* ignore-return-value */ close(socket);
+		return;
+	}
+
+	// The kernel still sends the octets in the send queue after the sending
+	// side has been shut down, followed by a FIN. Until the peer has received
+	// them, the reaper discards what the peer sends, so the connection isn't
+	// reset when the socket is closed.
+	if (lingeringCloseTime == 0 || shutdown(socket, SHUT_WR) == -1) {
+		/* ignore-return-value */ close(socket);
+		return;
 	}
 
-	// This makes sure all data has been transferred before closing the
-	// connection. Clever solutions like poll(2), read(?, ' ', 1), etc. didn't
-	// work. Maybe non-blocking sockets solve it[?]
-	struct timespec sleepTime { 0, 100000 };
-	while (true) {
-		int value;
-		if (ioctl(internalSocket, TIOCOUTQ, &value) == -1 || value == 0) {
-			break;
+	ConnectionReaper::Instance().Adopt(socket, std::chrono::milliseconds(lingeringCloseTime));
+}
+
+Connection::Status
+Connection::ContinueSetup(const HTTP::Configuration &configuration) noexcept {
+	if (!setupStarted) {
+		setupStarted = true;
+		lingeringCloseTime = configuration.securityPolicies.maxLingeringCloseTime;
+
+		int i = 1;
+		if (setsockopt(internalSocket, IPPROTO_TCP, TCP_NODELAY, static_cast<void *>(&i), sizeof(i)) == -1) {
+			return Status::FAILED;
 		}
-		nanosleep(&sleepTime, nullptr);
+
+		if (useTransportSecurity &&
+			!ConnectionSecureInternals::Prepare(this, configuration)) {
+			return Status::FAILED;
+		}
+	}
+
+	if (!useTransportSecurity) {
+		return Status::COMPLETE;
+	}
+
+	return ConnectionSecureInternals::Handshake(this);
+}
+
+Connection::Status
+Connection::FlushSendBacklog() noexcept {
+	corked = false;
+	std::size_t off = 0;
+
+	while (off != sendBacklog.size()) {
+		ssize_t status = WriteSome(sendBacklog.data() + off, sendBacklog.size() - off);
+		if (status == -1) {
+			sendBacklog.erase(std::begin(sendBacklog), std::begin(sendBacklog) + off);
+			return wouldBlock ? Status::WOULD_BLOCK : Status::FAILED;
+		}
+
+		off += status;
+	}
+
+	sendBacklog.clear();
+	return Status::COMPLETE;
+}
+
+void
+Connection::Park() noexcept {
+	fileBuffer = nullptr;
+	if (sendBacklog.empty()) {
+		std::vector<char>().swap(sendBacklog);
+	}
+}
+
+void
+Connection::Reopen(int socket) noexcept {
+	Close();
+
+	internalSocket = socket;
+	peerAddress.clear();
+	receiveBegin = 0;
+	receiveEnd = 0;
+	sendBacklog.clear();
+	corked = false;
+	nonBlocking = false;
+	setupStarted = false;
+	wantsWrite = false;
+	wouldBlock = false;
+	hasWriteFailed = false;
+	lingeringCloseTime = 0;
+	smallRecordCount = 0;
+	lastFileChunk = {};
+
+	isLocalhost = false;
+#ifdef HTTP_SERVER_FORCE_IPV4
+	CheckLocalHostv4();
+#else
+	CheckLocalHostv6();
+#endif
+}
+
+bool
+Connection::SetReceiveTimeout(std::chrono::milliseconds timeout) noexcept {
+	struct timeval value{};
+	value.tv_sec = static_cast<time_t>(timeout.count() / 1000);
+	value.tv_usec = static_cast<suseconds_t>((timeout.count() % 1000) * 1000);
+	return setsockopt(internalSocket, SOL_SOCKET, SO_RCVTIMEO, &value, sizeof(value)) != -1;
+}
+
+bool
+Connection::SetNonBlocking() noexcept {
+	int flags = fcntl(internalSocket, F_GETFL);
+	if (flags == -1 || fcntl(internalSocket, F_SETFL, flags | O_NONBLOCK) == -1) {
+		return false;
 	}
 
-	/* ignore-return-value */ shutdown(internalSocket, SHUT_RDWR);
-	/* ignore-return-value */ close(internalSocket);
+	nonBlocking = true;
+	return true;
 }
 
 bool
 Connection::Setup(const HTTP::Configuration &configuration) noexcept {
+	lingeringCloseTime = configuration.securityPolicies.maxLingeringCloseTime;
+
 	int i = 1;
 	if (setsockopt(internalSocket, IPPROTO_TCP, TCP_NODELAY, static_cast<void *>(&i), sizeof(i)) == -1) {
 		return false;
@@ -83,25 +223,124 @@ Connection::Setup(const HTTP::Configuration &configuration) noexcept {
 	return true;
 }
 
-// TODO Make sure that using char isn't causing problems when it isn't 8-bits.
 bool
-Connection::ReadChar(char *buf) const noexcept {
-	if (buf == nullptr) {
-		return false;
+Connection::FillReceiveBuffer() noexcept {
+	if (receiveEnd == receiveBuffer.size()) {
+		if (receiveBegin == 0) {
+			return false;
+		}
+
+		// Move the unconsumed octets to the front, to make space at the end.
+		std::copy(std::begin(receiveBuffer) + receiveBegin,
+				  std::begin(receiveBuffer) + receiveEnd,
+				  std::begin(receiveBuffer));
+		receiveEnd -= receiveBegin;
+		receiveBegin = 0;
 	}
 
+	char *destination = receiveBuffer.data() + receiveEnd;
+	const std::size_t capacity = receiveBuffer.size() - receiveEnd;
+
+	wouldBlock = false;
+	wantsWrite = false;
+
+	ssize_t status;
 	if (useTransportSecurity) {
-		return ConnectionSecureInternals::ReadChar(this, buf);
+		status = ConnectionSecureInternals::Read(this, destination, capacity);
+	} else {
+		status = psx::read(internalSocket, destination, capacity);
+		wouldBlock = status == -1 && nonBlocking && (errno == EAGAIN || errno == EWOULDBLOCK);
+	}
+
+	// A status of zero means the end of the stream has been reached, i.e. the
+	// peer has closed the connection.
+	if (status <= 0) {
+		return false;
+	}
+
+	receiveEnd += status;
+	return true;
+}
+
+std::string_view
+Connection::NegotiatedProtocol() const noexcept {
+	if (!useTransportSecurity || securityContext == nullptr) {
+		return {};
 	}
 
-	return psx::read(internalSocket, buf, 1) != -1;
+	return ConnectionSecureInternals::NegotiatedProtocol(this);
+}
+
+const std::string &
+Connection::PeerAddress() const noexcept {
+	if (!peerAddress.empty()) {
+		return peerAddress;
+	}
+
+	struct sockaddr_storage address{};
+	socklen_t len = sizeof(address);
+	if (getpeername(internalSocket, reinterpret_cast<struct sockaddr *>(&address), &len) != 0) {
+		return peerAddress;
+	}
+
+	std::array<char, INET6_ADDRSTRLEN> buffer{};
+	const char *result = nullptr;
+	if (address.ss_family == AF_INET) {
+		const auto *ipv4 = reinterpret_cast<const struct sockaddr_in *>(&address);
+		result = inet_ntop(AF_INET, &ipv4->sin_addr, buffer.data(), buffer.size());
+	} else if (address.ss_family == AF_INET6) {
+		const auto *ipv6 = reinterpret_cast<const struct sockaddr_in6 *>(&address);
+		if (IN6_IS_ADDR_V4MAPPED(&ipv6->sin6_addr)) {
+			result = inet_ntop(AF_INET, &ipv6->sin6_addr.s6_addr[12], buffer.data(), buffer.size());
+		} else {
+			result = inet_ntop(AF_INET6, &ipv6->sin6_addr, buffer.data(), buffer.size());
+		}
+	}
+
+	if (result != nullptr) {
+		peerAddress = result;
+	}
+	return peerAddress;
+}
+
+std::size_t
+Connection::NextFileChunkSize() noexcept {
+	if (!useTransportSecurity) {
+		return MAGIC_TLS_RECORD_SIZE;
+	}
+
+	const auto now = std::chrono::steady_clock::now();
+	if (now - lastFileChunk > std::chrono::milliseconds(MAGIC_TLS_RECORD_IDLE_RESET)) {
+		smallRecordCount = 0;
+	}
+	lastFileChunk = now;
+
+	if (smallRecordCount < MAGIC_TLS_SMALL_RECORD_COUNT) {
+		smallRecordCount++;
+		return MAGIC_TLS_SMALL_RECORD_SIZE;
+	}
+
+	return MAGIC_TLS_RECORD_SIZE;
+}
+
+ssize_t
+Connection::ReadFileChunk(int fd, off_t offset, std::size_t remaining) noexcept {
+	if (fileBuffer == nullptr) {
+		// Not value-initialized, since it is overwritten by pread(2) anyway.
+		fileBuffer.reset(new char[MAGIC_TLS_RECORD_SIZE]);
+	}
+
+	return psx::pread(fd, fileBuffer.get(), std::min(NextFileChunkSize(), remaining), offset);
 }
 
 bool
-Connection::SendFile(int fd, std::size_t count) noexcept {
+Connection::SendFile(int fd, off_t offset, std::size_t count) noexcept {
+	if ((corked || !sendBacklog.empty()) && FlushSendBacklog() != Status::COMPLETE) {
+		return false;
+	}
+
 	if (useTransportSecurity) {
-		// TODO Use ktls for in-kernel TLS (= support for sendfile)
-		return ConnectionSecureInternals::SendFile(this, fd, count);
+		return ConnectionSecureInternals::SendFile(this, fd, offset, count);
 	}
 
 #if defined(__FreeBSD__)
@@ -114,16 +353,17 @@ Connection::SendFile(int fd, std::size_t count) noexcept {
 	// (off_t *) amount of bytes sent (useful for non-blocking)
 	// (int)     flags
 	// TODO
-	return sendfile(fd, internalSocket, 0, 0, nullptr, nullptr, 0) == 0;
+	return sendfile(fd, internalSocket, offset, count, nullptr, nullptr, 0) == 0;
 #elif defined(__linux__)
 	// Sendfile syscall
-	// (int/fd) dest
-	// (int/fd) src
-	// (*)      unused
-	// (size_t) count of bytes to rw
+	// (int/fd)   dest
+	// (int/fd)   src
+	// (off_t *)  offset in file, the file offset of [fd] isn't used, since
+	//            the file can be sent by multiple clients at once
+	// (size_t)   count of bytes to rw
 
 	while (count != 0) {
-		ssize_t status = sendfile64(internalSocket, fd, nullptr, count);
+		ssize_t status = sendfile64(internalSocket, fd, &offset, count);
 		if (status == -1) {
 			std::stringstream errorInfo;
 			errorInfo << "[Linux] Error occurred: " << status << " errno is: " << errno;
@@ -136,23 +376,136 @@ Connection::SendFile(int fd, std::size_t count) noexcept {
 
 	return true;
 #else
-	std::array<char, 4096> buffer {};
-	do {
-		ssize_t result = psx::read(fd, buffer.data(), 4096);
-		if (result == -1) {
+	while (count != 0) {
+		ssize_t result = ReadFileChunk(fd, offset, count);
+		if (result <= 0) {
 			return false;
 		}
+		offset += result;
 		count -= result;
-		do {
-			ssize_t writeResult = psx::write(internalSocket, buffer.data(), result);
+
+		for (const char *data = fileBuffer.get(); result != 0;) {
+			ssize_t writeResult = psx::write(internalSocket, data, result);
 			if (writeResult == -1) {
 				hasWriteFailed = true;
 				return false;
 			}
+			data += writeResult;
 			result -= writeResult;
-		} while (result != 0);
-	} while (count != 0);
+		}
+	}
+
+	return true;
+#endif
+}
+
+Connection::Status
+Connection::SendFileNonBlocking(int fd, off_t &offset, std::size_t &remaining) noexcept {
+	if (corked || !sendBacklog.empty()) {
+		const auto status = FlushSendBacklog();
+		if (status != Status::COMPLETE) {
+			return status;
+		}
+	}
+
+#if defined(__linux__)
+	if (!useTransportSecurity) {
+		while (remaining != 0) {
+			ssize_t status = sendfile64(internalSocket, fd, &offset, remaining);
+			if (status == -1) {
+				if (errno == EAGAIN || errno == EWOULDBLOCK) {
+					wantsWrite = true;
+					return Status::WOULD_BLOCK;
+				}
+
+				hasWriteFailed = true;
+				return Status::FAILED;
+			}
+
+			if (status == 0) {
+				// The file was truncated while sending it.
+				hasWriteFailed = true;
+				return Status::FAILED;
+			}
+
+			remaining -= status;
+		}
+
+		return Status::COMPLETE;
+	}
 #endif
+
+	// With kTLS, the kernel encrypts the file as it is sent.
+	if (useTransportSecurity && ConnectionSecureInternals::CanSendFile(this)) {
+		while (remaining != 0) {
+			const auto status = ConnectionSecureInternals::SendFileSome(this, fd, offset, remaining);
+			if (status == -1) {
+				if (wouldBlock) {
+					return Status::WOULD_BLOCK;
+				}
+
+				hasWriteFailed = true;
+				return Status::FAILED;
+			}
+
+			offset += status;
+			remaining -= status;
+		}
+
+		return Status::COMPLETE;
+	}
+
+	// Read the file in chunks, and let WriteBaseString put the octets that
+	// couldn't be written in the send backlog.
+	while (remaining != 0) {
+		ssize_t result = ReadFileChunk(fd, offset, remaining);
+		if (result <= 0) {
+			hasWriteFailed = true;
+			return Status::FAILED;
+		}
+
+		offset += result;
+		remaining -= result;
+
+		if (!WriteBaseString(base::String(fileBuffer.get(), result))) {
+			return Status::FAILED;
+		}
+
+		if (!sendBacklog.empty()) {
+			wantsWrite = true;
+			return Status::WOULD_BLOCK;
+		}
+	}
+
+	return Status::COMPLETE;
+}
+
+Connection::Status
+Connection::WriteBody(const char *&data, std::size_t &remaining) noexcept {
+	if (corked || !sendBacklog.empty()) {
+		const auto status = FlushSendBacklog();
+		if (status != Status::COMPLETE) {
+			return status;
+		}
+	}
+
+	while (remaining != 0) {
+		const auto length = useTransportSecurity ? std::min(NextFileChunkSize(), remaining) : remaining;
+		const ssize_t status = WriteSome(data, length);
+		if (status == -1) {
+			if (wouldBlock) {
+				return Status::WOULD_BLOCK;
+			}
+
+			hasWriteFailed = true;
+			return Status::FAILED;
+		}
+
+		data += status;
+		remaining -= status;
+	}
+
+	return Status::COMPLETE;
 }
 
 bool
@@ -160,15 +513,20 @@ Connection::WriteBaseString(const base::String &str) noexcept {
 	std::size_t off = 0;
 	std::size_t len = str.length();
 
+	if (AppendsToBacklog(len)) {
+		sendBacklog.insert(std::end(sendBacklog), std::cbegin(str), std::cend(str));
+		return true;
+	}
+
 	while (len != 0) {
-		ssize_t status;
-		if (useTransportSecurity) {
-			status = ConnectionSecureInternals::Write(this, str.data() + off, len);
-		} else {
-			status = psx::write(internalSocket, str.data() + off, len);
-		}
+		ssize_t status = WriteSome(str.data() + off, len);
 
 		if (status == -1) {
+			if (wouldBlock) {
+				sendBacklog.insert(std::end(sendBacklog), str.data() + off, str.data() + off + len);
+				return true;
+			}
+
 			hasWriteFailed = true;
 			return false;
 		}
@@ -180,6 +538,117 @@ Connection::WriteBaseString(const base::String &str) noexcept {
 	return true;
 }
 
+bool
+Connection::WriteBaseStrings(std::initializer_list<base::String> strings) noexcept {
+	std::size_t total = 0;
+	for (const auto &str : strings) {
+		total += str.length();
+	}
+
+	if (strings.size() > MAGIC_WRITE_MAX_SEGMENTS ||
+		(useTransportSecurity && total > MAGIC_TLS_RECORD_SIZE)) {
+		return std::all_of(std::begin(strings), std::end(strings), [this](const auto &str) {
+			return WriteBaseString(str);
+		});
+	}
+
+	if (AppendsToBacklog(total)) {
+		for (const auto &str : strings) {
+			sendBacklog.insert(std::end(sendBacklog), std::cbegin(str), std::cend(str));
+		}
+		return true;
+	}
+
+	if (useTransportSecurity) {
+		// OpenSSL produces a record per SSL_write, so coalesce the strings.
+		std::array<char, MAGIC_TLS_RECORD_SIZE> buffer;
+		auto *end = buffer.data();
+		for (const auto &str : strings) {
+			end = std::copy(std::cbegin(str), std::cend(str), end);
+		}
+		return WriteBaseString(base::String(buffer.data(), total));
+	}
+
+	std::array<struct iovec, MAGIC_WRITE_MAX_SEGMENTS> vectors;
+	std::size_t count = 0;
+	for (const auto &str : strings) {
+		if (str.length() != 0) {
+			vectors[count++] = { const_cast<char *>(str.data()), str.length() };
+		}
+	}
+
+	struct iovec *vector = vectors.data();
+	while (count != 0) {
+		wouldBlock = false;
+		wantsWrite = false;
+
+		ssize_t status = psx::writev(internalSocket, vector, static_cast<int>(count));
+		if (status == -1) {
+			if (nonBlocking && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+				wouldBlock = true;
+				wantsWrite = true;
+				for (; count != 0; vector++, count--) {
+					const auto *base = static_cast<const char *>(vector->iov_base);
+					sendBacklog.insert(std::end(sendBacklog), base, base + vector->iov_len);
+				}
+				return true;
+			}
+
+			hasWriteFailed = true;
+			return false;
+		}
+
+		// Skip the vectors that have been written completely.
+		auto written = static_cast<std::size_t>(status);
+		while (count != 0 && written >= vector->iov_len) {
+			written -= vector->iov_len;
+			vector++;
+			count--;
+		}
+
+		if (count != 0) {
+			vector->iov_base = static_cast<char *>(vector->iov_base) + written;
+			vector->iov_len -= written;
+		}
+	}
+
+	return true;
+}
+
+bool
+Connection::AppendsToBacklog(std::size_t length) noexcept {
+	if (corked) {
+		if (sendBacklog.size() + length <= corkedBacklogSize) {
+			return true;
+		}
+
+		// When the backlog couldn't be written completely, the octets still
+		// can't overtake it.
+		return FlushSendBacklog() != Status::COMPLETE;
+	}
+
+	return nonBlocking && !sendBacklog.empty();
+}
+
+ssize_t
+Connection::WriteSome(const char *data, std::size_t length) noexcept {
+	wouldBlock = false;
+	wantsWrite = false;
+
+	if (useTransportSecurity) {
+		int status = ConnectionSecureInternals::Write(this, data, length);
+		return status <= 0 ? -1 : status;
+	}
+
+	ssize_t status = psx::write(internalSocket, data, length);
+	if (status == -1 && nonBlocking && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+		wouldBlock = true;
+		wantsWrite = true;
+	}
+
+	return status;
+}
+
 
 
 void
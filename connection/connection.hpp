@@ -6,9 +6,18 @@
  * See the COPYING file for licensing information.
  */
 
+#include <array>
+#include <chrono>
+#include <initializer_list>
 #include <iosfwd>
 #include <iostream>
+#include <memory>
 #include <string>
+#include <string_view>
+#include <vector>
+
+#include <cstddef>
+#include <sys/types.h>
 
 #include "base/string.hpp"
 
@@ -34,10 +43,99 @@ public:
 	}
 #endif /* CONNECTION_MEMORY_VARIANT */
 
+	// Closes the connection, see Close.
 	~Connection() noexcept;
 
-	// Will read a single character from the source, either directly from the
-	// socket or from the TLS wrapper.
+	// Closes the connection, once. The sending side is shut down, and the
+	// socket is closed by the reaper (see connection/reaper.hpp) once the
+	// peer has received everything.
+	void
+	Close() noexcept;
+
+	// Prepares this closed connection for a new connection on [socket], like
+	// constructing it does, but the buffers are kept, so they don't have to
+	// be allocated again.
+	void
+	Reopen(int socket) noexcept;
+
+	// The outcome of an operation on a non-blocking connection.
+	enum class Status {
+		// The operation has been completed.
+		COMPLETE,
+
+		// The operation couldn't be completed without blocking. It should be
+		// continued once the socket is ready (see WantsWrite).
+		WOULD_BLOCK,
+
+		// The connection has been closed, or a catastrophic failure has
+		// occurred.
+		FAILED,
+	};
+
+	// The amount of octets the receive buffer can hold. The source is read in
+	// chunks of at most this size, instead of a read for every octet.
+	static constexpr std::size_t receiveBufferSize = 8192;
+
+	// The amount of octets a corked connection gathers in the send backlog at
+	// most, see Cork.
+	static constexpr std::size_t corkedBacklogSize = 65536;
+
+	// Until the send backlog is flushed, the written strings are gathered in
+	// the send backlog instead of being written, so the responses to
+	// pipelined requests can be sent together with a single write. Flushing
+	// happens when the backlog would grow beyond corkedBacklogSize, and
+	// before a body is sent.
+	inline void
+	Cork() noexcept {
+		corked = true;
+	}
+
+	// Will consume the received octets: the next call to Peek() won't include
+	// the first [count] octets anymore.
+	//
+	// NOTE: [count] must not be larger than Peek().length().
+	inline void
+	Consume(std::size_t count) noexcept {
+		receiveBegin += count;
+		if (receiveBegin == receiveEnd) {
+			receiveBegin = 0;
+			receiveEnd = 0;
+		}
+	}
+
+	// Returns the octets that have been received but not consumed yet,
+	// without reading from the source.
+	[[nodiscard]] inline base::String
+	Buffered() const noexcept {
+		return { receiveBuffer.data() + receiveBegin, receiveEnd - receiveBegin };
+	}
+
+	// Reads as many octets as possible from the source, either directly from
+	// the socket or from the TLS wrapper, into the free space of the receive
+	// buffer. Octets that were received but not consumed yet are kept.
+	//
+	// Returns false if the read wasn't succesful, i.e. the connection has been
+	// closed, a catastrophic failure has occurred, or the receive buffer is
+	// full.
+	[[nodiscard]] bool
+	FillReceiveBuffer() noexcept;
+
+	// Returns the octets that have been received but not consumed yet. If
+	// there are none, the receive buffer will be filled first.
+	//
+	// An empty string means that the receive buffer couldn't be filled (see
+	// FillReceiveBuffer).
+	[[nodiscard]] inline base::String
+	Peek() noexcept {
+		if (receiveBegin == receiveEnd && !FillReceiveBuffer()) {
+			return { receiveBuffer.data(), 0 };
+		}
+
+		return { receiveBuffer.data() + receiveBegin, receiveEnd - receiveBegin };
+	}
+
+	// Will read a single character from the receive buffer, which is filled
+	// from the source if needed.
 	//
 	// This function, being part of the network stack, can fail. There can be
 	// many reasons for failure, but in general it means that the connection
@@ -49,11 +147,97 @@ public:
 	// NOTE: If the [bool] return value is false, the value of [char *] is
 	// undefined.
 	// NOTE: If [char *] is nullptr, false is always returned.
+	[[nodiscard]] inline bool
+	ReadChar(char *buf) noexcept {
+		if (buf == nullptr) {
+			return false;
+		}
+
+		if (receiveBegin == receiveEnd && !FillReceiveBuffer()) {
+			return false;
+		}
+
+		*buf = receiveBuffer[receiveBegin];
+		Consume(1);
+		return true;
+	}
+
+	[[nodiscard]] bool
+	SendFile(int fd, off_t offset, std::size_t count) noexcept;
+
+	// Sends [remaining] octets of the file, starting at [offset], for
+	// non-blocking connections. Stops when the socket would block, in which
+	// case [offset] and [remaining] describe the part that is yet to be sent.
+	[[nodiscard]] Status
+	SendFileNonBlocking(int fd, off_t &offset, std::size_t &remaining) noexcept;
+
+	// Writes [remaining] octets of [data], a response body in memory like a
+	// mapped file. Unlike WriteBaseString, the octets aren't copied into the
+	// send backlog: non-blocking connections stop when the socket would
+	// block, in which case [data] and [remaining] describe the part that is
+	// yet to be written. TLS records are sized like those of files.
+	[[nodiscard]] Status
+	WriteBody(const char *&data, std::size_t &remaining) noexcept;
+
+	// Continues the setup of a non-blocking connection, i.e. the TLS
+	// handshake. Should be called again when the socket is ready, until it
+	// doesn't return Status::WOULD_BLOCK anymore.
+	//
+	// The first call will also do what Setup does for blocking connections.
+	[[nodiscard]] Status
+	ContinueSetup(const HTTP::Configuration &) noexcept;
+
+	// Octets that couldn't be written without blocking are kept in the send
+	// backlog. Tries to write those octets.
+	[[nodiscard]] Status
+	FlushSendBacklog() noexcept;
+
+	// Releases the buffers that are only needed while a response is being
+	// sent, since the connection is idle. They're allocated again when the
+	// next response needs them.
+	void
+	Park() noexcept;
+
+	// Makes blocking reads fail once no octets have been received for
+	// [timeout], which is used by the thread-per-client serving mode.
+	//
+	// Returns success status
 	[[nodiscard]] bool
-	ReadChar(char *) const noexcept;
+	SetReceiveTimeout(std::chrono::milliseconds timeout) noexcept;
 
+	// Puts the socket in non-blocking mode, which is used by the event-driven
+	// serving mode. Writes on a non-blocking connection never block, but are
+	// put in the send backlog instead. Reads fail if no octets are available,
+	// in which case WouldBlock() returns true.
+	//
+	// Returns success status
 	[[nodiscard]] bool
-	SendFile(int fd, std::size_t count) noexcept;
+	SetNonBlocking() noexcept;
+
+	[[nodiscard]] inline bool
+	HasSendBacklog() const noexcept {
+		return !sendBacklog.empty();
+	}
+
+	[[nodiscard]] inline std::size_t
+	SendBacklogSize() const noexcept {
+		return sendBacklog.size();
+	}
+
+	// When the last operation would block, returns whether it needs the
+	// socket to be writable (as opposed to readable). E.g. a TLS read might
+	// need to write.
+	[[nodiscard]] inline bool
+	WantsWrite() const noexcept {
+		return wantsWrite;
+	}
+
+	// When the last read failed, returns whether it failed because no octets
+	// were available on a non-blocking connection, i.e. it would block.
+	[[nodiscard]] inline bool
+	WouldBlock() const noexcept {
+		return wouldBlock;
+	}
 
 	// Will setup the connection. If the configuration specifies the use of TLS,
 	// it will setup this as well.
@@ -73,11 +257,31 @@ public:
 	[[nodiscard]] bool
 	WriteBaseString(const base::String &) noexcept;
 
+	// Writes the contents of the strings in order, like calling
+	// WriteBaseString for each string, but with a single writev(2), or a
+	// single TLS record if they fit in one. Small responses can therefore be
+	// sent in a single packet.
+	//
+	// Returns success status
+	[[nodiscard]] bool
+	WriteBaseStrings(std::initializer_list<base::String>) noexcept;
+
 	[[nodiscard]] inline constexpr bool
 	IsLocalhost() const noexcept {
 		return isLocalhost;
 	}
 
+	// The protocol selected with ALPN during the TLS handshake, e.g. "h2", or
+	// an empty string if none was.
+	[[nodiscard]] std::string_view
+	NegotiatedProtocol() const noexcept;
+
+	// The numeric address of the peer, e.g. "192.0.2.1", or an empty string
+	// if it couldn't be retrieved. IPv4-mapped IPv6 addresses are written as
+	// IPv4 addresses. The address is retrieved once per connection.
+	[[nodiscard]] const std::string &
+	PeerAddress() const noexcept;
+
 	// Is used by memory_connection.hpp but isn't used in the normal
 	// implementation.
 	void *userData;
@@ -87,19 +291,78 @@ public:
 
 	bool isLocalhost{ false };
 
+#ifndef CONNECTION_ALLOW_EXTENDED_VISIBILITY
+private:
+#endif
+	// NOTE These members are accessed by inline functions, and are therefore
+	// placed before the variant-specific members, so the memory variant and
+	// the normal variant agree on their location.
+	std::array<char, receiveBufferSize> receiveBuffer;
+	std::size_t receiveBegin{ 0 };
+	std::size_t receiveEnd{ 0 };
+
+	std::vector<char> sendBacklog{};
+	bool corked{ false };
+	bool nonBlocking{ false };
+	bool setupStarted{ false };
+	bool wantsWrite{ false };
+	bool wouldBlock{ false };
+
+public:
 	#ifndef CONNECTION_MEMORY_VARIANT
 #ifndef CONNECTION_ALLOW_EXTENDED_VISIBILITY
 private:
 #endif
 	bool hasWriteFailed{ false };
-	const int internalSocket;
+	int internalSocket;
 	const bool useTransportSecurity;
+
+	// See PeerAddress. Empty until it is retrieved.
+	mutable std::string peerAddress;
+
+	// Security::Policies::maxLingeringCloseTime, see the destructor.
+	std::size_t lingeringCloseTime{ 0 };
+
+	// The buffer files are read into when they can't be sent with
+	// sendfile(2), allocated on first use. See ReadFileChunk.
+	std::unique_ptr<char[]> fileBuffer;
+
+	// The amount of small TLS records of file data that have been sent since
+	// the connection was last idle, and when the last one was sent. See
+	// NextFileChunkSize.
+	std::size_t smallRecordCount{ 0 };
+	std::chrono::steady_clock::time_point lastFileChunk{};
+
+	// Returns the amount of octets of a file to put in the next write. For
+	// TLS, this is the size of the next record: records start out small, so
+	// the peer can decrypt them as soon as they arrive, and grow to the
+	// maximum size once the congestion window has opened up.
+	[[nodiscard]] std::size_t
+	NextFileChunkSize() noexcept;
+
+	// Reads the next chunk of at most [remaining] octets of [fd] at [offset]
+	// into 'fileBuffer'. Returns the result of pread(2).
+	[[nodiscard]] ssize_t
+	ReadFileChunk(int fd, off_t offset, std::size_t remaining) noexcept;
 #endif /* CONNECTION_MEMORY_VARIANT */
 
 private:
+	// Whether [length] octets that are about to be written should be put in
+	// the send backlog: octets can't overtake the octets that are already in
+	// it, and a corked connection gathers them. If a corked backlog would
+	// grow too large, it is flushed first.
+	[[nodiscard]] bool
+	AppendsToBacklog(std::size_t length) noexcept;
+
 	void
 	CheckLocalHostv4() noexcept;
 
+	// Writes at most [length] octets, returning the amount of octets written
+	// or -1 on failure. When the failure was because the write would block,
+	// wouldBlock is set.
+	[[nodiscard]] ssize_t
+	WriteSome(const char *data, std::size_t length) noexcept;
+
 	void
 	CheckLocalHostv6() noexcept;
 };
@@ -20,6 +20,8 @@
 
 #include "connection/connection.hpp"
 
+#include <algorithm>
+#include <iterator>
 #include <vector>
 
 #include <unistd.h>
@@ -29,12 +31,44 @@
 Connection::~Connection() noexcept {
 }
 
+void
+Connection::Close() noexcept {
+}
+
+void
+Connection::Reopen(int) noexcept {
+	receiveBegin = 0;
+	receiveEnd = 0;
+	sendBacklog.clear();
+	corked = false;
+	nonBlocking = false;
+	setupStarted = false;
+	wantsWrite = false;
+	wouldBlock = false;
+}
+
 bool
 Connection::Setup(const HTTP::Configuration & /* configuration */) noexcept {
 	isLocalhost = true;
 	return true;
 }
 
+Connection::Status
+Connection::ContinueSetup(const HTTP::Configuration &configuration) noexcept {
+	return Setup(configuration) ? Status::COMPLETE : Status::FAILED;
+}
+
+std::string_view
+Connection::NegotiatedProtocol() const noexcept {
+	return {};
+}
+
+const std::string &
+Connection::PeerAddress() const noexcept {
+	static const std::string none;
+	return none;
+}
+
 void
 Connection::CheckLocalHostv4() noexcept {
 }
@@ -43,21 +77,73 @@ void
 Connection::CheckLocalHostv6() noexcept {
 }
 
+// The input vector is stored in reverse order, i.e. the back of the vector is
+// the first character to be read.
 bool
-Connection::ReadChar(char *buf) const noexcept {
+Connection::FillReceiveBuffer() noexcept {
 	auto *internalData = reinterpret_cast<MemoryUserData *>(userData);
 
 	if (internalData->input.empty()) {
 		return false;
 	}
 
-	*buf = internalData->input.back();
-	internalData->input.pop_back();
+	if (receiveEnd == receiveBuffer.size()) {
+		if (receiveBegin == 0) {
+			return false;
+		}
+
+		std::copy(std::begin(receiveBuffer) + receiveBegin,
+				  std::begin(receiveBuffer) + receiveEnd,
+				  std::begin(receiveBuffer));
+		receiveEnd -= receiveBegin;
+		receiveBegin = 0;
+	}
+
+	while (receiveEnd != receiveBuffer.size() && !internalData->input.empty()) {
+		receiveBuffer[receiveEnd++] = internalData->input.back();
+		internalData->input.pop_back();
+	}
+
 	return true;
 }
 
+Connection::Status
+Connection::FlushSendBacklog() noexcept {
+	corked = false;
+	return Status::COMPLETE;
+}
+
+void
+Connection::Park() noexcept {
+	if (sendBacklog.empty()) {
+		std::vector<char>().swap(sendBacklog);
+	}
+}
+
 bool
-Connection::SendFile(int fd, std::size_t count) noexcept {
+Connection::SetReceiveTimeout(std::chrono::milliseconds) noexcept {
+	return true;
+}
+
+bool
+Connection::SetNonBlocking() noexcept {
+	nonBlocking = true;
+	return true;
+}
+
+Connection::Status
+Connection::SendFileNonBlocking(int fd, off_t &offset, std::size_t &remaining) noexcept {
+	if (!SendFile(fd, offset, remaining)) {
+		return Status::FAILED;
+	}
+
+	offset += static_cast<off_t>(remaining);
+	remaining = 0;
+	return Status::COMPLETE;
+}
+
+bool
+Connection::SendFile(int fd, off_t fileOffset, std::size_t count) noexcept {
 	auto *internalData = reinterpret_cast<MemoryUserData *>(userData);
 
 	if (!internalData->writeSendFile) {
@@ -68,13 +154,14 @@ Connection::SendFile(int fd, std::size_t count) noexcept {
 	internalData->output.reserve(offset + count);
 
 	do {
-		ssize_t result = read(fd, internalData->output.data() + offset, count);
+		ssize_t result = pread(fd, internalData->output.data() + offset, count, fileOffset);
 
 		if (result == -1) {
 			return false;
 		}
 
 		offset += result;
+		fileOffset += result;
 		count -= result;
 	} while (count != 0);
 
@@ -89,3 +176,25 @@ Connection::WriteBaseString(const base::String &str) noexcept {
 
 	return true;
 }
+
+Connection::Status
+Connection::WriteBody(const char *&data, std::size_t &remaining) noexcept {
+	if (!WriteBaseString(base::String(data, remaining))) {
+		return Status::FAILED;
+	}
+
+	data += remaining;
+	remaining = 0;
+	return Status::COMPLETE;
+}
+
+bool
+Connection::WriteBaseStrings(std::initializer_list<base::String> strings) noexcept {
+	for (const auto &str : strings) {
+		if (!WriteBaseString(str)) {
+			return false;
+		}
+	}
+
+	return true;
+}
@@ -8,7 +8,6 @@
 
 #include "security_internals.hpp"
 
-#include <array>
 #include <sstream>
 
 #include <cstdio>
@@ -19,6 +18,7 @@
 
 #include "base/logger.hpp"
 #include "connection/connection.hpp"
+#include "security/tls_session_cache.hpp"
 
 //////////////////////////////////////////////////////////////////////
 // To enable OpenSSL debug information, enable the following macro: //
@@ -38,18 +38,34 @@ ConnectionSecureInternals::Destruct(Connection *connection) {
 	auto *ssl = reinterpret_cast<SSL *>(connection->securityContext);
 	SSL_shutdown(ssl);
 	SSL_free(ssl);
+
+	// A connection that ended without a close_notify leaves its errors in
+	// the queue of the thread, where SSL_get_error would find them for the
+	// next connection, failing its first read.
+	ERR_clear_error();
 }
 
 bool
 ConnectionSecureInternals::Setup(Connection *connection, const HTTP::Configuration &configuration) {
-	auto *ssl = SSL_new(reinterpret_cast<SSL_CTX *>(configuration.tlsConfiguration.context));
+	return Prepare(connection, configuration) &&
+		   Handshake(connection) == Connection::Status::COMPLETE;
+}
+
+bool
+ConnectionSecureInternals::Prepare(Connection *connection, const HTTP::Configuration &configuration) {
+	// The context might be replaced in the meantime, see
+	// Security::TLSConfiguration::CreateContext. The connection holds a
+	// reference to it until it is freed.
+	auto *context = configuration.tlsConfiguration.AcquireContext();
+	auto *ssl = SSL_new(reinterpret_cast<SSL_CTX *>(context));
+	Security::TLSConfiguration::ReleaseContext(context);
 	connection->securityContext = ssl;
 
 	if (ssl == nullptr) {
 #ifdef TLSIMPL_ENABLE_DEBUG_INFORMATION
 		ERR_print_errors_fp(stderr);
 		std::stringstream error;
-		error << "SSL_new failed. TLS context is " << configuration.tlsConfiguration.context;
+		error << "SSL_new failed. TLS context is " << context;
 		Logger::Error("CSI[OSSL]::Setup", error.str());
 #endif
 		return false;
@@ -63,64 +79,171 @@ ConnectionSecureInternals::Setup(Connection *connection, const HTTP::Configurati
 		return false;
 	}
 
+	if (connection->nonBlocking) {
+		// When SSL_write would block, the send backlog will retry the write
+		// from a different location.
+		SSL_set_mode(ssl, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+	}
+
+	return true;
+}
+
+// Updates the blocking state of the connection after a failed SSL_* call.
+// Returns whether or not the call failed because it would block.
+static bool
+CheckWouldBlock(Connection *connection, int status) {
+	switch (SSL_get_error(reinterpret_cast<SSL *>(connection->securityContext), status)) {
+		case SSL_ERROR_WANT_READ:
+			connection->wouldBlock = true;
+			connection->wantsWrite = false;
+			return true;
+		case SSL_ERROR_WANT_WRITE:
+			connection->wouldBlock = true;
+			connection->wantsWrite = true;
+			return true;
+		default:
+			connection->wouldBlock = false;
+			return false;
+	}
+}
+
+Connection::Status
+ConnectionSecureInternals::Handshake(Connection *connection) {
+	auto *ssl = reinterpret_cast<SSL *>(connection->securityContext);
+
+	// SSL_get_error inspects the error queue of the thread, which can hold
+	// errors of another connection, e.g. when the handshake is offloaded.
+	ERR_clear_error();
+
 	int status = SSL_accept(ssl);
 	if (status != 1) {
+		if (CheckWouldBlock(connection, status)) {
+			return Connection::Status::WOULD_BLOCK;
+		}
 #ifdef TLSIMPL_ENABLE_DEBUG_INFORMATION
 		ERR_print_errors_fp(stderr);
 		LogDescriptiveError(ssl, status, "CSI[OSSL]::Setup", "setup TLS communication");
 #endif
-		return false;
+		return Connection::Status::FAILED;
 	}
 
 	status = SSL_do_handshake(ssl);
 	if (status != 1) {
+		if (CheckWouldBlock(connection, status)) {
+			return Connection::Status::WOULD_BLOCK;
+		}
 #ifdef TLSIMPL_ENABLE_DEBUG_INFORMATION
 			ERR_print_errors_fp(stderr);
 			LogDescriptiveError(ssl, status, "CSI[OSSL]::Setup", "perform TLS handshake");
 #endif
-		return false;
+		return Connection::Status::FAILED;
 	}
 
-	return true;
+	if (auto *cache = Security::TLSSessionCache::Of(SSL_get_SSL_CTX(ssl))) {
+		cache->RecordHandshake(SSL_session_reused(ssl) == 1);
+	}
+
+	return Connection::Status::COMPLETE;
 }
 
-bool
-ConnectionSecureInternals::ReadChar(const Connection *connection, char *buf) {
-	auto status = SSL_read(reinterpret_cast<SSL *>(connection->securityContext), buf, 1);
+std::string_view
+ConnectionSecureInternals::NegotiatedProtocol(const Connection *connection) {
+	const unsigned char *protocol;
+	unsigned int length;
+	SSL_get0_alpn_selected(reinterpret_cast<const SSL *>(connection->securityContext), &protocol, &length);
+	return { reinterpret_cast<const char *>(protocol), length };
+}
 
-	if (status == 1) {
-		return true;
+int
+ConnectionSecureInternals::Read(Connection *connection, char *buf, std::size_t len) {
+	auto status = SSL_read(reinterpret_cast<SSL *>(connection->securityContext), buf, len);
+
+	if (status <= 0 && !CheckWouldBlock(connection, status)) {
+		ERR_print_errors_fp(stderr);
 	}
 
-	ERR_print_errors_fp(stderr);
+	return status;
+}
+
+bool
+ConnectionSecureInternals::CanSendFile(Connection *connection) {
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+	return BIO_get_ktls_send(SSL_get_wbio(reinterpret_cast<SSL *>(connection->securityContext)));
+#else
+	static_cast<void>(connection);
 	return false;
+#endif
+}
+
+ssize_t
+ConnectionSecureInternals::SendFileSome(Connection *connection, int fd, off_t offset, std::size_t count) {
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+	const auto status = SSL_sendfile(reinterpret_cast<SSL *>(connection->securityContext), fd, offset, count, 0);
+	if (status <= 0) {
+		/* ignore-return-value */ CheckWouldBlock(connection, static_cast<int>(status));
+		return -1;
+	}
+
+	return status;
+#else
+	static_cast<void>(connection);
+	static_cast<void>(fd);
+	static_cast<void>(offset);
+	static_cast<void>(count);
+	return -1;
+#endif
 }
 
 bool
-ConnectionSecureInternals::SendFile(Connection *connection, int fd, std::size_t count) {
-	std::array<char, 4096> buffer {};
-	do {
-		ssize_t result = read(fd, buffer.data(), 4096);
-		if (result == -1) {
+ConnectionSecureInternals::SendFile(Connection *connection, int fd, off_t offset, std::size_t count) {
+	if (CanSendFile(connection)) {
+		while (count != 0) {
+			const auto status = SendFileSome(connection, fd, offset, count);
+			if (status == -1) {
+				connection->hasWriteFailed = true;
+				return false;
+			}
+
+			offset += status;
+			count -= status;
+		}
+
+		return true;
+	}
+
+	// Without kTLS, read the file and let OpenSSL encrypt it, a record per
+	// chunk.
+	while (count != 0) {
+		ssize_t result = connection->ReadFileChunk(fd, offset, count);
+		if (result <= 0) {
 			return false;
 		}
+		offset += result;
 		count -= result;
-		do {
-			ssize_t writeResult = SSL_write(reinterpret_cast<SSL *>(connection->securityContext), buffer.data(), result);
-			if (writeResult == -1) {
+
+		for (const char *data = connection->fileBuffer.get(); result != 0;) {
+			int writeResult = SSL_write(reinterpret_cast<SSL *>(connection->securityContext), data, result);
+			if (writeResult <= 0) {
 				connection->hasWriteFailed = true;
 				return false;
 			}
+			data += writeResult;
 			result -= writeResult;
-		} while (result != 0);
-	} while (count != 0);
+		}
+	}
 
 	return true;
 }
 
 int
 ConnectionSecureInternals::Write(Connection *connection, const char *str, std::size_t len) {
-	return SSL_write(reinterpret_cast<SSL *>(connection->securityContext), str, len);
+	int status = SSL_write(reinterpret_cast<SSL *>(connection->securityContext), str, len);
+
+	if (status <= 0) {
+		/* ignore-return-value */ CheckWouldBlock(connection, status);
+	}
+
+	return status;
 }
 
 #ifdef TLSIMPL_ENABLE_DEBUG_INFORMATION
@@ -0,0 +1,152 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include "connection/reaper.hpp"
+
+#include <array>
+
+#include <cerrno>
+#include <fcntl.h>
+
+#include "base/logger.hpp"
+#include "event/clock.hpp"
+#include "posix/unistd.hpp"
+
+// The resolution of the deadlines, in milliseconds.
+#define MAGIC_REAPER_TIMER_RESOLUTION 100
+
+// The amount of milliseconds the reaper waits for events when no socket is
+// lingering, before checking whether it should stop.
+#define MAGIC_REAPER_IDLE_TIMEOUT 1000
+
+ConnectionReaper::Lingering::Lingering(ConnectionReaper *reaper, int socket) noexcept
+	: reaper(reaper), socket(socket) {
+}
+
+void
+ConnectionReaper::Lingering::OnEvent(std::uint32_t) noexcept {
+	std::array<char, 4096> discarded;
+
+	while (true) {
+		const auto result = psx::read(socket, discarded.data(), discarded.size());
+		if (result > 0) {
+			continue;
+		}
+
+		if (result == -1 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+			return;
+		}
+
+		// The peer has closed its side, or the connection has been reset.
+		reaper->Close(*this);
+		return;
+	}
+}
+
+void
+ConnectionReaper::Lingering::OnTimeout() noexcept {
+	reaper->Close(*this);
+}
+
+ConnectionReaper::ConnectionReaper() noexcept
+	: timers(std::chrono::milliseconds(MAGIC_REAPER_TIMER_RESOLUTION)) {
+}
+
+ConnectionReaper::~ConnectionReaper() noexcept {
+	running = false;
+	stopping = true;
+	if (thread.joinable()) {
+		loop.Post([] {});
+		thread.join();
+	}
+
+	for (const auto &entry : sockets) {
+		psx::close(entry.first);
+	}
+}
+
+void
+ConnectionReaper::Adopt(int socket, std::chrono::milliseconds deadline) noexcept {
+	const int flags = fcntl(socket, F_GETFL);
+	if (!running || flags == -1 || fcntl(socket, F_SETFL, flags | O_NONBLOCK) == -1) {
+		psx::close(socket);
+		return;
+	}
+
+	count++;
+	loop.Post([this, socket, deadline] {
+		auto lingering = std::make_unique<Lingering>(this, socket);
+		if (!loop.Add(socket, lingering.get(), Event::Interest::read)) {
+			psx::close(socket);
+			count--;
+			return;
+		}
+
+		timers.Schedule(*lingering, deadline);
+		sockets.emplace(socket, std::move(lingering));
+	});
+}
+
+void
+ConnectionReaper::Close(Lingering &lingering) noexcept {
+	if (lingering.closed) {
+		return;
+	}
+
+	// The descriptor is closed with the destruction, so it can't be reused
+	// for a socket that is adopted in the meantime.
+	lingering.closed = true;
+	timers.Cancel(lingering);
+	loop.Remove(lingering.socket);
+	closed.push_back(lingering.socket);
+}
+
+ConnectionReaper &
+ConnectionReaper::Instance() noexcept {
+	static ConnectionReaper reaper;
+	static const bool started = [] {
+		if (!reaper.Start()) {
+			Logger::Warning("ConnectionReaper", "Failed to start, so connections are closed right away");
+			return false;
+		}
+		return true;
+	}();
+
+	static_cast<void>(started);
+	return reaper;
+}
+
+void
+ConnectionReaper::Run() noexcept {
+	while (!stopping) {
+		const auto timeout = timers.IsEmpty() ? MAGIC_REAPER_IDLE_TIMEOUT : MAGIC_REAPER_TIMER_RESOLUTION;
+		if (!loop.RunOnce(timeout)) {
+			Logger::Severe("ConnectionReaper::Run", "Invalid state: event loop failure");
+			running = false;
+			return;
+		}
+
+		timers.Advance(Event::Clock::Now());
+
+		for (const int socket : closed) {
+			sockets.erase(socket);
+			psx::close(socket);
+			count--;
+		}
+		closed.clear();
+	}
+}
+
+bool
+ConnectionReaper::Start() noexcept {
+	if (!loop.Initialize()) {
+		return false;
+	}
+
+	running = true;
+	thread = std::thread(&ConnectionReaper::Run, this);
+	return true;
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <cstddef>
+
+#include "event/loop.hpp"
+#include "event/timer_wheel.hpp"
+
+// Closes the sockets of finished connections in the background, so the thread
+// that served a connection doesn't have to wait for the peer.
+//
+// Closing a socket while octets the peer sent are still unread makes the
+// kernel reset the connection, which discards the response octets that
+// haven't been delivered yet. Therefore the sending side of an adopted socket
+// has already been shut down, and the reaper reads and discards whatever the
+// peer sends, until the peer closes its side too, i.e. it has received the
+// whole response, or the deadline passes.
+class ConnectionReaper {
+public:
+	ConnectionReaper() noexcept;
+
+	~ConnectionReaper() noexcept;
+
+	ConnectionReaper(const ConnectionReaper &) = delete;
+	ConnectionReaper &operator=(const ConnectionReaper &) = delete;
+
+	// The reaper of the process, which is started on first use.
+	[[nodiscard]] static ConnectionReaper &
+	Instance() noexcept;
+
+	// Takes over [socket], whose sending side has been shut down with
+	// shutdown(2), and closes it once the peer has closed its side, or after
+	// [deadline]. If the reaper isn't running, the socket is closed right
+	// away.
+	//
+	// This function is thread-safe.
+	void
+	Adopt(int socket, std::chrono::milliseconds deadline) noexcept;
+
+	// The amount of sockets that have been adopted but not closed yet.
+	[[nodiscard]] inline std::size_t
+	Count() const noexcept {
+		return count;
+	}
+
+	// Starts the thread of the reaper.
+	//
+	// Returns success status
+	[[nodiscard]] bool
+	Start() noexcept;
+
+private:
+	class Lingering : public Event::Handler, public Event::Timer {
+	public:
+		Lingering(ConnectionReaper *reaper, int socket) noexcept;
+
+		// Discards what the peer has sent, and closes the socket when it has
+		// closed its side.
+		void
+		OnEvent(std::uint32_t events) noexcept override;
+
+		// The deadline has passed.
+		void
+		OnTimeout() noexcept override;
+
+		ConnectionReaper *reaper;
+		const int socket;
+
+		// Events fetched in the same batch might still be dispatched after the
+		// socket has been closed.
+		bool closed{ false };
+	};
+
+	Event::Loop loop;
+
+	// Declared before the sockets, whose timers are cancelled when they're
+	// destroyed.
+	Event::TimerWheel timers;
+
+	std::unordered_map<int, std::unique_ptr<Lingering>> sockets;
+	std::vector<int> closed;
+
+	std::atomic<std::size_t> count{ 0 };
+	std::atomic<bool> running{ false };
+	std::atomic<bool> stopping{ false };
+	std::thread thread;
+
+	// Closes the socket of [lingering], which is destroyed after the current
+	// batch of events.
+	void
+	Close(Lingering &lingering) noexcept;
+
+	void
+	Run() noexcept;
+};
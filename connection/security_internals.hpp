@@ -4,6 +4,8 @@
  * See the COPYING file for licensing information.
  */
 
+#include <string_view>
+
 #include <cstddef> // for std::size_t
 
 #include "connection/connection.hpp"
@@ -14,14 +16,42 @@ namespace ConnectionSecureInternals {
 void
 Destruct(Connection *connection);
 
+// Performs a (blocking) Prepare and Handshake.
 bool
 Setup(Connection *connection, const HTTP::Configuration &configuration);
 
+// Creates the TLS state of the connection, without performing the handshake.
+bool
+Prepare(Connection *connection, const HTTP::Configuration &configuration);
+
+// Performs the handshake. For non-blocking connections, the handshake may be
+// incomplete (Status::WOULD_BLOCK), and this function should be called again
+// when the socket is ready.
+Connection::Status
+Handshake(Connection *connection);
+
+// See Connection::NegotiatedProtocol
+std::string_view
+NegotiatedProtocol(const Connection *connection);
+
+int
+Read(Connection *connection, char *buf, std::size_t len);
+
+// Returns whether the records are encrypted by the kernel (kTLS), so that
+// SendFileSome can be used.
 bool
-ReadChar(const Connection *connection, char *buf);
+CanSendFile(Connection *connection);
 
 bool
-SendFile(Connection *connection, int fd, std::size_t count);
+SendFile(Connection *connection, int fd, off_t offset, std::size_t count);
+
+// Sends at most [count] octets of [fd] starting at [offset] with
+// SSL_sendfile. Returns the amount of octets sent, or -1 on failure, in
+// which case the blocking state of the connection is updated.
+//
+// Requires CanSendFile.
+ssize_t
+SendFileSome(Connection *connection, int fd, off_t offset, std::size_t count);
 
 int
 Write(Connection *connection, const char *str, std::size_t len);
@@ -0,0 +1,17 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include "event/clock.hpp"
+
+namespace Event {
+
+void
+Clock::Update() noexcept {
+	state.now = std::chrono::steady_clock::now();
+	state.seconds = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+}
+
+} // namespace Event
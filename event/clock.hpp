@@ -0,0 +1,54 @@
+#pragma once
+
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include <chrono>
+
+#include <ctime>
+
+namespace Event {
+
+// The time of a thread, read once per iteration of its loop (see
+// Loop::RunOnce), so the handlers of an iteration, the timers and the Date
+// header field share a single reading instead of each reading the clocks.
+// Threads without a loop update it themselves, e.g. once per message exchange.
+//
+// Like Loop, the clock is per thread, so it isn't synchronized.
+class Clock {
+public:
+	// Reads the monotonic and the wall clock.
+	static void
+	Update() noexcept;
+
+	// The monotonic time of the last update.
+	[[nodiscard]] static inline std::chrono::steady_clock::time_point
+	Now() noexcept {
+		if (state.now == std::chrono::steady_clock::time_point{}) {
+			Update();
+		}
+		return state.now;
+	}
+
+	// The wall time of the last update, in seconds since the epoch.
+	[[nodiscard]] static inline std::time_t
+	Seconds() noexcept {
+		if (state.now == std::chrono::steady_clock::time_point{}) {
+			Update();
+		}
+		return state.seconds;
+	}
+
+private:
+	struct State {
+		std::chrono::steady_clock::time_point now;
+		std::time_t seconds;
+	};
+
+	static inline thread_local State state{};
+};
+
+} // namespace Event
@@ -0,0 +1,232 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include "event/loop.hpp"
+
+#include <array>
+#include <chrono>
+#include <initializer_list>
+#include <utility>
+
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <sys/epoll.h>
+#elif defined(__FreeBSD__) || defined(__APPLE__)
+#include <sys/types.h>
+#include <sys/event.h>
+#include <sys/time.h>
+#else
+#error Unsupported platform: no epoll(7) or kqueue(2)
+#endif
+
+#include "event/clock.hpp"
+#include "posix/unistd.hpp"
+
+// The maximum amount of events handled in a single RunOnce() call.
+#define MAGIC_EVENT_BATCH_SIZE 64
+
+namespace Event {
+
+Loop::~Loop() noexcept {
+	for (int fd : { internalFD, wakeupPipe[0], wakeupPipe[1] }) {
+		if (fd != -1) {
+			psx::close(fd);
+		}
+	}
+}
+
+bool
+Loop::Initialize() noexcept {
+#if defined(__linux__)
+	internalFD = epoll_create1(EPOLL_CLOEXEC);
+#else
+	internalFD = kqueue();
+#endif
+
+	if (internalFD == -1) {
+		return false;
+	}
+
+	if (pipe(wakeupPipe) == -1) {
+		return false;
+	}
+
+	for (int fd : wakeupPipe) {
+		if (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) == -1 ||
+			fcntl(fd, F_SETFD, FD_CLOEXEC) == -1) {
+			return false;
+		}
+	}
+
+	// The wake-up pipe is registered without a handler, which RunOnce()
+	// recognizes.
+	return Add(wakeupPipe[0], nullptr, Interest::read);
+}
+
+#if defined(__linux__)
+
+static std::uint32_t
+ToEpollEvents(std::uint32_t interest) noexcept {
+	std::uint32_t events = 0;
+	if (interest & Interest::read) {
+		events |= EPOLLIN | EPOLLRDHUP;
+	}
+	if (interest & Interest::write) {
+		events |= EPOLLOUT;
+	}
+	return events;
+}
+
+bool
+Loop::Add(int fd, Handler *handler, std::uint32_t interest) noexcept {
+	struct epoll_event event {};
+	event.events = ToEpollEvents(interest);
+	event.data.ptr = handler;
+	return epoll_ctl(internalFD, EPOLL_CTL_ADD, fd, &event) == 0;
+}
+
+bool
+Loop::Modify(int fd, Handler *handler, std::uint32_t interest) noexcept {
+	struct epoll_event event {};
+	event.events = ToEpollEvents(interest);
+	event.data.ptr = handler;
+	return epoll_ctl(internalFD, EPOLL_CTL_MOD, fd, &event) == 0;
+}
+
+void
+Loop::Remove(int fd) noexcept {
+	/* ignore-return-value */ epoll_ctl(internalFD, EPOLL_CTL_DEL, fd, nullptr);
+}
+
+bool
+Loop::RunOnce(int timeout) noexcept {
+	std::array<struct epoll_event, MAGIC_EVENT_BATCH_SIZE> events; // NOLINT(cppcoreguidelines-pro-type-member-init)
+
+	int count = epoll_wait(internalFD, events.data(), events.size(), timeout);
+	if (count == -1) {
+		return errno == EINTR;
+	}
+
+	// The handlers and the timers of this iteration share a reading.
+	Clock::Update();
+	const auto dispatchStart = Clock::Now();
+	for (int i = 0; i < count; i++) {
+		auto *handler = static_cast<Handler *>(events[i].data.ptr);
+		if (handler == nullptr) {
+			RunPosted();
+			continue;
+		}
+
+		std::uint32_t ready = 0;
+		if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+			ready |= Interest::read;
+		}
+		if (events[i].events & EPOLLOUT) {
+			ready |= Interest::write;
+		}
+
+		handler->OnEvent(ready);
+	}
+
+	dispatchDuration = count == 0 ? std::chrono::steady_clock::duration{} : std::chrono::steady_clock::now() - dispatchStart;
+	return true;
+}
+
+#else /* kqueue */
+
+static bool
+ChangeKqueue(int kq, int fd, Handler *handler, std::uint32_t interest) noexcept {
+	std::array<struct kevent, 2> changes; // NOLINT(cppcoreguidelines-pro-type-member-init)
+	EV_SET(&changes[0], fd, EVFILT_READ,
+		   EV_ADD | ((interest & Interest::read) ? EV_ENABLE : EV_DISABLE),
+		   0, 0, handler);
+	EV_SET(&changes[1], fd, EVFILT_WRITE,
+		   EV_ADD | ((interest & Interest::write) ? EV_ENABLE : EV_DISABLE),
+		   0, 0, handler);
+	return kevent(kq, changes.data(), changes.size(), nullptr, 0, nullptr) == 0;
+}
+
+bool
+Loop::Add(int fd, Handler *handler, std::uint32_t interest) noexcept {
+	return ChangeKqueue(internalFD, fd, handler, interest);
+}
+
+bool
+Loop::Modify(int fd, Handler *handler, std::uint32_t interest) noexcept {
+	return ChangeKqueue(internalFD, fd, handler, interest);
+}
+
+void
+Loop::Remove(int fd) noexcept {
+	std::array<struct kevent, 2> changes; // NOLINT(cppcoreguidelines-pro-type-member-init)
+	EV_SET(&changes[0], fd, EVFILT_READ, EV_DELETE, 0, 0, nullptr);
+	EV_SET(&changes[1], fd, EVFILT_WRITE, EV_DELETE, 0, 0, nullptr);
+	/* ignore-return-value */ kevent(internalFD, changes.data(), changes.size(), nullptr, 0, nullptr);
+}
+
+bool
+Loop::RunOnce(int timeout) noexcept {
+	std::array<struct kevent, MAGIC_EVENT_BATCH_SIZE> events; // NOLINT(cppcoreguidelines-pro-type-member-init)
+
+	struct timespec duration { timeout / 1000, (timeout % 1000) * 1000000L };
+	int count = kevent(internalFD, nullptr, 0, events.data(), events.size(),
+					   timeout < 0 ? nullptr : &duration);
+	if (count == -1) {
+		return errno == EINTR;
+	}
+
+	// The handlers and the timers of this iteration share a reading.
+	Clock::Update();
+	const auto dispatchStart = Clock::Now();
+	for (int i = 0; i < count; i++) {
+		auto *handler = static_cast<Handler *>(events[i].udata);
+		if (handler == nullptr) {
+			RunPosted();
+			continue;
+		}
+
+		handler->OnEvent(events[i].filter == EVFILT_WRITE ? Interest::write : Interest::read);
+	}
+
+	dispatchDuration = count == 0 ? std::chrono::steady_clock::duration{} : std::chrono::steady_clock::now() - dispatchStart;
+	return true;
+}
+
+#endif
+
+void
+Loop::Post(std::function<void()> function) {
+	{
+		const std::lock_guard<std::mutex> lock(postedMutex);
+		posted.push_back(std::move(function));
+	}
+
+	const char signal = 0;
+	/* ignore-return-value */ psx::write(wakeupPipe[1], &signal, 1);
+}
+
+void
+Loop::RunPosted() noexcept {
+	std::array<char, 64> drain; // NOLINT(cppcoreguidelines-pro-type-member-init)
+	while (psx::read(wakeupPipe[0], drain.data(), drain.size()) > 0) {
+		continue;
+	}
+
+	std::vector<std::function<void()>> functions;
+	{
+		const std::lock_guard<std::mutex> lock(postedMutex);
+		functions.swap(posted);
+	}
+
+	for (const auto &function : functions) {
+		function();
+	}
+}
+
+} // namespace Event
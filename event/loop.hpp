@@ -0,0 +1,105 @@
+#pragma once
+
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include <cstdint>
+
+namespace Event {
+
+// The kinds of readiness a Handler can be interested in. These values can be
+// combined, e.g. 'Interest::read | Interest::write'.
+namespace Interest {
+	constexpr std::uint32_t none = 0x0;
+	constexpr std::uint32_t read = 0x1;
+	constexpr std::uint32_t write = 0x2;
+} // namespace Interest
+
+class Handler {
+public:
+	virtual ~Handler() noexcept = default;
+
+	// Called by the loop when the file descriptor is ready. The [events]
+	// parameter is a combination of Interest values. Hang-ups and errors are
+	// reported as Interest::read, so the handler notices them when reading.
+	virtual void
+	OnEvent(std::uint32_t events) noexcept = 0;
+};
+
+// The event loop is a thin wrapper around the readiness notification facility
+// of the operating system: epoll(7) on Linux and kqueue(2) on FreeBSD.
+//
+// A loop isn't thread-safe and should only be used by the thread that runs it,
+// with the exception of Post().
+class Loop {
+public:
+	Loop() noexcept = default;
+
+	~Loop() noexcept;
+
+	Loop(const Loop &) = delete;
+	Loop &operator=(const Loop &) = delete;
+
+	[[nodiscard]] bool
+	Initialize() noexcept;
+
+	// Starts watching [fd] for the readiness described by [interest]. When
+	// the descriptor is ready, [handler]'s OnEvent is called.
+	[[nodiscard]] bool
+	Add(int fd, Handler *handler, std::uint32_t interest) noexcept;
+
+	// Changes the readiness [fd] is watched for.
+	[[nodiscard]] bool
+	Modify(int fd, Handler *handler, std::uint32_t interest) noexcept;
+
+	// Will schedule [function] to be called by the thread running the loop.
+	// This is the only function that may be called from other threads.
+	void
+	Post(std::function<void()> function);
+
+	// Stops watching [fd]. This must be called before the descriptor is
+	// closed.
+	void
+	Remove(int fd) noexcept;
+
+	// Waits at most [timeout] milliseconds for events, and dispatches them to
+	// their handlers. A negative timeout means waiting indefinitely.
+	//
+	// Returns false if waiting failed catastrophically.
+	[[nodiscard]] bool
+	RunOnce(int timeout) noexcept;
+
+	// The time the last RunOnce() spent dispatching events, i.e. how long the
+	// events that became ready in the meantime waited at most, besides the
+	// time spent waiting.
+	[[nodiscard]] inline std::chrono::steady_clock::duration
+	DispatchDuration() const noexcept {
+		return dispatchDuration;
+	}
+
+private:
+	std::chrono::steady_clock::duration dispatchDuration{};
+
+	// The epoll/kqueue descriptor.
+	int internalFD{ -1 };
+
+	// Post() writes to the second descriptor to wake the loop up, the loop
+	// watches the first one.
+	int wakeupPipe[2]{ -1, -1 };
+
+	std::mutex postedMutex;
+	std::vector<std::function<void()>> posted;
+
+	void
+	RunPosted() noexcept;
+};
+
+} // namespace Event
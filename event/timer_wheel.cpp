@@ -0,0 +1,148 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include "event/timer_wheel.hpp"
+
+#include <algorithm>
+
+namespace Event {
+
+Timer::~Timer() noexcept {
+	Unlink();
+}
+
+void
+Timer::Unlink() noexcept {
+	if (wheel == nullptr) {
+		return;
+	}
+
+	previous->next = next;
+	next->previous = previous;
+	previous = nullptr;
+	next = nullptr;
+
+	wheel->count--;
+	wheel = nullptr;
+}
+
+TimerWheel::TimerWheel(std::chrono::milliseconds resolution, std::chrono::steady_clock::time_point origin) noexcept
+	: resolution(std::max(resolution, std::chrono::milliseconds(1))), origin(origin) {
+	for (auto &level : levels) {
+		for (auto &slot : level) {
+			slot.previous = &slot;
+			slot.next = &slot;
+		}
+	}
+}
+
+TimerWheel::~TimerWheel() noexcept {
+	// The timers outlive the wheel only when their owners are destroyed
+	// later, which shouldn't touch the slots anymore.
+	for (auto &level : levels) {
+		for (auto &slot : level) {
+			while (slot.next != &slot) {
+				static_cast<Timer *>(slot.next)->Unlink();
+			}
+		}
+	}
+}
+
+void
+TimerWheel::Advance(std::chrono::steady_clock::time_point now) noexcept {
+	if (now < origin) {
+		return;
+	}
+
+	const auto target = static_cast<std::uint64_t>((now - origin) / resolution);
+	if (count == 0) {
+		current = std::max(current, target);
+		return;
+	}
+
+	while (current < target) {
+		current++;
+
+		// Spread the timers of the next slot of each level that wraps
+		// around over the levels below it.
+		for (std::size_t level = 1; level < levelCount; level++) {
+			if (((current >> ((level - 1) * levelBits)) & (slotsPerLevel - 1)) != 0) {
+				break;
+			}
+			Cascade(level, (current >> (level * levelBits)) & (slotsPerLevel - 1));
+		}
+
+		auto &slot = levels[0][current & (slotsPerLevel - 1)];
+		while (slot.next != &slot) {
+			auto *timer = static_cast<Timer *>(slot.next);
+			timer->Unlink();
+			timer->OnTimeout();
+		}
+
+		if (count == 0) {
+			current = target;
+		}
+	}
+}
+
+void
+TimerWheel::Cancel(Timer &timer) noexcept {
+	timer.Unlink();
+}
+
+void
+TimerWheel::Cascade(std::size_t level, std::size_t index) noexcept {
+	auto &slot = levels[level][index];
+
+	// Detach the list first, since a timer might be put back in this slot.
+	TimerLink list{ slot.previous, slot.next };
+	if (list.next == &slot) {
+		return;
+	}
+	list.next->previous = &list;
+	list.previous->next = &list;
+	slot.previous = &slot;
+	slot.next = &slot;
+
+	while (list.next != &list) {
+		auto *timer = static_cast<Timer *>(list.next);
+		timer->Unlink();
+		Insert(*timer);
+	}
+}
+
+void
+TimerWheel::Insert(Timer &timer) noexcept {
+	const auto delta = timer.expiry - current;
+
+	std::size_t level = 0;
+	while (level + 1 < levelCount && delta >= (std::uint64_t{ 1 } << ((level + 1) * levelBits))) {
+		level++;
+	}
+
+	auto &slot = levels[level][(timer.expiry >> (level * levelBits)) & (slotsPerLevel - 1)];
+	timer.previous = slot.previous;
+	timer.next = &slot;
+	slot.previous->next = &timer;
+	slot.previous = &timer;
+
+	timer.wheel = this;
+	count++;
+}
+
+void
+TimerWheel::Schedule(Timer &timer, std::chrono::milliseconds delay) noexcept {
+	timer.Unlink();
+
+	auto ticks = static_cast<std::uint64_t>((std::max(delay.count(), std::chrono::milliseconds::rep{ 0 }) +
+											 resolution.count() - 1) / resolution.count());
+	ticks = std::clamp<std::uint64_t>(ticks, 1, maxTicks);
+
+	timer.expiry = current + ticks;
+	Insert(timer);
+}
+
+} // namespace Event
@@ -0,0 +1,131 @@
+#pragma once
+
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include <array>
+#include <chrono>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Event {
+
+class TimerWheel;
+
+// The links of the circular lists of the slots of a wheel.
+struct TimerLink {
+	TimerLink *previous{ nullptr };
+	TimerLink *next{ nullptr };
+};
+
+// A timer is embedded in the object it times, so scheduling and cancelling it
+// doesn't allocate. A timer is cancelled when it is destroyed.
+class Timer : private TimerLink {
+public:
+	Timer() noexcept = default;
+
+	Timer(const Timer &) = delete;
+	Timer &operator=(const Timer &) = delete;
+
+	virtual ~Timer() noexcept;
+
+	[[nodiscard]] inline bool
+	IsScheduled() const noexcept {
+		return wheel != nullptr;
+	}
+
+	// Called by the wheel when the timer has expired. The timer isn't
+	// scheduled anymore, but may be scheduled again.
+	virtual void
+	OnTimeout() noexcept = 0;
+
+private:
+	friend class TimerWheel;
+
+	TimerWheel *wheel{ nullptr };
+
+	// The tick at which the timer expires.
+	std::uint64_t expiry{ 0 };
+
+	void
+	Unlink() noexcept;
+};
+
+// A hierarchical timer wheel, which schedules, cancels and expires timers in
+// O(1). Time is divided in ticks of [resolution]; the first level has a slot
+// per tick, each next level a slot per 64 slots of the level below it. When
+// the first level wraps around, the timers of the next slot of the second
+// level are spread over the first level, and so on.
+//
+// Like Loop, a wheel should only be used by the thread that runs it.
+class TimerWheel {
+public:
+	// The ticks are counted from [origin].
+	explicit TimerWheel(std::chrono::milliseconds resolution,
+						std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now()) noexcept;
+
+	~TimerWheel() noexcept;
+
+	TimerWheel(const TimerWheel &) = delete;
+	TimerWheel &operator=(const TimerWheel &) = delete;
+
+	// Expires the timers whose time has passed at [now], in order of expiry.
+	void
+	Advance(std::chrono::steady_clock::time_point now) noexcept;
+
+	// Cancels [timer] if it is scheduled.
+	void
+	Cancel(Timer &timer) noexcept;
+
+	[[nodiscard]] inline bool
+	IsEmpty() const noexcept {
+		return count == 0;
+	}
+
+	[[nodiscard]] inline std::chrono::milliseconds
+	Resolution() const noexcept {
+		return resolution;
+	}
+
+	// Schedules [timer] to expire after [delay], which is rounded up to a
+	// whole amount of ticks. A scheduled timer is rescheduled.
+	void
+	Schedule(Timer &timer, std::chrono::milliseconds delay) noexcept;
+
+private:
+	friend class Timer;
+
+	static constexpr std::size_t levelBits = 6;
+	static constexpr std::size_t slotsPerLevel = 1 << levelBits;
+	static constexpr std::size_t levelCount = 4;
+
+	// Delays beyond the range of the wheel are shortened to this, which is
+	// about 19 days with a resolution of 100 milliseconds.
+	static constexpr std::uint64_t maxTicks = (std::uint64_t{ 1 } << (levelBits * levelCount)) - 1;
+
+	const std::chrono::milliseconds resolution;
+	const std::chrono::steady_clock::time_point origin;
+
+	// The last tick that has been expired.
+	std::uint64_t current{ 0 };
+
+	std::size_t count{ 0 };
+
+	// The slots are circular lists, whose sentinel is the slot itself.
+	std::array<std::array<TimerLink, slotsPerLevel>, levelCount> levels;
+
+	// Moves the timers of the slot of [level] at [index] to the levels
+	// below it.
+	void
+	Cascade(std::size_t level, std::size_t index) noexcept;
+
+	// Puts [timer] in the slot of its expiry.
+	void
+	Insert(Timer &timer) noexcept;
+};
+
+} // namespace Event
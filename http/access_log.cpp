@@ -0,0 +1,182 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include "http/access_log.hpp"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <limits>
+
+#include <ctime>
+
+#include "base/async_log.hpp"
+#include "http/request.hpp"
+
+namespace HTTP {
+
+namespace {
+
+// Appends to a buffer of maxAccessRecordLength octets, leaving room for the
+// line feed.
+class RecordWriter {
+public:
+	// Continues after the first [length] octets of [output].
+	RecordWriter(char *output, std::size_t length) noexcept :
+		begin(output), end(output + length), limit(output + maxAccessRecordLength - 1) {
+	}
+
+	void
+	Append(std::string_view text) noexcept {
+		const auto length = std::min(text.length(), static_cast<std::size_t>(limit - end));
+		end = std::copy_n(text.data(), length, end);
+	}
+
+	// Appends [text], or '-' if it is empty, escaping the octets that
+	// aren't printable, and the quotes and backslashes.
+	void
+	AppendEscaped(std::string_view text) noexcept {
+		if (text.empty()) {
+			Append("-");
+			return;
+		}
+
+		constexpr std::string_view digits("0123456789abcdef");
+		for (char character : text) {
+			const auto octet = static_cast<unsigned char>(character);
+			if (octet >= 0x20 && octet < 0x7F && character != '"' && character != '\\') {
+				if (end == limit) {
+					return;
+				}
+				*end++ = character;
+			} else {
+				if (limit - end < 4) {
+					return;
+				}
+				*end++ = '\\';
+				*end++ = 'x';
+				*end++ = digits[octet >> 4];
+				*end++ = digits[octet & 0xF];
+			}
+		}
+	}
+
+	void
+	AppendNumber(std::size_t number) noexcept {
+		std::array<char, 20> buffer;
+		const auto result = std::to_chars(buffer.data(), buffer.data() + buffer.size(), number);
+		Append(std::string_view(buffer.data(), static_cast<std::size_t>(result.ptr - buffer.data())));
+	}
+
+	[[nodiscard]] inline std::size_t
+	Length() const noexcept {
+		return static_cast<std::size_t>(end - begin);
+	}
+
+	[[nodiscard]] std::size_t
+	Finish() noexcept {
+		*end++ = '\n';
+		return static_cast<std::size_t>(end - begin);
+	}
+
+private:
+	char *begin;
+	char *end;
+	char *const limit;
+};
+
+// The time formatted as ISO 8601 in UTC, which is formatted once a second per
+// thread.
+[[nodiscard]] std::string_view
+CurrentTime() noexcept {
+	thread_local std::time_t formattedTime{ -1 };
+	thread_local std::array<char, 21> formatted{};
+
+	const auto now = std::time(nullptr);
+	if (now != formattedTime) {
+		struct tm components{};
+		gmtime_r(&now, &components);
+		std::strftime(formatted.data(), formatted.size(), "%Y-%m-%dT%H:%M:%SZ", &components);
+		formattedTime = now;
+	}
+
+	return { formatted.data(), formatted.size() - 1 };
+}
+
+} // namespace
+
+std::size_t
+FormatAccessRequest(char *output, const Request &request, std::string_view protocol,
+					std::string_view remoteAddress) noexcept {
+	RecordWriter writer(output, 0);
+	writer.Append(CurrentTime());
+	writer.Append(" ");
+	writer.AppendEscaped(remoteAddress);
+	writer.Append(" ");
+
+	const auto *host = request.headers.Find(HeaderID::HOST);
+	writer.AppendEscaped(host == nullptr ? std::string_view() : host->value);
+
+	writer.Append(" \"");
+	if (request.method.empty()) {
+		writer.Append("-");
+	} else {
+		writer.AppendEscaped(request.method);
+		writer.Append(" ");
+		writer.AppendEscaped(request.path);
+		if (!request.query.empty()) {
+			writer.Append("?");
+			writer.AppendEscaped(request.query);
+		}
+		writer.Append(" ");
+		writer.Append(protocol);
+	}
+	writer.Append("\" ");
+
+	return writer.Length();
+}
+
+std::size_t
+FinishAccessRecord(char *output, std::size_t length, std::string_view statusLine, std::size_t bodyLength) noexcept {
+	RecordWriter writer(output, length);
+
+	// "HTTP/1.1 200 OK"
+	writer.Append(statusLine.length() >= 12 ? statusLine.substr(9, 3) : std::string_view("-"));
+	writer.Append(" ");
+	if (bodyLength == std::numeric_limits<std::size_t>::max()) {
+		writer.Append("-");
+	} else {
+		writer.AppendNumber(bodyLength);
+	}
+
+	return writer.Finish();
+}
+
+std::size_t
+FormatAccessRecord(char *output, const Request &request, std::string_view protocol, std::string_view remoteAddress,
+				   std::string_view statusLine, std::size_t bodyLength) noexcept {
+	const auto length = FormatAccessRequest(output, request, protocol, remoteAddress);
+	return FinishAccessRecord(output, length, statusLine, bodyLength);
+}
+
+void
+LogAccess(base::AsyncLog &log, const Request &request, std::string_view protocol, std::string_view remoteAddress,
+		  std::string_view statusLine, std::size_t bodyLength) noexcept {
+	std::array<char, maxAccessRecordLength> record;
+	const auto length = FormatAccessRecord(record.data(), request, protocol, remoteAddress, statusLine, bodyLength);
+	static_cast<void>(log.Append(std::string_view(record.data(), length)));
+}
+
+void
+LogAccess(base::AsyncLog &log, std::string_view requestPart, std::string_view statusLine, std::size_t bodyLength) noexcept {
+	std::array<char, maxAccessRecordLength> record;
+	const auto prefix = std::min(requestPart.length(), maxAccessRecordLength - 1);
+	std::copy_n(requestPart.data(), prefix, record.data());
+	const auto length = FinishAccessRecord(record.data(), prefix, statusLine, bodyLength);
+	static_cast<void>(log.Append(std::string_view(record.data(), length)));
+}
+
+} // namespace HTTP
@@ -0,0 +1,65 @@
+#pragma once
+
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include <string_view>
+
+#include <cstddef>
+
+namespace base {
+// From base/async_log.hpp:
+class AsyncLog;
+} // namespace base
+
+namespace HTTP {
+
+// From http/request.hpp:
+struct Request;
+
+// The maximum amount of octets of a record. Longer request-targets and
+// hostnames are truncated.
+constexpr std::size_t maxAccessRecordLength = 1024;
+
+// Formats the record of the response to [request] into [output], which has
+// room for maxAccessRecordLength octets, and returns its length. A record is a
+// line of the form:
+//
+// 2020-06-01T12:00:00Z 192.0.2.1 example.com "GET /index.html HTTP/1.1" 200 1024
+//
+// with the time the response was sent, the address of the client, the Host
+// header field, the request-line, the status code and the length of the body,
+// or a '-' for unknown values. Octets that don't print are escaped as \xHH.
+[[nodiscard]] std::size_t
+FormatAccessRecord(char *output, const Request &request, std::string_view protocol, std::string_view remoteAddress,
+				   std::string_view statusLine, std::size_t bodyLength) noexcept;
+
+// Formats the part of the record up to the status code into [output], as
+// FormatAccessRecord, and returns its length. For responses that are sent
+// after the request has been reset, e.g. those of CGI scripts.
+[[nodiscard]] std::size_t
+FormatAccessRequest(char *output, const Request &request, std::string_view protocol,
+					std::string_view remoteAddress) noexcept;
+
+// Formats the status code and body length after the [length] octets of
+// [output] that FormatAccessRequest formatted, and returns the length of the
+// record.
+[[nodiscard]] std::size_t
+FinishAccessRecord(char *output, std::size_t length, std::string_view statusLine, std::size_t bodyLength) noexcept;
+
+// Formats the record of the response to [request] and appends it to [log].
+// [statusLine] is e.g. "HTTP/1.1 200 OK", and [bodyLength] is SIZE_MAX if it
+// isn't known.
+void
+LogAccess(base::AsyncLog &log, const Request &request, std::string_view protocol, std::string_view remoteAddress,
+		  std::string_view statusLine, std::size_t bodyLength) noexcept;
+
+// Appends the record of which [requestPart] was formatted by
+// FormatAccessRequest to [log].
+void
+LogAccess(base::AsyncLog &log, std::string_view requestPart, std::string_view statusLine, std::size_t bodyLength) noexcept;
+
+} // namespace HTTP
@@ -0,0 +1,140 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include "http/admission_control.hpp"
+
+#include <algorithm>
+
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "base/strings.hpp"
+#include "connection/reaper.hpp"
+#include "http/configuration.hpp"
+#include "http/metrics.hpp"
+#include "security/policies.hpp"
+
+namespace HTTP {
+
+namespace {
+
+[[nodiscard]] std::string
+CreateResponse() {
+	const auto &page = Strings::FileSystemOverloadPage;
+
+	std::string response(Strings::StatusLines::ServiceUnavailable.data(),
+						 Strings::StatusLines::ServiceUnavailable.length());
+	response += "\r\nConnection: close\r\nContent-Length: ";
+	response += std::to_string(page.length());
+	response += "\r\nContent-Type: text/html; charset=utf-8\r\nRetry-After: 1\r\n\r\n";
+	response.append(page.data(), page.length());
+	return response;
+}
+
+// The share of [total] connections of each of [count] threads, rounded up.
+[[nodiscard]] inline std::size_t
+Share(std::size_t total, std::size_t count) noexcept {
+	count = std::max<std::size_t>(count, 1);
+	return (total + count - 1) / count;
+}
+
+} // namespace
+
+AdmissionController::AdmissionController(const Configuration &configuration, std::size_t accepterCount) :
+	configuration(configuration),
+	maxConnections(Share(configuration.maxConnections, accepterCount)),
+	maxLag(std::chrono::milliseconds(configuration.maxEventLoopLag)),
+	response(CreateResponse()) {
+}
+
+AdmissionController::~AdmissionController() noexcept {
+	if (reservedDescriptor != -1) {
+		close(reservedDescriptor);
+	}
+}
+
+bool
+AdmissionController::Initialize() noexcept {
+	struct rlimit limit{};
+	if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY) {
+		descriptorLimit = static_cast<std::size_t>(limit.rlim_cur);
+	}
+
+	reservedDescriptor = open("/dev/null", O_RDONLY | O_CLOEXEC);
+	return reservedDescriptor != -1;
+}
+
+bool
+AdmissionController::ShouldShed(int socket, std::size_t connections, std::chrono::steady_clock::duration lag,
+								ShedReason &reason) const noexcept {
+	if (maxConnections != 0 && connections >= maxConnections) {
+		reason = ShedReason::CONNECTIONS;
+		return true;
+	}
+
+	// Descriptors are allocated lowest first, so all of the descriptors below
+	// [socket] are in use.
+	const auto headroom = configuration.fileDescriptorHeadroom;
+	if (headroom != 0 && descriptorLimit != 0 && static_cast<std::size_t>(socket) + 1 + headroom > descriptorLimit) {
+		reason = ShedReason::DESCRIPTORS;
+		return true;
+	}
+
+	if (maxLag.count() != 0 && lag > maxLag) {
+		reason = ShedReason::LAG;
+		return true;
+	}
+
+	return false;
+}
+
+void
+AdmissionController::Shed(int socket, ShedReason reason) const noexcept {
+	// The response of TLS connections would have to be encrypted, which is
+	// what shedding should avoid.
+	if (!configuration.useTransportSecurity) {
+		static_cast<void>(send(socket, response.data(), response.length(), MSG_DONTWAIT | MSG_NOSIGNAL));
+	}
+
+	// The request of the peer is unread, so closing the socket right away
+	// would reset the connection and might discard the response. See
+	// Connection::Close.
+	const auto lingeringCloseTime = configuration.securityPolicies.maxLingeringCloseTime;
+	if (configuration.useTransportSecurity || lingeringCloseTime == 0 || shutdown(socket, SHUT_WR) == -1) {
+		close(socket);
+	} else {
+		ConnectionReaper::Instance().Adopt(socket, std::chrono::milliseconds(lingeringCloseTime));
+	}
+
+	if (configuration.metrics != nullptr) {
+		configuration.metrics->CountShedConnection(reason);
+	}
+}
+
+bool
+AdmissionController::ShedWithReserve(int listeningSocket) noexcept {
+	// Reserving it again might have failed the previous time.
+	if (reservedDescriptor == -1) {
+		reservedDescriptor = open("/dev/null", O_RDONLY | O_CLOEXEC);
+		if (reservedDescriptor == -1) {
+			return false;
+		}
+	}
+
+	close(reservedDescriptor);
+	const int socket = accept(listeningSocket, nullptr, nullptr);
+	if (socket != -1) {
+		Shed(socket, ShedReason::DESCRIPTORS);
+	}
+
+	reservedDescriptor = open("/dev/null", O_RDONLY | O_CLOEXEC);
+	return socket != -1;
+}
+
+} // namespace HTTP
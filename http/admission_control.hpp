@@ -0,0 +1,104 @@
+#pragma once
+
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include <chrono>
+#include <string>
+
+#include <cstddef>
+
+namespace HTTP {
+
+// From http/configuration.hpp:
+struct Configuration;
+
+// Why a connection is shed.
+enum class ShedReason {
+	// The accepting thread has its share of Configuration::maxConnections,
+	// or the queue of the client threads is full, see
+	// Configuration::clientQueueCapacity.
+	CONNECTIONS,
+
+	// Fewer than Configuration::fileDescriptorHeadroom descriptors are left,
+	// or none at all.
+	DESCRIPTORS,
+
+	// The event loop of the worker lags more than
+	// Configuration::maxEventLoopLag.
+	LAG,
+};
+
+// Decides at accept time whether there is capacity for another connection,
+// so an overloaded server degrades by refusing new connections cheaply,
+// instead of accepting them until it collapses. A shed connection gets a
+// precomputed 503 (Service Unavailable) response, unless it is secured with
+// TLS, and is closed without allocating a client for it.
+//
+// Every accepting thread has a controller of its own, i.e. every worker in the
+// ServingMode::EVENT_DRIVEN serving mode, and the thread of the server in the
+// ServingMode::THREAD_PER_CLIENT serving mode.
+class AdmissionController {
+public:
+	// The connections are limited to a share of Configuration::maxConnections
+	// for each of the [accepterCount] accepting threads.
+	AdmissionController(const Configuration &configuration, std::size_t accepterCount);
+
+	~AdmissionController() noexcept;
+
+	AdmissionController(const AdmissionController &) = delete;
+	AdmissionController &operator=(const AdmissionController &) = delete;
+
+	// Reads the limit of file descriptors, and reserves a descriptor for
+	// ShedWithReserve.
+	//
+	// Returns success status
+	[[nodiscard]] bool
+	Initialize() noexcept;
+
+	// Whether the connection accepted as [socket] should be shed, with
+	// [connections] connections of the accepting thread already admitted,
+	// while its event loop lags [lag] on average.
+	[[nodiscard]] bool
+	ShouldShed(int socket, std::size_t connections, std::chrono::steady_clock::duration lag,
+			   ShedReason &reason) const noexcept;
+
+	// Sends the 503 response if possible, and closes [socket], lingering in
+	// the ConnectionReaper so the response isn't discarded.
+	void
+	Shed(int socket, ShedReason reason) const noexcept;
+
+	// Should be called when accept(2) failed because the process or system
+	// ran out of descriptors (EMFILE/ENFILE). Otherwise, the listening socket
+	// would stay ready until a descriptor is closed, and the pending
+	// connections would be stuck in its queue. The reserved descriptor is
+	// closed, so a connection can be accepted and shed, and reserved again
+	// after that. If reserving it failed, it is retried first.
+	//
+	// Returns whether a connection was shed
+	bool
+	ShedWithReserve(int listeningSocket) noexcept;
+
+	// The response sent to shed connections.
+	[[nodiscard]] inline const std::string &
+	Response() const noexcept {
+		return response;
+	}
+
+private:
+	const Configuration &configuration;
+	const std::size_t maxConnections;
+	const std::chrono::steady_clock::duration maxLag;
+	const std::string response;
+
+	// The soft RLIMIT_NOFILE, or 0 if there is none.
+	std::size_t descriptorLimit{ 0 };
+
+	// See ShedWithReserve.
+	int reservedDescriptor{ -1 };
+};
+
+} // namespace HTTP
@@ -0,0 +1,339 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include "http/body_reader.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <string_view>
+
+#include "http/utils.hpp"
+
+// The amount of hexadecimal digits of a chunk-size, which is enough for
+// chunks of up to an exabyte, without overflowing std::size_t.
+#define MAGIC_BODY_MAX_CHUNK_SIZE_DIGITS 15
+
+// The amount of octets of chunk extensions and trailer fields of a body.
+#define MAGIC_BODY_MAX_METADATA_LENGTH 4096
+
+namespace HTTP {
+
+namespace {
+
+[[nodiscard]] inline int
+HexadecimalValue(char character) noexcept {
+	if (character >= '0' && character <= '9') {
+		return character - '0';
+	}
+	if (character >= 'a' && character <= 'f') {
+		return character - 'a' + 10;
+	}
+	if (character >= 'A' && character <= 'F') {
+		return character - 'A' + 10;
+	}
+	return -1;
+}
+
+[[nodiscard]] std::string_view
+TrimWhitespace(std::string_view value) noexcept {
+	while (!value.empty() && (value.front() == ' ' || value.front() == '\t')) {
+		value.remove_prefix(1);
+	}
+	while (!value.empty() && (value.back() == ' ' || value.back() == '\t')) {
+		value.remove_suffix(1);
+	}
+	return value;
+}
+
+// Calls [function] with the elements of the comma-separated list [value],
+// without the whitespace around them. Empty elements are skipped. Stops when
+// [function] returns false.
+//
+// Spec: RFC 7230 § 7
+template <typename Function>
+bool
+ForEachElement(std::string_view value, Function function) noexcept {
+	while (true) {
+		const auto comma = value.find(',');
+		const auto element = TrimWhitespace(value.substr(0, comma));
+		if (!element.empty() && !function(element)) {
+			return false;
+		}
+
+		if (comma == std::string_view::npos) {
+			return true;
+		}
+		value.remove_prefix(comma + 1);
+	}
+}
+
+} // namespace
+
+ClientError
+BodyReader::EndOfStream() noexcept {
+	if (status == Status::INCOMPLETE) {
+		Fail(ClientError::FAILED_READ_BODY);
+	}
+	return error;
+}
+
+BodyReader::Status
+BodyReader::Read(const base::String &input, std::size_t &consumed, base::String &data) noexcept {
+	consumed = 0;
+	if (status != Status::INCOMPLETE) {
+		return status;
+	}
+
+	const char *octets = input.data();
+	const std::size_t length = input.length();
+	std::size_t offset = 0;
+
+	while (offset < length && status == Status::INCOMPLETE) {
+		if (state == State::DATA || state == State::CHUNK_DATA) {
+			const auto count = std::min(remaining, length - offset);
+			data = base::String(octets + offset, count);
+			remaining -= count;
+			received += count;
+			consumed = offset + count;
+
+			if (remaining == 0) {
+				if (state == State::DATA) {
+					status = Status::COMPLETE;
+				} else {
+					state = State::CHUNK_DATA_CR;
+				}
+			}
+			return Status::DATA;
+		}
+
+		const char character = octets[offset++];
+		switch (state) {
+			case State::CHUNK_SIZE: {
+				const auto digit = HexadecimalValue(character);
+				if (digit != -1) {
+					if (++sizeDigits > MAGIC_BODY_MAX_CHUNK_SIZE_DIGITS) {
+						Fail(ClientError::INCORRECT_CHUNK);
+					}
+					remaining = remaining * 16 + static_cast<std::size_t>(digit);
+				} else if (sizeDigits == 0) {
+					Fail(ClientError::INCORRECT_CHUNK);
+				} else if (character == ';' || character == ' ' || character == '\t') {
+					state = State::CHUNK_EXTENSION;
+				} else if (character == '\r') {
+					state = State::CHUNK_SIZE_LF;
+				} else {
+					Fail(ClientError::INCORRECT_CHUNK);
+				}
+			} break;
+			case State::CHUNK_EXTENSION:
+				if (character == '\r') {
+					state = State::CHUNK_SIZE_LF;
+				} else if (character == '\n' || ++metadataLength > MAGIC_BODY_MAX_METADATA_LENGTH) {
+					Fail(ClientError::INCORRECT_CHUNK);
+				}
+				break;
+			case State::CHUNK_SIZE_LF:
+				if (character != '\n') {
+					Fail(ClientError::INCORRECT_CHUNK);
+				} else if (remaining == 0) {
+					// The last chunk.
+					state = State::TRAILER_START;
+				} else if (maxLength != 0 && remaining > maxLength - received) {
+					Fail(ClientError::POLICY_TOO_LARGE_BODY);
+				} else {
+					sizeDigits = 0;
+					state = State::CHUNK_DATA;
+				}
+				break;
+			case State::CHUNK_DATA_CR:
+				if (character != '\r') {
+					Fail(ClientError::INCORRECT_CHUNK);
+				}
+				state = State::CHUNK_DATA_LF;
+				break;
+			case State::CHUNK_DATA_LF:
+				if (character != '\n') {
+					Fail(ClientError::INCORRECT_CHUNK);
+				}
+				state = State::CHUNK_SIZE;
+				break;
+			case State::TRAILER_START:
+				if (character == '\r') {
+					state = State::TRAILERS_END_LF;
+					break;
+				}
+				state = State::TRAILER_FIELD;
+				[[fallthrough]];
+			case State::TRAILER_FIELD:
+				if (character == '\r') {
+					state = State::TRAILER_FIELD_LF;
+				} else if (character == '\n' || ++metadataLength > MAGIC_BODY_MAX_METADATA_LENGTH) {
+					Fail(ClientError::INCORRECT_CHUNK);
+				}
+				break;
+			case State::TRAILER_FIELD_LF:
+				if (character != '\n') {
+					Fail(ClientError::INCORRECT_CHUNK);
+				}
+				state = State::TRAILER_START;
+				break;
+			case State::TRAILERS_END_LF:
+				if (character != '\n') {
+					Fail(ClientError::INCORRECT_CHUNK);
+				} else {
+					status = Status::COMPLETE;
+				}
+				break;
+			case State::DATA:
+			case State::CHUNK_DATA:
+				break;
+		}
+	}
+
+	consumed = offset;
+	return status;
+}
+
+void
+BodyReader::Reset() noexcept {
+	framing = BodyFraming::NONE;
+	state = State::DATA;
+	status = Status::COMPLETE;
+	error = ClientError::NO_ERROR;
+	maxLength = 0;
+	contentLength = 0;
+	received = 0;
+	remaining = 0;
+	sizeDigits = 0;
+	metadataLength = 0;
+}
+
+ClientError
+BodyReader::Start(const Request &request, std::size_t limit) noexcept {
+	Reset();
+	maxLength = limit;
+
+	const bool hasContentLength = request.headers.Count(HeaderID::CONTENT_LENGTH) != 0;
+	if (request.headers.Count(HeaderID::TRANSFER_ENCODING) != 0) {
+		// A request with both might be an attempt at request smuggling, and
+		// HTTP/1.0 doesn't have transfer codings.
+		//
+		// Spec: RFC 7230 § 3.3.3
+		auto result = ClientError::INCORRECT_BODY_FRAMING;
+		if (!hasContentLength && request.versionMinor != 0) {
+			result = StartChunked(request);
+		}
+
+		if (result != ClientError::NO_ERROR) {
+			Fail(result);
+			return error;
+		}
+
+		framing = BodyFraming::CHUNKED;
+		state = State::CHUNK_SIZE;
+		status = Status::INCOMPLETE;
+		return ClientError::NO_ERROR;
+	}
+
+	if (!hasContentLength) {
+		return ClientError::NO_ERROR;
+	}
+
+	framing = BodyFraming::CONTENT_LENGTH;
+	if (const auto result = StartContentLength(request); result != ClientError::NO_ERROR) {
+		Fail(result);
+		return error;
+	}
+
+	if (maxLength != 0 && contentLength > maxLength) {
+		Fail(ClientError::POLICY_TOO_LARGE_BODY);
+		return error;
+	}
+
+	remaining = contentLength;
+	status = remaining == 0 ? Status::COMPLETE : Status::INCOMPLETE;
+	return ClientError::NO_ERROR;
+}
+
+ClientError
+BodyReader::StartChunked(const Request &request) noexcept {
+	// The codings are listed in the order they were applied, so chunked has
+	// to be the last one, and can't be applied twice.
+	//
+	// Spec: RFC 7230 § 3.3.1
+	bool chunked = false;
+	bool otherCodings = false;
+	for (const auto &header : request.headers) {
+		if (header.id != HeaderID::TRANSFER_ENCODING) {
+			continue;
+		}
+
+		const bool valid = ForEachElement(header.value, [&](std::string_view coding) {
+			if (chunked) {
+				return false;
+			}
+
+			if (Utils::EqualsIgnoreCase(coding, "chunked")) {
+				chunked = true;
+			} else {
+				otherCodings = true;
+			}
+			return true;
+		});
+
+		if (!valid) {
+			return ClientError::INCORRECT_BODY_FRAMING;
+		}
+	}
+
+	if (!chunked) {
+		return ClientError::INCORRECT_BODY_FRAMING;
+	}
+
+	return otherCodings ? ClientError::UNSUPPORTED_TRANSFER_CODING : ClientError::NO_ERROR;
+}
+
+ClientError
+BodyReader::StartContentLength(const Request &request) noexcept {
+	// A list of the same length, e.g. because a proxy combined the fields,
+	// is accepted.
+	//
+	// Spec: RFC 7230 § 3.3.2
+	bool found = false;
+	auto result = ClientError::NO_ERROR;
+	for (const auto &header : request.headers) {
+		if (header.id != HeaderID::CONTENT_LENGTH) {
+			continue;
+		}
+
+		const bool valid = ForEachElement(header.value, [&](std::string_view element) {
+			std::size_t length{};
+			const char *end = element.data() + element.length();
+			const auto parsed = std::from_chars(element.data(), end, length);
+			if (parsed.ec == std::errc::result_out_of_range) {
+				result = ClientError::POLICY_TOO_LARGE_BODY;
+				return false;
+			}
+
+			if (parsed.ec != std::errc{} || parsed.ptr != end || (found && length != contentLength)) {
+				result = ClientError::INCORRECT_BODY_FRAMING;
+				return false;
+			}
+
+			found = true;
+			contentLength = length;
+			return true;
+		});
+
+		if (!valid) {
+			return result;
+		}
+	}
+
+	return found ? ClientError::NO_ERROR : ClientError::INCORRECT_BODY_FRAMING;
+}
+
+} // namespace HTTP
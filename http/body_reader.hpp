@@ -0,0 +1,170 @@
+#pragma once
+
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include <cstddef>
+
+#include "base/string.hpp"
+#include "http/client_error.hpp"
+#include "http/request.hpp"
+
+namespace HTTP {
+
+// How the length of the body of a request is determined.
+//
+// Spec: RFC 7230 § 3.3.3
+enum class BodyFraming {
+	// The request has no body.
+	NONE,
+
+	// The body is as long as the Content-Length header field says.
+	CONTENT_LENGTH,
+
+	// The body is sent with chunked transfer coding.
+	CHUNKED,
+};
+
+// An incremental decoder of the body of a request. Like the RequestParser,
+// the input can be fed in chunks of arbitrary size, and the decoder can stop
+// and continue at any octet. No data is copied: the parts of the body refer
+// to the input, so the body can be passed on as it is received, without
+// buffering the whole of it.
+//
+// Chunk extensions and trailer fields are discarded.
+class BodyReader {
+public:
+	enum class Status {
+		// The next part of the body has been decoded.
+		DATA,
+
+		// More input is needed.
+		INCOMPLETE,
+
+		// The body has been received completely. Read won't consume any
+		// more input until Start is called.
+		COMPLETE,
+
+		// The framing is malformed, the body is too large, or the connection
+		// ended prematurely. See Error().
+		FAILED,
+	};
+
+	// Determines the framing of the body of [request] from its Content-Length
+	// and Transfer-Encoding header fields. A body can't be larger than
+	// [maxLength] octets, unless it is 0.
+	//
+	// Returns the error, if the framing is invalid or unsupported, or the
+	// announced length is too large
+	[[nodiscard]] ClientError
+	Start(const Request &request, std::size_t maxLength) noexcept;
+
+	// Decodes the body from [input], of which [consumed] octets are used: the
+	// framing up to and including the next part of the body, which [data]
+	// refers to if DATA is returned. Otherwise, all of [input] is consumed
+	// if INCOMPLETE is returned.
+	[[nodiscard]] Status
+	Read(const base::String &input, std::size_t &consumed, base::String &data) noexcept;
+
+	// Should be called when no more input will be received. Will fail the
+	// decoder with FAILED_READ_BODY, unless the body is complete.
+	//
+	// Returns the error
+	[[nodiscard]] ClientError
+	EndOfStream() noexcept;
+
+	// The length announced by the Content-Length header field.
+	[[nodiscard]] inline std::size_t
+	ContentLength() const noexcept {
+		return contentLength;
+	}
+
+	[[nodiscard]] inline ClientError
+	Error() const noexcept {
+		return error;
+	}
+
+	[[nodiscard]] inline BodyFraming
+	Framing() const noexcept {
+		return framing;
+	}
+
+	// Never Status::DATA.
+	[[nodiscard]] inline Status
+	GetStatus() const noexcept {
+		return status;
+	}
+
+	// The amount of octets of the body that have been decoded.
+	[[nodiscard]] inline std::size_t
+	Received() const noexcept {
+		return received;
+	}
+
+	// The amount of octets of the body that are known to follow, i.e. the
+	// rest of the body, or of the current chunk.
+	[[nodiscard]] inline std::size_t
+	Remaining() const noexcept {
+		return remaining;
+	}
+
+	// Forgets the body, as if it were complete.
+	void
+	Reset() noexcept;
+
+private:
+	enum class State {
+		// The body is framed by Content-Length.
+		DATA,
+
+		CHUNK_SIZE,
+		CHUNK_EXTENSION,
+		CHUNK_SIZE_LF,
+		CHUNK_DATA,
+		CHUNK_DATA_CR,
+		CHUNK_DATA_LF,
+		TRAILER_START,
+		TRAILER_FIELD,
+		TRAILER_FIELD_LF,
+		TRAILERS_END_LF,
+	};
+
+	BodyFraming framing{ BodyFraming::NONE };
+	State state{ State::DATA };
+	Status status{ Status::COMPLETE };
+	ClientError error{ ClientError::NO_ERROR };
+
+	std::size_t maxLength{ 0 };
+	std::size_t contentLength{ 0 };
+	std::size_t received{ 0 };
+	std::size_t remaining{ 0 };
+
+	// The amount of hexadecimal digits of the chunk-size that have been
+	// received.
+	std::size_t sizeDigits{ 0 };
+
+	// The amount of octets of chunk extensions and trailer fields that have
+	// been received, which are limited, since they're discarded.
+	std::size_t metadataLength{ 0 };
+
+	inline void
+	Fail(ClientError clientError) noexcept {
+		status = Status::FAILED;
+		error = clientError;
+	}
+
+	// Parses the Content-Length header fields of [request]. Values that are
+	// lists have to consist of the same length.
+	[[nodiscard]] ClientError
+	StartContentLength(const Request &request) noexcept;
+
+	// Parses the Transfer-Encoding header fields of [request], of which the
+	// codings have to end with chunked. Other codings aren't supported.
+	[[nodiscard]] ClientError
+	StartChunked(const Request &request) noexcept;
+};
+
+} // namespace HTTP
@@ -8,17 +8,19 @@
 
 #include <algorithm>
 #include <array>
+#include <charconv>
+#include <functional>
 #include <iterator>
 #include <map>
 #include <memory>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <utility>
 #include <vector>
 
 #include <cctype>
 #include <climits>
-#include <csignal>
 #include <cstdio>
 #include <cstdlib>
 #include <strings.h>
@@ -27,29 +29,56 @@
 #include "base/logger.hpp"
 #include "base/media_type.hpp"
 #include "base/strings.hpp"
+#include "cgi/environment.hpp"
+#include "cgi/exchange.hpp"
 #include "cgi/manager.hpp"
+#include "cgi/proxy.hpp"
 #include "cgi/script.hpp"
+#include "event/clock.hpp"
+#include "http/access_log.hpp"
+#include "http/compressor.hpp"
 #include "http/configuration.hpp"
+#include "http/content_coding.hpp"
+#include "http/date.hpp"
+#include "http/entity_tag.hpp"
+#include "http/metrics.hpp"
+#include "http/range.hpp"
 #include "http/server.hpp"
 #include "http/utils.hpp"
+#include "http/worker.hpp"
+#include "http2/frame.hpp"
+#include "http2/session.hpp"
+#include "io/compression_cache.hpp"
 #include "io/file.hpp"
+#include "io/file_cache.hpp"
 #include "io/file_resolver.hpp"
+#include "posix/unistd.hpp"
 #include "security/policies.hpp"
 
+// The amount of octets of a file compressed at a time, i.e. the input of a
+// chunk of a compressed body.
+#define MAGIC_COMPRESSION_CHUNK_SIZE 16384
+
+// The amount of octets of a mapped file written together with the metadata.
+#define MAGIC_MAPPED_HEAD_SIZE 16384
+
+// The largest body of a request that isn't used which is read and discarded,
+// to keep the connection. Larger ones close the connection, since reading them
+// would cost more than a new connection.
+#define MAGIC_BODY_DRAIN_LIMIT 65536
+
 #define MAGIC_FIELD_NAME_AVG_LENGTH 12
 #define MAGIC_FIELD_VALUE_AVG_LENGTH 30
 // The following aren't really avg, just a blind guess
 #define MAGIC_METHOD_AVG_LENGTH 4
 #define MAGIC_PATH_AVG_LENGTH 8
 
-#define MAGIC_METHOD_MAX_BUFFER_SIZE_ON_RESET MAGIC_METHOD_AVG_LENGTH
-
 //#define SIG_IGN  ((__sighandler_t)  1)
 #undef SIG_IGN
 #define SIG_IGN reinterpret_cast<void (*)(int)>(1)
 
 [[nodiscard]] inline bool
-StringStartsWith(const std::string &string, const std::string &prefix) {
+StringStartsWith(std::string_view string, std::string_view prefix) {
 #ifdef __cpp_lib_starts_ends_with
 	return str.starts_with(str);
 #else
@@ -64,9 +93,58 @@ ClientBuffers::ClientBuffers() noexcept {
 	fieldName.reserve(MAGIC_FIELD_VALUE_AVG_LENGTH);
 }
 
-Client::Client(Server *server, int sock) noexcept :
+Client::Client(Server *server, int sock, Security::AddressLease &&lease) noexcept :
 	connection(std::make_unique<Connection>(sock, server->config().useTransportSecurity)),
-	server(server), thread(&Client::Entrypoint, this) {
+	server(server), parser(server->config().securityPolicies, currentRequest, Connection::receiveBufferSize),
+	addressLease(std::move(lease)) {
+}
+
+Client::Client(Server *server, Worker *worker, int sock, Security::AddressLease &&lease) noexcept :
+	connection(std::make_unique<Connection>(sock, server->config().useTransportSecurity)),
+	server(server), parser(server->config().securityPolicies, currentRequest, Connection::receiveBufferSize),
+	worker(worker), socket(sock), addressLease(std::move(lease)) {
+}
+
+Client::Client(Server *server) noexcept :
+	connection(nullptr), server(server),
+	parser(server->config().securityPolicies, currentRequest, Connection::receiveBufferSize) {
+}
+
+Client::~Client() noexcept = default;
+
+std::unique_ptr<Compressor>
+Client::AcquireCompressor(ContentCoding coding) noexcept {
+	if (worker == nullptr) {
+		return Compressor::Create(coding);
+	}
+
+	return worker->Compressors().Acquire(coding);
+}
+
+void
+Client::AwaitCGI() noexcept {
+	auto &loop = worker->EventLoop();
+
+	// The connection is removed from the loop, since the next request or a
+	// hang-up would be reported over and over until the script has output.
+	loop.Remove(socket);
+	state = State::AWAITING_CGI;
+
+	const auto awaited = pendingCGI->Awaiting();
+	for (std::size_t i = 0; i < awaited.size(); i++) {
+		if (awaited[i].fd == -1) {
+			continue;
+		}
+
+		const auto interest = awaited[i].write ? Event::Interest::read | Event::Interest::write : Event::Interest::read;
+		if (!loop.Add(awaited[i].fd, &cgiHandler, interest)) {
+			CloseEventDriven();
+			return;
+		}
+		cgiDescriptors[i] = awaited[i].fd;
+	}
+
+	ScheduleTimeout();
 }
 
 std::size_t
@@ -92,10 +170,22 @@ Client::CalculateMinLengthRequestTargetAbsoluteForm() const noexcept {
 
 }
 
+bool
+Client::CanCompress(const MediaType &mediaType, std::size_t length) const noexcept {
+	const auto &configuration = server->config();
+	return configuration.compressionEnabled && length >= configuration.compressionMinimumSize &&
+		   mediaType.IsCompressible();
+}
+
 bool
 Client::CheckConnectionLifetime() noexcept {
-	const auto now = std::chrono::high_resolution_clock::now();
-	if ((now - startingTimePoint) >= std::chrono::milliseconds(server->config().securityPolicies.maxConnectionLifetime)) {
+	const auto maxLifetime = server->config().securityPolicies.maxConnectionLifetime;
+	if (maxLifetime == 0) {
+		return true;
+	}
+
+	const auto now = Event::Clock::Now();
+	if ((now - startingTimePoint) >= std::chrono::milliseconds(maxLifetime)) {
 		MarkConnectionClosing();
 		return false;
 	}
@@ -104,33 +194,134 @@ Client::CheckConnectionLifetime() noexcept {
 }
 
 ClientError
-Client::CheckFileLocation(const std::string &path) const noexcept {
-	std::array<char, PATH_MAX> dest{};
-	if (realpath(path.c_str(), dest.data()) == nullptr) {
-		return ClientError::CHECK_FILE_LOCATION_VERIFICATION_FAILURE;
+Client::CheckUpgradeHTTPS() const noexcept {
+	if (server->config().upgradeToHTTPS) {
+		return ClientError::UPGRADE_TO_HTTPS;
+	}
+
+	return ClientError::NO_ERROR;
+}
+
+void
+Client::CloseEventDriven() noexcept {
+	if (state == State::AWAITING_CGI) {
+		RemoveCGIDescriptors();
 	}
+	ResetCGI();
+
+	state = State::CLOSED;
+	worker->Timers().Cancel(*this);
+	worker->EventLoop().Remove(socket);
+	worker->RemoveClient(this);
+}
+
+// Reads [count] octets of [fd] from [offset]. Returns false if the file
+// couldn't be read, or ended early.
+[[nodiscard]] static bool
+ReadFully(int fd, char *buffer, std::size_t count, off_t offset) noexcept {
+	while (count != 0) {
+		const auto result = psx::pread(fd, buffer, count, offset);
+		if (result <= 0) {
+			return false;
+		}
 
-	if (!StringStartsWith(dest.data(), server->config().rootDirectory)) {
-		return ClientError::CHECK_FILE_LOCATION_OUTSIDE_ROOT_DIRECTORY;
+		buffer += result;
+		count -= result;
+		offset += result;
 	}
 
-	return ClientError::NO_ERROR;
+	return true;
 }
 
-ClientError
-Client::CheckUpgradeHTTPS() const noexcept {
-	if (server->config().upgradeToHTTPS) {
-		return ClientError::UPGRADE_TO_HTTPS;
+bool
+Client::ContinueSession() noexcept {
+	connection->Cork();
+
+	// The streams that have been started are completed.
+	const auto maxLifetime = server->config().securityPolicies.maxConnectionLifetime;
+	if (server->IsDraining() ||
+		(maxLifetime != 0 && Event::Clock::Now() - startingTimePoint >= std::chrono::milliseconds(maxLifetime))) {
+		session->GoAway();
 	}
 
-	return ClientError::NO_ERROR;
+	return session->Receive() && session->Send();
 }
 
-void
-Client::Clean() noexcept {
-	connection = nullptr;
+Connection::Status
+Client::ContinueCGI() noexcept {
+	auto &output = buffers.cgi;
+	output.clear();
+
+	const auto status = pendingCGI->Read(output);
+	if (status == CGI::Exchange::Status::WOULD_BLOCK) {
+		return Connection::Status::WOULD_BLOCK;
+	}
+
+	if (status == CGI::Exchange::Status::FAILED) {
+		return FailCGI(Strings::StatusLines::BadGateway, Strings::BadGatewayPage) ?
+			Connection::Status::COMPLETE : Connection::Status::FAILED;
+	}
+
+	std::string_view body(output);
+	if (!cgiHeadSent) {
+		const auto parsed = cgiResponse.Feed(body);
+		if (parsed == CGI::ResponseParser::Status::FAILED ||
+			(parsed == CGI::ResponseParser::Status::INCOMPLETE && status == CGI::Exchange::Status::END)) {
+			Logger::Warning("Client::ContinueCGI", "The CGI script sent a malformed response");
+			return FailCGI(Strings::StatusLines::BadGateway, Strings::BadGatewayPage) ?
+				Connection::Status::COMPLETE : Connection::Status::FAILED;
+		}
+
+		if (parsed == CGI::ResponseParser::Status::INCOMPLETE) {
+			return Connection::Status::COMPLETE;
+		}
+
+		StartCGIResponse();
+		body = cgiResponse.Body();
+	}
+
+	if (cgiRemaining != unknownContentLength) {
+		body = body.substr(0, std::min(body.length(), cgiRemaining));
+		cgiRemaining -= body.length();
+	}
+
+	if (cgiBodyless) {
+		body = {};
+	}
 
-	server->SignalClientDeath(std::move(thread));
+	// The metadata is sent right away, even if there is no body yet.
+	if (status == CGI::Exchange::Status::END) {
+		return FinishCGI(body) ? Connection::Status::COMPLETE : Connection::Status::FAILED;
+	}
+	return response.Write(body) ? Connection::Status::COMPLETE : Connection::Status::FAILED;
+}
+
+std::shared_ptr<const std::string>
+Client::CompressFile(const IO::CachedFile &file, ContentCoding coding) noexcept {
+	auto compressor = AcquireCompressor(coding);
+	if (compressor == nullptr) {
+		return nullptr;
+	}
+
+	auto output = std::make_shared<std::string>();
+	bool success = true;
+
+	if (const auto memory = file.Memory(); !memory.empty()) {
+		success = compressor->Compress(memory, true, *output);
+	} else {
+		std::array<char, MAGIC_COMPRESSION_CHUNK_SIZE> input;
+		const auto size = file.file->Size();
+
+		for (std::size_t offset = 0; success && offset != size;) {
+			const auto length = std::min(size - offset, input.size());
+			success = ReadFully(file.file->Handle(), input.data(), length, static_cast<off_t>(offset)) &&
+					  compressor->Compress(std::string_view(input.data(), length), offset + length == size, *output);
+			offset += length;
+		}
+	}
+
+	ReleaseCompressor(std::move(compressor));
+	return success ? output : nullptr;
 }
 
 ClientError
@@ -163,21 +354,30 @@ Client::ConsumeHeaderField(char firstCharacter) noexcept {
 	std::size_t owsCount = 0;
 
 	/* Consume OWS (Optional Whitespaces) */
-	while (true) {
-		char character; // NOLINT(cppcoreguidelines-init-variables)
-
-		if (!connection->ReadChar(&character)) {
+	bool owsConsumed = false;
+	while (!owsConsumed) {
+		const auto received = connection->Peek();
+		if (received.length() == 0) {
 			return ClientError::FAILED_READ_HEADER_FIELD_GENERIC;
 		}
 
-		if (character != ' ' && character != '\t') {
-			buffers.fieldValue.push_back(character);
-			break;
-		}
+		std::size_t i = 0;
+		for (; i < received.length(); i++) {
+			const char character = received.data()[i];
 
-		if (maxOWS != 0 && ++owsCount > maxOWS) {
-			return ClientError::POLICY_TOO_MANY_OWS;
+			if (character != ' ' && character != '\t') {
+				buffers.fieldValue.push_back(character);
+				owsConsumed = true;
+				break;
+			}
+
+			if (maxOWS != 0 && ++owsCount > maxOWS) {
+				connection->Consume(i + 1);
+				return ClientError::POLICY_TOO_MANY_OWS;
+			}
 		}
+
+		connection->Consume(owsConsumed ? i + 1 : i);
 	}
 
 	/* Consume header-value */
@@ -186,20 +386,23 @@ Client::ConsumeHeaderField(char firstCharacter) noexcept {
 		return subroutineError;
 	}
 
-	/* Store in strings */
-	buffers.fieldName.push_back('\0');
-	buffers.fieldValue.push_back('\0');
+	const auto maxCount = server->config().securityPolicies.maxHeaderCount;
+	if (maxCount != 0 && currentRequest.headers.size() == maxCount) {
+		return ClientError::POLICY_TOO_MANY_HEADERS;
+	}
 
 	/* Trim end of OWS's. */
-	auto spaceIterator = std::find(std::begin(buffers.fieldValue), std::end(buffers.fieldValue), ' ');
-	auto tabIterator = std::find(std::begin(buffers.fieldValue), std::end(buffers.fieldValue), '\t');
-
-	auto endIterator = spaceIterator < tabIterator ? spaceIterator : tabIterator;
+	auto endIterator = std::end(buffers.fieldValue);
+	while (endIterator != std::begin(buffers.fieldValue) &&
+		   (*(endIterator - 1) == ' ' || *(endIterator - 1) == '\t')) {
+		--endIterator;
+	}
 
-	currentRequest.headers.insert({
-		std::string(buffers.fieldName.data()),
-		std::string(std::begin(buffers.fieldValue), endIterator - 1)
-	});
+	const auto name = arena.Copy({ buffers.fieldName.data(), buffers.fieldName.size() });
+	const auto value = arena.Copy({ buffers.fieldValue.data(), static_cast<std::size_t>(endIterator - std::begin(buffers.fieldValue)) });
+	if (!currentRequest.headers.Add({ name, value })) {
+		return ClientError::POLICY_TOO_MANY_HEADERS;
+	}
 
 	// Clear buffers (this won't reset the capacity, e.g. the buffer itself).
 	buffers.fieldName.clear();
@@ -210,38 +413,48 @@ Client::ConsumeHeaderField(char firstCharacter) noexcept {
 
 ClientError
 Client::ConsumeHeaderFieldValue() noexcept {
+	const auto max = server->config().securityPolicies.maxHeaderFieldValueLength;
+
 	/* obs-fold (optional line folding) isn't supported. */
 	while (true) {
-		/* Set next character */
-		char character; // NOLINT(cppcoreguidelines-init-variables)
-
-		if (!connection->ReadChar(&character)) {
+		const auto received = connection->Peek();
+		if (received.length() == 0) {
 			return ClientError::FAILED_READ_HEADER_FIELD_VALUE;
 		}
 
-		if (character == '\r') {
-			if (!connection->ReadChar(&character)) {
-				return ClientError::FAILED_READ_HEADER_NEWLINE;
+		for (std::size_t i = 0; i < received.length(); i++) {
+			const char character = received.data()[i];
+
+			if (character == '\r') {
+				connection->Consume(i + 1);
+
+				char newline; // NOLINT(cppcoreguidelines-init-variables)
+				if (!connection->ReadChar(&newline)) {
+					return ClientError::FAILED_READ_HEADER_NEWLINE;
+				}
+				if (newline != '\n') {
+					return ClientError::INCORRECT_HEADER_FIELD_NEWLINE;
+				}
+				return ClientError::NO_ERROR;
 			}
-			if (character != '\n') {
-				return ClientError::INCORRECT_HEADER_FIELD_NEWLINE;
+
+			auto uc = static_cast<unsigned char>(character);
+			if ((uc >= 0x21 && uc <= 0x7E) || // VCHAR
+				(uc >= 0x80 && uc <= 0xFF) || // obs-text
+				character == ' ' || character == '\t') {	// SP / HTAB
+				buffers.fieldValue.push_back(character);
+			} else {
+				connection->Consume(i + 1);
+				return ClientError::INCORRECT_HEADER_FIELD_VALUE;
 			}
-			return ClientError::NO_ERROR;
-		}
 
-		auto uc = static_cast<unsigned char>(character);
-		if ((uc >= 0x21 && uc <= 0x7E) || // VCHAR
-			(uc >= 0x80 && uc <= 0xFF) || // obs-text
-			character == ' ' || character == '\t') {	// SP / HTAB
-			buffers.fieldValue.push_back(character);
-		} else {
-			return ClientError::INCORRECT_HEADER_FIELD_VALUE;
+			if (max != 0 && buffers.fieldValue.size() == max) {
+				connection->Consume(i + 1);
+				return ClientError::POLICY_TOO_LONG_HEADER_FIELD_VALUE;
+			}
 		}
 
-		const auto max = server->config().securityPolicies.maxHeaderFieldValueLength;
-		if (max != 0 && buffers.fieldValue.size() == max) {
-			return ClientError::POLICY_TOO_LONG_HEADER_FIELD_VALUE;
-		}
+		connection->Consume(received.length());
 	}
 }
 
@@ -250,32 +463,41 @@ Client::ConsumeHeaderFieldName() noexcept {
 	static const std::array unreservedCharacters
 		= { '!', '#', '$', '%', '&', '\'', '*', '+', '-', '.', '^', '_', '`', '|', '~' };
 
-	while (true) {
-		char character; // NOLINT(cppcoreguidelines-init-variables)
+	const auto max = server->config().securityPolicies.maxHeaderFieldNameLength;
 
-		if (!connection->ReadChar(&character)) {
+	while (true) {
+		const auto received = connection->Peek();
+		if (received.length() == 0) {
 			return ClientError::FAILED_READ_HEADER_FIELD_NAME;
 		}
 
-		if (character == ':') {
-			return ClientError::NO_ERROR;
-		}
+		for (std::size_t i = 0; i < received.length(); i++) {
+			const char character = received.data()[i];
 
-		if (std::find(std::begin(unreservedCharacters),
-					  std::end(unreservedCharacters), character)
-			!= std::end(unreservedCharacters) ||
-			(character >= '0' && character <= '9') ||
-			(character >= 'A' && character <= 'Z') ||
-			(character >= 'a' && character <= 'z')) {
-			buffers.fieldName.push_back(std::tolower(character));
-		} else {
-			return ClientError::INCORRECT_HEADER_FIELD_NAME;
-		}
+			if (character == ':') {
+				connection->Consume(i + 1);
+				return ClientError::NO_ERROR;
+			}
+
+			if (std::find(std::begin(unreservedCharacters),
+						  std::end(unreservedCharacters), character)
+				!= std::end(unreservedCharacters) ||
+				(character >= '0' && character <= '9') ||
+				(character >= 'A' && character <= 'Z') ||
+				(character >= 'a' && character <= 'z')) {
+				buffers.fieldName.push_back(std::tolower(character));
+			} else {
+				connection->Consume(i + 1);
+				return ClientError::INCORRECT_HEADER_FIELD_NAME;
+			}
 
-		const auto max = server->config().securityPolicies.maxHeaderFieldNameLength;
-		if (max != 0 && buffers.fieldName.size() == max) {
-			return ClientError::POLICY_TOO_LONG_HEADER_FIELD_NAME;
+			if (max != 0 && buffers.fieldName.size() == max) {
+				connection->Consume(i + 1);
+				return ClientError::POLICY_TOO_LONG_HEADER_FIELD_NAME;
+			}
 		}
+
+		connection->Consume(received.length());
 	}
 }
 
@@ -305,34 +527,29 @@ Client::ConsumeHeaders() noexcept {
 }
 
 ClientError
-Client::CheckHostHeader() noexcept {
-	const std::string *str = nullptr;
-
+Client::CheckHostHeader(const Request &request, const Server &server, bool isLocalhost) noexcept {
 	// The 'Host' header was introduced in HTTP/1.1, so don't check the value
 	// for HTTP/1.0 requests:
-	if (currentRequest.versionMinor == 0) {
+	if (request.versionMinor == 0) {
 		return ClientError::NO_ERROR;
 	}
 
-	for (const auto &pair : currentRequest.headers) {
-		if (pair.first == "Host") {
-			if (str != nullptr) {
-				return ClientError::HOST_HEADER_MANY;
-			}
-
-			str = &pair.second;
-		}
+	if (request.headers.Count(HeaderID::HOST) > 1) {
+		return ClientError::HOST_HEADER_MANY;
 	}
 
-	if (str == nullptr) {
+	const auto *header = request.headers.Find(HeaderID::HOST);
+	if (header == nullptr) {
 		return ClientError::HOST_HEADER_NONE;
 	}
 
+	const std::string_view *str = &header->value;
+
 	auto end = str->find(':');
-	if (end == std::string::npos) {
+	if (end == std::string_view::npos) {
 		end = str->length();
 	} else {
-		std::string_view port(str->c_str() + end + 1);
+		std::string_view port = str->substr(end + 1);
 		if (port.length() == 0 || port.length() > 5) {
 			return ClientError::HOST_HEADER_ILLEGAL_PORT;
 		}
@@ -340,15 +557,15 @@ Client::CheckHostHeader() noexcept {
 			if (c < '0' || c > '9')
 				return ClientError::HOST_HEADER_ILLEGAL_PORT;
 		}
-		if (std::to_string(server->config().port) != port) {
+		if (std::to_string(server.config().port) != port) {
 			return ClientError::HOST_HEADER_INCORRECT_PORT;
 		}
 	}
 
-	std::string_view host(str->c_str(), end);
+	std::string_view host = str->substr(0, end);
 
-	if (host != server->config().hostname) {
-		if (connection->IsLocalhost()) {
+	if (host != server.config().hostname && server.FindVirtualHost(host) == nullptr) {
+		if (isLocalhost) {
 			if (host == "localhost" || host == "127.0.0.1" || host == "0.0.0.0") {
 				return ClientError::NO_ERROR;
 			}
@@ -362,37 +579,47 @@ Client::CheckHostHeader() noexcept {
 
 ClientError
 Client::ConsumeMethod() noexcept {
-	std::vector<char> &buffer = this->currentRequest.method;
+	std::vector<char> &buffer = buffers.method;
 
 	// Reserve 4 octets because GET & POST fit in 4 octets, so no reallocation
 	// is needed.
 	buffer.reserve(MAGIC_METHOD_AVG_LENGTH);
 
-	while (true) {
-		char character = 0;
+	const auto max = server->config().securityPolicies.maxMethodLength;
 
-		if (!connection->ReadChar(&character)) {
+	while (true) {
+		const auto received = connection->Peek();
+		if (received.length() == 0) {
 			return ClientError::FAILED_READ_METHOD;
 		}
 
-		if (character == ' ') {
-			if (buffer.empty()) {
-				return ClientError::EMPTY_METHOD;
+		for (std::size_t i = 0; i < received.length(); i++) {
+			const char character = received.data()[i];
+
+			if (character == ' ') {
+				connection->Consume(i + 1);
+				if (buffer.empty()) {
+					return ClientError::EMPTY_METHOD;
+				}
+				currentRequest.SetMethod({ buffer.data(), buffer.size() });
+				return ClientError::NO_ERROR;
 			}
-			return ClientError::NO_ERROR;
-		}
 
-		// Character validation
-		if (!Utils::IsTokenCharacter(character)) {
-			return ClientError::INCORRECT_METHOD;
-		}
+			// Character validation
+			if (!Utils::IsTokenCharacter(character)) {
+				connection->Consume(i + 1);
+				return ClientError::INCORRECT_METHOD;
+			}
 
-		buffer.push_back(character);
+			buffer.push_back(character);
 
-		const auto max = server->config().securityPolicies.maxMethodLength;
-		if (max != 0 && buffer.size() == max) {
-			return ClientError::POLICY_TOO_LONG_METHOD;
+			if (max != 0 && buffer.size() == max) {
+				connection->Consume(i + 1);
+				return ClientError::POLICY_TOO_LONG_METHOD;
+			}
 		}
+
+		connection->Consume(received.length());
 	}
 }
 
@@ -401,29 +628,38 @@ Client::ConsumePath() noexcept {
 	std::vector<char> buffer;
 	buffer.reserve(MAGIC_PATH_AVG_LENGTH);
 
-	while (true) {
-		char character = 0;
+	const auto max = server->config().securityPolicies.maxRequestTargetLength;
 
-		if (!connection->ReadChar(&character)) {
+	while (true) {
+		const auto received = connection->Peek();
+		if (received.length() == 0) {
 			return ClientError::FAILED_READ_PATH;
 		}
 
-		if (character == ' ') {
-			this->currentRequest.path = std::string(std::begin(buffer), std::end(buffer));
-			return ClientError::NO_ERROR;
-		}
+		for (std::size_t i = 0; i < received.length(); i++) {
+			const char character = received.data()[i];
 
-		// Character validation
-		if (!Utils::IsPathCharacter(character)) {
-			return ClientError::INCORRECT_PATH;
-		}
+			if (character == ' ') {
+				connection->Consume(i + 1);
+				currentRequest.path = arena.Copy({ buffer.data(), buffer.size() });
+				return ClientError::NO_ERROR;
+			}
+
+			// Character validation
+			if (!Utils::IsPathCharacter(character)) {
+				connection->Consume(i + 1);
+				return ClientError::INCORRECT_PATH;
+			}
 
-		buffer.push_back(character);
+			buffer.push_back(character);
 
-		const auto max = server->config().securityPolicies.maxRequestTargetLength;
-		if (max != 0 && buffer.size() == max) {
-			return ClientError::POLICY_TOO_LONG_REQUEST_TARGET;
+			if (max != 0 && buffer.size() == max) {
+				connection->Consume(i + 1);
+				return ClientError::POLICY_TOO_LONG_REQUEST_TARGET;
+			}
 		}
+
+		connection->Consume(received.length());
 	}
 }
 
@@ -458,35 +694,163 @@ Client::ConsumeVersion() noexcept {
 	return ClientError::NO_ERROR;
 }
 
+bool
+Client::IsIdle() noexcept {
+	const std::lock_guard guard(idleMutex);
+	return idle;
+}
+
 void
 Client::Entrypoint() {
-	// Ignore SIGPIPE ~= accessing closed connection
-	std::signal(SIGPIPE, SIG_IGN);
+	// The thread can't be parked, but it is released once the peer has
+	// been silent for too long.
+	const auto maxIdleTime = server->config().securityPolicies.maxIdleTime;
+	if (maxIdleTime != 0 && !connection->SetReceiveTimeout(std::chrono::milliseconds(maxIdleTime))) {
+		Logger::Warning("Client::Entrypoint", "Failed to set the receive timeout");
+	}
 
+	StartStage();
 	if (!connection->Setup(server->config())) {
 		Logger::Error("Client::Entrypoint", "Failed to setup connection!");
-		Clean();
 		return;
 	}
 
-	startingTimePoint = std::chrono::high_resolution_clock::now();
+	// This thread has no loop to update the clock, see Event::Clock.
+	Event::Clock::Update();
+	startingTimePoint = Event::Clock::Now();
+	FinishSetupStage();
+
+	if (connection->NegotiatedProtocol() == "h2" && !StartSession()) {
+		return;
+	}
 
-	bool previousRequestSuccess; // NOLINT(cppcoreguidelines-init-variables)
+	while (true) {
+		if (session != nullptr) {
+			RunSession();
+			break;
+		}
 
-	do {
-		previousRequestSuccess = RunMessageExchange();
+		// See RunEventDrivenExchanges.
+		if (IsPipelining()) {
+			connection->Cork();
+		} else if (connection->FlushSendBacklog() != Connection::Status::COMPLETE || !persistentConnection) {
+			break;
+		}
+
+		Event::Clock::Update();
+		const bool success = RunMessageExchange();
 		ResetExchangeState();
-	} while (previousRequestSuccess && persistentConnection && CheckConnectionLifetime());
 
-	Clean();
+		// A draining server closes the connection after the response, see
+		// Drain.
+		if (!success || !CheckConnectionLifetime() || server->IsDraining()) {
+			MarkConnectionClosing();
+		}
+	}
+}
+
+Connection::Status
+Client::ContinueResponse() noexcept {
+	auto status = connection->FlushSendBacklog();
+
+	// A compressed body is produced a chunk at a time, once the previous
+	// chunk has been sent, so at most a chunk is in the send backlog.
+	while (status == Connection::Status::COMPLETE && pendingCompressor != nullptr) {
+		if (!SendCompressedChunk()) {
+			return Connection::Status::FAILED;
+		}
+		status = response.Flush();
+	}
+
+	// The body of the request is passed to the CGI script before its output
+	// is read. While the script doesn't accept more of it, the output is read
+	// in the meantime, since the script might write it first.
+	if (status == Connection::Status::COMPLETE && forwardingBody) {
+		status = ForwardBody();
+		if (status == Connection::Status::COMPLETE) {
+			status = connection->FlushSendBacklog();
+		} else if (status == Connection::Status::WOULD_BLOCK && cgiInputBlocked) {
+			status = Connection::Status::COMPLETE;
+		}
+	}
+
+	// The output of a CGI script is sent as it is read, so at most a read
+	// is in the send backlog.
+	while (status == Connection::Status::COMPLETE && pendingCGI != nullptr) {
+		const auto cgiStatus = ContinueCGI();
+		if (cgiStatus != Connection::Status::COMPLETE) {
+			return cgiStatus;
+		}
+		status = response.Flush();
+	}
+
+	if (status != Connection::Status::COMPLETE || !pendingFile) {
+		// The backlog of a compressed or a small body has been sent.
+		if (status == Connection::Status::COMPLETE && pendingCGI == nullptr) {
+			FinishStage(Stage::BODY);
+		}
+		return status;
+	}
+
+	if (const auto mapping = pendingFile->file->Mapping(); !mapping.empty()) {
+		const char *data = mapping.data() + pendingFileOffset;
+		status = connection->WriteBody(data, pendingFileRemaining);
+		pendingFileOffset = static_cast<off_t>(data - mapping.data());
+	} else {
+		status = connection->SendFileNonBlocking(pendingFile->file->Handle(), pendingFileOffset, pendingFileRemaining);
+	}
+
+	if (status == Connection::Status::COMPLETE) {
+		pendingFile = nullptr;
+		FinishStage(Stage::BODY);
+	}
+
+	return status;
+}
+
+void
+Client::DetachRequest() noexcept {
+	if (headConsumed) {
+		return;
+	}
+
+	const auto head = connection->Buffered();
+	const auto length = parser.HeadLength();
+	auto *copy = static_cast<char *>(arena.Allocate(length, 1));
+	std::copy_n(head.data(), length, copy);
+	currentRequest.Relocate(head.data(), length, copy);
+
+	connection->Consume(length);
+	headConsumed = true;
+}
+
+bool
+Client::DrainBody() noexcept {
+	base::String data("", 0);
+	std::size_t consumed;
+	BodyReader::Status status;
+	do {
+		status = body.Read(connection->Buffered(), consumed, data);
+		connection->Consume(consumed);
+	} while (status == BodyReader::Status::DATA);
+
+	if (status == BodyReader::Status::INCOMPLETE && body.Received() + body.Remaining() <= MAGIC_BODY_DRAIN_LIMIT) {
+		return false;
+	}
+
+	if (status != BodyReader::Status::COMPLETE) {
+		body.Reset();
+		MarkConnectionClosing();
+	}
+	return true;
 }
 
 ClientError
 Client::ExtractComponentsFromPath() noexcept {
-	std::string path(currentRequest.path);
+	const auto path = currentRequest.path;
 	auto questionMark = path.find('?');
 
-	if (questionMark == std::string::npos) {
+	if (questionMark == std::string_view::npos) {
 		return ClientError::NO_ERROR;
 	}
 
@@ -496,27 +860,146 @@ Client::ExtractComponentsFromPath() noexcept {
 	// application/www-form-data format.
 
 	currentRequest.path = path.substr(0, questionMark);
-	currentRequest.query = path.substr(questionMark + 1, path.length() - 1 - questionMark);
+	currentRequest.query = path.substr(questionMark + 1);
 
 	return ClientError::NO_ERROR;
 }
 
 bool
-Client::HandleFileNotFound() noexcept {
-	static const std::string indexPathTarget("/index.html");
-	const auto *script = server->cgi().Lookup(currentRequest);
+Client::FailCGI(const base::String &statusLine, const base::String &page) noexcept {
+	const bool headSent = cgiHeadSent;
+	const bool bodyless = cgiBodyless;
+	ResetCGI();
+
+	// The metadata can't be taken back.
+	if (headSent) {
+		MarkConnectionClosing();
+		return true;
+	}
 
-	if (script != nullptr) {
-		return ServeCGI(script);
+	SerializeMetadata(statusLine, page.length(), MediaTypes::HTML, nullptr);
+	const base::String metadata(buffers.metadata.data(), buffers.metadata.size());
+	if (bodyless) {
+		return connection->WriteBaseString(metadata);
 	}
+	return connection->WriteBaseStrings({ metadata, page });
+}
+
+bool
+Client::FinishCGI(std::string_view last) noexcept {
+	// The body is delimited by closing the connection, or the script sent
+	// less than it announced.
+	if (!cgiBodyless && !cgiChunked && cgiRemaining != 0) {
+		MarkConnectionClosing();
+	}
+
+	const bool success = response.End(last);
+	ResetCGI();
+	return success;
+}
+
+Connection::Status
+Client::ForwardBody() noexcept {
+	if (cgiInputBlocked) {
+		switch (pendingCGI->Flush()) {
+			case CGI::Exchange::Status::DATA:
+				cgiInputBlocked = false;
+				break;
+			case CGI::Exchange::Status::WOULD_BLOCK:
+				return Connection::Status::WOULD_BLOCK;
+			default:
+				return FailCGI(Strings::StatusLines::BadGateway, Strings::BadGatewayPage) ?
+					Connection::Status::COMPLETE : Connection::Status::FAILED;
+		}
+	}
+
+	while (true) {
+		base::String data("", 0);
+		switch (ReadBody(data)) {
+			case BodyReader::Status::DATA:
+				switch (pendingCGI->WriteBody(std::string_view(data.data(), data.length()))) {
+					case CGI::Exchange::Status::DATA:
+						break;
+					case CGI::Exchange::Status::WOULD_BLOCK:
+						// The rest of the body is left in the connection until
+						// the script accepts more.
+						cgiInputBlocked = true;
+						return Connection::Status::WOULD_BLOCK;
+					default:
+						return FailCGI(Strings::StatusLines::BadGateway, Strings::BadGatewayPage) ?
+							Connection::Status::COMPLETE : Connection::Status::FAILED;
+				}
+				break;
+			case BodyReader::Status::INCOMPLETE:
+				return Connection::Status::WOULD_BLOCK;
+			case BodyReader::Status::COMPLETE:
+				forwardingBody = false;
+				if (!pendingCGI->EndBody()) {
+					return FailCGI(Strings::StatusLines::BadGateway, Strings::BadGatewayPage) ?
+						Connection::Status::COMPLETE : Connection::Status::FAILED;
+				}
+				return Connection::Status::COMPLETE;
+			case BodyReader::Status::FAILED: {
+				// The request may have been reset already, so the error
+				// response replaces the response of the script instead of
+				// going through RecoverError.
+				const auto error = body.Error();
+				if (auto *metrics = server->config().metrics) {
+					metrics->Count(error);
+				}
+
+				MarkConnectionClosing();
+				if (error == ClientError::FAILED_READ_BODY) {
+					ResetCGI();
+					return Connection::Status::FAILED;
+				}
+
+				const bool tooLarge = error == ClientError::POLICY_TOO_LARGE_BODY;
+				return FailCGI(tooLarge ? Strings::StatusLines::PayloadTooLarge : Strings::StatusLines::BadRequest,
+							   tooLarge ? Strings::BadRequestMessages::BodyTooLarge : Strings::BadRequestMessages::MalformedBody) ?
+					Connection::Status::COMPLETE : Connection::Status::FAILED;
+			}
+		}
+	}
+}
+
+bool
+Client::HandleFileNotFound() noexcept {
+	static const std::string indexPathTarget("/index.html");
 
 	if (StringStartsWith(indexPathTarget, currentRequest.path)) {
 		return ServeDefaultPage();
 	}
-	ErrorReporter::ReportError(ErrorReporter::Error::FILE_NOT_FOUND, "Path='" + currentRequest.path + '\'');
+	ErrorReporter::ReportError(ErrorReporter::Error::FILE_NOT_FOUND, "Path='" + std::string(currentRequest.path) + '\'');
 	return RecoverErrorFileNotFound();
 }
 
+// Writes the Content-Range header field for [range] of a representation of
+// [size] octets, or for an unsatisfied range if [range] is nullptr. Returns
+// the end of the output.
+//
+// Spec: RFC 7233 § 4.2
+static char *
+FormatContentRange(char *output, const ByteRange *range, std::size_t size) noexcept {
+	constexpr std::size_t maxLength = 96;
+	const std::string_view name("Content-Range: bytes ");
+	auto *end = std::copy(std::cbegin(name), std::cend(name), output);
+
+	if (range == nullptr) {
+		*end++ = '*';
+	} else {
+		end = std::to_chars(end, output + maxLength, range->first).ptr;
+		*end++ = '-';
+		end = std::to_chars(end, output + maxLength, range->last).ptr;
+	}
+
+	*end++ = '/';
+	end = std::to_chars(end, output + maxLength, size).ptr;
+	*end++ = '\r';
+	*end++ = '\n';
+	return end;
+}
+
 ClientError
 Client::HandleRequest() noexcept {
 	const auto maxRequests = server->config().securityPolicies.maxRequestsPerConnection;
@@ -525,58 +1008,421 @@ Client::HandleRequest() noexcept {
 		return ClientError::TOO_MANY_REQUESTS_PER_THIS_CONNECTION;
 	}
 
-	const auto resolveResult = server->fileResolver.Resolve(currentRequest);
-	const auto &status = resolveResult.first;
-	const auto &file = resolveResult.second;
-
-	if (status == IO::FileResolveStatus::NOT_FOUND) {
-		return ClientError::FILE_NOT_FOUND;
+	if (IsMetricsRequest()) {
+		stageStart = {};
+		return ServeMetrics() ? ClientError::NO_ERROR : ClientError::FAILED_WRITE_RESPONSE_METADATA;
 	}
 
-	if (status == IO::FileResolveStatus::INSUFFICIENT_PERMISSIONS) {
-		return ClientError::FILE_READ_INSUFFICIENT_PERMISSIONS;
+	// Routed paths are served by their scripts, without looking them up in
+	// the file system first. The scripts aren't timed.
+	if (const auto *script = server->cgi().Lookup(currentRequest)) {
+		stageStart = {};
+		return ServeCGI(script) ? ClientError::NO_ERROR : ClientError::FAILED_WRITE_RESPONSE_METADATA;
 	}
 
-	if (status == IO::FileResolveStatus::FILE_SYSTEM_OVERLOAD) {
-		return ClientError::FILE_SYSTEM_OVERLOAD;
+	IO::FileResolveStatus status;
+	std::shared_ptr<const std::string> listing;
+	auto cachedFile = server->ResolveFile(currentRequest, status, &listing);
+	EndStage(Stage::RESOLVE);
+	switch (status) {
+		case IO::FileResolveStatus::OK:
+			break;
+		case IO::FileResolveStatus::NOT_FOUND:
+			// A directory without an index, see Configuration::autoIndex.
+			if (listing != nullptr) {
+				return ServeStringRequest(Strings::StatusLines::OK, MediaTypes::HTML,
+										  base::String(listing->data(), listing->length()))
+					? ClientError::NO_ERROR : ClientError::FAILED_WRITE_RESPONSE_BODY;
+			}
+			return ClientError::FILE_NOT_FOUND;
+		case IO::FileResolveStatus::INSUFFICIENT_PERMISSIONS:
+			return ClientError::FILE_READ_INSUFFICIENT_PERMISSIONS;
+		case IO::FileResolveStatus::FILE_SYSTEM_OVERLOAD:
+			return ClientError::FILE_SYSTEM_OVERLOAD;
+		case IO::FileResolveStatus::OUTSIDE_ROOT_DIRECTORY:
+			return ClientError::CHECK_FILE_LOCATION_OUTSIDE_ROOT_DIRECTORY;
 	}
 
-	auto error = CheckFileLocation(file->Path());
-	if (error != ClientError::NO_ERROR) {
-		return error;
+	// A precompressed sibling is a variant with its own validators and size,
+	// so the conditionals and ranges below apply to the selected variant.
+	//
+	// Spec: RFC 7231 § 5.3.4
+	const bool hasEncodings = cachedFile->HasEncodings();
+	if (hasEncodings) {
+		if (const auto *acceptEncoding = currentRequest.headers.Find(HeaderID::ACCEPT_ENCODING)) {
+			const auto coding = AcceptEncoding::Parse(acceptEncoding->value).Select([&cachedFile](ContentCoding coding) {
+				return cachedFile->encodings[static_cast<std::size_t>(coding)] != nullptr;
+			});
+			if (coding != ContentCoding::IDENTITY) {
+				auto encoded = cachedFile->encodings[static_cast<std::size_t>(coding)];
+				cachedFile = std::move(encoded);
+			}
+		}
 	}
 
-	if (!SendMetadata(Strings::StatusLines::OK, file->Size(), server->config().mediaTypeFinder.DetectMediaType(file))) {
-		return ClientError::FAILED_WRITE_RESPONSE_METADATA;
+	const auto size = cachedFile->file->Size();
+
+	// Files without precompressed siblings are compressed on the fly, unless
+	// a part of the file is requested.
+	const bool compressible = !hasEncodings && CanCompress(*cachedFile->mediaType, size);
+	if (compressible && currentRequest.headers.Find(HeaderID::RANGE) == nullptr) {
+		ClientError error;
+		if (TryServeCompressedFile(cachedFile, error)) {
+			return error;
+		}
 	}
 
-	if (!currentRequest.IsHead() &&
-		!connection->SendFile(file->Handle(), file->Size())) {
-		perror("HandleRequest");
-		return ClientError::FAILED_WRITE_RESPONSE_BODY;
+	// Enough for Accept-Ranges, the validators, Vary, Content-Encoding and
+	// Content-Range.
+	std::array<char, 384> additional;
+	const std::string_view acceptRanges("Accept-Ranges: bytes\r\n");
+	const auto &validators = cachedFile->validatorHeaders;
+	auto *additionalEnd = std::copy(std::cbegin(acceptRanges), std::cend(acceptRanges), additional.data());
+	additionalEnd = std::copy(std::cbegin(validators), std::cend(validators), additionalEnd);
+
+	if (hasEncodings || compressible) {
+		const std::string_view vary("Vary: Accept-Encoding\r\n");
+		additionalEnd = std::copy(std::cbegin(vary), std::cend(vary), additionalEnd);
 	}
 
-	return ClientError::NO_ERROR;
-}
+	if (cachedFile->coding != ContentCoding::IDENTITY) {
+		const std::string_view contentEncoding("Content-Encoding: ");
+		const auto name = ContentCodingName(cachedFile->coding);
+		additionalEnd = std::copy(std::cbegin(contentEncoding), std::cend(contentEncoding), additionalEnd);
+		additionalEnd = std::copy(std::cbegin(name), std::cend(name), additionalEnd);
+		*additionalEnd++ = '\r';
+		*additionalEnd++ = '\n';
+	}
 
-void
-Client::InterpretConnectionHeaders() noexcept {
-	if (persistentConnection) {
-		auto header = currentRequest.headers.find("connection");
-		if (header != std::end(currentRequest.headers) &&
-			strcasecmp(header->second.c_str(), "close") == 0) {
-			MarkConnectionClosing();
-		}
+	if (IsNotModified(currentRequest, cachedFile->entityTag, cachedFile->file->ModificationTime())) {
+		*additionalEnd = '\0';
+		SerializeMetadata(Strings::StatusLines::NotModified, size, *cachedFile->mediaType, additional.data());
+		return connection->WriteBaseString(base::String(buffers.metadata.data(), buffers.metadata.size()))
+			? ClientError::NO_ERROR : ClientError::FAILED_WRITE_RESPONSE_METADATA;
 	}
-}
 
-void
-Client::MarkConnectionClosing() noexcept {
+	ByteRange range{ 0, size - 1 };
+
+	const base::String *statusLine = &Strings::StatusLines::OK;
+	switch (SelectRange(*cachedFile, range)) {
+		case RangeStatus::IGNORED:
+			range = { 0, size - 1 };
+			break;
+		case RangeStatus::SATISFIABLE:
+			statusLine = &Strings::StatusLines::PartialContent;
+			additionalEnd = FormatContentRange(additionalEnd, &range, size);
+			break;
+		case RangeStatus::UNSATISFIABLE:
+			*FormatContentRange(additional.data(), nullptr, size) = '\0';
+			SerializeMetadata(Strings::StatusLines::RangeNotSatisfiable, 0, *cachedFile->mediaType, additional.data());
+			return connection->WriteBaseString(base::String(buffers.metadata.data(), buffers.metadata.size()))
+				? ClientError::NO_ERROR : ClientError::FAILED_WRITE_RESPONSE_METADATA;
+	}
+	*additionalEnd = '\0';
+
+	// The range of an empty file is { 0, -1 }, i.e. zero octets.
+	const auto length = range.Length();
+	SerializeMetadata(*statusLine, length, *cachedFile->mediaType, additional.data());
+	const base::String metadata(buffers.metadata.data(), buffers.metadata.size());
+
+	if (currentRequest.IsHead()) {
+		return connection->WriteBaseString(metadata) ? ClientError::NO_ERROR : ClientError::FAILED_WRITE_RESPONSE_METADATA;
+	}
+
+	// Files kept in memory are sent like string responses.
+	if (cachedFile->hasContents) {
+		if (!connection->WriteBaseStrings({ metadata, base::String(cachedFile->contents.data() + range.first, length) })) {
+			return ClientError::FAILED_WRITE_RESPONSE_BODY;
+		}
+		return ClientError::NO_ERROR;
+	}
+
+	// A mapped file is written from memory as well, its first part together
+	// with the metadata.
+	const auto mapping = cachedFile->file->Mapping();
+	const auto head = mapping.empty() ? 0 : std::min<std::size_t>(length, MAGIC_MAPPED_HEAD_SIZE);
+	if (!connection->WriteBaseStrings({ metadata, base::String(mapping.data() + (head == 0 ? 0 : range.first), head) })) {
+		return ClientError::FAILED_WRITE_RESPONSE_METADATA;
+	}
+
+	if (!SendFileBody(cachedFile, static_cast<off_t>(range.first + head), length - head)) {
+		perror("HandleRequest");
+		return ClientError::FAILED_WRITE_RESPONSE_BODY;
+	}
+
+	return ClientError::NO_ERROR;
+}
+
+bool
+Client::HandleSetupStatus(Connection::Status status) noexcept {
+	switch (status) {
+		case Connection::Status::COMPLETE:
+			state = State::EXCHANGE;
+			startingTimePoint = Event::Clock::Now();
+			FinishSetupStage();
+			if (connection->NegotiatedProtocol() == "h2" && !StartSession()) {
+				break;
+			}
+			return true;
+		case Connection::Status::WOULD_BLOCK:
+			UpdateInterest(connection->WantsWrite() ? Event::Interest::write : Event::Interest::read);
+			ScheduleTimeout();
+			return false;
+		case Connection::Status::FAILED:
+			break;
+	}
+
+	Logger::Error("Client::HandleSetupStatus", "Failed to setup connection!");
+	CloseEventDriven();
+	return false;
+}
+
+bool
+Client::IsNotModified(const Request &request, std::string_view entityTag, std::time_t modificationTime) noexcept {
+	if (request.methodID != MethodID::GET && !request.IsHead()) {
+		return false;
+	}
+
+	// If-Modified-Since is ignored when If-None-Match is present, since the
+	// entity-tag is more accurate.
+	//
+	// Spec: RFC 7232 § 6
+	if (const auto *ifNoneMatch = request.headers.Find(HeaderID::IF_NONE_MATCH)) {
+		return EntityTag::MatchesListWeakly(ifNoneMatch->value, entityTag);
+	}
+
+	if (const auto *ifModifiedSince = request.headers.Find(HeaderID::IF_MODIFIED_SINCE)) {
+		std::time_t date;
+		return ParseDate(ifModifiedSince->value, date) && modificationTime <= date;
+	}
+
+	return false;
+}
+
+void
+Client::InterpretConnectionHeaders() noexcept {
+	if (server->IsDraining()) {
+		MarkConnectionClosing();
+	}
+
+	if (persistentConnection) {
+		const auto *header = currentRequest.headers.Find(HeaderID::CONNECTION);
+		if (header != nullptr && Utils::EqualsIgnoreCase(header->value, "close")) {
+			MarkConnectionClosing();
+		}
+	}
+}
+
+bool
+Client::IsPipelining() noexcept {
+	if (!persistentConnection || pendingFile != nullptr || pendingCompressor != nullptr || pendingCGI != nullptr ||
+		body.GetStatus() == BodyReader::Status::INCOMPLETE ||
+		connection->SendBacklogSize() >= Connection::corkedBacklogSize) {
+		return false;
+	}
+
+	return parser.Feed(connection->Buffered()) != RequestParser::Status::INCOMPLETE;
+}
+
+void
+Client::MarkConnectionClosing() noexcept {
 	persistentConnection = false;
 }
 
+void
+Client::CGIHandler::OnEvent(std::uint32_t) noexcept {
+	client->OnCGIEvent();
+}
+
+void
+Client::OnCGIEvent() noexcept {
+	if (state != State::AWAITING_CGI) {
+		return;
+	}
+
+	if (!StopAwaitingCGI()) {
+		CloseEventDriven();
+		return;
+	}
+
+	RunEventDrivenExchanges();
+}
+
+void
+Client::OnEvent(std::uint32_t) noexcept {
+	if (state == State::CLOSED || state == State::SETUP_OFFLOADED || state == State::AWAITING_CGI) {
+		return;
+	}
+
+	if (state == State::SETUP) {
+		if (OffloadSetup() || !HandleSetupStatus(connection->ContinueSetup(server->config()))) {
+			return;
+		}
+	}
+
+	RunEventDrivenExchanges();
+}
+
+void
+Client::Drain() noexcept {
+	// These check whether the server drains once they continue.
+	if (state != State::EXCHANGE) {
+		return;
+	}
+
+	// Sends the GOAWAY frame, see ContinueSession.
+	if (session != nullptr) {
+		RunEventDrivenExchanges();
+		return;
+	}
+
+	// Idle between requests, see ScheduleTimeout. The others announce that
+	// the connection closes with their response, see
+	// InterpretConnectionHeaders.
+	if (pendingFile == nullptr && pendingCompressor == nullptr && pendingCGI == nullptr &&
+		!connection->HasSendBacklog() && connection->Buffered().length() == 0 &&
+		body.GetStatus() != BodyReader::Status::INCOMPLETE) {
+		CloseEventDriven();
+	}
+}
+
+void
+Client::OnTimeout() noexcept {
+	// An offloaded step of the handshake still refers to this client.
+	if (state == State::CLOSED || state == State::SETUP_OFFLOADED) {
+		return;
+	}
+
+	// The script took too long.
+	if (state == State::AWAITING_CGI) {
+		if (!StopAwaitingCGI() || !FailCGI(Strings::StatusLines::GatewayTimeout, Strings::GatewayTimeoutPage)) {
+			CloseEventDriven();
+			return;
+		}
+
+		RunEventDrivenExchanges();
+		return;
+	}
+
+	CloseEventDriven();
+}
+
+bool
+Client::OffloadSetup() noexcept {
+	auto *pool = server->CryptoPool();
+	if (pool == nullptr) {
+		return false;
+	}
+
+	auto *loop = &worker->EventLoop();
+	std::function<void()> task = [this, loop] {
+		const auto status = connection->ContinueSetup(server->config());
+		loop->Post([this, status] { OnSetupOffloaded(status); });
+	};
+
+	// The connection is removed from the loop, since a hang-up would be
+	// reported over and over until the step is done.
+	loop->Remove(socket);
+	state = State::SETUP_OFFLOADED;
+	worker->Timers().Cancel(*this);
+
+	if (!pool->TrySubmit(task)) {
+		state = State::SETUP;
+		if (!loop->Add(socket, this, Event::Interest::read)) {
+			CloseEventDriven();
+			return true;
+		}
+		return false;
+	}
+
+	return true;
+}
+
+void
+Client::OnSetupOffloaded(Connection::Status status) noexcept {
+	state = State::SETUP;
+	if (!worker->EventLoop().Add(socket, this, Event::Interest::read)) {
+		CloseEventDriven();
+		return;
+	}
+
+	if (HandleSetupStatus(status)) {
+		RunEventDrivenExchanges();
+	}
+}
+
+ClientError
+Client::ParseRequest() noexcept {
+	// The rest of the body of the previous request comes first.
+	while (!DrainBody()) {
+		if (!connection->FillReceiveBuffer()) {
+			return parser.EndOfStream();
+		}
+	}
+
+	// The stage starts with the first octets of the head, not when the
+	// connection is waiting for the next request.
+	if (connection->Buffered().length() == 0 && !WaitForRequest()) {
+		return parser.EndOfStream();
+	}
+	StartStage();
+
+	// The head isn't consumed until ResetExchangeState, so the parser can
+	// refer to the receive buffer.
+	while (parser.Feed(connection->Buffered()) == RequestParser::Status::INCOMPLETE) {
+		if (!connection->FillReceiveBuffer()) {
+			return parser.EndOfStream();
+		}
+	}
+
+	return parser.Error();
+}
+
+BodyReader::Status
+Client::ReadBody(base::String &data) noexcept {
+	// Spec: RFC 7231 § 5.1.1
+	// The peer might have sent (a part of) the body without waiting.
+	if (expectsContinue) {
+		expectsContinue = false;
+		if (connection->Buffered().length() == 0) {
+			if (!connection->WriteBaseStrings({ Strings::StatusLines::Continue, base::String("\r\n\r\n", 4) })) {
+				static_cast<void>(body.EndOfStream());
+				return body.GetStatus();
+			}
+
+			if (connection->HasSendBacklog()) {
+				return BodyReader::Status::INCOMPLETE;
+			}
+		}
+	}
+
+	while (true) {
+		std::size_t consumed;
+		const auto status = body.Read(connection->Buffered(), consumed, data);
+		connection->Consume(consumed);
+		if (status != BodyReader::Status::INCOMPLETE) {
+			return status;
+		}
+
+		if (!connection->FillReceiveBuffer()) {
+			if (connection->WouldBlock()) {
+				return BodyReader::Status::INCOMPLETE;
+			}
+
+			static_cast<void>(body.EndOfStream());
+			return body.GetStatus();
+		}
+	}
+}
+
 bool
 Client::RecoverError(ClientError error) noexcept {
+	// The responses to errors aren't timed.
+	stageStart = {};
+	if (auto *metrics = server->config().metrics) {
+		metrics->Count(error);
+	}
+
 	if (!CheckConnectionLifetime()) {
 		return false;
 	}
@@ -586,65 +1432,33 @@ Client::RecoverError(ClientError error) noexcept {
 			return HandleFileNotFound();
 		case ClientError::FILE_READ_INSUFFICIENT_PERMISSIONS:
 			return RecoverErrorFileReadInsufficientPermissions();
-		case ClientError::EMPTY_METHOD:
-			return RecoverErrorBadRequest(Strings::BadRequestMessages::EmptyMethod);
-
-		case ClientError::INCORRECT_HEADER_FIELD_NAME:
-			return RecoverErrorBadRequest("invalid header field-name");
-		case ClientError::INCORRECT_HEADER_FIELD_NEWLINE:
-			return RecoverErrorBadRequest("expected newline (CRLF) after header field");
-		case ClientError::INCORRECT_HEADER_FIELD_VALUE:
-			return RecoverErrorBadRequest("invalid header field-value");
-
-		case ClientError::INCORRECT_METHOD:
-			return RecoverErrorBadRequest("invalid method: not a token as per RFC 7230 section 3.2.6");
-		case ClientError::INCORRECT_PATH:
-			return RecoverErrorBadRequest("incorrect request-target");
-		case ClientError::INCORRECT_CRLF:
-			return RecoverErrorBadRequest("request-line should end with a newline (CRLF)");
-		case ClientError::INCORRECT_VERSION:
-			return RecoverErrorBadRequest("invalid HTTP version as per RFC 7230 section 2.6");
-
-		case ClientError::INVALID_PATH_EMPTY:
-			return RecoverErrorBadRequest("request-target was empty");
-		case ClientError::INVALID_PATH_NOT_ABSOLUTE:
-			return RecoverErrorBadRequest("only origin-form and absolute-form request-targets are supported");
-		case ClientError::INCORRECT_PATH_ABSOLUTE_FORM:
-			return RecoverErrorBadRequest("absolute-form request-target in invalid form");
-
-		case ClientError::HOST_HEADER_ILLEGAL_PORT:
-			return RecoverErrorBadRequest("'Host' header port component isn't a number");
-		case ClientError::HOST_HEADER_INCORRECT:
-			return RecoverErrorBadRequest("incorrect 'Host' header field-value");
-		case ClientError::HOST_HEADER_INCORRECT_PORT:
-			return RecoverErrorBadRequest("incorrect 'Host' header port component");
-		case ClientError::HOST_HEADER_MANY:
-			return RecoverErrorBadRequest("more than one 'Host' header supplied");
-		case ClientError::HOST_HEADER_NONE:
-			return RecoverErrorBadRequest("no 'Host' header supplied");
-
-		case ClientError::POLICY_TOO_LONG_HEADER_FIELD_NAME:
-			return ServeStringRequest(Strings::StatusLines::PayloadTooLarge, MediaTypes::TEXT, Strings::BadRequestMessages::HeaderFieldNameTooLong);
-		case ClientError::POLICY_TOO_LONG_HEADER_FIELD_VALUE:
-			return ServeStringRequest(Strings::StatusLines::PayloadTooLarge, MediaTypes::TEXT, Strings::BadRequestMessages::HeaderFieldValueTooLong);
-		case ClientError::POLICY_TOO_LONG_METHOD:
-			return ServeStringRequest(Strings::StatusLines::PayloadTooLarge, MediaTypes::TEXT, Strings::BadRequestMessages::MethodTooLong);
-		case ClientError::POLICY_TOO_LONG_REQUEST_TARGET:
-			return ServeStringRequest(Strings::StatusLines::URITooLong, MediaTypes::TEXT, Strings::BadRequestMessages::RequestTargetTooLong);
-		case ClientError::POLICY_TOO_MANY_OWS:
-			return ServeStringRequest(Strings::StatusLines::PayloadTooLarge, MediaTypes::TEXT, Strings::BadRequestMessages::TooManyOWSs);
-
-		case ClientError::TOO_MANY_REQUESTS_PER_THIS_CONNECTION:
-			return ServeStringRequest(Strings::StatusLines::TooManyRequests, MediaTypes::HTML, Strings::TooManyRequestsPage);;
-		case ClientError::UPGRADE_TO_HTTPS:
+		case ClientError::UPGRADE_TO_HTTPS: {
+			// The connection is closed, since the client should use HTTPS.
 			MarkConnectionClosing();
-			return SendMetadata(Strings::StatusLines::MovedPermanently, 0, MediaTypes::HTML, ("Location: https://" + server->config().hostname + currentRequest.path + "\r\n").c_str()) && false;
-
-		case ClientError::FILE_SYSTEM_OVERLOAD:
-			return ServeStringRequest(Strings::StatusLines::ServiceUnavailable, MediaTypes::HTML, Strings::FileSystemOverloadPage);
-		case ClientError::UNSUPPORTED_VERSION:
-			return ServeStringRequest(Strings::StatusLines::HTTPVersionNotSupported, MediaTypes::TEXT, Strings::VersionNotSupportedPage);
+			LogAccess(std::string_view(Strings::StatusLines::MovedPermanently.data(),
+									   Strings::StatusLines::MovedPermanently.length()), 0);
+			EndStage(Stage::METADATA);
+
+			// The Date header field follows the status line.
+			const auto &head = server->UpgradeResponseHead();
+			const auto statusLength = Strings::StatusLines::MovedPermanently.length();
+			const auto date = CurrentDateHeader();
+			const auto &hostname = server->FindSite(currentRequest).hostname;
+			const auto &path = currentRequest.path;
+			static_cast<void>(connection->WriteBaseStrings({ base::String(head.data(), statusLength),
+															  base::String(date.data(), date.length()),
+															  base::String(head.data() + statusLength, head.length() - statusLength),
+															  base::String(hostname.data(), hostname.length()),
+															  base::String(path.data(), path.length()),
+															  base::String("\r\n\r\n", 4) }));
+
+			// The connection is closed after the redirect to HTTPS.
+			return false;
+		}
 		default:
+			if (server->FindErrorResponse(error) != nullptr) {
+				return ServeErrorResponse(error);
+			}
 			break;
 	}
 
@@ -655,84 +1469,299 @@ Client::RecoverError(ClientError error) noexcept {
 }
 
 bool
-Client::RecoverErrorBadRequest(const base::String &message) noexcept {
-	// TODO this works, but isn't really nice.
-	const char prefix[] = "Malformed request: ";
-	std::vector<char> buf(19 + message.length() + 1);
-	std::copy(std::begin(prefix), std::end(prefix) - 1, std::begin(buf));
-	std::copy(std::begin(message), std::end(message), std::begin(buf) + sizeof(prefix) - 1);
-	buf.at(message.length() + 19) = '\0';
+Client::RecoverErrorFileNotFound() noexcept {
+	return ServeErrorResponse(ClientError::FILE_NOT_FOUND);
+}
+
+bool
+Client::RecoverErrorFileReadInsufficientPermissions() noexcept {
+	ErrorReporter::ReportError(ErrorReporter::Error::FILE_READ_INSUFFICIENT_PERMISSIONS, "Path='" + std::string(currentRequest.path) + '\'');
+	return ServeErrorResponse(ClientError::FILE_READ_INSUFFICIENT_PERMISSIONS);
+}
 
-	// Because the request parsing has abruptly failed, the connection is
-	// useless.
-	MarkConnectionClosing();
+void
+Client::Release() noexcept {
+	connection->Close();
+	if (worker != nullptr) {
+		worker->Timers().Cancel(*this);
+	}
 
-	return ServeStringRequest(Strings::StatusLines::BadRequest, MediaTypes::TEXT, base::String(buf.data(), buf.size()));
+	if (pendingCompressor != nullptr) {
+		ReleaseCompressor(std::move(pendingCompressor));
+	}
+	pendingFile = nullptr;
+	pendingFileOffset = 0;
+	pendingFileRemaining = 0;
+
+	session = nullptr;
+	ResetCGI();
+	cgiAccessRecord.clear();
+	body.Reset();
+	headConsumed = false;
+	expectsContinue = false;
+	stageStart = {};
+	addressLease.Reset();
+
+	parser.Reset();
+	currentRequest.Reset();
+	arena.Reset();
+	buffers.fieldName.clear();
+	buffers.fieldValue.clear();
+	buffers.method.clear();
+	buffers.metadata.clear();
+	std::string().swap(buffers.compressed);
+
+	persistentConnection = true;
+	receivingHead = false;
+	requestCount = 0;
+	handle = {};
+	socket = -1;
+	state = State::SETUP;
 }
 
-bool
-Client::RecoverErrorFileNotFound() noexcept {
-	return ServeStringRequest(Strings::StatusLines::NotFound, MediaTypes::HTML, Strings::NotFoundPage);
+void
+Client::ReleaseCompressor(std::unique_ptr<Compressor> compressor) noexcept {
+	if (worker != nullptr) {
+		worker->Compressors().Release(std::move(compressor));
+	}
 }
 
-bool
-Client::RecoverErrorFileReadInsufficientPermissions() noexcept {
-	ErrorReporter::ReportError(ErrorReporter::Error::FILE_READ_INSUFFICIENT_PERMISSIONS, "Path='" + currentRequest.path + '\'');
-	return ServeStringRequest(Strings::StatusLines::Forbidden, MediaTypes::HTML, Strings::ForbiddenPage);
+void
+Client::RemoveCGIDescriptors() noexcept {
+	for (auto &fd : cgiDescriptors) {
+		if (fd != -1) {
+			worker->EventLoop().Remove(fd);
+			fd = -1;
+		}
+	}
+}
+
+void
+Client::ResetCGI() noexcept {
+	pendingCGI = nullptr;
+	response.Reset();
+	cgiResponse.Reset();
+	cgiHeadSent = false;
+	cgiBodyless = false;
+	cgiChunked = false;
+	cgiRemaining = unknownContentLength;
+
+	// The rest of the body is drained instead.
+	forwardingBody = false;
+	cgiInputBlocked = false;
 }
 
 void
 Client::ResetExchangeState() noexcept {
+	if (connection != nullptr) {
+		if (!headConsumed) {
+			connection->Consume(parser.HeadLength());
+		}
+
+		// A peer awaiting 100 (Continue) might not send the body at all
+		// after the final response.
+		//
+		// Spec: RFC 7231 § 5.1.1
+		if (!forwardingBody) {
+			if (expectsContinue && connection->Buffered().length() == 0) {
+				body.Reset();
+				MarkConnectionClosing();
+			}
+			expectsContinue = false;
+			static_cast<void>(DrainBody());
+		}
+	}
+	headConsumed = false;
+	parser.Reset();
+	currentRequest.Reset();
+	arena.Reset();
+	receivingHead = false;
+
 	const auto maxRequests = server->config().securityPolicies.maxRequestsPerConnection;
 	if (server->config().securityPolicies.maxRequestsCloseImmediately && maxRequests != 0 && ++requestCount >= maxRequests) {
 		// Close the connection.
 		MarkConnectionClosing();
-		return;
 	}
+}
 
-	/* Keep capacity but remove contents */
-	if (this->currentRequest.method.capacity() > MAGIC_METHOD_MAX_BUFFER_SIZE_ON_RESET) {
-		// How can we optimize this?
-		// I want to reserve() but backwards.
-		this->currentRequest.method.resize(MAGIC_METHOD_MAX_BUFFER_SIZE_ON_RESET, 0);
-		this->currentRequest.method.clear();
-	} else {
-		this->currentRequest.method.clear();
+void
+Client::Reuse(int sock, Security::AddressLease &&lease) noexcept {
+	connection->Reopen(sock);
+	socket = sock;
+	addressLease = std::move(lease);
+}
+
+void
+Client::RunEventDrivenExchanges() noexcept {
+	while (true) {
+		if (session != nullptr) {
+			RunEventDrivenSession();
+			return;
+		}
+
+		// The responses to pipelined requests are gathered, and sent together
+		// once the requests that have been received are answered. Otherwise,
+		// the previous response must be sent completely before the next
+		// request is handled.
+		if (IsPipelining()) {
+			connection->Cork();
+		} else {
+			switch (ContinueResponse()) {
+				case Connection::Status::COMPLETE:
+					break;
+				case Connection::Status::WOULD_BLOCK:
+					// Either the connection, or the CGI script. While the body of
+					// the request is passed to the script, the rest of it is
+					// awaited, unless the script doesn't accept more yet.
+					if (pendingCGI != nullptr && (!forwardingBody || cgiInputBlocked) && !connection->HasSendBacklog()) {
+						AwaitCGI();
+						return;
+					}
+					if (forwardingBody && !connection->HasSendBacklog() && !connection->WantsWrite()) {
+						UpdateInterest(Event::Interest::read);
+					} else {
+						UpdateInterest(Event::Interest::write);
+					}
+					ScheduleTimeout();
+					return;
+				case Connection::Status::FAILED:
+					CloseEventDriven();
+					return;
+			}
+		}
+
+		if (!persistentConnection) {
+			CloseEventDriven();
+			return;
+		}
+
+		// The rest of the body of the previous request comes first.
+		if (!DrainBody()) {
+			if (connection->FillReceiveBuffer()) {
+				continue;
+			}
+
+			if (connection->WouldBlock()) {
+				UpdateInterest(connection->WantsWrite() ? Event::Interest::write : Event::Interest::read);
+				ScheduleTimeout();
+				return;
+			}
+
+			CloseEventDriven();
+			return;
+		}
+
+		if (parser.GetStatus() == RequestParser::Status::INCOMPLETE &&
+			parser.Feed(connection->Buffered()) == RequestParser::Status::INCOMPLETE) {
+			if (connection->FillReceiveBuffer()) {
+				continue;
+			}
+
+			if (connection->WouldBlock()) {
+				UpdateInterest(connection->WantsWrite() ? Event::Interest::write : Event::Interest::read);
+				ScheduleTimeout();
+				return;
+			}
+
+			// The connection has been closed: RunMessageExchange will fail
+			// with the error of the parser.
+		}
+
+		const bool success = RunMessageExchange();
+		ResetExchangeState();
+
+		// A draining server closes the connection after the response, see
+		// Drain.
+		if (!success || !CheckConnectionLifetime() || server->IsDraining()) {
+			MarkConnectionClosing();
+		}
 	}
+}
+
+void
+Client::RunEventDrivenSession() noexcept {
+	while (true) {
+		const bool open = ContinueSession();
+
+		switch (connection->FlushSendBacklog()) {
+			case Connection::Status::COMPLETE:
+				break;
+			case Connection::Status::WOULD_BLOCK:
+				UpdateInterest(Event::Interest::write);
+				ScheduleTimeout();
+				return;
+			case Connection::Status::FAILED:
+				CloseEventDriven();
+				return;
+		}
 
-	// Clear the headers
-	this->currentRequest.headers.clear();
+		if (!open) {
+			CloseEventDriven();
+			return;
+		}
+
+		if (session->IsSending() || connection->FillReceiveBuffer()) {
+			continue;
+		}
 
-	// Clear the rest of the std::string's
-	this->currentRequest.path.clear();
-	this->currentRequest.query.clear();
+		if (connection->WouldBlock()) {
+			UpdateInterest(connection->WantsWrite() ? Event::Interest::write : Event::Interest::read);
+			ScheduleTimeout();
+			return;
+		}
+
+		CloseEventDriven();
+		return;
+	}
 }
 
 bool
-Client::RunMessageExchange() noexcept {
-	auto error = ConsumeMethod();
-	if (error != ClientError::NO_ERROR) {
-		return RecoverError(error);
+Client::RegisterEventHandler() noexcept {
+	if (!connection->SetNonBlocking() || !worker->EventLoop().Add(socket, this, Event::Interest::read)) {
+		return false;
 	}
 
-	error = ConsumePath();
-	if (error != ClientError::NO_ERROR) {
-		return RecoverError(error);
+	StartStage();
+	ScheduleTimeout();
+	return true;
+}
+
+bool
+Client::RunMessageExchange() noexcept {
+	auto error = ParseRequest();
+
+	// A client that knows the server supports HTTP/2 can start with the
+	// connection preface on a connection without TLS. The request line of
+	// the preface is "PRI * HTTP/2.0".
+	//
+	// Spec: RFC 7540 § 3.4
+	const auto &configuration = server->config();
+	if (error == ClientError::UNSUPPORTED_VERSION && requestCount == 0 && !configuration.useTransportSecurity &&
+		configuration.tlsConfiguration.enableHTTP2 && !configuration.upgradeToHTTPS) {
+		const auto received = connection->Buffered();
+		const std::string_view prefix(HTTP2::connectionPreface.substr(0, std::min(received.length(), HTTP2::connectionPreface.length())));
+		if (StringStartsWith(std::string_view(received.data(), received.length()), prefix)) {
+			// The preface hasn't been consumed, so the session can verify it.
+			parser.Reset();
+			stageStart = {};
+			return StartSession();
+		}
 	}
 
-	error = ConsumeVersion();
 	if (error != ClientError::NO_ERROR) {
 		return RecoverError(error);
 	}
 
-	error = ConsumeCRLF();
+	error = body.Start(currentRequest, configuration.securityPolicies.maxBodyLength);
 	if (error != ClientError::NO_ERROR) {
 		return RecoverError(error);
 	}
 
-	error = ConsumeHeaders();
-	if (error != ClientError::NO_ERROR) {
-		return RecoverError(error);
+	// Spec: RFC 7231 § 5.1.1
+	// HTTP/1.0 clients don't know the interim response.
+	if (const auto *expect = currentRequest.headers.Find(HeaderID::EXPECT); expect != nullptr) {
+		expectsContinue = currentRequest.versionMinor != 0 && body.GetStatus() == BodyReader::Status::INCOMPLETE &&
+						  Utils::EqualsIgnoreCase(expect->value, "100-continue");
 	}
 
 	error = CheckUpgradeHTTPS();
@@ -740,7 +1769,7 @@ Client::RunMessageExchange() noexcept {
 		return RecoverError(error);
 	}
 
-	error = CheckHostHeader();
+	error = CheckHostHeader(currentRequest, *server, connection->IsLocalhost());
 	if (error != ClientError::NO_ERROR) {
 		return RecoverError(error);
 	}
@@ -756,119 +1785,426 @@ Client::RunMessageExchange() noexcept {
 	}
 
 	InterpretConnectionHeaders();
+	EndStage(Stage::PARSE);
 
 	error = HandleRequest();
 	if (error != ClientError::NO_ERROR) {
 		return RecoverError(error);
 	}
 
+	// Otherwise, the body stage ends in ContinueResponse.
+	if (pendingFile == nullptr && pendingCompressor == nullptr && !connection->HasSendBacklog()) {
+		FinishStage(Stage::BODY);
+	}
+
 	return true;
 }
 
-bool
-Client::SendMetadata(const base::String &response, std::size_t contentLength, const MediaType &mediaType, const char *additionalMetaData) noexcept {
-	const std::string contentLengthValue = std::to_string(contentLength);
-	const bool useHSTS = server->config().useTransportSecurity && !server->config().hsts.empty();
-	const bool preventContentTypeSniffing = server->config().securityPolicies.enableContentTypeNosniffing;
-	const bool preventIframing = server->config().securityPolicies.denyIFraming;
-	const bool enableXSSPrevention = server->config().securityPolicies.enableXSSProtectionHeader;
-	const bool enableContentSecurityPolicy = server->config().securityPolicies.contentSecurityPolicy.length() != 0;
-	const bool disableReferrer = server->config().securityPolicies.disableReferrer;
-	const std::size_t additionalMetaDataLen = additionalMetaData == nullptr ? 0 : strlen(additionalMetaData);
-	const std::string &mediaTypeValue = mediaType.Complete();
-
-	const size_t size =
-		 response.length() +
-		 20 + contentLengthValue.length() +
-		 12 + server->config().serverProductName.length() +
-		 (persistentConnection ? 26 : 21) +
-		 (useHSTS ? 31 + server->config().hsts.length() : 0) +
-		 (preventContentTypeSniffing ? 33 : 0) +
-		 (preventIframing ? 29 : 0) +
-		 (enableXSSPrevention ? 33 : 0) +
-		 (enableContentSecurityPolicy ? 27 + server->config().securityPolicies.contentSecurityPolicy.length() : 0) +
-		 (disableReferrer ? 30 : 0) +
-		 18 + mediaTypeValue.length() +
-		 (mediaType.IncludeCharset() ? 18 : 2) +
-		 (additionalMetaData != nullptr ? additionalMetaDataLen : 0) +
-		 2;
-
-	std::vector<char> metadata;
-	metadata.reserve(size);
-	metadata.insert(std::end(metadata), std::cbegin(response), std::cend(response));
-
-	const char contentLengthName[] = "\r\nContent-Length: ";
-	metadata.insert(std::end(metadata), std::cbegin(contentLengthName), std::cend(contentLengthName) - 1);
-	metadata.insert(std::end(metadata), std::cbegin(contentLengthValue), std::cend(contentLengthValue));
-
-	const char serverHeaderName[] = "\r\nServer: ";
-	metadata.insert(std::end(metadata), std::cbegin(serverHeaderName), std::cend(serverHeaderName) - 1);
-	metadata.insert(std::end(metadata), std::cbegin(server->config().serverProductName), std::cend(server->config().serverProductName));
-
-	const char connectionHeaderAlive[] = "\r\nConnection: keep-alive";
-	const char connectionHeaderClose[] = "\r\nConnection: close";
-	if (persistentConnection) {
-		metadata.insert(std::end(metadata), std::cbegin(connectionHeaderAlive), std::cend(connectionHeaderAlive) - 1);
+void
+Client::RunSession() noexcept {
+	while (true) {
+		// This thread has no loop to update the clock, see Event::Clock.
+		Event::Clock::Update();
+		const bool open = ContinueSession();
+		if (connection->FlushSendBacklog() != Connection::Status::COMPLETE || !open) {
+			return;
+		}
+
+		if (!session->IsSending() && !connection->FillReceiveBuffer()) {
+			return;
+		}
+	}
+}
+
+void
+Client::ScheduleTimeout() noexcept {
+	if (state == State::CLOSED) {
+		return;
+	}
+
+	const auto &policies = server->config().securityPolicies;
+	const auto now = Event::Clock::Now();
+	auto &timers = worker->Timers();
+
+	if (state == State::AWAITING_CGI) {
+		timers.Schedule(*this, std::chrono::ceil<std::chrono::milliseconds>(pendingCGI->Deadline() - now));
+		return;
+	}
+
+	if (session != nullptr || pendingFile != nullptr || pendingCompressor != nullptr || pendingCGI != nullptr ||
+		connection->HasSendBacklog()) {
+		if (policies.maxIdleTime == 0) {
+			timers.Cancel(*this);
+		} else {
+			timers.Schedule(*this, std::chrono::milliseconds(policies.maxIdleTime));
+		}
+		return;
+	}
+
+	std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+	// The rest of the body of a request that is drained counts as the head of
+	// the next one.
+	if (state == State::SETUP || connection->Buffered().length() != 0 || body.GetStatus() == BodyReader::Status::INCOMPLETE) {
+		if (!receivingHead) {
+			receivingHead = true;
+			headDeadline = policies.maxRequestHeadTime == 0 ? deadline :
+						   now + std::chrono::milliseconds(policies.maxRequestHeadTime);
+		}
+		deadline = headDeadline;
 	} else {
-		metadata.insert(std::end(metadata), std::cbegin(connectionHeaderClose), std::cend(connectionHeaderClose) - 1);
+		// Nothing is sent or received until the next request, so the buffers
+		// of the connection aren't needed.
+		connection->Park();
+		std::string().swap(buffers.compressed);
+
+		if (policies.maxIdleTime != 0) {
+			deadline = now + std::chrono::milliseconds(policies.maxIdleTime);
+		}
+	}
+
+	if (state != State::SETUP && policies.maxConnectionLifetime != 0) {
+		deadline = std::min(deadline, startingTimePoint + std::chrono::milliseconds(policies.maxConnectionLifetime));
+	}
+
+	if (deadline == std::chrono::steady_clock::time_point::max()) {
+		timers.Cancel(*this);
+		return;
 	}
 
-	if (useHSTS) {
-		const char stsHeader[] = "\r\nStrict-Transport-Security: ";
-		metadata.insert(std::end(metadata), std::cbegin(stsHeader), std::cend(stsHeader) - 1);
-		metadata.insert(std::end(metadata), std::cbegin(server->config().hsts), std::cend(server->config().hsts));
+	timers.Schedule(*this, std::chrono::ceil<std::chrono::milliseconds>(deadline - now));
+}
+
+ContentCoding
+Client::SelectCompression() const noexcept {
+	const auto *acceptEncoding = currentRequest.headers.Find(HeaderID::ACCEPT_ENCODING);
+	if (acceptEncoding == nullptr) {
+		return ContentCoding::IDENTITY;
+	}
+
+	return AcceptEncoding::Parse(acceptEncoding->value).Select(Compressor::IsSupported);
+}
+
+RangeStatus
+Client::SelectRange(const IO::CachedFile &file, ByteRange &range) const noexcept {
+	// Ranges are only defined for GET.
+	const auto *header = currentRequest.headers.Find(HeaderID::RANGE);
+	if (header == nullptr || currentRequest.methodID != MethodID::GET ||
+		currentRequest.headers.Count(HeaderID::RANGE) != 1) {
+		return RangeStatus::IGNORED;
+	}
+
+	// The range only applies to the representation the client already has a
+	// part of: the entity-tag must match strongly, or the date must match
+	// Last-Modified exactly.
+	//
+	// Spec: RFC 7233 § 3.2
+	if (const auto *ifRange = currentRequest.headers.Find(HeaderID::IF_RANGE)) {
+		const auto value = ifRange->value;
+		if (!value.empty() && (value.front() == '"' || EntityTag::IsWeak(value))) {
+			if (!EntityTag::MatchesStrongly(value, file.entityTag)) {
+				return RangeStatus::IGNORED;
+			}
+		} else {
+			std::time_t date;
+			if (!ParseDate(value, date) || date != file.file->ModificationTime()) {
+				return RangeStatus::IGNORED;
+			}
+		}
+	}
+
+	return ParseRange(header->value, file.file->Size(), range);
+}
+
+bool
+Client::SendCompressedChunk() noexcept {
+	std::array<char, MAGIC_COMPRESSION_CHUNK_SIZE> input;
+	const auto length = std::min(pendingFileRemaining, input.size());
+
+	const char *data = input.data();
+	if (const auto memory = pendingFile->Memory(); !memory.empty()) {
+		data = memory.data() + pendingFileOffset;
+	} else if (!ReadFully(pendingFile->file->Handle(), input.data(), length, pendingFileOffset)) {
+		pendingCompressor = nullptr;
+		pendingFile = nullptr;
+		return false;
 	}
 
-	if (preventContentTypeSniffing) {
-		const char xctoHeader[] = "\r\nX-Content-Type-Options: nosniff";
-		metadata.insert(std::end(metadata), std::cbegin(xctoHeader), std::cend(xctoHeader) - 1);
+	pendingFileOffset += static_cast<off_t>(length);
+	pendingFileRemaining -= length;
+	const bool finish = pendingFileRemaining == 0;
+
+	auto &output = buffers.compressed;
+	output.clear();
+	if (!pendingCompressor->Compress(std::string_view(data, length), finish, output)) {
+		pendingCompressor = nullptr;
+		pendingFile = nullptr;
+		return false;
+	}
+
+	if (!finish) {
+		return response.Write(output);
+	}
+
+	ReleaseCompressor(std::move(pendingCompressor));
+	pendingCompressor = nullptr;
+	pendingFile = nullptr;
+	return response.End(output);
+}
+
+void
+Client::StartStage() noexcept {
+	if (server->config().metrics != nullptr) {
+		stageStart = std::chrono::steady_clock::now();
+	}
+}
+
+void
+Client::EndStage(Stage stage) noexcept {
+	if (stageStart == std::chrono::steady_clock::time_point{}) {
+		return;
+	}
+
+	const auto now = std::chrono::steady_clock::now();
+	server->config().metrics->Record(stage, now - stageStart);
+	stageStart = now;
+}
+
+void
+Client::FinishStage(Stage stage) noexcept {
+	EndStage(stage);
+	stageStart = {};
+}
+
+void
+Client::FinishSetupStage() noexcept {
+	if (server->config().useTransportSecurity) {
+		FinishStage(Stage::TLS_HANDSHAKE);
+	} else {
+		stageStart = {};
+	}
+}
+
+bool
+Client::IsMetricsRequest() const noexcept {
+	const auto &configuration = server->config();
+	if (configuration.metrics == nullptr || configuration.metricsPath.empty() ||
+		currentRequest.path != configuration.metricsPath) {
+		return false;
 	}
 
-	if (preventIframing) {
-		const char xfoHeader[] = "\r\nX-Frame-Options: SAMEORIGIN";
-		metadata.insert(std::end(metadata), std::cbegin(xfoHeader), std::cend(xfoHeader) - 1);
+	const auto &address = connection->PeerAddress();
+	return address == "::1" || StringStartsWith(address, "127.");
+}
+
+bool
+Client::ServeMetrics() noexcept {
+	// The version of the text format is a parameter of the media type.
+	static constexpr MediaType metricsType("text/plain;version=0.0.4;charset=utf-8");
+
+	thread_local std::string output;
+	output.clear();
+	try {
+		server->config().metrics->Render(output, server->config());
+	} catch (const std::bad_alloc &) {
+		return ServeErrorResponse(ClientError::FILE_SYSTEM_OVERLOAD);
 	}
 
-	if (enableXSSPrevention) {
-		const char xxpHeader[] = "\r\nX-XSS-Protection: 1; mode=block";
-		metadata.insert(std::end(metadata), std::cbegin(xxpHeader), std::cend(xxpHeader) - 1);
+	return ServeStringRequest(Strings::StatusLines::OK, metricsType, base::String(output.data(), output.length()));
+}
+
+void
+Client::LogAccess(std::string_view statusLine, std::size_t bodyLength) noexcept {
+	auto *accessLog = server->config().accessLog;
+	if (accessLog == nullptr) {
+		return;
 	}
 
-	if (enableContentSecurityPolicy) {
-		const auto &value = server->config().securityPolicies.contentSecurityPolicy;
-		const char cspHeader[] = "\r\nContent-Security-Policy: ";
-		metadata.insert(std::end(metadata), std::cbegin(cspHeader), std::cend(cspHeader) - 1);
-		metadata.insert(std::end(metadata), std::cbegin(value), std::cend(value));
+	if (!cgiAccessRecord.empty()) {
+		HTTP::LogAccess(*accessLog, cgiAccessRecord, statusLine, bodyLength);
+		cgiAccessRecord.clear();
+		return;
 	}
 
-	if (disableReferrer) {
-		const char rpHeader[] = "\r\nReferrer-Policy: no-referrer";
-		metadata.insert(std::end(metadata), std::cbegin(rpHeader), std::cend(rpHeader) - 1);
+	HTTP::LogAccess(*accessLog, currentRequest, currentRequest.versionMinor == 0 ? "HTTP/1.0" : "HTTP/1.1",
+					connection->PeerAddress(), statusLine, bodyLength);
+}
+
+void
+Client::StartCGIResponse() noexcept {
+	const auto statusLine = cgiResponse.StatusLine();
+
+	// Spec: RFC 7230 § 3.3.3
+	const auto code = statusLine.substr(std::string_view("HTTP/1.1 ").length(), 3);
+	const bool hasBody = code.front() != '1' && code != "204" && code != "304";
+
+	cgiHeadSent = true;
+	cgiBodyless |= !hasBody;
+	cgiRemaining = hasBody ? cgiResponse.ContentLength() : 0;
+	cgiChunked = cgiChunked && hasBody && cgiRemaining == unknownContentLength;
+
+	auto &metadata = buffers.metadata;
+	metadata.clear();
+	metadata.append(statusLine);
+	metadata.append(CurrentDateHeader());
+	if (cgiChunked) {
+		metadata.append("\r\nTransfer-Encoding: chunked");
+	} else if (cgiRemaining != unknownContentLength) {
+		if (hasBody) {
+			// Enough for the decimal representation of any std::size_t.
+			std::array<char, 20> contentLengthValue;
+			const auto contentLengthEnd = std::to_chars(contentLengthValue.data(),
+				contentLengthValue.data() + contentLengthValue.size(), cgiRemaining).ptr;
+			metadata.append("\r\nContent-Length: ");
+			metadata.append(contentLengthValue.data(), contentLengthEnd);
+		}
+	} else {
+		// An HTTP/1.0 client reads the body until the connection is closed.
+		MarkConnectionClosing();
 	}
 
-	const char contentTypeName[] = "\r\nContent-Type: ";
-	metadata.insert(std::end(metadata), std::cbegin(contentTypeName), std::cend(contentTypeName) - 1);
-	metadata.insert(std::end(metadata), std::cbegin(mediaTypeValue), std::cend(mediaTypeValue));
+	metadata.append(persistentConnection ? "\r\nConnection: keep-alive" : "\r\nConnection: close");
+	metadata.append(server->StaticHeaders());
+	metadata.append("\r\n");
+	metadata.append(cgiResponse.Fields());
+	metadata.append("\r\n");
+
+	LogAccess(statusLine, cgiRemaining);
+	response.Begin(*connection, base::String(metadata.data(), metadata.size()), cgiChunked && !cgiBodyless);
+}
 
-	const char crlf[] = "\r\n";
-	const char charset[] = ";charset=utf-8\r\n";
-	if (mediaType.IncludeCharset()) {
-		metadata.insert(std::end(metadata), std::begin(charset), std::end(charset) - 1);
+bool
+Client::SendMetadata(const base::String &response, std::size_t contentLength, const MediaType &mediaType, const char *additionalMetaData) noexcept {
+	SerializeMetadata(response, contentLength, mediaType, additionalMetaData);
+	return connection->WriteBaseString(base::String(buffers.metadata.data(), buffers.metadata.size()));
+}
+
+void
+Client::SerializeMetadata(const base::String &response, std::size_t contentLength, const MediaType &mediaType, const char *additionalMetaData) noexcept {
+	// Enough for the decimal representation of any std::size_t.
+	std::array<char, 20> contentLengthValue;
+	const auto contentLengthEnd = std::to_chars(contentLengthValue.data(),
+		contentLengthValue.data() + contentLengthValue.size(), contentLength).ptr;
+
+	const std::string_view connectionHeader = persistentConnection
+		? "\r\nConnection: keep-alive" : "\r\nConnection: close";
+
+	auto &metadata = buffers.metadata;
+	metadata.clear();
+	metadata.append(response.data(), response.length());
+	metadata.append(CurrentDateHeader());
+	if (contentLength == unknownContentLength) {
+		metadata.append("\r\nTransfer-Encoding: chunked");
 	} else {
-		metadata.insert(std::end(metadata), std::begin(crlf), std::end(crlf) - 1);
+		metadata.append("\r\nContent-Length: ");
+		metadata.append(contentLengthValue.data(), contentLengthEnd);
 	}
+	metadata.append(connectionHeader);
+	metadata.append(server->StaticHeaders());
+	metadata.append("\r\nContent-Type: ");
+	metadata.append(mediaType.ContentType());
+	metadata.append("\r\n");
 
 	if (additionalMetaData) {
-		metadata.insert(std::end(metadata), additionalMetaData, additionalMetaData + additionalMetaDataLen);
+		metadata.append(additionalMetaData);
 	}
 
-	metadata.insert(std::end(metadata), std::begin(crlf), std::end(crlf) - 1);
+	metadata.append("\r\n");
 
-	return connection->WriteBaseString(base::String(metadata.data(), metadata.size()));
+	LogAccess(std::string_view(response.data(), response.length()), contentLength);
+	EndStage(Stage::METADATA);
 }
 
 bool
-Client::ServeCGI(const CGI::Script *) noexcept {
+Client::SendFileBody(const std::shared_ptr<const IO::CachedFile> &file, off_t offset, std::size_t count) noexcept {
+	if (worker == nullptr) {
+		if (const auto mapping = file->file->Mapping(); !mapping.empty()) {
+			const char *data = mapping.data() + offset;
+			return connection->WriteBody(data, count) == Connection::Status::COMPLETE;
+		}
+		return connection->SendFile(file->file->Handle(), offset, count);
+	}
+
+	pendingFileOffset = offset;
+	pendingFileRemaining = count;
+	pendingFile = file;
+
+	return ContinueResponse() != Connection::Status::FAILED;
+}
+
+bool
+Client::ServeCGI(const CGI::Script *script) noexcept {
+	const auto &manager = server->cgi();
+	CGI::Manager::StartStatus status;
+	if (script->Type == CGI::Protocol::HTTP) {
+		status = manager.Forward(*script, CGI::CreateUpstreamRequest(currentRequest, server->config(), connection->PeerAddress(), body),
+								 currentRequest.IsHead(), body.Framing(), pendingCGI);
+	} else {
+		const auto environment = CGI::CreateEnvironment(*script, currentRequest, server->config(), connection->PeerAddress(), body);
+		status = manager.Start(*script, environment, body.Framing(), pendingCGI);
+	}
+
+	switch (status) {
+		case CGI::Manager::StartStatus::STARTED:
+			break;
+		case CGI::Manager::StartStatus::LIMIT_REACHED:
+			return ServeErrorResponse(ClientError::FILE_SYSTEM_OVERLOAD);
+		case CGI::Manager::StartStatus::FAILED:
+			return ServeStringRequest(Strings::StatusLines::BadGateway, MediaTypes::HTML, Strings::BadGatewayPage);
+	}
+
+	// The request is reset before the response is complete.
+	cgiBodyless = currentRequest.IsHead();
+	cgiChunked = currentRequest.versionMinor != 0;
+	if (server->config().accessLog != nullptr) {
+		std::array<char, maxAccessRecordLength> record;
+		const auto length = FormatAccessRequest(record.data(), currentRequest,
+			currentRequest.versionMinor == 0 ? "HTTP/1.0" : "HTTP/1.1", connection->PeerAddress());
+		cgiAccessRecord.assign(record.data(), length);
+	}
+
+	if (body.GetStatus() == BodyReader::Status::INCOMPLETE) {
+		// The body follows the head, which the request refers to.
+		DetachRequest();
+		forwardingBody = true;
+	} else if (body.Framing() != BodyFraming::NONE && !pendingCGI->EndBody()) {
+		ResetCGI();
+		return ServeStringRequest(Strings::StatusLines::BadGateway, MediaTypes::HTML, Strings::BadGatewayPage);
+	}
+
+	if (worker != nullptr) {
+		return ContinueResponse() != Connection::Status::FAILED;
+	}
+
+	while (pendingCGI != nullptr) {
+		if (forwardingBody) {
+			// The receive timeout ends a body that stalls, like an idle
+			// connection. The output is read while the script doesn't accept
+			// more of the body.
+			const auto status = ForwardBody();
+			if (status == Connection::Status::FAILED || (status == Connection::Status::WOULD_BLOCK && !cgiInputBlocked)) {
+				ResetCGI();
+				return false;
+			}
+
+			if (pendingCGI == nullptr) {
+				break;
+			}
+		}
+
+		switch (ContinueCGI()) {
+			case Connection::Status::COMPLETE:
+				break;
+			case Connection::Status::WOULD_BLOCK:
+				if (!pendingCGI->Wait() && !FailCGI(Strings::StatusLines::GatewayTimeout, Strings::GatewayTimeoutPage)) {
+					return false;
+				}
+				break;
+			case Connection::Status::FAILED:
+				ResetCGI();
+				return false;
+		}
+	}
+
 	return true;
 }
 
@@ -877,19 +2213,192 @@ Client::ServeDefaultPage() noexcept {
 	return ServeStringRequest(Strings::StatusLines::OK, MediaTypes::HTML, Strings::DefaultWebPage);
 }
 
+bool
+Client::ServeErrorResponse(ClientError error) noexcept {
+	const auto &response = *server->FindErrorResponse(error);
+	if (response.closesConnection) {
+		MarkConnectionClosing();
+	}
+
+	const auto body = response.Body();
+	if (response.compressible && SelectCompression() != ContentCoding::IDENTITY) {
+		return ServeStringRequest(base::String(response.statusLine.data(), response.statusLine.length()),
+								  *response.mediaType, base::String(body.data(), body.length()));
+	}
+
+	LogAccess(response.statusLine, body.length());
+	EndStage(Stage::METADATA);
+
+	// The Date header field follows the status line.
+	const auto &output = response.responses[persistentConnection];
+	const auto statusLength = response.statusLine.length();
+	const auto length = currentRequest.IsHead() ? response.headLengths[persistentConnection] : output.length();
+	const auto date = CurrentDateHeader();
+	return connection->WriteBaseStrings({ base::String(output.data(), statusLength),
+										  base::String(date.data(), date.length()),
+										  base::String(output.data() + statusLength, length - statusLength) });
+}
+
 bool
 Client::ServeStringRequest(const base::String &responseLine,
 						   const MediaType &type,
 						   const base::String &body) noexcept {
-	if (!SendMetadata(responseLine, body.length(), type)) {
-		return false;
+	base::String content = body;
+
+	// Enough for Vary and Content-Encoding.
+	std::array<char, 64> additional;
+	additional[0] = '\0';
+
+	// Generated bodies are small, so they're compressed at once, without the
+	// compression cache.
+	if (CanCompress(type, body.length())) {
+		const std::string_view vary("Vary: Accept-Encoding\r\n");
+		auto *additionalEnd = std::copy(std::cbegin(vary), std::cend(vary), additional.data());
+
+		const auto coding = SelectCompression();
+		auto compressor = coding == ContentCoding::IDENTITY ? nullptr : AcquireCompressor(coding);
+		if (compressor != nullptr) {
+			buffers.compressed.clear();
+			if (compressor->Compress(std::string_view(body.data(), body.length()), true, buffers.compressed)) {
+				content = base::String(buffers.compressed.data(), buffers.compressed.length());
+
+				const std::string_view contentEncoding("Content-Encoding: ");
+				const auto name = ContentCodingName(coding);
+				additionalEnd = std::copy(std::cbegin(contentEncoding), std::cend(contentEncoding), additionalEnd);
+				additionalEnd = std::copy(std::cbegin(name), std::cend(name), additionalEnd);
+				*additionalEnd++ = '\r';
+				*additionalEnd++ = '\n';
+			}
+			ReleaseCompressor(std::move(compressor));
+		}
+
+		*additionalEnd = '\0';
 	}
 
+	SerializeMetadata(responseLine, content.length(), type, additional.data());
+	const base::String metadata(buffers.metadata.data(), buffers.metadata.size());
+
 	if (currentRequest.IsHead()) {
+		return connection->WriteBaseString(metadata);
+	}
+
+	// Send the metadata and the body together, so they can share a packet.
+	return connection->WriteBaseStrings({ metadata, content });
+}
+
+bool
+Client::TryServeCompressedFile(const std::shared_ptr<const IO::CachedFile> &file, ClientError &error) noexcept {
+	const auto coding = SelectCompression();
+	if (coding == ContentCoding::IDENTITY) {
+		return false;
+	}
+
+	const auto size = file->file->Size();
+	auto &cache = server->compressionCache;
+	std::shared_ptr<const std::string> output;
+	std::unique_ptr<Compressor> compressor;
+
+	if (cache.IsEnabled() && size <= server->config().compressionCacheMaxFileSize) {
+		output = cache.Lookup(*file->file, coding);
+		if (auto *metrics = server->config().metrics) {
+			metrics->CountCompressionCacheLookup(output != nullptr);
+		}
+		if (output == nullptr) {
+			output = CompressFile(*file, coding);
+			if (output == nullptr) {
+				return false;
+			}
+			cache.Insert(*file->file, coding, output);
+		}
+	} else if (currentRequest.versionMinor == 0 || (compressor = AcquireCompressor(coding)) == nullptr) {
+		// The body is delimited by chunked transfer coding, which HTTP/1.0
+		// doesn't have.
+		return false;
+	}
+
+	// The compressed representation has an entity-tag of its own: the one of
+	// the file with the coding appended, e.g. "1-2-3-4-gzip". The validators
+	// are "ETag: <tag>\r\nLast-Modified: ...".
+	//
+	// Enough for the validators, Vary and Content-Encoding.
+	std::array<char, 256> additional;
+	const std::string_view etag("ETag: ");
+	const auto rest = std::string_view(file->validatorHeaders).substr(etag.length() + file->entityTag.length());
+	const std::string_view varyContentEncoding("Vary: Accept-Encoding\r\nContent-Encoding: ");
+	const auto name = ContentCodingName(coding);
+
+	auto *additionalEnd = std::copy(std::cbegin(etag), std::cend(etag), additional.data());
+	auto *entityTagBegin = additionalEnd;
+	additionalEnd = std::copy(std::cbegin(file->entityTag), std::cend(file->entityTag) - 1, additionalEnd);
+	*additionalEnd++ = '-';
+	additionalEnd = std::copy(std::cbegin(name), std::cend(name), additionalEnd);
+	*additionalEnd++ = '"';
+	const std::string_view entityTag(entityTagBegin, static_cast<std::size_t>(additionalEnd - entityTagBegin));
+	additionalEnd = std::copy(std::cbegin(rest), std::cend(rest), additionalEnd);
+	additionalEnd = std::copy(std::cbegin(varyContentEncoding), std::cend(varyContentEncoding), additionalEnd);
+	additionalEnd = std::copy(std::cbegin(name), std::cend(name), additionalEnd);
+	*additionalEnd++ = '\r';
+	*additionalEnd++ = '\n';
+	*additionalEnd = '\0';
+
+	const auto length = output != nullptr ? output->length() : unknownContentLength;
+	const bool notModified = IsNotModified(currentRequest, entityTag, file->file->ModificationTime());
+	SerializeMetadata(notModified ? Strings::StatusLines::NotModified : Strings::StatusLines::OK, length,
+					  *file->mediaType, additional.data());
+	const base::String metadata(buffers.metadata.data(), buffers.metadata.size());
+
+	if (notModified || currentRequest.IsHead()) {
+		if (compressor != nullptr) {
+			ReleaseCompressor(std::move(compressor));
+		}
+		error = connection->WriteBaseString(metadata) ? ClientError::NO_ERROR : ClientError::FAILED_WRITE_RESPONSE_METADATA;
 		return true;
 	}
 
-	return connection->WriteBaseString(body);
+	if (output != nullptr) {
+		error = connection->WriteBaseStrings({ metadata, base::String(output->data(), output->length()) })
+			? ClientError::NO_ERROR : ClientError::FAILED_WRITE_RESPONSE_BODY;
+		return true;
+	}
+
+	// The metadata is sent with the first chunk.
+	response.Begin(*connection, metadata, true);
+	pendingFile = file;
+	pendingFileOffset = 0;
+	pendingFileRemaining = size;
+	pendingCompressor = std::move(compressor);
+
+	bool success = true;
+	if (worker == nullptr) {
+		while (success && pendingCompressor != nullptr) {
+			success = SendCompressedChunk();
+		}
+	} else {
+		success = ContinueResponse() != Connection::Status::FAILED;
+	}
+
+	error = success ? ClientError::NO_ERROR : ClientError::FAILED_WRITE_RESPONSE_BODY;
+	return true;
+}
+
+bool
+Client::StartSession() noexcept {
+	session = std::make_unique<HTTP2::Session>(*server, *connection);
+	return session->Start();
+}
+
+bool
+Client::StopAwaitingCGI() noexcept {
+	RemoveCGIDescriptors();
+	state = State::EXCHANGE;
+	return worker->EventLoop().Add(socket, this, Event::Interest::read);
+}
+
+void
+Client::UpdateInterest(std::uint32_t interest) noexcept {
+	if (!worker->EventLoop().Modify(socket, this, interest)) {
+		CloseEventDriven();
+	}
 }
 
 ClientError
@@ -902,12 +2411,11 @@ Client::ValidateCurrentRequestPath() noexcept {
 	//   - * for the OPTIONS method.
 	//   - the 'absolute-form' request-target type
 	//   -
-	std::cout << "Checking path: '" << currentRequest.path << "'\n";
 	if (currentRequest.path[0] != '/') {
 		std::string_view path = currentRequest.path;
 
 		if (path.length() < CalculateMinLengthRequestTargetAbsoluteForm()) {
-			std::cout << "VCRP: path is shorter than CalculateMinLengthRequestTargetAbsoluteForm(): \"" << path << "\" != " << CalculateMinLengthRequestTargetAbsoluteForm() << "\n";
+			Logger::Debug("HTTPClient::ValidateCurrentRequestPath", "absolute-form shorter than the minimum");
 			return ClientError::INCORRECT_PATH_ABSOLUTE_FORM;
 		}
 
@@ -915,19 +2423,19 @@ Client::ValidateCurrentRequestPath() noexcept {
 			std::tolower(path[1]) != 't' ||
 			std::tolower(path[2]) != 't' ||
 			std::tolower(path[3]) != 'p') {
-			std::cout << "VCRP: path doesn't start with 'http'\n";
+			Logger::Debug("HTTPClient::ValidateCurrentRequestPath", "path doesn't start with 'http'");
 			return ClientError::INCORRECT_PATH_ABSOLUTE_FORM;
 		}
 
 		if (server->config().useTransportSecurity && path[5] != 's') {
-			std::cout << "VCRP: Transport Secured connection doesn't have HTTPS scheme\n";
+			Logger::Debug("HTTPClient::ValidateCurrentRequestPath", "Transport Secured connection doesn't have HTTPS scheme");
 			return ClientError::INCORRECT_PATH_ABSOLUTE_FORM;
 		}
 
 		path = path.substr(4 + (server->config().useTransportSecurity ? 1 : 0));
 
 		if (path[0] != ':' || path[1] != '/' || path[2] != '/') {
-			std::cout << "VCRP: path doesn't have :// \n";
+			Logger::Debug("HTTPClient::ValidateCurrentRequestPath", "path doesn't have ://");
 			return ClientError::INCORRECT_PATH_ABSOLUTE_FORM;
 		}
 
@@ -942,7 +2450,7 @@ Client::ValidateCurrentRequestPath() noexcept {
 			// todo maybe check port number, if it is the correct one?
 			path = path.substr(end);
 		} else {
-			std::cout << "VCRP: path doesn't end with slash\n";
+			Logger::Debug("HTTPClient::ValidateCurrentRequestPath", "path doesn't end with slash");
 			return ClientError::INCORRECT_PATH_ABSOLUTE_FORM;
 		}
 
@@ -952,4 +2460,27 @@ Client::ValidateCurrentRequestPath() noexcept {
 	return ClientError::NO_ERROR;
 }
 
+bool
+Client::WaitForRequest() noexcept {
+	if (worker != nullptr) {
+		return connection->FillReceiveBuffer();
+	}
+
+	// The server checks IsIdle after it has started draining, so either it
+	// sees this client waiting, or this client sees it draining.
+	{
+		const std::lock_guard guard(idleMutex);
+		if (server->IsDraining()) {
+			return false;
+		}
+		idle = true;
+	}
+
+	const bool received = connection->FillReceiveBuffer();
+
+	const std::lock_guard guard(idleMutex);
+	idle = false;
+	return received;
+}
+
 } // namespace HTTP
@@ -6,21 +6,55 @@
  * See the COPYING file for licensing information.
  */
 
+#include <array>
 #include <chrono>
 #include <iosfwd>
 #include <memory>
+#include <mutex>
 #include <string>
-#include <thread>
+#include <string_view>
 #include <vector>
 
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <sys/types.h>
+
 // From base/media_type.hpp:
 struct MediaType;
 
+// From cgi/exchange.hpp:
+namespace CGI {
+	class Exchange;
+} // namespace CGI
+
+// From http2/session.hpp:
+namespace HTTP2 {
+	class Session;
+} // namespace HTTP2
+
+// From io/file_cache.hpp:
+namespace IO {
+	struct CachedFile;
+} // namespace IO
+
+#include "base/arena.hpp"
+#include "base/slot_map.hpp"
 #include "base/string.hpp"
+#include "cgi/response.hpp"
 #include "cgi/script.hpp"
 #include "connection/connection.hpp"
+#include "event/loop.hpp"
+#include "event/timer_wheel.hpp"
+#include "http/body_reader.hpp"
 #include "http/client_error.hpp"
+#include "http/compressor.hpp"
+#include "http/content_coding.hpp"
+#include "http/range.hpp"
 #include "http/request.hpp"
+#include "http/request_parser.hpp"
+#include "http/response_writer.hpp"
+#include "security/address_limiter.hpp"
 
 #ifndef TESTING_VISIBILITY
 #define TESTING_VISIBILITY private
@@ -31,6 +65,12 @@ namespace HTTP {
 	// Forward-decl from server.hpp
 	class Server;
 
+	// Forward-decl from worker.hpp
+	class Worker;
+
+	// Forward-decl from metrics.hpp
+	enum class Stage;
+
 } // namespace HTTP
 
 namespace HTTP {
@@ -43,19 +83,120 @@ struct ClientBuffers {
 	// Header field value buffer
 	std::vector<char> fieldValue;
 
+	// The Consume* functions copy the request into the method buffer and the
+	// arena of the client, which 'currentRequest' refers to. The parser
+	// doesn't use them, since it refers to the receive buffer instead.
+	std::vector<char> method;
+
+	// The metadata of the response, reused to avoid allocations.
+	std::string metadata;
+
+	// The output of the compressor for the current response, reused to avoid
+	// allocations.
+	std::string compressed;
+
+	// The output of the CGI script read for the current response, reused to
+	// avoid allocations.
+	std::string cgi;
+
 	ClientBuffers() noexcept;
 };
 
-class Client {
+class Client : public Event::Handler, public Event::Timer {
 public:
-	Client(Server *server, int socket) noexcept;
+	// Creates a client served by a thread of HTTP::ClientPool, see Entrypoint,
+	// used by the ServingMode::THREAD_PER_CLIENT serving mode. [lease] counts
+	// the connection for the limits of its address, see
+	// Server::AdmitConnection.
+	Client(Server *server, int socket, Security::AddressLease &&lease) noexcept;
+
+	// Creates a client which is driven by the event loop of [worker], used by
+	// the ServingMode::EVENT_DRIVEN serving mode. See RegisterEventHandler.
+	Client(Server *server, Worker *worker, int socket, Security::AddressLease &&lease) noexcept;
+
+	~Client() noexcept override;
+
+	// Called by the event loop when the connection is ready.
+	void
+	OnEvent(std::uint32_t events) noexcept override;
+
+	// Called by the timer wheel of the worker when the connection has been
+	// idle, or receiving the head of a request, for too long. See
+	// ScheduleTimeout.
+	void
+	OnTimeout() noexcept override;
+
+	// Puts the connection in non-blocking mode and starts watching it on the
+	// event loop of the worker.
+	//
+	// Returns success status
+	[[nodiscard]] bool
+	RegisterEventHandler() noexcept;
 
 	// For testing purposes
-	inline explicit Client(Server *server) : connection(nullptr), server(server) {
-	}
+	explicit Client(Server *server) noexcept;
+
+	// Passed to SerializeMetadata as the length of bodies sent with chunked
+	// transfer coding, whose length isn't known in advance.
+	static constexpr std::size_t unknownContentLength = SIZE_MAX;
+
+	// Closes the connection and resets this client, so it can be reused for
+	// another connection of the same worker, or client thread, with Reuse.
+	void
+	Release() noexcept;
+
+	// Prepares this released client for the connection on [socket], see
+	// RegisterEventHandler.
+	void
+	Reuse(int socket, Security::AddressLease &&lease) noexcept;
+
+	// Called by the worker when the server drains, see Server::SignalDrain.
+	// An idle connection is closed right away, and an HTTP/2 session gets a
+	// GOAWAY frame. Other connections are closed once the current exchange
+	// is done, i.e. after the response to the request being received.
+	void
+	Drain() noexcept;
+
+	// Whether the thread serving this client waits for the next request of
+	// the connection, in the ServingMode::THREAD_PER_CLIENT serving mode. A
+	// draining server shuts such a connection down, see
+	// ClientPool::ShutdownIdle. A client that starts waiting once the server
+	// drains closes the connection instead.
+	//
+	// This function is thread-safe.
+	[[nodiscard]] bool
+	IsIdle() noexcept;
+
+	// The Entrypoint of the client, called by the client thread it is served
+	// on. This function calls repeatedly RunMessageExchange until EOS or
+	// error. Then the thread releases the client, see Release.
+	void
+	Entrypoint();
+
+	// Whether the conditional header fields of [request], If-None-Match or
+	// If-Modified-Since, say the client already has the representation with
+	// [entityTag] and [modificationTime], in which case a 304 (Not Modified)
+	// should be sent.
+	[[nodiscard]] static bool
+	IsNotModified(const Request &request, std::string_view entityTag, std::time_t modificationTime) noexcept;
+
+	// Checks if the 'Host' header of [request] is correct. This function
+	// verifies that one, and only one 'Host' header is present, and that the
+	// 'Host' header corresponds with a hostname of [server]. The names of
+	// the local machine are accepted if the peer [isLocalhost].
+	//
+	// See RFC 7230 § 5.4
+	// https://svn.tools.ietf.org/svn/wg/httpbis/specs/rfc7230.html#rfc.section.5.4.p.8
+	[[nodiscard]] static ClientError
+	CheckHostHeader(const Request &request, const Server &server, bool isLocalhost) noexcept;
 
 TESTING_VISIBILITY:
 	ClientBuffers buffers;
+
+	// Holds the data of the current request that doesn't refer to the
+	// receive buffer, e.g. the fields copied by the Consume* functions and
+	// generated header fields. Reset by ResetExchangeState.
+	base::Arena arena;
 	std::unique_ptr<Connection> connection;
 	Request currentRequest;
 
@@ -66,27 +207,185 @@ TESTING_VISIBILITY:
 
 	Server *server;
 
+	RequestParser parser;
+
+	// The body of the current request, which is passed to the CGI script
+	// handling the request as it is received, or discarded otherwise. See
+	// DrainBody.
+	BodyReader body;
+
+	// Whether the head of the request has been consumed from the receive
+	// buffer already, see DetachRequest.
+	bool headConsumed{ false };
+
+	// Whether the request has "Expect: 100-continue", and the interim
+	// response hasn't been sent yet, see ReadBody.
+	bool expectsContinue{ false };
+
+	// Whether the body is being passed to the CGI script, before its output
+	// is read. See ForwardBody.
+	bool forwardingBody{ false };
+
+	// Whether the CGI script doesn't accept more of the body yet, in which
+	// case its output is read meanwhile.
+	bool cgiInputBlocked{ false };
+
+	// The following members are only used by event-driven clients.
+	enum class State {
+		SETUP,
+
+		// A step of the TLS handshake is running on the crypto pool of the
+		// server, and the connection isn't watched in the meantime.
+		SETUP_OFFLOADED,
+		EXCHANGE,
+
+		// The response is produced by a CGI script, whose output is watched
+		// instead of the connection until there is more. See AwaitCGI.
+		AWAITING_CGI,
+		CLOSED,
+	};
+
+	Worker *worker{ nullptr };
+	int socket{ -1 };
+	State state{ State::SETUP };
+
+	// Whether the head of a request is being received, and when it should be
+	// complete. See ScheduleTimeout.
+	bool receivingHead{ false };
+	std::chrono::steady_clock::time_point headDeadline{};
+
+	// See IsIdle, guarded by 'idleMutex'.
+	std::mutex idleMutex;
+	bool idle{ false };
+
+	// When the current stage started, see HTTP::Stage. Only set when the
+	// configuration has metrics, and the stage is timed.
+	std::chrono::steady_clock::time_point stageStart{};
+
+	// Counts the connection for the limits of the address of the peer, until
+	// the client is released or destroyed.
+	Security::AddressLease addressLease;
+
+	// The response body that is still being sent.
+	std::shared_ptr<const IO::CachedFile> pendingFile;
+	off_t pendingFileOffset{ 0 };
+	std::size_t pendingFileRemaining{ 0 };
+
+	// When set, the pending file is compressed with it a chunk at a time,
+	// and sent with chunked transfer coding.
+	std::unique_ptr<Compressor> pendingCompressor;
+
+	// Writes the bodies that are produced while they're sent, i.e. those of
+	// 'pendingCompressor' and 'pendingCGI'.
+	ResponseWriter response;
+
+	// The HTTP/2 session of the connection, once HTTP/2 has been negotiated
+	// with ALPN, or the peer started the connection with the HTTP/2
+	// connection preface. The connection is driven by the session then.
+	std::unique_ptr<HTTP2::Session> session;
+
+	// Passes the readiness of the output of the CGI script to OnCGIEvent.
+	class CGIHandler : public Event::Handler {
+	public:
+		inline explicit
+		CGIHandler(Client *client) noexcept :
+			client(client) {
+		}
+
+		void
+		OnEvent(std::uint32_t events) noexcept override;
+
+	private:
+		Client *client;
+	};
+
+	// The CGI script producing the current response, whose output is sent
+	// as it is read, see ContinueCGI.
+	std::unique_ptr<CGI::Exchange> pendingCGI;
+	CGI::ResponseParser cgiResponse;
+	CGIHandler cgiHandler{ this };
+
+	// The descriptors of the script watched while the client awaits it, see
+	// CGI::Exchange::Awaiting.
+	std::array<int, 2> cgiDescriptors{ -1, -1 };
+
+	// Whether the metadata of the CGI response has been sent, whether its
+	// body is left out (a HEAD request, or a status without a body), and
+	// whether it is sent with chunked transfer coding. Until the metadata is
+	// sent, the latter is whether the client supports it.
+	bool cgiHeadSent{ false };
+	bool cgiBodyless{ false };
+	bool cgiChunked{ false };
+
+	// The octets of the body the script announced with Content-Length that
+	// haven't been sent, or unknownContentLength.
+	std::size_t cgiRemaining{ unknownContentLength };
+
+	// The part of the access record of the CGI response that is formatted by
+	// HTTP::FormatAccessRequest, because the request is reset before the
+	// response is sent. Empty if there's no access log, or once the record
+	// has been logged.
+	std::string cgiAccessRecord;
+
+	// Returns a compressor of [coding] from the pool of the worker, or a new
+	// one for threaded clients. Returns nullptr if [coding] isn't supported.
+	[[nodiscard]] std::unique_ptr<Compressor>
+	AcquireCompressor(ContentCoding coding) noexcept;
+
+	// Watches the descriptors the CGI script is awaited on instead of the
+	// connection, e.g. its output, or the connection to the upstream while
+	// the request is sent. Only for event-driven clients.
+	void
+	AwaitCGI() noexcept;
+
 	[[nodiscard]] std::size_t
 	CalculateMinLengthRequestTargetAbsoluteForm() const noexcept;
 
+	// Whether a body of [length] octets of [mediaType] should be compressed
+	// on the fly, if the client accepts it.
+	[[nodiscard]] bool
+	CanCompress(const MediaType &mediaType, std::size_t length) const noexcept;
+
 	// Checks if the connection should be closed due to security policies.
 	[[nodiscard]] bool
 	CheckConnectionLifetime() noexcept;
 
-	// Checks if the file is valid (e.g. inside the actual rootDirectory).
-	[[nodiscard]] ClientError
-	CheckFileLocation(const std::string &) const noexcept;
-
 	[[nodiscard]] ClientError
 	CheckUpgradeHTTPS() const noexcept;
 
-	// A before-destructor clean function, ran at the end of 'Entrypoint'.
+	// Stops watching the connection and lets the worker destroy this client.
+	// Only for event-driven clients.
 	void
-	Clean() noexcept;
+	CloseEventDriven() noexcept;
+
+	// Compresses the whole of [file] with [coding]. Returns nullptr if the
+	// file couldn't be read or compressed.
+	[[nodiscard]] std::shared_ptr<const std::string>
+	CompressFile(const IO::CachedFile &file, ContentCoding coding) noexcept;
 
 	[[nodiscard]] ClientError
 	ConsumeCRLF() noexcept;
 
+	// Reads the output of the CGI script that is available, and sends it:
+	// the metadata once the header section of the script is complete, and
+	// the body as it comes in. Returns WOULD_BLOCK if the script has no
+	// output yet.
+	[[nodiscard]] Connection::Status
+	ContinueCGI() noexcept;
+
+	// Runs a step of the HTTP/2 session: the frames that have been received
+	// are handled, and the response bodies are sent as far as possible.
+	//
+	// Returns false if the connection should be closed once the send backlog
+	// has been flushed.
+	[[nodiscard]] bool
+	ContinueSession() noexcept;
+
+	// Acts on the result of a step of Connection::ContinueSetup. Returns
+	// whether or not the setup is complete, i.e. exchanges can be run.
+	[[nodiscard]] bool
+	HandleSetupStatus(Connection::Status) noexcept;
+
 	// Effectively runs ConsumeHeaderFieldName and ConsumeHeaderFieldValue, and
 	// combines the collected data and pushes them into a pair in
 	// 'client.headers'.
@@ -110,15 +409,6 @@ TESTING_VISIBILITY:
 	[[nodiscard]] ClientError
 	ConsumeHeaders() noexcept;
 
-	// Checks if the 'Host' header is correct. This function verifies that one,
-	// and only one 'Host' header is present, and that the 'Host' header
-	// corresponds with the hostname of the server/machine.
-	//
-	// See RFC 7230 § 5.4
-	// https://svn.tools.ietf.org/svn/wg/httpbis/specs/rfc7230.html#rfc.section.5.4.p.8
-	[[nodiscard]] ClientError
-	CheckHostHeader() noexcept;
-
 	// See RFC 7230 § 5.3
 	// https://svn.tools.ietf.org/svn/wg/httpbis/specs/rfc7230.html#request-target
 	// NOTE This function only supports relative paths (i.e. paths starting
@@ -136,16 +426,52 @@ TESTING_VISIBILITY:
 	[[nodiscard]] ClientError
 	ConsumeVersion() noexcept;
 
-	// The Entrypoint of the client. This is the first effective call after
-	// summoning a new thread. This function calls repeatedly RunMessageExchange
-	// until EOS or error. Then it calls 'Clean'.
+	// Sends the remains of the previous response, i.e. the send backlog of the
+	// connection and the pending file body. Only for event-driven clients.
+	[[nodiscard]] Connection::Status
+	ContinueResponse() noexcept;
+
+	// Consumes the head of the request from the receive buffer, so the body
+	// can be read, after copying the parts 'currentRequest' refers to into
+	// the arena.
 	void
-	Entrypoint();
+	DetachRequest() noexcept;
+
+	// Discards the rest of the body of the previous request that has been
+	// received. A body larger than MAGIC_BODY_DRAIN_LIMIT isn't awaited, nor
+	// a malformed one: the connection is closed instead.
+	//
+	// Returns false if more of the body is expected
+	[[nodiscard]] bool
+	DrainBody() noexcept;
 
 	// Extract things like the query parameters from the path.
 	[[nodiscard]] ClientError
 	ExtractComponentsFromPath() noexcept;
 
+	// Ends the exchange with the CGI script that failed, or timed out. The
+	// response is replaced by one with [statusLine] and [page], or the
+	// connection is closed if the metadata has already been sent.
+	//
+	// Returns success status
+	[[nodiscard]] bool
+	FailCGI(const base::String &statusLine, const base::String &page) noexcept;
+
+	// Ends the body of the CGI response with [last], the last part of the
+	// output of the script, once it has finished.
+	//
+	// Returns success status
+	[[nodiscard]] bool
+	FinishCGI(std::string_view last) noexcept;
+
+	// Passes the body of the request to the CGI script as far as it has been
+	// received, and as far as the script accepts it, see cgiInputBlocked.
+	// Returns WOULD_BLOCK if more is expected, and COMPLETE once the body has
+	// been passed, or an error response has replaced the response of the
+	// script.
+	[[nodiscard]] Connection::Status
+	ForwardBody() noexcept;
+
 	// This function handles the FILE_NOT_FOUND ClientError. It is called from
 	// RecoverError.
 	[[nodiscard]] bool
@@ -161,6 +487,13 @@ TESTING_VISIBILITY:
 	void
 	InterpretConnectionHeaders() noexcept;
 
+	// Whether the head of the next request has been received already, while
+	// the previous response has been produced completely, i.e. the responses
+	// to both can be sent together. A malformed head counts too, since the
+	// error response is sent right away as well.
+	[[nodiscard]] bool
+	IsPipelining() noexcept;
+
 	// Mark the connection as to-be-closed. It will eventually be closed after a
 	// new run of Entrypoint's while loop.
 	//
@@ -172,14 +505,43 @@ TESTING_VISIBILITY:
 	void
 	MarkConnectionClosing() noexcept;
 
+	// Returns a compressor acquired with AcquireCompressor.
+	void
+	ReleaseCompressor(std::unique_ptr<Compressor> compressor) noexcept;
+
+	// Runs the next step of the TLS handshake on the crypto pool of the
+	// server, if it has one and the queue isn't full. The result is handed to
+	// OnSetupOffloaded on the thread of the worker.
+	//
+	// Returns whether or not the step was offloaded
+	[[nodiscard]] bool
+	OffloadSetup() noexcept;
+
+	void
+	OnSetupOffloaded(Connection::Status) noexcept;
+
+	// Called when a descriptor of the CGI script is ready, see AwaitCGI.
+	void
+	OnCGIEvent() noexcept;
+
+	// Reads the next part of the body of the request, from the receive buffer
+	// and then the connection, after sending a 100 (Continue) response if the
+	// peer awaits it. [data] refers to the receive buffer, until the next
+	// read.
+	[[nodiscard]] BodyReader::Status
+	ReadBody(base::String &data) noexcept;
+
+	// Parses the head of the request with 'parser', reading from the connection
+	// until the head is complete. Event-driven clients feed the parser before
+	// RunMessageExchange is called, so they won't have to wait.
+	[[nodiscard]] ClientError
+	ParseRequest() noexcept;
+
 	// This function is called after a subroutine encounters an error. Some
 	// errors can be handled gracefully (e.g. FILE_NOT_FOUND), but some can't.
 	[[nodiscard]] bool
 	RecoverError(ClientError) noexcept;
 
-	[[nodiscard]] bool
-	RecoverErrorBadRequest(const base::String &) noexcept;
-
 	// Handles the FILE_NOT_FOUND ClientError. Called by RecoverError.
 	[[nodiscard]] bool
 	RecoverErrorFileNotFound() noexcept;
@@ -189,42 +551,192 @@ TESTING_VISIBILITY:
 	[[nodiscard]] bool
 	RecoverErrorFileReadInsufficientPermissions() noexcept;
 
-	// Clears the 'currentRequest' member variable.
+	// Stops watching the descriptors of AwaitCGI.
+	void
+	RemoveCGIDescriptors() noexcept;
+
+	// Stops the CGI script, if there is one, and resets the state of the CGI
+	// response.
+	void
+	ResetCGI() noexcept;
+
+	// Consumes the head of the request from the receive buffer, and resets
+	// 'currentRequest' and the parser. The body is drained, unless it is
+	// passed to the CGI script.
 	void
 	ResetExchangeState() noexcept;
 
+	// The event-driven counterpart of Entrypoint's while loop: runs message
+	// exchanges until the connection would block, or should be closed.
+	void
+	RunEventDrivenExchanges() noexcept;
+
+	// The event-driven counterpart of RunSession.
+	void
+	RunEventDrivenSession() noexcept;
+
 	// This function calls the correct subroutines exchange functions. Called
 	// by 'Entrypoint', on failure, RecoverError is called and false is returned.
 	[[nodiscard]] bool
 	RunMessageExchange() noexcept;
 
+	// Runs the HTTP/2 session until the connection is closed. Called by
+	// 'Entrypoint'.
+	void
+	RunSession() noexcept;
+
+	// Schedules the timer of this client on the wheel of the worker for what
+	// the connection is waiting for, before returning to the event loop:
+	// - the output of a CGI script: the deadline of the script;
+	// - the peer accepting more of the response, or the next frame of an
+	//   HTTP/2 session: maxIdleTime, from now;
+	// - the rest of the head of a request, or the TLS handshake:
+	//   maxRequestHeadTime, from the first octet of the head;
+	// - the next request: maxIdleTime, from now. The connection is parked
+	//   meanwhile.
+	// The latter two are limited by the remaining maxConnectionLifetime.
+	// Only for event-driven clients.
+	void
+	ScheduleTimeout() noexcept;
+
+	// Selects the range of [file] the request asks for with the Range header
+	// field, taking If-Range into account.
+	[[nodiscard]] RangeStatus
+	SelectRange(const IO::CachedFile &file, ByteRange &range) const noexcept;
+
+	// Selects the coding the client accepts best of those that can be
+	// compressed on the fly, or IDENTITY.
+	[[nodiscard]] ContentCoding
+	SelectCompression() const noexcept;
+
+	// Compresses and sends the next chunk of the pending file, see
+	// 'pendingCompressor'. Ends the body after the last chunk.
+	//
+	// Returns success status
+	[[nodiscard]] bool
+	SendCompressedChunk() noexcept;
+
+	// Starts the CGI response with the status line and the fields of the
+	// header section of the script. The metadata is sent together with the
+	// first part of the body, see ResponseWriter.
+	void
+	StartCGIResponse() noexcept;
+
 	// Sends the HTTP metadata. (See below for more information.)
 	[[nodiscard]] bool
 	SendMetadata(const base::String &response, std::size_t contentLength, const MediaType &type, const char *additionalMetaData = nullptr) noexcept;
 
-	// Run the CGI algorithm.
+	// Starts timing a stage, if the configuration has metrics.
+	void
+	StartStage() noexcept;
+
+	// Records the duration of [stage], if it is being timed, and starts
+	// timing the next stage.
+	void
+	EndStage(Stage stage) noexcept;
+
+	// Records the duration of [stage], if it is being timed, and stops
+	// timing.
+	void
+	FinishStage(Stage stage) noexcept;
+
+	// Ends the stage that started when the connection was registered, which
+	// is the TLS handshake for connections with TLS.
+	void
+	FinishSetupStage() noexcept;
+
+	// Whether the request is for the metrics endpoint and the peer is
+	// allowed to see it, see Configuration::metricsPath.
 	[[nodiscard]] bool
-	ServeCGI(const CGI::Script *) noexcept;
+	IsMetricsRequest() const noexcept;
+
+	// Returns success status
+	[[nodiscard]] bool
+	ServeMetrics() noexcept;
+
+	// Appends the record of the response to the access log of the
+	// configuration, if any. See HTTP::LogAccess.
+	void
+	LogAccess(std::string_view statusLine, std::size_t bodyLength) noexcept;
+
+	// Serializes the HTTP metadata into buffers.metadata, without sending it.
+	// Used by SendMetadata. A [contentLength] of unknownContentLength
+	// announces chunked transfer coding instead.
+	void
+	SerializeMetadata(const base::String &response, std::size_t contentLength, const MediaType &type, const char *additionalMetaData) noexcept;
+
+	// Sends [count] octets of [file] from [offset] as the response body.
+	// Event-driven clients send the file as far as possible, and continue
+	// once the connection is writable.
+	[[nodiscard]] bool
+	SendFileBody(const std::shared_ptr<const IO::CachedFile> &file, off_t offset, std::size_t count) noexcept;
+
+	// Starts [script] with the meta-variables of the current request, or
+	// forwards the request to it for Protocol::HTTP, and sends its response.
+	// Event-driven clients send the output as far as it is available, and
+	// continue once there is more.
+	//
+	// Spec: RFC 3875
+	[[nodiscard]] bool
+	ServeCGI(const CGI::Script *script) noexcept;
 
 	// When the homepage of the site couldn't be found. (See below for more
 	// information.)
 	[[nodiscard]] bool
 	ServeDefaultPage() noexcept;
 
+	// Sends the precomputed response to [error], which should have one, see
+	// Server::FindErrorResponse.
+	[[nodiscard]] bool
+	ServeErrorResponse(ClientError error) noexcept;
+
 	// Send a response with a body defined in the base/strings.xpp files.
 	[[nodiscard]] bool
 	ServeStringRequest(const base::String &, const MediaType &, const base::String &body) noexcept;
 
+	// Sends [file] compressed with the coding the client accepts, either from
+	// the compression cache, or compressed while it is sent.
+	//
+	// Returns false if the file should be sent uncompressed instead. Otherwise
+	// [error] is the result of handling the request.
+	[[nodiscard]] bool
+	TryServeCompressedFile(const std::shared_ptr<const IO::CachedFile> &file, ClientError &error) noexcept;
+
+	// Starts the HTTP/2 session of the connection.
+	//
+	// Returns success status
+	[[nodiscard]] bool
+	StartSession() noexcept;
+
+	// Watches the connection again after AwaitCGI.
+	//
+	// Returns success status
+	[[nodiscard]] bool
+	StopAwaitingCGI() noexcept;
+
+	// Changes the readiness the event loop watches the connection for.
+	void
+	UpdateInterest(std::uint32_t) noexcept;
+
 	[[nodiscard]] ClientError
 	ValidateCurrentRequestPath() noexcept;
 
+	// Receives the first octets of the next request, see IsIdle.
+	//
+	// Returns false if the connection has been closed, or the server drains
+	[[nodiscard]] bool
+	WaitForRequest() noexcept;
+
 public:
 	// This value is encremented if Security::Policies::maxRequestsCloseImmediately
 	// is true: ResetExchangeState
 	// is false: HandleRequest
 	std::size_t requestCount{0};
-	std::thread thread;
-	std::chrono::time_point<std::chrono::high_resolution_clock> startingTimePoint;
+
+	// The handle of this client in the registry of the worker it is owned by.
+	base::SlotHandle handle;
+
+	std::chrono::steady_clock::time_point startingTimePoint;
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -253,9 +765,9 @@ public:
 //
 // The lookup for request-target "/", with DIR as the PUBLIC_HTML directory, is
 // as follows:
+// CGI script, if "/" is routed
 // DIR/index.html
 // DIR/index.*
-// CGI script
 // default page
 //
 // The default page of the site is an example test page. This document is
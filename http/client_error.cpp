@@ -14,6 +14,7 @@ ClientErrorToString(HTTP::ClientError error) {
 		"CHECK_FILE_LOCATION_VERIFICATION_FAILURE",
 		"CHECK_FILE_LOCATION_OUTSIDE_ROOT_DIRECTORY",
 		"EMPTY_METHOD",
+		"FAILED_READ_BODY",
 		"FAILED_READ_GENERIC",
 		"FAILED_READ_HEADER_FIELD_GENERIC",
 		"FAILED_READ_HEADER_FIELD_NAME",
@@ -33,6 +34,8 @@ ClientErrorToString(HTTP::ClientError error) {
 		"HOST_HEADER_INCORRECT_PORT",
 		"HOST_HEADER_MANY",
 		"HOST_HEADER_NONE",
+		"INCORRECT_BODY_FRAMING",
+		"INCORRECT_CHUNK",
 		"INCORRECT_HEADER_FIELD_NAME",
 		"INCORRECT_HEADER_FIELD_NEWLINE",
 		"INCORRECT_HEADER_FIELD_VALUE",
@@ -44,14 +47,18 @@ ClientErrorToString(HTTP::ClientError error) {
 		"INVALID_PATH_EMPTY",
 		"INVALID_PATH_NOT_ABSOLUTE",
 		"NO_ERROR",
+		"POLICY_TOO_LARGE_BODY",
 		"POLICY_TOO_LONG_HEADER_FIELD_NAME",
 		"POLICY_TOO_LONG_HEADER_FIELD_VALUE",
 		"POLICY_TOO_LONG_METHOD",
 		"POLICY_TOO_LONG_REQUEST_TARGET",
+		"POLICY_TOO_MANY_HEADERS",
 		"POLICY_TOO_MANY_OWS",
+		"REQUEST_HEAD_TOO_LARGE",
 		"TOO_MANY_REQUESTS_PER_THIS_CONNECTION",
 		"UNEXPECTED_CR_IN_FIELD_NAME",
 		"UPGRADE_TO_HTTPS",
+		"UNSUPPORTED_TRANSFER_CODING",
 		"UNSUPPORTED_VERSION",
 		"WHITESPACE_EXPECTED"
 	};
@@ -0,0 +1,230 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include "http/client_pool.hpp"
+
+#include <algorithm>
+#include <new>
+#include <utility>
+
+#include <climits>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "base/logger.hpp"
+#include "http/client.hpp"
+#include "http/server.hpp"
+#include "posix/unistd.hpp"
+
+namespace HTTP {
+
+namespace {
+
+// Rounds [stackSize] up to the minimum stack size and to whole pages, which
+// pthread_attr_setstacksize(3) might demand.
+[[nodiscard]] std::size_t
+AdjustStackSize(std::size_t stackSize) noexcept {
+	stackSize = std::max<std::size_t>(stackSize, PTHREAD_STACK_MIN);
+
+	const long pageSize = sysconf(_SC_PAGESIZE);
+	if (pageSize > 0) {
+		const auto page = static_cast<std::size_t>(pageSize);
+		stackSize = (stackSize + page - 1) / page * page;
+	}
+	return stackSize;
+}
+
+} // namespace
+
+ClientPool::ClientPool(Server &server, std::size_t threadCount, std::size_t queueCapacity, std::size_t stackSize)
+	: server(server), threadCount(threadCount), stackSize(stackSize), queue(queueCapacity) {
+}
+
+ClientPool::~ClientPool() noexcept {
+	Stop();
+}
+
+bool
+ClientPool::Next(PendingConnection &connection) noexcept {
+	if (!running.load(std::memory_order_acquire)) {
+		return false;
+	}
+
+	if (queue.TryPop(connection)) {
+		return true;
+	}
+
+	std::unique_lock lock(mutex);
+
+	// Pairs with the fence of TrySubmit: either the submitter sees this
+	// sleeper and notifies it, or this thread sees the connection.
+	sleepers.fetch_add(1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	bool popped = false;
+	condition.wait(lock, [&] {
+		return !running.load(std::memory_order_relaxed) || (popped = queue.TryPop(connection));
+	});
+
+	sleepers.fetch_sub(1, std::memory_order_relaxed);
+	return popped;
+}
+
+void *
+ClientPool::Run(void *thread) noexcept {
+	auto &self = *static_cast<Thread *>(thread);
+	self.pool->Serve(self);
+	return nullptr;
+}
+
+void
+ClientPool::Serve(Thread &thread) noexcept {
+	// The client of this thread, reused for every connection it serves.
+	std::unique_ptr<Client> client;
+
+	PendingConnection pending;
+	while (Next(pending)) {
+		{
+			const std::lock_guard guard(thread.mutex);
+
+			// Stop has shut down the connections being served already.
+			if (!running.load(std::memory_order_relaxed)) {
+				psx::close(pending.socket);
+				pending.lease.Reset();
+				connections.fetch_sub(1, std::memory_order_relaxed);
+				break;
+			}
+			thread.socket = pending.socket;
+		}
+
+		if (client == nullptr) {
+			// The constructor of Client is noexcept, so running out of memory
+			// here terminates the process, like it does in Worker.
+			client = std::make_unique<Client>(&server, pending.socket, std::move(pending.lease));
+
+			const std::lock_guard guard(thread.mutex);
+			thread.client = client.get();
+		} else {
+			client->Reuse(pending.socket, std::move(pending.lease));
+		}
+
+		client->Entrypoint();
+
+		{
+			const std::lock_guard guard(thread.mutex);
+			thread.socket = -1;
+		}
+		client->Release();
+		connections.fetch_sub(1, std::memory_order_relaxed);
+	}
+
+	const std::lock_guard guard(thread.mutex);
+	thread.client = nullptr;
+}
+
+bool
+ClientPool::Start() noexcept {
+	running.store(true, std::memory_order_release);
+
+	pthread_attr_t attributes;
+	if (pthread_attr_init(&attributes) != 0) {
+		running.store(false, std::memory_order_release);
+		return false;
+	}
+
+	if (stackSize != 0 && pthread_attr_setstacksize(&attributes, AdjustStackSize(stackSize)) != 0) {
+		Logger::Warning("HTTPClientPool::Start", "Failed to set the stack size, using the default");
+	}
+
+	try {
+		threads.reserve(threadCount);
+		for (std::size_t i = 0; i < threadCount; i++) {
+			auto thread = std::make_unique<Thread>();
+			thread->pool = this;
+			if (pthread_create(&thread->handle, &attributes, &ClientPool::Run, thread.get()) != 0) {
+				break;
+			}
+			threads.push_back(std::move(thread));
+		}
+	} catch (const std::bad_alloc &) {
+		// The threads that did start serve the connections.
+	}
+	pthread_attr_destroy(&attributes);
+
+	if (threads.empty()) {
+		running.store(false, std::memory_order_release);
+		return false;
+	}
+
+	if (threads.size() != threadCount) {
+		Logger::Warning("HTTPClientPool::Start", "Not all threads could be started");
+	}
+	return true;
+}
+
+void
+ClientPool::Stop() noexcept {
+	{
+		const std::lock_guard lock(mutex);
+		running.store(false, std::memory_order_release);
+		condition.notify_all();
+	}
+
+	// The threads are blocked on their connections, which are shut down so
+	// that the calls return.
+	for (const auto &thread : threads) {
+		const std::lock_guard guard(thread->mutex);
+		if (thread->socket != -1) {
+			static_cast<void>(shutdown(thread->socket, SHUT_RDWR));
+		}
+	}
+
+	for (const auto &thread : threads) {
+		pthread_join(thread->handle, nullptr);
+	}
+	threads.clear();
+
+	PendingConnection pending;
+	while (queue.TryPop(pending)) {
+		psx::close(pending.socket);
+		pending.lease.Reset();
+		connections.fetch_sub(1, std::memory_order_relaxed);
+	}
+}
+
+void
+ClientPool::ShutdownIdle() noexcept {
+	for (const auto &thread : threads) {
+		const std::lock_guard guard(thread->mutex);
+		if (thread->socket != -1 && thread->client != nullptr && thread->client->IsIdle()) {
+			static_cast<void>(shutdown(thread->socket, SHUT_RDWR));
+		}
+	}
+}
+
+bool
+ClientPool::TrySubmit(int socket, Security::AddressLease &lease) noexcept {
+	// Counted before it is queued, so a thread serving it right away doesn't
+	// underflow the count.
+	connections.fetch_add(1, std::memory_order_relaxed);
+
+	PendingConnection pending{ socket, std::move(lease) };
+	if (!queue.TryPush(pending)) {
+		connections.fetch_sub(1, std::memory_order_relaxed);
+		lease = std::move(pending.lease);
+		return false;
+	}
+
+	// See Next.
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (sleepers.load(std::memory_order_relaxed) != 0) {
+		const std::lock_guard lock(mutex);
+		condition.notify_one();
+	}
+	return true;
+}
+
+} // namespace HTTP
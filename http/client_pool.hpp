@@ -0,0 +1,125 @@
+#pragma once
+
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <cstddef>
+#include <pthread.h>
+
+#include "base/mpmc_queue.hpp"
+#include "security/address_limiter.hpp"
+
+namespace HTTP {
+
+	// Forward-decl from client.hpp
+	class Client;
+
+	// Forward-decl from server.hpp
+	class Server;
+
+} // namespace HTTP
+
+namespace HTTP {
+
+// The threads of the ServingMode::THREAD_PER_CLIENT serving mode. A fixed
+// amount of threads is started up front, with small stacks, and they take the
+// accepted connections from a lock-free queue. A thread serves a connection
+// at a time and blocks on it. It has a client of its own, which is reused for
+// its next connection, so the buffers of the client are allocated once per
+// thread instead of once per connection.
+//
+// Idle threads sleep until a connection is queued, see Next.
+class ClientPool {
+public:
+	// [stackSize] is the size of the stacks of the threads in octets, 0
+	// meaning the default of the platform.
+	ClientPool(Server &server, std::size_t threadCount, std::size_t queueCapacity, std::size_t stackSize);
+
+	// Stops the pool, see Stop.
+	~ClientPool() noexcept;
+
+	ClientPool(const ClientPool &) = delete;
+	ClientPool &operator=(const ClientPool &) = delete;
+
+	// Returns success status, which is success if any thread started.
+	[[nodiscard]] bool
+	Start() noexcept;
+
+	// Shuts the connections being served down, closes the queued ones, and
+	// joins the threads. Not to be called concurrently with TrySubmit.
+	void
+	Stop() noexcept;
+
+	// Shuts down the connections whose thread waits for their next request,
+	// see Client::IsIdle. Called when the server drains, since those threads
+	// would otherwise only notice once the peer sends or the idle time
+	// passes.
+	void
+	ShutdownIdle() noexcept;
+
+	// Queues the connection on [socket] for a thread. Returns false if the
+	// queue is full, in which case [socket] and [lease] are left untouched.
+	[[nodiscard]] bool
+	TrySubmit(int socket, Security::AddressLease &lease) noexcept;
+
+	// The amount of connections queued or being served.
+	[[nodiscard]] inline std::size_t
+	ConnectionCount() const noexcept {
+		return connections.load(std::memory_order_relaxed);
+	}
+
+private:
+	struct PendingConnection {
+		int socket{ -1 };
+		Security::AddressLease lease;
+	};
+
+	struct Thread {
+		ClientPool *pool;
+		pthread_t handle;
+
+		// The socket being served and the client serving it, guarded by
+		// 'mutex', so Stop doesn't shut down a socket that has been closed
+		// and reused since.
+		std::mutex mutex;
+		int socket{ -1 };
+		Client *client{ nullptr };
+	};
+
+	Server &server;
+	const std::size_t threadCount;
+	const std::size_t stackSize;
+
+	base::MPMCQueue<PendingConnection> queue;
+	std::atomic<std::size_t> connections{ 0 };
+
+	std::mutex mutex;
+	std::condition_variable condition;
+	std::atomic<std::size_t> sleepers{ 0 };
+	std::atomic<bool> running{ false };
+
+	std::vector<std::unique_ptr<Thread>> threads;
+
+	// Waits for a connection. Returns false if the pool is stopping.
+	[[nodiscard]] bool
+	Next(PendingConnection &connection) noexcept;
+
+	// The function of each thread, whose argument is its Thread.
+	static void *
+	Run(void *thread) noexcept;
+
+	// Serves the connections of the queue until the pool stops.
+	void
+	Serve(Thread &thread) noexcept;
+};
+
+} // namespace HTTP
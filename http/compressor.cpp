@@ -0,0 +1,242 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include "http/compressor.hpp"
+
+#include <new>
+
+#include <cstdint>
+
+#include <zlib.h>
+
+#if defined(WEBSERVER_HAVE_BROTLI)
+#include <brotli/encode.h>
+#endif
+
+// The zlib compression level (1-9). The default level is a good compromise
+// between the time spent and the size of the output.
+#define MAGIC_GZIP_LEVEL 6
+
+// The brotli quality (0-11). The higher qualities are too slow to compress
+// responses on the fly.
+#define MAGIC_BROTLI_QUALITY 5
+
+// The base-2 logarithm of the brotli window, which determines its memory
+// usage (2^20 is 1 MiB).
+#define MAGIC_BROTLI_WINDOW 20
+
+// The amount of octets the output grows with while compressing.
+#define MAGIC_COMPRESSOR_OUTPUT_STEP 16384
+
+// The maximum amount of idle compressors per coding kept by a pool.
+#define MAGIC_COMPRESSOR_POOL_SIZE 16
+
+namespace HTTP {
+
+namespace {
+
+class GzipCompressor final : public Compressor {
+public:
+	GzipCompressor() noexcept
+		: Compressor(ContentCoding::GZIP) {
+	}
+
+	~GzipCompressor() noexcept override {
+		if (initialized) {
+			deflateEnd(&stream);
+		}
+	}
+
+	[[nodiscard]] bool
+	Initialize() noexcept {
+		// A window of 15 bits, plus 16 for the gzip header and trailer.
+		initialized = deflateInit2(&stream, MAGIC_GZIP_LEVEL, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+		return initialized;
+	}
+
+	[[nodiscard]] bool
+	Compress(std::string_view input, bool finish, std::string &output) noexcept override {
+		stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(input.data()));
+		stream.avail_in = static_cast<uInt>(input.length());
+
+		while (true) {
+			const auto offset = output.length();
+			output.resize(offset + MAGIC_COMPRESSOR_OUTPUT_STEP);
+			stream.next_out = reinterpret_cast<Bytef *>(output.data() + offset);
+			stream.avail_out = MAGIC_COMPRESSOR_OUTPUT_STEP;
+
+			const int status = deflate(&stream, finish ? Z_FINISH : Z_NO_FLUSH);
+			output.resize(offset + MAGIC_COMPRESSOR_OUTPUT_STEP - stream.avail_out);
+
+			if (status == Z_STREAM_ERROR) {
+				Reset();
+				return false;
+			}
+
+			if (status == Z_STREAM_END) {
+				Reset();
+				return true;
+			}
+
+			if (!finish && stream.avail_in == 0 && stream.avail_out != 0) {
+				return true;
+			}
+		}
+	}
+
+	void
+	Reset() noexcept override {
+		deflateReset(&stream);
+	}
+
+private:
+	z_stream stream{};
+	bool initialized{ false };
+};
+
+#if defined(WEBSERVER_HAVE_BROTLI)
+class BrotliCompressor final : public Compressor {
+public:
+	BrotliCompressor() noexcept
+		: Compressor(ContentCoding::BROTLI) {
+	}
+
+	~BrotliCompressor() noexcept override {
+		if (state != nullptr) {
+			BrotliEncoderDestroyInstance(state);
+		}
+	}
+
+	[[nodiscard]] bool
+	Initialize() noexcept {
+		state = BrotliEncoderCreateInstance(nullptr, nullptr, nullptr);
+		return state != nullptr &&
+			   BrotliEncoderSetParameter(state, BROTLI_PARAM_QUALITY, MAGIC_BROTLI_QUALITY) &&
+			   BrotliEncoderSetParameter(state, BROTLI_PARAM_LGWIN, MAGIC_BROTLI_WINDOW);
+	}
+
+	[[nodiscard]] bool
+	Compress(std::string_view input, bool finish, std::string &output) noexcept override {
+		if (state == nullptr) {
+			return false;
+		}
+		started = true;
+
+		auto availableIn = input.length();
+		const auto *nextIn = reinterpret_cast<const std::uint8_t *>(input.data());
+		const auto operation = finish ? BROTLI_OPERATION_FINISH : BROTLI_OPERATION_PROCESS;
+
+		while (true) {
+			const auto offset = output.length();
+			output.resize(offset + MAGIC_COMPRESSOR_OUTPUT_STEP);
+			std::size_t availableOut = MAGIC_COMPRESSOR_OUTPUT_STEP;
+			auto *nextOut = reinterpret_cast<std::uint8_t *>(output.data() + offset);
+
+			const auto status = BrotliEncoderCompressStream(state, operation, &availableIn, &nextIn,
+															&availableOut, &nextOut, nullptr);
+			output.resize(offset + MAGIC_COMPRESSOR_OUTPUT_STEP - availableOut);
+
+			if (!status) {
+				Reset();
+				return false;
+			}
+
+			if (availableIn == 0 && !BrotliEncoderHasMoreOutput(state) &&
+				(!finish || BrotliEncoderIsFinished(state))) {
+				break;
+			}
+		}
+
+		if (finish) {
+			Reset();
+		}
+		return true;
+	}
+
+	// The encoder can't be reset, so it is created anew.
+	void
+	Reset() noexcept override {
+		if (!started && state != nullptr) {
+			return;
+		}
+
+		started = false;
+		BrotliEncoderDestroyInstance(state);
+		if (!Initialize() && state != nullptr) {
+			BrotliEncoderDestroyInstance(state);
+			state = nullptr;
+		}
+	}
+
+private:
+	BrotliEncoderState *state{ nullptr };
+
+	// Whether the encoder has been used since it was created.
+	bool started{ false };
+};
+#endif
+
+} // namespace
+
+std::unique_ptr<Compressor>
+Compressor::Create(ContentCoding coding) noexcept {
+	switch (coding) {
+		case ContentCoding::GZIP: {
+			auto compressor = std::unique_ptr<GzipCompressor>(new (std::nothrow) GzipCompressor());
+			if (compressor != nullptr && compressor->Initialize()) {
+				return compressor;
+			}
+			break;
+		}
+#if defined(WEBSERVER_HAVE_BROTLI)
+		case ContentCoding::BROTLI: {
+			auto compressor = std::unique_ptr<BrotliCompressor>(new (std::nothrow) BrotliCompressor());
+			if (compressor != nullptr && compressor->Initialize()) {
+				return compressor;
+			}
+			break;
+		}
+#endif
+		default:
+			break;
+	}
+
+	return nullptr;
+}
+
+bool
+Compressor::IsSupported(ContentCoding coding) noexcept {
+#if defined(WEBSERVER_HAVE_BROTLI)
+	return coding == ContentCoding::GZIP || coding == ContentCoding::BROTLI;
+#else
+	return coding == ContentCoding::GZIP;
+#endif
+}
+
+std::unique_ptr<Compressor>
+CompressorPool::Acquire(ContentCoding coding) noexcept {
+	auto &compressors = idle[static_cast<std::size_t>(coding)];
+	if (compressors.empty()) {
+		return Compressor::Create(coding);
+	}
+
+	auto compressor = std::move(compressors.back());
+	compressors.pop_back();
+	return compressor;
+}
+
+void
+CompressorPool::Release(std::unique_ptr<Compressor> compressor) noexcept {
+	auto &compressors = idle[static_cast<std::size_t>(compressor->Coding())];
+	if (compressors.size() == MAGIC_COMPRESSOR_POOL_SIZE) {
+		return;
+	}
+
+	compressor->Reset();
+	compressors.push_back(std::move(compressor));
+}
+
+} // namespace HTTP
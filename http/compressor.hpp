@@ -0,0 +1,78 @@
+#pragma once
+
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include <array>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "http/content_coding.hpp"
+
+namespace HTTP {
+
+// A streaming encoder of a content-coding. The state of an encoder takes
+// hundreds of kilobytes to set up, so compressors are reused for many
+// responses, see CompressorPool.
+class Compressor {
+public:
+	virtual ~Compressor() noexcept = default;
+
+	// Returns nullptr if [coding] isn't supported, i.e. the server was built
+	// without the library.
+	[[nodiscard]] static std::unique_ptr<Compressor>
+	Create(ContentCoding coding) noexcept;
+
+	[[nodiscard]] static bool
+	IsSupported(ContentCoding coding) noexcept;
+
+	[[nodiscard]] inline ContentCoding
+	Coding() const noexcept {
+		return coding;
+	}
+
+	// Compresses [input] and appends the output to [output]. The output may
+	// be empty until enough input has been collected. When [finish] is true,
+	// the stream is ended, after which the compressor starts a new stream.
+	//
+	// Returns false if the encoder failed, in which case the stream is
+	// abandoned.
+	[[nodiscard]] virtual bool
+	Compress(std::string_view input, bool finish, std::string &output) noexcept = 0;
+
+	// Abandons the current stream, if any.
+	virtual void
+	Reset() noexcept = 0;
+
+protected:
+	explicit inline Compressor(ContentCoding coding) noexcept
+		: coding(coding) {
+	}
+
+private:
+	const ContentCoding coding;
+};
+
+// The idle compressors of a worker. Only touched by the thread of the worker,
+// so no locking is needed.
+class CompressorPool {
+public:
+	// Returns an idle compressor of [coding], or a new one. Returns nullptr if
+	// [coding] isn't supported.
+	[[nodiscard]] std::unique_ptr<Compressor>
+	Acquire(ContentCoding coding) noexcept;
+
+	// Takes back a compressor acquired before, abandoning its stream.
+	void
+	Release(std::unique_ptr<Compressor> compressor) noexcept;
+
+private:
+	std::array<std::vector<std::unique_ptr<Compressor>>, contentCodingCount> idle;
+};
+
+} // namespace HTTP
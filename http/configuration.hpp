@@ -9,15 +9,62 @@
 #include <exception> // IWYU pragma: keep
 #include <iosfwd>
 #include <string>
+#include <vector>
 
+#include <cstddef>
 #include <cstdint>
 
 #include "base/media_type.hpp"
 #include "security/policies.hpp"
 #include "security/tls_configuration.hpp"
 
+namespace base {
+// From base/async_log.hpp:
+class AsyncLog;
+} // namespace base
+
+namespace IO {
+// From io/compression_cache.hpp:
+class CompressionCache;
+// From io/file_cache.hpp:
+class FileCache;
+} // namespace IO
+
 namespace HTTP {
 
+// From http/metrics.hpp:
+class Metrics;
+
+// How the server distributes connections over threads.
+enum class ServingMode {
+	// Every client gets a thread of its own, which blocks on the connection.
+	// The threads are those of a fixed pool, see HTTP::ClientPool.
+	THREAD_PER_CLIENT,
+
+	// The connections are multiplexed on a level-triggered event loop
+	// (epoll(7) on Linux, kqueue(2) on the BSDs), with non-blocking sockets.
+	EVENT_DRIVEN,
+};
+
+// A name-based virtual host, i.e. a site with a root directory of its own,
+// served next to the other sites of the server. The site of a request is
+// selected by its Host header field.
+//
+// Spec: RFC 7230 § 5.4
+struct VirtualHost {
+	// The hostnames of the site, e.g. "example.com" and "www.example.com".
+	// The first is used in redirects.
+	std::vector<std::string> hostnames;
+
+	std::string rootDirectory;
+
+	// The certificate files of the hostnames, see Security::TLSConfiguration.
+	// Empty if the certificate of the server covers them.
+	std::string certificateFile;
+	std::string chainFile;
+	std::string privateKeyFile;
+};
+
 struct Configuration {
 
 	inline Configuration(const MediaTypeFinder &mediaTypeFinder, const Security::Policies &policies,
@@ -26,6 +73,113 @@ struct Configuration {
 		  tlsConfiguration(tlsConfiguration) {
 	}
 
+	// The log the responses are recorded in, see HTTP::LogAccess. The log is
+	// owned, started and stopped by the creator of the configuration, so it
+	// can be shared with other servers. nullptr disables access logging.
+	base::AsyncLog *accessLog { nullptr };
+
+	// The header value of "Alt-Svc", advertising alternative services of
+	// the origin, e.g. an HTTP/3 endpoint in front of the same root
+	// directory: h3=":443"; ma=86400
+	// Empty means omit header.
+	// Spec: RFC 7838
+	std::string altSvc;
+
+	// Whether or not the directories without an index file are served as a
+	// generated listing of their entries, instead of a 404 page. The
+	// listings are kept until the directory changes, see IO::DirectoryIndex.
+	bool autoIndex { false };
+
+	// The maximum amount of listings of autoIndex kept per site.
+	std::size_t autoIndexCapacity { 256 };
+
+	// The maximum amount of accepted connections waiting for a client thread.
+	// When the queue is full, the connections are shed, see
+	// HTTP::AdmissionController.
+	//
+	// Only used by the ServingMode::THREAD_PER_CLIENT serving mode.
+	std::size_t clientQueueCapacity { 256 };
+
+	// The amount of threads serving the connections, each one at a time. The
+	// threads are started by Initialize.
+	//
+	// Only used by the ServingMode::THREAD_PER_CLIENT serving mode.
+	std::size_t clientThreadCount { 64 };
+
+	// The size of the stacks of the client threads in octets, which is
+	// rounded up to the minimum of the platform. The clients keep their
+	// buffers on the heap, so the threads don't need the default stacks of
+	// megabytes. 0 means the default of the platform.
+	//
+	// Only used by the ServingMode::THREAD_PER_CLIENT serving mode.
+	std::size_t clientThreadStackSize { 256 * 1024 };
+
+	// The maximum amount of octets of the files compressed on the fly that
+	// are kept in memory, see IO::CompressionCache. Zero disables the cache.
+	std::size_t compressionCacheCapacity { 16 * 1024 * 1024 };
+
+	// Files larger than this amount of octets aren't stored in the compression
+	// cache, but compressed while they're sent, with chunked transfer coding.
+	std::size_t compressionCacheMaxFileSize { 1024 * 1024 };
+
+	// Whether or not textual responses without a precompressed sibling are
+	// compressed on the fly, when the client accepts it.
+	bool compressionEnabled { true };
+
+	// Responses of fewer octets aren't compressed, since the headers would
+	// outweigh the savings.
+	std::size_t compressionMinimumSize { 256 };
+
+	// The maximum amount of TLS handshake steps queued for the crypto threads.
+	// When the queue is full, the handshake runs on the worker instead.
+	std::size_t cryptoQueueCapacity { 256 };
+
+	// The amount of threads the TLS handshakes are offloaded to, so that the
+	// asymmetric cryptography doesn't stall the event loops of the workers.
+	// Zero runs the handshakes on the workers.
+	//
+	// Only used by the ServingMode::EVENT_DRIVEN serving mode.
+	std::size_t cryptoThreadCount { 0 };
+
+	// How long the connections may take to finish their requests when the
+	// server drains, e.g. during a binary upgrade, see Server::SignalDrain.
+	// The connections that are left are closed afterwards.
+	//
+	// Time is in milliseconds.
+	// 0 means unlimited.
+	std::size_t drainTimeout { 30000 };
+
+	// The maximum amount of files kept open in the file cache of the server.
+	// Zero disables the cache.
+	std::size_t fileCacheCapacity { 1024 };
+
+	// Files of at most this amount of octets are kept in memory by the file
+	// cache, and sent without the intervention of the file system.
+	std::size_t fileCacheMaxContentSize { 64 * 1024 };
+
+	// Larger files of at most this amount of octets are mapped into memory by
+	// the file cache, and written from the mapping without a copy. Zero
+	// disables mapping, in which case they're sent with sendfile(2).
+	//
+	// NOTE: A file that is truncated while it is mapped raises SIGBUS when
+	//       the mapping is written, which stops the server. Only enable this
+	//       if the files are replaced (rename(2)) instead of rewritten in
+	//       place, see IO::File::Map.
+	std::size_t fileCacheMaxMappedSize { 0 };
+
+	// The file the keys of the file cache are saved to when the server is
+	// destroyed or the binary is upgraded, and which prewarmFileCache warms
+	// the cache from, see IO::FileCacheManifest. Servers sharing a file cache
+	// can share the manifest too. Empty means no manifest is kept.
+	std::string fileCacheManifest;
+
+	// The amount of file descriptors that should stay available for the
+	// connections that are admitted, e.g. for opening files and CGI pipes.
+	// Connections accepted with less headroom left under RLIMIT_NOFILE are
+	// shed, see HTTP::AdmissionController.
+	// 0 means no headroom is kept.
+	std::size_t fileDescriptorHeadroom { 64 };
+
 	// The hostname (domain name) of the server.
 	// If unset, will try to get it from the environment.
 	// If not in environment, try to get it from the POSIX gethostname(2) API.
@@ -36,11 +190,67 @@ struct Configuration {
 	// Spec: RFC 6797
 	std::string hsts{ "max-age=31536000; includeSubDomains; preload" };
 
+	// The listening sockets inherited from the previous process during a
+	// binary upgrade, see HTTP::Handoff. When set, the server listens on
+	// them instead of creating sockets of its own, and has a worker for
+	// each of them.
+	std::vector<int> inheritedSockets;
+
 	// The amount of clients awaiting in the accept() queue
 	std::size_t listenerBacklog { 100 };
 
+	// The maximum amount of connections at once. In the event-driven serving
+	// mode, each worker admits its share of them. Connections beyond it are
+	// shed, see HTTP::AdmissionController.
+	// 0 means unlimited.
+	std::size_t maxConnections { 0 };
+
+	// The maximum average time the event loop of a worker may take to
+	// dispatch a batch of events, i.e. how long a ready connection waits for
+	// the worker. Connections accepted by a worker lagging more are shed.
+	//
+	// Time is in milliseconds.
+	// 0 means unlimited.
+	// Only used by the ServingMode::EVENT_DRIVEN serving mode.
+	std::size_t maxEventLoopLag { 500 };
+
 	const MediaTypeFinder &mediaTypeFinder;
 
+	// The instrumentation of the server, see HTTP::Metrics. Like the access
+	// log, the metrics are owned by the creator of the configuration, and
+	// can be shared with other servers. nullptr disables the
+	// instrumentation.
+	Metrics *metrics { nullptr };
+
+	// The path of the request-target the metrics are served at, in the
+	// Prometheus text format, e.g. "/metrics". The endpoint is internal:
+	// only peers on the loopback interface are answered, other clients get
+	// the file at the path, if any. Empty means the metrics aren't served.
+	std::string metricsPath;
+
+	// Whether or not the workers are grouped by NUMA node, so the memory
+	// they use stays local to their node. Worker N runs on node N modulo the
+	// amount of nodes, pinned to a CPU of it (superseding
+	// pinWorkersToCores), and allocates its clients there. Connections are
+	// steered to a worker on the node of the CPU that received them where the
+	// kernel supports it, and the file cache of the server has a partition
+	// per node. A shared file cache is partitioned by its owner.
+	//
+	// Only used by the ServingMode::EVENT_DRIVEN serving mode.
+	bool numaLocalWorkers { false };
+
+	// Whether or not the threads of the workers should be pinned to a CPU core
+	// each, i.e. worker N runs on core N modulo the amount of cores.
+	//
+	// Only used by the ServingMode::EVENT_DRIVEN serving mode.
+	bool pinWorkersToCores { false };
+
+	// Fills the file cache on Initialize, before the server listens, so the
+	// first requests are served from it. The files are those of the
+	// fileCacheManifest if there is one, otherwise the files beneath the root
+	// directories of the sites, at most fileCacheCapacity.
+	bool prewarmFileCache { false };
+
 	// The amount of time should pass between poll() calls to the main server
 	// socket.
 	//
@@ -57,6 +267,8 @@ struct Configuration {
 	// 8080  This port is regularly used on (local) test servers.
 	uint16_t port { 8080 };
 
+	// The root directory of the site of 'hostname', which serves the
+	// requests that aren't for one of the virtual hosts.
 	std::string rootDirectory;
 
 	const Security::Policies &securityPolicies;
@@ -64,15 +276,36 @@ struct Configuration {
 	// The 'Server' header field value as defined per RFC 7231 § 7.4.2
 	std::string serverProductName { "Wizard" };
 
+	// The caches shared with other servers, e.g. with the server listening
+	// on another port for the same sites, so the files are cached once. When
+	// nullptr, the server has a cache of its own, with the capacities above.
+	// A shared file cache is initialized by its owner.
+	IO::CompressionCache *sharedCompressionCache { nullptr };
+	IO::FileCache *sharedFileCache { nullptr };
+
+	// The model used for serving the clients. See ServingMode above.
+	ServingMode servingMode { ServingMode::THREAD_PER_CLIENT };
+
 	// The configuration for the TLS implementation.
 	const Security::TLSConfiguration &tlsConfiguration;
 
 	// Use when on port 80. Redirect all OK requests to HTTPS.
 	bool upgradeToHTTPS{ false };
 
+	// The sites served next to the one of 'hostname'. With TLS, the
+	// certificates of their hostnames are selected with SNI, see
+	// Security::TLSConfiguration::serverNames.
+	std::vector<VirtualHost> virtualHosts;
+
 	// Whether or a security layer should be used.
 	// The security layer is TLS.
 	bool useTransportSecurity { false };
+
+	// The amount of workers, each with an event loop and a listening socket
+	// of its own (SO_REUSEPORT). Zero means one worker per hardware thread.
+	//
+	// Only used by the ServingMode::EVENT_DRIVEN serving mode.
+	std::size_t workerCount { 0 };
 };
 
 class ConfigurationException : public std::exception {
@@ -0,0 +1,101 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include "http/content_coding.hpp"
+
+#include "http/utils.hpp"
+
+namespace HTTP {
+
+static std::string_view
+TrimWhitespace(std::string_view value) noexcept {
+	while (!value.empty() && (value.front() == ' ' || value.front() == '\t')) {
+		value.remove_prefix(1);
+	}
+	while (!value.empty() && (value.back() == ' ' || value.back() == '\t')) {
+		value.remove_suffix(1);
+	}
+	return value;
+}
+
+// Parses the weight of an element, e.g. "q=0.5", in thousandths. Returns 1000
+// for anything malformed, like a missing weight.
+//
+// Spec: RFC 7231 § 5.3.1
+static std::uint16_t
+ParseQuality(std::string_view parameters) noexcept {
+	while (!parameters.empty()) {
+		const auto semicolon = parameters.find(';');
+		const auto parameter = TrimWhitespace(parameters.substr(0, semicolon));
+		parameters = semicolon == std::string_view::npos ? std::string_view() : parameters.substr(semicolon + 1);
+
+		if (parameter.length() < 3 || (parameter[0] | 0x20) != 'q' || parameter[1] != '=') {
+			continue;
+		}
+
+		// qvalue = ( "0" [ "." 0*3DIGIT ] ) / ( "1" [ "." 0*3("0") ] )
+		const auto value = parameter.substr(2);
+		if (value[0] != '0') {
+			return 1000;
+		}
+
+		std::uint16_t quality = 0;
+		std::uint16_t scale = 100;
+		for (std::size_t i = 2; i < value.length() && i < 5; i++) {
+			if (!Utils::IsNumericCharacter(value[i])) {
+				break;
+			}
+			quality += static_cast<std::uint16_t>((value[i] - '0') * scale);
+			scale /= 10;
+		}
+		return quality;
+	}
+
+	return 1000;
+}
+
+AcceptEncoding
+AcceptEncoding::Parse(std::string_view value) noexcept {
+	AcceptEncoding result;
+
+	// Quality of the codings not mentioned, set by "*".
+	std::uint16_t wildcard = 0;
+	std::array<bool, contentCodingCount> mentioned{};
+
+	while (!value.empty()) {
+		const auto comma = value.find(',');
+		const auto element = value.substr(0, comma);
+		value = comma == std::string_view::npos ? std::string_view() : value.substr(comma + 1);
+
+		const auto semicolon = element.find(';');
+		const auto name = TrimWhitespace(element.substr(0, semicolon));
+		const auto quality = semicolon == std::string_view::npos ? 1000 : ParseQuality(element.substr(semicolon + 1));
+
+		if (name == "*") {
+			wildcard = quality;
+			continue;
+		}
+
+		for (std::size_t i = 1; i < contentCodingCount; i++) {
+			const auto coding = static_cast<ContentCoding>(i);
+			if (Utils::EqualsIgnoreCase(name, ContentCodingName(coding)) ||
+				(coding == ContentCoding::GZIP && Utils::EqualsIgnoreCase(name, "x-gzip"))) {
+				result.quality[i] = quality;
+				mentioned[i] = true;
+			}
+		}
+	}
+
+	for (std::size_t i = 1; i < contentCodingCount; i++) {
+		if (!mentioned[i]) {
+			result.quality[i] = wildcard;
+		}
+	}
+
+	return result;
+}
+
+} // namespace HTTP
@@ -0,0 +1,75 @@
+#pragma once
+
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include <array>
+#include <string_view>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace HTTP {
+
+// The content-codings the server can send, in order of preference when the
+// client accepts multiple equally, i.e. from the smallest output.
+//
+// Spec: RFC 7231 § 3.1.2.1
+enum class ContentCoding : std::uint8_t {
+	IDENTITY,
+	BROTLI,
+	GZIP,
+};
+
+constexpr std::size_t contentCodingCount = 3;
+
+// The content-coding token, as used by Accept-Encoding and Content-Encoding.
+[[nodiscard]] inline constexpr std::string_view
+ContentCodingName(ContentCoding coding) noexcept {
+	constexpr std::array<std::string_view, contentCodingCount> names{ "identity", "br", "gzip" };
+	return names[static_cast<std::size_t>(coding)];
+}
+
+// The filename suffix of files precompressed with the coding, e.g. ".br" for
+// "style.css.br".
+[[nodiscard]] inline constexpr std::string_view
+ContentCodingSuffix(ContentCoding coding) noexcept {
+	constexpr std::array<std::string_view, contentCodingCount> suffixes{ "", ".br", ".gz" };
+	return suffixes[static_cast<std::size_t>(coding)];
+}
+
+// The interpreted value of an Accept-Encoding header field.
+//
+// Spec: RFC 7231 § 5.3.4
+struct AcceptEncoding {
+	// The quality value of each coding, in thousandths. The identity coding
+	// is always acceptable.
+	std::array<std::uint16_t, contentCodingCount> quality{ 1000 };
+
+	[[nodiscard]] static AcceptEncoding
+	Parse(std::string_view value) noexcept;
+
+	// Returns the acceptable coding with the highest quality for which
+	// [isAvailable] returns true, or IDENTITY.
+	template <typename Predicate>
+	[[nodiscard]] inline ContentCoding
+	Select(Predicate isAvailable) const noexcept {
+		auto selected = ContentCoding::IDENTITY;
+		std::uint16_t selectedQuality = 0;
+
+		for (std::size_t i = 1; i < contentCodingCount; i++) {
+			const auto coding = static_cast<ContentCoding>(i);
+			if (quality[i] > selectedQuality && isAvailable(coding)) {
+				selected = coding;
+				selectedQuality = quality[i];
+			}
+		}
+
+		return selected;
+	}
+};
+
+} // namespace HTTP
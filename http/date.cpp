@@ -0,0 +1,128 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include "http/date.hpp"
+
+#include <algorithm>
+#include <string_view>
+
+#include "event/clock.hpp"
+
+namespace HTTP {
+
+static constexpr std::array<std::string_view, 7> dayNames{
+	"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat",
+};
+
+static constexpr std::array<std::string_view, 12> monthNames{
+	"Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec",
+};
+
+static char *
+FormatTwoDigits(char *output, int value) noexcept {
+	output[0] = static_cast<char>('0' + value / 10);
+	output[1] = static_cast<char>('0' + value % 10);
+	return output + 2;
+}
+
+static char *
+FormatName(char *output, std::string_view name) noexcept {
+	for (char character : name) {
+		*output++ = character;
+	}
+	return output;
+}
+
+std::string_view
+CurrentDateHeader() noexcept {
+	static constexpr std::string_view name("\r\nDate: ");
+	thread_local std::time_t formatted = -1;
+	thread_local std::array<char, name.length() + dateLength> header;
+
+	const auto seconds = Event::Clock::Seconds();
+	if (seconds != formatted) {
+		std::array<char, dateLength> date;
+		FormatDate(seconds, date);
+		std::copy(std::cbegin(date), std::cend(date), std::copy(std::cbegin(name), std::cend(name), header.data()));
+		formatted = seconds;
+	}
+
+	return { header.data(), header.size() };
+}
+
+void
+FormatDate(std::time_t time, std::array<char, dateLength> &output) noexcept {
+	struct tm parts {};
+	gmtime_r(&time, &parts);
+
+	const int year = parts.tm_year + 1900;
+
+	char *end = FormatName(output.data(), dayNames[parts.tm_wday]);
+	*end++ = ',';
+	*end++ = ' ';
+	end = FormatTwoDigits(end, parts.tm_mday);
+	*end++ = ' ';
+	end = FormatName(end, monthNames[parts.tm_mon]);
+	*end++ = ' ';
+	end = FormatTwoDigits(end, year / 100);
+	end = FormatTwoDigits(end, year % 100);
+	*end++ = ' ';
+	end = FormatTwoDigits(end, parts.tm_hour);
+	*end++ = ':';
+	end = FormatTwoDigits(end, parts.tm_min);
+	*end++ = ':';
+	end = FormatTwoDigits(end, parts.tm_sec);
+	static_cast<void>(FormatName(end, " GMT"));
+}
+
+// Parses the [count] digits at [position] of [date].
+static bool
+ParseDigits(std::string_view date, std::size_t position, std::size_t count, int &value) noexcept {
+	value = 0;
+	for (std::size_t i = position; i < position + count; i++) {
+		if (date[i] < '0' || date[i] > '9') {
+			return false;
+		}
+		value = value * 10 + (date[i] - '0');
+	}
+	return true;
+}
+
+bool
+ParseDate(std::string_view date, std::time_t &time) noexcept {
+	// Sun, 06 Nov 1994 08:49:37 GMT
+	// 0123456789012345678901234567
+	if (date.length() != dateLength || date.substr(3, 2) != ", " || date[7] != ' ' || date[11] != ' ' ||
+		date[16] != ' ' || date[19] != ':' || date[22] != ':' || date.substr(25) != " GMT") {
+		return false;
+	}
+
+	struct tm parts {};
+	int year;
+
+	const auto month = date.substr(8, 3);
+	parts.tm_mon = -1;
+	for (std::size_t i = 0; i < monthNames.size(); i++) {
+		if (monthNames[i] == month) {
+			parts.tm_mon = static_cast<int>(i);
+		}
+	}
+
+	if (parts.tm_mon == -1 ||
+		!ParseDigits(date, 5, 2, parts.tm_mday) ||
+		!ParseDigits(date, 12, 4, year) ||
+		!ParseDigits(date, 17, 2, parts.tm_hour) ||
+		!ParseDigits(date, 20, 2, parts.tm_min) ||
+		!ParseDigits(date, 23, 2, parts.tm_sec)) {
+		return false;
+	}
+
+	parts.tm_year = year - 1900;
+	time = timegm(&parts);
+	return time != -1;
+}
+
+} // namespace HTTP
@@ -0,0 +1,49 @@
+#pragma once
+
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include <array>
+#include <string_view>
+
+#include <cstddef>
+#include <ctime>
+
+namespace HTTP {
+
+// The length of an IMF-fixdate, e.g. "Sun, 06 Nov 1994 08:49:37 GMT".
+constexpr std::size_t dateLength = 29;
+
+// Formats [time] as an IMF-fixdate, the preferred format of HTTP-dates. This
+// doesn't depend on the locale, unlike strftime(3).
+//
+// Spec: RFC 7231 § 7.1.1.1
+void
+FormatDate(std::time_t time, std::array<char, dateLength> &output) noexcept;
+
+// The Date header field of the responses, for the current second of
+// Event::Clock and preceded by a CRLF like Server::StaticHeaders. The field is
+// formatted again once the second has changed, on each thread, so the workers
+// don't share it.
+//
+// Spec: RFC 7231 § 7.1.1.2
+[[nodiscard]] std::string_view
+CurrentDateHeader() noexcept;
+
+// The value of CurrentDateHeader, e.g. for HTTP/2 responses.
+[[nodiscard]] inline std::string_view
+CurrentDate() noexcept {
+	return CurrentDateHeader().substr(std::string_view("\r\nDate: ").length());
+}
+
+// Parses an IMF-fixdate. The obsolete formats (RFC 850 and asctime(3)) aren't
+// accepted, and clients don't send them for validators anyway.
+//
+// Returns success status
+[[nodiscard]] bool
+ParseDate(std::string_view date, std::time_t &time) noexcept;
+
+} // namespace HTTP
@@ -0,0 +1,46 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include "http/entity_tag.hpp"
+
+namespace HTTP::EntityTag {
+
+[[nodiscard]] static constexpr std::string_view
+OpaqueTag(std::string_view tag) noexcept {
+	return IsWeak(tag) ? tag.substr(2) : tag;
+}
+
+bool
+MatchesListWeakly(std::string_view list, std::string_view tag) noexcept {
+	if (list == "*") {
+		return true;
+	}
+
+	const auto opaqueTag = OpaqueTag(tag);
+
+	// #entity-tag: separated by commas and OWS. Commas can't appear inside
+	// an opaque-tag's etagc, so the list can be split on them.
+	while (!list.empty()) {
+		auto end = list.find(',');
+		auto element = list.substr(0, end);
+		list = end == std::string_view::npos ? std::string_view() : list.substr(end + 1);
+
+		while (!element.empty() && (element.front() == ' ' || element.front() == '\t')) {
+			element.remove_prefix(1);
+		}
+		while (!element.empty() && (element.back() == ' ' || element.back() == '\t')) {
+			element.remove_suffix(1);
+		}
+
+		if (!element.empty() && OpaqueTag(element) == opaqueTag) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+} // namespace HTTP::EntityTag
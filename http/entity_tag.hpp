@@ -0,0 +1,37 @@
+#pragma once
+
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include <string_view>
+
+namespace HTTP::EntityTag {
+
+// Whether [tag] is a weak entity-tag, i.e. prefixed with "W/".
+[[nodiscard]] inline constexpr bool
+IsWeak(std::string_view tag) noexcept {
+	return tag.length() >= 2 && tag[0] == 'W' && tag[1] == '/';
+}
+
+// The strong comparison: both entity-tags are strong and equal. Used by
+// If-Range, since the ranges of different representations can't be combined.
+//
+// Spec: RFC 7232 § 2.3.2
+[[nodiscard]] inline constexpr bool
+MatchesStrongly(std::string_view a, std::string_view b) noexcept {
+	return !IsWeak(a) && !IsWeak(b) && a == b;
+}
+
+// Whether [tag] matches one of the entity-tags in [list], the value of an
+// If-None-Match header field, with the weak comparison: the opaque-tags are
+// equal, regardless of whether the entity-tags are weak. "*" matches any
+// entity-tag.
+//
+// Spec: RFC 7232 § 3.2
+[[nodiscard]] bool
+MatchesListWeakly(std::string_view list, std::string_view tag) noexcept;
+
+} // namespace HTTP::EntityTag
@@ -0,0 +1,229 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include "http/handoff.hpp"
+
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// The maximum amount of sockets passed in a single message.
+#define MAGIC_HANDOFF_BATCH_SIZE 64
+
+extern char **environ;
+
+namespace HTTP::Handoff {
+
+namespace {
+
+// Precedes the sockets of a port. A header without sockets for port 0 ends the
+// handoff.
+struct Header {
+	std::uint16_t port;
+	std::uint16_t count;
+};
+
+// Ancillary data with room for a batch of sockets, aligned for the headers.
+union Control {
+	char buffer[CMSG_SPACE(sizeof(int) * MAGIC_HANDOFF_BATCH_SIZE)];
+	struct cmsghdr alignment;
+};
+
+[[nodiscard]] bool
+SendBatch(int channel, Header header, const int *sockets) noexcept {
+	struct iovec vector{ &header, sizeof(header) };
+	struct msghdr message{};
+	message.msg_iov = &vector;
+	message.msg_iovlen = 1;
+
+	Control control{};
+	if (header.count != 0) {
+		const auto length = sizeof(int) * header.count;
+		message.msg_control = control.buffer;
+		message.msg_controllen = CMSG_SPACE(length);
+
+		auto *controlHeader = CMSG_FIRSTHDR(&message);
+		controlHeader->cmsg_level = SOL_SOCKET;
+		controlHeader->cmsg_type = SCM_RIGHTS;
+		controlHeader->cmsg_len = CMSG_LEN(length);
+		std::memcpy(CMSG_DATA(controlHeader), sockets, length);
+	}
+
+	ssize_t result;
+	do {
+		result = sendmsg(channel, &message, MSG_NOSIGNAL);
+	} while (result == -1 && errno == EINTR);
+	return result == static_cast<ssize_t>(sizeof(header));
+}
+
+void
+CloseSockets(Sockets &sockets) noexcept {
+	for (const auto &entry : sockets) {
+		for (int socket : entry.second) {
+			close(socket);
+		}
+	}
+	sockets.clear();
+}
+
+} // namespace
+
+bool
+AwaitReady(int channel, std::chrono::milliseconds timeout) noexcept {
+	const auto deadline = std::chrono::steady_clock::now() + timeout;
+
+	struct pollfd pollAction{ channel, POLLIN, 0 };
+	while (true) {
+		const auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+		const int result = poll(&pollAction, 1, static_cast<int>(std::max<std::chrono::milliseconds::rep>(remaining.count(), 0)));
+		if (result == 0) {
+			return false;
+		}
+		if (result == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return false;
+		}
+
+		// The successor closes the channel if it fails.
+		char ready;
+		return recv(channel, &ready, 1, 0) == 1;
+	}
+}
+
+int
+Launch(const char *binary, char *const arguments[], pid_t &process) noexcept {
+	int channels[2];
+	if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, channels) == -1) {
+		return -1;
+	}
+
+	// Only async-signal-safe functions can be called in the child of a
+	// multithreaded process, so the environment is prepared beforehand.
+	std::vector<std::string> variables;
+	std::vector<char *> environment;
+	try {
+		const std::string prefix = std::string(environmentVariable) + '=';
+		for (char **variable = environ; *variable != nullptr; variable++) {
+			if (std::string_view(*variable).substr(0, prefix.length()) != prefix) {
+				environment.push_back(*variable);
+			}
+		}
+
+		variables.push_back(prefix + std::to_string(channels[1]));
+		environment.push_back(variables.back().data());
+		environment.push_back(nullptr);
+	} catch (...) {
+		close(channels[0]);
+		close(channels[1]);
+		return -1;
+	}
+
+	process = fork();
+	if (process == 0) {
+		// The end of the successor is kept open across exec.
+		if (fcntl(channels[1], F_SETFD, 0) == -1) {
+			_exit(EXIT_FAILURE);
+		}
+
+		execve(binary, arguments, environment.data());
+		_exit(EXIT_FAILURE);
+	}
+
+	close(channels[1]);
+	if (process == -1) {
+		close(channels[0]);
+		return -1;
+	}
+
+	return channels[0];
+}
+
+bool
+ReceiveSockets(int channel, Sockets &sockets) noexcept {
+	while (true) {
+		Header header{};
+		struct iovec vector{ &header, sizeof(header) };
+		struct msghdr message{};
+		message.msg_iov = &vector;
+		message.msg_iovlen = 1;
+
+		Control control{};
+		message.msg_control = control.buffer;
+		message.msg_controllen = sizeof(control.buffer);
+
+		ssize_t result;
+		do {
+			result = recvmsg(channel, &message, MSG_CMSG_CLOEXEC);
+		} while (result == -1 && errno == EINTR);
+
+		if (result != static_cast<ssize_t>(sizeof(header)) || (message.msg_flags & MSG_CTRUNC) != 0 ||
+			header.count > MAGIC_HANDOFF_BATCH_SIZE) {
+			CloseSockets(sockets);
+			return false;
+		}
+
+		std::size_t received = 0;
+		for (auto *controlHeader = CMSG_FIRSTHDR(&message); controlHeader != nullptr;
+			 controlHeader = CMSG_NXTHDR(&message, controlHeader)) {
+			if (controlHeader->cmsg_level != SOL_SOCKET || controlHeader->cmsg_type != SCM_RIGHTS) {
+				continue;
+			}
+
+			const auto count = (controlHeader->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+			auto &portSockets = sockets[header.port];
+			for (std::size_t i = 0; i < count; i++) {
+				int socket;
+				std::memcpy(&socket, CMSG_DATA(controlHeader) + i * sizeof(int), sizeof(int));
+				portSockets.push_back(socket);
+			}
+			received += count;
+		}
+
+		if (received != header.count) {
+			CloseSockets(sockets);
+			return false;
+		}
+
+		if (header.port == 0 && header.count == 0) {
+			// Only ports that have sockets are in the map.
+			sockets.erase(0);
+			return true;
+		}
+	}
+}
+
+bool
+SendSockets(int channel, const Sockets &sockets) noexcept {
+	for (const auto &[port, portSockets] : sockets) {
+		for (std::size_t offset = 0; offset < portSockets.size(); offset += MAGIC_HANDOFF_BATCH_SIZE) {
+			const auto count = std::min<std::size_t>(portSockets.size() - offset, MAGIC_HANDOFF_BATCH_SIZE);
+			if (!SendBatch(channel, Header{ port, static_cast<std::uint16_t>(count) }, portSockets.data() + offset)) {
+				return false;
+			}
+		}
+	}
+
+	return SendBatch(channel, Header{ 0, 0 }, nullptr);
+}
+
+bool
+SignalReady(int channel) noexcept {
+	const char ready = 'R';
+	return send(channel, &ready, 1, MSG_NOSIGNAL) == 1;
+}
+
+} // namespace HTTP::Handoff
@@ -0,0 +1,69 @@
+#pragma once
+
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include <chrono>
+#include <map>
+#include <vector>
+
+#include <cstdint>
+#include <sys/types.h>
+
+// The handoff of the listening sockets during a binary upgrade. The running
+// process starts its successor (e.g. a new binary, or the same one with a new
+// configuration) with a UNIX socket, the channel, in the environment, and
+// passes the listening sockets of its servers over it. The successor listens
+// on them, so no connection is refused in the meantime, and it isn't bound to
+// the privileges of binding the ports. Once the servers of the successor have
+// started, the predecessor drains its own, see Server::SignalDrain.
+//
+// The processes share the sockets, so connections waiting to be accepted
+// aren't lost, whichever process accepts them.
+namespace HTTP::Handoff {
+
+// The listening sockets of the servers, by port.
+using Sockets = std::map<std::uint16_t, std::vector<int>>;
+
+// The environment variable with the file descriptor of the channel, in the
+// environment of the successor.
+inline constexpr const char *environmentVariable = "WS_HANDOFF_FD";
+
+// Starts [binary] with [arguments] and the environment of this process, with
+// the channel in environmentVariable. [process] is the process ID of the
+// successor.
+//
+// Returns the channel to the successor, or -1 on failure
+[[nodiscard]] int
+Launch(const char *binary, char *const arguments[], pid_t &process) noexcept;
+
+// Sends [sockets] to the other end of [channel].
+//
+// Returns success status
+[[nodiscard]] bool
+SendSockets(int channel, const Sockets &sockets) noexcept;
+
+// Receives the sockets sent by SendSockets from the other end of [channel].
+// On failure, the sockets that have been received are closed.
+//
+// Returns success status
+[[nodiscard]] bool
+ReceiveSockets(int channel, Sockets &sockets) noexcept;
+
+// Tells the predecessor that the servers have started, so it can drain.
+//
+// Returns success status
+[[nodiscard]] bool
+SignalReady(int channel) noexcept;
+
+// Waits until the successor signals that its servers have started, for at most
+// [timeout].
+//
+// Returns false if it hasn't, e.g. because it failed to start
+[[nodiscard]] bool
+AwaitReady(int channel, std::chrono::milliseconds timeout) noexcept;
+
+} // namespace HTTP::Handoff
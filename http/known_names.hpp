@@ -0,0 +1,202 @@
+#pragma once
+
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+/**
+ * The well-known header field-names and methods, interned as enum IDs. The
+ * names are looked up with a perfect hash table built at compile time, so
+ * resolving a name costs one hash and one comparison, and all later lookups
+ * compare integers.
+ */
+
+#include <array>
+#include <string_view>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "http/utils.hpp"
+
+namespace HTTP {
+
+// Keep in sync with 'headerNames' below.
+enum class HeaderID : std::uint8_t {
+	UNKNOWN,
+	ACCEPT,
+	ACCEPT_ENCODING,
+	ACCEPT_LANGUAGE,
+	AUTHORIZATION,
+	CACHE_CONTROL,
+	CONNECTION,
+	CONTENT_ENCODING,
+	CONTENT_LENGTH,
+	CONTENT_TYPE,
+	COOKIE,
+	DATE,
+	EXPECT,
+	FORWARDED,
+	HOST,
+	HTTP2_SETTINGS,
+	IF_MATCH,
+	IF_MODIFIED_SINCE,
+	IF_NONE_MATCH,
+	IF_RANGE,
+	IF_UNMODIFIED_SINCE,
+	KEEP_ALIVE,
+	ORIGIN,
+	PRAGMA,
+	RANGE,
+	REFERER,
+	TE,
+	TRAILER,
+	TRANSFER_ENCODING,
+	UPGRADE,
+	UPGRADE_INSECURE_REQUESTS,
+	USER_AGENT,
+	VIA,
+	X_FORWARDED_FOR,
+	X_FORWARDED_PROTO,
+	X_REAL_IP,
+};
+
+// Keep in sync with 'methodNames' below.
+enum class MethodID : std::uint8_t {
+	UNKNOWN,
+	CONNECT,
+	DELETE,
+	GET,
+	HEAD,
+	OPTIONS,
+	PATCH,
+	POST,
+	PUT,
+	TRACE,
+};
+
+namespace KnownNames {
+
+	// Indexed by HeaderID. The names are lowercase.
+	inline constexpr std::array<std::string_view, 36> headerNames{
+		"",
+		"accept",
+		"accept-encoding",
+		"accept-language",
+		"authorization",
+		"cache-control",
+		"connection",
+		"content-encoding",
+		"content-length",
+		"content-type",
+		"cookie",
+		"date",
+		"expect",
+		"forwarded",
+		"host",
+		"http2-settings",
+		"if-match",
+		"if-modified-since",
+		"if-none-match",
+		"if-range",
+		"if-unmodified-since",
+		"keep-alive",
+		"origin",
+		"pragma",
+		"range",
+		"referer",
+		"te",
+		"trailer",
+		"transfer-encoding",
+		"upgrade",
+		"upgrade-insecure-requests",
+		"user-agent",
+		"via",
+		"x-forwarded-for",
+		"x-forwarded-proto",
+		"x-real-ip",
+	};
+
+	// Indexed by MethodID.
+	inline constexpr std::array<std::string_view, 10> methodNames{
+		"", "CONNECT", "DELETE", "GET", "HEAD", "OPTIONS", "PATCH", "POST", "PUT", "TRACE"
+	};
+
+	// The hash tables map the hash of a name to its ID. The seeds are chosen
+	// so that no two names share an entry, which is verified below.
+	inline constexpr std::size_t headerTableBits = 6;
+	inline constexpr std::uint32_t headerTableSeed = 212751;
+	inline constexpr std::size_t methodTableBits = 4;
+	inline constexpr std::uint32_t methodTableSeed = 12;
+
+	// FNV-1a with a seed, folded to [bits] bits. Header field-names are
+	// case-insensitive, so letters are hashed as lowercase letters when
+	// [foldCase] is set.
+	[[nodiscard]] inline constexpr std::size_t
+	Hash(std::string_view name, std::uint32_t seed, std::size_t bits, bool foldCase) noexcept {
+		std::uint32_t hash = seed;
+		for (char character : name) {
+			const auto octet = static_cast<std::uint8_t>(character);
+			hash = (hash ^ (foldCase ? (octet | 0x20) : octet)) * 16777619u;
+		}
+		return hash >> (32 - bits);
+	}
+
+	template <std::size_t Bits, std::size_t Count>
+	struct Table {
+		std::array<std::uint8_t, std::size_t(1) << Bits> ids{};
+
+		// False if two names collided.
+		bool perfect{ true };
+	};
+
+	template <std::size_t Bits, std::size_t Count>
+	[[nodiscard]] inline constexpr Table<Bits, Count>
+	BuildTable(const std::array<std::string_view, Count> &names, std::uint32_t seed, bool foldCase) noexcept {
+		Table<Bits, Count> table{};
+		// Index 0 is UNKNOWN, which isn't stored.
+		for (std::size_t id = 1; id < Count; id++) {
+			auto &entry = table.ids[Hash(names[id], seed, Bits, foldCase)];
+			if (entry != 0) {
+				table.perfect = false;
+			}
+			entry = static_cast<std::uint8_t>(id);
+		}
+		return table;
+	}
+
+	inline constexpr auto headerTable = BuildTable<headerTableBits>(headerNames, headerTableSeed, true);
+	inline constexpr auto methodTable = BuildTable<methodTableBits>(methodNames, methodTableSeed, false);
+
+	static_assert(headerTable.perfect, "header names collide: pick another headerTableSeed");
+	static_assert(methodTable.perfect, "method names collide: pick another methodTableSeed");
+	static_assert(headerNames.back() == "x-real-ip", "headerNames isn't in sync with HeaderID");
+	static_assert(methodNames.back() == "TRACE", "methodNames isn't in sync with MethodID");
+
+} // namespace KnownNames
+
+// Header field-names are case-insensitive.
+[[nodiscard]] inline constexpr HeaderID
+LookupHeaderID(std::string_view name) noexcept {
+	using namespace KnownNames;
+	const auto id = headerTable.ids[Hash(name, headerTableSeed, headerTableBits, true)];
+	return Utils::EqualsIgnoreCase(headerNames[id], name) ? static_cast<HeaderID>(id) : HeaderID::UNKNOWN;
+}
+
+// Methods are case-sensitive.
+[[nodiscard]] inline constexpr MethodID
+LookupMethodID(std::string_view name) noexcept {
+	using namespace KnownNames;
+	const auto id = methodTable.ids[Hash(name, methodTableSeed, methodTableBits, false)];
+	return methodNames[id] == name ? static_cast<MethodID>(id) : MethodID::UNKNOWN;
+}
+
+static_assert(LookupHeaderID("Content-Length") == HeaderID::CONTENT_LENGTH);
+static_assert(LookupHeaderID("x-real-ip") == HeaderID::X_REAL_IP);
+static_assert(LookupHeaderID("hostname") == HeaderID::UNKNOWN);
+static_assert(LookupMethodID("HEAD") == MethodID::HEAD);
+static_assert(LookupMethodID("head") == MethodID::UNKNOWN);
+
+} // namespace HTTP
@@ -0,0 +1,318 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include "http/metrics.hpp"
+
+#include <algorithm>
+#include <array>
+#include <new>
+#include <string_view>
+#include <utility>
+
+#include <cstdio>
+
+#include "base/async_log.hpp"
+#include "http/admission_control.hpp"
+#include "http/configuration.hpp"
+#include "security/address_limiter.hpp"
+#include "security/tls_configuration.hpp"
+#include "security/tls_session_cache.hpp"
+
+namespace HTTP {
+
+struct MetricsShard {
+	using Counter = std::atomic<std::uint64_t>;
+
+	struct Histogram {
+		std::array<Counter, Metrics::bucketCount> buckets{};
+
+		// In nanoseconds.
+		Counter sum{ 0 };
+	};
+
+	std::array<Histogram, Metrics::stageCount> stages{};
+	std::array<Counter, clientErrorCount> errors{};
+
+	// The hits and misses.
+	std::array<Counter, 2> fileCacheLookups{};
+	std::array<Counter, 2> compressionCacheLookups{};
+
+	// Because of too many connections, and because of the rate.
+	std::array<Counter, 2> refusedConnections{};
+
+	// By ShedReason.
+	std::array<Counter, Metrics::shedReasonCount> shedConnections{};
+};
+
+namespace {
+
+// The names of the stages, in the order of the enumeration.
+constexpr std::array<std::string_view, Metrics::stageCount> stageNames{
+	"accept", "tls_handshake", "parse", "resolve", "metadata", "body"
+};
+
+static_assert(Metrics::shedReasonCount == static_cast<std::size_t>(ShedReason::LAG) + 1);
+
+// The names of the reasons, in the order of the enumeration.
+constexpr std::array<std::string_view, Metrics::shedReasonCount> shedReasonNames{
+	"connections", "descriptors", "lag"
+};
+
+// The shards of the calling thread, by the identifier of their metrics.
+thread_local std::vector<std::pair<std::uint64_t, std::shared_ptr<MetricsShard>>> threadShards;
+
+std::atomic<std::uint64_t> nextIdentifier{ 0 };
+
+// The counters of a shard are only written by its thread, so they don't need
+// an atomic read-modify-write, only an atomic store for the scraper.
+inline void
+Increment(MetricsShard::Counter &counter, std::uint64_t amount = 1) noexcept {
+	counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+[[nodiscard]] inline std::size_t
+BucketOf(std::uint64_t nanoseconds) noexcept {
+	const auto microseconds = (nanoseconds + 999) / 1000;
+	if (microseconds <= 1) {
+		return 0;
+	}
+
+	const auto bucket = static_cast<std::size_t>(64 - __builtin_clzll(microseconds - 1));
+	return std::min(bucket, Metrics::bucketCount - 1);
+}
+
+void
+AppendNumber(std::string &output, std::uint64_t number) {
+	std::array<char, 24> buffer;
+	const auto length = std::snprintf(buffer.data(), buffer.size(), "%llu", static_cast<unsigned long long>(number));
+	output.append(buffer.data(), static_cast<std::size_t>(length));
+}
+
+void
+AppendCounter(std::string &output, std::string_view name, std::string_view labels, std::uint64_t value) {
+	output.append(name);
+	if (!labels.empty()) {
+		output.append("{");
+		output.append(labels);
+		output.append("}");
+	}
+	output.append(" ");
+	AppendNumber(output, value);
+	output.append("\n");
+}
+
+void
+AppendHeader(std::string &output, std::string_view name, std::string_view type, std::string_view help) {
+	output.append("# HELP ");
+	output.append(name);
+	output.append(" ");
+	output.append(help);
+	output.append("\n# TYPE ");
+	output.append(name);
+	output.append(" ");
+	output.append(type);
+	output.append("\n");
+}
+
+} // namespace
+
+Metrics::Metrics() noexcept :
+	identifier(nextIdentifier.fetch_add(1, std::memory_order_relaxed)) {
+}
+
+MetricsShard *
+Metrics::ThreadShard() noexcept {
+	for (const auto &entry : threadShards) {
+		if (entry.first == identifier) {
+			return entry.second.get();
+		}
+	}
+
+	try {
+		auto shard = std::make_shared<MetricsShard>();
+		threadShards.emplace_back(identifier, shard);
+
+		std::lock_guard lock(shardsMutex);
+		shards.push_back(std::move(shard));
+		return shards.back().get();
+	} catch (const std::bad_alloc &) {
+		return nullptr;
+	}
+}
+
+void
+Metrics::Record(Stage stage, std::chrono::steady_clock::duration duration) noexcept {
+	auto *shard = ThreadShard();
+	if (shard == nullptr) {
+		return;
+	}
+
+	const auto nanoseconds = static_cast<std::uint64_t>(std::max<std::int64_t>(
+		std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count(), 0));
+	auto &histogram = shard->stages[static_cast<std::size_t>(stage)];
+	Increment(histogram.buckets[BucketOf(nanoseconds)]);
+	Increment(histogram.sum, nanoseconds);
+}
+
+void
+Metrics::Count(ClientError error) noexcept {
+	if (auto *shard = ThreadShard()) {
+		Increment(shard->errors[static_cast<std::size_t>(error)]);
+	}
+}
+
+void
+Metrics::CountFileCacheLookup(bool hit) noexcept {
+	if (auto *shard = ThreadShard()) {
+		Increment(shard->fileCacheLookups[hit ? 0 : 1]);
+	}
+}
+
+void
+Metrics::CountCompressionCacheLookup(bool hit) noexcept {
+	if (auto *shard = ThreadShard()) {
+		Increment(shard->compressionCacheLookups[hit ? 0 : 1]);
+	}
+}
+
+void
+Metrics::CountRefusedConnection(Security::AddressAdmission reason) noexcept {
+	if (auto *shard = ThreadShard()) {
+		Increment(shard->refusedConnections[reason == Security::AddressAdmission::RATE_LIMITED ? 1 : 0]);
+	}
+}
+
+void
+Metrics::CountShedConnection(ShedReason reason) noexcept {
+	if (auto *shard = ThreadShard()) {
+		Increment(shard->shedConnections[static_cast<std::size_t>(reason)]);
+	}
+}
+
+void
+Metrics::Render(std::string &output, const Configuration &configuration) const {
+	std::array<std::array<std::uint64_t, bucketCount>, stageCount> buckets{};
+	std::array<std::uint64_t, stageCount> sums{};
+	std::array<std::uint64_t, clientErrorCount> errors{};
+	std::array<std::uint64_t, 2> fileCacheLookups{};
+	std::array<std::uint64_t, 2> compressionCacheLookups{};
+	std::array<std::uint64_t, 2> refusedConnections{};
+	std::array<std::uint64_t, shedReasonCount> shedConnections{};
+
+	{
+		std::lock_guard lock(shardsMutex);
+		for (const auto &shard : shards) {
+			for (std::size_t stage = 0; stage < stageCount; stage++) {
+				for (std::size_t bucket = 0; bucket < bucketCount; bucket++) {
+					buckets[stage][bucket] += shard->stages[stage].buckets[bucket].load(std::memory_order_relaxed);
+				}
+				sums[stage] += shard->stages[stage].sum.load(std::memory_order_relaxed);
+			}
+			for (std::size_t error = 0; error < clientErrorCount; error++) {
+				errors[error] += shard->errors[error].load(std::memory_order_relaxed);
+			}
+			for (std::size_t result = 0; result < 2; result++) {
+				fileCacheLookups[result] += shard->fileCacheLookups[result].load(std::memory_order_relaxed);
+				compressionCacheLookups[result] += shard->compressionCacheLookups[result].load(std::memory_order_relaxed);
+				refusedConnections[result] += shard->refusedConnections[result].load(std::memory_order_relaxed);
+			}
+			for (std::size_t reason = 0; reason < shedReasonCount; reason++) {
+				shedConnections[reason] += shard->shedConnections[reason].load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	std::array<char, 64> buffer;
+	AppendHeader(output, "webserver_stage_duration_seconds", "histogram",
+				 "The duration of the stages of connections and exchanges.");
+	for (std::size_t stage = 0; stage < stageCount; stage++) {
+		std::uint64_t count = 0;
+		for (std::size_t bucket = 0; bucket < bucketCount; bucket++) {
+			count += buckets[stage][bucket];
+			output.append("webserver_stage_duration_seconds_bucket{stage=\"");
+			output.append(stageNames[stage]);
+			if (bucket == bucketCount - 1) {
+				output.append("\",le=\"+Inf\"} ");
+			} else {
+				const auto length = std::snprintf(buffer.data(), buffer.size(), "\",le=\"%g\"} ",
+												  static_cast<double>(std::uint64_t(1) << bucket) / 1e6);
+				output.append(buffer.data(), static_cast<std::size_t>(length));
+			}
+			AppendNumber(output, count);
+			output.append("\n");
+		}
+
+		output.append("webserver_stage_duration_seconds_sum{stage=\"");
+		output.append(stageNames[stage]);
+		const auto length = std::snprintf(buffer.data(), buffer.size(), "\"} %.9f\n",
+										  static_cast<double>(sums[stage]) / 1e9);
+		output.append(buffer.data(), static_cast<std::size_t>(length));
+
+		output.append("webserver_stage_duration_seconds_count{stage=\"");
+		output.append(stageNames[stage]);
+		output.append("\"} ");
+		AppendNumber(output, count);
+		output.append("\n");
+	}
+
+	AppendHeader(output, "webserver_client_errors_total", "counter",
+				 "The errors of clients, by the error that occurred.");
+	for (std::size_t error = 0; error < clientErrorCount; error++) {
+		const auto value = static_cast<ClientError>(error);
+		if (value == ClientError::NO_ERROR) {
+			continue;
+		}
+		AppendCounter(output, "webserver_client_errors_total",
+					  std::string("error=\"") + ClientErrorToString(value) + "\"", errors[error]);
+	}
+
+	AppendHeader(output, "webserver_file_cache_lookups_total", "counter",
+				 "The lookups of files in the file cache.");
+	AppendCounter(output, "webserver_file_cache_lookups_total", "result=\"hit\"", fileCacheLookups[0]);
+	AppendCounter(output, "webserver_file_cache_lookups_total", "result=\"miss\"", fileCacheLookups[1]);
+
+	AppendHeader(output, "webserver_compression_cache_lookups_total", "counter",
+				 "The lookups of compressed files in the compression cache.");
+	AppendCounter(output, "webserver_compression_cache_lookups_total", "result=\"hit\"", compressionCacheLookups[0]);
+	AppendCounter(output, "webserver_compression_cache_lookups_total", "result=\"miss\"", compressionCacheLookups[1]);
+
+	AppendHeader(output, "webserver_connections_refused_total", "counter",
+				 "The connections refused by the limits per address.");
+	AppendCounter(output, "webserver_connections_refused_total", "reason=\"connections\"", refusedConnections[0]);
+	AppendCounter(output, "webserver_connections_refused_total", "reason=\"rate\"", refusedConnections[1]);
+
+	AppendHeader(output, "webserver_connections_shed_total", "counter",
+				 "The connections shed because the server was overloaded.");
+	for (std::size_t reason = 0; reason < shedReasonCount; reason++) {
+		AppendCounter(output, "webserver_connections_shed_total",
+					  std::string("reason=\"") + std::string(shedReasonNames[reason]) + "\"", shedConnections[reason]);
+	}
+
+	if (const auto &sessionCache = configuration.tlsConfiguration.sessionCache) {
+		const auto statistics = sessionCache->Statistics();
+		AppendHeader(output, "webserver_tls_handshakes_total", "counter",
+					 "The completed TLS handshakes, by whether they resumed a session.");
+		AppendCounter(output, "webserver_tls_handshakes_total", "kind=\"full\"", statistics.fullHandshakes);
+		AppendCounter(output, "webserver_tls_handshakes_total", "kind=\"resumed\"", statistics.resumedHandshakes);
+
+		AppendHeader(output, "webserver_tls_session_cache_lookups_total", "counter",
+					 "The lookups of session IDs in the TLS session cache.");
+		AppendCounter(output, "webserver_tls_session_cache_lookups_total", "result=\"hit\"", statistics.cacheHits);
+		AppendCounter(output, "webserver_tls_session_cache_lookups_total", "result=\"miss\"", statistics.cacheMisses);
+
+		AppendHeader(output, "webserver_tls_tickets_rejected_total", "counter",
+					 "The session tickets that couldn't be decrypted.");
+		AppendCounter(output, "webserver_tls_tickets_rejected_total", {}, statistics.ticketsRejected);
+	}
+
+	if (configuration.accessLog != nullptr) {
+		AppendHeader(output, "webserver_access_log_dropped_total", "counter",
+					 "The records of the access log that have been dropped.");
+		AppendCounter(output, "webserver_access_log_dropped_total", {}, configuration.accessLog->Dropped());
+	}
+}
+
+} // namespace HTTP
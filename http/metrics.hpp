@@ -0,0 +1,124 @@
+#pragma once
+
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "http/client_error.hpp"
+
+// Forward-decl from security/address_limiter.hpp
+namespace Security {
+	enum class AddressAdmission;
+} // namespace Security
+
+namespace HTTP {
+
+// From http/admission_control.hpp:
+enum class ShedReason;
+
+// From http/configuration.hpp:
+struct Configuration;
+
+// The counters of a thread, see metrics.cpp.
+struct MetricsShard;
+
+// The stages of a connection and of the exchanges on it, which have a latency
+// histogram each.
+enum class Stage {
+	// From accept(2) until the client is registered.
+	ACCEPT,
+
+	// From the registration of the client until the handshake is complete.
+	// Only recorded for connections with TLS.
+	TLS_HANDSHAKE,
+
+	// From the first octets of the request head until the request is
+	// parsed and validated.
+	PARSE,
+
+	// The lookup of the file in the file cache, or in the file system.
+	RESOLVE,
+
+	// Evaluating the conditionals and ranges, and serializing the metadata.
+	METADATA,
+
+	// Sending the response, i.e. the metadata and the body, which are
+	// written together.
+	BODY,
+};
+
+// The instrumentation of a server. Every thread that records has counters of
+// its own, which are only written by that thread, so recording doesn't
+// contend with other threads: the counters are only summed when they're
+// scraped. Metrics can be shared by servers, like the caches.
+class Metrics {
+public:
+	static constexpr std::size_t stageCount = static_cast<std::size_t>(Stage::BODY) + 1;
+	static constexpr std::size_t shedReasonCount = 3;
+
+	// The upper bounds of the buckets are 1 µs, 2 µs, 4 µs, ..., 2^23 µs
+	// (about 8 seconds), and one for the longer durations.
+	static constexpr std::size_t bucketCount = 25;
+
+	Metrics() noexcept;
+
+	Metrics(const Metrics &) = delete;
+	Metrics &operator=(const Metrics &) = delete;
+
+	void
+	Record(Stage, std::chrono::steady_clock::duration) noexcept;
+
+	// Counts an error of a client, see Client::RecoverError.
+	void
+	Count(ClientError) noexcept;
+
+	void
+	CountFileCacheLookup(bool hit) noexcept;
+
+	void
+	CountCompressionCacheLookup(bool hit) noexcept;
+
+	// Counts a connection that was refused by the address limiter, see
+	// Server::AdmitConnection.
+	void
+	CountRefusedConnection(Security::AddressAdmission reason) noexcept;
+
+	// Counts a connection that was shed by an AdmissionController.
+	void
+	CountShedConnection(ShedReason reason) noexcept;
+
+	// Appends the metrics, and those of the caches and logs of
+	// [configuration], in the Prometheus text exposition format.
+	// Read more at https://prometheus.io/docs/instrumenting/exposition_formats/
+	void
+	Render(std::string &output, const Configuration &configuration) const;
+
+private:
+	// Distinguishes the metrics from the ones before it at the same address,
+	// in the list of shards of a thread.
+	const std::uint64_t identifier;
+
+	// The shards are kept after their thread has exited, so the totals
+	// don't decrease.
+	mutable std::mutex shardsMutex;
+	std::vector<std::shared_ptr<MetricsShard>> shards;
+
+	// Returns the shard of the calling thread, or nullptr if it couldn't be
+	// created.
+	[[nodiscard]] MetricsShard *
+	ThreadShard() noexcept;
+};
+
+} // namespace HTTP
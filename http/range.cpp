@@ -0,0 +1,85 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include "http/range.hpp"
+
+#include <charconv>
+#include <system_error>
+
+#include "http/utils.hpp"
+
+namespace HTTP {
+
+// Parses the digits at the start of [value], removing them. Values that don't
+// fit are saturated, since they are past the end of any representation.
+static bool
+ParsePosition(std::string_view &value, std::size_t &position) noexcept {
+	const auto result = std::from_chars(value.data(), value.data() + value.length(), position);
+	if (result.ptr == value.data()) {
+		return false;
+	}
+
+	if (result.ec == std::errc::result_out_of_range) {
+		position = static_cast<std::size_t>(-1);
+	}
+
+	value.remove_prefix(result.ptr - value.data());
+	return true;
+}
+
+RangeStatus
+ParseRange(std::string_view value, std::size_t size, ByteRange &range) noexcept {
+	constexpr std::string_view unit("bytes=");
+	if (value.length() < unit.length() || !Utils::EqualsIgnoreCase(value.substr(0, unit.length()), unit)) {
+		return RangeStatus::IGNORED;
+	}
+	value.remove_prefix(unit.length());
+
+	// suffix-byte-range-spec = "-" suffix-length
+	if (!value.empty() && value.front() == '-') {
+		value.remove_prefix(1);
+
+		std::size_t suffixLength;
+		if (!ParsePosition(value, suffixLength) || !value.empty()) {
+			return RangeStatus::IGNORED;
+		}
+
+		if (suffixLength == 0 || size == 0) {
+			return RangeStatus::UNSATISFIABLE;
+		}
+
+		range.first = suffixLength < size ? size - suffixLength : 0;
+		range.last = size - 1;
+		return RangeStatus::SATISFIABLE;
+	}
+
+	// byte-range-spec = first-byte-pos "-" [ last-byte-pos ]
+	std::size_t first;
+	if (!ParsePosition(value, first) || value.empty() || value.front() != '-') {
+		return RangeStatus::IGNORED;
+	}
+	value.remove_prefix(1);
+
+	std::size_t last = static_cast<std::size_t>(-1);
+	if (!value.empty() && !ParsePosition(value, last)) {
+		return RangeStatus::IGNORED;
+	}
+
+	// Anything else might be another range, e.g. a comma.
+	if (!value.empty() || last < first) {
+		return RangeStatus::IGNORED;
+	}
+
+	if (first >= size) {
+		return RangeStatus::UNSATISFIABLE;
+	}
+
+	range.first = first;
+	range.last = last < size ? last : size - 1;
+	return RangeStatus::SATISFIABLE;
+}
+
+} // namespace HTTP
@@ -0,0 +1,48 @@
+#pragma once
+
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include <string_view>
+
+#include <cstddef>
+
+namespace HTTP {
+
+// The octets 'first' up to and including 'last' of a representation.
+struct ByteRange {
+	std::size_t first;
+	std::size_t last;
+
+	[[nodiscard]] inline constexpr std::size_t
+	Length() const noexcept {
+		return last - first + 1;
+	}
+};
+
+enum class RangeStatus {
+	// The Range header field should be ignored, and the full representation
+	// sent: it is malformed, of another unit than bytes, or specifies
+	// multiple ranges, which aren't supported.
+	IGNORED,
+
+	// The range has been stored, and a 206 (Partial Content) should be sent.
+	SATISFIABLE,
+
+	// The range starts past the end of the representation, and a 416 (Range
+	// Not Satisfiable) should be sent.
+	UNSATISFIABLE,
+};
+
+// Parses the value of a Range header field for a representation of [size]
+// octets. The last position of [range] is clamped to the end of the
+// representation.
+//
+// Spec: RFC 7233 § 2.1
+[[nodiscard]] RangeStatus
+ParseRange(std::string_view value, std::size_t size, ByteRange &range) noexcept;
+
+} // namespace HTTP
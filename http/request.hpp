@@ -6,31 +6,173 @@
  * See the COPYING file for licensing information.
  */
 
-#include <map>
-#include <string>
-#include <vector>
+#include <array>
+#include <functional>
+#include <string_view>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "http/known_names.hpp"
+#include "http/utils.hpp"
 
 namespace HTTP {
 
+struct Header {
+	std::string_view name;
+	std::string_view value;
+
+	// Resolved by HeaderList::Add.
+	HeaderID id{ HeaderID::UNKNOWN };
+};
+
+// The header fields of a request, stored inline, so no allocations are made.
+// The well-known fields are indexed by their HeaderID.
+class HeaderList {
+public:
+	static constexpr std::size_t capacity = 64;
+
+	// Returns false if the list is full.
+	[[nodiscard]] inline bool
+	Add(const Header &header) noexcept {
+		if (count == capacity) {
+			return false;
+		}
+
+		auto &stored = headers[count++];
+		stored = header;
+		stored.id = LookupHeaderID(header.name);
+
+		const auto index = static_cast<std::size_t>(stored.id);
+		if (stored.id != HeaderID::UNKNOWN && occurrences[index]++ == 0) {
+			firsts[index] = static_cast<std::uint8_t>(count - 1);
+		}
+		return true;
+	}
+
+	[[nodiscard]] inline const Header *
+	begin() const noexcept {
+		return headers.data();
+	}
+
+	inline void
+	Clear() noexcept {
+		count = 0;
+		occurrences.fill(0);
+	}
+
+	// The number of fields with the given ID.
+	[[nodiscard]] inline std::size_t
+	Count(HeaderID id) const noexcept {
+		return occurrences[static_cast<std::size_t>(id)];
+	}
+
+	[[nodiscard]] inline const Header *
+	end() const noexcept {
+		return headers.data() + count;
+	}
+
+	// Returns the first header with the given ID, or nullptr if there is no
+	// such header. Returns nullptr for UNKNOWN.
+	[[nodiscard]] inline const Header *
+	Find(HeaderID id) const noexcept {
+		const auto index = static_cast<std::size_t>(id);
+		return occurrences[index] == 0 ? nullptr : &headers[firsts[index]];
+	}
+
+	// Returns the first header named [name], compared case-insensitively, or
+	// nullptr if there is no such header.
+	[[nodiscard]] inline const Header *
+	Find(std::string_view name) const noexcept {
+		if (const auto id = LookupHeaderID(name); id != HeaderID::UNKNOWN) {
+			return Find(id);
+		}
+
+		for (const auto &header : *this) {
+			if (Utils::EqualsIgnoreCase(header.name, name)) {
+				return &header;
+			}
+		}
+
+		return nullptr;
+	}
+
+	[[nodiscard]] inline std::size_t
+	size() const noexcept {
+		return count;
+	}
+
+	// Calls [function] with the name and the value of every field, which it
+	// may change, see Request::Relocate.
+	template <typename Function>
+	inline void
+	TransformViews(Function function) noexcept {
+		for (std::size_t i = 0; i < count; i++) {
+			function(headers[i].name);
+			function(headers[i].value);
+		}
+	}
+
+private:
+	std::array<Header, capacity> headers;
+	std::size_t count{ 0 };
+
+	// Indexed by HeaderID: the amount of fields and the index of the first.
+	std::array<std::uint8_t, KnownNames::headerNames.size()> occurrences{};
+	std::array<std::uint8_t, KnownNames::headerNames.size()> firsts{};
+};
+
+// The views of a request refer to the storage of the parser, i.e. the receive
+// buffer of the connection. They are valid until the request is reset.
 struct Request {
-	std::vector<char> method;
+	std::string_view method;
+	MethodID methodID{ MethodID::UNKNOWN };
 
-	std::string path;
-	std::string query;
+	std::string_view path;
+	std::string_view query;
 
-	std::uint8_t versionMinor;
+	std::uint8_t versionMinor{ 1 };
 
 	// Version isn't worth/needed storing atm.
 
-	std::multimap<std::string, std::string> headers;
+	HeaderList headers;
 
 	// Is method head
 	[[nodiscard]] inline bool
-	IsHead() {
-		const char head[] = "HEAD";
-		return std::mismatch(std::begin(method), std::end(method),
-							 std::begin(head), std::begin(head) + 4)
-				.first == std::end(method);
+	IsHead() const noexcept {
+		return methodID == MethodID::HEAD;
+	}
+
+	inline void
+	SetMethod(std::string_view name) noexcept {
+		method = name;
+		methodID = LookupMethodID(name);
+	}
+
+	// Makes the views that refer to the [length] octets at [from] refer to
+	// the same octets at [to] instead, e.g. after the head of the request has
+	// been copied out of the receive buffer.
+	inline void
+	Relocate(const char *from, std::size_t length, const char *to) noexcept {
+		const auto relocate = [from, length, to](std::string_view &view) {
+			if (std::greater_equal<>{}(view.data(), from) && std::less<>{}(view.data(), from + length)) {
+				view = std::string_view(to + (view.data() - from), view.length());
+			}
+		};
+
+		relocate(method);
+		relocate(path);
+		relocate(query);
+		headers.TransformViews(relocate);
+	}
+
+	inline void
+	Reset() noexcept {
+		method = {};
+		methodID = MethodID::UNKNOWN;
+		path = {};
+		query = {};
+		headers.Clear();
 	}
 };
 
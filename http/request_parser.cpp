@@ -0,0 +1,604 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include "http/request_parser.hpp"
+
+#include <algorithm>
+#include <array>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "http/utils.hpp"
+#include "security/policies.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+//                                SIMD Scanning                              //
+///////////////////////////////////////////////////////////////////////////////
+// A run of octets is scanned a vector at a time. The character class is
+// computed for the whole vector, which yields a mask of the octets outside of
+// the class. The first of these is the end of the run, which is either the
+// delimiter (SP, CR, ':') or an invalid character.
+//
+// The comparisons are signed, so octets >= 0x80 compare as negative.
+namespace {
+
+#if defined(__AVX2__)
+#define MAGIC_SIMD_WIDTH 32
+using Vector = __m256i;
+
+[[nodiscard]] inline Vector
+Load(const char *data) noexcept {
+	return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data));
+}
+
+[[nodiscard]] inline Vector
+Equal(Vector vector, char character) noexcept {
+	return _mm256_cmpeq_epi8(vector, _mm256_set1_epi8(character));
+}
+
+[[nodiscard]] inline Vector
+Greater(Vector vector, char character) noexcept {
+	return _mm256_cmpgt_epi8(vector, _mm256_set1_epi8(character));
+}
+
+[[nodiscard]] inline Vector
+Less(Vector vector, char character) noexcept {
+	return _mm256_cmpgt_epi8(_mm256_set1_epi8(character), vector);
+}
+
+[[nodiscard]] inline Vector
+And(Vector a, Vector b) noexcept {
+	return _mm256_and_si256(a, b);
+}
+
+[[nodiscard]] inline Vector
+Or(Vector a, Vector b) noexcept {
+	return _mm256_or_si256(a, b);
+}
+
+// a & ~b
+[[nodiscard]] inline Vector
+AndNot(Vector a, Vector b) noexcept {
+	return _mm256_andnot_si256(b, a);
+}
+
+[[nodiscard]] inline std::uint64_t
+Mismatches(Vector inClass) noexcept {
+	return ~static_cast<std::uint32_t>(_mm256_movemask_epi8(inClass));
+}
+
+[[nodiscard]] inline std::size_t
+FirstMismatch(std::uint64_t mismatches) noexcept {
+	return static_cast<std::size_t>(__builtin_ctzll(mismatches));
+}
+#elif defined(__SSE2__)
+#define MAGIC_SIMD_WIDTH 16
+using Vector = __m128i;
+
+[[nodiscard]] inline Vector
+Load(const char *data) noexcept {
+	return _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+}
+
+[[nodiscard]] inline Vector
+Equal(Vector vector, char character) noexcept {
+	return _mm_cmpeq_epi8(vector, _mm_set1_epi8(character));
+}
+
+[[nodiscard]] inline Vector
+Greater(Vector vector, char character) noexcept {
+	return _mm_cmpgt_epi8(vector, _mm_set1_epi8(character));
+}
+
+[[nodiscard]] inline Vector
+Less(Vector vector, char character) noexcept {
+	return _mm_cmplt_epi8(vector, _mm_set1_epi8(character));
+}
+
+[[nodiscard]] inline Vector
+And(Vector a, Vector b) noexcept {
+	return _mm_and_si128(a, b);
+}
+
+[[nodiscard]] inline Vector
+Or(Vector a, Vector b) noexcept {
+	return _mm_or_si128(a, b);
+}
+
+// a & ~b
+[[nodiscard]] inline Vector
+AndNot(Vector a, Vector b) noexcept {
+	return _mm_andnot_si128(b, a);
+}
+
+[[nodiscard]] inline std::uint64_t
+Mismatches(Vector inClass) noexcept {
+	return ~static_cast<std::uint32_t>(_mm_movemask_epi8(inClass)) & 0xFFFFU;
+}
+
+[[nodiscard]] inline std::size_t
+FirstMismatch(std::uint64_t mismatches) noexcept {
+	return static_cast<std::size_t>(__builtin_ctzll(mismatches));
+}
+#elif defined(__ARM_NEON)
+#define MAGIC_SIMD_WIDTH 16
+using Vector = int8x16_t;
+
+[[nodiscard]] inline Vector
+Load(const char *data) noexcept {
+	return vld1q_s8(reinterpret_cast<const int8_t *>(data));
+}
+
+[[nodiscard]] inline Vector
+Equal(Vector vector, char character) noexcept {
+	return vreinterpretq_s8_u8(vceqq_s8(vector, vdupq_n_s8(static_cast<int8_t>(character))));
+}
+
+[[nodiscard]] inline Vector
+Greater(Vector vector, char character) noexcept {
+	return vreinterpretq_s8_u8(vcgtq_s8(vector, vdupq_n_s8(static_cast<int8_t>(character))));
+}
+
+[[nodiscard]] inline Vector
+Less(Vector vector, char character) noexcept {
+	return vreinterpretq_s8_u8(vcltq_s8(vector, vdupq_n_s8(static_cast<int8_t>(character))));
+}
+
+[[nodiscard]] inline Vector
+And(Vector a, Vector b) noexcept {
+	return vandq_s8(a, b);
+}
+
+[[nodiscard]] inline Vector
+Or(Vector a, Vector b) noexcept {
+	return vorrq_s8(a, b);
+}
+
+// a & ~b
+[[nodiscard]] inline Vector
+AndNot(Vector a, Vector b) noexcept {
+	return vbicq_s8(a, b);
+}
+
+// NEON has no movemask, so the mask is narrowed to a nibble per octet.
+[[nodiscard]] inline std::uint64_t
+Mismatches(Vector inClass) noexcept {
+	const uint8x16_t outOfClass = vmvnq_u8(vreinterpretq_u8_s8(inClass));
+	const uint8x8_t narrowed = vshrn_n_u16(vreinterpretq_u16_u8(outOfClass), 4);
+	return vget_lane_u64(vreinterpret_u64_u8(narrowed), 0);
+}
+
+[[nodiscard]] inline std::size_t
+FirstMismatch(std::uint64_t mismatches) noexcept {
+	return static_cast<std::size_t>(__builtin_ctzll(mismatches)) / 4;
+}
+#endif
+
+// The character classes of the runs. 'Scalar' is used for the octets at the
+// end of the input that don't fill a vector.
+struct PathClass {
+	// The request-target without SP, since SP ends it.
+	[[nodiscard]] static inline bool
+	Scalar(char character) noexcept {
+		return character != ' ' && HTTP::Utils::IsPathCharacter(character);
+	}
+
+#ifdef MAGIC_SIMD_WIDTH
+	[[nodiscard]] static inline Vector
+	InClass(Vector vector) noexcept {
+		return And(Greater(vector, 0x20), Less(vector, 0x7F));
+	}
+#endif
+};
+
+struct TokenClass {
+	[[nodiscard]] static inline bool
+	Scalar(char character) noexcept {
+		return HTTP::Utils::IsTokenCharacter(character);
+	}
+
+#ifdef MAGIC_SIMD_WIDTH
+	[[nodiscard]] static inline Vector
+	InClass(Vector vector) noexcept {
+		const Vector visible = And(Greater(vector, 0x20), Less(vector, 0x7F));
+
+		// ':' through '@'
+		Vector delimiters = And(Greater(vector, '9'), Less(vector, 'A'));
+		for (char delimiter : { '"', '(', ')', ',', '/', '[', '\\', ']', '{', '}' }) {
+			delimiters = Or(delimiters, Equal(vector, delimiter));
+		}
+
+		return AndNot(visible, delimiters);
+	}
+#endif
+};
+
+struct FieldValueClass {
+	// VCHAR, obs-text, SP and HTAB. CR ends the value.
+	[[nodiscard]] static inline bool
+	Scalar(char character) noexcept {
+		return HTTP::Utils::IsFieldValueCharacter(character);
+	}
+
+#ifdef MAGIC_SIMD_WIDTH
+	[[nodiscard]] static inline Vector
+	InClass(Vector vector) noexcept {
+		const Vector printable = AndNot(Greater(vector, 0x1F), Equal(vector, 0x7F));
+		return Or(Or(printable, Less(vector, 0)), Equal(vector, '\t'));
+	}
+#endif
+};
+
+} // namespace
+
+// Returns the length of the run of octets in [Class] at the start of [data].
+template <typename Class>
+[[nodiscard]] static std::size_t
+ScanRun(const char *data, std::size_t length) noexcept {
+	std::size_t i = 0;
+
+#ifdef MAGIC_SIMD_WIDTH
+	for (; i + MAGIC_SIMD_WIDTH <= length; i += MAGIC_SIMD_WIDTH) {
+		const auto mismatches = Mismatches(Class::InClass(Load(data + i)));
+		if (mismatches != 0) {
+			return i + FirstMismatch(mismatches);
+		}
+	}
+#endif
+
+	while (i < length && Class::Scalar(data[i])) {
+		i++;
+	}
+
+	return i;
+}
+
+// Limits the run of [length] octets, appended to a part of [size] octets, by
+// [max] the same way the consumers of HTTP::Client do: the policy is violated
+// when the part reaches exactly [max] octets after an append.
+//
+// Returns true if the policy was violated, in which case [length] is reduced
+// to the octets consumed.
+[[nodiscard]] static bool
+LimitRun(std::size_t size, std::size_t &length, std::size_t max) noexcept {
+	if (max != 0 && size < max && length >= max - size) {
+		length = max - size;
+		return true;
+	}
+
+	return false;
+}
+
+namespace HTTP {
+
+RequestParser::RequestParser(const Security::Policies &policies, Request &request, std::size_t maxHeadLength) noexcept
+	: policies(policies), request(request), maxHeadLength(maxHeadLength) {
+}
+
+bool
+RequestParser::CommitHeaderField(const char *data) noexcept {
+	const auto maxCount = policies.maxHeaderCount;
+	if (fieldCount == fields.size() || (maxCount != 0 && fieldCount == maxCount)) {
+		return false;
+	}
+
+	while (fieldValue.length != 0 &&
+		   (data[fieldValue.begin + fieldValue.length - 1] == ' ' ||
+			data[fieldValue.begin + fieldValue.length - 1] == '\t')) {
+		fieldValue.length--;
+	}
+
+	fields[fieldCount++] = { fieldName, fieldValue };
+	return true;
+}
+
+void
+RequestParser::Complete(const char *data) noexcept {
+	request.SetMethod({ data + method.begin, method.length });
+	request.path = { data + path.begin, path.length };
+
+	request.headers.Clear();
+	for (std::size_t i = 0; i < fieldCount; i++) {
+		const auto &field = fields[i];
+		// Can't fail: there are at most HeaderList::capacity fields.
+		static_cast<void>(request.headers.Add({
+			{ data + field.name.begin, field.name.length },
+			{ data + field.value.begin, field.value.length }
+		}));
+	}
+
+	status = Status::COMPLETE;
+}
+
+ClientError
+RequestParser::EndOfStream() noexcept {
+	if (status != Status::INCOMPLETE) {
+		return error;
+	}
+
+	switch (state) {
+		case State::METHOD:
+			error = ClientError::FAILED_READ_METHOD;
+			break;
+		case State::PATH:
+			error = ClientError::FAILED_READ_PATH;
+			break;
+		case State::VERSION:
+			error = ClientError::FAILED_READ_VERSION;
+			break;
+		case State::REQUEST_LINE_CR:
+		case State::REQUEST_LINE_LF:
+			error = ClientError::FAILED_READ_CRLF;
+			break;
+		case State::HEADER_START:
+		case State::FIELD_NAME:
+			error = ClientError::FAILED_READ_HEADER_FIELD_NAME;
+			break;
+		case State::HEADERS_END_LF:
+		case State::FIELD_VALUE_LF:
+			error = ClientError::FAILED_READ_HEADER_NEWLINE;
+			break;
+		case State::FIELD_OWS:
+			error = ClientError::FAILED_READ_HEADER_FIELD_GENERIC;
+			break;
+		case State::FIELD_VALUE:
+			error = ClientError::FAILED_READ_HEADER_FIELD_VALUE;
+			break;
+	}
+
+	status = Status::FAILED;
+	return error;
+}
+
+RequestParser::Status
+RequestParser::Feed(const base::String &head) noexcept {
+	const char *data = head.data();
+	const std::size_t length = std::min(head.length(), maxHeadLength);
+
+	while (position < length && status == Status::INCOMPLETE) {
+		switch (state) {
+			case State::METHOD:
+				position = ParseMethod(data, length, position);
+				break;
+			case State::PATH:
+				position = ParsePath(data, length, position);
+				break;
+			case State::FIELD_NAME:
+				position = ParseFieldName(data, length, position);
+				break;
+			case State::FIELD_OWS:
+				position = ParseFieldOWS(data, length, position);
+				break;
+			case State::FIELD_VALUE:
+				position = ParseFieldValue(data, length, position);
+				break;
+			default:
+				position = ParseOctet(data, position);
+				break;
+		}
+	}
+
+	if (status == Status::INCOMPLETE && position == maxHeadLength) {
+		position = Fail(ClientError::REQUEST_HEAD_TOO_LARGE, position);
+	}
+
+	return status;
+}
+
+std::size_t
+RequestParser::ParseFieldName(const char *data, std::size_t length, std::size_t offset) noexcept {
+	std::size_t run = ScanRun<TokenClass>(data + offset, length - offset);
+
+	const bool violated = LimitRun(fieldName.length, run, policies.maxHeaderFieldNameLength);
+	fieldName.length += run;
+
+	offset += run;
+	if (violated) {
+		return Fail(ClientError::POLICY_TOO_LONG_HEADER_FIELD_NAME, offset);
+	}
+
+	if (offset == length) {
+		return offset;
+	}
+
+	if (data[offset] != ':') {
+		return Fail(ClientError::INCORRECT_HEADER_FIELD_NAME, offset + 1);
+	}
+
+	state = State::FIELD_OWS;
+	owsCount = 0;
+	return offset + 1;
+}
+
+std::size_t
+RequestParser::ParseFieldOWS(const char *data, std::size_t length, std::size_t offset) noexcept {
+	const auto maxOWS = policies.maxWhiteSpacesInHeaderField;
+
+	for (; offset < length; offset++) {
+		const char character = data[offset];
+
+		// The first character of the value isn't validated by
+		// ConsumeHeaderField either.
+		if (character != ' ' && character != '\t') {
+			fieldValue = { offset, 1 };
+			state = State::FIELD_VALUE;
+			return offset + 1;
+		}
+
+		if (maxOWS != 0 && ++owsCount > maxOWS) {
+			return Fail(ClientError::POLICY_TOO_MANY_OWS, offset + 1);
+		}
+	}
+
+	return offset;
+}
+
+std::size_t
+RequestParser::ParseFieldValue(const char *data, std::size_t length, std::size_t offset) noexcept {
+	std::size_t run = ScanRun<FieldValueClass>(data + offset, length - offset);
+
+	const bool violated = LimitRun(fieldValue.length, run, policies.maxHeaderFieldValueLength);
+	fieldValue.length += run;
+
+	offset += run;
+	if (violated) {
+		return Fail(ClientError::POLICY_TOO_LONG_HEADER_FIELD_VALUE, offset);
+	}
+
+	if (offset == length) {
+		return offset;
+	}
+
+	if (data[offset] != '\r') {
+		return Fail(ClientError::INCORRECT_HEADER_FIELD_VALUE, offset + 1);
+	}
+
+	state = State::FIELD_VALUE_LF;
+	return offset + 1;
+}
+
+std::size_t
+RequestParser::ParseMethod(const char *data, std::size_t length, std::size_t offset) noexcept {
+	std::size_t run = ScanRun<TokenClass>(data + offset, length - offset);
+
+	const bool violated = LimitRun(method.length, run, policies.maxMethodLength);
+	method.length += run;
+
+	offset += run;
+	if (violated) {
+		return Fail(ClientError::POLICY_TOO_LONG_METHOD, offset);
+	}
+
+	if (offset == length) {
+		return offset;
+	}
+
+	if (data[offset] != ' ') {
+		return Fail(ClientError::INCORRECT_METHOD, offset + 1);
+	}
+
+	if (method.length == 0) {
+		return Fail(ClientError::EMPTY_METHOD, offset + 1);
+	}
+
+	state = State::PATH;
+	path = { offset + 1, 0 };
+	return offset + 1;
+}
+
+std::size_t
+RequestParser::ParseOctet(const char *data, std::size_t offset) noexcept {
+	static const std::array<char, 8> expectedVersion = {
+		'H', 'T', 'T', 'P', '/', '1', '.', '\0'
+	};
+
+	const char character = data[offset];
+
+	switch (state) {
+		case State::VERSION:
+			if (versionIndex == 5) {
+				if (character != expectedVersion[5]) {
+					return Fail(ClientError::UNSUPPORTED_VERSION, offset + 1);
+				}
+			} else if (versionIndex == 7) {
+				if (!Utils::IsNumericCharacter(character)) {
+					return Fail(ClientError::INCORRECT_VERSION, offset + 1);
+				}
+				request.versionMinor = character - '0';
+				state = State::REQUEST_LINE_CR;
+			} else if (character != expectedVersion[versionIndex]) {
+				return Fail(ClientError::INCORRECT_VERSION, offset + 1);
+			}
+			versionIndex++;
+			break;
+		case State::REQUEST_LINE_CR:
+			// ConsumeCRLF reads both characters before checking them.
+			requestLineCR = character;
+			state = State::REQUEST_LINE_LF;
+			break;
+		case State::REQUEST_LINE_LF:
+			if (requestLineCR != '\r' || character != '\n') {
+				return Fail(ClientError::INCORRECT_CRLF, offset + 1);
+			}
+			state = State::HEADER_START;
+			break;
+		case State::HEADER_START:
+			if (character == '\r') {
+				state = State::HEADERS_END_LF;
+			} else {
+				// The first character of the name isn't validated by
+				// ConsumeHeaders either.
+				fieldName = { offset, 1 };
+				state = State::FIELD_NAME;
+			}
+			break;
+		case State::HEADERS_END_LF:
+			if (character != '\n') {
+				return Fail(ClientError::UNEXPECTED_CR_IN_FIELD_NAME, offset + 1);
+			}
+			Complete(data);
+			break;
+		case State::FIELD_VALUE_LF:
+			if (character != '\n') {
+				return Fail(ClientError::INCORRECT_HEADER_FIELD_NEWLINE, offset + 1);
+			}
+			if (!CommitHeaderField(data)) {
+				return Fail(ClientError::POLICY_TOO_MANY_HEADERS, offset + 1);
+			}
+			state = State::HEADER_START;
+			break;
+		default:
+			break;
+	}
+
+	return offset + 1;
+}
+
+std::size_t
+RequestParser::ParsePath(const char *data, std::size_t length, std::size_t offset) noexcept {
+	std::size_t run = ScanRun<PathClass>(data + offset, length - offset);
+
+	const bool violated = LimitRun(path.length, run, policies.maxRequestTargetLength);
+	path.length += run;
+
+	offset += run;
+	if (violated) {
+		return Fail(ClientError::POLICY_TOO_LONG_REQUEST_TARGET, offset);
+	}
+
+	if (offset == length) {
+		return offset;
+	}
+
+	if (data[offset] != ' ') {
+		return Fail(ClientError::INCORRECT_PATH, offset + 1);
+	}
+
+	state = State::VERSION;
+	versionIndex = 0;
+	return offset + 1;
+}
+
+void
+RequestParser::Reset() noexcept {
+	state = State::METHOD;
+	status = Status::INCOMPLETE;
+	error = ClientError::NO_ERROR;
+	position = 0;
+	versionIndex = 0;
+	owsCount = 0;
+	method = { 0, 0 };
+	path = { 0, 0 };
+	fieldCount = 0;
+}
+
+} // namespace HTTP
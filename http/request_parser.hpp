@@ -0,0 +1,186 @@
+#pragma once
+
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include <array>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "base/string.hpp"
+#include "http/client_error.hpp"
+#include "http/request.hpp"
+
+// Forward-decl from security/policies.hpp
+namespace Security {
+	struct Policies;
+} // namespace Security
+
+namespace HTTP {
+
+// An incremental parser for the request-line and headers of a request (the
+// 'head' of a request). The input can be fed in chunks of arbitrary size, and
+// the parser can stop and continue at any octet, which makes it suitable for
+// non-blocking connections.
+//
+// The parser accepts the same input as the consumers of HTTP::Client
+// (ConsumeMethod, ConsumePath, ...), and raises the same ClientError's and
+// Security::Policies limits. Runs of octets of the same class (e.g. token
+// characters) are scanned and validated with SIMD instructions where
+// available (SSE2, AVX2 or NEON).
+//
+// No data is copied: the request refers to the input.
+class RequestParser {
+public:
+	enum class Status {
+		// More input is needed.
+		INCOMPLETE,
+
+		// The head of the request has been parsed. Feed won't parse any more
+		// input until Reset is called.
+		COMPLETE,
+
+		// The input is malformed, or the connection ended prematurely. See
+		// Error().
+		FAILED,
+	};
+
+	// The parsed data is stored in [request]. The head can't be larger than
+	// [maxHeadLength] octets.
+	RequestParser(const Security::Policies &policies, Request &request, std::size_t maxHeadLength) noexcept;
+
+	// Parses the octets of [head] that haven't been parsed yet. [head] should
+	// start with the octets passed to the previous calls since the last
+	// Reset, but doesn't have to be at the same address: until the head is
+	// complete only offsets are stored. After that, the views of the request
+	// refer to [head].
+	[[nodiscard]] Status
+	Feed(const base::String &head) noexcept;
+
+	// Should be called when no more input will be received. Will fail the
+	// parser with the FAILED_READ_* error associated with the current state.
+	//
+	// Returns the error
+	[[nodiscard]] ClientError
+	EndOfStream() noexcept;
+
+	[[nodiscard]] inline ClientError
+	Error() const noexcept {
+		return error;
+	}
+
+	[[nodiscard]] inline Status
+	GetStatus() const noexcept {
+		return status;
+	}
+
+	// The amount of octets parsed. When the head is complete, this is the
+	// length of the head. On error, the octet that caused the error is
+	// included.
+	[[nodiscard]] inline std::size_t
+	HeadLength() const noexcept {
+		return position;
+	}
+
+	// Prepares the parser for the next request. Doesn't reset the request.
+	void
+	Reset() noexcept;
+
+private:
+	enum class State {
+		METHOD,
+		PATH,
+		VERSION,
+		REQUEST_LINE_CR,
+		REQUEST_LINE_LF,
+		HEADER_START,
+		HEADERS_END_LF,
+		FIELD_NAME,
+		FIELD_OWS,
+		FIELD_VALUE,
+		FIELD_VALUE_LF,
+	};
+
+	// A part of the head, relative to the start of the head.
+	struct Span {
+		std::size_t begin;
+		std::size_t length;
+	};
+
+	struct FieldSpans {
+		Span name;
+		Span value;
+	};
+
+	const Security::Policies &policies;
+	Request &request;
+	const std::size_t maxHeadLength;
+
+	State state{ State::METHOD };
+	Status status{ Status::INCOMPLETE };
+	ClientError error{ ClientError::NO_ERROR };
+	std::size_t position{ 0 };
+
+	// The index of the next character of the version.
+	std::size_t versionIndex{ 0 };
+
+	// The character received in the REQUEST_LINE_CR state.
+	char requestLineCR{ 0 };
+
+	std::size_t owsCount{ 0 };
+
+	Span method{ 0, 0 };
+	Span path{ 0, 0 };
+	Span fieldName{ 0, 0 };
+	Span fieldValue{ 0, 0 };
+
+	std::array<FieldSpans, HeaderList::capacity> fields;
+	std::size_t fieldCount{ 0 };
+
+	// Stores the field whose name and value have been parsed. Trailing OWS is
+	// removed from the value.
+	//
+	// Returns false if the maxHeaderCount policy was violated.
+	[[nodiscard]] bool
+	CommitHeaderField(const char *data) noexcept;
+
+	// Makes the views of the request refer to [data].
+	void
+	Complete(const char *data) noexcept;
+
+	[[nodiscard]] inline std::size_t
+	Fail(ClientError clientError, std::size_t consumed) noexcept {
+		status = Status::FAILED;
+		error = clientError;
+		return consumed;
+	}
+
+	// The following functions parse the input starting at [data][offset] for
+	// the state they are named after, and return the new offset.
+	[[nodiscard]] std::size_t
+	ParseFieldName(const char *data, std::size_t length, std::size_t offset) noexcept;
+
+	[[nodiscard]] std::size_t
+	ParseFieldOWS(const char *data, std::size_t length, std::size_t offset) noexcept;
+
+	[[nodiscard]] std::size_t
+	ParseFieldValue(const char *data, std::size_t length, std::size_t offset) noexcept;
+
+	[[nodiscard]] std::size_t
+	ParseMethod(const char *data, std::size_t length, std::size_t offset) noexcept;
+
+	[[nodiscard]] std::size_t
+	ParsePath(const char *data, std::size_t length, std::size_t offset) noexcept;
+
+	// Parses a single octet of the states that are only an octet long, i.e.
+	// VERSION, REQUEST_LINE_CR/LF, HEADER_START, HEADERS_END_LF and
+	// FIELD_VALUE_LF.
+	[[nodiscard]] std::size_t
+	ParseOctet(const char *data, std::size_t offset) noexcept;
+};
+
+} // namespace HTTP
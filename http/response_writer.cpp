@@ -0,0 +1,88 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include "http/response_writer.hpp"
+
+#include <array>
+#include <charconv>
+
+namespace HTTP {
+
+namespace {
+
+// Enough for the hexadecimal representation of any std::size_t and CRLF.
+using ChunkSize = std::array<char, 2 * sizeof(std::size_t) + 2>;
+
+[[nodiscard]] base::String
+FormatChunkSize(ChunkSize &output, std::size_t length) noexcept {
+	auto *end = std::to_chars(output.data(), output.data() + output.size(), length, 16).ptr;
+	*end++ = '\r';
+	*end++ = '\n';
+	return base::String(output.data(), static_cast<std::size_t>(end - output.data()));
+}
+
+} // namespace
+
+void
+ResponseWriter::Begin(Connection &output, const base::String &head, bool chunkedBody) noexcept {
+	connection = &output;
+	metadata = head;
+	chunked = chunkedBody;
+	inProgress = true;
+}
+
+bool
+ResponseWriter::End(std::string_view data) noexcept {
+	inProgress = false;
+	const base::String body(data.data(), data.length());
+	const auto head = metadata;
+	metadata = base::String("", 0);
+
+	if (!chunked) {
+		return connection->WriteBaseStrings({ head, body });
+	}
+
+	const base::String lastChunk("0\r\n\r\n", 5);
+	if (data.empty()) {
+		return connection->WriteBaseStrings({ head, lastChunk });
+	}
+
+	ChunkSize size;
+	return connection->WriteBaseStrings({ head, FormatChunkSize(size, data.length()), body,
+										  base::String("\r\n0\r\n\r\n", 7) });
+}
+
+Connection::Status
+ResponseWriter::Flush() noexcept {
+	if (connection == nullptr) {
+		return Connection::Status::COMPLETE;
+	}
+
+	if (metadata.length() != 0 && !Write({})) {
+		return Connection::Status::FAILED;
+	}
+	return connection->FlushSendBacklog();
+}
+
+bool
+ResponseWriter::Write(std::string_view data) noexcept {
+	const base::String body(data.data(), data.length());
+	const auto head = metadata;
+	metadata = base::String("", 0);
+
+	if (data.empty()) {
+		return head.length() == 0 || connection->WriteBaseString(head);
+	}
+
+	if (!chunked) {
+		return connection->WriteBaseStrings({ head, body });
+	}
+
+	ChunkSize size;
+	return connection->WriteBaseStrings({ head, FormatChunkSize(size, data.length()), body, base::String("\r\n", 2) });
+}
+
+} // namespace HTTP
@@ -0,0 +1,80 @@
+#pragma once
+
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include <string_view>
+
+#include "base/string.hpp"
+#include "connection/connection.hpp"
+
+namespace HTTP {
+
+// Writes a response body that is produced while it is sent, e.g. the output of
+// a CGI script or a file compressed on the fly, whose length often isn't known
+// in advance. Such a body is sent with chunked transfer coding, or as it is if
+// the peer doesn't support it (HTTP/1.0), or its length is known after all.
+//
+// The framing of a chunk is written together with its data, and the metadata
+// together with the first part of the body, in a single vectored write, see
+// Connection::WriteBaseStrings. The memory is bounded by the producer, which
+// should only produce the next part once the previous ones have been sent,
+// see Flush, so at most a part is in the send backlog.
+//
+// Spec: RFC 7230 § 4.1
+class ResponseWriter {
+public:
+	// Starts the response on [connection] with [metadata], which is held back
+	// until the first Write or End, so it has to stay valid until then. With
+	// [chunked], the metadata should announce chunked transfer coding.
+	void
+	Begin(Connection &connection, const base::String &metadata, bool chunked) noexcept;
+
+	// Writes the next part of the body, as a chunk if the body is chunked. An
+	// empty part would end a chunked body, so only the metadata is written
+	// then, if it has been held back.
+	//
+	// Returns success status
+	[[nodiscard]] bool
+	Write(std::string_view data) noexcept;
+
+	// Writes the last part of the body, followed by the last chunk if the body
+	// is chunked, and ends the response.
+	//
+	// Returns success status
+	[[nodiscard]] bool
+	End(std::string_view data = {}) noexcept;
+
+	// Writes the send backlog of the connection. The next part of the body
+	// should only be produced once COMPLETE is returned.
+	[[nodiscard]] Connection::Status
+	Flush() noexcept;
+
+	// Whether a response has been started, but not ended.
+	[[nodiscard]] inline bool
+	InProgress() const noexcept {
+		return inProgress;
+	}
+
+	// Forgets the response, e.g. when it has been replaced or the connection
+	// is closed.
+	inline void
+	Reset() noexcept {
+		metadata = base::String("", 0);
+		chunked = false;
+		inProgress = false;
+	}
+
+private:
+	Connection *connection{ nullptr };
+
+	// Empty once it has been written.
+	base::String metadata{ "", 0 };
+	bool chunked{ false };
+	bool inProgress{ false };
+};
+
+} // namespace HTTP
@@ -7,24 +7,387 @@
 #include "server.hpp"
 
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <exception>
 #include <initializer_list>
 #include <iterator>
+#include <new>
 #include <sstream> // IWYU pragma: keep
+#include <string>
 
 #include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <dirent.h>
+#include <fcntl.h>
 #include <netinet/in.h>
 #include <poll.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
+#if defined(__linux__)
+#include <linux/filter.h>
+#endif
+
 #include "base/logger.hpp"
+#include "base/numa.hpp"
+#include "base/strings.hpp"
 #include "http/client.hpp"
 #include "http/configuration.hpp"
+#include "http/metrics.hpp"
 #include "http/server_launch_error.hpp"
+#include "http/utils.hpp"
+#include "http/worker.hpp"
+#include "io/file_cache_manifest.hpp"
+
+// FreeBSD's SO_REUSEPORT doesn't distribute the incoming connections over the
+// sockets, which is what SO_REUSEPORT_LB is for.
+#ifdef SO_REUSEPORT_LB
+#define MAGIC_SO_REUSEPORT SO_REUSEPORT_LB
+#else
+#define MAGIC_SO_REUSEPORT SO_REUSEPORT
+#endif
+
+// How often the clients are checked while the server drains, in milliseconds.
+#define MAGIC_DRAIN_POLL_INTERVAL 50
+
+// Linux selects the listening socket of a connection with a classic BPF
+// program attached to the sockets, see Server::SteerConnections.
+#if defined(__linux__) && defined(SO_ATTACH_REUSEPORT_CBPF)
+#define MAGIC_STEER_CONNECTIONS
+#endif
+
+// The maximum amount of directories WarmFileCache descends into beneath the
+// root directory of a site.
+#define MAGIC_FILE_CACHE_WARM_MAX_DEPTH 16
 
 namespace HTTP {
 
+namespace {
+
+// The site and request path of each file to warm, see Server::WarmFileCache.
+using WarmTargets = std::vector<std::pair<const Site *, std::string>>;
+
+// Whether [name] in [directory] is the precompressed sibling of a file next to
+// it, which is cached with that file.
+[[nodiscard]] bool
+IsPrecompressedSibling(int directory, std::string_view name) noexcept {
+	for (std::size_t i = 1; i < contentCodingCount; i++) {
+		const auto suffix = ContentCodingSuffix(static_cast<ContentCoding>(i));
+		if (name.length() <= suffix.length() || name.substr(name.length() - suffix.length()) != suffix) {
+			continue;
+		}
+
+		const std::string file(name.substr(0, name.length() - suffix.length()));
+		struct stat status{};
+		return fstatat(directory, file.c_str(), &status, 0) == 0 && S_ISREG(status.st_mode);
+	}
+	return false;
+}
+
+// Collects the files beneath [path] of [site], which is opened as
+// [directoryHandle], until there are [limit] targets. Directories with an
+// index.html are targets too.
+void
+CollectFiles(const Site &site, int directoryHandle, std::string &path, std::size_t depth, std::size_t limit,
+			 WarmTargets &targets) {
+	DIR *directory = fdopendir(directoryHandle);
+	if (directory == nullptr) {
+		close(directoryHandle);
+		return;
+	}
+
+	const auto pathLength = path.length();
+	bool hasIndex = false;
+	while (targets.size() < limit) {
+		const struct dirent *entry = readdir(directory);
+		if (entry == nullptr) {
+			break;
+		}
+
+		const std::string_view name(entry->d_name);
+		if (name == "." || name == "..") {
+			continue;
+		}
+
+		auto type = entry->d_type;
+		if (type == DT_UNKNOWN) {
+			struct stat status{};
+			if (fstatat(dirfd(directory), entry->d_name, &status, AT_SYMLINK_NOFOLLOW) != 0) {
+				continue;
+			}
+			type = S_ISDIR(status.st_mode) ? DT_DIR : S_ISLNK(status.st_mode) ? DT_LNK : DT_REG;
+		}
+
+		path.append(1, '/').append(name);
+		if (type == DT_DIR) {
+			// Symbolic links to directories aren't followed, so there are no
+			// cycles.
+			const int handle = depth == 0 ? -1 : openat(dirfd(directory), entry->d_name,
+														 O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+			if (handle != -1) {
+				CollectFiles(site, handle, path, depth - 1, limit, targets);
+			}
+		} else if ((type == DT_REG || type == DT_LNK) && !IsPrecompressedSibling(dirfd(directory), name)) {
+			targets.emplace_back(&site, path);
+			hasIndex = hasIndex || name == "index.html";
+		}
+		path.resize(pathLength);
+	}
+
+	closedir(directory);
+	if (hasIndex && targets.size() < limit) {
+		targets.emplace_back(&site, path + '/');
+	}
+}
+
+// The errors that are answered with a fixed response, see ErrorResponse.
+struct FixedError {
+	ClientError error;
+	const base::String &statusLine;
+	const MediaType &mediaType;
+	std::string_view body;
+
+	// Whether the request is malformed, in which case the body is prefixed and
+	// the connection is closed.
+	bool malformed;
+
+	bool closesConnection;
+};
+
+[[nodiscard]] inline std::string_view
+View(const base::String &string) noexcept {
+	return { string.data(), string.length() };
+}
+
+[[nodiscard]] std::vector<FixedError>
+FixedErrors() {
+	using namespace Strings;
+	return {
+		{ ClientError::EMPTY_METHOD, StatusLines::BadRequest, MediaTypes::TEXT, View(BadRequestMessages::EmptyMethod), true, true },
+		{ ClientError::FILE_NOT_FOUND, StatusLines::NotFound, MediaTypes::HTML, View(NotFoundPage), false, false },
+		{ ClientError::FILE_READ_INSUFFICIENT_PERMISSIONS, StatusLines::Forbidden, MediaTypes::HTML, View(ForbiddenPage), false, false },
+		{ ClientError::FILE_SYSTEM_OVERLOAD, StatusLines::ServiceUnavailable, MediaTypes::HTML, View(FileSystemOverloadPage), false, false },
+		{ ClientError::HOST_HEADER_ILLEGAL_PORT, StatusLines::BadRequest, MediaTypes::TEXT, "'Host' header port component isn't a number", true, true },
+		{ ClientError::HOST_HEADER_INCORRECT, StatusLines::BadRequest, MediaTypes::TEXT, "incorrect 'Host' header field-value", true, true },
+		{ ClientError::HOST_HEADER_INCORRECT_PORT, StatusLines::BadRequest, MediaTypes::TEXT, "incorrect 'Host' header port component", true, true },
+		{ ClientError::HOST_HEADER_MANY, StatusLines::BadRequest, MediaTypes::TEXT, "more than one 'Host' header supplied", true, true },
+		{ ClientError::HOST_HEADER_NONE, StatusLines::BadRequest, MediaTypes::TEXT, "no 'Host' header supplied", true, true },
+		{ ClientError::INCORRECT_BODY_FRAMING, StatusLines::BadRequest, MediaTypes::TEXT, "invalid Content-Length or Transfer-Encoding header field", true, true },
+		{ ClientError::INCORRECT_CHUNK, StatusLines::BadRequest, MediaTypes::TEXT, View(BadRequestMessages::MalformedBody), true, true },
+		{ ClientError::INCORRECT_HEADER_FIELD_NAME, StatusLines::BadRequest, MediaTypes::TEXT, "invalid header field-name", true, true },
+		{ ClientError::INCORRECT_HEADER_FIELD_NEWLINE, StatusLines::BadRequest, MediaTypes::TEXT, "expected newline (CRLF) after header field", true, true },
+		{ ClientError::INCORRECT_HEADER_FIELD_VALUE, StatusLines::BadRequest, MediaTypes::TEXT, "invalid header field-value", true, true },
+		{ ClientError::INCORRECT_METHOD, StatusLines::BadRequest, MediaTypes::TEXT, "invalid method: not a token as per RFC 7230 section 3.2.6", true, true },
+		{ ClientError::INCORRECT_PATH, StatusLines::BadRequest, MediaTypes::TEXT, "incorrect request-target", true, true },
+		{ ClientError::INCORRECT_PATH_ABSOLUTE_FORM, StatusLines::BadRequest, MediaTypes::TEXT, "absolute-form request-target in invalid form", true, true },
+		{ ClientError::INCORRECT_CRLF, StatusLines::BadRequest, MediaTypes::TEXT, "request-line should end with a newline (CRLF)", true, true },
+		{ ClientError::INCORRECT_VERSION, StatusLines::BadRequest, MediaTypes::TEXT, "invalid HTTP version as per RFC 7230 section 2.6", true, true },
+		{ ClientError::INVALID_PATH_EMPTY, StatusLines::BadRequest, MediaTypes::TEXT, "request-target was empty", true, true },
+		{ ClientError::INVALID_PATH_NOT_ABSOLUTE, StatusLines::BadRequest, MediaTypes::TEXT, "only origin-form and absolute-form request-targets are supported", true, true },
+		// The body isn't read, so the connection can't be used for another
+		// request.
+		{ ClientError::POLICY_TOO_LARGE_BODY, StatusLines::PayloadTooLarge, MediaTypes::TEXT, View(BadRequestMessages::BodyTooLarge), false, true },
+		{ ClientError::POLICY_TOO_LONG_HEADER_FIELD_NAME, StatusLines::PayloadTooLarge, MediaTypes::TEXT, View(BadRequestMessages::HeaderFieldNameTooLong), false, false },
+		{ ClientError::POLICY_TOO_LONG_HEADER_FIELD_VALUE, StatusLines::PayloadTooLarge, MediaTypes::TEXT, View(BadRequestMessages::HeaderFieldValueTooLong), false, false },
+		{ ClientError::POLICY_TOO_LONG_METHOD, StatusLines::PayloadTooLarge, MediaTypes::TEXT, View(BadRequestMessages::MethodTooLong), false, false },
+		{ ClientError::POLICY_TOO_LONG_REQUEST_TARGET, StatusLines::URITooLong, MediaTypes::TEXT, View(BadRequestMessages::RequestTargetTooLong), false, false },
+		{ ClientError::POLICY_TOO_MANY_HEADERS, StatusLines::RequestHeaderFieldsTooLarge, MediaTypes::TEXT, View(BadRequestMessages::TooManyHeaders), false, false },
+		{ ClientError::POLICY_TOO_MANY_OWS, StatusLines::PayloadTooLarge, MediaTypes::TEXT, View(BadRequestMessages::TooManyOWSs), false, false },
+		{ ClientError::REQUEST_HEAD_TOO_LARGE, StatusLines::RequestHeaderFieldsTooLarge, MediaTypes::TEXT, View(BadRequestMessages::RequestHeadTooLarge), false, false },
+		{ ClientError::TOO_MANY_REQUESTS_PER_THIS_CONNECTION, StatusLines::TooManyRequests, MediaTypes::HTML, View(TooManyRequestsPage), false, false },
+		{ ClientError::UNSUPPORTED_TRANSFER_CODING, StatusLines::NotImplemented, MediaTypes::TEXT, View(BadRequestMessages::UnsupportedTransferCoding), false, true },
+		{ ClientError::UNSUPPORTED_VERSION, StatusLines::HTTPVersionNotSupported, MediaTypes::TEXT, View(VersionNotSupportedPage), false, false },
+	};
+}
+
+} // namespace
+
+void
+Server::SerializeErrorResponses() {
+	// The same head as Client::SerializeMetadata.
+	const auto serializeHead = [this](std::string &output, const base::String &statusLine, std::size_t contentLength,
+									  std::string_view connection, const MediaType &mediaType) {
+		output.assign(statusLine.data(), statusLine.length());
+		output += "\r\nContent-Length: ";
+		output += std::to_string(contentLength);
+		output += connection;
+		output += staticHeaders;
+		output += "\r\nContent-Type: ";
+		output += mediaType.ContentType();
+		output += "\r\n";
+	};
+
+	const std::string_view prefix("Malformed request: ");
+	for (const auto &fixed : FixedErrors()) {
+		std::string body(fixed.malformed ? prefix : std::string_view());
+		body += fixed.body;
+
+		auto &response = errorResponses[static_cast<std::size_t>(fixed.error)];
+		response.statusLine = View(fixed.statusLine);
+		response.mediaType = &fixed.mediaType;
+		response.closesConnection = fixed.malformed || fixed.closesConnection;
+		response.compressible = configuration.compressionEnabled &&
+								body.length() >= configuration.compressionMinimumSize &&
+								fixed.mediaType.IsCompressible();
+
+		for (bool persistent : { false, true }) {
+			auto &output = response.responses[persistent];
+			serializeHead(output, fixed.statusLine, body.length(),
+						  persistent ? "\r\nConnection: keep-alive" : "\r\nConnection: close", fixed.mediaType);
+			if (response.compressible) {
+				output += "Vary: Accept-Encoding\r\n";
+			}
+			output += "\r\n";
+			response.headLengths[persistent] = output.length();
+			output += body;
+		}
+	}
+
+	serializeHead(upgradeResponseHead, Strings::StatusLines::MovedPermanently, 0, "\r\nConnection: close", MediaTypes::HTML);
+	upgradeResponseHead += "Location: https://";
+}
+
+void
+Server::SerializeStaticHeaders() {
+	const auto &policies = configuration.securityPolicies;
+
+	staticHeaders = "\r\nServer: " + configuration.serverProductName;
+
+	const auto &hsts = configuration.hsts;
+	if (configuration.useTransportSecurity && hsts.length() != 0) {
+		staticHeaders += "\r\nStrict-Transport-Security: ";
+		staticHeaders.append(hsts.data(), hsts.length());
+	}
+
+	const auto &altSvc = configuration.altSvc;
+	if (altSvc.length() != 0) {
+		staticHeaders += "\r\nAlt-Svc: ";
+		staticHeaders.append(altSvc.data(), altSvc.length());
+	}
+
+	if (policies.enableContentTypeNosniffing) {
+		staticHeaders += "\r\nX-Content-Type-Options: nosniff";
+	}
+
+	if (policies.denyIFraming) {
+		staticHeaders += "\r\nX-Frame-Options: SAMEORIGIN";
+	}
+
+	if (policies.enableXSSProtectionHeader) {
+		staticHeaders += "\r\nX-XSS-Protection: 1; mode=block";
+	}
+
+	const auto &csp = policies.contentSecurityPolicy;
+	if (csp.length() != 0) {
+		staticHeaders += "\r\nContent-Security-Policy: ";
+		staticHeaders.append(csp.data(), csp.length());
+	}
+
+	if (policies.disableReferrer) {
+		staticHeaders += "\r\nReferrer-Policy: no-referrer";
+	}
+
+	staticFields = HTTP2::HPACK::RepeatedFields(staticHeaders);
+}
+
+void
+Server::CreateSites() {
+	sites.push_back(std::make_unique<Site>(configuration.hostname, configuration.rootDirectory,
+										   configuration.autoIndexCapacity));
+
+	for (const auto &virtualHost : configuration.virtualHosts) {
+		if (virtualHost.hostnames.empty()) {
+			throw HTTP::ConfigurationException("virtual host without hostnames");
+		}
+
+		sites.push_back(std::make_unique<Site>(virtualHost.hostnames.front(), virtualHost.rootDirectory,
+											   configuration.autoIndexCapacity));
+		for (const auto &hostname : virtualHost.hostnames) {
+			std::string name(hostname);
+			std::transform(std::cbegin(name), std::cend(name), std::begin(name), Utils::ToLower);
+			siteNames.emplace_back(std::move(name), sites.back().get());
+		}
+	}
+
+	std::sort(std::begin(siteNames), std::end(siteNames));
+	const auto duplicate = std::adjacent_find(std::cbegin(siteNames), std::cend(siteNames),
+											  [](const auto &a, const auto &b) { return a.first == b.first; });
+	if (duplicate != std::cend(siteNames)) {
+		throw HTTP::ConfigurationException("hostname of multiple virtual hosts");
+	}
+}
+
+const Site *
+Server::FindVirtualHost(std::string_view host) const noexcept {
+	std::array<char, 256> buffer;
+	if (host.empty() || host.length() > buffer.size()) {
+		return nullptr;
+	}
+
+	std::transform(std::cbegin(host), std::cend(host), std::begin(buffer), Utils::ToLower);
+	const std::string_view name(buffer.data(), host.length());
+
+	const auto iterator = std::lower_bound(std::cbegin(siteNames), std::cend(siteNames), name,
+										   [](const auto &entry, std::string_view value) {
+		return entry.first < value;
+	});
+	if (iterator == std::cend(siteNames) || iterator->first != name) {
+		return nullptr;
+	}
+
+	return iterator->second;
+}
+
+const Site &
+Server::FindSite(const Request &request) const noexcept {
+	const auto *header = request.headers.Find(HeaderID::HOST);
+	if (header == nullptr || siteNames.empty()) {
+		return *sites.front();
+	}
+
+	// The port has been checked by Client::CheckHostHeader.
+	auto host = header->value;
+	host = host.substr(0, host.find(':'));
+
+	const auto *site = FindVirtualHost(host);
+	return site != nullptr ? *site : *sites.front();
+}
+
+std::shared_ptr<const IO::CachedFile>
+Server::ResolveFile(const Request &request, IO::FileResolveStatus &status,
+					std::shared_ptr<const std::string> *listing) noexcept {
+	const auto &site = FindSite(request);
+
+	// The file cache might be shared with other sites and servers, so the
+	// files are keyed by the root directory too.
+	thread_local std::string key;
+	key.assign(site.rootDirectory);
+	key.append(request.path);
+
+	status = IO::FileResolveStatus::OK;
+	auto cachedFile = fileCache.Lookup(key);
+	if (configuration.metrics != nullptr) {
+		configuration.metrics->CountFileCacheLookup(cachedFile != nullptr);
+	}
+	if (cachedFile != nullptr) {
+		return cachedFile;
+	}
+
+	return CacheFile(site, key, request, status, listing);
+}
+
+bool
+Server::SaveFileCacheManifest() noexcept {
+	if (configuration.fileCacheManifest.empty()) {
+		return true;
+	}
+	return IO::FileCacheManifest::Save(configuration.fileCacheManifest, fileCache.Paths());
+}
+
 void
 Server::Start() {
 	internalThread = std::make_unique<std::thread>(&Server::InternalStart, this);
@@ -32,17 +395,68 @@ Server::Start() {
 
 bool
 Server::Initialize() noexcept {
+	// Without the file cache the files are still served, so it isn't fatal.
+	if (ownFileCache != nullptr) {
+		static_cast<void>(ownFileCache->Initialize());
+	}
+
+	// Before listening, so the server is warm once it accepts connections.
+	if (configuration.prewarmFileCache) {
+		WarmFileCache();
+	}
+
+	// Ignore SIGPIPE ~= accessing closed connection. Once for the process,
+	// instead of per thread, since the writes of OpenSSL and to the pipes of
+	// CGI scripts can't pass MSG_NOSIGNAL.
+	std::signal(SIGPIPE, SIG_IGN);
+
+	if (configuration.servingMode == ServingMode::THREAD_PER_CLIENT) {
+		if (!admission.Initialize()) {
+			Logger::Error("HTTPServer::Initialize", "Failed to reserve a file descriptor");
+			return false;
+		}
+
+		try {
+			clientPool = std::make_unique<ClientPool>(*this, configuration.clientThreadCount,
+													  configuration.clientQueueCapacity,
+													  configuration.clientThreadStackSize);
+		} catch (const std::bad_alloc &) {
+			Logger::Error("HTTPServer::Initialize", "Failed to allocate the client pool");
+			return false;
+		}
+
+		if (!clientPool->Start()) {
+			Logger::Error("HTTPServer::Initialize", "Failed to start the client threads");
+			clientPool.reset();
+			return false;
+		}
+	}
+
+	const auto &policies = configuration.securityPolicies;
+	if (policies.maxConnectionsPerAddress != 0 || policies.connectionRatePerAddress != 0) {
+		try {
+			addressLimiter = std::make_unique<Security::AddressLimiter>(policies);
+		} catch (const std::bad_alloc &) {
+			Logger::Error("HTTPServer::Initialize", "Failed to allocate the address limiter");
+			return false;
+		}
+	}
 	return CreateServer();
 }
 
 void
 Server::InternalStart() {
+	if (configuration.servingMode == ServingMode::EVENT_DRIVEN) {
+		RunWorkers();
+		return;
+	}
+
 	struct pollfd pollAction;
-	pollAction.fd = internalSocket;
+	pollAction.fd = internalSockets.front();
 	pollAction.events = POLLIN;
 	pollAction.revents = 0;
 
-	while (!shutdownSignaled) {
+	while (!shutdownSignaled && !IsDraining()) {
 		int pollStatus = poll(&pollAction, 1, configuration.pollAcceptTimeout);
 
 		if (pollStatus == 0) {
@@ -58,35 +472,121 @@ Server::InternalStart() {
 		AcceptClient();
 	}
 
-	// WARNING This causes a memory leak, and is just to mitigate the raised
-	// exception by std::thread::~thread if std::thread::joinable() is true.
-	clientsMutex.lock();
-	for (const auto &client : clients) {
-		client->thread.detach();
+	if (IsDraining()) {
+		DrainClients();
 	}
-	clientsMutex.unlock();
+
+	// The connections left are shut down.
+	clientPool->Stop();
 }
 
 Server::~Server() noexcept {
-	// The thread has exited by now.
+	// The thread has exited by now, but the server might not have run, while
+	// the threads of the clients have.
+	if (clientPool != nullptr) {
+		clientPool->Stop();
+	}
 
 	for (const auto &cleanFunction : cleanFunctions) {
 		cleanFunction(this);
 	}
+
+	if (!SaveFileCacheManifest()) {
+		Logger::Warning("HTTPServer", "Failed to save the file cache manifest");
+	}
 }
 
 void
 Server::AcceptClient() {
-	int client = accept(internalSocket, nullptr, nullptr);
+	const auto acceptStart = configuration.metrics == nullptr ? std::chrono::steady_clock::time_point{}
+															  : std::chrono::steady_clock::now();
+	struct sockaddr_storage address{};
+	socklen_t addressLength = sizeof(address);
+	int client = accept(internalSockets.front(), reinterpret_cast<struct sockaddr *>(&address), &addressLength);
 
 	if (client == -1) {
+		if ((errno == EMFILE || errno == ENFILE) && admission.ShedWithReserve(internalSockets.front())) {
+			return;
+		}
 		Logger::Warning("HTTPServer::AcceptClient", "Accept() failed!");
 		return;
 	}
 
-	clientsMutex.lock();
-	clients.push_back(std::make_unique<Client>(this, client));
-	clientsMutex.unlock();
+	Security::AddressLease lease;
+	if (!AdmitConnection(address, lease)) {
+		close(client);
+		return;
+	}
+
+	ShedReason reason;
+	if (admission.ShouldShed(client, clientPool->ConnectionCount(), {}, reason)) {
+		admission.Shed(client, reason);
+		return;
+	}
+
+	// Every thread is busy and the queue is full.
+	if (!clientPool->TrySubmit(client, lease)) {
+		admission.Shed(client, ShedReason::CONNECTIONS);
+		return;
+	}
+
+	if (configuration.metrics != nullptr) {
+		configuration.metrics->Record(Stage::ACCEPT, std::chrono::steady_clock::now() - acceptStart);
+	}
+}
+
+bool
+Server::AdmitConnection(const struct sockaddr_storage &address, Security::AddressLease &lease) noexcept {
+	if (addressLimiter == nullptr) {
+		return true;
+	}
+
+	const auto admission = addressLimiter->Admit(reinterpret_cast<const struct sockaddr *>(&address), lease);
+	if (admission == Security::AddressAdmission::ADMITTED) {
+		return true;
+	}
+
+	if (configuration.metrics != nullptr) {
+		configuration.metrics->CountRefusedConnection(admission);
+	}
+	return false;
+}
+
+std::size_t
+Server::CalculateWorkerCount() const noexcept {
+	if (configuration.servingMode != ServingMode::EVENT_DRIVEN) {
+		return 1;
+	}
+
+	if (!configuration.inheritedSockets.empty()) {
+		return configuration.inheritedSockets.size();
+	}
+
+	if (configuration.workerCount != 0) {
+		return configuration.workerCount;
+	}
+
+	return std::max(std::thread::hardware_concurrency(), 1U);
+}
+
+std::shared_ptr<const IO::CachedFile>
+Server::CacheFile(const Site &site, std::string_view key, const Request &request,
+				  IO::FileResolveStatus &status, std::shared_ptr<const std::string> *listing) noexcept {
+	auto resolveResult = site.resolver.Resolve(request);
+	status = resolveResult.first;
+	if (status != IO::FileResolveStatus::OK) {
+		// The resolver returns the directory when it has no index.
+		if (listing != nullptr && configuration.autoIndex && resolveResult.second != nullptr) {
+			const auto &directory = *resolveResult.second;
+			*listing = site.listings.Listing(directory, std::string_view(directory.Path()).substr(site.rootDirectory.length()));
+		}
+		return nullptr;
+	}
+
+	auto &file = resolveResult.second;
+	const auto &mediaType = configuration.mediaTypeFinder.DetectMediaType(file);
+	auto encodings = site.resolver.ResolveEncodings(*file);
+	return fileCache.Insert(key, std::move(file), mediaType, std::move(encodings));
 }
 
 void
@@ -94,20 +594,23 @@ Server::CheckConfiguration() const {
 	if (configuration.pollAcceptTimeout < 0) {
 		throw HTTP::ConfigurationException("negative pollAcceptTimeout");
 	}
+
+	if (configuration.servingMode == ServingMode::THREAD_PER_CLIENT && configuration.clientThreadCount == 0) {
+		throw HTTP::ConfigurationException("no clientThreadCount");
+	}
 }
 
 void
-Server::CloseSocket() noexcept {
-	if (internalSocket == -1) {
-		return;
+Server::CloseSockets() noexcept {
+	for (int socket : internalSockets) {
+		close(socket);
 	}
 
-	close(internalSocket);
-	internalSocket = -1;
+	internalSockets.clear();
 }
 
 ServerLaunchError
-Server::ConfigureSocketBind() noexcept {
+Server::ConfigureSocketBind(int &socket) noexcept {
 #ifdef HTTP_SERVER_FORCE_IPV4
 	struct sockaddr_in address;
 	address.sin_family = AF_INET;
@@ -120,7 +623,7 @@ Server::ConfigureSocketBind() noexcept {
 	address.sin6_addr = IN6ADDR_ANY_INIT;
 #endif
 
-	if (bind(internalSocket, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) == -1) {
+	if (bind(socket, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) == -1) {
 		switch (errno) {
 			case EADDRINUSE:
 				return ServerLaunchError::SOCKET_BIND_PORT_IN_USE;
@@ -137,8 +640,8 @@ Server::ConfigureSocketBind() noexcept {
 }
 
 ServerLaunchError
-Server::ConfigureSocketListen() noexcept {
-	if (listen(internalSocket, configuration.listenerBacklog) == -1) {
+Server::ConfigureSocketListen(int &socket) noexcept {
+	if (listen(socket, configuration.listenerBacklog) == -1) {
 		return ServerLaunchError::SOCKET_LISTEN;
 	}
 
@@ -146,10 +649,17 @@ Server::ConfigureSocketListen() noexcept {
 }
 
 ServerLaunchError
-Server::ConfigureSocketSetReusable() noexcept {
+Server::ConfigureSocketSetReusable(int &socket) noexcept {
 	int flag = 1;
 
-	if (setsockopt(internalSocket, SOL_SOCKET, SO_REUSEADDR, &flag, sizeof(int)) == -1) {
+	if (setsockopt(socket, SOL_SOCKET, SO_REUSEADDR, &flag, sizeof(int)) == -1) {
+		return ServerLaunchError::SOCKET_REUSABLE;
+	}
+
+	// Every worker has a listening socket of its own, bound to the same port.
+	// The kernel distributes the incoming connections over them.
+	if (CalculateWorkerCount() > 1 &&
+		setsockopt(socket, SOL_SOCKET, MAGIC_SO_REUSEPORT, &flag, sizeof(int)) == -1) {
 		return ServerLaunchError::SOCKET_REUSABLE;
 	}
 
@@ -158,37 +668,71 @@ Server::ConfigureSocketSetReusable() noexcept {
 
 bool
 Server::CreateServer() noexcept {
-	for (auto function : { &Server::CreateSocket, &Server::ConfigureSocketSetReusable, &Server::ConfigureSocketBind, &Server::ConfigureSocketListen }) {
-		ServerLaunchError error = (this->*function)();
+	cleanFunctions.emplace_back(&Server::CloseSockets);
 
-		if (error != ServerLaunchError::NO_ERROR) {
-			std::stringstream info;
-			info << "Failed to create server!\nError: " << error;
-			Logger::Warning("HTTPServer::AcceptClient", info.str());
-			return false;
+	// The sockets are bound and listening already.
+	if (!configuration.inheritedSockets.empty()) {
+		internalSockets = configuration.inheritedSockets;
+		return true;
+	}
+
+	const auto socketCount = CalculateWorkerCount();
+	for (std::size_t i = 0; i < socketCount; i++) {
+		int socket = -1;
+
+		for (auto function : { &Server::CreateSocket, &Server::ConfigureSocketSetReusable, &Server::ConfigureSocketBind, &Server::ConfigureSocketListen }) {
+			ServerLaunchError error = (this->*function)(socket);
+
+			if (error != ServerLaunchError::NO_ERROR) {
+				std::stringstream info;
+				info << "Failed to create server!\nError: " << error;
+				Logger::Warning("HTTPServer::CreateServer", info.str());
+				return false;
+			}
 		}
 	}
 
+	SteerConnections();
 	return true;
 }
 
 ServerLaunchError
-Server::CreateSocket() noexcept {
+Server::CreateSocket(int &socket) noexcept {
+	// The socket is passed on explicitly to the process of a binary upgrade,
+	// not inherited by CGI scripts.
 #ifdef HTTP_SERVER_FORCE_IPV4
-	internalSocket = socket(AF_INET, SOCK_STREAM, 0);
+	socket = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
 #else
-	internalSocket = socket(AF_INET6, SOCK_STREAM, 0);
+	socket = ::socket(AF_INET6, SOCK_STREAM | SOCK_CLOEXEC, 0);
 #endif
 
-	if (internalSocket == -1) {
+	if (socket == -1) {
 		return ServerLaunchError::SOCKET_CREATION;
 	}
 
-	cleanFunctions.emplace_back(&Server::CloseSocket);
+	internalSockets.push_back(socket);
 
 	return ServerLaunchError::NO_ERROR;
 }
 
+void
+Server::DrainClients() noexcept {
+	const auto timeout = std::chrono::milliseconds(configuration.drainTimeout);
+	const auto deadline = std::chrono::steady_clock::now() + timeout;
+
+	// The clients close their connection once the current exchange is done,
+	// see Client::CheckConnectionLifetime, and the idle ones right away.
+	clientPool->ShutdownIdle();
+	while (!shutdownSignaled && clientPool->ConnectionCount() != 0) {
+		if (configuration.drainTimeout != 0 && std::chrono::steady_clock::now() >= deadline) {
+			Logger::Warning("HTTPServer::DrainClients", "Not all clients finished in time");
+			return;
+		}
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(MAGIC_DRAIN_POLL_INTERVAL));
+	}
+}
+
 void
 Server::HandlePollFailure() {
 	// A call to poll() can ONLY fail on catastrophic failures, like a shortage
@@ -205,39 +749,207 @@ Server::HandlePollFailure() {
 	std::terminate();
 }
 
-// SignalClientDeath is tailcalled from the destructor of HTTP::Client.
-// This function will remove the client from the 'clients' vector.
-//
-// To remove the client, we will momentarily detach the thread, because
-// std::thread::~thread will std::terminate if it isn't joining or
-// detached.
-//
-// We can't do the former, since joining will only work from another thread
-// and if it was possible, it would mean a deadlock since the destructor
-// can't be called.
 void
-Server::SignalClientDeath(std::thread thread) noexcept {
-	// Lock the mutex to prevent modifications as we access 'clients'.
-	const std::lock_guard<std::mutex> lock(clientsMutex);
+Server::RunWorkers() {
+	const int coreCount = static_cast<int>(std::thread::hardware_concurrency());
+	const auto placements = topology.Place(internalSockets.size());
+
+	for (std::size_t i = 0; i < internalSockets.size(); i++) {
+		int core = -1;
+		std::size_t node = 0;
+		if (!placements.empty()) {
+			core = placements[i].cpu;
+			node = placements[i].node;
+		} else if (configuration.pinWorkersToCores && coreCount > 0) {
+			core = static_cast<int>(i) % coreCount;
+		}
+
+		workers.push_back(std::make_unique<Worker>(this, internalSockets[i], internalSockets.size(), core, node));
+		if (!workers.back()->Initialize()) {
+			Logger::Severe("HTTPServer::RunWorkers", "Failed to initialize a worker");
+			workers.clear();
+			return;
+		}
+	}
+
+	if (configuration.useTransportSecurity && configuration.cryptoThreadCount != 0) {
+		cryptoPool = std::make_unique<base::ThreadPool>(configuration.cryptoThreadCount,
+														 configuration.cryptoQueueCapacity);
+		if (!cryptoPool->Start()) {
+			Logger::Warning("HTTPServer::RunWorkers", "Failed to start the crypto pool, handshakes run on the workers");
+			cryptoPool.reset();
+		}
+	}
+
+	// The first worker runs on the internal thread of the server.
+	std::vector<std::thread> threads;
+	threads.reserve(workers.size() - 1);
+	for (std::size_t i = 1; i < workers.size(); i++) {
+		threads.emplace_back(&Worker::Run, workers[i].get());
+	}
+
+	workers.front()->Run();
+
+	for (auto &thread : threads) {
+		thread.join();
+	}
 
+	// The workers no longer run, so the results of the tasks are discarded.
+	if (cryptoPool != nullptr) {
+		cryptoPool->Stop();
+	}
+}
 
-	// Detach the thread so we can remove the client.
-	thread.detach();
+void
+Server::SteerConnections() noexcept {
+	if (topology.nodes.empty() || internalSockets.size() < 2) {
+		return;
+	}
 
-	const auto id = thread.get_id();
-	auto iterator = std::find_if(std::begin(clients), std::end(clients),
-		[id](const auto &client) {
-			return client->thread.get_id() == id;
+#ifdef MAGIC_STEER_CONNECTIONS
+	// The listening sockets are selected by their index in the group of the
+	// port, which is the order they were created in, i.e. the index of their
+	// worker. A CPU without a worker of its own is mapped to the workers of
+	// its node in turn.
+	const auto placements = topology.Place(internalSockets.size());
+	std::vector<struct sock_filter> program;
+	program.push_back(BPF_STMT(BPF_LD | BPF_W | BPF_ABS, static_cast<std::uint32_t>(SKF_AD_OFF + SKF_AD_CPU)));
+
+	for (std::size_t node = 0; node < topology.nodes.size(); node++) {
+		std::vector<std::uint32_t> nodeWorkers;
+		for (std::size_t i = 0; i < placements.size(); i++) {
+			if (placements[i].node == node) {
+				nodeWorkers.push_back(static_cast<std::uint32_t>(i));
+			}
+		}
+		if (nodeWorkers.empty()) {
+			continue;
 		}
-	);
 
-	if (iterator == std::end(clients)) {
-		// Shouldn't happen, but isn't catastrophic. Don't use std::terminate
-		// in production but return instead, since it isn't a breaking bug.
-		std::terminate();
+		std::size_t turn = 0;
+		for (const int cpu : topology.nodes[node]) {
+			const auto pinned = std::find_if(std::cbegin(placements), std::cend(placements),
+											 [cpu](const auto &placement) { return placement.cpu == cpu; });
+			const auto worker = pinned != std::cend(placements)
+				? static_cast<std::uint32_t>(std::distance(std::cbegin(placements), pinned))
+				: nodeWorkers[turn++ % nodeWorkers.size()];
+
+			program.push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, static_cast<std::uint32_t>(cpu), 0, 1));
+			program.push_back(BPF_STMT(BPF_RET | BPF_K, worker));
+		}
+	}
+
+	// An index out of range has the kernel select a socket by the hash of
+	// the connection, as it does without a program.
+	program.push_back(BPF_STMT(BPF_RET | BPF_K, 0xffffffff));
+
+	if (program.size() > BPF_MAXINSNS) {
+		Logger::Warning("HTTPServer::SteerConnections", "Too many CPUs to steer the connections by node");
+		return;
+	}
+
+	struct sock_fprog filter{};
+	filter.len = static_cast<unsigned short>(program.size());
+	filter.filter = program.data();
+	if (setsockopt(internalSockets.front(), SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &filter, sizeof(filter)) == -1) {
+		Logger::Warning("HTTPServer::SteerConnections", "Failed to steer the connections by node");
+	}
+#else
+	Logger::Warning("HTTPServer::SteerConnections", "Steering connections by node isn't supported on this platform");
+#endif
+}
+
+void
+Server::WarmFileCache() noexcept {
+	const auto limit = configuration.fileCacheCapacity;
+	if (limit == 0) {
+		return;
+	}
+
+	WarmTargets targets;
+	try {
+		IO::FileCacheManifest manifest;
+		if (!configuration.fileCacheManifest.empty() && manifest.Load(configuration.fileCacheManifest)) {
+			for (std::size_t i = 0; i < manifest.Size() && targets.size() < limit; i++) {
+				// The key is prefixed by the root directory of its site, which
+				// might be beneath the root directory of another.
+				const auto key = manifest[i];
+				const Site *site = nullptr;
+				for (const auto &candidate : sites) {
+					const auto &root = candidate->rootDirectory;
+					if (key.length() > root.length() && key[root.length()] == '/' &&
+						key.compare(0, root.length(), root) == 0 &&
+						(site == nullptr || root.length() > site->rootDirectory.length())) {
+						site = candidate.get();
+					}
+				}
+
+				if (site != nullptr) {
+					targets.emplace_back(site, std::string(key.substr(site->rootDirectory.length())));
+				}
+			}
+		} else {
+			for (const auto &site : sites) {
+				const int handle = open(site->rootDirectory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+				if (handle != -1) {
+					std::string path;
+					CollectFiles(*site, handle, path, MAGIC_FILE_CACHE_WARM_MAX_DEPTH, limit, targets);
+				}
+			}
+		}
+	} catch (const std::bad_alloc &) {
+		Logger::Warning("HTTPServer::WarmFileCache", "Failed to allocate the files to warm");
+		return;
+	}
+
+	// Opening and reading the files is mostly waiting for the file system, so
+	// the files are resolved in parallel. With a partition per node, each is
+	// filled by threads pinned to its node, except for the calling thread.
+	const auto nodeCount = fileCache.NodeCount();
+	std::vector<std::atomic<std::size_t>> next(nodeCount);
+	std::atomic<std::size_t> warmed{ 0 };
+	const auto warm = [&](std::size_t thread) {
+		const auto node = thread % nodeCount;
+		if (nodeCount > 1) {
+			if (thread != 0 && node < topology.nodes.size()) {
+				static_cast<void>(base::PinThread(topology.nodes[node]));
+			}
+			base::SetCurrentNumaNode(node);
+		}
+
+		Request request;
+		std::string key;
+		for (auto i = next[node]++; i < targets.size(); i = next[node]++) {
+			const auto &[site, path] = targets[i];
+			key.assign(site->rootDirectory).append(path);
+			request.path = path;
+
+			IO::FileResolveStatus status = IO::FileResolveStatus::OK;
+			if ((fileCache.Lookup(key) != nullptr || CacheFile(*site, key, request, status) != nullptr) &&
+				node == 0) {
+				warmed.fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+	};
+
+	std::vector<std::thread> threads;
+	const auto threadCount = std::max<std::size_t>(
+		std::min<std::size_t>(std::thread::hardware_concurrency(), targets.size()), nodeCount);
+	try {
+		while (threads.size() + 1 < threadCount) {
+			threads.emplace_back(warm, threads.size() + 1);
+		}
+	} catch (const std::exception &) {
+		// The files are warmed by the threads that did start.
+	}
+
+	warm(0);
+	for (auto &thread : threads) {
+		thread.join();
 	}
 
-	clients.erase(iterator);
+	Logger::Log("HTTPServer::WarmFileCache", "Warmed " + std::to_string(warmed.load()) + " of " +
+												 std::to_string(targets.size()) + " files");
 }
 
 } // namespace HTTP
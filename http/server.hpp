@@ -6,26 +6,105 @@
  * See the COPYING file for licensing information.
  */
 
+#include <array>
+#include <atomic>
 #include <functional>
 #include <memory>
-#include <mutex>
+#include <string>
+#include <string_view>
 #include <thread>
+#include <utility>
 #include <vector>
 
+#include "base/numa.hpp"
+#include "base/thread_pool.hpp"
 #include "cgi/manager.hpp"
 #include "http/client.hpp" // IWYU pragma: keep
+#include "http/admission_control.hpp"
+#include "http/client_error.hpp"
+#include "http/client_pool.hpp"
 #include "http/configuration.hpp"
 #include "http/server_launch_error.hpp"
+#include "http/worker.hpp"
+#include "http2/hpack.hpp"
+#include "io/compression_cache.hpp"
+#include "io/directory_index.hpp"
+#include "io/file_cache.hpp"
 #include "io/file_resolver.hpp"
+#include "security/address_limiter.hpp"
 
 namespace HTTP {
 
+// A site served by the server, i.e. the site of the hostname of the
+// configuration, or a virtual host.
+struct Site {
+	inline Site(std::string hostname, const std::string &rootDirectory, std::size_t listingCapacity) noexcept :
+		hostname(std::move(hostname)), rootDirectory(rootDirectory), resolver(rootDirectory),
+		listings(listingCapacity) {
+	}
+
+	// The hostname used in redirects.
+	std::string hostname;
+
+	// Prefixes the keys of the files of the site in the file cache, which
+	// might be shared with other servers and sites.
+	std::string rootDirectory;
+
+	IO::FileResolver resolver;
+
+	// See Configuration::autoIndex. The listings are generated on demand.
+	mutable IO::DirectoryIndex listings;
+};
+
+// A response to an error of the client with a fixed status line and body,
+// serialized once per server with the static headers, so the floods of bad
+// requests scanners send are answered with a single write each. See
+// Server::FindErrorResponse.
+struct ErrorResponse {
+	// Set for the errors with a fixed response only.
+	const MediaType *mediaType{ nullptr };
+	std::string_view statusLine;
+
+	// The complete responses, indexed by whether the connection persists,
+	// i.e. with "Connection: close" and "Connection: keep-alive". The head of
+	// each is the first 'headLengths' octets, followed by the body.
+	std::array<std::string, 2> responses;
+	std::array<std::size_t, 2> headLengths{};
+
+	// Whether the connection is closed after the response regardless of the
+	// request, e.g. since the request is malformed.
+	bool closesConnection{ false };
+
+	// Whether the body is compressed for the clients that accept it, see
+	// Client::ServeStringRequest. The responses are for the other clients.
+	bool compressible{ false };
+
+	[[nodiscard]] inline std::string_view
+	Body() const noexcept {
+		return std::string_view(responses[0]).substr(headLengths[0]);
+	}
+};
+
 class Server {
 public:
 	inline Server(const Configuration &configuration, const CGI::Manager &manager) :
-		fileResolver(configuration.rootDirectory), configuration(configuration),
+		topology(configuration.numaLocalWorkers ? base::NumaTopology::Detect() : base::NumaTopology{}),
+		ownFileCache(configuration.sharedFileCache != nullptr ? nullptr :
+					 std::make_unique<IO::FileCache>(configuration.fileCacheCapacity,
+													 configuration.fileCacheMaxContentSize,
+													 configuration.fileCacheMaxMappedSize,
+													 topology.nodes.size())),
+		ownCompressionCache(configuration.sharedCompressionCache != nullptr ? nullptr :
+							std::make_unique<IO::CompressionCache>(configuration.compressionCacheCapacity)),
+		fileCache(configuration.sharedFileCache != nullptr ? *configuration.sharedFileCache : *ownFileCache),
+		compressionCache(configuration.sharedCompressionCache != nullptr ? *configuration.sharedCompressionCache
+																		 : *ownCompressionCache),
+		configuration(configuration),
 		manager(manager) {
 		CheckConfiguration();
+		SerializeStaticHeaders();
+		SerializeErrorResponses();
+		CreateSites();
 	}
 
 	~Server() noexcept;
@@ -44,14 +123,44 @@ public:
 		}
 	}
 
-	void
-	SignalClientDeath(std::thread) noexcept;
+	// Counts the connection accepted from [address] for the connection limits
+	// of the security policies, see Security::AddressLimiter. If it is
+	// refused, the connection should be closed right away.
+	//
+	// Returns whether the connection is admitted
+	[[nodiscard]] bool
+	AdmitConnection(const struct sockaddr_storage &address, Security::AddressLease &lease) noexcept;
+
+	[[nodiscard]] inline bool
+	IsShutdownSignaled() const noexcept {
+		return shutdownSignaled;
+	}
 
 	inline void
 	SignalShutdown() noexcept {
 		shutdownSignaled = true;
 	}
 
+	[[nodiscard]] inline bool
+	IsDraining() const noexcept {
+		return draining.load(std::memory_order_relaxed);
+	}
+
+	// Stops accepting connections, e.g. because another process took over
+	// the listening sockets. The connections are closed once their current
+	// exchange is done, or right away if they're idle, and the server stops
+	// once they are all closed, or Configuration::drainTimeout has passed.
+	inline void
+	SignalDrain() noexcept {
+		draining.store(true, std::memory_order_relaxed);
+	}
+
+	// The sockets the server listens on, created by Initialize.
+	[[nodiscard]] inline const std::vector<int> &
+	ListeningSockets() const noexcept {
+		return internalSockets;
+	}
+
 	[[nodiscard]] inline constexpr const Configuration &
 	config() const noexcept {
 		return configuration;
@@ -62,7 +171,81 @@ public:
 		return manager;
 	}
 
-	IO::FileResolver fileResolver;
+	// The pool the TLS handshakes are offloaded to, or nullptr if they
+	// should be performed by the workers.
+	[[nodiscard]] inline base::ThreadPool *
+	CryptoPool() const noexcept {
+		return cryptoPool.get();
+	}
+
+	// The header fields that are the same for every response, e.g. Server
+	// and the security headers, each preceded by a CRLF.
+	[[nodiscard]] inline const std::string &
+	StaticHeaders() const noexcept {
+		return staticHeaders;
+	}
+
+	// The static headers encoded for HTTP/2 responses.
+	[[nodiscard]] inline const HTTP2::HPACK::RepeatedFields &
+	StaticFields() const noexcept {
+		return staticFields;
+	}
+
+	// Returns the response to [error], or nullptr if it isn't fixed.
+	[[nodiscard]] inline const ErrorResponse *
+	FindErrorResponse(ClientError error) const noexcept {
+		const auto &response = errorResponses[static_cast<std::size_t>(error)];
+		return response.mediaType == nullptr ? nullptr : &response;
+	}
+
+	// The head of the redirects to HTTPS of Configuration::upgradeToHTTPS, up
+	// to the value of the Location header field. It is followed by the
+	// hostname and the path of the request, and two CRLFs.
+	[[nodiscard]] inline const std::string &
+	UpgradeResponseHead() const noexcept {
+		return upgradeResponseHead;
+	}
+
+	// Returns the site of the Host header field of [request], i.e. the
+	// virtual host with that hostname, or the site of the hostname of the
+	// configuration.
+	[[nodiscard]] const Site &
+	FindSite(const Request &request) const noexcept;
+
+	// Returns the virtual host of which [host] is a hostname, compared
+	// case-insensitively, or nullptr if there isn't one.
+	[[nodiscard]] const Site *
+	FindVirtualHost(std::string_view host) const noexcept;
+
+	// Returns the file [request] refers to from the file cache, or resolves
+	// and caches it. Returns nullptr if the file can't be served, in which
+	// case [status] is the reason. For a directory without an index, the
+	// status is NOT_FOUND and [listing] is set to its listing if listings are
+	// enabled, see Configuration::autoIndex.
+	[[nodiscard]] std::shared_ptr<const IO::CachedFile>
+	ResolveFile(const Request &request, IO::FileResolveStatus &status,
+				std::shared_ptr<const std::string> *listing = nullptr) noexcept;
+
+	// Saves the keys of the file cache to Configuration::fileCacheManifest,
+	// if set.
+	//
+	// Returns success status
+	[[nodiscard]] bool
+	SaveFileCacheManifest() noexcept;
+
+private:
+	// The NUMA nodes the workers are grouped by, see
+	// Configuration::numaLocalWorkers. Empty when they aren't.
+	const base::NumaTopology topology;
+
+	// The caches used when the configuration has no shared ones. Declared
+	// before the references to the caches in use.
+	std::unique_ptr<IO::FileCache> ownFileCache;
+	std::unique_ptr<IO::CompressionCache> ownCompressionCache;
+
+public:
+	IO::FileCache &fileCache;
+	IO::CompressionCache &compressionCache;
 #ifdef TESTING
 
 public:
@@ -74,45 +257,130 @@ private:
 	Configuration configuration;
 	const CGI::Manager &manager;
 	std::unique_ptr<std::thread> internalThread{ nullptr };
-	int internalSocket{ -1 };
+
+	// The listening sockets. In the ServingMode::EVENT_DRIVEN serving mode,
+	// each worker has one of its own, otherwise only the first is used.
+	std::vector<int> internalSockets;
 
 	std::vector<std::function<void(Server *)>> cleanFunctions;
 
-	std::mutex clientsMutex;
-	std::vector<std::unique_ptr<Client>> clients;
+	// Limits the connections per address, or nullptr if the policies don't.
+	// Declared before the clients, which hold leases of it.
+	std::unique_ptr<Security::AddressLimiter> addressLimiter;
+
+	// Used by the ServingMode::THREAD_PER_CLIENT serving mode, the workers
+	// have one of their own.
+	AdmissionController admission{ configuration, 1 };
+
+	// Used by the ServingMode::THREAD_PER_CLIENT serving mode, created by
+	// Initialize.
+	std::unique_ptr<ClientPool> clientPool;
+
+	// Used by the ServingMode::EVENT_DRIVEN serving mode.
+	std::vector<std::unique_ptr<Worker>> workers;
+
+	// See CryptoPool. Declared after 'workers', so the tasks are done before
+	// the clients are destroyed.
+	std::unique_ptr<base::ThreadPool> cryptoPool;
+
+	std::atomic<bool> shutdownSignaled{ false };
+
+	// See SignalDrain
+	std::atomic<bool> draining{ false };
+
+	// See StaticHeaders
+	std::string staticHeaders;
+
+	// See StaticFields
+	HTTP2::HPACK::RepeatedFields staticFields;
+
+	// See FindErrorResponse
+	std::array<ErrorResponse, clientErrorCount> errorResponses;
+
+	// See UpgradeResponseHead
+	std::string upgradeResponseHead;
+
+	// The first site is the one of the hostname of the configuration. See
+	// FindSite.
+	std::vector<std::unique_ptr<Site>> sites;
 
-	bool shutdownSignaled{ false };
+	// The lowercase hostnames of the virtual hosts, sorted.
+	std::vector<std::pair<std::string, const Site *>> siteNames;
 
 	void
 	AcceptClient();
 
+	// Returns the amount of workers, and thus listening sockets, to use.
+	[[nodiscard]] std::size_t
+	CalculateWorkerCount() const noexcept;
+
+	// Resolves the file of [request] on [site] and stores it in the file
+	// cache under [key]. See ResolveFile.
+	[[nodiscard]] std::shared_ptr<const IO::CachedFile>
+	CacheFile(const Site &site, std::string_view key, const Request &request, IO::FileResolveStatus &status,
+			  std::shared_ptr<const std::string> *listing = nullptr) noexcept;
+
 	void
 	CheckConfiguration() const;
 
 	void
-	CloseSocket() noexcept;
+	CloseSockets() noexcept;
 
 	[[nodiscard]] ServerLaunchError
-	ConfigureSocketBind() noexcept;
+	ConfigureSocketBind(int &socket) noexcept;
 
 	[[nodiscard]] ServerLaunchError
-	ConfigureSocketListen() noexcept;
+	ConfigureSocketListen(int &socket) noexcept;
 
 	[[nodiscard]] ServerLaunchError
-	ConfigureSocketSetReusable() noexcept;
+	ConfigureSocketSetReusable(int &socket) noexcept;
 
 	[[nodiscard]] bool
 	CreateServer() noexcept;
 
+	// Creates the sites from the configuration, called once on construction.
+	void
+	CreateSites();
+
 	[[nodiscard]] ServerLaunchError
-	CreateSocket() noexcept;
+	CreateSocket(int &socket) noexcept;
 
 	void
 	HandlePollFailure();
 
+	// Waits until the clients of the ServingMode::THREAD_PER_CLIENT serving
+	// mode have finished, see SignalDrain.
+	void
+	DrainClients() noexcept;
+
 	void
 	InternalStart();
 
+	// The InternalStart of the ServingMode::EVENT_DRIVEN serving mode. Runs
+	// the workers, each on a thread of its own.
+	void
+	RunWorkers();
+
+	// Serializes the responses of FindErrorResponse and UpgradeResponseHead
+	// with the static headers, called once on construction.
+	void
+	SerializeErrorResponses();
+
+	// Serializes the static headers from the configuration, called once on
+	// construction.
+	void
+	SerializeStaticHeaders();
+
+	// Has the kernel hand the connections to a listening socket of a worker
+	// on the node of the CPU that received them, see
+	// Configuration::numaLocalWorkers.
+	void
+	SteerConnections() noexcept;
+
+	// Fills the file cache in parallel, see Configuration::prewarmFileCache.
+	void
+	WarmFileCache() noexcept;
+
 };
 
 } // namespace HTTP
@@ -6,6 +6,8 @@
  * See the COPYING file for licensing information.
  */
 
+#include <string_view>
+
 #include <cstdint>
 
 namespace HTTP::Utils {
@@ -30,6 +32,47 @@ namespace HTTP::Utils {
 		return character >= '0' && character <= '9';
 	}
 
+	// Compares two strings of USASCII characters, ignoring the case of
+	// letters. Used for case-insensitive tokens like header field-names.
+	[[nodiscard]] inline constexpr bool
+	EqualsIgnoreCase(std::string_view a, std::string_view b) noexcept {
+		if (a.length() != b.length()) {
+			return false;
+		}
+
+		for (std::size_t i = 0; i < a.length(); i++) {
+			if ((a[i] | 0x20) != (b[i] | 0x20)) {
+				return false;
+			}
+
+			// '|' 0x20 maps some non-letters to each other, e.g. '@' and '`'.
+			const char lower = static_cast<char>(a[i] | 0x20);
+			if (a[i] != b[i] && (lower < 'a' || lower > 'z')) {
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	// Lowercases the USASCII letters, leaving other characters as they are.
+	[[nodiscard]] inline constexpr char
+	ToLower(char character) noexcept {
+		return (character >= 'A' && character <= 'Z') ? static_cast<char>(character | 0x20) : character;
+	}
+
+	// The characters of a header field-value, excluding obs-fold: VCHAR,
+	// obs-text, SP and HTAB.
+	//
+	// Reference:
+	// https://svn.tools.ietf.org/svn/wg/httpbis/specs/rfc7230.html#header.fields
+	[[nodiscard]] inline constexpr bool
+	IsFieldValueCharacter(char character) noexcept {
+		return (character >= 0x21 && character <= 0x7E) || // VCHAR
+			   IsNonUSASCIICharacter(character) ||           // obs-text
+			   character == ' ' || character == '\t';       // SP / HTAB
+	}
+
 	// Some inputs are specified as 'token' definitions. This function makes
 	// sure the characters follow the standard.
 	//
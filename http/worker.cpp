@@ -0,0 +1,228 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include "http/worker.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <utility>
+
+#include <cerrno>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/socket.h>
+
+#ifdef __FreeBSD__
+#include <pthread_np.h>
+#include <sys/cpuset.h>
+#endif
+
+#include "base/logger.hpp"
+#include "base/numa.hpp"
+#include "event/clock.hpp"
+#include "http/configuration.hpp"
+#include "http/metrics.hpp"
+#include "http/server.hpp"
+#include "posix/unistd.hpp"
+
+// The maximum amount of clients accepted per readiness event of the listening
+// socket, so a connection storm doesn't starve the accepted clients.
+#define MAGIC_ACCEPT_BATCH_SIZE 64
+
+// The maximum amount of released clients a worker keeps for reuse.
+#define MAGIC_CLIENT_POOL_SIZE 64
+
+// The resolution of the timeouts of the clients, in milliseconds. The event
+// loop wakes up this often while any timeout is scheduled.
+#define MAGIC_TIMER_RESOLUTION 100
+
+namespace HTTP {
+
+Worker::Worker(Server *server, int listeningSocket, std::size_t workerCount, int core, std::size_t node)
+	: server(server), listeningSocket(listeningSocket), core(core), node(node),
+	  timers(std::chrono::milliseconds(MAGIC_TIMER_RESOLUTION)),
+	  admission(server->config(), workerCount) {
+}
+
+void
+Worker::AcceptClients() noexcept {
+	auto *metrics = server->config().metrics;
+	for (std::size_t i = 0; i < MAGIC_ACCEPT_BATCH_SIZE; i++) {
+		const auto acceptStart = metrics == nullptr ? std::chrono::steady_clock::time_point{} : std::chrono::steady_clock::now();
+		struct sockaddr_storage address{};
+		socklen_t addressLength = sizeof(address);
+		int socket = accept(listeningSocket, reinterpret_cast<struct sockaddr *>(&address), &addressLength);
+
+		if (socket == -1) {
+			if ((errno == EMFILE || errno == ENFILE) && admission.ShedWithReserve(listeningSocket)) {
+				continue;
+			}
+			if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+				Logger::Warning("HTTPWorker::AcceptClients", "Accept() failed!");
+			}
+			return;
+		}
+
+		// A refused connection is closed before a client is taken for it.
+		Security::AddressLease lease;
+		if (!server->AdmitConnection(address, lease)) {
+			psx::close(socket);
+			continue;
+		}
+
+		ShedReason reason;
+		if (admission.ShouldShed(socket, clients.Size(), loopLag, reason)) {
+			admission.Shed(socket, reason);
+			continue;
+		}
+
+		std::unique_ptr<Client> client;
+		if (idleClients.empty()) {
+			client = std::make_unique<Client>(server, this, socket, std::move(lease));
+		} else {
+			client = std::move(idleClients.back());
+			idleClients.pop_back();
+			client->Reuse(socket, std::move(lease));
+		}
+
+		if (!client->RegisterEventHandler()) {
+			Logger::Warning("HTTPWorker::AcceptClients", "Failed to register client");
+			continue;
+		}
+
+		auto *pointer = client.get();
+		pointer->handle = clients.Insert(std::move(client));
+
+		if (metrics != nullptr) {
+			metrics->Record(Stage::ACCEPT, std::chrono::steady_clock::now() - acceptStart);
+		}
+	}
+}
+
+void
+Worker::Drain() noexcept {
+	// Another process might accept from the listening socket now.
+	loop.Remove(listeningSocket);
+
+	clients.ForEach([](Client &client) {
+		client.Drain();
+	});
+	DestroyRemovedClients();
+}
+
+void
+Worker::DestroyRemovedClients() noexcept {
+	for (const auto handle : removedClients) {
+		auto client = clients.Take(handle);
+		if (client == nullptr || idleClients.size() == MAGIC_CLIENT_POOL_SIZE) {
+			continue;
+		}
+
+		client->Release();
+		idleClients.push_back(std::move(client));
+	}
+
+	removedClients.clear();
+}
+
+bool
+Worker::Initialize() noexcept {
+	int flags = fcntl(listeningSocket, F_GETFL);
+	if (flags == -1 || fcntl(listeningSocket, F_SETFL, flags | O_NONBLOCK) == -1) {
+		return false;
+	}
+
+	return admission.Initialize() &&
+		   loop.Initialize() &&
+		   loop.Add(listeningSocket, this, Event::Interest::read);
+}
+
+void
+Worker::OnEvent(std::uint32_t) noexcept {
+	AcceptClients();
+}
+
+void
+Worker::PinToCore() noexcept {
+	if (core == -1) {
+		return;
+	}
+
+#if defined(__linux__) || defined(__FreeBSD__)
+#ifdef __FreeBSD__
+	cpuset_t set;
+#else
+	cpu_set_t set;
+#endif
+	CPU_ZERO(&set);
+	CPU_SET(core, &set);
+
+	if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+		Logger::Warning("HTTPWorker::PinToCore", "Failed to pin worker to core " + std::to_string(core));
+	}
+#else
+	Logger::Warning("HTTPWorker::PinToCore", "Pinning workers to cores isn't supported on this platform");
+#endif
+}
+
+void
+Worker::RemoveClient(Client *client) noexcept {
+	removedClients.push_back(client->handle);
+}
+
+void
+Worker::Run() {
+	// The clients are allocated by this thread once it is pinned, so their
+	// memory is on the node of the worker.
+	PinToCore();
+	base::SetCurrentNumaNode(node);
+
+	bool draining = false;
+	auto drainDeadline = std::chrono::steady_clock::time_point::max();
+
+	while (!server->IsShutdownSignaled()) {
+		if (!draining && server->IsDraining()) {
+			draining = true;
+			if (const auto timeout = server->config().drainTimeout; timeout != 0) {
+				drainDeadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+			}
+			Drain();
+		}
+
+		if (draining) {
+			if (clients.Size() == 0) {
+				break;
+			}
+			if (std::chrono::steady_clock::now() >= drainDeadline) {
+				Logger::Warning("HTTPWorker::Run", "Not all clients finished in time");
+				break;
+			}
+		}
+
+		int timeout = server->config().pollAcceptTimeout;
+		if (!timers.IsEmpty()) {
+			timeout = std::min(timeout, static_cast<int>(timers.Resolution().count()));
+		}
+
+		if (!loop.RunOnce(timeout)) {
+			Logger::Severe("HTTPWorker::Run", "Invalid state: event loop failure");
+			return;
+		}
+
+		// With a weight of 1/8 for the last batch.
+		loopLag += (loop.DispatchDuration() - loopLag) / 8;
+
+		timers.Advance(Event::Clock::Now());
+		DestroyRemovedClients();
+	}
+
+	if (!draining) {
+		loop.Remove(listeningSocket);
+	}
+}
+
+} // namespace HTTP
@@ -0,0 +1,119 @@
+#pragma once
+
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include <cstdint>
+
+#include "base/slot_map.hpp"
+#include "event/loop.hpp"
+#include "event/timer_wheel.hpp"
+#include "http/admission_control.hpp"
+#include "http/client.hpp"
+#include "http/compressor.hpp"
+
+namespace HTTP {
+
+	// Forward-decl from server.hpp
+	class Server;
+
+} // namespace HTTP
+
+namespace HTTP {
+
+// A worker is used by the ServingMode::EVENT_DRIVEN serving mode. It runs an
+// event loop, on which the listening socket and the connections accepted from
+// it are multiplexed. The clients of a worker are only touched by the thread
+// running the worker, so no locking is needed.
+class Worker : public Event::Handler {
+public:
+	// When [core] isn't -1, the thread running the worker is pinned to that
+	// CPU core, which is on NUMA node [node]. The server has [workerCount]
+	// workers, which share the connection limit of the configuration.
+	Worker(Server *server, int listeningSocket, std::size_t workerCount, int core = -1, std::size_t node = 0);
+
+	[[nodiscard]] bool
+	Initialize() noexcept;
+
+	[[nodiscard]] inline Event::Loop &
+	EventLoop() noexcept {
+		return loop;
+	}
+
+	// The compressors of the clients of this worker.
+	[[nodiscard]] inline CompressorPool &
+	Compressors() noexcept {
+		return compressors;
+	}
+
+	// The timeouts of the clients of this worker.
+	[[nodiscard]] inline Event::TimerWheel &
+	Timers() noexcept {
+		return timers;
+	}
+
+	// The listening socket is ready, i.e. clients can be accepted.
+	void
+	OnEvent(std::uint32_t events) noexcept override;
+
+	// Called by a client when its connection has been closed. The client is
+	// destroyed after the current batch of events has been dispatched, since
+	// it might still be on the stack.
+	void
+	RemoveClient(Client *) noexcept;
+
+	// Runs the event loop until the server is signaled to shut down, or has
+	// drained, see Server::SignalDrain. This function is ran by the thread of
+	// the worker.
+	void
+	Run();
+
+private:
+	Server *server;
+	const int listeningSocket;
+	const int core;
+	const std::size_t node;
+	Event::Loop loop;
+	CompressorPool compressors;
+
+	// Declared before the clients, whose timers are cancelled when they're
+	// destroyed.
+	Event::TimerWheel timers;
+
+	base::SlotMap<Client> clients;
+	std::vector<base::SlotHandle> removedClients;
+
+	// Clients whose connection has been closed, which are reused for newly
+	// accepted connections, see Client::Release.
+	std::vector<std::unique_ptr<Client>> idleClients;
+
+	AdmissionController admission;
+
+	// The moving average of the time the event loop takes to dispatch a batch
+	// of events, see Configuration::maxEventLoopLag.
+	std::chrono::steady_clock::duration loopLag{};
+
+	void
+	AcceptClients() noexcept;
+
+	void
+	DestroyRemovedClients() noexcept;
+
+	// Stops accepting clients, and has the clients close their connections,
+	// see Client::Drain.
+	void
+	Drain() noexcept;
+
+	// Pins the calling thread to the core of this worker.
+	void
+	PinToCore() noexcept;
+};
+
+} // namespace HTTP
@@ -0,0 +1,148 @@
+#pragma once
+
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+/**
+ * The framing layer of HTTP/2.
+ *
+ * Spec: RFC 7540 § 4 and § 6
+ */
+
+#include <array>
+#include <string_view>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace HTTP2 {
+
+// The octets a client starts a connection with, before its SETTINGS frame.
+//
+// Spec: RFC 7540 § 3.5
+constexpr std::string_view connectionPreface("PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n");
+
+// The length of the header of every frame.
+constexpr std::size_t frameHeaderSize = 9;
+
+// The initial value of SETTINGS_MAX_FRAME_SIZE, which this server doesn't
+// raise, so frames it receives are at most this large.
+constexpr std::size_t defaultMaxFrameSize = 16384;
+
+// The initial size of the flow-control windows, of the connection and of
+// every stream.
+//
+// Spec: RFC 7540 § 6.9.2
+constexpr std::int64_t defaultWindowSize = 65535;
+
+// The largest size a flow-control window can have.
+constexpr std::int64_t maxWindowSize = 0x7FFFFFFF;
+
+enum class FrameType : std::uint8_t {
+	DATA = 0x0,
+	HEADERS = 0x1,
+	PRIORITY = 0x2,
+	RST_STREAM = 0x3,
+	SETTINGS = 0x4,
+	PUSH_PROMISE = 0x5,
+	PING = 0x6,
+	GOAWAY = 0x7,
+	WINDOW_UPDATE = 0x8,
+	CONTINUATION = 0x9,
+};
+
+namespace Flags {
+	constexpr std::uint8_t ACK = 0x1;
+	constexpr std::uint8_t END_STREAM = 0x1;
+	constexpr std::uint8_t END_HEADERS = 0x4;
+	constexpr std::uint8_t PADDED = 0x8;
+	constexpr std::uint8_t PRIORITY = 0x20;
+} // namespace Flags
+
+// Spec: RFC 7540 § 7
+enum class ErrorCode : std::uint32_t {
+	NO_ERROR = 0x0,
+	PROTOCOL_ERROR = 0x1,
+	INTERNAL_ERROR = 0x2,
+	FLOW_CONTROL_ERROR = 0x3,
+	SETTINGS_TIMEOUT = 0x4,
+	STREAM_CLOSED = 0x5,
+	FRAME_SIZE_ERROR = 0x6,
+	REFUSED_STREAM = 0x7,
+	CANCEL = 0x8,
+	COMPRESSION_ERROR = 0x9,
+	CONNECT_ERROR = 0xa,
+	ENHANCE_YOUR_CALM = 0xb,
+	INADEQUATE_SECURITY = 0xc,
+	HTTP_1_1_REQUIRED = 0xd,
+};
+
+// Spec: RFC 7540 § 6.5.2
+enum class SettingID : std::uint16_t {
+	HEADER_TABLE_SIZE = 0x1,
+	ENABLE_PUSH = 0x2,
+	MAX_CONCURRENT_STREAMS = 0x3,
+	INITIAL_WINDOW_SIZE = 0x4,
+	MAX_FRAME_SIZE = 0x5,
+	MAX_HEADER_LIST_SIZE = 0x6,
+};
+
+struct FrameHeader {
+	std::size_t length;
+	FrameType type;
+	std::uint8_t flags;
+	std::uint32_t streamID;
+};
+
+// Reads a 32-bit integer in network byte order, without the reserved bit,
+// i.e. a stream identifier or a window size increment.
+[[nodiscard]] inline constexpr std::uint32_t
+ReadUInt31(const char *data) noexcept {
+	return ((static_cast<std::uint32_t>(static_cast<unsigned char>(data[0])) & 0x7F) << 24) |
+		   (static_cast<std::uint32_t>(static_cast<unsigned char>(data[1])) << 16) |
+		   (static_cast<std::uint32_t>(static_cast<unsigned char>(data[2])) << 8) |
+		   static_cast<std::uint32_t>(static_cast<unsigned char>(data[3]));
+}
+
+[[nodiscard]] inline constexpr std::uint32_t
+ReadUInt32(const char *data) noexcept {
+	return (static_cast<std::uint32_t>(static_cast<unsigned char>(data[0])) << 24) |
+		   ReadUInt31(data);
+}
+
+inline void
+WriteUInt32(char *output, std::uint32_t value) noexcept {
+	output[0] = static_cast<char>(value >> 24);
+	output[1] = static_cast<char>(value >> 16);
+	output[2] = static_cast<char>(value >> 8);
+	output[3] = static_cast<char>(value);
+}
+
+// Parses the frameHeaderSize octets of [data].
+[[nodiscard]] inline FrameHeader
+ParseFrameHeader(const char *data) noexcept {
+	return {
+		(static_cast<std::size_t>(static_cast<unsigned char>(data[0])) << 16) |
+			(static_cast<std::size_t>(static_cast<unsigned char>(data[1])) << 8) |
+			static_cast<std::size_t>(static_cast<unsigned char>(data[2])),
+		static_cast<FrameType>(data[3]),
+		static_cast<std::uint8_t>(data[4]),
+		ReadUInt31(data + 5)
+	};
+}
+
+// Writes the header of a frame into the frameHeaderSize octets of [output].
+inline void
+WriteFrameHeader(char *output, std::size_t length, FrameType type, std::uint8_t flags, std::uint32_t streamID) noexcept {
+	output[0] = static_cast<char>(length >> 16);
+	output[1] = static_cast<char>(length >> 8);
+	output[2] = static_cast<char>(length);
+	output[3] = static_cast<char>(type);
+	output[4] = static_cast<char>(flags);
+	WriteUInt32(output + 5, streamID);
+}
+
+} // namespace HTTP2
@@ -0,0 +1,522 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include "http2/hpack.hpp"
+
+#include <array>
+#include <utility>
+#include <vector>
+
+#include "http/utils.hpp"
+
+namespace HTTP2::HPACK {
+
+// Spec: RFC 7541 Appendix A
+static constexpr std::array<Field, 61> staticTable{{
+	{ ":authority", "" },
+	{ ":method", "GET" },
+	{ ":method", "POST" },
+	{ ":path", "/" },
+	{ ":path", "/index.html" },
+	{ ":scheme", "http" },
+	{ ":scheme", "https" },
+	{ ":status", "200" },
+	{ ":status", "204" },
+	{ ":status", "206" },
+	{ ":status", "304" },
+	{ ":status", "400" },
+	{ ":status", "404" },
+	{ ":status", "500" },
+	{ "accept-charset", "" },
+	{ "accept-encoding", "gzip, deflate" },
+	{ "accept-language", "" },
+	{ "accept-ranges", "" },
+	{ "accept", "" },
+	{ "access-control-allow-origin", "" },
+	{ "age", "" },
+	{ "allow", "" },
+	{ "authorization", "" },
+	{ "cache-control", "" },
+	{ "content-disposition", "" },
+	{ "content-encoding", "" },
+	{ "content-language", "" },
+	{ "content-length", "" },
+	{ "content-location", "" },
+	{ "content-range", "" },
+	{ "content-type", "" },
+	{ "cookie", "" },
+	{ "date", "" },
+	{ "etag", "" },
+	{ "expect", "" },
+	{ "expires", "" },
+	{ "from", "" },
+	{ "host", "" },
+	{ "if-match", "" },
+	{ "if-modified-since", "" },
+	{ "if-none-match", "" },
+	{ "if-range", "" },
+	{ "if-unmodified-since", "" },
+	{ "last-modified", "" },
+	{ "link", "" },
+	{ "location", "" },
+	{ "max-forwards", "" },
+	{ "proxy-authenticate", "" },
+	{ "proxy-authorization", "" },
+	{ "range", "" },
+	{ "referer", "" },
+	{ "refresh", "" },
+	{ "retry-after", "" },
+	{ "server", "" },
+	{ "set-cookie", "" },
+	{ "strict-transport-security", "" },
+	{ "transfer-encoding", "" },
+	{ "user-agent", "" },
+	{ "vary", "" },
+	{ "via", "" },
+	{ "www-authenticate", "" },
+}};
+
+struct HuffmanCode {
+	std::uint32_t code;
+	std::uint8_t length;
+};
+
+// Indexed by symbol, the last one being EOS.
+//
+// Spec: RFC 7541 Appendix B
+static constexpr std::array<HuffmanCode, 257> huffmanCodes{{
+	{ 0x1ff8, 13 }, { 0x7fffd8, 23 }, { 0xfffffe2, 28 }, { 0xfffffe3, 28 },
+	{ 0xfffffe4, 28 }, { 0xfffffe5, 28 }, { 0xfffffe6, 28 }, { 0xfffffe7, 28 },
+	{ 0xfffffe8, 28 }, { 0xffffea, 24 }, { 0x3ffffffc, 30 }, { 0xfffffe9, 28 },
+	{ 0xfffffea, 28 }, { 0x3ffffffd, 30 }, { 0xfffffeb, 28 }, { 0xfffffec, 28 },
+	{ 0xfffffed, 28 }, { 0xfffffee, 28 }, { 0xfffffef, 28 }, { 0xffffff0, 28 },
+	{ 0xffffff1, 28 }, { 0xffffff2, 28 }, { 0x3ffffffe, 30 }, { 0xffffff3, 28 },
+	{ 0xffffff4, 28 }, { 0xffffff5, 28 }, { 0xffffff6, 28 }, { 0xffffff7, 28 },
+	{ 0xffffff8, 28 }, { 0xffffff9, 28 }, { 0xffffffa, 28 }, { 0xffffffb, 28 },
+	{ 0x14, 6 }, { 0x3f8, 10 }, { 0x3f9, 10 }, { 0xffa, 12 },
+	{ 0x1ff9, 13 }, { 0x15, 6 }, { 0xf8, 8 }, { 0x7fa, 11 },
+	{ 0x3fa, 10 }, { 0x3fb, 10 }, { 0xf9, 8 }, { 0x7fb, 11 },
+	{ 0xfa, 8 }, { 0x16, 6 }, { 0x17, 6 }, { 0x18, 6 },
+	{ 0x0, 5 }, { 0x1, 5 }, { 0x2, 5 }, { 0x19, 6 },
+	{ 0x1a, 6 }, { 0x1b, 6 }, { 0x1c, 6 }, { 0x1d, 6 },
+	{ 0x1e, 6 }, { 0x1f, 6 }, { 0x5c, 7 }, { 0xfb, 8 },
+	{ 0x7ffc, 15 }, { 0x20, 6 }, { 0xffb, 12 }, { 0x3fc, 10 },
+	{ 0x1ffa, 13 }, { 0x21, 6 }, { 0x5d, 7 }, { 0x5e, 7 },
+	{ 0x5f, 7 }, { 0x60, 7 }, { 0x61, 7 }, { 0x62, 7 },
+	{ 0x63, 7 }, { 0x64, 7 }, { 0x65, 7 }, { 0x66, 7 },
+	{ 0x67, 7 }, { 0x68, 7 }, { 0x69, 7 }, { 0x6a, 7 },
+	{ 0x6b, 7 }, { 0x6c, 7 }, { 0x6d, 7 }, { 0x6e, 7 },
+	{ 0x6f, 7 }, { 0x70, 7 }, { 0x71, 7 }, { 0x72, 7 },
+	{ 0xfc, 8 }, { 0x73, 7 }, { 0xfd, 8 }, { 0x1ffb, 13 },
+	{ 0x7fff0, 19 }, { 0x1ffc, 13 }, { 0x3ffc, 14 }, { 0x22, 6 },
+	{ 0x7ffd, 15 }, { 0x3, 5 }, { 0x23, 6 }, { 0x4, 5 },
+	{ 0x24, 6 }, { 0x5, 5 }, { 0x25, 6 }, { 0x26, 6 },
+	{ 0x27, 6 }, { 0x6, 5 }, { 0x74, 7 }, { 0x75, 7 },
+	{ 0x28, 6 }, { 0x29, 6 }, { 0x2a, 6 }, { 0x7, 5 },
+	{ 0x2b, 6 }, { 0x76, 7 }, { 0x2c, 6 }, { 0x8, 5 },
+	{ 0x9, 5 }, { 0x2d, 6 }, { 0x77, 7 }, { 0x78, 7 },
+	{ 0x79, 7 }, { 0x7a, 7 }, { 0x7b, 7 }, { 0x7ffe, 15 },
+	{ 0x7fc, 11 }, { 0x3ffd, 14 }, { 0x1ffd, 13 }, { 0xffffffc, 28 },
+	{ 0xfffe6, 20 }, { 0x3fffd2, 22 }, { 0xfffe7, 20 }, { 0xfffe8, 20 },
+	{ 0x3fffd3, 22 }, { 0x3fffd4, 22 }, { 0x3fffd5, 22 }, { 0x7fffd9, 23 },
+	{ 0x3fffd6, 22 }, { 0x7fffda, 23 }, { 0x7fffdb, 23 }, { 0x7fffdc, 23 },
+	{ 0x7fffdd, 23 }, { 0x7fffde, 23 }, { 0xffffeb, 24 }, { 0x7fffdf, 23 },
+	{ 0xffffec, 24 }, { 0xffffed, 24 }, { 0x3fffd7, 22 }, { 0x7fffe0, 23 },
+	{ 0xffffee, 24 }, { 0x7fffe1, 23 }, { 0x7fffe2, 23 }, { 0x7fffe3, 23 },
+	{ 0x7fffe4, 23 }, { 0x1fffdc, 21 }, { 0x3fffd8, 22 }, { 0x7fffe5, 23 },
+	{ 0x3fffd9, 22 }, { 0x7fffe6, 23 }, { 0x7fffe7, 23 }, { 0xffffef, 24 },
+	{ 0x3fffda, 22 }, { 0x1fffdd, 21 }, { 0xfffe9, 20 }, { 0x3fffdb, 22 },
+	{ 0x3fffdc, 22 }, { 0x7fffe8, 23 }, { 0x7fffe9, 23 }, { 0x1fffde, 21 },
+	{ 0x7fffea, 23 }, { 0x3fffdd, 22 }, { 0x3fffde, 22 }, { 0xfffff0, 24 },
+	{ 0x1fffdf, 21 }, { 0x3fffdf, 22 }, { 0x7fffeb, 23 }, { 0x7fffec, 23 },
+	{ 0x1fffe0, 21 }, { 0x1fffe1, 21 }, { 0x3fffe0, 22 }, { 0x1fffe2, 21 },
+	{ 0x7fffed, 23 }, { 0x3fffe1, 22 }, { 0x7fffee, 23 }, { 0x7fffef, 23 },
+	{ 0xfffea, 20 }, { 0x3fffe2, 22 }, { 0x3fffe3, 22 }, { 0x3fffe4, 22 },
+	{ 0x7ffff0, 23 }, { 0x3fffe5, 22 }, { 0x3fffe6, 22 }, { 0x7ffff1, 23 },
+	{ 0x3ffffe0, 26 }, { 0x3ffffe1, 26 }, { 0xfffeb, 20 }, { 0x7fff1, 19 },
+	{ 0x3fffe7, 22 }, { 0x7ffff2, 23 }, { 0x3fffe8, 22 }, { 0x1ffffec, 25 },
+	{ 0x3ffffe2, 26 }, { 0x3ffffe3, 26 }, { 0x3ffffe4, 26 }, { 0x7ffffde, 27 },
+	{ 0x7ffffdf, 27 }, { 0x3ffffe5, 26 }, { 0xfffff1, 24 }, { 0x1ffffed, 25 },
+	{ 0x7fff2, 19 }, { 0x1fffe3, 21 }, { 0x3ffffe6, 26 }, { 0x7ffffe0, 27 },
+	{ 0x7ffffe1, 27 }, { 0x3ffffe7, 26 }, { 0x7ffffe2, 27 }, { 0xfffff2, 24 },
+	{ 0x1fffe4, 21 }, { 0x1fffe5, 21 }, { 0x3ffffe8, 26 }, { 0x3ffffe9, 26 },
+	{ 0xffffffd, 28 }, { 0x7ffffe3, 27 }, { 0x7ffffe4, 27 }, { 0x7ffffe5, 27 },
+	{ 0xfffec, 20 }, { 0xfffff3, 24 }, { 0xfffed, 20 }, { 0x1fffe6, 21 },
+	{ 0x3fffe9, 22 }, { 0x1fffe7, 21 }, { 0x1fffe8, 21 }, { 0x7ffff3, 23 },
+	{ 0x3fffea, 22 }, { 0x3fffeb, 22 }, { 0x1ffffee, 25 }, { 0x1ffffef, 25 },
+	{ 0xfffff4, 24 }, { 0xfffff5, 24 }, { 0x3ffffea, 26 }, { 0x7ffff4, 23 },
+	{ 0x3ffffeb, 26 }, { 0x7ffffe6, 27 }, { 0x3ffffec, 26 }, { 0x3ffffed, 26 },
+	{ 0x7ffffe7, 27 }, { 0x7ffffe8, 27 }, { 0x7ffffe9, 27 }, { 0x7ffffea, 27 },
+	{ 0x7ffffeb, 27 }, { 0xffffffe, 28 }, { 0x7ffffec, 27 }, { 0x7ffffed, 27 },
+	{ 0x7ffffee, 27 }, { 0x7ffffef, 27 }, { 0x7fffff0, 27 }, { 0x3ffffee, 26 },
+	{ 0x3fffffff, 30 },
+}};
+
+// The symbol of EOS, see huffmanCodes.
+static constexpr std::int16_t huffmanEOS = 256;
+
+// A node of the decoding tree holds the children for a 0 and a 1 bit. A
+// negative child is a leaf, of symbol -child - 1.
+using HuffmanNode = std::array<std::int16_t, 2>;
+
+[[nodiscard]] static const std::vector<HuffmanNode> &
+HuffmanTree() noexcept {
+	static const auto tree = [] {
+		std::vector<HuffmanNode> nodes(1);
+		for (std::size_t symbol = 0; symbol < huffmanCodes.size(); symbol++) {
+			const auto code = huffmanCodes[symbol].code;
+			std::size_t node = 0;
+
+			for (unsigned bit = huffmanCodes[symbol].length - 1; bit != 0; bit--) {
+				auto child = nodes[node][(code >> bit) & 1];
+				if (child == 0) {
+					child = static_cast<std::int16_t>(nodes.size());
+					nodes[node][(code >> bit) & 1] = child;
+					nodes.emplace_back();
+				}
+				node = static_cast<std::size_t>(child);
+			}
+
+			nodes[node][code & 1] = static_cast<std::int16_t>(-static_cast<std::int16_t>(symbol) - 1);
+		}
+		return nodes;
+	}();
+
+	return tree;
+}
+
+bool
+DecodeHuffman(std::string_view input, std::string &output) noexcept {
+	const auto &tree = HuffmanTree();
+	std::size_t node = 0;
+
+	// The bits since the last symbol, and whether they are all ones.
+	unsigned pending = 0;
+	bool ones = true;
+
+	for (const char character : input) {
+		for (int shift = 7; shift >= 0; shift--) {
+			const unsigned bit = (static_cast<unsigned char>(character) >> shift) & 1;
+			const auto child = tree[node][bit];
+
+			if (child >= 0) {
+				node = static_cast<std::size_t>(child);
+				pending++;
+				ones = ones && bit == 1;
+				continue;
+			}
+
+			const auto symbol = static_cast<std::int16_t>(-child - 1);
+			if (symbol == huffmanEOS) {
+				return false;
+			}
+
+			output.push_back(static_cast<char>(symbol));
+			node = 0;
+			pending = 0;
+			ones = true;
+		}
+	}
+
+	// The padding is shorter than an octet, and the start of EOS.
+	return pending < 8 && ones;
+}
+
+// Decodes an integer with a prefix of [prefixBits] bits, and removes it from
+// [input]. Integers that don't fit in 28 bits are rejected, since no sane
+// length or index is that large.
+//
+// Spec: RFC 7541 § 5.1
+[[nodiscard]] static bool
+DecodeInteger(std::string_view &input, unsigned prefixBits, std::size_t &value) noexcept {
+	if (input.empty()) {
+		return false;
+	}
+
+	const std::size_t mask = (std::size_t{ 1 } << prefixBits) - 1;
+	value = static_cast<unsigned char>(input.front()) & mask;
+	input.remove_prefix(1);
+	if (value != mask) {
+		return true;
+	}
+
+	for (unsigned shift = 0; shift <= 21; shift += 7) {
+		if (input.empty()) {
+			return false;
+		}
+
+		const auto octet = static_cast<unsigned char>(input.front());
+		input.remove_prefix(1);
+		value += static_cast<std::size_t>(octet & 0x7F) << shift;
+		if ((octet & 0x80) == 0) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// Decodes a string literal, and removes it from [input]. A Huffman-coded
+// string is decoded into [buffer].
+//
+// Spec: RFC 7541 § 5.2
+[[nodiscard]] static bool
+DecodeString(std::string_view &input, std::string &buffer, std::string_view &string) noexcept {
+	if (input.empty()) {
+		return false;
+	}
+
+	const bool huffman = (static_cast<unsigned char>(input.front()) & 0x80) != 0;
+	std::size_t length;
+	if (!DecodeInteger(input, 7, length) || length > input.length()) {
+		return false;
+	}
+
+	string = input.substr(0, length);
+	input.remove_prefix(length);
+	if (!huffman) {
+		return true;
+	}
+
+	buffer.clear();
+	if (!DecodeHuffman(string, buffer)) {
+		return false;
+	}
+
+	string = buffer;
+	return true;
+}
+
+// The size of an entry in the dynamic table.
+//
+// Spec: RFC 7541 § 4.1
+[[nodiscard]] static constexpr std::size_t
+EntrySize(std::string_view name, std::string_view value) noexcept {
+	return 32 + name.length() + value.length();
+}
+
+Decoder::Decoder(std::size_t maxTableSize) noexcept
+	: limit(maxTableSize), maxTableSize(maxTableSize) {
+}
+
+void
+Decoder::Evict(std::size_t maximum) noexcept {
+	while (size > maximum) {
+		size -= EntrySize(entries.back().name, entries.back().value);
+		entries.pop_back();
+	}
+}
+
+void
+Decoder::Insert(Field field) noexcept {
+	// The field might refer to an entry that is evicted to make room.
+	Entry entry{ std::string(field.name), std::string(field.value) };
+	const auto entrySize = EntrySize(field.name, field.value);
+
+	// An entry larger than the table empties it, without being added.
+	Evict(entrySize > limit ? 0 : limit - entrySize);
+	if (entrySize > limit) {
+		nameBuffer = std::move(entry.name);
+		valueBuffer = std::move(entry.value);
+		return;
+	}
+
+	entries.push_front(std::move(entry));
+	size += entrySize;
+}
+
+bool
+Decoder::Lookup(std::size_t index, Field &field) const noexcept {
+	if (index == 0) {
+		return false;
+	}
+
+	if (index <= staticTable.size()) {
+		field = staticTable[index - 1];
+		return true;
+	}
+
+	index -= staticTable.size() + 1;
+	if (index >= entries.size()) {
+		return false;
+	}
+
+	field = { entries[index].name, entries[index].value };
+	return true;
+}
+
+Decoder::Result
+Decoder::Next(std::string_view &block, bool atStart, Field &field) noexcept {
+	const auto first = static_cast<unsigned char>(block.front());
+	std::size_t index;
+
+	// Spec: RFC 7541 § 6.1
+	if ((first & 0x80) != 0) {
+		return DecodeInteger(block, 7, index) && Lookup(index, field) ? Result::FIELD : Result::FAILED;
+	}
+
+	// Spec: RFC 7541 § 6.3
+	if ((first & 0xE0) == 0x20) {
+		if (!atStart || !DecodeInteger(block, 5, index) || index > maxTableSize) {
+			return Result::FAILED;
+		}
+
+		limit = index;
+		Evict(limit);
+		return Result::TABLE_SIZE_UPDATE;
+	}
+
+	// Literals without indexing and those that are never indexed only differ
+	// for intermediaries.
+	//
+	// Spec: RFC 7541 § 6.2
+	const bool indexing = (first & 0xC0) == 0x40;
+	if (!DecodeInteger(block, indexing ? 6 : 4, index)) {
+		return Result::FAILED;
+	}
+
+	if (index == 0) {
+		if (!DecodeString(block, nameBuffer, field.name)) {
+			return Result::FAILED;
+		}
+	} else {
+		Field named;
+		if (!Lookup(index, named)) {
+			return Result::FAILED;
+		}
+		field.name = named.name;
+	}
+
+	if (!DecodeString(block, valueBuffer, field.value)) {
+		return Result::FAILED;
+	}
+
+	if (indexing) {
+		Insert(field);
+		field = entries.empty() || size == 0 ? Field{ nameBuffer, valueBuffer }
+											 : Field{ entries.front().name, entries.front().value };
+	}
+
+	return Result::FIELD;
+}
+
+// Returns the index of the first entry of the static table named [name], or
+// zero if there is none.
+[[nodiscard]] static std::size_t
+StaticNameIndex(std::string_view name) noexcept {
+	for (std::size_t i = 0; i < staticTable.size(); i++) {
+		if (HTTP::Utils::EqualsIgnoreCase(staticTable[i].name, name)) {
+			return i + 1;
+		}
+	}
+
+	return 0;
+}
+
+// Appends a literal, with the index of the name in [prefixBits] bits after
+// [flags].
+static void
+EncodeLiteral(std::string &output, std::string_view name, std::string_view value,
+			  unsigned prefixBits, std::uint8_t flags) noexcept {
+	const auto index = StaticNameIndex(name);
+	EncodeInteger(output, index, prefixBits, flags);
+
+	if (index == 0) {
+		EncodeInteger(output, name.length(), 7, 0);
+		for (const char character : name) {
+			output.push_back(character >= 'A' && character <= 'Z' ? static_cast<char>(character | 0x20) : character);
+		}
+	}
+
+	EncodeInteger(output, value.length(), 7, 0);
+	output.append(value);
+}
+
+// Calls [function] with the name and value of each of [lines].
+template <typename Function>
+static void
+ForEachLine(std::string_view lines, Function function) noexcept {
+	while (!lines.empty()) {
+		const auto end = lines.find("\r\n");
+		const auto line = lines.substr(0, end);
+		lines.remove_prefix(end == std::string_view::npos ? lines.length() : end + 2);
+
+		const auto colon = line.find(':');
+		if (colon == std::string_view::npos) {
+			continue;
+		}
+
+		auto value = line.substr(colon + 1);
+		while (!value.empty() && (value.front() == ' ' || value.front() == '\t')) {
+			value.remove_prefix(1);
+		}
+
+		function(line.substr(0, colon), value);
+	}
+}
+
+void
+EncodeInteger(std::string &output, std::size_t value, unsigned prefixBits, std::uint8_t flags) noexcept {
+	const std::size_t mask = (std::size_t{ 1 } << prefixBits) - 1;
+	if (value < mask) {
+		output.push_back(static_cast<char>(flags | value));
+		return;
+	}
+
+	output.push_back(static_cast<char>(flags | mask));
+	for (value -= mask; value >= 0x80; value >>= 7) {
+		output.push_back(static_cast<char>((value & 0x7F) | 0x80));
+	}
+	output.push_back(static_cast<char>(value));
+}
+
+void
+EncodeField(std::string &output, std::string_view name, std::string_view value) noexcept {
+	EncodeLiteral(output, name, value, 4, 0x00);
+}
+
+void
+EncodeFieldLines(std::string &output, std::string_view lines) noexcept {
+	ForEachLine(lines, [&output](std::string_view name, std::string_view value) {
+		EncodeField(output, name, value);
+	});
+}
+
+void
+EncodeStatus(std::string &output, std::string_view code) noexcept {
+	// The codes in the static table, starting at index 8.
+	static constexpr std::array<std::string_view, 7> indexedCodes{
+		"200", "204", "206", "304", "400", "404", "500"
+	};
+
+	for (std::size_t i = 0; i < indexedCodes.size(); i++) {
+		if (indexedCodes[i] == code) {
+			EncodeInteger(output, i + 8, 7, 0x80);
+			return;
+		}
+	}
+
+	EncodeInteger(output, 8, 4, 0x00);
+	EncodeInteger(output, code.length(), 7, 0);
+	output.append(code);
+}
+
+RepeatedFields::RepeatedFields(std::string_view lines) noexcept {
+	std::size_t count = 0;
+	ForEachLine(lines, [this, &count](std::string_view name, std::string_view value) {
+		EncodeLiteral(indexing, name, value, 6, 0x40);
+		EncodeField(literal, name, value);
+		tableSize += EntrySize(name, value);
+		count++;
+	});
+
+	// The last entry added has the first index after the static table.
+	for (std::size_t i = 0; i < count; i++) {
+		EncodeInteger(indexed, staticTable.size() + count - i, 7, 0x80);
+	}
+}
+
+} // namespace HTTP2::HPACK
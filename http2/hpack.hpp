@@ -0,0 +1,176 @@
+#pragma once
+
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+/**
+ * HPACK, the compression of the header fields of HTTP/2.
+ *
+ * Spec: RFC 7541
+ */
+
+#include <deque>
+#include <string>
+#include <string_view>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace HTTP2::HPACK {
+
+// The size of the dynamic table when SETTINGS_HEADER_TABLE_SIZE isn't sent.
+//
+// Spec: RFC 7540 § 6.5.2
+constexpr std::size_t defaultTableSize = 4096;
+
+struct Field {
+	std::string_view name;
+	std::string_view value;
+};
+
+// Decodes the header blocks of the peer. The decoder holds the dynamic table
+// of the connection, so every block must be decoded, in the order the blocks
+// were received.
+class Decoder {
+public:
+	enum class Result {
+		FIELD,
+		TABLE_SIZE_UPDATE,
+
+		// The representation is malformed, i.e. a COMPRESSION_ERROR.
+		FAILED,
+	};
+
+	// The dynamic table can't be made larger than [maxTableSize], which is
+	// the SETTINGS_HEADER_TABLE_SIZE sent to the peer.
+	explicit Decoder(std::size_t maxTableSize = defaultTableSize) noexcept;
+
+	// Calls [function] with each field of [block], which returns false to
+	// stop. The views of the field are only valid during the call.
+	//
+	// Returns false if the block is malformed, or [function] stopped.
+	template <typename Function>
+	[[nodiscard]] bool
+	Decode(std::string_view block, Function function) noexcept {
+		bool atStart = true;
+		Field field;
+
+		while (!block.empty()) {
+			switch (Next(block, atStart, field)) {
+				case Result::FIELD:
+					atStart = false;
+					if (!function(field)) {
+						return false;
+					}
+					break;
+				case Result::TABLE_SIZE_UPDATE:
+					break;
+				case Result::FAILED:
+					return false;
+			}
+		}
+
+		return true;
+	}
+
+	// Decodes the representation at the start of [block], and removes it from
+	// [block]. Dynamic table size updates are only allowed [atStart] of the
+	// block. The views of [field] are valid until the next call.
+	[[nodiscard]] Result
+	Next(std::string_view &block, bool atStart, Field &field) noexcept;
+
+	// The size of the entries in the dynamic table, as defined by RFC 7541
+	// § 4.1.
+	[[nodiscard]] inline std::size_t
+	TableSize() const noexcept {
+		return size;
+	}
+
+private:
+	struct Entry {
+		std::string name;
+		std::string value;
+	};
+
+	// The newest entry is at the front.
+	std::deque<Entry> entries;
+	std::size_t size{ 0 };
+	std::size_t limit;
+	const std::size_t maxTableSize;
+
+	// The storage of the Huffman-decoded strings of the last field.
+	std::string nameBuffer;
+	std::string valueBuffer;
+
+	// Evicts the oldest entries until the table is at most [maximum] large.
+	void
+	Evict(std::size_t maximum) noexcept;
+
+	void
+	Insert(Field field) noexcept;
+
+	[[nodiscard]] bool
+	Lookup(std::size_t index, Field &field) const noexcept;
+};
+
+// The representations of header fields a server sends, i.e. the parts of the
+// blocks of responses. They are never Huffman-coded, since the values that
+// vary are short, and the repeated fields are indexed (see RepeatedFields).
+
+// Appends [value] as an integer with a prefix of [prefixBits] bits, which are
+// in the first octet together with [flags].
+//
+// Spec: RFC 7541 § 5.1
+void
+EncodeInteger(std::string &output, std::size_t value, unsigned prefixBits, std::uint8_t flags) noexcept;
+
+// Appends the field as a literal without indexing. The name is lowercased,
+// and refers to the static table when it is in there.
+//
+// Spec: RFC 7541 § 6.2.2
+void
+EncodeField(std::string &output, std::string_view name, std::string_view value) noexcept;
+
+// Appends the fields of [lines], which are "Name: value" lines separated by
+// CRLFs, like the header fields of an HTTP/1.1 response.
+void
+EncodeFieldLines(std::string &output, std::string_view lines) noexcept;
+
+// Appends the :status pseudo-header field with the three digits of [code].
+void
+EncodeStatus(std::string &output, std::string_view code) noexcept;
+
+// Decodes the Huffman-coded [input], appending it to [output].
+//
+// Returns false if [input] is malformed: it contains EOS, or the padding
+// isn't the start of EOS.
+//
+// Spec: RFC 7541 § 5.2
+[[nodiscard]] bool
+DecodeHuffman(std::string_view input, std::string &output) noexcept;
+
+// The header fields sent with every response, e.g. Server::StaticHeaders,
+// encoded once. The first block a connection sends adds them to the dynamic
+// table of the peer, after which each is referred to with a single octet.
+struct RepeatedFields {
+	// [lines] are like those of EncodeFieldLines.
+	explicit RepeatedFields(std::string_view lines = {}) noexcept;
+
+	// Literals with incremental indexing, for the first block.
+	std::string indexing;
+
+	// References to the entries added by 'indexing', for the next blocks.
+	std::string indexed;
+
+	// Literals without indexing, for peers whose table is too small for the
+	// entries.
+	std::string literal;
+
+	// The size the entries take in the dynamic table of the peer.
+	std::size_t tableSize{ 0 };
+};
+
+} // namespace HTTP2::HPACK
@@ -0,0 +1,892 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include "http2/session.hpp"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <utility>
+
+#include "base/media_type.hpp"
+#include "base/strings.hpp"
+#include "cgi/manager.hpp"
+#include "http/access_log.hpp"
+#include "http/client.hpp"
+#include "http/configuration.hpp"
+#include "http/content_coding.hpp"
+#include "http/date.hpp"
+#include "http/server.hpp"
+#include "http/utils.hpp"
+#include "io/file.hpp"
+#include "io/file_cache.hpp"
+#include "io/file_resolver.hpp"
+#include "posix/unistd.hpp"
+#include "security/policies.hpp"
+
+// The largest payload of a DATA frame, such that the frame fits in a TLS
+// record of the maximum size, 16384 octets.
+#define MAGIC_HTTP2_DATA_FRAME_SIZE (16384 - 9)
+
+// The largest header block of a request. Larger blocks can't be refused
+// without decoding them, since they change the dynamic table.
+#define MAGIC_HTTP2_MAX_HEADER_BLOCK_SIZE 16384
+
+// The amount of DATA octets received before the window of the connection is
+// replenished.
+#define MAGIC_HTTP2_WINDOW_UPDATE_THRESHOLD 32768
+
+namespace HTTP2 {
+
+Session::Session(HTTP::Server &server, Connection &connection) noexcept
+	: server(server), connection(connection) {
+}
+
+Session::~Session() noexcept = default;
+
+bool
+Session::Fail(ErrorCode code) noexcept {
+	if (failed) {
+		return false;
+	}
+
+	failed = true;
+	std::array<char, 8> goAway;
+	WriteUInt32(goAway.data(), lastStreamID);
+	WriteUInt32(goAway.data() + 4, static_cast<std::uint32_t>(code));
+	SendFrame(FrameType::GOAWAY, 0, 0, { goAway.data(), goAway.size() });
+	return false;
+}
+
+Session::Stream *
+Session::FindStream(std::uint32_t streamID) noexcept {
+	for (auto &stream : streams) {
+		if (stream.id == streamID) {
+			return &stream;
+		}
+	}
+
+	return nullptr;
+}
+
+void
+Session::FinishStream(std::size_t index) noexcept {
+	// The request body isn't needed anymore.
+	//
+	// Spec: RFC 7540 § 8.1
+	if (!streams[index].requestEnded) {
+		SendReset(streams[index].id, ErrorCode::NO_ERROR);
+	}
+
+	streams.erase(std::begin(streams) + static_cast<std::ptrdiff_t>(index));
+}
+
+void
+Session::GoAway() noexcept {
+	if (goingAway) {
+		return;
+	}
+
+	goingAway = true;
+	goAwayStreamID = lastStreamID;
+
+	std::array<char, 8> goAway;
+	WriteUInt32(goAway.data(), lastStreamID);
+	WriteUInt32(goAway.data() + 4, static_cast<std::uint32_t>(ErrorCode::NO_ERROR));
+	SendFrame(FrameType::GOAWAY, 0, 0, { goAway.data(), goAway.size() });
+}
+
+bool
+Session::HandleFrame() noexcept {
+	switch (frame.type) {
+		case FrameType::DATA:
+			// The body of a request is discarded, and only counts towards the
+			// flow-control windows. Once the request has ended, the window of
+			// the stream isn't needed anymore.
+			if (auto *stream = FindStream(frame.streamID); stream != nullptr && !stream->requestEnded) {
+				if (frame.flags & Flags::END_STREAM) {
+					stream->requestEnded = true;
+				} else {
+					stream->unacknowledgedData += frame.length;
+					if (stream->unacknowledgedData >= MAGIC_HTTP2_WINDOW_UPDATE_THRESHOLD) {
+						SendWindowUpdate(stream->id, stream->unacknowledgedData);
+						stream->unacknowledgedData = 0;
+					}
+				}
+			}
+
+			unacknowledgedData += frame.length;
+			if (unacknowledgedData >= MAGIC_HTTP2_WINDOW_UPDATE_THRESHOLD) {
+				SendWindowUpdate(0, unacknowledgedData);
+				unacknowledgedData = 0;
+			}
+			return true;
+		case FrameType::HEADERS:
+			return HandleHeaders();
+		case FrameType::PRIORITY:
+			// Priorities are ignored; the streams are served round-robin.
+			if (frame.streamID == 0) {
+				return Fail(ErrorCode::PROTOCOL_ERROR);
+			}
+			return frame.length == 5 || Fail(ErrorCode::FRAME_SIZE_ERROR);
+		case FrameType::RST_STREAM:
+			if (frame.streamID == 0 || frame.streamID > lastStreamID) {
+				return Fail(ErrorCode::PROTOCOL_ERROR);
+			}
+			if (frame.length != 4) {
+				return Fail(ErrorCode::FRAME_SIZE_ERROR);
+			}
+			for (std::size_t i = 0; i < streams.size(); i++) {
+				if (streams[i].id == frame.streamID) {
+					streams.erase(std::begin(streams) + static_cast<std::ptrdiff_t>(i));
+					break;
+				}
+			}
+			return true;
+		case FrameType::SETTINGS:
+			return HandleSettings();
+		case FrameType::PUSH_PROMISE:
+			// Only servers push.
+			return Fail(ErrorCode::PROTOCOL_ERROR);
+		case FrameType::PING:
+			if (frame.streamID != 0) {
+				return Fail(ErrorCode::PROTOCOL_ERROR);
+			}
+			if (frame.length != 8) {
+				return Fail(ErrorCode::FRAME_SIZE_ERROR);
+			}
+			if ((frame.flags & Flags::ACK) == 0) {
+				SendFrame(FrameType::PING, Flags::ACK, 0, payload);
+			}
+			return true;
+		case FrameType::GOAWAY:
+			if (frame.streamID != 0) {
+				return Fail(ErrorCode::PROTOCOL_ERROR);
+			}
+			if (frame.length < 8) {
+				return Fail(ErrorCode::FRAME_SIZE_ERROR);
+			}
+			goingAway = true;
+			return true;
+		case FrameType::WINDOW_UPDATE:
+			return HandleWindowUpdate();
+		case FrameType::CONTINUATION:
+			if (headerStreamID == 0) {
+				return Fail(ErrorCode::PROTOCOL_ERROR);
+			}
+			if (headerBlock.length() + payload.length() > MAGIC_HTTP2_MAX_HEADER_BLOCK_SIZE) {
+				return Fail(ErrorCode::ENHANCE_YOUR_CALM);
+			}
+			headerBlock.append(payload);
+			return (frame.flags & Flags::END_HEADERS) == 0 || HandleHeaderBlock();
+	}
+
+	// Frames of unknown types are ignored.
+	//
+	// Spec: RFC 7540 § 4.1
+	return true;
+}
+
+bool
+Session::HandleHeaderBlock() noexcept {
+	const auto streamID = headerStreamID;
+	headerStreamID = 0;
+
+	// A block on a stream started after the GOAWAY of the server only has
+	// to be decoded for the dynamic table.
+	if (goingAway && streamID > goAwayStreamID) {
+		if (!decoder.Decode(headerBlock, [](HPACK::Field) { return true; })) {
+			return Fail(ErrorCode::COMPRESSION_ERROR);
+		}
+
+		lastStreamID = std::max(lastStreamID, streamID);
+		return true;
+	}
+
+	// A block on a stream that isn't new can only be the trailers of a
+	// request that hasn't ended yet, or be in flight from before the server
+	// reset the stream.
+	//
+	// Spec: RFC 7540 § 5.1, § 5.1.1 and § 8.1
+	if (streamID <= lastStreamID) {
+		if (!decoder.Decode(headerBlock, [](HPACK::Field) { return true; })) {
+			return Fail(ErrorCode::COMPRESSION_ERROR);
+		}
+
+		auto *stream = FindStream(streamID);
+		if (stream == nullptr || stream->requestEnded) {
+			return IsReset(streamID) || Fail(ErrorCode::PROTOCOL_ERROR);
+		}
+
+		// Trailers end the request.
+		if (headerEndStream) {
+			stream->requestEnded = true;
+		} else {
+			SendReset(streamID, ErrorCode::PROTOCOL_ERROR);
+			streams.erase(std::begin(streams) + (stream - streams.data()));
+		}
+		return true;
+	}
+
+	lastStreamID = streamID;
+	request.Reset();
+	arena.Reset();
+
+	const auto &policies = server.config().securityPolicies;
+	bool malformed = false;
+	bool regularSeen = false;
+	bool hasScheme = false;
+	bool hasAuthority = false;
+	std::string_view authority;
+	auto error = HTTP::ClientError::NO_ERROR;
+
+	// Spec: RFC 7540 § 8.1.2
+	const bool decoded = decoder.Decode(headerBlock, [&](HPACK::Field field) {
+		if (field.name.empty()) {
+			malformed = true;
+			return true;
+		}
+
+		if (field.name.front() == ':') {
+			if (regularSeen) {
+				malformed = true;
+			} else if (field.name == ":method") {
+				malformed |= !request.method.empty();
+				if (policies.maxMethodLength != 0 && field.value.length() >= policies.maxMethodLength) {
+					error = HTTP::ClientError::POLICY_TOO_LONG_METHOD;
+				}
+				request.SetMethod(arena.Copy(field.value));
+			} else if (field.name == ":path") {
+				malformed |= !request.path.empty() || field.value.empty();
+				if (policies.maxRequestTargetLength != 0 && field.value.length() >= policies.maxRequestTargetLength) {
+					error = HTTP::ClientError::POLICY_TOO_LONG_REQUEST_TARGET;
+				}
+				request.path = arena.Copy(field.value);
+			} else if (field.name == ":scheme") {
+				malformed |= hasScheme;
+				hasScheme = true;
+			} else if (field.name == ":authority") {
+				malformed |= hasAuthority;
+				hasAuthority = true;
+				authority = arena.Copy(field.value);
+				if (!request.headers.Add({ "host", authority })) {
+					error = HTTP::ClientError::POLICY_TOO_MANY_HEADERS;
+				}
+			} else {
+				malformed = true;
+			}
+			return true;
+		}
+
+		regularSeen = true;
+		if (std::any_of(std::cbegin(field.name), std::cend(field.name), [](char c) { return c >= 'A' && c <= 'Z'; }) ||
+			field.name == "connection" || field.name == "keep-alive" || field.name == "proxy-connection" ||
+			field.name == "transfer-encoding" || field.name == "upgrade" ||
+			(field.name == "te" && field.value != "trailers")) {
+			malformed = true;
+			return true;
+		}
+
+		// A Host header field next to :authority only repeats it.
+		//
+		// Spec: RFC 7540 § 8.1.2.3
+		if (hasAuthority && field.name == "host") {
+			malformed |= field.value != authority;
+			return true;
+		}
+
+		if (policies.maxHeaderFieldNameLength != 0 && field.name.length() >= policies.maxHeaderFieldNameLength) {
+			error = HTTP::ClientError::POLICY_TOO_LONG_HEADER_FIELD_NAME;
+		} else if (policies.maxHeaderFieldValueLength != 0 && field.value.length() >= policies.maxHeaderFieldValueLength) {
+			error = HTTP::ClientError::POLICY_TOO_LONG_HEADER_FIELD_VALUE;
+		} else if ((policies.maxHeaderCount != 0 && request.headers.size() == policies.maxHeaderCount) ||
+				   !request.headers.Add({ arena.Copy(field.name), arena.Copy(field.value) })) {
+			error = HTTP::ClientError::POLICY_TOO_MANY_HEADERS;
+		}
+		return true;
+	});
+
+	if (!decoded) {
+		return Fail(ErrorCode::COMPRESSION_ERROR);
+	}
+
+	const auto path = request.path;
+	if (malformed || !hasScheme || request.method.empty() || path.empty() || path.front() != '/' ||
+		!std::all_of(std::cbegin(path), std::cend(path), HTTP::Utils::IsPathCharacter)) {
+		SendReset(streamID, ErrorCode::PROTOCOL_ERROR);
+		return true;
+	}
+
+	if (streams.size() >= maxConcurrentStreams) {
+		SendReset(streamID, ErrorCode::REFUSED_STREAM);
+		return true;
+	}
+
+	if (const auto questionMark = path.find('?'); questionMark != std::string_view::npos) {
+		request.path = path.substr(0, questionMark);
+		request.query = path.substr(questionMark + 1);
+	}
+
+	// The same checks as for HTTP/1.1, on the Host header field that's
+	// made of :authority.
+	if (error == HTTP::ClientError::NO_ERROR) {
+		error = HTTP::Client::CheckHostHeader(request, server, connection.IsLocalhost());
+	}
+
+	Respond(streamID, headerEndStream, error);
+	return true;
+}
+
+bool
+Session::HandleHeaders() noexcept {
+	if (frame.streamID == 0 || (frame.streamID & 1) == 0) {
+		return Fail(ErrorCode::PROTOCOL_ERROR);
+	}
+
+	std::string_view fragment(payload);
+	if (frame.flags & Flags::PADDED) {
+		const std::size_t padding = fragment.empty() ? 0 : static_cast<unsigned char>(fragment.front());
+		if (fragment.length() < padding + 1) {
+			return Fail(ErrorCode::PROTOCOL_ERROR);
+		}
+		fragment = fragment.substr(1, fragment.length() - padding - 1);
+	}
+
+	if (frame.flags & Flags::PRIORITY) {
+		if (fragment.length() < 5) {
+			return Fail(ErrorCode::PROTOCOL_ERROR);
+		}
+		fragment.remove_prefix(5);
+	}
+
+	headerBlock.assign(fragment.data(), fragment.length());
+	headerStreamID = frame.streamID;
+	headerEndStream = (frame.flags & Flags::END_STREAM) != 0;
+	return (frame.flags & Flags::END_HEADERS) == 0 || HandleHeaderBlock();
+}
+
+bool
+Session::HandleSettings() noexcept {
+	if (frame.streamID != 0) {
+		return Fail(ErrorCode::PROTOCOL_ERROR);
+	}
+
+	if (frame.flags & Flags::ACK) {
+		return frame.length == 0 || Fail(ErrorCode::FRAME_SIZE_ERROR);
+	}
+
+	if (frame.length % 6 != 0) {
+		return Fail(ErrorCode::FRAME_SIZE_ERROR);
+	}
+
+	settingsReceived = true;
+	for (std::size_t offset = 0; offset != payload.length(); offset += 6) {
+		const auto *setting = payload.data() + offset;
+		const auto id = static_cast<SettingID>((static_cast<unsigned char>(setting[0]) << 8) |
+											   static_cast<unsigned char>(setting[1]));
+		const auto value = ReadUInt32(setting + 2);
+
+		switch (id) {
+			case SettingID::HEADER_TABLE_SIZE:
+				// A smaller table than the encoder uses must be acknowledged
+				// with a dynamic table size update.
+				//
+				// Spec: RFC 7541 § 4.2
+				if (value < peerTableSize) {
+					pendingTableSizeUpdate = true;
+					peerTableSize = value;
+					if (fieldsState == FieldsState::INDEXED && value < server.StaticFields().tableSize) {
+						fieldsState = FieldsState::LITERAL;
+					}
+				}
+				break;
+			case SettingID::ENABLE_PUSH:
+				if (value > 1) {
+					return Fail(ErrorCode::PROTOCOL_ERROR);
+				}
+				break;
+			case SettingID::INITIAL_WINDOW_SIZE: {
+				if (value > maxWindowSize) {
+					return Fail(ErrorCode::FLOW_CONTROL_ERROR);
+				}
+
+				// Spec: RFC 7540 § 6.9.2
+				const auto delta = static_cast<std::int64_t>(value) - initialStreamWindow;
+				initialStreamWindow = value;
+				for (auto &stream : streams) {
+					stream.window += delta;
+					if (stream.window > maxWindowSize) {
+						return Fail(ErrorCode::FLOW_CONTROL_ERROR);
+					}
+				}
+			} break;
+			case SettingID::MAX_FRAME_SIZE:
+				if (value < defaultMaxFrameSize || value > 0xFFFFFF) {
+					return Fail(ErrorCode::PROTOCOL_ERROR);
+				}
+				peerMaxFrameSize = value;
+				break;
+			default:
+				break;
+		}
+	}
+
+	SendFrame(FrameType::SETTINGS, Flags::ACK, 0, {});
+	return true;
+}
+
+bool
+Session::HandleWindowUpdate() noexcept {
+	if (frame.length != 4) {
+		return Fail(ErrorCode::FRAME_SIZE_ERROR);
+	}
+
+	const auto increment = ReadUInt31(payload.data());
+	if (frame.streamID == 0) {
+		if (increment == 0) {
+			return Fail(ErrorCode::PROTOCOL_ERROR);
+		}
+
+		sendWindow += increment;
+		return sendWindow <= maxWindowSize || Fail(ErrorCode::FLOW_CONTROL_ERROR);
+	}
+
+	if (frame.streamID > lastStreamID) {
+		return Fail(ErrorCode::PROTOCOL_ERROR);
+	}
+
+	auto *stream = FindStream(frame.streamID);
+	if (stream == nullptr) {
+		return true;
+	}
+
+	stream->window += increment;
+	if (increment == 0 || stream->window > maxWindowSize) {
+		SendReset(stream->id, increment == 0 ? ErrorCode::PROTOCOL_ERROR : ErrorCode::FLOW_CONTROL_ERROR);
+		streams.erase(std::begin(streams) + (stream - streams.data()));
+	}
+
+	return true;
+}
+
+bool
+Session::IsDone() const noexcept {
+	return failed || (goingAway && streams.empty());
+}
+
+bool
+Session::IsReset(std::uint32_t streamID) const noexcept {
+	return std::find(std::cbegin(resetStreams), std::cend(resetStreams), streamID) != std::cend(resetStreams);
+}
+
+bool
+Session::IsSending() const noexcept {
+	if (sendWindow <= 0) {
+		return false;
+	}
+
+	return std::any_of(std::cbegin(streams), std::cend(streams), [](const Stream &stream) {
+		return stream.window > 0;
+	});
+}
+
+bool
+Session::Receive() noexcept {
+	while (!failed) {
+		const auto input = connection.Buffered();
+
+		// Spec: RFC 7540 § 3.5
+		if (!prefaceReceived) {
+			const auto length = std::min(input.length(), connectionPreface.length());
+			if (std::string_view(input.data(), length) != connectionPreface.substr(0, length)) {
+				return Fail(ErrorCode::PROTOCOL_ERROR);
+			}
+			if (length != connectionPreface.length()) {
+				break;
+			}
+
+			connection.Consume(length);
+			prefaceReceived = true;
+			continue;
+		}
+
+		if (!hasFrameHeader) {
+			if (input.length() < frameHeaderSize) {
+				break;
+			}
+
+			frame = ParseFrameHeader(input.data());
+			connection.Consume(frameHeaderSize);
+			hasFrameHeader = true;
+			frameRemaining = frame.length;
+			payload.clear();
+
+			if (frame.length > defaultMaxFrameSize) {
+				return Fail(ErrorCode::FRAME_SIZE_ERROR);
+			}
+
+			// The preface of the client ends with a SETTINGS frame, and a
+			// header block can't be interrupted by other frames.
+			//
+			// Spec: RFC 7540 § 3.5 and § 6.10
+			if ((!settingsReceived && frame.type != FrameType::SETTINGS) ||
+				(headerStreamID != 0 && (frame.type != FrameType::CONTINUATION || frame.streamID != headerStreamID))) {
+				return Fail(ErrorCode::PROTOCOL_ERROR);
+			}
+
+			if (frame.type == FrameType::DATA && (frame.streamID == 0 || frame.streamID > lastStreamID)) {
+				return Fail(ErrorCode::PROTOCOL_ERROR);
+			}
+			continue;
+		}
+
+		const auto length = std::min(frameRemaining, input.length());
+		if (frame.type != FrameType::DATA) {
+			payload.append(input.data(), length);
+		}
+		connection.Consume(length);
+		frameRemaining -= length;
+
+		if (frameRemaining != 0) {
+			break;
+		}
+
+		hasFrameHeader = false;
+		if (!HandleFrame()) {
+			return false;
+		}
+	}
+
+	return !IsDone();
+}
+
+void
+Session::Respond(std::uint32_t streamID, bool requestEnded, HTTP::ClientError error) noexcept {
+	const auto maxRequests = server.config().securityPolicies.maxRequestsPerConnection;
+	if (maxRequests != 0 && ++requestCount > maxRequests) {
+		error = HTTP::ClientError::TOO_MANY_REQUESTS_PER_THIS_CONNECTION;
+	}
+
+	if (error == HTTP::ClientError::NO_ERROR) {
+		// The scripts of routed paths are only run for HTTP/1.1, whose
+		// clients forward the request body and stream the output. The paths
+		// shadow the file system, so they aren't looked up there instead.
+		if (server.cgi().Lookup(request) != nullptr) {
+			ServeString(streamID, requestEnded, Strings::StatusLines::BadGateway, MediaTypes::HTML, Strings::BadGatewayPage);
+		} else {
+			ServeFile(streamID, requestEnded);
+		}
+		return;
+	}
+
+	// The errors of the policies and of the Host header field all have
+	// fixed responses.
+	const auto *response = server.FindErrorResponse(error);
+	if (response == nullptr) {
+		SendReset(streamID, ErrorCode::INTERNAL_ERROR);
+		return;
+	}
+
+	const auto &serialized = response->responses[0];
+	const auto headLength = response->headLengths[0];
+	ServeString(streamID, requestEnded, base::String(response->statusLine.data(), response->statusLine.length()),
+				*response->mediaType, base::String(serialized.data() + headLength, serialized.length() - headLength));
+}
+
+bool
+Session::Send() noexcept {
+	while (sendWindow > 0 && connection.SendBacklogSize() < Connection::corkedBacklogSize) {
+		bool progressed = false;
+
+		// A frame of each stream at a time.
+		for (std::size_t i = 0; i < streams.size() && sendWindow > 0;) {
+			auto &stream = streams[i];
+			if (stream.window <= 0) {
+				i++;
+				continue;
+			}
+
+			if (!SendData(stream)) {
+				SendReset(stream.id, ErrorCode::INTERNAL_ERROR);
+				stream.requestEnded = true;
+				FinishStream(i);
+				continue;
+			}
+
+			progressed = true;
+			if (stream.remaining == 0) {
+				FinishStream(i);
+				continue;
+			}
+			i++;
+		}
+
+		if (!progressed) {
+			break;
+		}
+	}
+
+	return !IsDone();
+}
+
+bool
+Session::SendData(Stream &stream) noexcept {
+	const auto length = static_cast<std::size_t>(std::min<std::int64_t>({
+		static_cast<std::int64_t>(std::min<std::size_t>(stream.remaining, std::min<std::size_t>(peerMaxFrameSize, MAGIC_HTTP2_DATA_FRAME_SIZE))),
+		sendWindow, stream.window
+	}));
+
+	const char *data = stream.data;
+	if (data == nullptr) {
+		if (fileBuffer == nullptr) {
+			fileBuffer = std::make_unique<char[]>(MAGIC_HTTP2_DATA_FRAME_SIZE);
+		}
+
+		for (std::size_t read = 0; read != length;) {
+			const auto result = psx::pread(stream.file->file->Handle(), fileBuffer.get() + read, length - read,
+										   stream.offset + static_cast<off_t>(read));
+			if (result <= 0) {
+				return false;
+			}
+			read += static_cast<std::size_t>(result);
+		}
+		data = fileBuffer.get();
+		stream.offset += static_cast<off_t>(length);
+	} else {
+		stream.data += length;
+	}
+
+	stream.remaining -= length;
+	stream.window -= static_cast<std::int64_t>(length);
+	sendWindow -= static_cast<std::int64_t>(length);
+
+	std::array<char, frameHeaderSize> header;
+	WriteFrameHeader(header.data(), length, FrameType::DATA, stream.remaining == 0 ? Flags::END_STREAM : 0, stream.id);
+	return connection.WriteBaseStrings({ base::String(header.data(), header.size()), base::String(data, length) });
+}
+
+void
+Session::SendFrame(FrameType type, std::uint8_t flags, std::uint32_t streamID, std::string_view framePayload) noexcept {
+	std::array<char, frameHeaderSize> header;
+	WriteFrameHeader(header.data(), framePayload.length(), type, flags, streamID);
+
+	// A failed write shows up as a failed flush of the client.
+	static_cast<void>(connection.WriteBaseStrings({
+		base::String(header.data(), header.size()),
+		base::String(framePayload.data(), framePayload.length())
+	}));
+}
+
+void
+Session::SendHead(std::uint32_t streamID, const base::String &statusLine, std::size_t contentLength,
+				  const MediaType &mediaType, std::string_view lines, bool endStream) noexcept {
+	auto &block = responseBlock;
+	block.clear();
+
+	if (pendingTableSizeUpdate) {
+		HPACK::EncodeInteger(block, peerTableSize, 5, 0x20);
+		pendingTableSizeUpdate = false;
+	}
+
+	// "HTTP/1.1 200 OK"
+	HPACK::EncodeStatus(block, std::string_view(statusLine.data(), statusLine.length()).substr(9, 3));
+
+	const auto &fields = server.StaticFields();
+	switch (fieldsState) {
+		case FieldsState::UNSENT:
+			if (fields.tableSize <= peerTableSize) {
+				block.append(fields.indexing);
+				fieldsState = FieldsState::INDEXED;
+			} else {
+				block.append(fields.literal);
+				fieldsState = FieldsState::LITERAL;
+			}
+			break;
+		case FieldsState::INDEXED:
+			block.append(fields.indexed);
+			break;
+		case FieldsState::LITERAL:
+			block.append(fields.literal);
+			break;
+	}
+
+	// Enough for the decimal representation of any std::size_t.
+	std::array<char, 20> contentLengthValue;
+	const auto contentLengthEnd = std::to_chars(contentLengthValue.data(),
+		contentLengthValue.data() + contentLengthValue.size(), contentLength).ptr;
+	HPACK::EncodeField(block, "content-length", std::string_view(contentLengthValue.data(),
+		static_cast<std::size_t>(contentLengthEnd - contentLengthValue.data())));
+
+	HPACK::EncodeField(block, "content-type", mediaType.ContentType());
+	HPACK::EncodeField(block, "date", HTTP::CurrentDate());
+
+	HPACK::EncodeFieldLines(block, lines);
+
+	if (auto *accessLog = server.config().accessLog) {
+		HTTP::LogAccess(*accessLog, request, "HTTP/2", connection.PeerAddress(),
+						std::string_view(statusLine.data(), statusLine.length()), contentLength);
+	}
+
+	// Spec: RFC 7540 § 6.2 and § 6.10
+	auto &frames = responseFrames;
+	frames.clear();
+	std::string_view rest(block);
+	auto type = FrameType::HEADERS;
+	do {
+		const auto fragment = rest.substr(0, peerMaxFrameSize);
+		rest.remove_prefix(fragment.length());
+
+		std::uint8_t flags = rest.empty() ? Flags::END_HEADERS : 0;
+		if (type == FrameType::HEADERS && endStream) {
+			flags |= Flags::END_STREAM;
+		}
+
+		std::array<char, frameHeaderSize> header;
+		WriteFrameHeader(header.data(), fragment.length(), type, flags, streamID);
+		frames.append(header.data(), header.size());
+		frames.append(fragment);
+		type = FrameType::CONTINUATION;
+	} while (!rest.empty());
+
+	// A failed write shows up as a failed flush of the client.
+	static_cast<void>(connection.WriteBaseString(base::String(frames.data(), frames.length())));
+}
+
+void
+Session::SendReset(std::uint32_t streamID, ErrorCode code) noexcept {
+	std::array<char, 4> errorCode;
+	WriteUInt32(errorCode.data(), static_cast<std::uint32_t>(code));
+	SendFrame(FrameType::RST_STREAM, 0, streamID, { errorCode.data(), errorCode.size() });
+
+	if (resetStreams.size() == maxResetStreams) {
+		resetStreams.erase(std::begin(resetStreams));
+	}
+	resetStreams.push_back(streamID);
+}
+
+void
+Session::SendWindowUpdate(std::uint32_t streamID, std::size_t increment) noexcept {
+	std::array<char, 4> windowIncrement;
+	WriteUInt32(windowIncrement.data(), static_cast<std::uint32_t>(increment));
+	SendFrame(FrameType::WINDOW_UPDATE, 0, streamID, { windowIncrement.data(), windowIncrement.size() });
+}
+
+void
+Session::ServeFile(std::uint32_t streamID, bool requestEnded) noexcept {
+	static const std::string_view indexPathTarget("/index.html");
+
+	IO::FileResolveStatus status;
+	std::shared_ptr<const std::string> listing;
+	auto cachedFile = server.ResolveFile(request, status, &listing);
+	switch (status) {
+		case IO::FileResolveStatus::OK:
+			break;
+		case IO::FileResolveStatus::NOT_FOUND:
+			// A directory without an index, see HTTP::Configuration::autoIndex.
+			if (listing != nullptr) {
+				const bool hasBody = !request.IsHead() && !listing->empty();
+				SendHead(streamID, Strings::StatusLines::OK, listing->length(), MediaTypes::HTML, {}, !hasBody);
+				StartBody({ streamID, initialStreamWindow, nullptr, listing->data(), 0,
+							hasBody ? listing->length() : 0, requestEnded, listing });
+				return;
+			}
+			if (indexPathTarget.substr(0, request.path.length()) == request.path) {
+				ServeString(streamID, requestEnded, Strings::StatusLines::OK, MediaTypes::HTML, Strings::DefaultWebPage);
+				return;
+			}
+			[[fallthrough]];
+		case IO::FileResolveStatus::OUTSIDE_ROOT_DIRECTORY:
+			ServeString(streamID, requestEnded, Strings::StatusLines::NotFound, MediaTypes::HTML, Strings::NotFoundPage);
+			return;
+		case IO::FileResolveStatus::INSUFFICIENT_PERMISSIONS:
+			ServeString(streamID, requestEnded, Strings::StatusLines::Forbidden, MediaTypes::HTML, Strings::ForbiddenPage);
+			return;
+		case IO::FileResolveStatus::FILE_SYSTEM_OVERLOAD:
+			ServeString(streamID, requestEnded, Strings::StatusLines::ServiceUnavailable, MediaTypes::HTML, Strings::FileSystemOverloadPage);
+			return;
+	}
+
+	// Spec: RFC 7231 § 5.3.4
+	const bool hasEncodings = cachedFile->HasEncodings();
+	if (hasEncodings) {
+		if (const auto *acceptEncoding = request.headers.Find(HTTP::HeaderID::ACCEPT_ENCODING)) {
+			const auto coding = HTTP::AcceptEncoding::Parse(acceptEncoding->value).Select([&cachedFile](HTTP::ContentCoding coding) {
+				return cachedFile->encodings[static_cast<std::size_t>(coding)] != nullptr;
+			});
+			if (coding != HTTP::ContentCoding::IDENTITY) {
+				auto encoded = cachedFile->encodings[static_cast<std::size_t>(coding)];
+				cachedFile = std::move(encoded);
+			}
+		}
+	}
+
+	const auto size = cachedFile->file->Size();
+	const auto &configuration = server.config();
+
+	// Files are only compressed on the fly for HTTP/1.1, but the response
+	// varies all the same.
+	std::string lines(cachedFile->validatorHeaders);
+	if (hasEncodings || (configuration.compressionEnabled && size >= configuration.compressionMinimumSize &&
+						 cachedFile->mediaType->IsCompressible())) {
+		lines.append("Vary: Accept-Encoding\r\n");
+	}
+
+	if (cachedFile->coding != HTTP::ContentCoding::IDENTITY) {
+		lines.append("Content-Encoding: ");
+		lines.append(HTTP::ContentCodingName(cachedFile->coding));
+		lines.append("\r\n");
+	}
+
+	if (HTTP::Client::IsNotModified(request, cachedFile->entityTag, cachedFile->file->ModificationTime())) {
+		SendHead(streamID, Strings::StatusLines::NotModified, size, *cachedFile->mediaType, lines, true);
+		StartBody({ streamID, 0, nullptr, nullptr, 0, 0, requestEnded });
+		return;
+	}
+
+	const bool hasBody = !request.IsHead() && size != 0;
+	SendHead(streamID, Strings::StatusLines::OK, size, *cachedFile->mediaType, lines, !hasBody);
+
+	const auto memory = cachedFile->Memory();
+	StartBody({ streamID, initialStreamWindow, std::move(cachedFile), memory.empty() ? nullptr : memory.data(), 0,
+				hasBody ? size : 0, requestEnded });
+}
+
+void
+Session::ServeString(std::uint32_t streamID, bool requestEnded, const base::String &statusLine,
+					 const MediaType &mediaType, const base::String &body) noexcept {
+	const bool hasBody = !request.IsHead() && body.length() != 0;
+	SendHead(streamID, statusLine, body.length(), mediaType, {}, !hasBody);
+	StartBody({ streamID, initialStreamWindow, nullptr, body.data(), 0, hasBody ? body.length() : 0, requestEnded });
+}
+
+bool
+Session::Start() noexcept {
+	std::array<char, 6> settings;
+	settings[0] = 0;
+	settings[1] = static_cast<char>(SettingID::MAX_CONCURRENT_STREAMS);
+	WriteUInt32(settings.data() + 2, maxConcurrentStreams);
+
+	std::array<char, frameHeaderSize> header;
+	WriteFrameHeader(header.data(), settings.size(), FrameType::SETTINGS, 0, 0);
+	return connection.WriteBaseStrings({
+		base::String(header.data(), header.size()),
+		base::String(settings.data(), settings.size())
+	});
+}
+
+void
+Session::StartBody(Stream stream) noexcept {
+	if (stream.remaining != 0) {
+		streams.push_back(std::move(stream));
+		return;
+	}
+
+	if (!stream.requestEnded) {
+		SendReset(stream.id, ErrorCode::NO_ERROR);
+	}
+}
+
+} // namespace HTTP2
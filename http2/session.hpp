@@ -0,0 +1,293 @@
+#pragma once
+
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+#include <sys/types.h>
+
+#include "base/arena.hpp"
+#include "base/string.hpp"
+#include "connection/connection.hpp"
+#include "http/client_error.hpp"
+#include "http/request.hpp"
+#include "http2/frame.hpp"
+#include "http2/hpack.hpp"
+
+// From base/media_type.hpp:
+struct MediaType;
+
+// From io/file_cache.hpp:
+namespace IO {
+	struct CachedFile;
+} // namespace IO
+
+namespace HTTP {
+	// Forward-decl from server.hpp
+	class Server;
+} // namespace HTTP
+
+namespace HTTP2 {
+
+// An HTTP/2 connection, which multiplexes the exchanges of many requests.
+// Requests are answered as soon as their header block has been received, so
+// the connection only holds the response bodies that are still being sent,
+// which are interleaved a DATA frame at a time.
+//
+// Request bodies are discarded, and the flow-control windows of the
+// connection and of their stream are replenished as they're received, so
+// they never stall either.
+//
+// The session is driven by the client of the connection: Receive is called
+// with new octets in the receive buffer, and Send when the connection can be
+// written to.
+//
+// Spec: RFC 7540
+class Session {
+public:
+	// The amount of streams a peer may open concurrently, which is sent in
+	// the SETTINGS frame of the server.
+	static constexpr std::size_t maxConcurrentStreams = 100;
+
+	Session(HTTP::Server &server, Connection &connection) noexcept;
+
+	~Session() noexcept;
+
+	Session(const Session &) = delete;
+	Session &operator=(const Session &) = delete;
+
+	// Writes the connection preface of the server, i.e. its SETTINGS frame.
+	//
+	// Returns success status
+	[[nodiscard]] bool
+	Start() noexcept;
+
+	// Handles the frames in the receive buffer of the connection, which are
+	// consumed, responding to the requests among them.
+	//
+	// Returns false if the connection should be closed once the send
+	// backlog has been flushed, e.g. because of a connection error, in which
+	// case a GOAWAY frame has been written.
+	[[nodiscard]] bool
+	Receive() noexcept;
+
+	// Writes DATA frames of the response bodies until the flow-control
+	// windows are exhausted, or the send backlog of the connection is
+	// corkedBacklogSize octets large.
+	//
+	// Returns false if the connection should be closed once the send
+	// backlog has been flushed.
+	[[nodiscard]] bool
+	Send() noexcept;
+
+	// Whether Send can write more DATA frames right away.
+	[[nodiscard]] bool
+	IsSending() const noexcept;
+
+	// Stops accepting new streams, and closes the connection once the
+	// current ones are done, e.g. when the connection has lived long
+	// enough.
+	void
+	GoAway() noexcept;
+
+private:
+	struct Stream {
+		std::uint32_t id;
+		std::int64_t window;
+
+		// Keeps the body alive, if it's a file.
+		std::shared_ptr<const IO::CachedFile> file;
+
+		// The rest of the body if it's in memory, otherwise the rest is read
+		// from the file at 'offset'.
+		const char *data;
+		off_t offset;
+		std::size_t remaining;
+
+		bool requestEnded;
+
+		// Keeps the body alive, if it's the listing of a directory, see
+		// HTTP::Configuration::autoIndex.
+		std::shared_ptr<const std::string> listing{};
+
+		// The amount of DATA octets received on the stream since its last
+		// WINDOW_UPDATE.
+		std::size_t unacknowledgedData{ 0 };
+	};
+
+	// The amount of streams reset by the server that are remembered, see
+	// 'resetStreams'.
+	static constexpr std::size_t maxResetStreams = maxConcurrentStreams;
+
+	HTTP::Server &server;
+	Connection &connection;
+
+	HPACK::Decoder decoder;
+
+	// The request being handled, whose fields are copied into the arena.
+	HTTP::Request request;
+	base::Arena arena;
+
+	// The state of the frame being received. The payload of a frame other
+	// than DATA is gathered in 'payload', since it can be larger than the
+	// receive buffer. DATA is discarded as it arrives.
+	bool prefaceReceived{ false };
+	bool settingsReceived{ false };
+	bool hasFrameHeader{ false };
+	FrameHeader frame{};
+	std::size_t frameRemaining{ 0 };
+	std::string payload;
+
+	// The header block being received. While 'headerStreamID' isn't zero,
+	// the block continues in CONTINUATION frames.
+	std::string headerBlock;
+	std::uint32_t headerStreamID{ 0 };
+	bool headerEndStream{ false };
+
+	std::uint32_t lastStreamID{ 0 };
+	std::size_t requestCount{ 0 };
+
+	// The amount of DATA octets received since the last WINDOW_UPDATE of
+	// the connection.
+	std::size_t unacknowledgedData{ 0 };
+
+	// The settings of the peer, and the flow-control window of the
+	// connection for sending.
+	std::int64_t sendWindow{ defaultWindowSize };
+	std::int64_t initialStreamWindow{ defaultWindowSize };
+	std::size_t peerMaxFrameSize{ defaultMaxFrameSize };
+
+	// The static fields are added to the dynamic table of the peer with the
+	// first response, and referred to by index afterwards. If the table of
+	// the peer is too small, they're sent as literals.
+	enum class FieldsState {
+		UNSENT,
+		INDEXED,
+		LITERAL,
+	};
+	FieldsState fieldsState{ FieldsState::UNSENT };
+	std::size_t peerTableSize{ HPACK::defaultTableSize };
+	bool pendingTableSizeUpdate{ false };
+
+	// Whether either side has sent a GOAWAY frame. Streams started after
+	// the GOAWAY of the server are ignored.
+	bool goingAway{ false };
+	std::uint32_t goAwayStreamID{ UINT32_MAX };
+	bool failed{ false };
+
+	std::vector<Stream> streams;
+
+	// The most recent streams the server has reset, on which the frames the
+	// peer sent before it received the RST_STREAM frame are ignored, oldest
+	// first. Other closed streams don't receive frames.
+	//
+	// Spec: RFC 7540 § 5.1
+	std::vector<std::uint32_t> resetStreams;
+
+	// The encoded header block of a response, and the frames it's sent in.
+	std::string responseBlock;
+	std::string responseFrames;
+
+	// The buffer file bodies that aren't in memory are read into, allocated
+	// on first use.
+	std::unique_ptr<char[]> fileBuffer;
+
+	// Decodes the header block of a request on [streamID], and responds to
+	// it.
+	[[nodiscard]] bool
+	HandleHeaderBlock() noexcept;
+
+	// Handles the frame whose payload has been received completely.
+	[[nodiscard]] bool
+	HandleFrame() noexcept;
+
+	[[nodiscard]] bool
+	HandleHeaders() noexcept;
+
+	[[nodiscard]] bool
+	HandleSettings() noexcept;
+
+	[[nodiscard]] bool
+	HandleWindowUpdate() noexcept;
+
+	// Sends a GOAWAY frame with [code], because of a connection error.
+	//
+	// Returns false, for convenience.
+	[[nodiscard]] bool
+	Fail(ErrorCode code) noexcept;
+
+	[[nodiscard]] Stream *
+	FindStream(std::uint32_t streamID) noexcept;
+
+	// Whether the connection should be closed.
+	[[nodiscard]] bool
+	IsDone() const noexcept;
+
+	// Whether the server has reset [streamID], see 'resetStreams'.
+	[[nodiscard]] bool
+	IsReset(std::uint32_t streamID) const noexcept;
+
+	// Removes the stream at [index], which has been answered completely.
+	void
+	FinishStream(std::size_t index) noexcept;
+
+	// Responds to 'request', which has been received on [streamID]. A
+	// policy violation of the request, or a wrong Host header field, is in
+	// [error].
+	void
+	Respond(std::uint32_t streamID, bool requestEnded, HTTP::ClientError error) noexcept;
+
+	// Serves the file of 'request'.
+	void
+	ServeFile(std::uint32_t streamID, bool requestEnded) noexcept;
+
+	// Responds with a body defined in the base/strings.xpp files.
+	void
+	ServeString(std::uint32_t streamID, bool requestEnded, const base::String &statusLine,
+				const MediaType &mediaType, const base::String &body) noexcept;
+
+	// Writes the DATA frame with the next part of the body of [stream].
+	//
+	// Returns success status
+	[[nodiscard]] bool
+	SendData(Stream &stream) noexcept;
+
+	// Writes the frame of [type] with [payload].
+	void
+	SendFrame(FrameType type, std::uint8_t flags, std::uint32_t streamID, std::string_view payload) noexcept;
+
+	// Writes the head of a response, in a HEADERS frame and CONTINUATION
+	// frames if needed. The status code is taken from [statusLine], and
+	// [lines] are extra header fields, like the validators. Without a body,
+	// the stream is closed, otherwise the body is sent by Send once [stream]
+	// is added.
+	void
+	SendHead(std::uint32_t streamID, const base::String &statusLine, std::size_t contentLength,
+			 const MediaType &mediaType, std::string_view lines, bool endStream) noexcept;
+
+	// Writes a RST_STREAM frame with [code], and remembers the stream in
+	// 'resetStreams'.
+	void
+	SendReset(std::uint32_t streamID, ErrorCode code) noexcept;
+
+	// Writes a WINDOW_UPDATE frame, for the connection if [streamID] is
+	// zero.
+	void
+	SendWindowUpdate(std::uint32_t streamID, std::size_t increment) noexcept;
+
+	// Closes the stream after the response without a body, and starts
+	// sending the body otherwise.
+	void
+	StartBody(Stream stream) noexcept;
+};
+
+} // namespace HTTP2
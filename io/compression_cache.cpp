@@ -0,0 +1,126 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include "compression_cache.hpp"
+
+#include <array>
+#include <charconv>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <system_error>
+
+#include <cstdint>
+
+namespace IO {
+
+CompressionCache::CompressionCache(std::size_t capacity) noexcept
+	: shardCapacity(capacity / shardCount) {
+}
+
+void
+CompressionCache::Insert(const File &file, HTTP::ContentCoding coding, std::shared_ptr<const std::string> output) noexcept {
+	if (shardCapacity == 0 || output->length() > shardCapacity) {
+		return;
+	}
+
+	auto key = KeyOf(file, coding);
+	auto &shard = ShardOf(key);
+	std::lock_guard guard(shard.mutex);
+
+	if (auto existing = shard.index.find(key); existing != std::end(shard.index)) {
+		shard.size -= existing->second->output->length();
+		shard.entries.erase(existing->second);
+		shard.index.erase(existing);
+	}
+
+	while (shard.size + output->length() > shardCapacity) {
+		shard.size -= shard.entries.back().output->length();
+		shard.index.erase(shard.entries.back().key);
+		shard.entries.pop_back();
+	}
+
+	shard.size += output->length();
+	shard.entries.push_front({ std::move(key), std::move(output) });
+	shard.index.emplace(shard.entries.front().key, std::begin(shard.entries));
+}
+
+std::string
+CompressionCache::KeyOf(const File &file, HTTP::ContentCoding coding) noexcept {
+	std::string key;
+	WriteKey(file, coding, key);
+	return key;
+}
+
+void
+CompressionCache::WriteKey(const File &file, HTTP::ContentCoding coding, std::string &key) noexcept {
+	const auto &status = file.Status();
+#if defined(__APPLE__)
+	const auto nanoseconds = status.st_mtimespec.tv_nsec;
+#else
+	const auto nanoseconds = status.st_mtim.tv_nsec;
+#endif
+
+	// The path can't contain NUL characters, so it separates the components:
+	// NUL, the seconds, '.', the nanoseconds, NUL and the coding. A number
+	// has at most digits10 + 1 digits and a sign, so the conversions can't
+	// fail, but they are checked so the writes stay visibly in bounds.
+	static_assert(sizeof(status.st_mtime) <= sizeof(std::int64_t));
+	constexpr std::size_t numberLength = std::numeric_limits<std::int64_t>::digits10 + 2;
+	std::array<char, 1 + numberLength + 1 + numberLength + 2> suffix;
+
+	auto *end = suffix.data();
+	auto *const last = suffix.data() + suffix.size();
+	*end++ = '\0';
+
+	auto result = std::to_chars(end, last, static_cast<std::int64_t>(status.st_mtime));
+	if (result.ec != std::errc{} || result.ptr == last) {
+		key.assign(file.Path());
+		return;
+	}
+	end = result.ptr;
+	*end++ = '.';
+
+	result = std::to_chars(end, last, static_cast<std::int64_t>(nanoseconds));
+	if (result.ec != std::errc{} || last - result.ptr < 2) {
+		key.assign(file.Path());
+		return;
+	}
+	end = result.ptr;
+	*end++ = '\0';
+	*end++ = static_cast<char>('0' + static_cast<int>(coding));
+
+	key.assign(file.Path());
+	key.append(suffix.data(), end);
+}
+
+std::shared_ptr<const std::string>
+CompressionCache::Lookup(const File &file, HTTP::ContentCoding coding) noexcept {
+	if (shardCapacity == 0) {
+		return nullptr;
+	}
+
+	// The key is only needed for the lookup, so the buffer is reused.
+	thread_local std::string key;
+	WriteKey(file, coding, key);
+	auto &shard = ShardOf(key);
+	std::lock_guard guard(shard.mutex);
+
+	auto result = shard.index.find(key);
+	if (result == std::end(shard.index)) {
+		return nullptr;
+	}
+
+	shard.entries.splice(std::begin(shard.entries), shard.entries, result->second);
+	return result->second->output;
+}
+
+CompressionCache::Shard &
+CompressionCache::ShardOf(std::string_view key) noexcept {
+	return shards[std::hash<std::string_view>{}(key) % shardCount];
+}
+
+} // namespace IO
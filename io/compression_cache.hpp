@@ -0,0 +1,91 @@
+#pragma once
+
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include <array>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include <cstddef>
+
+#include "http/content_coding.hpp"
+#include "io/file.hpp"
+
+namespace IO {
+
+// A bounded cache of files compressed on the fly, so that every file is
+// compressed once per content-coding, instead of once per response.
+//
+// The entries are keyed by the path, the modification time and the coding, so
+// a changed file gets a new entry and the outdated entry is evicted
+// eventually. Like the FileCache, the cache is split into shards with a lock
+// each, and every shard evicts its least-recently used entries when the total
+// size of its entries would exceed its part of the capacity.
+class CompressionCache {
+public:
+	// [capacity] is the maximum amount of compressed octets. Zero disables
+	// the cache.
+	explicit CompressionCache(std::size_t capacity) noexcept;
+
+	// Returns the output of [file] compressed with [coding], or nullptr if it
+	// isn't cached.
+	[[nodiscard]] std::shared_ptr<const std::string>
+	Lookup(const File &file, HTTP::ContentCoding coding) noexcept;
+
+	// Stores the output of [file] compressed with [coding], if it fits.
+	void
+	Insert(const File &file, HTTP::ContentCoding coding, std::shared_ptr<const std::string> output) noexcept;
+
+	[[nodiscard]] inline bool
+	IsEnabled() const noexcept {
+		return shardCapacity != 0;
+	}
+
+#ifdef TESTING
+public:
+#else
+private:
+#endif
+	struct Entry {
+		std::string key;
+		std::shared_ptr<const std::string> output;
+	};
+
+	struct Shard {
+		std::mutex mutex;
+
+		// The total size of the outputs of the entries.
+		std::size_t size{ 0 };
+
+		// Ordered from the most to the least recently used. The keys of the
+		// index refer to Entry::key.
+		std::list<Entry> entries;
+		std::unordered_map<std::string_view, std::list<Entry>::iterator> index;
+	};
+
+	static constexpr std::size_t shardCount = 16;
+
+	const std::size_t shardCapacity;
+	std::array<Shard, shardCount> shards;
+
+	// The key of the entry of [file] and [coding].
+	[[nodiscard]] static std::string
+	KeyOf(const File &file, HTTP::ContentCoding coding) noexcept;
+
+	[[nodiscard]] Shard &
+	ShardOf(std::string_view key) noexcept;
+
+	// Writes the key of KeyOf into [key].
+	static void
+	WriteKey(const File &file, HTTP::ContentCoding coding, std::string &key) noexcept;
+};
+
+} // namespace IO
@@ -0,0 +1,183 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include "directory_index.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "posix/unistd.hpp"
+
+namespace IO {
+
+namespace {
+
+void
+AppendEscapedHTML(std::string &output, std::string_view text) noexcept {
+	for (const char character : text) {
+		switch (character) {
+			case '&':
+				output.append("&amp;");
+				break;
+			case '<':
+				output.append("&lt;");
+				break;
+			case '>':
+				output.append("&gt;");
+				break;
+			case '"':
+				output.append("&quot;");
+				break;
+			case '\'':
+				output.append("&#39;");
+				break;
+			default:
+				output += character;
+				break;
+		}
+	}
+}
+
+// Appends [name] as a path segment, i.e. percent-encoded except for the
+// unreserved characters.
+//
+// Spec: RFC 3986 § 2.3
+void
+AppendPercentEncoded(std::string &output, std::string_view name) noexcept {
+	constexpr std::string_view digits("0123456789ABCDEF");
+	for (const char character : name) {
+		const auto octet = static_cast<unsigned char>(character);
+		if ((octet >= 'a' && octet <= 'z') || (octet >= 'A' && octet <= 'Z') || (octet >= '0' && octet <= '9') ||
+			octet == '-' || octet == '.' || octet == '_' || octet == '~') {
+			output += character;
+		} else {
+			output += '%';
+			output += digits[octet >> 4];
+			output += digits[octet & 0xF];
+		}
+	}
+}
+
+} // namespace
+
+DirectoryIndex::DirectoryIndex(std::size_t capacity) noexcept
+	: capacity(capacity) {
+}
+
+bool
+DirectoryIndex::Generate(const File &directory, std::string_view path, std::string &output) noexcept {
+	// The stream takes ownership of the descriptor, which the file keeps.
+	const int fd = fcntl(directory.Handle(), F_DUPFD_CLOEXEC, 0);
+	if (fd == -1) {
+		return false;
+	}
+
+	DIR *stream = fdopendir(fd);
+	if (stream == nullptr) {
+		psx::close(fd);
+		return false;
+	}
+	rewinddir(stream);
+
+	// The names of the directories end with a slash.
+	std::vector<std::string> names;
+	while (const auto *entry = readdir(stream)) {
+		const std::string_view name(entry->d_name);
+		if (name.empty() || name.front() == '.') {
+			continue;
+		}
+
+		// Symbolic links are listed by what they refer to.
+		bool isDirectory = entry->d_type == DT_DIR;
+		if (entry->d_type == DT_UNKNOWN || entry->d_type == DT_LNK) {
+			struct stat status{};
+			isDirectory = fstatat(dirfd(stream), entry->d_name, &status, 0) == 0 && S_ISDIR(status.st_mode);
+		}
+
+		names.emplace_back(name);
+		if (isDirectory) {
+			names.back() += '/';
+		}
+	}
+	closedir(stream);
+
+	std::sort(std::begin(names), std::end(names));
+
+	std::string base(path);
+	if (base.empty() || base.back() != '/') {
+		base += '/';
+	}
+
+	output.clear();
+	output.append("<!DOCTYPE html>\n<html><head><meta charset=\"utf-8\"><title>Index of ");
+	AppendEscapedHTML(output, base);
+	output.append("</title></head><body><h1>Index of ");
+	AppendEscapedHTML(output, base);
+	output.append("</h1><ul>\n");
+
+	if (base != "/") {
+		const auto parent = std::string_view(base).substr(0, base.find_last_of('/', base.length() - 2) + 1);
+		output.append("<li><a href=\"");
+		AppendEscapedHTML(output, parent);
+		output.append("\">../</a></li>\n");
+	}
+
+	for (const auto &name : names) {
+		const bool isDirectory = name.back() == '/';
+		const std::string_view segment(name.data(), name.length() - (isDirectory ? 1 : 0));
+
+		output.append("<li><a href=\"");
+		AppendEscapedHTML(output, base);
+		AppendPercentEncoded(output, segment);
+		if (isDirectory) {
+			output += '/';
+		}
+		output.append("\">");
+		AppendEscapedHTML(output, name);
+		output.append("</a></li>\n");
+	}
+
+	output.append("</ul></body></html>\n");
+	return true;
+}
+
+std::shared_ptr<const std::string>
+DirectoryIndex::Listing(const File &directory, std::string_view path) noexcept {
+	const auto version = FileVersion::Of(directory.Status());
+	const std::string key(path);
+
+	{
+		std::lock_guard guard(mutex);
+		const auto entry = entries.find(key);
+		if (entry != std::end(entries) && entry->second.version == version) {
+			return entry->second.listing;
+		}
+	}
+
+	auto listing = std::make_shared<std::string>();
+	if (!Generate(directory, path, *listing)) {
+		return nullptr;
+	}
+
+	// A recently modified directory might change again unnoticed.
+	if (capacity != 0 && version.IsSettled()) {
+		std::lock_guard guard(mutex);
+		if (entries.size() == capacity && entries.find(key) == std::end(entries)) {
+			entries.erase(std::begin(entries));
+		}
+		entries.insert_or_assign(key, Entry{ version, listing });
+	}
+	return listing;
+}
+
+} // namespace IO
@@ -0,0 +1,56 @@
+#pragma once
+
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include <cstddef>
+
+#include "io/file.hpp"
+
+namespace IO {
+
+// The generated listings of directories without an index file, see
+// HTTP::Configuration::autoIndex. A listing is generated when the directory
+// is first requested, and kept until the version of the directory changes
+// (see FileVersion), so large directories aren't read on every request.
+//
+// The listing is an HTML page linking to the entries of the directory, except
+// those starting with a dot, sorted by name.
+class DirectoryIndex {
+public:
+	// [capacity] is the maximum amount of listings kept.
+	explicit DirectoryIndex(std::size_t capacity) noexcept;
+
+	// Returns the listing of [directory], which is at [path] beneath the root
+	// of its site, e.g. "/downloads", or nullptr if it can't be read.
+	[[nodiscard]] std::shared_ptr<const std::string>
+	Listing(const File &directory, std::string_view path) noexcept;
+
+	// Generates the listing, see Listing.
+	//
+	// Returns success status
+	[[nodiscard]] static bool
+	Generate(const File &directory, std::string_view path, std::string &output) noexcept;
+
+private:
+	struct Entry {
+		FileVersion version;
+		std::shared_ptr<const std::string> listing;
+	};
+
+	const std::size_t capacity;
+
+	std::mutex mutex;
+	std::unordered_map<std::string, Entry> entries;
+};
+
+} // namespace IO
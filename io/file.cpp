@@ -6,13 +6,28 @@
 
 #include "file.hpp"
 
+#include <ctime>
+
 #include <fcntl.h>
+#include <sys/mman.h>
 #include <unistd.h>
 
 #include "posix/fcntl.hpp"
 #include "posix/stat.hpp"
 #include "posix/unistd.hpp"
 
+void
+IO::File::Adopt(int handle) noexcept {
+	fd = handle;
+	error = 0;
+
+	if (psx::fstat(fd, &status) == -1) {
+		error = errno;
+		psx::close(fd);
+		fd = -1;
+	}
+}
+
 void
 IO::File::InternalInit(const char *path) {
 	if (fd != -1) {
@@ -33,8 +48,48 @@ IO::File::InternalInit(const char *path) {
 	}
 }
 
+bool
+IO::File::Map() noexcept {
+	if (mapping != nullptr) {
+		return true;
+	}
+
+	if (fd == -1 || Size() == 0) {
+		return false;
+	}
+
+	void *address = mmap(nullptr, Size(), PROT_READ, MAP_SHARED, fd, 0);
+	if (address == MAP_FAILED) {
+		return false;
+	}
+
+	// The file is mapped because it is served often, so fault it in now.
+	static_cast<void>(madvise(address, Size(), MADV_WILLNEED));
+	mapping = static_cast<const char *>(address);
+	return true;
+}
+
 IO::File::~File() noexcept {
+	if (mapping != nullptr) {
+		munmap(const_cast<char *>(mapping), Size());
+	}
+
 	if (fd != -1) {
 		psx::close(fd);
 	}
 }
+
+IO::FileVersion
+IO::FileVersion::Of(const struct stat &status) noexcept {
+#if defined(__APPLE__)
+	const auto nanoseconds = status.st_mtimespec.tv_nsec;
+#else
+	const auto nanoseconds = status.st_mtim.tv_nsec;
+#endif
+	return { status.st_ino, status.st_mtime, static_cast<long>(nanoseconds) };
+}
+
+bool
+IO::FileVersion::IsSettled() const noexcept {
+	return std::time(nullptr) - seconds >= 1;
+}
@@ -7,11 +7,37 @@
  */
 
 #include <string>
+#include <string_view>
+#include <utility>
 
 #include <cstddef>
+#include <ctime>
 #include <sys/stat.h>
 
 namespace IO {
+
+// Identifies a version of a file by its inode and modification time. The
+// modification time of a directory changes when an entry is added, removed
+// or renamed, so the version of a directory identifies its entries.
+struct FileVersion {
+	ino_t inode{ 0 };
+	time_t seconds{ 0 };
+	long nanoseconds{ 0 };
+
+	[[nodiscard]] static FileVersion
+	Of(const struct stat &status) noexcept;
+
+	// Whether the version is at least a second old. Modifications within the
+	// granularity of the timestamps of the file system might not change the
+	// modification time, so a newer version might be succeeded unnoticed.
+	[[nodiscard]] bool
+	IsSettled() const noexcept;
+
+	[[nodiscard]] inline bool
+	operator==(const FileVersion &other) const noexcept {
+		return inode == other.inode && seconds == other.seconds && nanoseconds == other.nanoseconds;
+	}
+};
 class File {
 	friend class FileResolver;
 
@@ -20,6 +46,11 @@ public:
 		InternalInit(path);
 	}
 
+	// Takes ownership of [handle], which has been opened for [path].
+	inline File(int handle, std::string path) noexcept : fd(-1), internalPath(std::move(path)) {
+		Adopt(handle);
+	}
+
 	~File() noexcept;
 
 	[[nodiscard]] inline constexpr int
@@ -37,6 +68,19 @@ public:
 		return status.st_size;
 	}
 
+	// The status of the file, as retrieved by fstat(2) when it was opened.
+	[[nodiscard]] inline constexpr const struct stat &
+	Status() const noexcept {
+		return status;
+	}
+
+	// The time of the last modification of the contents, in seconds since
+	// the epoch.
+	[[nodiscard]] inline constexpr time_t
+	ModificationTime() const noexcept {
+		return status.st_mtime;
+	}
+
 	[[nodiscard]] inline constexpr bool
 	IsNormalFile() const noexcept {
 		return S_ISREG(status.st_mode);
@@ -52,7 +96,26 @@ public:
 		return internalPath;
 	}
 
+	// Maps the contents of the file into memory with mmap(2), which lasts
+	// until the file is destroyed. Returns false if the file couldn't be
+	// mapped, e.g. because it is empty.
+	//
+	// NOTE: Accessing a mapping of a file that has been truncated since
+	//       raises SIGBUS, so files that might be mapped should be replaced
+	//       (rename(2)) instead of rewritten in place.
+	[[nodiscard]] bool
+	Map() noexcept;
+
+	// The contents of the file as mapped by Map, or empty if it isn't mapped.
+	[[nodiscard]] inline std::string_view
+	Mapping() const noexcept {
+		return mapping == nullptr ? std::string_view() : std::string_view(mapping, Size());
+	}
+
 protected:
+	void
+	Adopt(int handle) noexcept;
+
 	void
 	InternalInit(const char *);
 
@@ -61,6 +124,7 @@ private:
 	int error;
 	std::string internalPath;
 	struct stat status;
+	const char *mapping{ nullptr };
 };
 
 } // namespace IO
@@ -0,0 +1,452 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include "file_cache.hpp"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <unordered_set>
+#include <utility>
+
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
+#include <ctime>
+#include <poll.h>
+
+#if defined(__linux__)
+#include <sys/inotify.h>
+#elif defined(__FreeBSD__) || defined(__APPLE__) || defined(__NetBSD__) || defined(__OpenBSD__)
+#define FILE_CACHE_USE_KQUEUE
+#include <sys/event.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#endif
+
+#include "base/logger.hpp"
+#include "base/numa.hpp"
+#include "posix/unistd.hpp"
+
+// The amount of milliseconds the watcher waits for changes, before checking
+// whether it should stop.
+#define MAGIC_FILE_CACHE_WATCH_TIMEOUT 250
+
+namespace IO {
+
+FileCache::FileCache(std::size_t capacity, std::size_t maxContentSize, std::size_t maxMappedSize,
+					 std::size_t nodeCount) noexcept
+	: shardCapacity((capacity + shardCount - 1) / shardCount), maxContentSize(maxContentSize),
+	  maxMappedSize(maxMappedSize), nodeCount(std::max<std::size_t>(nodeCount, 1)),
+	  shards(this->nodeCount * shardCount) {
+}
+
+FileCache::~FileCache() noexcept {
+	stopWatching = true;
+	if (watchThread.joinable()) {
+		watchThread.join();
+	}
+
+	if (watcher != -1) {
+		psx::close(watcher);
+	}
+}
+
+void
+FileCache::Clear() noexcept {
+	Invalidate([](const Entry &) { return true; });
+}
+
+bool
+FileCache::Initialize() noexcept {
+	if (shardCapacity == 0) {
+		return true;
+	}
+
+#if defined(__linux__)
+	watcher = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#elif defined(FILE_CACHE_USE_KQUEUE)
+	watcher = kqueue();
+#endif
+
+	if (watcher == -1) {
+		Logger::Warning("FileCache", "Can't watch files for changes, so they won't be cached");
+		return false;
+	}
+
+	watchThread = std::thread(&FileCache::RunWatcher, this);
+	return true;
+}
+
+// Computes the entity-tag and validator headers of [cachedFile].
+static void
+ComputeValidators(CachedFile &cachedFile) noexcept {
+	const auto &status = cachedFile.file->Status();
+#if defined(__APPLE__)
+	const auto nanoseconds = status.st_mtimespec.tv_nsec;
+#else
+	const auto nanoseconds = status.st_mtim.tv_nsec;
+#endif
+
+	// Enough for W/"", 3 hyphens and 4 hexadecimal 64-bit values.
+	std::array<char, 72> tag;
+	auto *end = tag.data();
+	if (std::time(nullptr) - status.st_mtime < 1) {
+		*end++ = 'W';
+		*end++ = '/';
+	}
+	*end++ = '"';
+	for (const auto value : { static_cast<std::uint64_t>(status.st_ino), static_cast<std::uint64_t>(status.st_size),
+							  static_cast<std::uint64_t>(status.st_mtime), static_cast<std::uint64_t>(nanoseconds) }) {
+		if (end[-1] != '"') {
+			*end++ = '-';
+		}
+		end = std::to_chars(end, tag.data() + tag.size(), value, 16).ptr;
+	}
+	*end++ = '"';
+	cachedFile.entityTag.assign(tag.data(), end);
+
+	std::array<char, HTTP::dateLength> lastModified;
+	HTTP::FormatDate(status.st_mtime, lastModified);
+
+	auto &headers = cachedFile.validatorHeaders;
+	headers.reserve(32 + cachedFile.entityTag.length() + lastModified.size());
+	headers.append("ETag: ");
+	headers.append(cachedFile.entityTag);
+	headers.append("\r\nLast-Modified: ");
+	headers.append(lastModified.data(), lastModified.size());
+	headers.append("\r\n");
+}
+
+// Whether the entity-tag of [cachedFile] or of one of its siblings is weak,
+// while it could be strong by now. See ComputeValidators.
+[[nodiscard]] static bool
+IsWeakenedNeedlessly(const CachedFile &cachedFile, std::time_t now) noexcept {
+	const auto isWeakened = [now](const CachedFile &file) {
+		return file.entityTag.rfind("W/", 0) == 0 && now - file.file->Status().st_mtime >= 1;
+	};
+
+	return isWeakened(cachedFile) || std::any_of(std::cbegin(cachedFile.encodings), std::cend(cachedFile.encodings),
+		[&isWeakened](const auto &encoding) { return encoding != nullptr && isWeakened(*encoding); });
+}
+
+void
+FileCache::Erase(std::size_t shardIndex, std::list<Entry>::iterator entry) noexcept {
+	auto &shard = shards[shardIndex];
+	{
+		const std::lock_guard guard(watchMutex);
+		if (auto files = watched.find(entry->watch); files != std::end(watched)) {
+			if (auto file = files->second.find(entry->name); file != std::end(files->second)) {
+				auto &entries = file->second;
+				entries.erase(std::remove_if(std::begin(entries), std::end(entries), [&](const WatchedEntry &watchedEntry) {
+					return watchedEntry.shard == shardIndex && watchedEntry.path == entry->path;
+				}), std::end(entries));
+
+				if (entries.empty()) {
+					files->second.erase(file);
+				}
+			}
+
+			if (files->second.empty()) {
+				watched.erase(files);
+			}
+		}
+	}
+
+	shard.index.erase(entry->path);
+	shard.entries.erase(entry);
+}
+
+std::shared_ptr<const CachedFile>
+FileCache::Insert(std::string_view path, std::unique_ptr<File> file, const MediaType &mediaType,
+				  std::array<std::unique_ptr<File>, HTTP::contentCodingCount> encodings) noexcept {
+	auto cachedFile = std::make_shared<CachedFile>();
+	cachedFile->file = std::move(file);
+	cachedFile->mediaType = &mediaType;
+	ComputeValidators(*cachedFile);
+
+	// The siblings are kept mutable until their contents have been loaded.
+	std::array<std::shared_ptr<CachedFile>, HTTP::contentCodingCount> encoded;
+	for (std::size_t i = 1; i < encodings.size(); i++) {
+		if (encodings[i] != nullptr) {
+			encoded[i] = std::make_shared<CachedFile>();
+			encoded[i]->file = std::move(encodings[i]);
+			encoded[i]->mediaType = &mediaType;
+			encoded[i]->coding = static_cast<HTTP::ContentCoding>(i);
+			ComputeValidators(*encoded[i]);
+		}
+	}
+
+	const auto publishEncodings = [&cachedFile, &encoded] {
+		std::copy(std::cbegin(encoded), std::cend(encoded), std::begin(cachedFile->encodings));
+	};
+
+	if (watcher == -1) {
+		publishEncodings();
+		return cachedFile;
+	}
+
+	// An invalidation between watching and storing the entry might be missed,
+	// in which case the entry shouldn't be stored.
+	const auto generation = invalidations.load();
+
+	Entry entry{ std::string(path), cachedFile, -1, {} };
+	const bool loaded = Watch(entry) && LoadContents(*cachedFile) &&
+		std::all_of(std::cbegin(encoded), std::cend(encoded), [this](const auto &encoding) {
+			return encoding == nullptr || LoadContents(*encoding);
+		});
+
+	publishEncodings();
+	if (!loaded) {
+		return cachedFile;
+	}
+
+	auto &shard = ShardOf(path);
+	const auto shardIndex = IndexOf(shard);
+	std::lock_guard guard(shard.mutex);
+
+	if (generation != invalidations.load()) {
+		return cachedFile;
+	}
+
+	if (auto existing = shard.index.find(path); existing != std::end(shard.index)) {
+		Erase(shardIndex, existing->second);
+	} else if (shard.entries.size() == shardCapacity) {
+		Erase(shardIndex, std::prev(std::end(shard.entries)));
+	}
+
+	shard.entries.push_front(std::move(entry));
+	const auto &stored = shard.entries.front();
+	shard.index.emplace(stored.path, std::begin(shard.entries));
+
+	const std::lock_guard watchGuard(watchMutex);
+	watched[stored.watch][stored.name].push_back({ shardIndex, stored.path });
+	return cachedFile;
+}
+
+bool
+FileCache::LoadContents(CachedFile &file) const noexcept {
+	const int fd = file.file->Handle();
+	const auto size = file.file->Size();
+	if (size > maxContentSize) {
+		// Failing to map the file isn't fatal, it is sent from the file then.
+		if (size <= maxMappedSize) {
+			static_cast<void>(file.file->Map());
+		}
+		return true;
+	}
+
+	file.contents.resize(size);
+
+	std::size_t offset = 0;
+	while (offset != size) {
+		const auto result = psx::pread(fd, file.contents.data() + offset, size - offset, static_cast<off_t>(offset));
+		if (result <= 0) {
+			return false;
+		}
+		offset += result;
+	}
+
+	file.hasContents = true;
+	return true;
+}
+
+template <typename Predicate>
+void
+FileCache::Invalidate(Predicate predicate) noexcept {
+	invalidations++;
+
+	for (std::size_t shardIndex = 0; shardIndex < shards.size(); shardIndex++) {
+		auto &shard = shards[shardIndex];
+		std::lock_guard guard(shard.mutex);
+
+		for (auto it = std::begin(shard.entries); it != std::end(shard.entries);) {
+			const auto next = std::next(it);
+			if (predicate(*it)) {
+				Erase(shardIndex, it);
+			}
+			it = next;
+		}
+	}
+}
+
+void
+FileCache::InvalidateWatch(int watch, const std::string_view *name) noexcept {
+	invalidations++;
+
+	// The entries are collected first, since the shards are locked before
+	// 'watchMutex'.
+	std::vector<std::pair<WatchedEntry, std::string>> affected;
+	{
+		const std::lock_guard guard(watchMutex);
+		const auto files = watched.find(watch);
+		if (files == std::end(watched)) {
+			return;
+		}
+
+		const auto collect = [&affected](const std::string &fileName, const std::vector<WatchedEntry> &entries) {
+			for (const auto &entry : entries) {
+				affected.emplace_back(entry, fileName);
+			}
+		};
+
+		if (name == nullptr) {
+			for (const auto &file : files->second) {
+				collect(file.first, file.second);
+			}
+		} else {
+			// Siblings like "style.css.br" also invalidate "style.css".
+			for (auto end = name->find('.'); ; end = name->find('.', end + 1)) {
+				const std::string fileName(name->substr(0, end));
+				if (const auto file = files->second.find(fileName); file != std::end(files->second)) {
+					collect(file->first, file->second);
+				}
+
+				if (end == std::string_view::npos) {
+					break;
+				}
+			}
+		}
+	}
+
+	for (const auto &[watchedEntry, fileName] : affected) {
+		auto &shard = shards[watchedEntry.shard];
+		std::lock_guard guard(shard.mutex);
+
+		// The entry might have been replaced by one of another file since.
+		const auto entry = shard.index.find(watchedEntry.path);
+		if (entry != std::end(shard.index) && entry->second->watch == watch && entry->second->name == fileName) {
+			Erase(watchedEntry.shard, entry->second);
+		}
+	}
+}
+
+std::shared_ptr<const CachedFile>
+FileCache::Lookup(std::string_view path) noexcept {
+	if (watcher == -1) {
+		return nullptr;
+	}
+
+	auto &shard = ShardOf(path);
+	std::lock_guard guard(shard.mutex);
+
+	auto result = shard.index.find(path);
+	if (result == std::end(shard.index)) {
+		return nullptr;
+	}
+
+	// The entity-tag is computed again when the file is stored again.
+	if (IsWeakenedNeedlessly(*result->second->file, std::time(nullptr))) {
+		Erase(IndexOf(shard), result->second);
+		return nullptr;
+	}
+
+	shard.entries.splice(std::begin(shard.entries), shard.entries, result->second);
+	return result->second->file;
+}
+
+std::vector<std::string>
+FileCache::Paths() noexcept {
+	std::vector<std::string> paths;
+
+	// The partitions of the nodes mostly hold the same files.
+	std::unordered_set<std::string> seen;
+	for (auto &shard : shards) {
+		std::lock_guard guard(shard.mutex);
+		for (const auto &entry : shard.entries) {
+			if (nodeCount == 1 || seen.insert(entry.path).second) {
+				paths.push_back(entry.path);
+			}
+		}
+	}
+	return paths;
+}
+
+void
+FileCache::RunWatcher() noexcept {
+	struct pollfd pollAction;
+	pollAction.fd = watcher;
+	pollAction.events = POLLIN;
+
+#if defined(__linux__)
+	alignas(struct inotify_event) std::array<char, 4096> buffer;
+
+	while (!stopWatching) {
+		pollAction.revents = 0;
+		if (poll(&pollAction, 1, MAGIC_FILE_CACHE_WATCH_TIMEOUT) <= 0) {
+			continue;
+		}
+
+		const auto length = psx::read(watcher, buffer.data(), buffer.size());
+		for (ssize_t offset = 0; offset < length;) {
+			const auto *event = reinterpret_cast<const struct inotify_event *>(buffer.data() + offset);
+			offset += sizeof(struct inotify_event) + event->len;
+
+			if (event->mask & IN_Q_OVERFLOW) {
+				Clear();
+			} else if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+				InvalidateWatch(event->wd, nullptr);
+			} else if (event->len != 0) {
+				const std::string_view name(event->name);
+				InvalidateWatch(event->wd, &name);
+			}
+		}
+	}
+#elif defined(FILE_CACHE_USE_KQUEUE)
+	std::array<struct kevent, 64> events;
+	const struct timespec timeout { 0, MAGIC_FILE_CACHE_WATCH_TIMEOUT * 1000000L };
+
+	while (!stopWatching) {
+		const int count = kevent(watcher, nullptr, 0, events.data(), static_cast<int>(events.size()), &timeout);
+		for (int i = 0; i < count; i++) {
+			InvalidateWatch(static_cast<int>(events[i].ident), nullptr);
+		}
+	}
+#endif
+}
+
+FileCache::Shard &
+FileCache::ShardOf(std::string_view path) noexcept {
+	const auto node = std::min(base::CurrentNumaNode(), nodeCount - 1);
+	return shards[node * shardCount + std::hash<std::string_view>{}(path) % shardCount];
+}
+
+bool
+FileCache::Watch(Entry &entry) noexcept {
+#if defined(__linux__)
+	// Watch the directory the file is actually in, which also reports
+	// replacing the file with rename(2).
+	std::array<char, PATH_MAX> resolved{};
+	if (realpath(entry.file->file->Path().c_str(), resolved.data()) == nullptr) {
+		return false;
+	}
+
+	std::string directory(resolved.data());
+	const auto slash = directory.find_last_of('/');
+	entry.name = directory.substr(slash + 1);
+	directory.resize(std::max<std::size_t>(slash, 1));
+
+	entry.watch = inotify_add_watch(watcher, directory.c_str(),
+		IN_ATTRIB | IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_DELETE_SELF |
+		IN_MODIFY | IN_MOVE_SELF | IN_MOVED_FROM | IN_MOVED_TO);
+	return entry.watch != -1;
+#elif defined(FILE_CACHE_USE_KQUEUE)
+	entry.watch = entry.file->file->Handle();
+
+	struct kevent change;
+	EV_SET(&change, entry.watch, EVFILT_VNODE, EV_ADD | EV_CLEAR,
+		   NOTE_ATTRIB | NOTE_DELETE | NOTE_EXTEND | NOTE_RENAME | NOTE_REVOKE | NOTE_WRITE, 0, nullptr);
+	return kevent(watcher, &change, 1, nullptr, 0, nullptr) != -1;
+#else
+	static_cast<void>(entry);
+	return false;
+#endif
+}
+
+} // namespace IO
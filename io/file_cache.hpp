@@ -0,0 +1,238 @@
+#pragma once
+
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include <array>
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "http/content_coding.hpp"
+#include "http/date.hpp"
+#include "io/file.hpp"
+
+// Forward-decl from base/media_type.hpp
+struct MediaType;
+
+namespace IO {
+
+// A file as served by the server. While the entry is referenced, the file
+// stays open, even when the entry is evicted from or invalidated in the cache.
+struct CachedFile {
+	std::unique_ptr<File> file;
+	const MediaType *mediaType;
+
+	// Whether the contents of the file are stored in 'contents', which is the
+	// case for small files. Somewhat larger files are mapped instead, see
+	// File::Map.
+	bool hasContents{ false };
+	std::string contents;
+
+	// The contents of the file if they're in memory, i.e. stored or mapped.
+	// Empty otherwise.
+	[[nodiscard]] inline std::string_view
+	Memory() const noexcept {
+		return hasContents ? std::string_view(contents) : file->Mapping();
+	}
+
+	// The entity-tag of the file, derived from the inode, size and
+	// modification time. It is weak when the file was modified during the
+	// second it was opened, since another modification within that second
+	// might not change the modification time. The cache drops such an entry
+	// once that second has passed, so it is stored again with a strong one.
+	//
+	// Spec: RFC 7232 § 2.3
+	std::string entityTag;
+
+	// The ETag and Last-Modified header fields, each followed by a CRLF.
+	std::string validatorHeaders;
+
+	// The content-coding of the file, i.e. of a precompressed sibling.
+	HTTP::ContentCoding coding{ HTTP::ContentCoding::IDENTITY };
+
+	// The precompressed siblings of the file by coding, which are nullptr if
+	// they don't exist. They are stored with the file, so whether they exist
+	// is known without looking them up for every request.
+	std::array<std::shared_ptr<const CachedFile>, HTTP::contentCodingCount> encodings;
+
+	[[nodiscard]] inline bool
+	HasEncodings() const noexcept {
+		for (const auto &encoding : encodings) {
+			if (encoding != nullptr) {
+				return true;
+			}
+		}
+		return false;
+	}
+};
+
+// A bounded cache of the files served, keyed by the path of the request. The
+// cache is split into shards with a lock each, and every shard evicts its
+// least-recently used entry when full.
+//
+// The entries are invalidated when the file is changed, moved or removed,
+// which is detected with inotify(7) on Linux and kqueue(2) on the BSDs. When
+// this isn't available, or the capacity is zero, nothing is cached. On Linux,
+// changes to the files next to it with the same name and another extension
+// invalidate the entry too, so creating or changing a precompressed sibling is
+// noticed. kqueue(2) only watches the file itself.
+//
+// On machines with several NUMA nodes, the cache can be partitioned by node
+// (see base::NumaTopology), so the threads of a node look up and store the
+// entries in a partition of their own, which stays in the memory of that
+// node. A file is then cached once per node.
+class FileCache {
+public:
+	// [capacity] is the maximum amount of entries, and thus of open files.
+	// Files of at most [maxContentSize] octets are kept in memory, and larger
+	// files of at most [maxMappedSize] octets are mapped into memory. The
+	// cache has a partition for each of the [nodeCount] nodes, each of
+	// [capacity] entries, see base::CurrentNumaNode.
+	FileCache(std::size_t capacity, std::size_t maxContentSize, std::size_t maxMappedSize = 0,
+			  std::size_t nodeCount = 1) noexcept;
+
+	~FileCache() noexcept;
+
+	// Starts watching for changes. Returns false if the cache is disabled
+	// because changes can't be watched.
+	[[nodiscard]] bool
+	Initialize() noexcept;
+
+	// Returns the entry of [path], or nullptr if it isn't cached.
+	[[nodiscard]] std::shared_ptr<const CachedFile>
+	Lookup(std::string_view path) noexcept;
+
+	// Wraps [file] and its precompressed siblings [encodings] (see
+	// FileResolver::ResolveEncodings) in an entry and stores it under [path],
+	// if possible. The entry is returned regardless.
+	[[nodiscard]] std::shared_ptr<const CachedFile>
+	Insert(std::string_view path, std::unique_ptr<File> file, const MediaType &mediaType,
+		   std::array<std::unique_ptr<File>, HTTP::contentCodingCount> encodings = {}) noexcept;
+
+	// Removes all entries.
+	void
+	Clear() noexcept;
+
+	[[nodiscard]] inline std::size_t
+	NodeCount() const noexcept {
+		return nodeCount;
+	}
+
+	// Returns the paths of the entries, from the most to the least recently
+	// used within each shard, once even when cached by several nodes. See
+	// FileCacheManifest.
+	[[nodiscard]] std::vector<std::string>
+	Paths() noexcept;
+
+#ifdef TESTING
+public:
+#else
+private:
+#endif
+	struct Entry {
+		std::string path;
+		std::shared_ptr<const CachedFile> file;
+
+		// The identity of the file for the watcher: the watch descriptor of
+		// the directory and the name of the file on Linux, the file
+		// descriptor on the BSDs.
+		int watch;
+		std::string name;
+	};
+
+	struct Shard {
+		std::mutex mutex;
+
+		// Ordered from the most to the least recently used. The keys of the
+		// index refer to Entry::path.
+		std::list<Entry> entries;
+		std::unordered_map<std::string_view, std::list<Entry>::iterator> index;
+	};
+
+	// An entry registered for the identity of its file, see 'watched'.
+	struct WatchedEntry {
+		std::size_t shard;
+		std::string path;
+	};
+
+	static constexpr std::size_t shardCount = 16;
+
+	const std::size_t shardCapacity;
+	const std::size_t maxContentSize;
+	const std::size_t maxMappedSize;
+	const std::size_t nodeCount;
+
+	// The shards of node N are those from N * shardCount.
+	std::vector<Shard> shards;
+
+	// The inotify or kqueue descriptor, -1 when disabled.
+	int watcher{ -1 };
+	std::atomic<bool> stopWatching{ false };
+	std::thread watchThread;
+
+	// Incremented by every invalidation. See Insert.
+	std::atomic<std::uint64_t> invalidations{ 0 };
+
+	// The stored entries by Entry::watch and Entry::name, so the watcher
+	// locks only the shards of the entries of a changed file. Guarded by
+	// 'watchMutex', which is taken while a shard is locked, and never the
+	// other way around.
+	std::mutex watchMutex;
+	std::unordered_map<int, std::unordered_map<std::string, std::vector<WatchedEntry>>> watched;
+
+	// Removes [entry] of [shard], whose mutex is locked.
+	void
+	Erase(std::size_t shard, std::list<Entry>::iterator entry) noexcept;
+
+	// Removes the entries for which [predicate] returns true.
+	template <typename Predicate>
+	void
+	Invalidate(Predicate predicate) noexcept;
+
+	// Removes the entries of the file [name] watched by [watch], or of every
+	// file of [watch] if [name] is nullptr. On Linux, the entries of a file
+	// named like [name] without one or more extensions are removed too, so
+	// a precompressed sibling invalidates the file.
+	void
+	InvalidateWatch(int watch, const std::string_view *name) noexcept;
+
+	// Reads the contents of [file] into memory, or maps them, if it is small
+	// enough. Returns false if reading failed.
+	[[nodiscard]] bool
+	LoadContents(CachedFile &file) const noexcept;
+
+	// Returns the shard of [path] in the partition of the node of the calling
+	// thread.
+	[[nodiscard]] Shard &
+	ShardOf(std::string_view path) noexcept;
+
+	// Returns the index of [shard] in 'shards'.
+	[[nodiscard]] inline std::size_t
+	IndexOf(const Shard &shard) const noexcept {
+		return static_cast<std::size_t>(&shard - shards.data());
+	}
+
+	// Starts watching the entry for changes. Returns false if the entry
+	// can't be watched, and therefore shouldn't be cached.
+	[[nodiscard]] bool
+	Watch(Entry &entry) noexcept;
+
+	// The function of 'watchThread'.
+	void
+	RunWatcher() noexcept;
+};
+
+} // namespace IO
@@ -0,0 +1,127 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include "file_cache_manifest.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+
+#include "posix/unistd.hpp"
+
+// Identifies the format, see FileCacheManifest.
+#define MAGIC_FILE_CACHE_MANIFEST_SIGNATURE "WSCACHE1"
+#define MAGIC_FILE_CACHE_MANIFEST_SIGNATURE_LENGTH 8
+
+namespace IO {
+
+namespace {
+
+constexpr std::size_t headerLength = MAGIC_FILE_CACHE_MANIFEST_SIGNATURE_LENGTH + sizeof(std::uint32_t);
+
+[[nodiscard]] bool
+WriteFully(int fd, const char *data, std::size_t length) noexcept {
+	while (length != 0) {
+		const auto result = psx::write(fd, data, length);
+		if (result <= 0) {
+			return false;
+		}
+		data += result;
+		length -= static_cast<std::size_t>(result);
+	}
+	return true;
+}
+
+[[nodiscard]] inline std::uint32_t
+ReadUInt32(const char *data) noexcept {
+	std::uint32_t value;
+	std::memcpy(&value, data, sizeof(value));
+	return value;
+}
+
+} // namespace
+
+bool
+FileCacheManifest::Load(const std::string &fileName) noexcept {
+	count = 0;
+	ends = nullptr;
+	paths = {};
+
+	file = std::make_unique<File>(fileName.c_str());
+	if (file->Handle() == -1 || !file->IsNormalFile() || !file->Map()) {
+		return false;
+	}
+
+	const auto mapping = file->Mapping();
+	if (mapping.length() < headerLength ||
+		mapping.compare(0, MAGIC_FILE_CACHE_MANIFEST_SIGNATURE_LENGTH, MAGIC_FILE_CACHE_MANIFEST_SIGNATURE) != 0) {
+		return false;
+	}
+
+	const std::size_t pathCount = ReadUInt32(mapping.data() + MAGIC_FILE_CACHE_MANIFEST_SIGNATURE_LENGTH);
+	if (pathCount > (mapping.length() - headerLength) / sizeof(std::uint32_t)) {
+		return false;
+	}
+
+	const char *table = mapping.data() + headerLength;
+	const auto tableEnd = headerLength + pathCount * sizeof(std::uint32_t);
+
+	// The offsets are checked once, so the paths can be accessed without.
+	std::uint32_t previous = 0;
+	for (std::size_t i = 0; i < pathCount; i++) {
+		const auto end = ReadUInt32(table + i * sizeof(std::uint32_t));
+		if (end < previous || end > mapping.length() - tableEnd) {
+			return false;
+		}
+		previous = end;
+	}
+
+	count = pathCount;
+	ends = table;
+	paths = mapping.substr(tableEnd);
+	return true;
+}
+
+std::string_view
+FileCacheManifest::operator[](std::size_t index) const noexcept {
+	const std::size_t begin = index == 0 ? 0 : ReadUInt32(ends + (index - 1) * sizeof(std::uint32_t));
+	const std::size_t end = ReadUInt32(ends + index * sizeof(std::uint32_t));
+	return paths.substr(begin, end - begin);
+}
+
+bool
+FileCacheManifest::Save(const std::string &fileName, const std::vector<std::string> &paths) noexcept {
+	std::string contents(MAGIC_FILE_CACHE_MANIFEST_SIGNATURE);
+	const auto count = static_cast<std::uint32_t>(paths.size());
+	contents.append(reinterpret_cast<const char *>(&count), sizeof(count));
+
+	std::uint32_t end = 0;
+	for (const auto &path : paths) {
+		end += static_cast<std::uint32_t>(path.length());
+		contents.append(reinterpret_cast<const char *>(&end), sizeof(end));
+	}
+	for (const auto &path : paths) {
+		contents.append(path);
+	}
+
+	const std::string temporaryName = fileName + ".tmp";
+	const int fd = open(temporaryName.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd == -1) {
+		return false;
+	}
+
+	const bool written = WriteFully(fd, contents.data(), contents.length());
+	if (psx::close(fd) != 0 || !written || std::rename(temporaryName.c_str(), fileName.c_str()) != 0) {
+		std::remove(temporaryName.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+} // namespace IO
@@ -0,0 +1,63 @@
+#pragma once
+
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <cstddef>
+
+#include "io/file.hpp"
+
+namespace IO {
+
+// A snapshot of the keys of the file cache, i.e. the paths of the files that
+// were served, so a restarted server can warm its cache with the same files
+// without walking the root directories.
+//
+// The manifest is mapped into memory as it is, since the format is a table of
+// the end offsets of the paths, followed by the paths:
+//   8 octets   "WSCACHE1"
+//   4 octets   the amount of paths (N), in host byte order
+//   4N octets  the end offset of each path in the paths that follow
+//   ...        the paths, without separators
+class FileCacheManifest {
+public:
+	// Writes [paths] to [fileName]. The manifest is written to a temporary
+	// file that replaces it, so a mapped manifest stays intact.
+	//
+	// Returns success status
+	[[nodiscard]] static bool
+	Save(const std::string &fileName, const std::vector<std::string> &paths) noexcept;
+
+	// Maps the manifest at [fileName].
+	//
+	// Returns false if it doesn't exist, or is malformed
+	[[nodiscard]] bool
+	Load(const std::string &fileName) noexcept;
+
+	[[nodiscard]] inline std::size_t
+	Size() const noexcept {
+		return count;
+	}
+
+	// Returns the path at [index], which refers to the mapping.
+	[[nodiscard]] std::string_view
+	operator[](std::size_t index) const noexcept;
+
+private:
+	std::unique_ptr<File> file;
+	std::size_t count{ 0 };
+
+	// Refer to the mapping.
+	const char *ends{ nullptr };
+	std::string_view paths;
+};
+
+} // namespace IO
@@ -6,12 +6,34 @@
 
 #include "file_resolver.hpp"
 
-#include <iostream>
-#include <sstream>
+#include <array>
+#include <atomic>
+#include <mutex>
+
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
 
 #include <fcntl.h>
 #include <unistd.h>
 
+#if defined(__linux__) && __has_include(<linux/openat2.h>)
+#define FILE_RESOLVER_USE_OPENAT2
+#include <linux/openat2.h>
+#include <sys/syscall.h>
+#endif
+
+#include "posix/unistd.hpp"
+
+// The maximum amount of directories without an index the resolver remembers.
+#define MAGIC_FILE_RESOLVER_MAX_DIRECTORIES_WITHOUT_INDEX 1024
+
+// The flags of the files opened beneath the root. Opening a FIFO or a device
+// node would otherwise block the thread, e.g. a worker with all of its
+// connections, until there is a writer. Those aren't normal files, so they
+// are rejected before they're read, and regular files ignore O_NONBLOCK.
+#define FILE_RESOLVER_OPEN_FLAGS (O_RDONLY | O_CLOEXEC | O_NONBLOCK)
+
 [[nodiscard]]
 IO::FileResolveStatus
 ResolveErrno() noexcept {
@@ -19,35 +41,197 @@ ResolveErrno() noexcept {
 		case EACCES:
 			return IO::FileResolveStatus::INSUFFICIENT_PERMISSIONS;
 		case EMFILE:
+		case ENFILE:
 			return IO::FileResolveStatus::FILE_SYSTEM_OVERLOAD;
+		case EXDEV:
+			return IO::FileResolveStatus::OUTSIDE_ROOT_DIRECTORY;
 		default:
 			return IO::FileResolveStatus::NOT_FOUND;
 	}
 }
 
+IO::FileResolver::FileResolver(const std::string &rootDirectory) noexcept
+	: root(rootDirectory) {
+	rootHandle = open(root.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+	std::array<char, PATH_MAX> resolved{};
+	if (realpath(root.c_str(), resolved.data()) != nullptr) {
+		resolvedRoot = resolved.data();
+	}
+}
+
+IO::FileResolver::~FileResolver() noexcept {
+	if (rootHandle != -1) {
+		psx::close(rootHandle);
+	}
+}
+
+bool
+IO::FileResolver::NormalizePath(std::string_view path, std::string &relativePath) noexcept {
+	relativePath.clear();
+
+	while (!path.empty()) {
+		const auto slash = path.find('/');
+		const auto segment = path.substr(0, slash);
+		path = slash == std::string_view::npos ? std::string_view() : path.substr(slash + 1);
+
+		if (segment.empty() || segment == ".") {
+			continue;
+		}
+
+		if (segment == "..") {
+			if (relativePath.empty()) {
+				return false;
+			}
+
+			const auto previous = relativePath.find_last_of('/');
+			relativePath.resize(previous == std::string::npos ? 0 : previous);
+			continue;
+		}
+
+		if (!relativePath.empty()) {
+			relativePath += '/';
+		}
+		relativePath.append(segment);
+	}
+
+	return true;
+}
+
+int
+IO::FileResolver::OpenBeneath(const std::string &relativePath) const noexcept {
+	if (rootHandle == -1) {
+		errno = ENOENT;
+		return -1;
+	}
+
+	const char *path = relativePath.empty() ? "." : relativePath.c_str();
+
+#if defined(FILE_RESOLVER_USE_OPENAT2)
+	// openat2 is available since Linux 5.6.
+	static std::atomic<bool> hasOpenat2{ true };
+	if (hasOpenat2) {
+		struct open_how how{};
+		how.flags = FILE_RESOLVER_OPEN_FLAGS;
+		how.resolve = RESOLVE_BENEATH | RESOLVE_NO_MAGICLINKS;
+
+		const auto fd = static_cast<int>(syscall(SYS_openat2, rootHandle, path, &how, sizeof(how)));
+		if (fd != -1 || errno != ENOSYS) {
+			return fd;
+		}
+
+		hasOpenat2 = false;
+	}
+#elif defined(O_RESOLVE_BENEATH)
+	return openat(rootHandle, path, FILE_RESOLVER_OPEN_FLAGS | O_RESOLVE_BENEATH);
+#endif
+
+	const int fd = openat(rootHandle, path, FILE_RESOLVER_OPEN_FLAGS);
+	if (fd == -1) {
+		return -1;
+	}
+
+	std::array<char, PATH_MAX> resolved{};
+	const std::string full = root + '/' + relativePath;
+	if (realpath(full.c_str(), resolved.data()) == nullptr) {
+		const int error = errno;
+		psx::close(fd);
+		errno = error;
+		return -1;
+	}
+
+	const std::string_view resolvedPath(resolved.data());
+	if (resolvedRoot.empty() || resolvedPath.compare(0, resolvedRoot.length(), resolvedRoot) != 0 ||
+		(resolvedPath.length() != resolvedRoot.length() && resolvedPath[resolvedRoot.length()] != '/' &&
+		 resolvedRoot != "/")) {
+		psx::close(fd);
+		errno = EXDEV;
+		return -1;
+	}
+
+	return fd;
+}
+
+std::array<std::unique_ptr<IO::File>, HTTP::contentCodingCount>
+IO::FileResolver::ResolveEncodings(const IO::File &file) const noexcept {
+	std::array<std::unique_ptr<IO::File>, HTTP::contentCodingCount> encodings;
+
+	const auto &path = file.Path();
+	if (path.length() <= root.length() + 1) {
+		return encodings;
+	}
+	const auto relativePath = path.substr(root.length() + 1);
+
+	for (std::size_t i = 1; i < HTTP::contentCodingCount; i++) {
+		const std::string suffix(HTTP::ContentCodingSuffix(static_cast<HTTP::ContentCoding>(i)));
+		const int fd = OpenBeneath(relativePath + suffix);
+		if (fd == -1) {
+			continue;
+		}
+
+		auto encoded = std::make_unique<IO::File>(fd, path + suffix);
+		if (encoded->Handle() != -1 && encoded->IsNormalFile()) {
+			encodings[i] = std::move(encoded);
+		}
+	}
+
+	return encodings;
+}
+
 std::pair<IO::FileResolveStatus, std::unique_ptr<IO::File>>
 IO::FileResolver::Resolve(const HTTP::Request &request) const noexcept {
-	std::stringstream pathBuilder;
-	pathBuilder << root;
-	pathBuilder << request.path;
+	std::string relativePath;
+	if (!NormalizePath(request.path, relativePath)) {
+		return { IO::FileResolveStatus::OUTSIDE_ROOT_DIRECTORY, std::unique_ptr<IO::File> {} };
+	}
+
+	int fd = OpenBeneath(relativePath);
+	if (fd == -1) {
+		return { ResolveErrno(), std::unique_ptr<IO::File> {} };
+	}
 
-	auto file = std::make_unique<IO::File>(pathBuilder.str().c_str());
+	auto file = std::make_unique<IO::File>(fd, root + '/' + relativePath);
 	if (file->Handle() != -1 && file->IsNormalFile()) {
 		return { IO::FileResolveStatus::OK, std::move(file) };
 	}
 
-	// Always use first status
-	const auto status = ResolveErrno();
-	if (file->Handle() != -1 && !file->IsDirectory()) {
-		return { status, std::unique_ptr<IO::File> {} };
+	if (file->Handle() == -1 || !file->IsDirectory()) {
+		return { IO::FileResolveStatus::NOT_FOUND, std::unique_ptr<IO::File> {} };
 	}
 
-	pathBuilder << "/index.html";
+	const auto version = IO::FileVersion::Of(file->Status());
+	{
+		std::lock_guard guard(mutex);
+		const auto known = directoriesWithoutIndex.find(relativePath);
+		if (known != std::end(directoriesWithoutIndex) && known->second == version) {
+			return { IO::FileResolveStatus::NOT_FOUND, std::move(file) };
+		}
+	}
+
+	auto directory = std::move(file);
+	std::string indexPath = relativePath + (relativePath.empty() ? "index.html" : "/index.html");
+
+	fd = OpenBeneath(indexPath);
+	if (fd == -1) {
+		if (errno != ENOENT) {
+			return { ResolveErrno(), std::unique_ptr<IO::File> {} };
+		}
 
-	file->InternalInit(pathBuilder.str().c_str());
-	if (file->Handle() != -1) {
+		// A recently modified directory might change again unnoticed.
+		if (version.IsSettled()) {
+			std::lock_guard guard(mutex);
+			if (directoriesWithoutIndex.size() == MAGIC_FILE_RESOLVER_MAX_DIRECTORIES_WITHOUT_INDEX) {
+				directoriesWithoutIndex.clear();
+			}
+			directoriesWithoutIndex.insert_or_assign(std::move(relativePath), version);
+		}
+		return { IO::FileResolveStatus::NOT_FOUND, std::move(directory) };
+	}
+
+	file = std::make_unique<IO::File>(fd, root + '/' + indexPath);
+	if (file->Handle() != -1 && file->IsNormalFile()) {
 		return { IO::FileResolveStatus::OK, std::move(file) };
 	}
 
-	return { status, std::unique_ptr<IO::File> {} };
+	return { IO::FileResolveStatus::NOT_FOUND, std::unique_ptr<IO::File> {} };
 }
@@ -6,10 +6,15 @@
  * See the COPYING file for licensing information.
  */
 
+#include <array>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <utility>
 
+#include "http/content_coding.hpp"
 #include "http/request.hpp"
 #include "io/file.hpp"
 
@@ -20,18 +25,66 @@ enum class FileResolveStatus {
 	NOT_FOUND,
 	INSUFFICIENT_PERMISSIONS,
 	FILE_SYSTEM_OVERLOAD,
+	OUTSIDE_ROOT_DIRECTORY,
 };
 
+// Resolves the paths of requests to files beneath the root directory. The
+// root directory is held open, and the files are opened relative to it with
+// openat2(2)'s RESOLVE_BENEATH (or FreeBSD's O_RESOLVE_BENEATH), so the
+// kernel guarantees that neither '..' nor symbolic links escape the root,
+// during a single path walk. Where this isn't available, the resolved path of
+// the file is checked with realpath(3) instead.
+//
+// The directories without an index file are remembered until they change, so
+// requests for them don't look for the index every time.
 class FileResolver {
 public:
-	inline explicit FileResolver(const std::string &rootDirectory) noexcept : root(rootDirectory) {
-	}
+	explicit FileResolver(const std::string &rootDirectory) noexcept;
 
+	FileResolver(const FileResolver &) = delete;
+
+	FileResolver &
+	operator=(const FileResolver &) = delete;
+
+	~FileResolver() noexcept;
+
+	// Normalizes the request-target [path] lexically into [relativePath],
+	// i.e. without a leading slash, empty, '.' and '..' segments.
+	//
+	// Returns false if the path ascends above the root.
+	[[nodiscard]] static bool
+	NormalizePath(std::string_view path, std::string &relativePath) noexcept;
+
+	// Resolves the file of the request, which is the "index.html" in it for
+	// a directory. When the directory has no index, NOT_FOUND is returned
+	// with the directory, so it can be listed, see DirectoryIndex.
 	[[nodiscard]] std::pair<FileResolveStatus, std::unique_ptr<IO::File>>
 	Resolve(const HTTP::Request &) const noexcept;
 
+	// Opens the precompressed siblings of [file], which has been resolved by
+	// this resolver, e.g. "style.css.br" and "style.css.gz" for "style.css".
+	// The element of a coding is nullptr if there is no such (normal) file,
+	// and the element of IDENTITY always is.
+	[[nodiscard]] std::array<std::unique_ptr<IO::File>, HTTP::contentCodingCount>
+	ResolveEncodings(const IO::File &file) const noexcept;
+
 private:
 	std::string root;
+	int rootHandle{ -1 };
+
+	// The realpath(3) of the root, used when RESOLVE_BENEATH isn't available.
+	std::string resolvedRoot;
+
+	// The versions of the directories without an index file, by their path
+	// relative to the root. Cleared when full.
+	mutable std::mutex mutex;
+	mutable std::unordered_map<std::string, FileVersion> directoriesWithoutIndex;
+
+	// Opens [relativePath] (which should be normalized) beneath the root.
+	// Returns the file descriptor, or -1 with errno set, EXDEV meaning the
+	// file is outside the root.
+	[[nodiscard]] int
+	OpenBeneath(const std::string &relativePath) const noexcept;
 };
 
 } // namespace IO
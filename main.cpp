@@ -4,21 +4,37 @@
  * See the COPYING file for licensing information.
  */
 
+#include <algorithm>
 #include <array>
+#include <chrono>
 #include <iostream>
 #include <iterator>
+#include <list>
 #include <sstream>
 #include <string>
+#include <vector>
 
+#include <cctype>
+#include <cerrno>
+#include <csignal>
 #include <cstdio>
 #include <cstdlib>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
+#include "base/async_log.hpp"
 #include "base/logger.hpp"
 #include "base/media_type.hpp"
+#include "base/numa.hpp"
 #include "cgi/manager.hpp"
 #include "http/configuration.hpp"
+#include "http/handoff.hpp"
+#include "http/metrics.hpp"
 #include "http/server.hpp"
+#include "io/compression_cache.hpp"
+#include "io/file_cache.hpp"
 #include "security/policies.hpp"
 #include "security/process.hpp"
 #include "security/tls_configuration.hpp"
@@ -26,21 +42,63 @@
 #define NO_HTTP_SERVER2
 constexpr bool shouldLoadTLSConfiguration = false;
 
+// How long the new process of a binary upgrade may take to start its servers.
+constexpr std::chrono::seconds upgradeTimeout{ 30 };
+
 bool
 LoadTLSConfiguration(Security::TLSConfiguration &config);
 
 bool
 LoadHostName(HTTP::Configuration &config);
 
+[[nodiscard]] bool
+LoadVirtualHosts(HTTP::Configuration &config);
+
+[[nodiscard]] bool
+LoadVirtualHostCertificates(const HTTP::Configuration &config, Security::TLSConfiguration &defaults,
+							std::list<Security::TLSConfiguration> &configurations);
+
 [[nodiscard]] bool
 DropPrivileges(gid_t, uid_t) noexcept;
 
 [[nodiscard]] bool
 DetectPrivileges(Security::Policies &);
 
+[[nodiscard]] bool
+ReceiveHandoff(int &channel, HTTP::Handoff::Sockets &sockets);
+
+void
+InheritSockets(HTTP::Configuration &config, HTTP::Handoff::Sockets &sockets);
+
+[[nodiscard]] bool
+InstallSignalHandlers();
+
+[[nodiscard]] bool
+AwaitStop(char *arguments[], const std::vector<HTTP::Server *> &servers, Security::TLSConfiguration &tlsConfiguration,
+		  std::list<Security::TLSConfiguration> &virtualHostTLSConfigurations);
+
+[[nodiscard]] bool
+UpgradeBinary(char *arguments[], const std::vector<HTTP::Server *> &servers);
+
 int
-main() {
+main(int, char *argv[]) {
+	// Set when this process is the successor of a binary upgrade.
+	int handoffChannel = -1;
+	HTTP::Handoff::Sockets inheritedSockets;
+	if (!ReceiveHandoff(handoffChannel, inheritedSockets)) {
+		Logger::Error("Main", "Failed to receive the listening sockets of the previous process");
+		return EXIT_FAILURE;
+	}
+
 	CGI::Manager manager{};
+	CGI::Script testScript;
+	testScript.Command = "/opt/test.sh";
+	testScript.Name = "Test CGI Script";
+	if (!manager.Register("/cgi", testScript)) {
+		Logger::Error("Main", "Failed to register the CGI scripts");
+		return EXIT_FAILURE;
+	}
+
 	MediaTypeFinder mediaTypeFinder{};
 	Security::Policies securityPolicies{};
 	Security::TLSConfiguration tlsConfiguration{};
@@ -51,8 +109,10 @@ main() {
 	}
 
 	HTTP::Configuration httpConfig1(mediaTypeFinder, securityPolicies, tlsConfiguration);
+	httpConfig1.servingMode = HTTP::ServingMode::EVENT_DRIVEN;
 #ifndef NO_HTTP_SERVER2
 	HTTP::Configuration httpConfig2(mediaTypeFinder, securityPolicies, tlsConfiguration);
+	httpConfig2.servingMode = HTTP::ServingMode::EVENT_DRIVEN;
 #endif
 
 	if ((httpConfig1.hostname.empty() && !LoadHostName(httpConfig1))
@@ -64,22 +124,125 @@ main() {
 		return EXIT_FAILURE;
 	}
 
+	if (!LoadVirtualHosts(httpConfig1)) {
+		Logger::Error("Main", "Failed to load virtual hosts");
+		return EXIT_FAILURE;
+	}
+
+	// The certificates of the virtual hosts are selected with SNI, so they
+	// are loaded before the servers start.
+	std::list<Security::TLSConfiguration> virtualHostTLSConfigurations;
+	if (shouldLoadTLSConfiguration &&
+		!LoadVirtualHostCertificates(httpConfig1, tlsConfiguration, virtualHostTLSConfigurations)) {
+		Logger::Error("Main", "Failed to load the certificates of the virtual hosts");
+		return EXIT_FAILURE;
+	}
+
+	// The workers are grouped by NUMA node when WS_NUMA_LOCAL_WORKERS is set.
+	std::size_t nodeCount = 1;
+	if (std::getenv("WS_NUMA_LOCAL_WORKERS") != nullptr) {
+		httpConfig1.numaLocalWorkers = true;
+#ifndef NO_HTTP_SERVER2
+		httpConfig2.numaLocalWorkers = true;
+#endif
+		nodeCount = base::NumaTopology::Detect().nodes.size();
+	}
+
+	// The servers share the caches, since they serve the same sites.
+	IO::FileCache fileCache(httpConfig1.fileCacheCapacity, httpConfig1.fileCacheMaxContentSize,
+							httpConfig1.fileCacheMaxMappedSize, nodeCount);
+	IO::CompressionCache compressionCache(httpConfig1.compressionCacheCapacity);
+	static_cast<void>(fileCache.Initialize());
+	httpConfig1.sharedFileCache = &fileCache;
+	httpConfig1.sharedCompressionCache = &compressionCache;
+#ifndef NO_HTTP_SERVER2
+	httpConfig2.virtualHosts = httpConfig1.virtualHosts;
+	httpConfig2.sharedFileCache = &fileCache;
+	httpConfig2.sharedCompressionCache = &compressionCache;
+#endif
+
+	// The access log is opened before the privileges are dropped, and is
+	// shared by the servers as well.
+	base::AsyncLog accessLog;
+	if (auto *accessLogPath = std::getenv("WS_ACCESS_LOG")) {
+		if (!accessLog.Start(accessLogPath)) {
+			Logger::Error("Main", "Failed to open the access log");
+			return EXIT_FAILURE;
+		}
+		httpConfig1.accessLog = &accessLog;
+#ifndef NO_HTTP_SERVER2
+		httpConfig2.accessLog = &accessLog;
+#endif
+	}
+
+	// The servers are instrumented when WS_METRICS is set, and the metrics
+	// are served to local clients at WS_METRICS_PATH, if set.
+	HTTP::Metrics metrics;
+	if (std::getenv("WS_METRICS") != nullptr) {
+		httpConfig1.metrics = &metrics;
+#ifndef NO_HTTP_SERVER2
+		httpConfig2.metrics = &metrics;
+#endif
+		if (auto *metricsPath = std::getenv("WS_METRICS_PATH")) {
+			httpConfig1.metricsPath = metricsPath;
+#ifndef NO_HTTP_SERVER2
+			httpConfig2.metricsPath = metricsPath;
+#endif
+		}
+	}
+
+	// Directories without an index are listed when WS_AUTO_INDEX is set.
+	if (std::getenv("WS_AUTO_INDEX") != nullptr) {
+		httpConfig1.autoIndex = true;
+#ifndef NO_HTTP_SERVER2
+		httpConfig2.autoIndex = true;
+#endif
+	}
+
+	// The file cache is warmed before the servers listen, from the manifest at
+	// WS_FILE_CACHE_MANIFEST if it exists, which is saved on stopping and
+	// upgrading.
+	if (auto *manifestPath = std::getenv("WS_FILE_CACHE_MANIFEST")) {
+		httpConfig1.fileCacheManifest = manifestPath;
+		httpConfig1.prewarmFileCache = true;
+#ifndef NO_HTTP_SERVER2
+		httpConfig2.fileCacheManifest = manifestPath;
+		httpConfig2.prewarmFileCache = true;
+#endif
+	}
+
 #ifdef NO_HTTP_SERVER2
 	httpConfig1.rootDirectory = "/var/www/html";
 	httpConfig1.port = 80;
+	InheritSockets(httpConfig1, inheritedSockets);
 	HTTP::Server httpServer1(httpConfig1, manager);
 #else
 	httpConfig1.rootDirectory = "/dev/null";
 	httpConfig1.port = 80;
 	httpConfig1.upgradeToHTTPS = true;
+	InheritSockets(httpConfig1, inheritedSockets);
 	HTTP::Server httpServer1(httpConfig1, manager);
 
 	httpConfig2.rootDirectory = "/var/www/html";
 	httpConfig2.port = 443;
 	httpConfig2.useTransportSecurity = true;
+	httpConfig2.cryptoThreadCount = 2;
+	InheritSockets(httpConfig2, inheritedSockets);
 	HTTP::Server httpServer2(httpConfig2, manager);
 #endif
 
+	// The ports that are no longer served.
+	for (const auto &entry : inheritedSockets) {
+		for (int socket : entry.second) {
+			close(socket);
+		}
+	}
+
+	std::vector<HTTP::Server *> servers{ &httpServer1 };
+#ifndef NO_HTTP_SERVER2
+	servers.push_back(&httpServer2);
+#endif
+
 	if (!httpServer1.Initialize()
 #ifndef NO_HTTP_SERVER2
 		|| !httpServer2.Initialize()
@@ -89,6 +252,11 @@ main() {
 		return EXIT_FAILURE;
 	}
 
+	if (!InstallSignalHandlers()) {
+		Logger::Error("Main", "Failed to install the signal handlers");
+		return EXIT_FAILURE;
+	}
+
 	if (DetectPrivileges(securityPolicies) &&
 		!DropPrivileges(securityPolicies.privileges.groupID, securityPolicies.privileges.userID)) {
 		return EXIT_FAILURE;
@@ -101,17 +269,30 @@ main() {
 
 	Logger::Log("Main", "Server Started");
 
-	std::string test;
-	std::cin >> test;
+	// The previous process drains its servers now.
+	if (handoffChannel != -1) {
+		if (!HTTP::Handoff::SignalReady(handoffChannel)) {
+			Logger::Warning("Main", "Failed to signal the previous process");
+		}
+		close(handoffChannel);
+	}
 
-	Logger::Log("Main", "Stopping...");
+	// After an upgrade, the new process serves the new connections, and the
+	// current ones are finished.
+	const bool upgraded = AwaitStop(argv, servers, tlsConfiguration, virtualHostTLSConfigurations);
+	Logger::Log("Main", upgraded ? "Draining..." : "Stopping...");
 
-	httpServer1.SignalShutdown();
-#ifndef NO_HTTP_SERVER2
-	httpServer2.SignalShutdown();
-	httpServer2.Join();
-#endif
-	httpServer1.Join();
+	for (auto *server : servers) {
+		if (upgraded) {
+			server->SignalDrain();
+		} else {
+			server->SignalShutdown();
+		}
+	}
+	for (auto *server : servers) {
+		server->Join();
+	}
+	accessLog.Stop();
 
 	Logger::Log("Main", "Stopped!");
 
@@ -183,6 +364,103 @@ LoadHostName(HTTP::Configuration &config) {
 	return true;
 }
 
+// Reads the virtual hosts from WS_VIRTUAL_HOSTS, of the form
+// "example.com,www.example.com=/var/www/example;example.org=/var/www/org",
+// i.e. the hostnames and root directory of each host. A host with a
+// certificate of its own is followed by the files of it, as in
+// "example.org=/var/www/org=/etc/org/cert.pem,/etc/org/chain.pem,/etc/org/key.pem".
+bool
+LoadVirtualHosts(HTTP::Configuration &config) {
+	auto *envVirtualHosts = std::getenv("WS_VIRTUAL_HOSTS");
+	if (envVirtualHosts == nullptr) {
+		return true;
+	}
+
+	std::stringstream hosts(envVirtualHosts);
+	std::string host;
+	while (std::getline(hosts, host, ';')) {
+		if (host.empty()) {
+			continue;
+		}
+
+		const auto separator = host.find('=');
+		if (separator == std::string::npos || separator == 0 || separator + 1 == host.length()) {
+			Logger::Error("LoadVirtualHosts", "Expected hostnames=root, got \"" + host + '"');
+			return false;
+		}
+
+		HTTP::VirtualHost virtualHost;
+		const auto certificateSeparator = host.find('=', separator + 1);
+		virtualHost.rootDirectory = host.substr(separator + 1, certificateSeparator - separator - 1);
+
+		if (certificateSeparator != std::string::npos) {
+			std::stringstream files(host.substr(certificateSeparator + 1));
+			std::getline(files, virtualHost.certificateFile, ',');
+			std::getline(files, virtualHost.chainFile, ',');
+			std::getline(files, virtualHost.privateKeyFile);
+			if (virtualHost.rootDirectory.empty() || virtualHost.certificateFile.empty() ||
+				virtualHost.chainFile.empty() || virtualHost.privateKeyFile.empty()) {
+				Logger::Error("LoadVirtualHosts", "Expected hostnames=root=certificate,chain,key, got \"" + host + '"');
+				return false;
+			}
+		}
+
+		std::stringstream hostnames(host.substr(0, separator));
+		std::string hostname;
+		while (std::getline(hostnames, hostname, ',')) {
+			if (!hostname.empty()) {
+				virtualHost.hostnames.push_back(hostname);
+			}
+		}
+
+		config.virtualHosts.push_back(std::move(virtualHost));
+	}
+
+	return true;
+}
+
+// Creates the TLS configurations of the virtual hosts with a certificate of
+// their own, and registers them with the server names of [defaults], which
+// the other settings are copied from.
+//
+// Returns success status
+bool
+LoadVirtualHostCertificates(const HTTP::Configuration &config, Security::TLSConfiguration &defaults,
+							std::list<Security::TLSConfiguration> &configurations) {
+	for (const auto &virtualHost : config.virtualHosts) {
+		if (virtualHost.certificateFile.empty()) {
+			continue;
+		}
+
+		auto &tlsConfiguration = configurations.emplace_back();
+		tlsConfiguration.certificateFile = virtualHost.certificateFile;
+		tlsConfiguration.chainFile = virtualHost.chainFile;
+		tlsConfiguration.privateKeyFile = virtualHost.privateKeyFile;
+		tlsConfiguration.cipherList = defaults.cipherList;
+		tlsConfiguration.cipherSuites = defaults.cipherSuites;
+		tlsConfiguration.enableKernelTLS = defaults.enableKernelTLS;
+		tlsConfiguration.enableHTTP2 = defaults.enableHTTP2;
+		tlsConfiguration.sessionCacheCapacity = defaults.sessionCacheCapacity;
+		tlsConfiguration.sessionTimeout = defaults.sessionTimeout;
+		tlsConfiguration.ticketKeyLifetime = defaults.ticketKeyLifetime;
+
+		if (!tlsConfiguration.CreateContext() || tlsConfiguration.context == nullptr) {
+			Logger::Error("LoadVirtualHostCertificates", "Failed to load \"" + virtualHost.certificateFile + '"');
+			return false;
+		}
+
+		// See Security::TLSConfiguration::serverNames.
+		for (auto hostname : virtualHost.hostnames) {
+			std::transform(std::cbegin(hostname), std::cend(hostname), std::begin(hostname), [](unsigned char character) {
+				return static_cast<char>(std::tolower(character));
+			});
+			defaults.serverNames.emplace(std::move(hostname), &tlsConfiguration);
+		}
+	}
+
+	return true;
+}
+
 bool
 DropPrivileges(gid_t group, uid_t user) noexcept {
 	auto privilegeStatus = Security::Process::DropPrivileges(group, user);
@@ -258,3 +536,170 @@ This disables the additional security layer of kernel privileges de-escalation."
 
 	return true;
 }
+
+// Receives the listening sockets from the previous process, if this process
+// is the successor of a binary upgrade, see HTTP::Handoff.
+bool
+ReceiveHandoff(int &channel, HTTP::Handoff::Sockets &sockets) {
+	auto *channelValue = std::getenv(HTTP::Handoff::environmentVariable);
+	if (channelValue == nullptr) {
+		return true;
+	}
+
+	try {
+		channel = std::stoi(channelValue);
+	} catch (...) {
+		return false;
+	}
+
+	// The channel isn't inherited by CGI scripts, nor by the next upgrade.
+	unsetenv(HTTP::Handoff::environmentVariable);
+	if (fcntl(channel, F_SETFD, FD_CLOEXEC) == -1) {
+		return false;
+	}
+
+	return HTTP::Handoff::ReceiveSockets(channel, sockets);
+}
+
+// Has the server of [config] listen on the inherited sockets of its port, if
+// there are any. Those are removed from [sockets].
+void
+InheritSockets(HTTP::Configuration &config, HTTP::Handoff::Sockets &sockets) {
+	if (auto node = sockets.extract(config.port)) {
+		config.inheritedSockets = std::move(node.mapped());
+	}
+}
+
+namespace {
+
+// The signals are passed on to AwaitStop through this pipe.
+std::array<int, 2> signalPipe{ -1, -1 };
+
+void
+OnSignal(int signal) {
+	const int savedErrno = errno;
+	const auto number = static_cast<char>(signal);
+	static_cast<void>(write(signalPipe[1], &number, 1));
+	errno = savedErrno;
+}
+
+} // namespace
+
+bool
+InstallSignalHandlers() {
+	if (pipe2(signalPipe.data(), O_CLOEXEC | O_NONBLOCK) == -1) {
+		return false;
+	}
+
+	struct sigaction action{};
+	action.sa_handler = OnSignal;
+	action.sa_flags = SA_RESTART;
+	sigemptyset(&action.sa_mask);
+	return sigaction(SIGHUP, &action, nullptr) == 0 && sigaction(SIGUSR2, &action, nullptr) == 0;
+}
+
+// Waits until the servers should stop, i.e. when there is input (or the end of
+// it) on the standard input, or the binary has been upgraded. In the meantime:
+//   - SIGHUP reloads the TLS configuration, e.g. renewed certificates;
+//   - SIGUSR2 upgrades the binary, see UpgradeBinary.
+//
+// Returns whether the binary has been upgraded
+bool
+AwaitStop(char *arguments[], const std::vector<HTTP::Server *> &servers, Security::TLSConfiguration &tlsConfiguration,
+		  std::list<Security::TLSConfiguration> &virtualHostTLSConfigurations) {
+	std::array<struct pollfd, 2> pollActions{ {
+		{ STDIN_FILENO, POLLIN, 0 },
+		{ signalPipe[0], POLLIN, 0 },
+	} };
+
+	while (true) {
+		if (poll(pollActions.data(), pollActions.size(), -1) == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+			Logger::Error("Main", "Failed to wait for signals");
+			return false;
+		}
+
+		if (pollActions[0].revents != 0) {
+			std::string input;
+			std::cin >> input;
+			return false;
+		}
+
+		char signal;
+		while (read(signalPipe[0], &signal, 1) == 1) {
+			if (signal == SIGUSR2) {
+				if (UpgradeBinary(arguments, servers)) {
+					return true;
+				}
+				continue;
+			}
+
+			if (!shouldLoadTLSConfiguration) {
+				Logger::Log("Main", "There is no TLS configuration to reload");
+				continue;
+			}
+
+			// A configuration that fails keeps its current context.
+			bool reloaded = tlsConfiguration.CreateContext();
+			for (auto &virtualHostTLSConfiguration : virtualHostTLSConfigurations) {
+				reloaded = virtualHostTLSConfiguration.CreateContext() && reloaded;
+			}
+
+			if (reloaded) {
+				Logger::Log("Main", "Reloaded the TLS configuration");
+			} else {
+				Logger::Error("Main", "Failed to reload the TLS configuration, the current contexts of the failures are kept");
+			}
+		}
+	}
+}
+
+// Starts the binary at WS_UPGRADE_BINARY, or the one of this process, with the
+// listening sockets of [servers], see HTTP::Handoff. The new process reads the
+// configuration anew.
+//
+// Returns whether the new process has started its servers
+bool
+UpgradeBinary(char *arguments[], const std::vector<HTTP::Server *> &servers) {
+	HTTP::Handoff::Sockets sockets;
+	for (const auto *server : servers) {
+		const auto &listeningSockets = server->ListeningSockets();
+		auto &portSockets = sockets[server->config().port];
+		portSockets.insert(std::end(portSockets), std::cbegin(listeningSockets), std::cend(listeningSockets));
+	}
+
+	// The new process warms its file cache with the files of this one.
+	for (auto *server : servers) {
+		if (!server->SaveFileCacheManifest()) {
+			Logger::Warning("Upgrade", "Failed to save the file cache manifest");
+		}
+	}
+
+	const char *binary = std::getenv("WS_UPGRADE_BINARY");
+	if (binary == nullptr) {
+		binary = arguments[0];
+	}
+
+	pid_t process;
+	const int channel = HTTP::Handoff::Launch(binary, arguments, process);
+	if (channel == -1) {
+		Logger::Error("Upgrade", "Failed to start the new process");
+		return false;
+	}
+
+	const bool success = HTTP::Handoff::SendSockets(channel, sockets) &&
+						 HTTP::Handoff::AwaitReady(channel, upgradeTimeout);
+	close(channel);
+
+	if (!success) {
+		Logger::Error("Upgrade", "The new process failed to start, the current one keeps serving");
+		kill(process, SIGKILL);
+		static_cast<void>(waitpid(process, nullptr, 0));
+		return false;
+	}
+
+	Logger::Log("Upgrade", "The new process has started");
+	return true;
+}
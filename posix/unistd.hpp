@@ -20,6 +20,7 @@
 namespace psx {
 
 	using ::close;
+	using ::pread;
 	using ::read;
 	using ::write;
 
@@ -0,0 +1,221 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include "security/address_limiter.hpp"
+
+#include <algorithm>
+
+#include <cstring>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+#include "security/policies.hpp"
+
+// The amount of slots an address can be stored in, starting at the slot of
+// its hash.
+#define MAGIC_ADDRESS_LIMITER_PROBES 8
+
+// The smallest capacity of the table.
+#define MAGIC_ADDRESS_LIMITER_MIN_CAPACITY 64
+
+// A token is a thousand units of the bucket, which has 24 bits for them.
+#define MAGIC_ADDRESS_LIMITER_TOKEN 1000
+#define MAGIC_ADDRESS_LIMITER_MAX_BURST ((1U << 24) / MAGIC_ADDRESS_LIMITER_TOKEN - 1)
+
+namespace Security {
+
+namespace {
+
+[[nodiscard]] std::size_t
+RoundCapacity(std::size_t capacity) noexcept {
+	std::size_t rounded = MAGIC_ADDRESS_LIMITER_MIN_CAPACITY;
+	while (rounded < capacity) {
+		rounded <<= 1;
+	}
+	return rounded;
+}
+
+// The finalizer of SplitMix64, so keys that differ in a few bits (like the
+// addresses of a subnet) are spread over the table.
+[[nodiscard]] inline std::uint64_t
+Mix(std::uint64_t key) noexcept {
+	key = (key ^ (key >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	key = (key ^ (key >> 27)) * 0x94D049BB133111EBULL;
+	return key ^ (key >> 31);
+}
+
+[[nodiscard]] inline std::uint64_t
+KeyOfIPv4(std::uint32_t address) noexcept {
+	// The prefix of IPv4-mapped IPv6 addresses, so the keys can't be mistaken
+	// for the /64 prefixes of (global) IPv6 addresses.
+	return (std::uint64_t{ 0xFFFF } << 32) | ntohl(address);
+}
+
+} // namespace
+
+AddressLimiter::AddressLimiter(const Policies &policies) :
+	maxConnections(static_cast<std::uint32_t>(policies.maxConnectionsPerAddress)),
+	refillRate(policies.connectionRatePerAddress),
+	bucketCapacity(std::clamp<std::uint64_t>(policies.connectionBurstPerAddress, 1, MAGIC_ADDRESS_LIMITER_MAX_BURST)
+				   * MAGIC_ADDRESS_LIMITER_TOKEN),
+	mask(RoundCapacity(policies.addressTableCapacity) - 1),
+	slots(std::make_unique<Slot[]>(mask + 1)),
+	epoch(std::chrono::steady_clock::now()) {
+}
+
+AddressAdmission
+AddressLimiter::Admit(const struct sockaddr *address, AddressLease &lease) noexcept {
+	lease.Reset();
+
+	const auto key = KeyOf(address);
+	if (key == 0) {
+		return AddressAdmission::ADMITTED;
+	}
+
+	const auto now = refillRate == 0 ? 0 : Now();
+	auto *slot = Claim(key, now);
+	if (slot == nullptr) {
+		return AddressAdmission::ADMITTED;
+	}
+
+	if (refillRate != 0 && !TakeToken(*slot, now)) {
+		return AddressAdmission::RATE_LIMITED;
+	}
+
+	if (maxConnections != 0) {
+		if (slot->connections.fetch_add(1, std::memory_order_relaxed) >= maxConnections) {
+			slot->connections.fetch_sub(1, std::memory_order_relaxed);
+			return AddressAdmission::TOO_MANY_CONNECTIONS;
+		}
+		lease.counter = &slot->connections;
+	}
+
+	return AddressAdmission::ADMITTED;
+}
+
+AddressLimiter::Slot *
+AddressLimiter::Claim(std::uint64_t key, std::uint64_t now) noexcept {
+	const auto start = Mix(key);
+
+	for (std::size_t probe = 0; probe < MAGIC_ADDRESS_LIMITER_PROBES; probe++) {
+		auto &slot = slots[(start + probe) & mask];
+		auto current = slot.key.load(std::memory_order_acquire);
+		if (current == 0 && slot.key.compare_exchange_strong(current, key, std::memory_order_acq_rel)) {
+			return &slot;
+		}
+		if (current == key) {
+			return &slot;
+		}
+	}
+
+	// The address isn't tracked, and there are no empty slots: take the slot
+	// of an address that hasn't been limited recently. Its counter is kept,
+	// since it is 0 unless a lease of the previous address was acquired
+	// concurrently, which is then released on the counter all the same.
+	for (std::size_t probe = 0; probe < MAGIC_ADDRESS_LIMITER_PROBES; probe++) {
+		auto &slot = slots[(start + probe) & mask];
+		auto current = slot.key.load(std::memory_order_acquire);
+		if (IsIdle(slot, now) && slot.key.compare_exchange_strong(current, key, std::memory_order_acq_rel)) {
+			slot.bucket.store(0, std::memory_order_relaxed);
+			return &slot;
+		}
+	}
+
+	return nullptr;
+}
+
+std::uint32_t
+AddressLimiter::Connections(const struct sockaddr *address) const noexcept {
+	const auto *slot = Find(KeyOf(address));
+	return slot == nullptr ? 0 : slot->connections.load(std::memory_order_relaxed);
+}
+
+const AddressLimiter::Slot *
+AddressLimiter::Find(std::uint64_t key) const noexcept {
+	if (key == 0) {
+		return nullptr;
+	}
+
+	const auto start = Mix(key);
+	for (std::size_t probe = 0; probe < MAGIC_ADDRESS_LIMITER_PROBES; probe++) {
+		const auto &slot = slots[(start + probe) & mask];
+		if (slot.key.load(std::memory_order_acquire) == key) {
+			return &slot;
+		}
+	}
+	return nullptr;
+}
+
+bool
+AddressLimiter::IsIdle(const Slot &slot, std::uint64_t now) const noexcept {
+	if (slot.connections.load(std::memory_order_relaxed) != 0) {
+		return false;
+	}
+	return refillRate == 0 || TokensOf(slot.bucket.load(std::memory_order_relaxed), now) == bucketCapacity;
+}
+
+std::uint64_t
+AddressLimiter::KeyOf(const struct sockaddr *address) noexcept {
+	if (address->sa_family == AF_INET) {
+		return KeyOfIPv4(reinterpret_cast<const struct sockaddr_in *>(address)->sin_addr.s_addr);
+	}
+
+	if (address->sa_family != AF_INET6) {
+		return 0;
+	}
+
+	const auto &address6 = reinterpret_cast<const struct sockaddr_in6 *>(address)->sin6_addr;
+	if (IN6_IS_ADDR_V4MAPPED(&address6)) {
+		std::uint32_t address4;
+		std::memcpy(&address4, address6.s6_addr + 12, sizeof(address4));
+		return KeyOfIPv4(address4);
+	}
+
+	std::uint64_t prefix = 0;
+	for (std::size_t i = 0; i < 8; i++) {
+		prefix = (prefix << 8) | address6.s6_addr[i];
+	}
+
+	// The prefix of the loopback and unspecified addresses.
+	return prefix == 0 ? 1 : prefix;
+}
+
+std::uint64_t
+AddressLimiter::Now() const noexcept {
+	const auto elapsed = std::chrono::steady_clock::now() - epoch;
+	return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count()) + 1;
+}
+
+bool
+AddressLimiter::TakeToken(Slot &slot, std::uint64_t now) noexcept {
+	auto bucket = slot.bucket.load(std::memory_order_relaxed);
+	while (true) {
+		const auto tokens = TokensOf(bucket, now);
+		if (tokens < MAGIC_ADDRESS_LIMITER_TOKEN) {
+			return false;
+		}
+
+		const auto updated = (now << 24) | (tokens - MAGIC_ADDRESS_LIMITER_TOKEN);
+		if (slot.bucket.compare_exchange_weak(bucket, updated, std::memory_order_relaxed)) {
+			return true;
+		}
+	}
+}
+
+std::uint64_t
+AddressLimiter::TokensOf(std::uint64_t bucket, std::uint64_t now) const noexcept {
+	if (bucket == 0) {
+		return bucketCapacity;
+	}
+
+	const auto time = bucket >> 24;
+	const auto tokens = bucket & 0xFFFFFF;
+	const auto elapsed = std::min(now > time ? now - time : 0, bucketCapacity);
+	return std::min(bucketCapacity, tokens + elapsed * refillRate);
+}
+
+} // namespace Security
@@ -0,0 +1,168 @@
+#pragma once
+
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <sys/socket.h>
+
+namespace Security {
+
+// Forward-decl from security/policies.hpp
+struct Policies;
+
+// A connection counted by an AddressLimiter. The connection is no longer
+// counted when the lease is reset or destroyed.
+class AddressLease {
+public:
+	AddressLease() noexcept = default;
+
+	inline AddressLease(AddressLease &&other) noexcept :
+		counter(other.counter) {
+		other.counter = nullptr;
+	}
+
+	inline AddressLease &
+	operator=(AddressLease &&other) noexcept {
+		if (this != &other) {
+			Reset();
+			counter = other.counter;
+			other.counter = nullptr;
+		}
+		return *this;
+	}
+
+	AddressLease(const AddressLease &) = delete;
+	AddressLease &operator=(const AddressLease &) = delete;
+
+	inline ~AddressLease() noexcept {
+		Reset();
+	}
+
+	inline void
+	Reset() noexcept {
+		if (counter != nullptr) {
+			counter->fetch_sub(1, std::memory_order_relaxed);
+			counter = nullptr;
+		}
+	}
+
+private:
+	friend class AddressLimiter;
+
+	std::atomic<std::uint32_t> *counter{ nullptr };
+};
+
+enum class AddressAdmission {
+	ADMITTED,
+
+	// The address has maxConnectionsPerAddress connections already.
+	TOO_MANY_CONNECTIONS,
+
+	// The address opens connections faster than connectionRatePerAddress.
+	RATE_LIMITED,
+};
+
+// Limits the amount of connections per IP address, and the rate at which they
+// are opened, as configured by the Security::Policies. Checked right after
+// accept(2), so refused connections don't cost a client or a thread.
+//
+// The addresses are kept in a hash table of a fixed capacity, which is shared
+// by the threads without locks: the slots are claimed and updated with atomic
+// operations only. An address is tracked while it has connections, or until
+// its token bucket has refilled; then its slot can be taken by another
+// address. When the slots an address hashes to are all in use, the address
+// isn't limited, so a full table fails open.
+//
+// IPv6 addresses are limited by their /64 prefix, since that is what a single
+// host is usually assigned. IPv4-mapped IPv6 addresses are limited like the
+// IPv4 address.
+class AddressLimiter {
+public:
+	explicit AddressLimiter(const Policies &policies);
+
+	AddressLimiter(const AddressLimiter &) = delete;
+	AddressLimiter &operator=(const AddressLimiter &) = delete;
+
+	// Counts a new connection from [address], as returned by accept(2). If it
+	// is admitted, [lease] holds the connection for as long as it lasts.
+	[[nodiscard]] AddressAdmission
+	Admit(const struct sockaddr *address, AddressLease &lease) noexcept;
+
+	// The amount of connections from [address] that are counted.
+	[[nodiscard]] std::uint32_t
+	Connections(const struct sockaddr *address) const noexcept;
+
+	// The amount of slots of the table.
+	[[nodiscard]] inline std::size_t
+	Capacity() const noexcept {
+		return mask + 1;
+	}
+
+private:
+	struct Slot {
+		// The key of the address, see KeyOf. 0 means the slot is empty.
+		std::atomic<std::uint64_t> key{ 0 };
+
+		std::atomic<std::uint32_t> connections{ 0 };
+
+		// The token bucket: the time of the last update in milliseconds since
+		// 'epoch' in the upper 40 bits, and the amount of thousandths of
+		// tokens in the lower 24 bits. 0 means the bucket is full.
+		std::atomic<std::uint64_t> bucket{ 0 };
+	};
+
+	const std::uint32_t maxConnections;
+
+	// In thousandths of tokens per millisecond, i.e. tokens per second.
+	const std::uint64_t refillRate;
+
+	// In thousandths of tokens.
+	const std::uint64_t bucketCapacity;
+
+	const std::size_t mask;
+	const std::unique_ptr<Slot[]> slots;
+	const std::chrono::steady_clock::time_point epoch;
+
+	// Returns the slot tracking [key], claiming an empty or reclaimable one
+	// if it isn't tracked yet, or nullptr if none could be claimed.
+	[[nodiscard]] Slot *
+	Claim(std::uint64_t key, std::uint64_t now) noexcept;
+
+	[[nodiscard]] const Slot *
+	Find(std::uint64_t key) const noexcept;
+
+	// Whether [slot] is as if its address was never seen.
+	[[nodiscard]] bool
+	IsIdle(const Slot &slot, std::uint64_t now) const noexcept;
+
+	// The amount of thousandths of tokens in [bucket] at [now].
+	[[nodiscard]] std::uint64_t
+	TokensOf(std::uint64_t bucket, std::uint64_t now) const noexcept;
+
+	// Takes a token from the bucket of [slot].
+	//
+	// Returns false if the bucket is empty
+	[[nodiscard]] bool
+	TakeToken(Slot &slot, std::uint64_t now) noexcept;
+
+	// The milliseconds since 'epoch', plus one so the time is never 0.
+	[[nodiscard]] std::uint64_t
+	Now() const noexcept;
+
+	// Returns the key of [address], which is never 0, or 0 if the family of
+	// [address] isn't supported.
+	[[nodiscard]] static std::uint64_t
+	KeyOf(const struct sockaddr *address) noexcept;
+};
+
+} // namespace Security
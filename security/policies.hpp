@@ -21,6 +21,22 @@ struct PoliciesInternalPrivileges {
 
 struct Policies {
 
+	// The amount of IP addresses whose connections are limited, see
+	// maxConnectionsPerAddress and connectionRatePerAddress. The table of the
+	// addresses has a fixed size, of about 24 octets per address. When it is
+	// full, the connections of the addresses that aren't in it aren't limited.
+	std::size_t addressTableCapacity{ 8192 };
+
+	// The amount of connections an IP address may open at once, before
+	// connectionRatePerAddress applies. See Security::AddressLimiter.
+	std::size_t connectionBurstPerAddress{ 64 };
+
+	// The amount of connections per second an IP address may open on
+	// average. Connections opened faster than that are closed right after
+	// they're accepted.
+	// 0 means unlimited.
+	std::size_t connectionRatePerAddress{ 0 };
+
 	// Sets the value of the "Content-Security-Policy" header.
 	// E.g. can tell browsers what sources are allowed.
 	// Empty means not sending the header at all.
@@ -63,6 +79,12 @@ struct Policies {
 	// Spec: https://fetch.spec.whatwg.org/#x-content-type-options-header
 	bool enableContentTypeNosniffing{ true };
 
+	// The maximum length of the body of a request. Longer bodies are refused
+	// with 413 (Payload Too Large), before they are passed to a CGI script.
+	// Default is 1048576 i.e. 1 MiB
+	// 0 means unlimited.
+	std::size_t maxBodyLength{ 1024 * 1024 };
+
 	// Maximum lifetime of a connection. If the max is reached and the
 	// connection is still alive, it will be closed ungracefully.
 	//
@@ -71,6 +93,17 @@ struct Policies {
 	// 0 means unlimited.
 	std::size_t maxConnectionLifetime{ 60000 };
 
+	// The maximum amount of connections from a single IP address, or IPv6 /64
+	// prefix, at once. Connections beyond it are closed right after they're
+	// accepted, before a client or thread is allocated for them.
+	// 0 means unlimited.
+	std::size_t maxConnectionsPerAddress{ 128 };
+
+	// The maximum amount of header fields in a request.
+	// Can't exceed HTTP::HeaderList::capacity (64), which is also what 0
+	// means.
+	std::size_t maxHeaderCount{ 64 };
+
 	// The maximum length of the header field-name.
 	// At this time, the longest registered header field-name is
 	// 'Include-Referred-Token-Binding-ID', with a length of 33 characters.
@@ -82,6 +115,27 @@ struct Policies {
 	// 0 means unlimited.
 	std::size_t maxHeaderFieldValueLength{ 255 };
 
+	// The maximum time a connection may be idle, i.e. waiting for the next
+	// request without having received any of it, or not accepting any of the
+	// response. Idle connections don't hold a thread or a worker's attention
+	// in the event-driven serving mode, but they do hold a socket.
+	//
+	// Time is in milliseconds
+	// Default is 15000 i.e. 15 seconds
+	// 0 means unlimited.
+	std::size_t maxIdleTime{ 15000 };
+
+	// The maximum time a connection lingers after the response has been sent,
+	// waiting for the peer to close it as well. The socket is handed to a
+	// background reaper in the meantime, which discards what the peer sends,
+	// so closing it doesn't reset the connection before the peer has received
+	// the whole response.
+	//
+	// Time is in milliseconds
+	// Default is 5000 i.e. 5 seconds
+	// 0 means the socket is closed right away.
+	std::size_t maxLingeringCloseTime{ 5000 };
+
 	// The maximum method length.
 	// At this time, the longest registered method is 'UPDATEREDIRECTREF', with
 	// a length of 17, therefore the default value is 18 (17 + 0 for the null
@@ -89,6 +143,17 @@ struct Policies {
 	// 0 means unlimited.
 	std::size_t maxMethodLength{ 18 };
 
+	// The maximum time between accepting the connection or receiving the first
+	// octet of a request, and receiving the complete head of that request.
+	// Unlike a timeout per read, this can't be postponed by sending the head
+	// an octet at a time (slow loris). The TLS handshake is included for the
+	// first request.
+	//
+	// Time is in milliseconds
+	// Default is 10000 i.e. 10 seconds
+	// 0 means unlimited.
+	std::size_t maxRequestHeadTime{ 10000 };
+
 	// The amount of requests that may be made in a single connection (session).
 	// 0 means unlimited.
 	std::size_t maxRequestsPerConnection{ 300 };
@@ -8,6 +8,11 @@
 
 #define TLS_LIBRARY_OPENSSL
 
+#include <algorithm>
+#include <iterator>
+#include <string>
+
+#include <cctype>
 #include <cstdlib>
 
 #if defined(TLS_LIBRARY_OPENSSL)
@@ -19,23 +24,117 @@
 
 #include "base/logger.hpp"
 
+// The protocols offered with ALPN, in order of preference.
+static const unsigned char offeredProtocols[] = "\x02h2\x08http/1.1";
+
+// Selects the protocol of the connection from those the client offers. A
+// client that offers neither gets HTTP/1.1 without ALPN.
+//
+// Spec: RFC 7301 § 3.2
+static int
+SelectProtocol(SSL *, const unsigned char **out, unsigned char *outLength,
+			   const unsigned char *in, unsigned int inLength, void *) {
+	auto **selected = const_cast<unsigned char **>(out);
+	if (SSL_select_next_proto(selected, outLength, offeredProtocols, sizeof(offeredProtocols) - 1,
+							  in, inLength) != OPENSSL_NPN_NEGOTIATED) {
+		return SSL_TLSEXT_ERR_NOACK;
+	}
+
+	return SSL_TLSEXT_ERR_OK;
+}
+
+// Switches the connection to the context of the configuration of the server
+// name the client indicates, if there is one. Other names are served with the
+// default context, rather than aborting the handshake.
+//
+// Spec: RFC 6066 § 3
+static int
+SelectServerName(SSL *ssl, int *, void *argument) {
+	const auto *configuration = static_cast<const Security::TLSConfiguration *>(argument);
+	const char *serverName = SSL_get_servername(ssl, TLSEXT_NAMETYPE_host_name);
+	if (serverName == nullptr || configuration->serverNames.empty()) {
+		return SSL_TLSEXT_ERR_OK;
+	}
+
+	std::string name(serverName);
+	std::transform(std::cbegin(name), std::cend(name), std::begin(name), [](unsigned char character) {
+		return static_cast<char>(std::tolower(character));
+	});
+
+	const auto iterator = configuration->serverNames.find(name);
+	if (iterator == std::cend(configuration->serverNames)) {
+		return SSL_TLSEXT_ERR_OK;
+	}
+
+	if (auto *context = iterator->second->AcquireContext(); context != nullptr) {
+		SSL_set_SSL_CTX(ssl, reinterpret_cast<SSL_CTX *>(context));
+		Security::TLSConfiguration::ReleaseContext(context);
+	}
+
+	return SSL_TLSEXT_ERR_OK;
+}
+
 Security::TLSConfiguration::~TLSConfiguration() {
-	SSL_CTX_free(reinterpret_cast<SSL_CTX *>(context));
+	SSL_CTX_free(reinterpret_cast<SSL_CTX *>(context.load()));
 	EVP_cleanup();
 }
 
+void *
+Security::TLSConfiguration::AcquireContext() const noexcept {
+	const std::lock_guard guard(contextMutex);
+	auto *ctx = context.load(std::memory_order_relaxed);
+	if (ctx != nullptr && SSL_CTX_up_ref(reinterpret_cast<SSL_CTX *>(ctx)) != 1) {
+		return nullptr;
+	}
+	return ctx;
+}
+
+void
+Security::TLSConfiguration::ReleaseContext(void *context) noexcept {
+	SSL_CTX_free(reinterpret_cast<SSL_CTX *>(context));
+}
+
 bool
 Security::TLSConfiguration::CreateContext() {
 	SSL_load_error_strings();
 	OpenSSL_add_ssl_algorithms();
 
+	auto *ctx = NewContext();
+	if (ctx == nullptr) {
+		return false;
+	}
+
+	void *previous;
+	{
+		const std::lock_guard guard(contextMutex);
+		previous = context.exchange(ctx, std::memory_order_acq_rel);
+	}
+
+	// The reference of the configuration. The connections set up with the
+	// previous context keep it alive until they're freed.
+	SSL_CTX_free(reinterpret_cast<SSL_CTX *>(previous));
+	return true;
+}
+
+void *
+Security::TLSConfiguration::NewContext() {
 	auto *ctx = SSL_CTX_new(SSLv23_method());
 
 	if (ctx == nullptr) {
-		return false;
+		return nullptr;
+	}
+
+	if (!ConfigureContext(ctx)) {
+		SSL_CTX_free(ctx);
+		return nullptr;
 	}
 
-	this->context = ctx;
+	return ctx;
+}
+
+bool
+Security::TLSConfiguration::ConfigureContext(void *newContext) {
+	auto *ctx = reinterpret_cast<SSL_CTX *>(newContext);
 
 	if (SSL_CTX_use_certificate_file(ctx, certificateFile.c_str(), SSL_FILETYPE_PEM) != 1) {
 		Logger::Error("TLSConfiguration::CreateContext", "Failed to load certificate file!");
@@ -74,6 +173,32 @@ Security::TLSConfiguration::CreateContext() {
 
 	SSL_CTX_set_min_proto_version(ctx, TLS1_2_VERSION);
 
+#ifdef SSL_OP_ENABLE_KTLS
+	// OpenSSL falls back to userspace encryption when kTLS can't be used for
+	// the connection, e.g. when the tls kernel module isn't loaded.
+	if (enableKernelTLS) {
+		SSL_CTX_set_options(ctx, SSL_OP_ENABLE_KTLS);
+	}
+#endif
+
+	if (enableHTTP2) {
+		SSL_CTX_set_alpn_select_cb(ctx, SelectProtocol, nullptr);
+	}
+
+	SSL_CTX_set_timeout(ctx, static_cast<long>(sessionTimeout.count()));
+
+	SSL_CTX_set_tlsext_servername_callback(ctx, SelectServerName);
+	SSL_CTX_set_tlsext_servername_arg(ctx, this);
+
+	if (sessionCache == nullptr) {
+		sessionCache = std::make_unique<TLSSessionCache>(sessionCacheCapacity, ticketKeyLifetime);
+	}
+	if (!sessionCache->Attach(ctx)) {
+		Logger::Error("TLSConfiguration::CreateContext", "Failed to install the session cache");
+		ERR_print_errors_fp(stderr);
+		return false;
+	}
+
 	if (!cipherList.empty() &&
 		!SSL_CTX_set_cipher_list(ctx, cipherList.c_str())) {
 		ERR_print_errors_fp(stderr);
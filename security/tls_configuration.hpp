@@ -6,8 +6,18 @@
  * See the COPYING file for licensing information.
  */
 
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
 
+#include <cstddef>
+
+#include "security/tls_session_cache.hpp"
+
 namespace Security {
 
 // The TLS configuration is how the security should be handled within Wizard.
@@ -17,6 +27,10 @@ struct TLSConfiguration {
 
 	~TLSConfiguration();
 
+	// Creates the context from the files below. When there is a context
+	// already, e.g. when the certificates have been renewed, it is replaced
+	// atomically: the connections that are set up use the new one, and the
+	// others keep the old one. On failure, the current context is kept.
 	[[nodiscard]] bool
 	CreateContext();
 
@@ -50,12 +64,76 @@ struct TLSConfiguration {
 	// TODO better further reading source
 	std::string cipherSuites;
 
+	// Whether or not the TLS records should be encrypted by the kernel (kTLS)
+	// when the kernel and the negotiated cipher support it. This allows files
+	// to be sent with sendfile(2), without copying them to userspace.
+	// Read more at https://www.kernel.org/doc/html/latest/networking/tls.html
+	bool enableKernelTLS{ true };
+
+	// Whether or not HTTP/2 is offered with ALPN, next to HTTP/1.1. Without
+	// TLS, this allows HTTP/2 with prior knowledge as well.
+	// Read more at https://www.rfc-editor.org/rfc/rfc7540#section-3
+	bool enableHTTP2{ true };
+
+	// The maximum amount of sessions kept for session resumption by session
+	// ID. Resumption skips the asymmetric cryptography of the handshake.
+	// Read more at https://www.rfc-editor.org/rfc/rfc5246#appendix-F.1.4
+	std::size_t sessionCacheCapacity{ 20480 };
+
+	// How long a session (by ID or ticket) can be resumed.
+	std::chrono::seconds sessionTimeout{ std::chrono::hours(2) };
+
+	// How long a session ticket key is used to encrypt new tickets. Tickets
+	// of the previous key are accepted for another lifetime.
+	// Read more at https://www.rfc-editor.org/rfc/rfc5077#section-4
+	std::chrono::seconds ticketKeyLifetime{ std::chrono::hours(12) };
+
+	// The configurations with the certificates of other hostnames, by the
+	// lowercase hostname, e.g. those of the virtual hosts. The configuration
+	// is selected by the server name the client indicates (SNI), and this
+	// one is used for the other names and clients that don't indicate one.
+	// The contexts should be created before the handshakes, and the entries
+	// shouldn't change afterwards.
+	// Read more at https://www.rfc-editor.org/rfc/rfc6066#section-3
+	std::map<std::string, const TLSConfiguration *, std::less<>> serverNames;
+
+	// The session cache and ticket keys shared by all connections of the
+	// context. Created by the first CreateContext, and kept by the contexts
+	// replacing it, so sessions survive a reload.
+	std::unique_ptr<TLSSessionCache> sessionCache;
+
 	// The context is dependent on the TLS implementation, but often represents
-	// the compiled configuration, with loaded certificates and all.
+	// the compiled configuration, with loaded certificates and all. It is
+	// replaced by CreateContext while connections are set up with it, so
+	// connections should use AcquireContext instead.
 	//
 	// e.g. OpenSSL: "void *" is actually "SSL_CTX *"
-	void *context{ nullptr };
+	std::atomic<void *> context{ nullptr };
+
+	// Returns the current context with a reference for the caller, which
+	// should be given back with ReleaseContext, or nullptr if there is none.
+	// The connections set up with a context hold references of their own, so
+	// a context that has been replaced is freed with its last connection.
+	[[nodiscard]] void *
+	AcquireContext() const noexcept;
+
+	static void
+	ReleaseContext(void *context) noexcept;
+
+private:
+	// Taken to replace the context, and to take a reference to it, so it
+	// can't be freed in between loading it and taking the reference.
+	mutable std::mutex contextMutex;
 
+	// Creates a context from the files, or returns nullptr.
+	[[nodiscard]] void *
+	NewContext();
+
+	// Loads the files into [newContext], and sets the options above.
+	//
+	// Returns success status
+	[[nodiscard]] bool
+	ConfigureContext(void *newContext);
 };
 
 } // namespace Security
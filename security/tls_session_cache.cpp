@@ -0,0 +1,283 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include "tls_session_cache.hpp"
+
+#define TLS_LIBRARY_OPENSSL
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <utility>
+
+#include <cstring>
+
+#if defined(TLS_LIBRARY_OPENSSL)
+#include <openssl/core_names.h>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include <openssl/ssl.h>
+#else
+#error Unsupported TLS Library
+#endif
+
+namespace Security {
+
+// The index of the SSL_CTX ex_data the cache is stored in.
+static int
+ContextIndex() noexcept {
+	static const int index = SSL_CTX_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+	return index;
+}
+
+static int
+NewSessionCallback(SSL *ssl, SSL_SESSION *session) {
+	auto *cache = TLSSessionCache::Of(SSL_get_SSL_CTX(ssl));
+
+	unsigned int idLength;
+	const unsigned char *id = SSL_SESSION_get_id(session, &idLength);
+
+	const int length = i2d_SSL_SESSION(session, nullptr);
+	if (cache == nullptr || length <= 0) {
+		return 0;
+	}
+
+	std::string serialized(static_cast<std::size_t>(length), '\0');
+	auto *destination = reinterpret_cast<unsigned char *>(serialized.data());
+	if (i2d_SSL_SESSION(session, &destination) != length) {
+		return 0;
+	}
+
+	cache->Store({ reinterpret_cast<const char *>(id), idLength }, std::move(serialized));
+
+	// The cache has its own (serialized) copy, so it doesn't keep the
+	// reference.
+	return 0;
+}
+
+static SSL_SESSION *
+GetSessionCallback(SSL *ssl, const unsigned char *id, int idLength, int *copy) {
+	auto *cache = TLSSessionCache::Of(SSL_get_SSL_CTX(ssl));
+	*copy = 0;
+
+	if (cache == nullptr) {
+		return nullptr;
+	}
+
+	const auto serialized = cache->Find({ reinterpret_cast<const char *>(id), static_cast<std::size_t>(idLength) });
+	if (serialized.empty()) {
+		return nullptr;
+	}
+
+	// OpenSSL checks whether the session has expired.
+	const auto *source = reinterpret_cast<const unsigned char *>(serialized.data());
+	return d2i_SSL_SESSION(nullptr, &source, static_cast<long>(serialized.length()));
+}
+
+static void
+RemoveSessionCallback(SSL_CTX *context, SSL_SESSION *session) {
+	auto *cache = TLSSessionCache::Of(context);
+	if (cache == nullptr) {
+		return;
+	}
+
+	unsigned int idLength;
+	const unsigned char *id = SSL_SESSION_get_id(session, &idLength);
+	cache->Remove({ reinterpret_cast<const char *>(id), idLength });
+}
+
+// See SSL_CTX_set_tlsext_ticket_key_evp_cb(3).
+static int
+TicketKeyCallback(SSL *ssl, unsigned char *keyName, unsigned char *iv, EVP_CIPHER_CTX *cipherContext,
+				  EVP_MAC_CTX *macContext, int encrypt) {
+	auto *cache = TLSSessionCache::Of(SSL_get_SSL_CTX(ssl));
+	if (cache == nullptr) {
+		return -1;
+	}
+
+	TLSSessionCache::TicketKey key;
+	bool isCurrent = true;
+
+	if (encrypt) {
+		if (!cache->CurrentTicketKey(key) || RAND_bytes(iv, EVP_MAX_IV_LENGTH) != 1) {
+			return -1;
+		}
+		std::copy(std::cbegin(key.name), std::cend(key.name), keyName);
+	} else if (!cache->FindTicketKey(keyName, key, isCurrent)) {
+		cache->RecordRejectedTicket();
+		return 0;
+	}
+
+	std::array<OSSL_PARAM, 3> parameters{
+		OSSL_PARAM_construct_octet_string(OSSL_MAC_PARAM_KEY, key.macKey.data(), key.macKey.size()),
+		OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, const_cast<char *>("SHA256"), 0),
+		OSSL_PARAM_construct_end(),
+	};
+
+	if (EVP_MAC_CTX_set_params(macContext, parameters.data()) != 1) {
+		return -1;
+	}
+
+	const int status = encrypt
+		? EVP_EncryptInit_ex(cipherContext, EVP_aes_256_cbc(), nullptr, key.cipherKey.data(), iv)
+		: EVP_DecryptInit_ex(cipherContext, EVP_aes_256_cbc(), nullptr, key.cipherKey.data(), iv);
+	if (status != 1) {
+		return -1;
+	}
+
+	// 2 means the ticket is valid, but a new one should be issued.
+	return isCurrent ? 1 : 2;
+}
+
+TLSSessionCache::TLSSessionCache(std::size_t capacity, std::chrono::seconds ticketKeyLifetime) noexcept
+	: stripeCapacity(std::max<std::size_t>(1, (capacity + stripeCount - 1) / stripeCount)),
+	  ticketKeyLifetime(ticketKeyLifetime) {
+}
+
+bool
+TLSSessionCache::Attach(void *context) noexcept {
+	auto *ctx = reinterpret_cast<SSL_CTX *>(context);
+
+	const char sessionIDContext[] = "Wizard";
+	if (ContextIndex() == -1 || SSL_CTX_set_ex_data(ctx, ContextIndex(), this) != 1 ||
+		SSL_CTX_set_session_id_context(ctx, reinterpret_cast<const unsigned char *>(sessionIDContext),
+									   sizeof(sessionIDContext) - 1) != 1) {
+		return false;
+	}
+
+	// Only use the external cache, i.e. this one.
+	SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER | SSL_SESS_CACHE_NO_INTERNAL);
+	SSL_CTX_sess_set_new_cb(ctx, NewSessionCallback);
+	SSL_CTX_sess_set_get_cb(ctx, GetSessionCallback);
+	SSL_CTX_sess_set_remove_cb(ctx, RemoveSessionCallback);
+
+	return SSL_CTX_set_tlsext_ticket_key_evp_cb(ctx, TicketKeyCallback) == 1;
+}
+
+bool
+TLSSessionCache::CurrentTicketKey(TicketKey &key) noexcept {
+	const auto now = std::chrono::steady_clock::now();
+	std::lock_guard guard(ticketKeyMutex);
+
+	if (!hasTicketKey || now - ticketKeyCreation >= ticketKeyLifetime) {
+		TicketKey next;
+		if (RAND_bytes(next.name.data(), next.name.size()) != 1 ||
+			RAND_bytes(next.cipherKey.data(), next.cipherKey.size()) != 1 ||
+			RAND_bytes(next.macKey.data(), next.macKey.size()) != 1) {
+			return false;
+		}
+
+		previousTicketKey = currentTicketKey;
+		hasPreviousTicketKey = hasTicketKey;
+		currentTicketKey = next;
+		ticketKeyCreation = now;
+		hasTicketKey = true;
+	}
+
+	key = currentTicketKey;
+	return true;
+}
+
+std::string
+TLSSessionCache::Find(std::string_view id) noexcept {
+	auto &stripe = StripeOf(id);
+	std::lock_guard guard(stripe.mutex);
+
+	const auto result = stripe.sessions.find(id);
+	if (result == std::end(stripe.sessions)) {
+		cacheMisses.fetch_add(1, std::memory_order_relaxed);
+		return {};
+	}
+
+	cacheHits.fetch_add(1, std::memory_order_relaxed);
+	return result->second.first;
+}
+
+bool
+TLSSessionCache::FindTicketKey(const unsigned char *name, TicketKey &key, bool &isCurrent) noexcept {
+	const auto now = std::chrono::steady_clock::now();
+	std::lock_guard guard(ticketKeyMutex);
+
+	const auto matches = [name](const TicketKey &candidate) {
+		return std::equal(std::cbegin(candidate.name), std::cend(candidate.name), name);
+	};
+
+	if (hasTicketKey && matches(currentTicketKey)) {
+		key = currentTicketKey;
+		isCurrent = true;
+		return true;
+	}
+
+	// The previous key expires a lifetime after it has been replaced.
+	if (hasPreviousTicketKey && matches(previousTicketKey) &&
+		now - ticketKeyCreation < ticketKeyLifetime) {
+		key = previousTicketKey;
+		isCurrent = false;
+		return true;
+	}
+
+	return false;
+}
+
+TLSSessionCache *
+TLSSessionCache::Of(void *context) noexcept {
+	if (ContextIndex() == -1) {
+		return nullptr;
+	}
+
+	return reinterpret_cast<TLSSessionCache *>(SSL_CTX_get_ex_data(reinterpret_cast<SSL_CTX *>(context), ContextIndex()));
+}
+
+void
+TLSSessionCache::Remove(std::string_view id) noexcept {
+	auto &stripe = StripeOf(id);
+	std::lock_guard guard(stripe.mutex);
+
+	const auto result = stripe.sessions.find(id);
+	if (result != std::end(stripe.sessions)) {
+		const auto position = result->second.second;
+		stripe.sessions.erase(result);
+		stripe.order.erase(position);
+	}
+}
+
+TLSSessionStatistics
+TLSSessionCache::Statistics() const noexcept {
+	return {
+		fullHandshakes.load(std::memory_order_relaxed),
+		resumedHandshakes.load(std::memory_order_relaxed),
+		cacheHits.load(std::memory_order_relaxed),
+		cacheMisses.load(std::memory_order_relaxed),
+		ticketsRejected.load(std::memory_order_relaxed),
+	};
+}
+
+void
+TLSSessionCache::Store(std::string_view id, std::string &&session) noexcept {
+	auto &stripe = StripeOf(id);
+	std::lock_guard guard(stripe.mutex);
+
+	if (const auto existing = stripe.sessions.find(id); existing != std::end(stripe.sessions)) {
+		existing->second.first = std::move(session);
+		return;
+	}
+
+	if (stripe.sessions.size() == stripeCapacity) {
+		stripe.sessions.erase(stripe.order.front());
+		stripe.order.pop_front();
+	}
+
+	stripe.order.emplace_back(id);
+	const auto position = std::prev(std::end(stripe.order));
+	stripe.sessions.emplace(*position, std::make_pair(std::move(session), position));
+}
+
+TLSSessionCache::Stripe &
+TLSSessionCache::StripeOf(std::string_view id) noexcept {
+	return stripes[std::hash<std::string_view>{}(id) % stripeCount];
+}
+
+} // namespace Security
@@ -0,0 +1,143 @@
+#pragma once
+
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <list>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Security {
+
+struct TLSSessionStatistics {
+	// Handshakes that created a new session, i.e. with the full asymmetric
+	// cryptography.
+	std::uint64_t fullHandshakes;
+
+	// Handshakes that resumed a session, from the cache or from a ticket.
+	std::uint64_t resumedHandshakes;
+
+	// Lookups of session IDs in the cache.
+	std::uint64_t cacheHits;
+	std::uint64_t cacheMisses;
+
+	// Tickets that couldn't be decrypted, e.g. because the key has expired.
+	std::uint64_t ticketsRejected;
+};
+
+// The server-side state for TLS session resumption, shared by all the
+// connections (and thus threads) of a TLS context:
+//   - A cache of sessions by session ID, split into stripes with a lock each,
+//     which replaces the internal cache of the TLS library, which has a
+//     single lock.
+//   - The keys session tickets are encrypted with. The keys are rotated, and
+//     tickets of the previous key are still accepted (and renewed).
+class TLSSessionCache {
+public:
+	// [capacity] is the maximum amount of sessions stored. The ticket key is
+	// replaced after [ticketKeyLifetime].
+	TLSSessionCache(std::size_t capacity, std::chrono::seconds ticketKeyLifetime) noexcept;
+
+	// Installs the cache and ticket key callbacks on [context], which is the
+	// TLS context of the implementation (e.g. SSL_CTX * for OpenSSL).
+	//
+	// Returns success status
+	[[nodiscard]] bool
+	Attach(void *context) noexcept;
+
+	// Returns the cache attached to [context], or nullptr.
+	[[nodiscard]] static TLSSessionCache *
+	Of(void *context) noexcept;
+
+	// Should be called after each completed handshake.
+	inline void
+	RecordHandshake(bool resumed) noexcept {
+		(resumed ? resumedHandshakes : fullHandshakes).fetch_add(1, std::memory_order_relaxed);
+	}
+
+	[[nodiscard]] TLSSessionStatistics
+	Statistics() const noexcept;
+
+	// The functions below are used by the callbacks of the TLS library.
+
+	// Returns the serialized session with [id], or an empty string.
+	[[nodiscard]] std::string
+	Find(std::string_view id) noexcept;
+
+	void
+	Remove(std::string_view id) noexcept;
+
+	void
+	Store(std::string_view id, std::string &&session) noexcept;
+
+	struct TicketKey {
+		std::array<unsigned char, 16> name;
+		std::array<unsigned char, 32> cipherKey;
+		std::array<unsigned char, 32> macKey;
+	};
+
+	// Gets the key to encrypt new tickets with, rotating the keys when the
+	// current has expired.
+	//
+	// Returns success status
+	[[nodiscard]] bool
+	CurrentTicketKey(TicketKey &key) noexcept;
+
+	// Gets the key named [name] to decrypt a ticket with. [isCurrent] is set
+	// to false if the key is the previous key, in which case the ticket should
+	// be renewed.
+	//
+	// Returns whether or not the key was found
+	[[nodiscard]] bool
+	FindTicketKey(const unsigned char *name, TicketKey &key, bool &isCurrent) noexcept;
+
+	inline void
+	RecordRejectedTicket() noexcept {
+		ticketsRejected.fetch_add(1, std::memory_order_relaxed);
+	}
+
+private:
+	struct Stripe {
+		std::mutex mutex;
+
+		// Ordered from the oldest to the newest session. The keys of the map
+		// are the IDs stored in the list.
+		std::list<std::string> order;
+		std::unordered_map<std::string_view, std::pair<std::string, std::list<std::string>::iterator>> sessions;
+	};
+
+	static constexpr std::size_t stripeCount = 16;
+
+	const std::size_t stripeCapacity;
+	std::array<Stripe, stripeCount> stripes;
+
+	const std::chrono::seconds ticketKeyLifetime;
+	std::mutex ticketKeyMutex;
+	TicketKey currentTicketKey{};
+	TicketKey previousTicketKey{};
+	bool hasPreviousTicketKey{ false };
+	std::chrono::steady_clock::time_point ticketKeyCreation{};
+	bool hasTicketKey{ false };
+
+	std::atomic<std::uint64_t> fullHandshakes{ 0 };
+	std::atomic<std::uint64_t> resumedHandshakes{ 0 };
+	std::atomic<std::uint64_t> cacheHits{ 0 };
+	std::atomic<std::uint64_t> cacheMisses{ 0 };
+	std::atomic<std::uint64_t> ticketsRejected{ 0 };
+
+	[[nodiscard]] Stripe &
+	StripeOf(std::string_view id) noexcept;
+};
+
+} // namespace Security
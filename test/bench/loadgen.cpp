@@ -0,0 +1,829 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+// The end-to-end benchmark: a load generator that drives a server over real
+// connections, and reports the throughput and the latency percentiles. By
+// default it starts an HTTP::Server of its own, serving a generated file:
+//
+//     loadgen --connections=256 --threads=2 --pipeline=4 --duration=10
+//     loadgen --tls --certificate=cert.pem --private-key=key.pem
+//     loadgen --host=192.0.2.1 --port=443 --tls --path=/index.html
+//
+// Every connection sends [pipeline] requests at once, and sends the next batch
+// once all responses have been received. The latency of a request is the time
+// from sending its batch until its response has been received completely.
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <cctype>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+
+#include "base/media_type.hpp"
+#include "cgi/manager.hpp"
+#include "event/loop.hpp"
+#include "http/configuration.hpp"
+#include "http/server.hpp"
+#include "security/policies.hpp"
+#include "security/tls_configuration.hpp"
+
+// The amount of octets read from a connection at once.
+#define MAGIC_LOADGEN_READ_SIZE 16384
+
+// How long a generator waits for events before checking whether it should
+// stop, in milliseconds.
+#define MAGIC_LOADGEN_POLL_TIMEOUT 50
+
+namespace {
+
+struct Options {
+	// The server to drive. Without a port, a server is started in-process.
+	std::string host{ "127.0.0.1" };
+	std::uint16_t port{ 0 };
+	std::string path{ "/" };
+	std::string hostHeader{ "localhost" };
+
+	std::size_t connections{ 64 };
+	std::size_t threads{ 1 };
+	std::size_t pipeline{ 1 };
+	bool keepAlive{ true };
+	bool tls{ false };
+	std::chrono::seconds duration{ 10 };
+	std::chrono::seconds warmup{ 1 };
+
+	// The in-process server. The file at [path] is generated with
+	// [bodySize] octets, unless a root directory is given.
+	std::uint16_t serverPort{ 8089 };
+	std::string rootDirectory;
+	std::size_t bodySize{ 1024 };
+	bool eventDriven{ true };
+	std::string certificateFile;
+	std::string privateKeyFile;
+};
+
+struct Statistics {
+	// The latencies of the requests, in nanoseconds.
+	std::vector<std::uint64_t> latencies;
+
+	std::uint64_t requests{ 0 };
+	std::uint64_t errors{ 0 };
+	std::uint64_t octets{ 0 };
+	std::uint64_t connects{ 0 };
+};
+
+// The shared state of the generators.
+struct Run {
+	const Options &options;
+	const struct sockaddr_storage &address;
+	const socklen_t addressLength;
+	SSL_CTX *context;
+	std::string batch;
+
+	// Only the exchanges in the measured period are recorded.
+	std::atomic<bool> recording{ false };
+	std::atomic<bool> stopping{ false };
+};
+
+[[nodiscard]] bool
+EqualsIgnoreCase(std::string_view a, std::string_view b) noexcept {
+	return a.length() == b.length() && std::equal(std::cbegin(a), std::cend(a), std::cbegin(b), [](char x, char y) {
+		return std::tolower(static_cast<unsigned char>(x)) == std::tolower(static_cast<unsigned char>(y));
+	});
+}
+
+// The framing of a response, as far as the generator needs it.
+struct ResponseHead {
+	std::size_t headLength;
+	std::size_t bodyLength;
+	int status;
+	bool closes;
+};
+
+// Returns false if [input] doesn't start with a complete head yet. Sets
+// [head.status] to -1 if the head is malformed, or isn't framed by
+// Content-Length.
+[[nodiscard]] bool
+ParseResponseHead(std::string_view input, ResponseHead &head) noexcept {
+	const auto end = input.find("\r\n\r\n");
+	if (end == std::string_view::npos) {
+		return false;
+	}
+
+	head = { end + 4, 0, -1, false };
+	if (input.length() < 12 || input.substr(0, 5) != "HTTP/") {
+		return true;
+	}
+	head.status = std::atoi(std::string(input.substr(9, 3)).c_str());
+
+	bool hasLength = false;
+	auto lines = input.substr(0, end);
+	while (!lines.empty()) {
+		const auto lineEnd = lines.find("\r\n");
+		const auto line = lines.substr(0, lineEnd);
+		lines = lineEnd == std::string_view::npos ? std::string_view() : lines.substr(lineEnd + 2);
+
+		const auto colon = line.find(':');
+		if (colon == std::string_view::npos) {
+			continue;
+		}
+
+		const auto name = line.substr(0, colon);
+		auto value = line.substr(colon + 1);
+		value.remove_prefix(std::min(value.find_first_not_of(' '), value.length()));
+
+		if (EqualsIgnoreCase(name, "Content-Length")) {
+			head.bodyLength = std::strtoull(std::string(value).c_str(), nullptr, 10);
+			hasLength = true;
+		} else if (EqualsIgnoreCase(name, "Connection")) {
+			head.closes = EqualsIgnoreCase(value, "close");
+		}
+	}
+
+	// Spec: RFC 7230 § 3.3.3
+	if (head.status / 100 == 1 || head.status == 204 || head.status == 304) {
+		head.bodyLength = 0;
+	} else if (!hasLength) {
+		head.status = -1;
+	}
+
+	return true;
+}
+
+class Generator;
+
+class LoadConnection : public Event::Handler {
+public:
+	explicit LoadConnection(Generator &generator) noexcept :
+		generator(generator) {
+	}
+
+	~LoadConnection() noexcept override {
+		Close();
+		SSL_SESSION_free(session);
+	}
+
+	LoadConnection(const LoadConnection &) = delete;
+	LoadConnection &operator=(const LoadConnection &) = delete;
+
+	[[nodiscard]] bool
+	Open() noexcept;
+
+	void
+	Close() noexcept;
+
+	void
+	OnEvent(std::uint32_t events) noexcept override;
+
+private:
+	enum class State {
+		CONNECTING,
+		HANDSHAKE,
+		SENDING,
+		RECEIVING,
+		CLOSED,
+	};
+
+	Generator &generator;
+	State state{ State::CLOSED };
+	int fd{ -1 };
+	SSL *ssl{ nullptr };
+
+	// The session of the previous connection, which is resumed.
+	SSL_SESSION *session{ nullptr };
+
+	std::size_t sent{ 0 };
+	std::size_t outstanding{ 0 };
+	bool closes{ false };
+	std::chrono::steady_clock::time_point batchStart;
+	std::string received;
+
+	void
+	Continue() noexcept;
+
+	void
+	Fail() noexcept;
+
+	// Closes the connection and opens a new one, or stops when the run is
+	// over.
+	void
+	Reconnect() noexcept;
+
+	void
+	StartBatch() noexcept;
+
+	void
+	Flush() noexcept;
+
+	void
+	Receive() noexcept;
+
+	// Returns whether the responses could be interpreted.
+	[[nodiscard]] bool
+	ConsumeResponses() noexcept;
+
+	// Returns the amount of octets transferred, 0 if the peer closed the
+	// connection, and -1 for errors and when the connection would block.
+	[[nodiscard]] ssize_t
+	Read(char *buffer, std::size_t length) noexcept;
+
+	[[nodiscard]] ssize_t
+	Write(const char *buffer, std::size_t length) noexcept;
+
+	[[nodiscard]] bool
+	WouldBlock() const noexcept;
+
+	void
+	Await(std::uint32_t interest) noexcept;
+};
+
+// Runs the connections of a thread on an event loop of its own.
+class Generator {
+public:
+	Generator(Run &run, std::size_t connectionCount) noexcept :
+		run(run), connectionCount(connectionCount) {
+	}
+
+	[[nodiscard]] bool
+	Initialize() noexcept {
+		if (!loop.Initialize()) {
+			return false;
+		}
+
+		for (std::size_t i = 0; i < connectionCount; i++) {
+			connections.push_back(std::make_unique<LoadConnection>(*this));
+			if (!connections.back()->Open()) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void
+	Execute() noexcept {
+		while (!run.stopping.load(std::memory_order_relaxed)) {
+			if (!loop.RunOnce(MAGIC_LOADGEN_POLL_TIMEOUT)) {
+				break;
+			}
+		}
+
+		for (auto &connection : connections) {
+			connection->Close();
+		}
+	}
+
+	[[nodiscard]] inline bool
+	Recording() const noexcept {
+		return run.recording.load(std::memory_order_relaxed);
+	}
+
+	Run &run;
+	Event::Loop loop;
+	Statistics statistics;
+
+private:
+	const std::size_t connectionCount;
+	std::vector<std::unique_ptr<LoadConnection>> connections;
+};
+
+bool
+LoadConnection::Open() noexcept {
+	const auto &run = generator.run;
+	fd = socket(run.address.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd == -1) {
+		return false;
+	}
+
+	const int enable = 1;
+	static_cast<void>(setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable)));
+
+	if (connect(fd, reinterpret_cast<const struct sockaddr *>(&run.address), run.addressLength) != 0 &&
+		errno != EINPROGRESS) {
+		close(fd);
+		fd = -1;
+		return false;
+	}
+
+	if (generator.Recording()) {
+		generator.statistics.connects++;
+	}
+
+	state = State::CONNECTING;
+	received.clear();
+	closes = false;
+	outstanding = 0;
+	return generator.loop.Add(fd, this, Event::Interest::write);
+}
+
+void
+LoadConnection::Close() noexcept {
+	if (fd == -1) {
+		return;
+	}
+
+	generator.loop.Remove(fd);
+	if (ssl != nullptr) {
+		if (auto *current = SSL_get1_session(ssl)) {
+			SSL_SESSION_free(session);
+			session = current;
+		}
+		SSL_free(ssl);
+		ssl = nullptr;
+	}
+	close(fd);
+	fd = -1;
+	state = State::CLOSED;
+}
+
+void
+LoadConnection::Fail() noexcept {
+	if (generator.Recording()) {
+		generator.statistics.errors++;
+	}
+	Reconnect();
+}
+
+void
+LoadConnection::Reconnect() noexcept {
+	Close();
+	if (!generator.run.stopping.load(std::memory_order_relaxed) && !Open()) {
+		if (generator.Recording()) {
+			generator.statistics.errors++;
+		}
+	}
+}
+
+void
+LoadConnection::OnEvent(std::uint32_t) noexcept {
+	Continue();
+}
+
+void
+LoadConnection::Continue() noexcept {
+	switch (state) {
+		case State::CONNECTING:
+			// A connect(2) on a connected socket reports whether the
+			// connection has been established.
+			if (connect(fd, reinterpret_cast<const struct sockaddr *>(&generator.run.address),
+						generator.run.addressLength) != 0 && errno != EISCONN) {
+				if (errno != EALREADY && errno != EINPROGRESS) {
+					Fail();
+				}
+				return;
+			}
+
+			if (generator.run.context == nullptr) {
+				StartBatch();
+				return;
+			}
+
+			ssl = SSL_new(generator.run.context);
+			if (ssl == nullptr || SSL_set_fd(ssl, fd) != 1 ||
+				SSL_set_tlsext_host_name(ssl, generator.run.options.hostHeader.c_str()) != 1) {
+				Fail();
+				return;
+			}
+			if (session != nullptr) {
+				static_cast<void>(SSL_set_session(ssl, session));
+			}
+			SSL_set_connect_state(ssl);
+			state = State::HANDSHAKE;
+			[[fallthrough]];
+		case State::HANDSHAKE: {
+			const int result = SSL_do_handshake(ssl);
+			if (result == 1) {
+				StartBatch();
+				return;
+			}
+
+			const int error = SSL_get_error(ssl, result);
+			if (error == SSL_ERROR_WANT_READ) {
+				Await(Event::Interest::read);
+			} else if (error == SSL_ERROR_WANT_WRITE) {
+				Await(Event::Interest::write);
+			} else {
+				ERR_clear_error();
+				Fail();
+			}
+			return;
+		}
+		case State::SENDING:
+			Flush();
+			return;
+		case State::RECEIVING:
+			Receive();
+			return;
+		case State::CLOSED:
+			return;
+	}
+}
+
+void
+LoadConnection::StartBatch() noexcept {
+	state = State::SENDING;
+	sent = 0;
+	outstanding = generator.run.options.pipeline;
+	batchStart = std::chrono::steady_clock::now();
+	Flush();
+}
+
+void
+LoadConnection::Flush() noexcept {
+	const auto &batch = generator.run.batch;
+	while (sent < batch.length()) {
+		const auto result = Write(batch.data() + sent, batch.length() - sent);
+		if (result <= 0) {
+			if (WouldBlock()) {
+				Await(Event::Interest::write);
+			} else {
+				Fail();
+			}
+			return;
+		}
+		sent += static_cast<std::size_t>(result);
+	}
+
+	state = State::RECEIVING;
+	Await(Event::Interest::read);
+
+	// The responses might have been read during the handshake.
+	if (!received.empty() && !ConsumeResponses()) {
+		Fail();
+	}
+}
+
+void
+LoadConnection::Receive() noexcept {
+	std::array<char, MAGIC_LOADGEN_READ_SIZE> buffer;
+	while (state == State::RECEIVING) {
+		const auto result = Read(buffer.data(), buffer.size());
+		if (result < 0 && WouldBlock()) {
+			return;
+		}
+
+		if (result <= 0) {
+			// The server closed the connection, which is only expected after
+			// the last response.
+			if (outstanding != 0) {
+				Fail();
+			} else {
+				Reconnect();
+			}
+			return;
+		}
+
+		received.append(buffer.data(), static_cast<std::size_t>(result));
+		if (!ConsumeResponses()) {
+			Fail();
+			return;
+		}
+	}
+}
+
+bool
+LoadConnection::ConsumeResponses() noexcept {
+	std::size_t offset = 0;
+	ResponseHead head{};
+	while (outstanding != 0 && ParseResponseHead(std::string_view(received).substr(offset), head)) {
+		if (head.status == -1) {
+			return false;
+		}
+
+		const auto length = head.headLength + head.bodyLength;
+		if (received.length() - offset < length) {
+			break;
+		}
+
+		offset += length;
+		outstanding--;
+		closes |= head.closes;
+
+		if (generator.Recording()) {
+			auto &statistics = generator.statistics;
+			const auto latency = std::chrono::steady_clock::now() - batchStart;
+			statistics.latencies.push_back(static_cast<std::uint64_t>(
+				std::chrono::duration_cast<std::chrono::nanoseconds>(latency).count()));
+			statistics.requests++;
+			statistics.octets += length;
+			if (head.status >= 400) {
+				statistics.errors++;
+			}
+		}
+
+		// The server limits the amount of requests per connection.
+		closes |= head.status == 429;
+	}
+	received.erase(0, offset);
+
+	if (outstanding == 0) {
+		if (closes || !generator.run.options.keepAlive) {
+			Reconnect();
+		} else if (!generator.run.stopping.load(std::memory_order_relaxed)) {
+			StartBatch();
+		}
+	}
+	return true;
+}
+
+ssize_t
+LoadConnection::Read(char *buffer, std::size_t length) noexcept {
+	if (ssl == nullptr) {
+		return recv(fd, buffer, length, 0);
+	}
+
+	const int result = SSL_read(ssl, buffer, static_cast<int>(length));
+	if (result > 0) {
+		return result;
+	}
+	if (SSL_get_error(ssl, result) == SSL_ERROR_ZERO_RETURN) {
+		return 0;
+	}
+	return -1;
+}
+
+ssize_t
+LoadConnection::Write(const char *buffer, std::size_t length) noexcept {
+	if (ssl == nullptr) {
+		return send(fd, buffer, length, MSG_NOSIGNAL);
+	}
+
+	const int result = SSL_write(ssl, buffer, static_cast<int>(length));
+	return result > 0 ? result : -1;
+}
+
+bool
+LoadConnection::WouldBlock() const noexcept {
+	if (ssl == nullptr) {
+		return errno == EAGAIN || errno == EWOULDBLOCK;
+	}
+
+	// The error of the last operation is kept by the library, so the
+	// result is passed as -1.
+	const int error = SSL_get_error(ssl, -1);
+	if (error == SSL_ERROR_WANT_READ || error == SSL_ERROR_WANT_WRITE) {
+		return true;
+	}
+	ERR_clear_error();
+	return false;
+}
+
+void
+LoadConnection::Await(std::uint32_t interest) noexcept {
+	if (!generator.loop.Modify(fd, this, interest)) {
+		Fail();
+	}
+}
+
+[[nodiscard]] bool
+ParseOptions(int argc, char *argv[], Options &options) {
+	for (int i = 1; i < argc; i++) {
+		const std::string_view argument(argv[i]);
+		const auto equals = argument.find('=');
+		const auto name = argument.substr(0, equals);
+		const std::string value(equals == std::string_view::npos ? std::string_view() : argument.substr(equals + 1));
+		const auto number = std::strtoull(value.c_str(), nullptr, 10);
+
+		if (name == "--host") {
+			options.host = value;
+		} else if (name == "--port") {
+			options.port = static_cast<std::uint16_t>(number);
+		} else if (name == "--path") {
+			options.path = value;
+		} else if (name == "--host-header") {
+			options.hostHeader = value;
+		} else if (name == "--connections") {
+			options.connections = std::max<std::size_t>(number, 1);
+		} else if (name == "--threads") {
+			options.threads = std::max<std::size_t>(number, 1);
+		} else if (name == "--pipeline") {
+			options.pipeline = std::max<std::size_t>(number, 1);
+		} else if (name == "--no-keep-alive") {
+			options.keepAlive = false;
+		} else if (name == "--tls") {
+			options.tls = true;
+		} else if (name == "--duration") {
+			options.duration = std::chrono::seconds(std::max<std::size_t>(number, 1));
+		} else if (name == "--warmup") {
+			options.warmup = std::chrono::seconds(number);
+		} else if (name == "--server-port") {
+			options.serverPort = static_cast<std::uint16_t>(number);
+		} else if (name == "--root") {
+			options.rootDirectory = value;
+		} else if (name == "--body-size") {
+			options.bodySize = number;
+		} else if (name == "--thread-per-client") {
+			options.eventDriven = false;
+		} else if (name == "--certificate") {
+			options.certificateFile = value;
+		} else if (name == "--private-key") {
+			options.privateKeyFile = value;
+		} else {
+			std::fprintf(stderr, "Unknown option: %s\n", argv[i]);
+			return false;
+		}
+	}
+
+	if (options.connections < options.threads) {
+		options.threads = options.connections;
+	}
+
+	if (options.port == 0 && options.tls && (options.certificateFile.empty() || options.privateKeyFile.empty())) {
+		std::fputs("The in-process server needs --certificate and --private-key for TLS\n", stderr);
+		return false;
+	}
+	return true;
+}
+
+[[nodiscard]] double
+Percentile(const std::vector<std::uint64_t> &sorted, double fraction) noexcept {
+	if (sorted.empty()) {
+		return 0;
+	}
+	const auto index = std::min(sorted.size() - 1, static_cast<std::size_t>(fraction * static_cast<double>(sorted.size())));
+	return static_cast<double>(sorted[index]) / 1e6;
+}
+
+} // namespace
+
+int
+main(int argc, char *argv[]) {
+	Options options;
+	if (!ParseOptions(argc, argv, options)) {
+		std::fputs("Usage: loadgen [--connections=N] [--threads=N] [--pipeline=N] [--duration=S] [--warmup=S]\n"
+				   "               [--no-keep-alive] [--tls] [--path=P] [--host-header=H]\n"
+				   "               [--host=A --port=N] | [--server-port=N] [--root=D] [--body-size=N]\n"
+				   "               [--thread-per-client] [--certificate=F --private-key=F]\n", stderr);
+		return EXIT_FAILURE;
+	}
+	std::signal(SIGPIPE, SIG_IGN);
+
+	// The in-process server.
+	CGI::Manager manager;
+	MediaTypeFinder finder;
+	Security::Policies policies;
+	Security::TLSConfiguration tlsConfiguration;
+	HTTP::Configuration configuration(finder, policies, tlsConfiguration);
+	std::unique_ptr<HTTP::Server> server;
+	std::string generatedFile;
+	std::string generatedDirectory;
+
+	if (options.port == 0) {
+		if (options.rootDirectory.empty()) {
+			generatedDirectory = "/tmp/webserver-loadgen-XXXXXX";
+			if (mkdtemp(generatedDirectory.data()) == nullptr) {
+				std::perror("mkdtemp");
+				return EXIT_FAILURE;
+			}
+			options.rootDirectory = generatedDirectory;
+			generatedFile = generatedDirectory + (options.path == "/" ? "/index.html" : options.path);
+			std::ofstream(generatedFile) << std::string(options.bodySize, 'x');
+		}
+
+		if (options.tls) {
+			tlsConfiguration.certificateFile = options.certificateFile;
+			tlsConfiguration.chainFile = options.certificateFile;
+			tlsConfiguration.privateKeyFile = options.privateKeyFile;
+			tlsConfiguration.enableHTTP2 = false;
+			if (!tlsConfiguration.CreateContext()) {
+				return EXIT_FAILURE;
+			}
+		}
+
+		configuration.hostname = options.hostHeader;
+		configuration.port = options.serverPort;
+		configuration.rootDirectory = options.rootDirectory;
+		configuration.servingMode = options.eventDriven ? HTTP::ServingMode::EVENT_DRIVEN : HTTP::ServingMode::THREAD_PER_CLIENT;
+		configuration.useTransportSecurity = options.tls;
+		configuration.compressionEnabled = false;
+		policies.maxConnectionsPerAddress = 0;
+		policies.maxRequestsPerConnection = 0;
+
+		server = std::make_unique<HTTP::Server>(configuration, manager);
+		if (!server->Initialize()) {
+			std::fputs("Failed to initialize the server\n", stderr);
+			return EXIT_FAILURE;
+		}
+		server->Start();
+		options.port = options.serverPort;
+	}
+
+	struct addrinfo hints{};
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	struct addrinfo *resolved = nullptr;
+	const auto service = std::to_string(options.port);
+	if (getaddrinfo(options.host.c_str(), service.c_str(), &hints, &resolved) != 0 || resolved == nullptr) {
+		std::fprintf(stderr, "Failed to resolve %s\n", options.host.c_str());
+		return EXIT_FAILURE;
+	}
+	struct sockaddr_storage address{};
+	const auto addressLength = resolved->ai_addrlen;
+	std::memcpy(&address, resolved->ai_addr, resolved->ai_addrlen);
+	freeaddrinfo(resolved);
+
+	SSL_CTX *context = nullptr;
+	if (options.tls) {
+		context = SSL_CTX_new(TLS_client_method());
+		if (context == nullptr) {
+			return EXIT_FAILURE;
+		}
+		SSL_CTX_set_verify(context, SSL_VERIFY_NONE, nullptr);
+		SSL_CTX_set_session_cache_mode(context, SSL_SESS_CACHE_CLIENT);
+	}
+
+	Run run{ options, address, addressLength, context, {} };
+	std::string request = "GET " + options.path + " HTTP/1.1\r\nHost: " + options.hostHeader + "\r\n";
+	request += options.keepAlive ? "\r\n" : "Connection: close\r\n\r\n";
+	for (std::size_t i = 0; i < options.pipeline; i++) {
+		run.batch += request;
+	}
+
+	std::vector<std::unique_ptr<Generator>> generators;
+	for (std::size_t i = 0; i < options.threads; i++) {
+		const auto count = options.connections / options.threads + (i < options.connections % options.threads ? 1 : 0);
+		generators.push_back(std::make_unique<Generator>(run, count));
+		if (!generators.back()->Initialize()) {
+			std::fputs("Failed to open the connections\n", stderr);
+			return EXIT_FAILURE;
+		}
+	}
+
+	std::vector<std::thread> threads;
+	for (auto &generator : generators) {
+		threads.emplace_back(&Generator::Execute, generator.get());
+	}
+
+	std::this_thread::sleep_for(options.warmup);
+	run.recording = true;
+	const auto start = std::chrono::steady_clock::now();
+	std::this_thread::sleep_for(options.duration);
+	run.recording = false;
+	const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	run.stopping = true;
+
+	for (auto &thread : threads) {
+		thread.join();
+	}
+
+	Statistics total;
+	for (const auto &generator : generators) {
+		const auto &statistics = generator->statistics;
+		total.latencies.insert(std::end(total.latencies), std::cbegin(statistics.latencies), std::cend(statistics.latencies));
+		total.requests += statistics.requests;
+		total.errors += statistics.errors;
+		total.octets += statistics.octets;
+		total.connects += statistics.connects;
+	}
+	std::sort(std::begin(total.latencies), std::end(total.latencies));
+
+	std::printf("Target:      %s:%u%s, path %s\n", options.host.c_str(), options.port,
+				server == nullptr ? "" : (options.eventDriven ? " (in-process, event-driven)" : " (in-process, thread per client)"),
+				options.path.c_str());
+	std::printf("Load:        %zu connections on %zu threads, pipeline %zu, %s, %s\n", options.connections,
+				options.threads, options.pipeline, options.keepAlive ? "keep-alive" : "a connection per batch",
+				options.tls ? "TLS" : "plaintext");
+	std::printf("Measured:    %.2f s, after a warm-up of %lld s\n", elapsed, static_cast<long long>(options.warmup.count()));
+	std::printf("Requests:    %llu (%.1f/s), %.2f MiB/s\n", static_cast<unsigned long long>(total.requests),
+				static_cast<double>(total.requests) / elapsed, static_cast<double>(total.octets) / elapsed / (1024 * 1024));
+	std::printf("Errors:      %llu, connects: %llu\n", static_cast<unsigned long long>(total.errors),
+				static_cast<unsigned long long>(total.connects));
+	std::printf("Latency:     p50 %.3f ms, p99 %.3f ms, p99.9 %.3f ms, max %.3f ms\n", Percentile(total.latencies, 0.5),
+				Percentile(total.latencies, 0.99), Percentile(total.latencies, 0.999), Percentile(total.latencies, 1));
+
+	if (server != nullptr) {
+		server->SignalShutdown();
+		server->Join();
+	}
+	SSL_CTX_free(context);
+
+	if (!generatedDirectory.empty()) {
+		unlink(generatedFile.c_str());
+		rmdir(generatedDirectory.c_str());
+	}
+
+	return EXIT_SUCCESS;
+}
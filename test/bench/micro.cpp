@@ -0,0 +1,205 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+// The microbenchmarks of the hot paths of an exchange, on the in-memory
+// connection variant. The inputs are fixed, so runs are comparable:
+//
+//     microbench --benchmark_repetitions=10 --benchmark_report_aggregates_only
+//
+// See loadgen.cpp for the end-to-end benchmark.
+
+#define CONNECTION_MEMORY_VARIANT
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+
+#include <cstdlib>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <benchmark/benchmark.h>
+
+#define TESTING_VISIBILITY public
+
+#include "base/media_type.hpp"
+#include "base/strings.hpp"
+#include "cgi/manager.hpp"
+#include "connection/connection.hpp"
+#include "connection/memory_userdata.hpp"
+#include "http/client.hpp"
+#include "http/configuration.hpp"
+#include "http/request_parser.hpp"
+#include "http/server.hpp"
+#include "io/file_resolver.hpp"
+#include "security/policies.hpp"
+#include "security/tls_configuration.hpp"
+
+namespace {
+
+// A request head like those of browsers.
+const std::string requestHead =
+	"GET /assets/css/style.min.css?v=3 HTTP/1.1\r\n"
+	"Host: localhost\r\n"
+	"User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:78.0) Gecko/20100101 Firefox/78.0\r\n"
+	"Accept: text/css,*/*;q=0.1\r\n"
+	"Accept-Language: en-US,en;q=0.5\r\n"
+	"Accept-Encoding: gzip, deflate, br\r\n"
+	"Referer: http://localhost/\r\n"
+	"Connection: keep-alive\r\n"
+	"If-None-Match: \"5eda45b2-2a8c\"\r\n"
+	"Cache-Control: max-age=0\r\n"
+	"\r\n";
+
+// A client of an unstarted server, on an in-memory connection.
+class Fixture {
+public:
+	Fixture() : server(HTTP::Configuration(finder, policies, tlsConfiguration), manager), client(&server) {
+		client.connection = std::make_unique<Connection>(&data);
+	}
+
+	// Makes [input] the input of the connection. The memory connection reads
+	// the input from the back.
+	void
+	SetInput(const std::string &input) {
+		data.input.resize(input.length());
+		std::copy(std::crbegin(input), std::crend(input), std::begin(data.input));
+	}
+
+	CGI::Manager manager;
+	MediaTypeFinder finder;
+	Security::Policies policies;
+	Security::TLSConfiguration tlsConfiguration;
+	HTTP::Server server;
+	MemoryUserData data{};
+	HTTP::Client client;
+};
+
+// The copying consumers of the client, octet by octet.
+void
+ClientConsumeHead(benchmark::State &state) {
+	Fixture fixture;
+	auto &client = fixture.client;
+
+	for (auto _ : state) {
+		fixture.SetInput(requestHead);
+		client.buffers.method.clear();
+
+		if (client.ConsumeMethod() != HTTP::ClientError::NO_ERROR ||
+			client.ConsumePath() != HTTP::ClientError::NO_ERROR ||
+			client.ConsumeVersion() != HTTP::ClientError::NO_ERROR ||
+			client.ConsumeCRLF() != HTTP::ClientError::NO_ERROR ||
+			client.ConsumeHeaders() != HTTP::ClientError::NO_ERROR) {
+			state.SkipWithError("The head couldn't be consumed");
+			break;
+		}
+
+		benchmark::DoNotOptimize(client.currentRequest.headers);
+		client.ResetExchangeState();
+	}
+
+	state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * requestHead.length()));
+}
+BENCHMARK(ClientConsumeHead);
+
+// The incremental parser, which refers to the input instead of copying it.
+void
+RequestParserFeed(benchmark::State &state) {
+	Security::Policies policies;
+	HTTP::Request request;
+	HTTP::RequestParser parser(policies, request, Connection::receiveBufferSize);
+	const base::String head(requestHead.data(), requestHead.length());
+
+	for (auto _ : state) {
+		parser.Reset();
+		request.Reset();
+		if (parser.Feed(head) != HTTP::RequestParser::Status::COMPLETE) {
+			state.SkipWithError("The head couldn't be parsed");
+			break;
+		}
+		benchmark::DoNotOptimize(request.headers);
+	}
+
+	state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * requestHead.length()));
+}
+BENCHMARK(RequestParserFeed);
+
+// The metadata of a file response, with its validators.
+void
+ClientSendMetadata(benchmark::State &state) {
+	Fixture fixture;
+	auto &client = fixture.client;
+	const char *additional = "Accept-Ranges: bytes\r\n"
+							 "ETag: \"5eda45b2-2a8c\"\r\n"
+							 "Last-Modified: Fri, 05 Jun 2020 13:05:22 GMT\r\n"
+							 "Vary: Accept-Encoding\r\n";
+
+	for (auto _ : state) {
+		if (!client.SendMetadata(Strings::StatusLines::OK, 10892, MediaTypes::HTML, additional)) {
+			state.SkipWithError("The metadata couldn't be sent");
+			break;
+		}
+		fixture.data.output.clear();
+	}
+}
+BENCHMARK(ClientSendMetadata);
+
+void
+DetectMediaType(benchmark::State &state) {
+	MediaTypeFinder finder;
+	const std::array<std::string_view, 8> paths{
+		"/var/www/html/index.html", "/var/www/html/assets/css/style.min.css", "/var/www/html/js/app.js",
+		"/var/www/html/favicon.ico", "/var/www/html/images/logo.svg", "/var/www/html/fonts/body.woff2",
+		"/var/www/html/robots.txt", "/var/www/html/archive.tar.gz",
+	};
+
+	for (auto _ : state) {
+		for (const auto path : paths) {
+			benchmark::DoNotOptimize(finder.DetectMediaType(path));
+		}
+	}
+
+	state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * paths.size()));
+}
+BENCHMARK(DetectMediaType);
+
+// The lookup of files in the file system, i.e. the cost of a miss of the file
+// cache. state.range(0) selects an existing file (1) or a missing one (0).
+void
+FileResolverResolve(benchmark::State &state) {
+	std::string root("/tmp/webserver-bench-XXXXXX");
+	if (mkdtemp(root.data()) == nullptr || mkdir((root + "/assets").c_str(), 0700) != 0) {
+		state.SkipWithError("The root directory couldn't be created");
+		return;
+	}
+	std::ofstream(root + "/assets/style.css") << "body{}";
+
+	IO::FileResolver resolver(root);
+	HTTP::Request request;
+	request.path = state.range(0) ? "/assets/style.css" : "/assets/missing.css";
+	const auto expected = state.range(0) ? IO::FileResolveStatus::OK : IO::FileResolveStatus::NOT_FOUND;
+
+	for (auto _ : state) {
+		auto result = resolver.Resolve(request);
+		if (result.first != expected) {
+			state.SkipWithError("The file wasn't resolved as expected");
+			break;
+		}
+		benchmark::DoNotOptimize(result.second);
+	}
+
+	unlink((root + "/assets/style.css").c_str());
+	rmdir((root + "/assets").c_str());
+	rmdir(root.c_str());
+}
+BENCHMARK(FileResolverResolve)->Arg(1)->Arg(0);
+
+} // namespace
+
+BENCHMARK_MAIN();
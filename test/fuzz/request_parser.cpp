@@ -0,0 +1,400 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+// The differential fuzz target of the request parsers: every input is parsed
+// by the consumers of HTTP::Client (ConsumeMethod, ConsumePath, ...) on the
+// in-memory connection, and by HTTP::RequestParser. The process aborts when
+// they don't agree on the ClientError, the amount of octets consumed, or the
+// contents of the request.
+//
+// The first octet of an input isn't part of the request, but selects the
+// conditions of the parse:
+//     bits 0-2: the size of the chunks fed to the RequestParser
+//     bit 3:    whether the length limits of the policies are lowered
+//     bits 4-6: the limit, when they are lowered
+//
+// With WEBSERVER_FUZZING=ON (Clang), this is a libFuzzer target. Otherwise it
+// is a driver that parses the files given as arguments (or stdin), which can
+// be used with AFL (afl-fuzz -i corpus -o findings -- ./fuzz_request_parser @@)
+// or to replay a corpus. The driver also measures the cycles of both parsers
+// per input:
+//     fuzz_request_parser --cycles corpus/* > cycles.tsv
+//     fuzz_request_parser --baseline=cycles.tsv --tolerance=25 corpus/*
+// fails if the RequestParser needs more than 25% more cycles than in the
+// baseline for any input, with some slack for the short ones.
+
+#define CONNECTION_MEMORY_VARIANT
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#define TESTING_VISIBILITY public
+
+#include "base/media_type.hpp"
+#include "cgi/manager.hpp"
+#include "connection/connection.hpp"
+#include "connection/memory_userdata.hpp"
+#include "http/client.hpp"
+#include "http/client_error.hpp"
+#include "http/configuration.hpp"
+#include "http/request.hpp"
+#include "http/request_parser.hpp"
+#include "http/server.hpp"
+#include "security/policies.hpp"
+#include "security/tls_configuration.hpp"
+
+// The amount of times an input is parsed when measuring, of which the fewest
+// cycles are reported.
+#define MAGIC_FUZZ_MEASURE_REPETITIONS 64
+
+// The cycles an input may regress by regardless of the tolerance, since short
+// inputs are parsed in too few cycles to be measured precisely.
+#define MAGIC_FUZZ_CYCLE_SLACK 1000
+
+namespace {
+
+constexpr std::size_t maxHeadLength = Connection::receiveBufferSize;
+
+constexpr std::array<std::size_t, 8> chunkSizes{ 1, 2, 3, 7, 16, 33, 64, maxHeadLength };
+constexpr std::array<std::size_t, 8> limits{ 1, 2, 3, 5, 17, 33, 64, 255 };
+
+// The time stamp counter where available, nanoseconds otherwise.
+[[nodiscard]] inline std::uint64_t
+ReadCycles() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+// The views of HTTP::Request don't outlive the parse, so the results are
+// copied. Header names are compared case-insensitively.
+struct Outcome {
+	HTTP::ClientError error{ HTTP::ClientError::NO_ERROR };
+	std::size_t consumed{ 0 };
+	std::string method;
+	std::string path;
+	std::uint8_t versionMinor{ 0 };
+	std::vector<std::pair<std::string, std::string>> headers;
+	std::uint64_t cycles{ 0 };
+
+	void
+	Store(const HTTP::Request &request) {
+		method = request.method;
+		path = request.path;
+		versionMinor = request.versionMinor;
+		headers.clear();
+		for (const auto &header : request.headers) {
+			std::string name(header.name);
+			std::transform(std::begin(name), std::end(name), std::begin(name),
+						   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+			headers.emplace_back(std::move(name), std::string(header.value));
+		}
+	}
+
+	[[nodiscard]] bool
+	operator==(const Outcome &other) const noexcept {
+		if (error != other.error || consumed != other.consumed) {
+			return false;
+		}
+
+		// The request is only complete without errors.
+		return error != HTTP::ClientError::NO_ERROR || (method == other.method && path == other.path &&
+			versionMinor == other.versionMinor && headers == other.headers);
+	}
+};
+
+class Harness {
+public:
+	Harness() : server(HTTP::Configuration(finder, policies, tlsConfiguration), manager) {
+	}
+
+	// Applies the conditions selected by [options], see the top of this file.
+	void
+	Configure(std::uint8_t options) noexcept {
+		chunkSize = chunkSizes[options & 0x7];
+
+		const Security::Policies defaults{};
+		const bool lowered = (options & 0x8) != 0;
+		const auto limit = limits[(options >> 4) & 0x7];
+		policies.maxHeaderFieldNameLength = lowered ? limit : defaults.maxHeaderFieldNameLength;
+		policies.maxHeaderFieldValueLength = lowered ? limit : defaults.maxHeaderFieldValueLength;
+		policies.maxMethodLength = lowered ? limit : defaults.maxMethodLength;
+		policies.maxRequestTargetLength = lowered ? limit : defaults.maxRequestTargetLength;
+		policies.maxWhiteSpacesInHeaderField = lowered ? limit : defaults.maxWhiteSpacesInHeaderField;
+	}
+
+	// Parses [input] with the consumers of HTTP::Client.
+	[[nodiscard]] Outcome
+	ParseLegacy(std::string_view input) {
+		HTTP::Client client(&server);
+		MemoryUserData data{};
+		data.input.assign(std::crbegin(input), std::crend(input));
+		client.connection = std::make_unique<Connection>(&data);
+
+		Outcome outcome;
+		const auto start = ReadCycles();
+		for (auto function : { &HTTP::Client::ConsumeMethod, &HTTP::Client::ConsumePath,
+							   &HTTP::Client::ConsumeVersion, &HTTP::Client::ConsumeCRLF,
+							   &HTTP::Client::ConsumeHeaders }) {
+			outcome.error = (client.*function)();
+			if (outcome.error != HTTP::ClientError::NO_ERROR) {
+				break;
+			}
+		}
+		outcome.cycles = ReadCycles() - start;
+
+		const auto remaining = data.input.size() + client.connection->Buffered().length();
+		outcome.consumed = input.length() - remaining;
+		outcome.Store(client.currentRequest);
+		return outcome;
+	}
+
+	// Parses [input] with the RequestParser, fed in chunks.
+	[[nodiscard]] Outcome
+	Parse(std::string_view input) {
+		HTTP::Request request{};
+		HTTP::RequestParser parser(policies, request, maxHeadLength);
+
+		Outcome outcome;
+		const auto start = ReadCycles();
+		std::size_t fed = 0;
+		auto status = HTTP::RequestParser::Status::INCOMPLETE;
+		while (fed < input.length() && status == HTTP::RequestParser::Status::INCOMPLETE) {
+			fed = std::min(input.length(), fed + chunkSize);
+			status = parser.Feed({ input.data(), fed });
+		}
+		outcome.error = status == HTTP::RequestParser::Status::INCOMPLETE ? parser.EndOfStream() : parser.Error();
+		outcome.cycles = ReadCycles() - start;
+
+		outcome.consumed = parser.HeadLength();
+		outcome.Store(request);
+		return outcome;
+	}
+
+private:
+	CGI::Manager manager;
+	MediaTypeFinder finder;
+	Security::Policies policies;
+	Security::TLSConfiguration tlsConfiguration;
+	HTTP::Server server;
+	std::size_t chunkSize{ maxHeadLength };
+};
+
+[[nodiscard]] Harness &
+GetHarness() {
+	static Harness harness;
+	return harness;
+}
+
+void
+Report(const Outcome &outcome, const char *name) {
+	std::cerr << name << ": " << ClientErrorToString(outcome.error) << ", consumed " << outcome.consumed
+			  << ", method \"" << outcome.method << "\", path \"" << outcome.path << "\", HTTP/1."
+			  << static_cast<int>(outcome.versionMinor) << '\n';
+	for (const auto &header : outcome.headers) {
+		std::cerr << "    \"" << header.first << "\": \"" << header.second << "\"\n";
+	}
+}
+
+[[nodiscard]] std::string
+Escape(std::string_view input) {
+	std::ostringstream stream;
+	for (char character : input) {
+		const auto octet = static_cast<unsigned char>(character);
+		if (octet >= 0x20 && octet < 0x7F && character != '\\') {
+			stream << character;
+		} else {
+			std::array<char, 5> buffer;
+			std::snprintf(buffer.data(), buffer.size(), "\\x%02x", octet);
+			stream << buffer.data();
+		}
+	}
+	return stream.str();
+}
+
+// Returns the request part of [data], or false if there is none. The legacy
+// consumers don't limit the length of the head, so the request is cut off
+// before the parser would.
+[[nodiscard]] bool
+Prepare(const std::uint8_t *data, std::size_t size, std::string_view &input) {
+	if (size == 0) {
+		return false;
+	}
+
+	GetHarness().Configure(data[0]);
+	input = std::string_view(reinterpret_cast<const char *>(data + 1), std::min(size - 1, maxHeadLength - 1));
+	return true;
+}
+
+// Aborts if the parsers disagree. Stores the cycles of the parsers.
+void
+Compare(std::string_view input, std::uint8_t options, std::uint64_t &legacyCycles, std::uint64_t &parserCycles) {
+	auto &harness = GetHarness();
+	const auto expected = harness.ParseLegacy(input);
+	const auto outcome = harness.Parse(input);
+
+	if (!(expected == outcome)) {
+		std::cerr << "The parsers disagree with options 0x" << std::hex << static_cast<int>(options) << std::dec
+				  << " on \"" << Escape(input) << "\"\n";
+		Report(expected, "Client");
+		Report(outcome, "RequestParser");
+		std::abort();
+	}
+
+	legacyCycles = expected.cycles;
+	parserCycles = outcome.cycles;
+}
+
+} // namespace
+
+extern "C" int
+LLVMFuzzerTestOneInput(const std::uint8_t *data, std::size_t size) {
+	std::string_view input;
+	if (Prepare(data, size, input)) {
+		std::uint64_t legacyCycles;
+		std::uint64_t parserCycles;
+		Compare(input, data[0], legacyCycles, parserCycles);
+	}
+	return 0;
+}
+
+#ifndef WEBSERVER_LIBFUZZER
+
+namespace {
+
+[[nodiscard]] bool
+ReadFile(const std::string &path, std::string &contents) {
+	std::ifstream stream(path, std::ios::binary);
+	if (!stream) {
+		return false;
+	}
+	contents.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+	return true;
+}
+
+// Reads the output of --cycles: the path, and the cycles of the Client and
+// the RequestParser, separated by tabs.
+[[nodiscard]] bool
+ReadBaseline(const std::string &path, std::map<std::string, std::uint64_t> &baseline) {
+	std::ifstream stream(path);
+	if (!stream) {
+		return false;
+	}
+
+	std::string line;
+	while (std::getline(stream, line)) {
+		const auto first = line.find('\t');
+		const auto second = line.find('\t', first + 1);
+		if (first == std::string::npos || second == std::string::npos) {
+			continue;
+		}
+		baseline[line.substr(0, first)] = std::strtoull(line.c_str() + second + 1, nullptr, 10);
+	}
+	return true;
+}
+
+} // namespace
+
+int
+main(int argc, char *argv[]) {
+	bool printCycles = false;
+	std::string baselinePath;
+	std::uint64_t tolerance = 25;
+	std::vector<std::string> paths;
+
+	for (int i = 1; i < argc; i++) {
+		const std::string_view argument(argv[i]);
+		if (argument == "--cycles") {
+			printCycles = true;
+		} else if (argument.substr(0, 11) == "--baseline=") {
+			baselinePath = argument.substr(11);
+		} else if (argument.substr(0, 12) == "--tolerance=") {
+			tolerance = std::strtoull(argv[i] + 12, nullptr, 10);
+		} else {
+			paths.emplace_back(argument);
+		}
+	}
+
+	std::map<std::string, std::uint64_t> baseline;
+	if (!baselinePath.empty() && !ReadBaseline(baselinePath, baseline)) {
+		std::cerr << "Failed to read the baseline " << baselinePath << '\n';
+		return EXIT_FAILURE;
+	}
+
+	if (paths.empty()) {
+		paths.emplace_back("-");
+	}
+
+	const bool measure = printCycles || !baseline.empty();
+	std::size_t regressions = 0;
+	for (const auto &path : paths) {
+		std::string contents;
+		if (path == "-") {
+			contents.assign(std::istreambuf_iterator<char>(std::cin), std::istreambuf_iterator<char>());
+		} else if (!ReadFile(path, contents)) {
+			std::cerr << "Failed to read " << path << '\n';
+			return EXIT_FAILURE;
+		}
+
+		const auto *data = reinterpret_cast<const std::uint8_t *>(contents.data());
+		std::string_view input;
+		if (!Prepare(data, contents.size(), input)) {
+			continue;
+		}
+
+		std::uint64_t legacyCycles = UINT64_MAX;
+		std::uint64_t parserCycles = UINT64_MAX;
+		for (std::size_t i = 0; i < (measure ? MAGIC_FUZZ_MEASURE_REPETITIONS : 1); i++) {
+			std::uint64_t legacy;
+			std::uint64_t parser;
+			Compare(input, data[0], legacy, parser);
+			legacyCycles = std::min(legacyCycles, legacy);
+			parserCycles = std::min(parserCycles, parser);
+		}
+
+		if (printCycles) {
+			std::cout << path << '\t' << legacyCycles << '\t' << parserCycles << '\n';
+		}
+
+		const auto entry = baseline.find(path);
+		if (entry != std::cend(baseline) && parserCycles * 100 > entry->second * (100 + tolerance) + MAGIC_FUZZ_CYCLE_SLACK * 100) {
+			std::cerr << path << ": " << parserCycles << " cycles, " << entry->second << " in the baseline\n";
+			regressions++;
+		}
+	}
+
+	if (regressions != 0) {
+		std::cerr << regressions << " inputs regressed by more than " << tolerance << "%\n";
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
+
+#endif // WEBSERVER_LIBFUZZER
@@ -0,0 +1,166 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <gtest/gtest.h>
+
+#include "security/address_limiter.hpp"
+#include "security/policies.hpp"
+
+// An address as returned by accept(2).
+static struct sockaddr_storage
+Address(const std::string &text) {
+	struct sockaddr_storage address{};
+	if (text.find(':') == std::string::npos) {
+		auto *address4 = reinterpret_cast<struct sockaddr_in *>(&address);
+		address4->sin_family = AF_INET;
+		EXPECT_EQ(inet_pton(AF_INET, text.c_str(), &address4->sin_addr), 1);
+	} else {
+		auto *address6 = reinterpret_cast<struct sockaddr_in6 *>(&address);
+		address6->sin6_family = AF_INET6;
+		EXPECT_EQ(inet_pton(AF_INET6, text.c_str(), &address6->sin6_addr), 1);
+	}
+	return address;
+}
+
+static Security::AddressAdmission
+Admit(Security::AddressLimiter &limiter, const std::string &text, Security::AddressLease &lease) {
+	const auto address = Address(text);
+	return limiter.Admit(reinterpret_cast<const struct sockaddr *>(&address), lease);
+}
+
+static std::uint32_t
+Connections(const Security::AddressLimiter &limiter, const std::string &text) {
+	const auto address = Address(text);
+	return limiter.Connections(reinterpret_cast<const struct sockaddr *>(&address));
+}
+
+TEST(AddressLimiter, LimitsConnectionsPerAddress) {
+	Security::Policies policies;
+	policies.maxConnectionsPerAddress = 2;
+	Security::AddressLimiter limiter(policies);
+
+	Security::AddressLease first;
+	Security::AddressLease second;
+	Security::AddressLease third;
+	ASSERT_EQ(Admit(limiter, "192.0.2.1", first), Security::AddressAdmission::ADMITTED);
+	ASSERT_EQ(Admit(limiter, "192.0.2.1", second), Security::AddressAdmission::ADMITTED);
+	ASSERT_EQ(Admit(limiter, "192.0.2.1", third), Security::AddressAdmission::TOO_MANY_CONNECTIONS);
+	ASSERT_EQ(Connections(limiter, "192.0.2.1"), 2);
+
+	// Other addresses aren't affected.
+	ASSERT_EQ(Admit(limiter, "192.0.2.2", third), Security::AddressAdmission::ADMITTED);
+	ASSERT_EQ(Connections(limiter, "192.0.2.2"), 1);
+
+	// Releasing a connection makes room for another.
+	first.Reset();
+	ASSERT_EQ(Connections(limiter, "192.0.2.1"), 1);
+	ASSERT_EQ(Admit(limiter, "192.0.2.1", first), Security::AddressAdmission::ADMITTED);
+
+	// Moving a lease doesn't count the connection twice.
+	Security::AddressLease moved(std::move(second));
+	second.Reset();
+	ASSERT_EQ(Connections(limiter, "192.0.2.1"), 2);
+	moved = std::move(first);
+	ASSERT_EQ(Connections(limiter, "192.0.2.1"), 1);
+	moved.Reset();
+	ASSERT_EQ(Connections(limiter, "192.0.2.1"), 0);
+}
+
+TEST(AddressLimiter, GroupsIPv6ByPrefix) {
+	Security::Policies policies;
+	policies.maxConnectionsPerAddress = 1;
+	Security::AddressLimiter limiter(policies);
+
+	Security::AddressLease first;
+	Security::AddressLease second;
+	ASSERT_EQ(Admit(limiter, "2001:db8:1:2::1", first), Security::AddressAdmission::ADMITTED);
+	ASSERT_EQ(Admit(limiter, "2001:db8:1:2:ffff::2", second), Security::AddressAdmission::TOO_MANY_CONNECTIONS);
+	ASSERT_EQ(Admit(limiter, "2001:db8:1:3::1", second), Security::AddressAdmission::ADMITTED);
+
+	// IPv4-mapped addresses are the IPv4 addresses.
+	Security::AddressLease third;
+	Security::AddressLease fourth;
+	ASSERT_EQ(Admit(limiter, "198.51.100.7", third), Security::AddressAdmission::ADMITTED);
+	ASSERT_EQ(Admit(limiter, "::ffff:198.51.100.7", fourth), Security::AddressAdmission::TOO_MANY_CONNECTIONS);
+
+	// The loopback address has a prefix of zeroes.
+	ASSERT_EQ(Admit(limiter, "::1", fourth), Security::AddressAdmission::ADMITTED);
+	ASSERT_EQ(Connections(limiter, "::1"), 1);
+}
+
+TEST(AddressLimiter, LimitsConnectionRate) {
+	Security::Policies policies;
+	policies.maxConnectionsPerAddress = 0;
+	policies.connectionRatePerAddress = 100;
+	policies.connectionBurstPerAddress = 3;
+	Security::AddressLimiter limiter(policies);
+
+	Security::AddressLease lease;
+	for (int i = 0; i < 3; i++) {
+		ASSERT_EQ(Admit(limiter, "203.0.113.9", lease), Security::AddressAdmission::ADMITTED);
+	}
+	ASSERT_EQ(Admit(limiter, "203.0.113.9", lease), Security::AddressAdmission::RATE_LIMITED);
+	ASSERT_EQ(Admit(limiter, "203.0.113.10", lease), Security::AddressAdmission::ADMITTED);
+
+	// A token is added every 10 milliseconds.
+	std::this_thread::sleep_for(std::chrono::milliseconds(30));
+	ASSERT_EQ(Admit(limiter, "203.0.113.9", lease), Security::AddressAdmission::ADMITTED);
+}
+
+TEST(AddressLimiter, FailsOpenWhenFull) {
+	Security::Policies policies;
+	policies.maxConnectionsPerAddress = 1;
+	policies.addressTableCapacity = 0;
+	Security::AddressLimiter limiter(policies);
+
+	// Every address has a connection, so no slot can be reclaimed.
+	std::vector<Security::AddressLease> leases(limiter.Capacity() * 2);
+	std::size_t untracked = 0;
+	for (std::size_t i = 0; i < leases.size(); i++) {
+		const auto address = "10.0." + std::to_string(i / 256) + "." + std::to_string(i % 256);
+		ASSERT_EQ(Admit(limiter, address, leases[i]), Security::AddressAdmission::ADMITTED);
+		untracked += Connections(limiter, address) == 0;
+	}
+	ASSERT_GE(untracked, limiter.Capacity());
+
+	// Idle slots are reclaimed.
+	leases.clear();
+	Security::AddressLease first;
+	Security::AddressLease second;
+	ASSERT_EQ(Admit(limiter, "172.16.0.1", first), Security::AddressAdmission::ADMITTED);
+	ASSERT_EQ(Admit(limiter, "172.16.0.1", second), Security::AddressAdmission::TOO_MANY_CONNECTIONS);
+}
+
+TEST(AddressLimiter, CountsConcurrently) {
+	Security::Policies policies;
+	policies.maxConnectionsPerAddress = 1000;
+	Security::AddressLimiter limiter(policies);
+
+	std::vector<std::thread> threads;
+	for (int thread = 0; thread < 4; thread++) {
+		threads.emplace_back([&limiter] {
+			for (int i = 0; i < 10000; i++) {
+				Security::AddressLease lease;
+				EXPECT_EQ(Admit(limiter, "192.0.2.1", lease), Security::AddressAdmission::ADMITTED);
+			}
+		});
+	}
+	for (auto &thread : threads) {
+		thread.join();
+	}
+
+	ASSERT_EQ(Connections(limiter, "192.0.2.1"), 0);
+}
@@ -0,0 +1,147 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include <chrono>
+#include <string>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include "base/media_type.hpp"
+#include "http/admission_control.hpp"
+#include "http/configuration.hpp"
+#include "http/metrics.hpp"
+#include "security/policies.hpp"
+#include "security/tls_configuration.hpp"
+
+namespace HTTP {
+
+class AdmissionControlTest : public ::testing::Test {
+protected:
+	MediaTypeFinder finder;
+	Security::Policies policies;
+	Security::TLSConfiguration tlsConfiguration;
+	Configuration configuration{ finder, policies, tlsConfiguration };
+	Metrics metrics;
+
+	void
+	SetUp() override {
+		configuration.metrics = &metrics;
+	}
+
+	[[nodiscard]] std::string
+	Render() const {
+		std::string output;
+		metrics.Render(output, configuration);
+		return output;
+	}
+};
+
+TEST_F(AdmissionControlTest, ShedsAboveTheShareOfConnections) {
+	configuration.maxConnections = 10;
+	configuration.fileDescriptorHeadroom = 0;
+	configuration.maxEventLoopLag = 0;
+
+	// Three workers get four connections each.
+	AdmissionController admission(configuration, 3);
+	ASSERT_TRUE(admission.Initialize());
+
+	ShedReason reason;
+	EXPECT_FALSE(admission.ShouldShed(3, 3, {}, reason));
+	ASSERT_TRUE(admission.ShouldShed(3, 4, {}, reason));
+	EXPECT_EQ(reason, ShedReason::CONNECTIONS);
+
+	configuration.maxConnections = 0;
+	AdmissionController unlimited(configuration, 3);
+	EXPECT_FALSE(unlimited.ShouldShed(3, 1000000, {}, reason));
+}
+
+TEST_F(AdmissionControlTest, ShedsWithoutDescriptorHeadroom) {
+	struct rlimit limit{};
+	ASSERT_EQ(getrlimit(RLIMIT_NOFILE, &limit), 0);
+	if (limit.rlim_cur == RLIM_INFINITY) {
+		GTEST_SKIP() << "There is no limit of file descriptors";
+	}
+
+	configuration.fileDescriptorHeadroom = 16;
+	AdmissionController admission(configuration, 1);
+	ASSERT_TRUE(admission.Initialize());
+
+	const auto descriptorLimit = static_cast<int>(limit.rlim_cur);
+	ShedReason reason;
+	EXPECT_FALSE(admission.ShouldShed(descriptorLimit - 17, 0, {}, reason));
+	ASSERT_TRUE(admission.ShouldShed(descriptorLimit - 16, 0, {}, reason));
+	EXPECT_EQ(reason, ShedReason::DESCRIPTORS);
+}
+
+TEST_F(AdmissionControlTest, ShedsWhenTheLoopLags) {
+	configuration.maxEventLoopLag = 100;
+	AdmissionController admission(configuration, 1);
+	ASSERT_TRUE(admission.Initialize());
+
+	ShedReason reason;
+	EXPECT_FALSE(admission.ShouldShed(3, 0, std::chrono::milliseconds(100), reason));
+	ASSERT_TRUE(admission.ShouldShed(3, 0, std::chrono::milliseconds(101), reason));
+	EXPECT_EQ(reason, ShedReason::LAG);
+}
+
+TEST_F(AdmissionControlTest, SendsServiceUnavailable) {
+	AdmissionController admission(configuration, 1);
+	ASSERT_TRUE(admission.Initialize());
+
+	int sockets[2];
+	ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, sockets), 0);
+	admission.Shed(sockets[0], ShedReason::LAG);
+
+	std::string received;
+	char buffer[4096];
+	ssize_t length;
+	while ((length = read(sockets[1], buffer, sizeof(buffer))) > 0) {
+		received.append(buffer, static_cast<std::size_t>(length));
+	}
+	close(sockets[1]);
+
+	EXPECT_EQ(received, admission.Response());
+	EXPECT_EQ(received.rfind("HTTP/1.1 503 Service Unavailable\r\n", 0), 0);
+	EXPECT_NE(received.find("\r\nConnection: close\r\n"), std::string::npos);
+	EXPECT_NE(received.find("\r\nRetry-After: 1\r\n"), std::string::npos);
+	EXPECT_NE(Render().find("webserver_connections_shed_total{reason=\"lag\"} 1\n"), std::string::npos);
+}
+
+TEST_F(AdmissionControlTest, ShedsWithTheReservedDescriptor) {
+	const int listeningSocket = socket(AF_INET, SOCK_STREAM, 0);
+	ASSERT_NE(listeningSocket, -1);
+
+	struct sockaddr_in address{};
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	socklen_t addressLength = sizeof(address);
+	ASSERT_EQ(bind(listeningSocket, reinterpret_cast<struct sockaddr *>(&address), addressLength), 0);
+	ASSERT_EQ(listen(listeningSocket, 4), 0);
+	ASSERT_EQ(getsockname(listeningSocket, reinterpret_cast<struct sockaddr *>(&address), &addressLength), 0);
+
+	const int client = socket(AF_INET, SOCK_STREAM, 0);
+	ASSERT_NE(client, -1);
+	ASSERT_EQ(connect(client, reinterpret_cast<struct sockaddr *>(&address), addressLength), 0);
+
+	AdmissionController admission(configuration, 1);
+	ASSERT_TRUE(admission.Initialize());
+	EXPECT_TRUE(admission.ShedWithReserve(listeningSocket));
+
+	char buffer[64];
+	EXPECT_GT(read(client, buffer, sizeof(buffer)), 0);
+	EXPECT_NE(Render().find("webserver_connections_shed_total{reason=\"descriptors\"} 1\n"), std::string::npos);
+
+	close(client);
+	close(listeningSocket);
+}
+
+} // namespace HTTP
@@ -0,0 +1,58 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include <string_view>
+
+#include <cstdint>
+
+#include <gtest/gtest.h>
+
+#include "base/arena.hpp"
+
+TEST(Arena, AllocatesAligned) {
+	base::Arena arena(128);
+	static_cast<void>(arena.Allocate(3, 1));
+
+	auto *aligned = arena.Allocate(8, 8);
+	ASSERT_EQ(reinterpret_cast<std::uintptr_t>(aligned) % 8, 0);
+	ASSERT_EQ(arena.ChunkCount(), 1);
+}
+
+TEST(Arena, CopiesStrings) {
+	base::Arena arena;
+	const std::string_view original("Accept-Encoding");
+	const auto copy = arena.Copy(original);
+	ASSERT_EQ(copy, original);
+	ASSERT_NE(copy.data(), original.data());
+}
+
+TEST(Arena, SettlesOnSingleChunk) {
+	base::Arena arena(64);
+	for (int i = 0; i < 4; i++) {
+		static_cast<void>(arena.Allocate(48, 1));
+	}
+	ASSERT_EQ(arena.ChunkCount(), 4);
+
+	// The next time, the same allocations fit in a single chunk.
+	arena.Reset();
+	auto *first = arena.Allocate(48, 1);
+	for (int i = 0; i < 3; i++) {
+		static_cast<void>(arena.Allocate(48, 1));
+	}
+	ASSERT_EQ(arena.ChunkCount(), 1);
+
+	// Which is reused after resetting again.
+	arena.Reset();
+	ASSERT_EQ(arena.Allocate(48, 1), first);
+	ASSERT_EQ(arena.ChunkCount(), 1);
+}
+
+TEST(Arena, AllocatesLargerThanChunk) {
+	base::Arena arena(64);
+	auto *large = static_cast<char *>(arena.Allocate(1000, 1));
+	large[999] = 'x';
+	ASSERT_EQ(arena.ChunkCount(), 1);
+}
@@ -0,0 +1,145 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include <array>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include "base/async_log.hpp"
+#include "http/access_log.hpp"
+#include "http/request.hpp"
+
+namespace {
+
+// Reads everything that has been written to [fd] after its write end is
+// closed.
+[[nodiscard]] std::string
+ReadAll(int fd) {
+	std::string result;
+	std::array<char, 4096> buffer;
+	ssize_t length;
+	while ((length = read(fd, buffer.data(), buffer.size())) > 0) {
+		result.append(buffer.data(), static_cast<std::size_t>(length));
+	}
+	return result;
+}
+
+} // namespace
+
+TEST(AsyncLog, WritesTheRecordsOfEveryThread) {
+	std::array<int, 2> pipe;
+	ASSERT_EQ(pipe2(pipe.data(), O_CLOEXEC), 0);
+
+	constexpr std::size_t threadCount = 4;
+	constexpr std::size_t recordCount = 1000;
+	std::vector<std::size_t> counts(threadCount);
+	std::string output;
+	{
+		base::AsyncLog log(1024, std::chrono::milliseconds(1));
+		ASSERT_TRUE(log.Start(pipe[1]));
+
+		// The pipe is drained concurrently, since its buffer is smaller than
+		// the records.
+		std::thread reader([&] { output = ReadAll(pipe[0]); });
+
+		std::vector<std::thread> threads;
+		for (std::size_t thread = 0; thread < threadCount; thread++) {
+			threads.emplace_back([&log, &counts, thread] {
+				const std::string record = "thread " + std::to_string(thread) + "\n";
+				for (std::size_t i = 0; i < recordCount; i++) {
+					while (!log.Append(record)) {
+						std::this_thread::yield();
+					}
+				}
+			});
+		}
+		for (auto &thread : threads) {
+			thread.join();
+		}
+
+		log.Stop();
+		close(pipe[1]);
+		reader.join();
+	}
+	close(pipe[0]);
+
+	std::size_t begin = 0;
+	std::size_t end;
+	while ((end = output.find('\n', begin)) != std::string::npos) {
+		const auto line = output.substr(begin, end - begin);
+		ASSERT_EQ(line.substr(0, 7), "thread ") << line;
+		counts.at(std::stoul(line.substr(7)))++;
+		begin = end + 1;
+	}
+	ASSERT_EQ(begin, output.length());
+
+	for (auto count : counts) {
+		EXPECT_EQ(count, recordCount);
+	}
+}
+
+TEST(AsyncLog, DropsRecordsWhenTheRingIsFull) {
+	std::array<int, 2> pipe;
+	ASSERT_EQ(pipe2(pipe.data(), O_CLOEXEC), 0);
+
+	std::string output;
+	{
+		// The writer isn't started, so nothing is drained.
+		base::AsyncLog log(64);
+		const std::string record(40, 'a');
+		EXPECT_TRUE(log.Append(record));
+		EXPECT_FALSE(log.Append(record));
+		EXPECT_EQ(log.Dropped(), 1);
+
+		ASSERT_TRUE(log.Start(pipe[1]));
+		log.Stop();
+		close(pipe[1]);
+		output = ReadAll(pipe[0]);
+	}
+	close(pipe[0]);
+
+	EXPECT_EQ(output, std::string(40, 'a'));
+}
+
+TEST(AccessLog, FormatsRecords) {
+	HTTP::Request request;
+	request.SetMethod("GET");
+	request.path = "/a \"b\"";
+	request.query = "q=1";
+	ASSERT_TRUE(request.headers.Add({ "Host", "example.com" }));
+
+	std::array<char, HTTP::maxAccessRecordLength> record;
+	auto length = HTTP::FormatAccessRecord(record.data(), request, "HTTP/1.1", "192.0.2.1", "HTTP/1.1 200 OK", 1024);
+	std::string_view line(record.data(), length);
+
+	// The time is e.g. "2020-06-01T12:00:00Z".
+	ASSERT_GT(line.length(), 21);
+	EXPECT_EQ(line[10], 'T');
+	EXPECT_EQ(line[19], 'Z');
+	EXPECT_EQ(line.substr(20), " 192.0.2.1 example.com \"GET /a \\x22b\\x22?q=1 HTTP/1.1\" 200 1024\n");
+
+	request.Reset();
+	length = HTTP::FormatAccessRecord(record.data(), request, "HTTP/1.1", "", "HTTP/1.1 400 Bad Request", SIZE_MAX);
+	EXPECT_EQ(std::string_view(record.data(), length).substr(20), " - - \"-\" 400 -\n");
+}
+
+TEST(AccessLog, TruncatesLongRecords) {
+	HTTP::Request request;
+	request.SetMethod("GET");
+	const std::string path(2 * HTTP::maxAccessRecordLength, '/');
+	request.path = path;
+
+	std::array<char, HTTP::maxAccessRecordLength> record;
+	const auto length = HTTP::FormatAccessRecord(record.data(), request, "HTTP/1.1", "192.0.2.1", "HTTP/1.1 200 OK", 0);
+	ASSERT_EQ(length, HTTP::maxAccessRecordLength);
+	EXPECT_EQ(record.back(), '\n');
+}
@@ -0,0 +1,170 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "http/body_reader.hpp"
+
+namespace HTTP {
+
+class BodyReaderTest : public ::testing::Test {
+protected:
+	Request request;
+	BodyReader reader;
+
+	void
+	SetUp() override {
+		request.SetMethod("POST");
+		request.path = "/";
+	}
+
+	[[nodiscard]] ClientError
+	Start(std::vector<std::pair<std::string_view, std::string_view>> headers, std::size_t maxLength = 0) {
+		for (const auto &[name, value] : headers) {
+			EXPECT_TRUE(request.headers.Add({ name, value }));
+		}
+		return reader.Start(request, maxLength);
+	}
+
+	// Feeds [input] in parts of [partLength] octets, and collects the body,
+	// or "INCOMPLETE" or "FAILED".
+	[[nodiscard]] std::string
+	Decode(std::string_view input, std::size_t partLength) {
+		std::string body;
+		while (true) {
+			const auto part = input.substr(0, partLength);
+			std::size_t consumed;
+			base::String data("", 0);
+			const auto status = reader.Read(base::String(part.data(), part.length()), consumed, data);
+			input.remove_prefix(consumed);
+
+			switch (status) {
+				case BodyReader::Status::DATA:
+					body.append(data.data(), data.length());
+					break;
+				case BodyReader::Status::INCOMPLETE:
+					EXPECT_EQ(consumed, part.length());
+					if (input.empty()) {
+						return "INCOMPLETE";
+					}
+					break;
+				case BodyReader::Status::COMPLETE:
+					return body;
+				case BodyReader::Status::FAILED:
+					return "FAILED";
+			}
+		}
+	}
+};
+
+TEST_F(BodyReaderTest, HasNoBodyWithoutFraming) {
+	ASSERT_EQ(Start({}), ClientError::NO_ERROR);
+	EXPECT_EQ(reader.Framing(), BodyFraming::NONE);
+	EXPECT_EQ(reader.GetStatus(), BodyReader::Status::COMPLETE);
+}
+
+TEST_F(BodyReaderTest, ReadsContentLength) {
+	ASSERT_EQ(Start({ { "Content-Length", "11" } }), ClientError::NO_ERROR);
+	EXPECT_EQ(reader.Framing(), BodyFraming::CONTENT_LENGTH);
+	EXPECT_EQ(reader.ContentLength(), 11);
+
+	// The next request isn't consumed.
+	std::size_t consumed;
+	base::String data("", 0);
+	ASSERT_EQ(reader.Read(base::String("hello world", 11), consumed, data), BodyReader::Status::DATA);
+	EXPECT_EQ(std::string_view(data.data(), data.length()), "hello world");
+	EXPECT_EQ(consumed, 11);
+	EXPECT_EQ(reader.GetStatus(), BodyReader::Status::COMPLETE);
+	EXPECT_EQ(reader.Read(base::String("GET", 3), consumed, data), BodyReader::Status::COMPLETE);
+	EXPECT_EQ(consumed, 0);
+}
+
+TEST_F(BodyReaderTest, CompletesAnEmptyBody) {
+	ASSERT_EQ(Start({ { "Content-Length", "0" } }), ClientError::NO_ERROR);
+	EXPECT_EQ(reader.GetStatus(), BodyReader::Status::COMPLETE);
+}
+
+TEST_F(BodyReaderTest, AcceptsListsOfTheSameLength) {
+	ASSERT_EQ(Start({ { "Content-Length", "5, 5" }, { "Content-Length", "5" } }), ClientError::NO_ERROR);
+	EXPECT_EQ(reader.ContentLength(), 5);
+}
+
+TEST_F(BodyReaderTest, RefusesInvalidContentLengths) {
+	for (const std::string_view value : { "5, 6", "-1", "0x10", "", "1 2" }) {
+		request.headers.Clear();
+		EXPECT_EQ(Start({ { "Content-Length", value } }), ClientError::INCORRECT_BODY_FRAMING) << value;
+	}
+}
+
+TEST_F(BodyReaderTest, LimitsTheLength) {
+	EXPECT_EQ(Start({ { "Content-Length", "101" } }, 100), ClientError::POLICY_TOO_LARGE_BODY);
+
+	request.headers.Clear();
+	EXPECT_EQ(Start({ { "Content-Length", "99999999999999999999999" } }), ClientError::POLICY_TOO_LARGE_BODY);
+
+	request.headers.Clear();
+	ASSERT_EQ(Start({ { "Transfer-Encoding", "chunked" } }, 100), ClientError::NO_ERROR);
+	EXPECT_EQ(Decode("64\r\n" + std::string(100, 'x') + "\r\n1\r\nx\r\n0\r\n\r\n", 1000), "FAILED");
+	EXPECT_EQ(reader.Error(), ClientError::POLICY_TOO_LARGE_BODY);
+}
+
+TEST_F(BodyReaderTest, DecodesChunksSplitAnywhere) {
+	const std::string_view input("5;name=value\r\nhello\r\n6\r\n world\r\n0\r\nTrailer: x\r\n\r\n");
+	for (std::size_t partLength = 1; partLength <= input.length(); partLength++) {
+		reader.Reset();
+		request.headers.Clear();
+		ASSERT_EQ(Start({ { "Transfer-Encoding", "chunked" } }), ClientError::NO_ERROR);
+		EXPECT_EQ(reader.Framing(), BodyFraming::CHUNKED);
+		EXPECT_EQ(Decode(input, partLength), "hello world") << partLength;
+		EXPECT_EQ(reader.Received(), 11);
+	}
+}
+
+TEST_F(BodyReaderTest, RefusesMalformedChunks) {
+	for (const std::string_view input : { "x\r\n", "5\r\nhello0\r\n\r\n", "5\nhello\r\n", "\r\n",
+										  "1234567890123456\r\n", "0\r\nTrailer: x\n\r\n" }) {
+		request.headers.Clear();
+		ASSERT_EQ(Start({ { "Transfer-Encoding", "chunked" } }), ClientError::NO_ERROR);
+		EXPECT_EQ(Decode(input, input.length()), "FAILED") << input;
+		EXPECT_EQ(reader.Error(), ClientError::INCORRECT_CHUNK);
+	}
+}
+
+TEST_F(BodyReaderTest, FailsAtTheEndOfTheStream) {
+	ASSERT_EQ(Start({ { "Content-Length", "10" } }), ClientError::NO_ERROR);
+	EXPECT_EQ(Decode("hello", 5), "INCOMPLETE");
+	EXPECT_EQ(reader.Received(), 5);
+	EXPECT_EQ(reader.EndOfStream(), ClientError::FAILED_READ_BODY);
+	EXPECT_EQ(reader.GetStatus(), BodyReader::Status::FAILED);
+}
+
+TEST_F(BodyReaderTest, RefusesAmbiguousFraming) {
+	// Spec: RFC 7230 § 3.3.3
+	EXPECT_EQ(Start({ { "Transfer-Encoding", "chunked" }, { "Content-Length", "5" } }),
+			  ClientError::INCORRECT_BODY_FRAMING);
+
+	request.headers.Clear();
+	request.versionMinor = 0;
+	EXPECT_EQ(Start({ { "Transfer-Encoding", "chunked" } }), ClientError::INCORRECT_BODY_FRAMING);
+
+	request.versionMinor = 1;
+	for (const std::string_view value : { "chunked, chunked", "chunked, gzip", "gzip" }) {
+		request.headers.Clear();
+		EXPECT_EQ(Start({ { "Transfer-Encoding", value } }), ClientError::INCORRECT_BODY_FRAMING) << value;
+	}
+}
+
+TEST_F(BodyReaderTest, RefusesOtherTransferCodings) {
+	EXPECT_EQ(Start({ { "Transfer-Encoding", "gzip" }, { "Transfer-Encoding", "Chunked" } }),
+			  ClientError::UNSUPPORTED_TRANSFER_CODING);
+}
+
+} // namespace HTTP
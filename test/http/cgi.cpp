@@ -0,0 +1,352 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include <array>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include "cgi/exchange.hpp"
+#include "cgi/fastcgi.hpp"
+#include "cgi/manager.hpp"
+#include "cgi/response.hpp"
+#include "http/body_reader.hpp"
+
+using namespace std::string_literals;
+using namespace std::string_view_literals;
+
+namespace {
+
+// Reads the whole output of [exchange], or "FAILED".
+[[nodiscard]] std::string
+ReadAll(CGI::Exchange &exchange) {
+	std::string output;
+	while (true) {
+		switch (exchange.Read(output)) {
+			case CGI::Exchange::Status::DATA:
+				break;
+			case CGI::Exchange::Status::WOULD_BLOCK:
+				if (!exchange.Wait()) {
+					return "FAILED";
+				}
+				break;
+			case CGI::Exchange::Status::END:
+				return output;
+			case CGI::Exchange::Status::FAILED:
+				return "FAILED";
+		}
+	}
+}
+
+class ScriptFile {
+public:
+	explicit ScriptFile(std::string_view contents) {
+		std::array<char, 32> name{ "/tmp/cgi-test-XXXXXX" };
+		const int fd = mkstemp(name.data());
+		path = name.data();
+		EXPECT_EQ(write(fd, contents.data(), contents.length()), static_cast<ssize_t>(contents.length()));
+		fchmod(fd, 0700);
+		close(fd);
+	}
+
+	~ScriptFile() {
+		std::remove(path.c_str());
+	}
+
+	std::string path;
+};
+
+} // namespace
+
+TEST(CGIResponseParser, ParsesTheHeaderSection) {
+	CGI::ResponseParser parser;
+	ASSERT_EQ(parser.Feed("Content-Type: text/plain\r\nStat"), CGI::ResponseParser::Status::INCOMPLETE);
+	ASSERT_EQ(parser.Feed("us: 404 Not Found\r\nContent-Length: 5\r\nConnection: close\r\n\r\nhello"),
+			  CGI::ResponseParser::Status::COMPLETE);
+
+	EXPECT_EQ(parser.StatusLine(), "HTTP/1.1 404 Not Found"sv);
+	EXPECT_EQ(parser.Fields(), "Content-Type: text/plain\r\n"sv);
+	EXPECT_EQ(parser.ContentLength(), 5);
+	EXPECT_EQ(parser.Body(), "hello"sv);
+}
+
+TEST(CGIResponseParser, AcceptsStatusesWithoutReasons) {
+	CGI::ResponseParser parser;
+	ASSERT_EQ(parser.Feed("Status: 404\r\n\r\n"), CGI::ResponseParser::Status::COMPLETE);
+	EXPECT_EQ(parser.StatusLine(), "HTTP/1.1 404 "sv);
+}
+
+TEST(CGIResponseParser, AcceptsLineFeeds) {
+	CGI::ResponseParser parser;
+	ASSERT_EQ(parser.Feed("Content-Type: text/html\n\n<p>"), CGI::ResponseParser::Status::COMPLETE);
+
+	EXPECT_EQ(parser.StatusLine(), "HTTP/1.1 200 OK"sv);
+	EXPECT_EQ(parser.Fields(), "Content-Type: text/html\r\n"sv);
+	EXPECT_EQ(parser.ContentLength(), CGI::ResponseParser::unknownContentLength);
+	EXPECT_EQ(parser.Body(), "<p>"sv);
+}
+
+TEST(CGIResponseParser, RedirectsWithLocation) {
+	CGI::ResponseParser parser;
+	ASSERT_EQ(parser.Feed("Location: /elsewhere\n\n"), CGI::ResponseParser::Status::COMPLETE);
+	EXPECT_EQ(parser.StatusLine(), "HTTP/1.1 302 Found"sv);
+}
+
+TEST(CGIResponseParser, RejectsMalformedSections) {
+	for (const auto input : { "no colon\n\n"sv, ": value\n\n"sv, "Status: abc\n\n"sv,
+							  "Content-Length: 1x\n\n"sv, "Bad Name: value\n\n"sv }) {
+		CGI::ResponseParser parser;
+		EXPECT_EQ(parser.Feed(input), CGI::ResponseParser::Status::FAILED) << input;
+	}
+
+	CGI::ResponseParser parser;
+	const std::string large(CGI::ResponseParser::maxHeadSize + 1, 'a');
+	EXPECT_EQ(parser.Feed(large), CGI::ResponseParser::Status::FAILED);
+}
+
+TEST(FastCGI, EncodesNameValuePairs) {
+	std::string output;
+	CGI::FastCGI::AppendNameValuePair(output, "NAME", "value");
+	EXPECT_EQ(output, "\x04\x05NAMEvalue"sv);
+
+	output.clear();
+	const std::string value(200, 'v');
+	CGI::FastCGI::AppendNameValuePair(output, "N", value);
+	EXPECT_EQ(output, "\x01\x80\x00\x00\xC8N"s + value);
+}
+
+TEST(FastCGI, EncodesRequests) {
+	std::string output;
+	CGI::FastCGI::AppendRequest(output, 1, { "A=b" }, true);
+
+	// BEGIN_REQUEST, PARAMS padded to eight octets, the empty PARAMS and
+	// the empty STDIN.
+	EXPECT_EQ(output,
+			  "\x01\x01\x00\x01\x00\x08\x00\x00" "\x00\x01\x01\x00\x00\x00\x00\x00"
+			  "\x01\x04\x00\x01\x00\x04\x04\x00" "\x01\x01" "Ab" "\x00\x00\x00\x00"
+			  "\x01\x04\x00\x01\x00\x00\x00\x00"
+			  "\x01\x05\x00\x01\x00\x00\x00\x00"s);
+
+	const auto header = CGI::FastCGI::ParseRecordHeader(output.data() + 16);
+	EXPECT_EQ(header.type, CGI::FastCGI::RecordType::PARAMS);
+	EXPECT_EQ(header.requestID, 1);
+	EXPECT_EQ(header.contentLength, 4);
+	EXPECT_EQ(header.paddingLength, 4);
+
+	// The STDIN stream is left open for the body.
+	std::string withBody;
+	CGI::FastCGI::AppendRequest(withBody, 1, { "A=b" }, true, true);
+	EXPECT_EQ(withBody, output.substr(0, output.length() - CGI::FastCGI::headerSize));
+}
+
+TEST(FastCGI, SplitsStreams) {
+	std::string output;
+	const std::string content(CGI::FastCGI::maxContentLength + 1, 'x');
+	CGI::FastCGI::AppendStream(output, CGI::FastCGI::RecordType::STDIN, 1, content);
+
+	const auto first = CGI::FastCGI::ParseRecordHeader(output.data());
+	EXPECT_EQ(first.type, CGI::FastCGI::RecordType::STDIN);
+	EXPECT_EQ(first.contentLength, CGI::FastCGI::maxContentLength);
+
+	const std::size_t secondOffset = CGI::FastCGI::headerSize + first.contentLength + first.paddingLength;
+	const auto second = CGI::FastCGI::ParseRecordHeader(output.data() + secondOffset);
+	EXPECT_EQ(second.contentLength, 1);
+	EXPECT_EQ(output.length(), secondOffset + CGI::FastCGI::headerSize + 8);
+
+	output.clear();
+	CGI::FastCGI::AppendStream(output, CGI::FastCGI::RecordType::STDIN, 1, {});
+	EXPECT_TRUE(output.empty());
+}
+
+TEST(CGIManager, RunsScripts) {
+	ScriptFile file("#!/bin/sh\nprintf 'Content-Type: text/plain\\n\\n%s' \"$REQUEST_METHOD $QUERY_STRING\"\n");
+
+	CGI::Manager manager;
+	CGI::Script script;
+	script.Command = file.path;
+	script.Name = "Test";
+	ASSERT_TRUE(manager.Register("/script", script));
+
+	HTTP::Request request;
+	request.path = "/script";
+	const auto *registered = manager.Lookup(request);
+	ASSERT_NE(registered, nullptr);
+
+	std::unique_ptr<CGI::Exchange> exchange;
+	ASSERT_EQ(manager.Start(*registered, { "REQUEST_METHOD=GET", "QUERY_STRING=a=b" }, HTTP::BodyFraming::NONE, exchange),
+			  CGI::Manager::StartStatus::STARTED);
+	EXPECT_EQ(ReadAll(*exchange), "Content-Type: text/plain\n\nGET a=b");
+}
+
+TEST(CGIManager, PassesTheBodyAsInput) {
+	// The script echoes its input, so it writes output while the body is
+	// written to it, more than the pipes can hold.
+	ScriptFile file("#!/bin/sh\nprintf 'Content-Type: text/plain\\n\\n'\ncat\n");
+	std::signal(SIGPIPE, SIG_IGN);
+
+	CGI::Manager manager;
+	CGI::Script script;
+	script.Command = file.path;
+	script.Name = "Test";
+	ASSERT_TRUE(manager.Register("/script", script));
+
+	HTTP::Request request;
+	request.path = "/script";
+	const auto *registered = manager.Lookup(request);
+	ASSERT_NE(registered, nullptr);
+
+	std::unique_ptr<CGI::Exchange> exchange;
+	ASSERT_EQ(manager.Start(*registered, {}, HTTP::BodyFraming::CHUNKED, exchange), CGI::Manager::StartStatus::STARTED);
+
+	std::string body;
+	std::string output;
+	for (int i = 0; i < 64; i++) {
+		const std::string part(8192, static_cast<char>('a' + i % 26));
+		body += part;
+
+		// The output is read while the script doesn't accept more input.
+		auto status = exchange->WriteBody(part);
+		while (status == CGI::Exchange::Status::WOULD_BLOCK) {
+			const auto readStatus = exchange->Read(output);
+			ASSERT_TRUE(readStatus == CGI::Exchange::Status::DATA || readStatus == CGI::Exchange::Status::WOULD_BLOCK);
+			if (readStatus == CGI::Exchange::Status::WOULD_BLOCK) {
+				ASSERT_TRUE(exchange->Wait());
+			}
+			status = exchange->Flush();
+		}
+		ASSERT_EQ(status, CGI::Exchange::Status::DATA);
+	}
+	ASSERT_TRUE(exchange->EndBody());
+	EXPECT_EQ(output + ReadAll(*exchange), "Content-Type: text/plain\n\n" + body);
+}
+
+TEST(CGIManager, QueuesTheInputWithoutWaiting) {
+	ScriptFile file("#!/bin/sh\nsleep 10\n");
+
+	CGI::Manager manager;
+	CGI::Script script;
+	script.Command = file.path;
+	script.Name = "Test";
+	ASSERT_TRUE(manager.Register("/script", script));
+
+	HTTP::Request request;
+	request.path = "/script";
+	const auto *registered = manager.Lookup(request);
+
+	std::unique_ptr<CGI::Exchange> exchange;
+	ASSERT_EQ(manager.Start(*registered, {}, HTTP::BodyFraming::CHUNKED, exchange), CGI::Manager::StartStatus::STARTED);
+
+	// More than the pipe holds, while the script doesn't read.
+	const auto start = std::chrono::steady_clock::now();
+	EXPECT_EQ(exchange->WriteBody(std::string(1024 * 1024, 'a')), CGI::Exchange::Status::WOULD_BLOCK);
+	EXPECT_EQ(exchange->Flush(), CGI::Exchange::Status::WOULD_BLOCK);
+	EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(1));
+
+	const auto awaited = exchange->Awaiting();
+	EXPECT_TRUE(awaited[0].write);
+	EXPECT_NE(awaited[1].fd, -1);
+}
+
+TEST(CGIManager, LimitsConcurrency) {
+	ScriptFile file("#!/bin/sh\nsleep 10\n");
+
+	CGI::Manager manager;
+	CGI::Script script;
+	script.Command = file.path;
+	script.Name = "Test";
+	script.MaxConcurrency = 1;
+	script.Timeout = std::chrono::milliseconds(100);
+	ASSERT_TRUE(manager.Register("/script", script));
+
+	HTTP::Request request;
+	request.path = "/script";
+	const auto *registered = manager.Lookup(request);
+
+	std::unique_ptr<CGI::Exchange> first;
+	std::unique_ptr<CGI::Exchange> second;
+	ASSERT_EQ(manager.Start(*registered, {}, HTTP::BodyFraming::NONE, first), CGI::Manager::StartStatus::STARTED);
+	EXPECT_EQ(manager.Start(*registered, {}, HTTP::BodyFraming::NONE, second), CGI::Manager::StartStatus::LIMIT_REACHED);
+
+	// The script doesn't finish in time, and is stopped.
+	EXPECT_EQ(ReadAll(*first), "FAILED");
+	first = nullptr;
+	EXPECT_EQ(manager.Start(*registered, {}, HTTP::BodyFraming::NONE, second), CGI::Manager::StartStatus::STARTED);
+}
+
+TEST(CGIManager, KeepsFastCGIConnections) {
+	const std::string path = "/tmp/cgi-test-" + std::to_string(getpid()) + ".sock";
+	std::remove(path.c_str());
+
+	const int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	struct sockaddr_un address{};
+	address.sun_family = AF_UNIX;
+	std::copy(std::cbegin(path), std::cend(path), address.sun_path);
+	ASSERT_EQ(bind(listener, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)), 0);
+	ASSERT_EQ(listen(listener, 4), 0);
+
+	// Answers two requests, on a single connection.
+	std::thread application([listener] {
+		const int fd = accept(listener, nullptr, nullptr);
+		for (int i = 0; i < 2; i++) {
+			// Read until the empty STDIN record.
+			std::string input;
+			std::array<char, 4096> buffer{};
+			while (input.find("\x01\x05\x00\x01\x00\x00\x00\x00"sv) == std::string::npos) {
+				const auto result = read(fd, buffer.data(), buffer.size());
+				if (result <= 0) {
+					close(fd);
+					return;
+				}
+				input.append(buffer.data(), static_cast<std::size_t>(result));
+			}
+
+			std::string output;
+			CGI::FastCGI::AppendRecord(output, CGI::FastCGI::RecordType::STDERR, 1, "warning");
+			CGI::FastCGI::AppendRecord(output, CGI::FastCGI::RecordType::STDOUT, 1, "Status: 204 No Content\r\n\r\n");
+			CGI::FastCGI::AppendRecord(output, CGI::FastCGI::RecordType::STDOUT, 1, {});
+			CGI::FastCGI::AppendRecord(output, CGI::FastCGI::RecordType::END_REQUEST, 1, "\0\0\0\0\0\0\0\0"sv);
+			static_cast<void>(write(fd, output.data(), output.length()));
+		}
+		close(fd);
+	});
+
+	CGI::Manager manager;
+	CGI::Script script;
+	script.Command = "/srv/app.php";
+	script.Name = "Test";
+	script.Type = CGI::Protocol::FAST_CGI;
+	script.Addresses = { path };
+	ASSERT_TRUE(manager.Register("/app", script));
+
+	HTTP::Request request;
+	request.path = "/app";
+	const auto *registered = manager.Lookup(request);
+
+	for (int i = 0; i < 2; i++) {
+		std::unique_ptr<CGI::Exchange> exchange;
+		ASSERT_EQ(manager.Start(*registered, { "REQUEST_METHOD=GET" }, HTTP::BodyFraming::NONE, exchange), CGI::Manager::StartStatus::STARTED);
+		EXPECT_EQ(ReadAll(*exchange), "Status: 204 No Content\r\n\r\n");
+	}
+
+	application.join();
+	close(listener);
+	std::remove(path.c_str());
+}
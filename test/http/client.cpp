@@ -7,12 +7,15 @@
 #define CONNECTION_MEMORY_VARIANT
 
 #include <algorithm>
+#include <chrono>
 #include <initializer_list>
 #include <iterator>
 #include <memory>
 #include <ostream>
 #include <random>
 #include <string>
+#include <string_view>
+#include <thread>
 
 #include <cstddef>
 
@@ -25,10 +28,13 @@
 #include "cgi/manager.hpp"
 #include "connection/connection.hpp"
 #include "connection/memory_userdata.hpp"
+#include "event/clock.hpp"
 #include "http/client.hpp"
 #include "http/client_error.hpp"
 #include "http/configuration.hpp"
 #include "http/server.hpp"
+#include "http2/frame.hpp"
+#include "http2/session.hpp"
 #include "security/policies.hpp"
 #include "security/tls_configuration.hpp"
 
@@ -66,13 +72,30 @@ TEST_F(ClientTest, TestConnectionSetup) {
 	ASSERT_EQ(internalData.input.size(), 0);
 }
 
+// Test if the receive buffer hands out the input in order
+TEST_F(ClientTest, TestConnectionPeekConsume) {
+	const std::string input("GET /");
+	ensureInputSize(input.length());
+	std::copy(std::crbegin(input), std::crend(input), std::begin(internalData.input));
+
+	auto received = client.connection->Peek();
+	ASSERT_EQ(std::string(received.data(), received.length()), input);
+
+	client.connection->Consume(4);
+	received = client.connection->Peek();
+	ASSERT_EQ(std::string(received.data(), received.length()), "/");
+
+	client.connection->Consume(1);
+	ASSERT_EQ(client.connection->Peek().length(), 0);
+}
+
 TEST_F(ClientTest, ConsumeMethodNormal) {
 	for (const std::string &method : { "GET ", "POST ", "UPDATEREDIRECTREF " }) {
 		ensureInputSize(method.length());
 		std::copy(std::crbegin(method), std::crend(method), std::begin(internalData.input));
 
 		/* Clear buffer(s) */
-		client.currentRequest.method.clear();
+		client.buffers.method.clear();
 
 		auto error = client.ConsumeMethod();
 		ASSERT_EQ_CLIENT_ERROR(error, HTTP::ClientError::NO_ERROR);
@@ -84,7 +107,7 @@ TEST_F(ClientTest, ConsumeMethodZeroLength) {
 	internalData.input[0] = ' ';
 
 	/* Clear buffer(s) */
-	client.currentRequest.method.clear();
+	client.buffers.method.clear();
 
 	auto error = client.ConsumeMethod();
 	ASSERT_EQ_CLIENT_ERROR(error, HTTP::ClientError::EMPTY_METHOD);
@@ -115,7 +138,7 @@ TEST_F(ClientTest, ConsumeMethodRandomToken) {
 		copyOfBuf.push_back('\0');
 
 		/* Clear buffer(s) */
-		client.currentRequest.method.clear();
+		client.buffers.method.clear();
 
 		auto error = client.ConsumeMethod();
 		ASSERT_EQ(error, HTTP::ClientError::NO_ERROR) << "Error: " << ClientErrorToString(error)
@@ -123,3 +146,100 @@ TEST_F(ClientTest, ConsumeMethodRandomToken) {
 			<< "\" a correct method (i.e. token i.e. 1*tchar) string, while it is a valid method string.";
 	}
 }
+
+TEST_F(ClientTest, IsPipelining) {
+	const std::string input("GET /a HTTP/1.1\r\nHost: localhost\r\n\r\nGET /b HTTP/1.1\r\nHost: localhost\r\n\r\nGET /c");
+	ensureInputSize(input.length());
+	std::copy(std::crbegin(input), std::crend(input), std::begin(internalData.input));
+
+	ASSERT_EQ_CLIENT_ERROR(client.ParseRequest(), HTTP::ClientError::NO_ERROR);
+	ASSERT_EQ(client.currentRequest.path, "/a");
+	client.ResetExchangeState();
+
+	// The second request has been received with the first.
+	ASSERT_TRUE(client.IsPipelining());
+	ASSERT_EQ_CLIENT_ERROR(client.ParseRequest(), HTTP::ClientError::NO_ERROR);
+	ASSERT_EQ(client.currentRequest.path, "/b");
+	client.ResetExchangeState();
+
+	// The head of the third is incomplete.
+	ASSERT_FALSE(client.IsPipelining());
+
+	client.MarkConnectionClosing();
+	ASSERT_FALSE(client.IsPipelining());
+}
+
+TEST_F(ClientTest, DrainsUnusedBodies) {
+	const std::string input("POST /a HTTP/1.1\r\nHost: localhost\r\nContent-Length: 5\r\n\r\nhello"
+							"POST /b HTTP/1.1\r\nHost: localhost\r\nTransfer-Encoding: chunked\r\n\r\n3\r\nabc\r\n0\r\n\r\n"
+							"GET /c HTTP/1.1\r\nHost: localhost\r\n\r\n");
+	ensureInputSize(input.length());
+	std::copy(std::crbegin(input), std::crend(input), std::begin(internalData.input));
+
+	for (const std::string_view path : { "/a", "/b", "/c" }) {
+		ASSERT_EQ_CLIENT_ERROR(client.ParseRequest(), HTTP::ClientError::NO_ERROR);
+		ASSERT_EQ(client.currentRequest.path, path);
+		ASSERT_EQ_CLIENT_ERROR(client.body.Start(client.currentRequest, 0), HTTP::ClientError::NO_ERROR);
+		client.ResetExchangeState();
+	}
+
+	ASSERT_EQ(client.connection->Buffered().length(), 0);
+	ASSERT_TRUE(client.persistentConnection);
+}
+
+TEST_F(ClientTest, ReadsBodiesAfterTheHead) {
+	const std::string input("POST /a HTTP/1.1\r\nHost: localhost\r\nContent-Length: 5\r\n\r\nhello");
+	ensureInputSize(input.length());
+	std::copy(std::crbegin(input), std::crend(input), std::begin(internalData.input));
+
+	ASSERT_EQ_CLIENT_ERROR(client.ParseRequest(), HTTP::ClientError::NO_ERROR);
+	ASSERT_EQ_CLIENT_ERROR(client.body.Start(client.currentRequest, 0), HTTP::ClientError::NO_ERROR);
+
+	// The request no longer refers to the receive buffer.
+	client.DetachRequest();
+	base::String data("", 0);
+	ASSERT_EQ(client.ReadBody(data), HTTP::BodyReader::Status::DATA);
+	ASSERT_EQ(std::string_view(data.data(), data.length()), "hello");
+	ASSERT_EQ(client.ReadBody(data), HTTP::BodyReader::Status::COMPLETE);
+	ASSERT_EQ(client.currentRequest.path, "/a");
+	ASSERT_EQ(client.currentRequest.headers.Find(HTTP::HeaderID::HOST)->value, "localhost");
+	client.ResetExchangeState();
+	ASSERT_TRUE(client.persistentConnection);
+}
+
+TEST_F(ClientTest, ClosesInsteadOfDrainingLargeBodies) {
+	const std::string input("POST /a HTTP/1.1\r\nHost: localhost\r\nContent-Length: 1000000\r\n\r\nhello");
+	ensureInputSize(input.length());
+	std::copy(std::crbegin(input), std::crend(input), std::begin(internalData.input));
+
+	ASSERT_EQ_CLIENT_ERROR(client.ParseRequest(), HTTP::ClientError::NO_ERROR);
+	ASSERT_EQ_CLIENT_ERROR(client.body.Start(client.currentRequest, 0), HTTP::ClientError::NO_ERROR);
+	client.ResetExchangeState();
+	ASSERT_FALSE(client.persistentConnection);
+}
+
+// A threaded client has no loop to update the clock for it, so the session
+// does.
+TEST_F(ClientTest, EndsThreadedSessionsAfterTheirLifetime) {
+	secPolicies.maxConnectionLifetime = 50;
+	Event::Clock::Update();
+	client.startingTimePoint = Event::Clock::Now();
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+	std::string input(HTTP2::connectionPreface);
+	input.append(HTTP2::frameHeaderSize, '\0');
+	HTTP2::WriteFrameHeader(input.data() + input.length() - HTTP2::frameHeaderSize, 0, HTTP2::FrameType::SETTINGS, 0, 0);
+	internalData.input.assign(std::crbegin(input), std::crend(input));
+
+	ASSERT_TRUE(client.StartSession());
+	client.RunSession();
+
+	bool goingAway = false;
+	const std::string_view output(internalData.output.data(), internalData.output.size());
+	for (std::size_t offset = 0; output.length() - offset >= HTTP2::frameHeaderSize;) {
+		const auto header = HTTP2::ParseFrameHeader(output.data() + offset);
+		goingAway |= header.type == HTTP2::FrameType::GOAWAY;
+		offset += HTTP2::frameHeaderSize + header.length;
+	}
+	EXPECT_TRUE(goingAway);
+}
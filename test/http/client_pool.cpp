@@ -0,0 +1,80 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include "base/media_type.hpp"
+#include "cgi/manager.hpp"
+#include "http/client_pool.hpp"
+#include "http/server.hpp"
+#include "security/address_limiter.hpp"
+#include "security/policies.hpp"
+#include "security/tls_configuration.hpp"
+
+namespace HTTP {
+
+	// The connections themselves aren't served by the tests, since those link
+	// the memory connection.
+	TEST(ClientPool, StartsAndStopsWithSmallStacks) {
+		MediaTypeFinder finder;
+		Security::Policies policies;
+		Security::TLSConfiguration tlsConfiguration;
+		Configuration configuration(finder, policies, tlsConfiguration);
+		configuration.hostname = "pool.test";
+
+		CGI::Manager manager;
+		Server server(configuration, manager);
+
+		// Rounded up to the minimum of the platform.
+		ClientPool pool(server, 4, 16, 1);
+		ASSERT_TRUE(pool.Start());
+		EXPECT_EQ(pool.ConnectionCount(), 0);
+		pool.Stop();
+	}
+
+	TEST(ClientPool, RejectsWhenFull) {
+		MediaTypeFinder finder;
+		Security::Policies policies;
+		Security::TLSConfiguration tlsConfiguration;
+		Configuration configuration(finder, policies, tlsConfiguration);
+		configuration.hostname = "pool.test";
+
+		CGI::Manager manager;
+		Server server(configuration, manager);
+
+		// Not started, so the connections stay in the queue.
+		ClientPool pool(server, 1, 2, 0);
+
+		int sockets[3][2];
+		for (auto &pair : sockets) {
+			ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, pair), 0);
+		}
+
+		Security::AddressLease lease;
+		ASSERT_TRUE(pool.TrySubmit(sockets[0][0], lease));
+		ASSERT_TRUE(pool.TrySubmit(sockets[1][0], lease));
+		ASSERT_FALSE(pool.TrySubmit(sockets[2][0], lease));
+		EXPECT_EQ(pool.ConnectionCount(), 2);
+
+		// The queued connections are closed, the rejected one is left alone.
+		pool.Stop();
+		EXPECT_EQ(pool.ConnectionCount(), 0);
+
+		char octet;
+		EXPECT_EQ(read(sockets[0][1], &octet, 1), 0);
+		EXPECT_EQ(read(sockets[1][1], &octet, 1), 0);
+		EXPECT_EQ(write(sockets[2][0], "x", 1), 1);
+
+		close(sockets[0][1]);
+		close(sockets[1][1]);
+		close(sockets[2][0]);
+		close(sockets[2][1]);
+	}
+
+} // namespace HTTP
@@ -0,0 +1,122 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#define TESTING
+
+#include "io/compression_cache.hpp"
+#include "io/file.hpp"
+
+class CompressionCacheTest : public ::testing::Test {
+protected:
+	std::string path;
+
+	void
+	SetUp() override {
+		std::string name("/tmp/compression_cache_test.XXXXXX");
+		const int fd = mkstemp(name.data());
+		ASSERT_NE(fd, -1);
+		close(fd);
+		path = name;
+	}
+
+	void
+	TearDown() override {
+		std::remove(path.c_str());
+	}
+
+	[[nodiscard]] static std::shared_ptr<const std::string>
+	Output(std::size_t length) {
+		return std::make_shared<const std::string>(length, 'x');
+	}
+};
+
+TEST_F(CompressionCacheTest, KeyedByCodingAndModificationTime) {
+	IO::CompressionCache cache(IO::CompressionCache::shardCount * 1024);
+	ASSERT_TRUE(cache.IsEnabled());
+
+	const IO::File file(path.c_str());
+	const auto output = Output(10);
+	cache.Insert(file, HTTP::ContentCoding::GZIP, output);
+	ASSERT_EQ(cache.Lookup(file, HTTP::ContentCoding::GZIP), output);
+	ASSERT_EQ(cache.Lookup(file, HTTP::ContentCoding::BROTLI), nullptr);
+
+	// A newer version of the file has another key.
+	std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	std::ofstream(path) << "changed";
+	const IO::File changed(path.c_str());
+	ASSERT_EQ(cache.Lookup(changed, HTTP::ContentCoding::GZIP), nullptr);
+}
+
+TEST_F(CompressionCacheTest, BoundedBySize) {
+	// A shard holds 100 octets.
+	IO::CompressionCache cache(IO::CompressionCache::shardCount * 100);
+
+	const IO::File file(path.c_str());
+	const auto coding = HTTP::ContentCoding::GZIP;
+	auto &shard = cache.ShardOf(IO::CompressionCache::KeyOf(file, coding));
+
+	cache.Insert(file, coding, Output(101));
+	ASSERT_EQ(cache.Lookup(file, coding), nullptr);
+
+	cache.Insert(file, coding, Output(60));
+	ASSERT_EQ(shard.size, 60);
+
+	// Replacing the entry doesn't count the old output.
+	cache.Insert(file, coding, Output(70));
+	ASSERT_EQ(shard.size, 70);
+	ASSERT_EQ(cache.Lookup(file, coding)->length(), 70);
+	ASSERT_EQ(shard.entries.size(), 1);
+}
+
+TEST_F(CompressionCacheTest, EvictsLeastRecentlyUsed) {
+	IO::CompressionCache cache(IO::CompressionCache::shardCount * 100);
+
+	// There are more paths than shards, so two of them share a shard.
+	std::vector<std::unique_ptr<IO::File>> files;
+	const IO::File *first = nullptr;
+	const IO::File *second = nullptr;
+	for (std::size_t i = 0; second == nullptr; i++) {
+		const auto name = path + '.' + std::to_string(i);
+		std::ofstream(name) << i;
+		files.push_back(std::make_unique<IO::File>(name.c_str()));
+		std::remove(name.c_str());
+
+		const auto &shard = cache.ShardOf(IO::CompressionCache::KeyOf(*files.back(), HTTP::ContentCoding::GZIP));
+		for (std::size_t j = 0; j + 1 < files.size(); j++) {
+			if (&cache.ShardOf(IO::CompressionCache::KeyOf(*files[j], HTTP::ContentCoding::GZIP)) == &shard) {
+				first = files[j].get();
+				second = files.back().get();
+			}
+		}
+	}
+
+	cache.Insert(*first, HTTP::ContentCoding::GZIP, Output(60));
+	cache.Insert(*second, HTTP::ContentCoding::GZIP, Output(60));
+	ASSERT_EQ(cache.Lookup(*first, HTTP::ContentCoding::GZIP), nullptr);
+	ASSERT_NE(cache.Lookup(*second, HTTP::ContentCoding::GZIP), nullptr);
+}
+
+TEST_F(CompressionCacheTest, Disabled) {
+	IO::CompressionCache cache(0);
+	ASSERT_FALSE(cache.IsEnabled());
+
+	const IO::File file(path.c_str());
+	cache.Insert(file, HTTP::ContentCoding::GZIP, Output(0));
+	ASSERT_EQ(cache.Lookup(file, HTTP::ContentCoding::GZIP), nullptr);
+}
@@ -0,0 +1,114 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include <string>
+
+#include <cstdint>
+
+#include <gtest/gtest.h>
+#include <zlib.h>
+
+#if defined(WEBSERVER_HAVE_BROTLI)
+#include <brotli/decode.h>
+#endif
+
+#include "http/compressor.hpp"
+
+namespace HTTP {
+
+[[nodiscard]] static std::string
+Decompress(ContentCoding coding, const std::string &input) {
+	std::string output(1 << 20, '\0');
+
+	if (coding == ContentCoding::GZIP) {
+		z_stream stream{};
+		if (inflateInit2(&stream, 15 + 16) != Z_OK) {
+			return {};
+		}
+		stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(input.data()));
+		stream.avail_in = static_cast<uInt>(input.length());
+		stream.next_out = reinterpret_cast<Bytef *>(output.data());
+		stream.avail_out = static_cast<uInt>(output.length());
+		const int status = inflate(&stream, Z_FINISH);
+		output.resize(stream.total_out);
+		inflateEnd(&stream);
+		return status == Z_STREAM_END ? output : std::string();
+	}
+
+#if defined(WEBSERVER_HAVE_BROTLI)
+	std::size_t length = output.length();
+	if (BrotliDecoderDecompress(input.length(), reinterpret_cast<const std::uint8_t *>(input.data()), &length,
+								reinterpret_cast<std::uint8_t *>(output.data())) != BROTLI_DECODER_RESULT_SUCCESS) {
+		return {};
+	}
+	output.resize(length);
+	return output;
+#else
+	return {};
+#endif
+}
+
+TEST(Compressor, RoundTrip) {
+	std::string input;
+	for (int i = 0; i < 20000; i++) {
+		input += std::to_string(i) + '\n';
+	}
+
+	for (const auto coding : { ContentCoding::GZIP, ContentCoding::BROTLI }) {
+		auto compressor = Compressor::Create(coding);
+		if (!Compressor::IsSupported(coding)) {
+			ASSERT_EQ(compressor, nullptr);
+			continue;
+		}
+		ASSERT_NE(compressor, nullptr);
+		ASSERT_EQ(compressor->Coding(), coding);
+
+		// At once, and a chunk at a time, which the compressor may buffer.
+		std::string output;
+		ASSERT_TRUE(compressor->Compress(input, true, output));
+		ASSERT_LT(output.length(), input.length());
+		ASSERT_EQ(Decompress(coding, output), input);
+
+		output.clear();
+		for (std::size_t offset = 0; offset < input.length(); offset += 1000) {
+			const auto chunk = std::string_view(input).substr(offset, 1000);
+			ASSERT_TRUE(compressor->Compress(chunk, offset + 1000 >= input.length(), output));
+		}
+		ASSERT_EQ(Decompress(coding, output), input);
+
+		// An abandoned stream doesn't affect the next.
+		output.clear();
+		ASSERT_TRUE(compressor->Compress("abandoned", false, output));
+		compressor->Reset();
+		output.clear();
+		ASSERT_TRUE(compressor->Compress("next", true, output));
+		ASSERT_EQ(Decompress(coding, output), "next");
+	}
+}
+
+TEST(Compressor, Pool) {
+	ASSERT_FALSE(Compressor::IsSupported(ContentCoding::IDENTITY));
+
+	CompressorPool pool;
+	ASSERT_EQ(pool.Acquire(ContentCoding::IDENTITY), nullptr);
+
+	auto compressor = pool.Acquire(ContentCoding::GZIP);
+	ASSERT_NE(compressor, nullptr);
+	auto *pointer = compressor.get();
+
+	std::string output;
+	ASSERT_TRUE(compressor->Compress("unfinished", false, output));
+	pool.Release(std::move(compressor));
+
+	// The compressor is reused, with a fresh stream.
+	compressor = pool.Acquire(ContentCoding::GZIP);
+	ASSERT_EQ(compressor.get(), pointer);
+	output.clear();
+	ASSERT_TRUE(compressor->Compress("fresh", true, output));
+	ASSERT_EQ(Decompress(ContentCoding::GZIP, output), "fresh");
+}
+
+} // namespace HTTP
@@ -0,0 +1,53 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include <gtest/gtest.h>
+
+#include "http/content_coding.hpp"
+
+namespace HTTP {
+
+[[nodiscard]] static std::uint16_t
+QualityOf(const AcceptEncoding &acceptEncoding, ContentCoding coding) {
+	return acceptEncoding.quality[static_cast<std::size_t>(coding)];
+}
+
+TEST(ContentCoding, ParseAcceptEncoding) {
+	auto result = AcceptEncoding::Parse("gzip, deflate, br");
+	ASSERT_EQ(QualityOf(result, ContentCoding::BROTLI), 1000);
+	ASSERT_EQ(QualityOf(result, ContentCoding::GZIP), 1000);
+
+	result = AcceptEncoding::Parse("br;q=0.5 ,GZIP; q=0.25");
+	ASSERT_EQ(QualityOf(result, ContentCoding::BROTLI), 500);
+	ASSERT_EQ(QualityOf(result, ContentCoding::GZIP), 250);
+
+	result = AcceptEncoding::Parse("x-gzip;q=1.0");
+	ASSERT_EQ(QualityOf(result, ContentCoding::BROTLI), 0);
+	ASSERT_EQ(QualityOf(result, ContentCoding::GZIP), 1000);
+
+	result = AcceptEncoding::Parse("*;q=0.1, gzip;q=0");
+	ASSERT_EQ(QualityOf(result, ContentCoding::BROTLI), 100);
+	ASSERT_EQ(QualityOf(result, ContentCoding::GZIP), 0);
+
+	result = AcceptEncoding::Parse("");
+	ASSERT_EQ(QualityOf(result, ContentCoding::IDENTITY), 1000);
+	ASSERT_EQ(QualityOf(result, ContentCoding::BROTLI), 0);
+	ASSERT_EQ(QualityOf(result, ContentCoding::GZIP), 0);
+}
+
+TEST(ContentCoding, SelectAcceptEncoding) {
+	const auto all = [](ContentCoding) { return true; };
+	const auto gzipOnly = [](ContentCoding coding) { return coding == ContentCoding::GZIP; };
+
+	ASSERT_EQ(AcceptEncoding::Parse("gzip, br").Select(all), ContentCoding::BROTLI);
+	ASSERT_EQ(AcceptEncoding::Parse("gzip, br").Select(gzipOnly), ContentCoding::GZIP);
+	ASSERT_EQ(AcceptEncoding::Parse("gzip, br;q=0.5").Select(all), ContentCoding::GZIP);
+	ASSERT_EQ(AcceptEncoding::Parse("br").Select(gzipOnly), ContentCoding::IDENTITY);
+	ASSERT_EQ(AcceptEncoding::Parse("gzip;q=0").Select(all), ContentCoding::IDENTITY);
+	ASSERT_EQ(AcceptEncoding::Parse("identity").Select(all), ContentCoding::IDENTITY);
+}
+
+} // namespace HTTP
@@ -0,0 +1,65 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include <array>
+#include <chrono>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "event/clock.hpp"
+#include "http/date.hpp"
+
+namespace HTTP {
+
+TEST(Date, Format) {
+	std::array<char, dateLength> output{};
+
+	FormatDate(784111777, output);
+	ASSERT_EQ(std::string_view(output.data(), output.size()), "Sun, 06 Nov 1994 08:49:37 GMT");
+
+	FormatDate(0, output);
+	ASSERT_EQ(std::string_view(output.data(), output.size()), "Thu, 01 Jan 1970 00:00:00 GMT");
+}
+
+TEST(Date, Parse) {
+	std::time_t time;
+
+	ASSERT_TRUE(ParseDate("Sun, 06 Nov 1994 08:49:37 GMT", time));
+	ASSERT_EQ(time, 784111777);
+
+	for (const char *date : {
+			"", "Sunday, 06-Nov-94 08:49:37 GMT", "Sun Nov  6 08:49:37 1994",
+			"Sun, 06 Nov 1994 08:49:37 UTC", "Sun, 06 Now 1994 08:49:37 GMT", "Sun, 0x Nov 1994 08:49:37 GMT",
+		}) {
+		ASSERT_FALSE(ParseDate(date, time)) << date;
+	}
+}
+
+TEST(Date, CurrentDateHeader) {
+	const auto expected = [] {
+		std::array<char, dateLength> date{};
+		FormatDate(Event::Clock::Seconds(), date);
+		return "\r\nDate: " + std::string(date.data(), date.size());
+	};
+
+	Event::Clock::Update();
+	ASSERT_EQ(CurrentDateHeader(), expected());
+	ASSERT_EQ(CurrentDate(), expected().substr(8));
+
+	// Only an update of the clock changes the field.
+	const std::string before(CurrentDateHeader());
+	std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+	ASSERT_EQ(CurrentDateHeader(), before);
+
+	Event::Clock::Update();
+	ASSERT_NE(CurrentDateHeader(), before);
+	ASSERT_EQ(CurrentDateHeader(), expected());
+}
+
+} // namespace HTTP
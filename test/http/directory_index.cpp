@@ -0,0 +1,96 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include <fstream>
+#include <string>
+
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <gtest/gtest.h>
+
+#include "io/directory_index.hpp"
+#include "io/file.hpp"
+
+class DirectoryIndexTest : public ::testing::Test {
+protected:
+	std::string root;
+
+	void
+	SetUp() override {
+		std::string name("/tmp/directory_index_test.XXXXXX");
+		ASSERT_NE(mkdtemp(name.data()), nullptr);
+		root = name;
+
+		ASSERT_EQ(mkdir((root + "/sub").c_str(), 0700), 0);
+		std::ofstream(root + "/b.txt") << "b";
+		std::ofstream(root + "/a b&.html") << "a";
+		std::ofstream(root + "/.hidden") << "hidden";
+	}
+
+	void
+	TearDown() override {
+		for (const char *path : { "/sub", "/b.txt", "/a b&.html", "/.hidden", "/c.txt", "" }) {
+			std::remove((root + path).c_str());
+		}
+	}
+
+	void
+	Backdate(time_t seconds) {
+		const struct timespec times[2]{ { seconds, 0 }, { seconds, 0 } };
+		ASSERT_EQ(utimensat(AT_FDCWD, root.c_str(), times, 0), 0);
+	}
+};
+
+TEST_F(DirectoryIndexTest, Generate) {
+	const IO::File directory(root.c_str());
+	ASSERT_TRUE(directory.IsDirectory());
+
+	std::string listing;
+	ASSERT_TRUE(IO::DirectoryIndex::Generate(directory, "/files", listing));
+	EXPECT_NE(listing.find("<title>Index of /files/</title>"), std::string::npos);
+	EXPECT_NE(listing.find("<a href=\"/\">../</a>"), std::string::npos);
+	EXPECT_EQ(listing.find("hidden"), std::string::npos);
+
+	// The entries are escaped and sorted, and the directories marked.
+	const auto first = listing.find("<a href=\"/files/a%20b%26.html\">a b&amp;.html</a>");
+	const auto second = listing.find("<a href=\"/files/b.txt\">b.txt</a>");
+	const auto third = listing.find("<a href=\"/files/sub/\">sub/</a>");
+	ASSERT_NE(first, std::string::npos);
+	ASSERT_NE(second, std::string::npos);
+	ASSERT_NE(third, std::string::npos);
+	EXPECT_LT(first, second);
+	EXPECT_LT(second, third);
+
+	// The root has no parent.
+	ASSERT_TRUE(IO::DirectoryIndex::Generate(directory, "/", listing));
+	EXPECT_EQ(listing.find("../"), std::string::npos);
+	EXPECT_NE(listing.find("<a href=\"/sub/\">sub/</a>"), std::string::npos);
+}
+
+TEST_F(DirectoryIndexTest, KeepsListingsUntilTheDirectoryChanges) {
+	IO::DirectoryIndex index(16);
+
+	Backdate(1000);
+	const auto listing = index.Listing(IO::File(root.c_str()), "/");
+	ASSERT_NE(listing, nullptr);
+	EXPECT_EQ(index.Listing(IO::File(root.c_str()), "/"), listing);
+
+	std::ofstream(root + "/c.txt") << "c";
+	Backdate(2000);
+	const auto changed = index.Listing(IO::File(root.c_str()), "/");
+	ASSERT_NE(changed, listing);
+	EXPECT_NE(changed->find("c.txt"), std::string::npos);
+
+	// A recently modified directory is listed again every time.
+	ASSERT_EQ(utimensat(AT_FDCWD, root.c_str(), nullptr, 0), 0);
+	const auto recent = index.Listing(IO::File(root.c_str()), "/");
+	EXPECT_NE(index.Listing(IO::File(root.c_str()), "/"), recent);
+}
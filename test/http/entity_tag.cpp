@@ -0,0 +1,34 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include <gtest/gtest.h>
+
+#include "http/entity_tag.hpp"
+
+namespace HTTP {
+
+TEST(EntityTag, MatchesStrongly) {
+	ASSERT_TRUE(EntityTag::MatchesStrongly("\"a\"", "\"a\""));
+	ASSERT_FALSE(EntityTag::MatchesStrongly("\"a\"", "\"b\""));
+	ASSERT_FALSE(EntityTag::MatchesStrongly("W/\"a\"", "\"a\""));
+	ASSERT_FALSE(EntityTag::MatchesStrongly("W/\"a\"", "W/\"a\""));
+}
+
+TEST(EntityTag, MatchesListWeakly) {
+	ASSERT_TRUE(EntityTag::MatchesListWeakly("*", "\"a\""));
+	ASSERT_TRUE(EntityTag::MatchesListWeakly("\"a\"", "\"a\""));
+	ASSERT_TRUE(EntityTag::MatchesListWeakly("W/\"a\"", "\"a\""));
+	ASSERT_TRUE(EntityTag::MatchesListWeakly("\"a\"", "W/\"a\""));
+	ASSERT_TRUE(EntityTag::MatchesListWeakly("\"x\", \"a\"", "\"a\""));
+	ASSERT_TRUE(EntityTag::MatchesListWeakly("\"x\",\t W/\"a\" ,\"y\"", "\"a\""));
+
+	ASSERT_FALSE(EntityTag::MatchesListWeakly("", "\"a\""));
+	ASSERT_FALSE(EntityTag::MatchesListWeakly("\"x\", \"y\"", "\"a\""));
+	ASSERT_FALSE(EntityTag::MatchesListWeakly("\"a\"x", "\"a\""));
+	ASSERT_FALSE(EntityTag::MatchesListWeakly(", ,", "\"a\""));
+}
+
+} // namespace HTTP
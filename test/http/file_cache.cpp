@@ -0,0 +1,268 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include <array>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#define TESTING
+
+#include "base/media_type.hpp"
+#include "base/numa.hpp"
+#include "io/file.hpp"
+#include "io/file_cache.hpp"
+
+class FileCacheTest : public ::testing::Test {
+protected:
+	std::string path;
+
+	void
+	SetUp() override {
+		std::string name("/tmp/file_cache_test.XXXXXX");
+		const int fd = mkstemp(name.data());
+		ASSERT_NE(fd, -1);
+		close(fd);
+		path = name;
+	}
+
+	void
+	TearDown() override {
+		std::remove(path.c_str());
+	}
+
+	void
+	WriteFile(const std::string &contents) {
+		std::ofstream(path, std::ios::trunc) << contents;
+	}
+
+	// Waits until the watcher has invalidated [key], if ever.
+	[[nodiscard]] static bool
+	AwaitInvalidation(IO::FileCache &cache, const std::string &key) {
+		for (int i = 0; i < 100; i++) {
+			if (!cache.Lookup(key)) {
+				return true;
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		}
+		return false;
+	}
+};
+
+TEST_F(FileCacheTest, StoresSmallFiles) {
+	IO::FileCache cache(16, 16);
+	ASSERT_TRUE(cache.Initialize());
+	WriteFile("contents");
+
+	auto entry = cache.Insert("/a", std::make_unique<IO::File>(path.c_str()), MediaTypes::TEXT);
+	ASSERT_TRUE(entry->hasContents);
+	ASSERT_EQ(entry->contents, "contents");
+	ASSERT_EQ(entry->mediaType, &MediaTypes::TEXT);
+	ASSERT_EQ(cache.Lookup("/a"), entry);
+	ASSERT_EQ(cache.Lookup("/b"), nullptr);
+
+	WriteFile("a file larger than sixteen octets");
+	entry = cache.Insert("/c", std::make_unique<IO::File>(path.c_str()), MediaTypes::TEXT);
+	ASSERT_FALSE(entry->hasContents);
+	ASSERT_NE(entry->file->Handle(), -1);
+}
+
+TEST_F(FileCacheTest, MapsLargerFiles) {
+	IO::FileCache cache(16, 4, 64);
+	ASSERT_TRUE(cache.Initialize());
+	WriteFile("larger than four octets");
+
+	auto entry = cache.Insert("/a", std::make_unique<IO::File>(path.c_str()), MediaTypes::TEXT);
+	ASSERT_FALSE(entry->hasContents);
+	ASSERT_EQ(entry->file->Mapping(), "larger than four octets");
+	ASSERT_EQ(entry->Memory(), "larger than four octets");
+
+	// Too large to be mapped.
+	WriteFile(std::string(65, 'x'));
+	entry = cache.Insert("/b", std::make_unique<IO::File>(path.c_str()), MediaTypes::TEXT);
+	ASSERT_TRUE(entry->file->Mapping().empty());
+	ASSERT_TRUE(entry->Memory().empty());
+}
+
+TEST_F(FileCacheTest, ComputesValidators) {
+	IO::FileCache cache(16, 16);
+	ASSERT_TRUE(cache.Initialize());
+	WriteFile("contents");
+
+	const auto entry = cache.Insert("/a", std::make_unique<IO::File>(path.c_str()), MediaTypes::TEXT);
+	ASSERT_GE(entry->entityTag.length(), 2);
+	ASSERT_EQ(entry->entityTag.back(), '"');
+	ASSERT_EQ(entry->validatorHeaders.rfind("ETag: " + entry->entityTag + "\r\nLast-Modified: ", 0), 0);
+
+	// The file has just been written, so the entity-tag is weak.
+	ASSERT_EQ(entry->entityTag.rfind("W/\"", 0), 0);
+
+	// A different file has a different entity-tag.
+	WriteFile("other contents");
+	const auto other = cache.Insert("/b", std::make_unique<IO::File>(path.c_str()), MediaTypes::TEXT);
+	ASSERT_NE(other->entityTag, entry->entityTag);
+}
+
+TEST_F(FileCacheTest, StrengthensWeakValidators) {
+	IO::FileCache cache(16, 16);
+	ASSERT_TRUE(cache.Initialize());
+	WriteFile("contents");
+
+	const auto entry = cache.Insert("/a", std::make_unique<IO::File>(path.c_str()), MediaTypes::TEXT);
+	ASSERT_EQ(entry->entityTag.rfind("W/\"", 0), 0);
+
+	// Once the second of the modification has passed, the entry is stored
+	// again with a strong entity-tag.
+	std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+	ASSERT_EQ(cache.Lookup("/a"), nullptr);
+
+	const auto stored = cache.Insert("/a", std::make_unique<IO::File>(path.c_str()), MediaTypes::TEXT);
+	ASSERT_EQ(stored->entityTag.rfind('"', 0), 0);
+	ASSERT_EQ(cache.Lookup("/a"), stored);
+}
+
+TEST_F(FileCacheTest, EvictsLeastRecentlyUsed) {
+	// A shard holds a single entry.
+	IO::FileCache cache(1, 0);
+	ASSERT_TRUE(cache.Initialize());
+
+	// Find two keys of the same shard.
+	const std::string first("/0");
+	std::string second;
+	for (int i = 1; second.empty(); i++) {
+		const auto key = "/" + std::to_string(i);
+		if (&cache.ShardOf(key) == &cache.ShardOf(first)) {
+			second = key;
+		}
+	}
+
+	static_cast<void>(cache.Insert(first, std::make_unique<IO::File>(path.c_str()), MediaTypes::TEXT));
+	ASSERT_NE(cache.Lookup(first), nullptr);
+	static_cast<void>(cache.Insert(second, std::make_unique<IO::File>(path.c_str()), MediaTypes::TEXT));
+	ASSERT_EQ(cache.Lookup(first), nullptr);
+	ASSERT_NE(cache.Lookup(second), nullptr);
+}
+
+TEST_F(FileCacheTest, PartitionsByNode) {
+	IO::FileCache cache(16, 16, 0, 2);
+	ASSERT_TRUE(cache.Initialize());
+	WriteFile("contents");
+
+	const auto entry = cache.Insert("/a", std::make_unique<IO::File>(path.c_str()), MediaTypes::TEXT);
+	ASSERT_EQ(cache.Lookup("/a"), entry);
+
+	// The other node has a partition of its own, and the nodes beyond are
+	// folded onto the last.
+	std::thread([&cache, this] {
+		base::SetCurrentNumaNode(1);
+		EXPECT_EQ(cache.Lookup("/a"), nullptr);
+		static_cast<void>(cache.Insert("/a", std::make_unique<IO::File>(path.c_str()), MediaTypes::TEXT));
+
+		base::SetCurrentNumaNode(7);
+		EXPECT_NE(cache.Lookup("/a"), nullptr);
+	}).join();
+
+	ASSERT_EQ(cache.Lookup("/a"), entry);
+	ASSERT_EQ(cache.Paths(), std::vector<std::string>{ "/a" });
+}
+
+TEST_F(FileCacheTest, InvalidatesChangedFiles) {
+	IO::FileCache cache(16, 1024);
+	ASSERT_TRUE(cache.Initialize());
+	WriteFile("first");
+
+	const auto entry = cache.Insert("/a", std::make_unique<IO::File>(path.c_str()), MediaTypes::TEXT);
+	ASSERT_NE(cache.Lookup("/a"), nullptr);
+
+	WriteFile("second");
+	ASSERT_TRUE(AwaitInvalidation(cache, "/a"));
+
+	// The evicted entry is still usable by whoever holds it.
+	ASSERT_EQ(entry->contents, "first");
+	ASSERT_NE(entry->file->Handle(), -1);
+
+	static_cast<void>(cache.Insert("/a", std::make_unique<IO::File>(path.c_str()), MediaTypes::TEXT));
+	ASSERT_EQ(cache.Lookup("/a")->contents, "second");
+
+	std::remove(path.c_str());
+	ASSERT_TRUE(AwaitInvalidation(cache, "/a"));
+}
+
+TEST_F(FileCacheTest, InvalidatesOnlyTheChangedFile) {
+	IO::FileCache cache(16, 1024);
+	ASSERT_TRUE(cache.Initialize());
+
+	std::string other("/tmp/file_cache_test.XXXXXX");
+	const int fd = mkstemp(other.data());
+	ASSERT_NE(fd, -1);
+	close(fd);
+
+	// Backdated, so the entity-tags are strong and the entries are kept.
+	const struct timespec times[2]{ { 1000, 0 }, { 1000, 0 } };
+	ASSERT_EQ(utimensat(AT_FDCWD, path.c_str(), times, 0), 0);
+	ASSERT_EQ(utimensat(AT_FDCWD, other.c_str(), times, 0), 0);
+
+	static_cast<void>(cache.Insert("/a", std::make_unique<IO::File>(path.c_str()), MediaTypes::TEXT));
+	static_cast<void>(cache.Insert("/b", std::make_unique<IO::File>(other.c_str()), MediaTypes::TEXT));
+
+	std::ofstream(other, std::ios::trunc) << "changed";
+	ASSERT_TRUE(AwaitInvalidation(cache, "/b"));
+	ASSERT_NE(cache.Lookup("/a"), nullptr);
+
+	std::remove(other.c_str());
+}
+
+TEST_F(FileCacheTest, StoresEncodings) {
+	IO::FileCache cache(16, 1024);
+	ASSERT_TRUE(cache.Initialize());
+	WriteFile("identity");
+
+	const auto sibling = path + ".gz";
+	std::ofstream(sibling) << "gzip";
+
+	std::array<std::unique_ptr<IO::File>, HTTP::contentCodingCount> encodings;
+	encodings[static_cast<std::size_t>(HTTP::ContentCoding::GZIP)] = std::make_unique<IO::File>(sibling.c_str());
+
+	const auto entry = cache.Insert("/a", std::make_unique<IO::File>(path.c_str()), MediaTypes::TEXT, std::move(encodings));
+	ASSERT_TRUE(entry->HasEncodings());
+	ASSERT_EQ(entry->coding, HTTP::ContentCoding::IDENTITY);
+	ASSERT_EQ(entry->encodings[static_cast<std::size_t>(HTTP::ContentCoding::BROTLI)], nullptr);
+
+	const auto &encoded = entry->encodings[static_cast<std::size_t>(HTTP::ContentCoding::GZIP)];
+	ASSERT_NE(encoded, nullptr);
+	ASSERT_EQ(encoded->coding, HTTP::ContentCoding::GZIP);
+	ASSERT_EQ(encoded->contents, "gzip");
+	ASSERT_EQ(encoded->mediaType, &MediaTypes::TEXT);
+	ASSERT_NE(encoded->entityTag, entry->entityTag);
+
+	// Changing a sibling invalidates the entry too.
+	std::ofstream(path + ".br") << "brotli";
+	ASSERT_TRUE(AwaitInvalidation(cache, "/a"));
+
+	std::remove(sibling.c_str());
+	std::remove((path + ".br").c_str());
+}
+
+TEST_F(FileCacheTest, Disabled) {
+	IO::FileCache cache(0, 1024);
+	ASSERT_TRUE(cache.Initialize());
+
+	const auto entry = cache.Insert("/a", std::make_unique<IO::File>(path.c_str()), MediaTypes::TEXT);
+	ASSERT_NE(entry, nullptr);
+	ASSERT_EQ(cache.Lookup("/a"), nullptr);
+}
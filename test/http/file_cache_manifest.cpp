@@ -0,0 +1,94 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include "io/file_cache_manifest.hpp"
+
+class FileCacheManifestTest : public ::testing::Test {
+protected:
+	std::string path;
+
+	void
+	SetUp() override {
+		std::string name("/tmp/file_cache_manifest_test.XXXXXX");
+		const int fd = mkstemp(name.data());
+		ASSERT_NE(fd, -1);
+		close(fd);
+		path = name;
+	}
+
+	void
+	TearDown() override {
+		std::remove(path.c_str());
+	}
+
+	void
+	WriteFile(const std::string &contents) {
+		std::ofstream(path, std::ios::trunc | std::ios::binary) << contents;
+	}
+
+	[[nodiscard]] static std::string
+	Encode(std::uint32_t value) {
+		return std::string(reinterpret_cast<const char *>(&value), sizeof(value));
+	}
+};
+
+TEST_F(FileCacheManifestTest, RoundTrips) {
+	const std::vector<std::string> paths{ "/var/www/html/", "/var/www/html/index.html", "", "/var/www/a.css" };
+	ASSERT_TRUE(IO::FileCacheManifest::Save(path, paths));
+
+	IO::FileCacheManifest manifest;
+	ASSERT_TRUE(manifest.Load(path));
+	ASSERT_EQ(manifest.Size(), paths.size());
+	for (std::size_t i = 0; i < paths.size(); i++) {
+		EXPECT_EQ(manifest[i], paths[i]) << i;
+	}
+
+	// Saving replaces the file, so the mapping stays intact.
+	ASSERT_TRUE(IO::FileCacheManifest::Save(path, {}));
+	EXPECT_EQ(manifest[1], paths[1]);
+
+	IO::FileCacheManifest empty;
+	ASSERT_TRUE(empty.Load(path));
+	EXPECT_EQ(empty.Size(), 0);
+}
+
+TEST_F(FileCacheManifestTest, RejectsMalformedManifests) {
+	IO::FileCacheManifest manifest;
+	EXPECT_FALSE(manifest.Load(path + ".missing"));
+
+	WriteFile("");
+	EXPECT_FALSE(manifest.Load(path));
+
+	WriteFile("WSCACHE0" + Encode(0));
+	EXPECT_FALSE(manifest.Load(path));
+
+	// The table doesn't fit.
+	WriteFile("WSCACHE1" + Encode(2) + Encode(1));
+	EXPECT_FALSE(manifest.Load(path));
+
+	// The offsets point past the paths, or descend.
+	WriteFile("WSCACHE1" + Encode(1) + Encode(5) + "/a");
+	EXPECT_FALSE(manifest.Load(path));
+	WriteFile("WSCACHE1" + Encode(2) + Encode(2) + Encode(1) + "/a");
+	EXPECT_FALSE(manifest.Load(path));
+
+	WriteFile("WSCACHE1" + Encode(2) + Encode(2) + Encode(4) + "/a/b");
+	ASSERT_TRUE(manifest.Load(path));
+	ASSERT_EQ(manifest.Size(), 2);
+	EXPECT_EQ(manifest[0], "/a");
+	EXPECT_EQ(manifest[1], "/b");
+}
@@ -0,0 +1,158 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <gtest/gtest.h>
+
+#include "http/request.hpp"
+#include "io/file_resolver.hpp"
+
+TEST(FileResolver, NormalizePath) {
+	std::string relativePath;
+
+	for (const auto &[path, expected] : {
+			std::pair{ "/", "" },
+			std::pair{ "/index.html", "index.html" },
+			std::pair{ "//a///b/", "a/b" },
+			std::pair{ "/./a/./b", "a/b" },
+			std::pair{ "/a/b/../c", "a/c" },
+			std::pair{ "/a/..", "" },
+			std::pair{ "/a/..b/...", "a/..b/..." },
+		}) {
+		ASSERT_TRUE(IO::FileResolver::NormalizePath(path, relativePath)) << path;
+		ASSERT_EQ(relativePath, expected) << path;
+	}
+
+	for (const char *path : { "/..", "/../etc/passwd", "/a/../../b", "/a/./../.." }) {
+		ASSERT_FALSE(IO::FileResolver::NormalizePath(path, relativePath)) << path;
+	}
+}
+
+class FileResolverTest : public ::testing::Test {
+protected:
+	std::string root;
+
+	void
+	SetUp() override {
+		std::string name("/tmp/file_resolver_test.XXXXXX");
+		ASSERT_NE(mkdtemp(name.data()), nullptr);
+		root = name;
+
+		ASSERT_EQ(mkdir((root + "/dir").c_str(), 0700), 0);
+		ASSERT_EQ(mkdir((root + "/empty").c_str(), 0700), 0);
+		std::ofstream(root + "/dir/index.html") << "index";
+		std::ofstream(root + "/file.txt") << "file";
+		std::ofstream(root + "/file.txt.gz") << "gzip";
+		ASSERT_EQ(mkdir((root + "/file.txt.br").c_str(), 0700), 0);
+		ASSERT_EQ(symlink("file.txt", (root + "/inside").c_str()), 0);
+		ASSERT_EQ(symlink("/etc/passwd", (root + "/outside").c_str()), 0);
+		ASSERT_EQ(symlink("../../etc", (root + "/dir/up").c_str()), 0);
+	}
+
+	void
+	TearDown() override {
+		for (const char *path : { "/dir/up", "/dir/index.html", "/dir", "/empty", "/inside", "/outside", "/file.txt.br",
+								  "/file.txt.gz", "/file.txt", "" }) {
+			std::remove((root + path).c_str());
+		}
+	}
+
+	[[nodiscard]] IO::FileResolveStatus
+	Resolve(std::string_view path) const {
+		IO::FileResolver resolver(root);
+		HTTP::Request request{};
+		request.path = path;
+		return resolver.Resolve(request).first;
+	}
+};
+
+TEST_F(FileResolverTest, Resolve) {
+	ASSERT_EQ(Resolve("/file.txt"), IO::FileResolveStatus::OK);
+	ASSERT_EQ(Resolve("/dir"), IO::FileResolveStatus::OK);
+	ASSERT_EQ(Resolve("/dir/../file.txt"), IO::FileResolveStatus::OK);
+	ASSERT_EQ(Resolve("/inside"), IO::FileResolveStatus::OK);
+	ASSERT_EQ(Resolve("/nope"), IO::FileResolveStatus::NOT_FOUND);
+	ASSERT_EQ(Resolve("/empty"), IO::FileResolveStatus::NOT_FOUND);
+}
+
+TEST_F(FileResolverTest, RemembersDirectoriesWithoutIndex) {
+	const auto directory = root + "/empty";
+	const auto backdate = [&directory](time_t seconds) {
+		const struct timespec times[2]{ { seconds, 0 }, { seconds, 0 } };
+		ASSERT_EQ(utimensat(AT_FDCWD, directory.c_str(), times, 0), 0);
+	};
+
+	IO::FileResolver resolver(root);
+	HTTP::Request request{};
+	request.path = "/empty";
+
+	// The directory is returned, so it can be listed.
+	backdate(1000);
+	auto result = resolver.Resolve(request);
+	ASSERT_EQ(result.first, IO::FileResolveStatus::NOT_FOUND);
+	ASSERT_NE(result.second, nullptr);
+	ASSERT_TRUE(result.second->IsDirectory());
+
+	// The index isn't looked for while the directory is unchanged...
+	std::ofstream(directory + "/index.html") << "index";
+	backdate(1000);
+	ASSERT_EQ(resolver.Resolve(request).first, IO::FileResolveStatus::NOT_FOUND);
+
+	// ...which it is after an entry is added.
+	backdate(2000);
+	result = resolver.Resolve(request);
+	ASSERT_EQ(result.first, IO::FileResolveStatus::OK);
+	ASSERT_EQ(result.second->Path(), directory + "/index.html");
+
+	std::remove((directory + "/index.html").c_str());
+}
+
+// A FIFO without a writer would block open(2).
+TEST_F(FileResolverTest, RejectsFIFOsWithoutBlocking) {
+	const auto fifo = root + "/fifo";
+	ASSERT_EQ(mkfifo(fifo.c_str(), 0600), 0);
+	EXPECT_EQ(Resolve("/fifo"), IO::FileResolveStatus::NOT_FOUND);
+	std::remove(fifo.c_str());
+}
+
+TEST_F(FileResolverTest, StaysBeneathRoot) {
+	ASSERT_EQ(Resolve("/../etc/passwd"), IO::FileResolveStatus::OUTSIDE_ROOT_DIRECTORY);
+	ASSERT_EQ(Resolve("/outside"), IO::FileResolveStatus::OUTSIDE_ROOT_DIRECTORY);
+	ASSERT_EQ(Resolve("/dir/up/passwd"), IO::FileResolveStatus::OUTSIDE_ROOT_DIRECTORY);
+}
+
+TEST_F(FileResolverTest, ResolveEncodings) {
+	IO::FileResolver resolver(root);
+	HTTP::Request request{};
+	request.path = "/file.txt";
+	auto file = resolver.Resolve(request).second;
+	ASSERT_NE(file, nullptr);
+
+	// The ".br" sibling is a directory, so it isn't used.
+	const auto encodings = resolver.ResolveEncodings(*file);
+	ASSERT_EQ(encodings[static_cast<std::size_t>(HTTP::ContentCoding::IDENTITY)], nullptr);
+	ASSERT_EQ(encodings[static_cast<std::size_t>(HTTP::ContentCoding::BROTLI)], nullptr);
+	ASSERT_NE(encodings[static_cast<std::size_t>(HTTP::ContentCoding::GZIP)], nullptr);
+	ASSERT_EQ(encodings[static_cast<std::size_t>(HTTP::ContentCoding::GZIP)]->Path(), root + "/file.txt.gz");
+
+	request.path = "/dir";
+	file = resolver.Resolve(request).second;
+	ASSERT_NE(file, nullptr);
+	for (const auto &encoding : resolver.ResolveEncodings(*file)) {
+		ASSERT_EQ(encoding, nullptr);
+	}
+}
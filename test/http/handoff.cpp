@@ -0,0 +1,104 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include <chrono>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include "http/handoff.hpp"
+
+namespace HTTP {
+
+class HandoffTest : public ::testing::Test {
+protected:
+	int channels[2]{ -1, -1 };
+
+	void
+	SetUp() override {
+		ASSERT_EQ(socketpair(AF_UNIX, SOCK_SEQPACKET, 0, channels), 0);
+	}
+
+	void
+	TearDown() override {
+		for (int channel : channels) {
+			if (channel != -1) {
+				close(channel);
+			}
+		}
+	}
+
+	[[nodiscard]] static ino_t
+	Inode(int fd) {
+		struct stat status{};
+		EXPECT_EQ(fstat(fd, &status), 0);
+		return status.st_ino;
+	}
+};
+
+TEST_F(HandoffTest, PassesTheSockets) {
+	// More sockets than fit in a single message.
+	Handoff::Sockets sockets;
+	for (std::uint16_t port : { 80, 443 }) {
+		for (std::size_t i = 0; i < (port == 80 ? 2 : 70); i++) {
+			const int socket = ::socket(AF_INET, SOCK_STREAM, 0);
+			ASSERT_NE(socket, -1);
+			sockets[port].push_back(socket);
+		}
+	}
+
+	ASSERT_TRUE(Handoff::SendSockets(channels[0], sockets));
+
+	Handoff::Sockets received;
+	ASSERT_TRUE(Handoff::ReceiveSockets(channels[1], received));
+	ASSERT_EQ(received.size(), 2);
+
+	for (const auto &[port, portSockets] : sockets) {
+		const auto &receivedSockets = received[port];
+		ASSERT_EQ(receivedSockets.size(), portSockets.size()) << port;
+		for (std::size_t i = 0; i < portSockets.size(); i++) {
+			EXPECT_NE(receivedSockets[i], portSockets[i]);
+			EXPECT_EQ(Inode(receivedSockets[i]), Inode(portSockets[i]));
+			close(receivedSockets[i]);
+			close(portSockets[i]);
+		}
+	}
+}
+
+TEST_F(HandoffTest, PassesNoSockets) {
+	ASSERT_TRUE(Handoff::SendSockets(channels[0], {}));
+	Handoff::Sockets received;
+	ASSERT_TRUE(Handoff::ReceiveSockets(channels[1], received));
+	EXPECT_TRUE(received.empty());
+}
+
+TEST_F(HandoffTest, FailsWhenThePeerIsGone) {
+	// Before the end of the handoff.
+	close(channels[0]);
+	channels[0] = -1;
+
+	Handoff::Sockets received;
+	EXPECT_FALSE(Handoff::ReceiveSockets(channels[1], received));
+	EXPECT_TRUE(received.empty());
+}
+
+TEST_F(HandoffTest, AwaitsReadiness) {
+	EXPECT_FALSE(Handoff::AwaitReady(channels[0], std::chrono::milliseconds(10)));
+
+	ASSERT_TRUE(Handoff::SignalReady(channels[1]));
+	EXPECT_TRUE(Handoff::AwaitReady(channels[0], std::chrono::milliseconds(1000)));
+
+	// The successor failed to start.
+	close(channels[1]);
+	channels[1] = -1;
+	EXPECT_FALSE(Handoff::AwaitReady(channels[0], std::chrono::milliseconds(1000)));
+}
+
+} // namespace HTTP
@@ -0,0 +1,124 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "http2/hpack.hpp"
+
+using namespace std::string_view_literals;
+
+namespace {
+
+[[nodiscard]] std::vector<std::string>
+Decode(HTTP2::HPACK::Decoder &decoder, std::string_view block) {
+	std::vector<std::string> fields;
+	const bool result = decoder.Decode(block, [&fields](HTTP2::HPACK::Field field) {
+		fields.push_back(std::string(field.name) + ": " + std::string(field.value));
+		return true;
+	});
+
+	if (!result) {
+		fields.emplace_back("FAILED");
+	}
+
+	return fields;
+}
+
+} // namespace
+
+TEST(HPACK, EncodesIntegers) {
+	// Spec: RFC 7541 § C.1
+	std::string output;
+	HTTP2::HPACK::EncodeInteger(output, 10, 5, 0);
+	ASSERT_EQ(output, "\x0A"sv);
+
+	output.clear();
+	HTTP2::HPACK::EncodeInteger(output, 1337, 5, 0);
+	ASSERT_EQ(output, "\x1F\x9A\x0A"sv);
+
+	output.clear();
+	HTTP2::HPACK::EncodeInteger(output, 42, 8, 0);
+	ASSERT_EQ(output, "\x2A"sv);
+}
+
+TEST(HPACK, DecodesRequestsWithoutHuffman) {
+	// Spec: RFC 7541 § C.3
+	HTTP2::HPACK::Decoder decoder;
+
+	ASSERT_EQ(Decode(decoder, "\x82\x86\x84\x41\x0f" "www.example.com"sv),
+			  (std::vector<std::string>{ ":method: GET", ":scheme: http", ":path: /", ":authority: www.example.com" }));
+	ASSERT_EQ(decoder.TableSize(), 57);
+
+	ASSERT_EQ(Decode(decoder, "\x82\x86\x84\xbe\x58\x08" "no-cache"sv),
+			  (std::vector<std::string>{ ":method: GET", ":scheme: http", ":path: /", ":authority: www.example.com",
+										 "cache-control: no-cache" }));
+	ASSERT_EQ(decoder.TableSize(), 110);
+
+	ASSERT_EQ(Decode(decoder, "\x82\x87\x85\xbf\x40\x0a" "custom-key\x0c" "custom-value"sv),
+			  (std::vector<std::string>{ ":method: GET", ":scheme: https", ":path: /index.html",
+										 ":authority: www.example.com", "custom-key: custom-value" }));
+	ASSERT_EQ(decoder.TableSize(), 164);
+}
+
+TEST(HPACK, DecodesRequestsWithHuffman) {
+	// Spec: RFC 7541 § C.4
+	HTTP2::HPACK::Decoder decoder;
+
+	ASSERT_EQ(Decode(decoder, "\x82\x86\x84\x41\x8c\xf1\xe3\xc2\xe5\xf2\x3a\x6b\xa0\xab\x90\xf4\xff"sv),
+			  (std::vector<std::string>{ ":method: GET", ":scheme: http", ":path: /", ":authority: www.example.com" }));
+	ASSERT_EQ(decoder.TableSize(), 57);
+
+	ASSERT_EQ(Decode(decoder, "\x82\x86\x84\xbe\x58\x86\xa8\xeb\x10\x64\x9c\xbf"sv),
+			  (std::vector<std::string>{ ":method: GET", ":scheme: http", ":path: /", ":authority: www.example.com",
+										 "cache-control: no-cache" }));
+	ASSERT_EQ(decoder.TableSize(), 110);
+
+	ASSERT_EQ(Decode(decoder, "\x82\x87\x85\xbf\x40\x88\x25\xa8\x49\xe9\x5b\xa9\x7d\x7f\x89\x25\xa8\x49\xe9\x5b\xb8\xe8\xb4\xbf"sv),
+			  (std::vector<std::string>{ ":method: GET", ":scheme: https", ":path: /index.html",
+										 ":authority: www.example.com", "custom-key: custom-value" }));
+	ASSERT_EQ(decoder.TableSize(), 164);
+}
+
+TEST(HPACK, RejectsMalformedBlocks) {
+	HTTP2::HPACK::Decoder decoder(256);
+
+	// Index zero, and an index past the tables.
+	ASSERT_EQ(Decode(decoder, "\x80"sv).back(), "FAILED");
+	ASSERT_EQ(Decode(decoder, "\xbe"sv).back(), "FAILED");
+
+	// A string longer than the block.
+	ASSERT_EQ(Decode(decoder, "\x04\x05" "ab"sv).back(), "FAILED");
+
+	// A table size update that isn't at the start, or larger than the maximum.
+	ASSERT_EQ(Decode(decoder, "\x82\x20"sv).back(), "FAILED");
+	ASSERT_EQ(Decode(decoder, "\x3f\xe2\x01"sv).back(), "FAILED");
+
+	// Huffman padding with a zero bit, and padding of a whole octet.
+	std::string output;
+	ASSERT_FALSE(HTTP2::HPACK::DecodeHuffman("\x1e"sv, output));
+	ASSERT_FALSE(HTTP2::HPACK::DecodeHuffman("\x1f\xff"sv, output));
+}
+
+TEST(HPACK, EncodesRepeatedFields) {
+	const HTTP2::HPACK::RepeatedFields fields("Server: webserver\r\nX-Custom: 1\r\n");
+	HTTP2::HPACK::Decoder decoder;
+
+	const std::vector<std::string> expected{ "server: webserver", "x-custom: 1" };
+	ASSERT_EQ(Decode(decoder, fields.indexing), expected);
+	ASSERT_EQ(decoder.TableSize(), fields.tableSize);
+	ASSERT_EQ(fields.indexed, "\xbf\xbe"sv);
+	ASSERT_EQ(Decode(decoder, fields.indexed), expected);
+	ASSERT_EQ(Decode(decoder, fields.literal), expected);
+
+	std::string status;
+	HTTP2::HPACK::EncodeStatus(status, "404");
+	HTTP2::HPACK::EncodeStatus(status, "429");
+	ASSERT_EQ(Decode(decoder, status), (std::vector<std::string>{ ":status: 404", ":status: 429" }));
+}
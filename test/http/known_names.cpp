@@ -0,0 +1,65 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include <string>
+
+#include <cctype>
+#include <cstddef>
+
+#include <gtest/gtest.h>
+
+#include "http/known_names.hpp"
+#include "http/request.hpp"
+
+namespace HTTP {
+
+	TEST(KnownNames, LookupHeaderID) {
+		for (std::size_t i = 1; i < KnownNames::headerNames.size(); i++) {
+			std::string name(KnownNames::headerNames[i]);
+			ASSERT_EQ(LookupHeaderID(name), static_cast<HeaderID>(i)) << name;
+
+			for (auto &character : name) {
+				character = static_cast<char>(std::toupper(static_cast<unsigned char>(character)));
+			}
+			ASSERT_EQ(LookupHeaderID(name), static_cast<HeaderID>(i)) << name;
+
+			name.back() ^= 0x01;
+			ASSERT_EQ(LookupHeaderID(name), HeaderID::UNKNOWN) << name;
+		}
+
+		ASSERT_EQ(LookupHeaderID(""), HeaderID::UNKNOWN);
+		ASSERT_EQ(LookupHeaderID("h`st"), HeaderID::UNKNOWN);
+	}
+
+	TEST(KnownNames, LookupMethodID) {
+		for (std::size_t i = 1; i < KnownNames::methodNames.size(); i++) {
+			ASSERT_EQ(LookupMethodID(KnownNames::methodNames[i]), static_cast<MethodID>(i));
+		}
+
+		ASSERT_EQ(LookupMethodID(""), MethodID::UNKNOWN);
+		ASSERT_EQ(LookupMethodID("Get"), MethodID::UNKNOWN);
+		ASSERT_EQ(LookupMethodID("UPDATEREDIRECTREF"), MethodID::UNKNOWN);
+	}
+
+	TEST(KnownNames, HeaderList) {
+		HeaderList list;
+		ASSERT_TRUE(list.Add({ "X-Custom", "1" }));
+		ASSERT_TRUE(list.Add({ "HOST", "a" }));
+		ASSERT_TRUE(list.Add({ "host", "b" }));
+
+		ASSERT_EQ(list.Count(HeaderID::HOST), 2);
+		ASSERT_EQ(list.Find(HeaderID::HOST)->value, "a");
+		ASSERT_EQ(list.Find("Host")->value, "a");
+		ASSERT_EQ(list.Find("x-custom")->value, "1");
+		ASSERT_EQ(list.Find(HeaderID::CONNECTION), nullptr);
+		ASSERT_EQ(list.Find(HeaderID::UNKNOWN), nullptr);
+
+		list.Clear();
+		ASSERT_EQ(list.Count(HeaderID::HOST), 0);
+		ASSERT_EQ(list.Find(HeaderID::HOST), nullptr);
+	}
+
+} // namespace HTTP
@@ -0,0 +1,88 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include <cstdint>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include "event/loop.hpp"
+
+namespace {
+
+struct CountingHandler : public Event::Handler {
+	std::size_t reads{ 0 };
+	std::size_t writes{ 0 };
+
+	void
+	OnEvent(std::uint32_t events) noexcept override {
+		if (events & Event::Interest::read) {
+			reads++;
+		}
+		if (events & Event::Interest::write) {
+			writes++;
+		}
+	}
+};
+
+} // namespace
+
+class EventLoopTest : public ::testing::Test {
+protected:
+	Event::Loop loop;
+	CountingHandler handler;
+	int sockets[2]{ -1, -1 };
+
+	void
+	SetUp() override {
+		ASSERT_TRUE(loop.Initialize());
+		ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, sockets), 0);
+	}
+
+	void
+	TearDown() override {
+		close(sockets[0]);
+		close(sockets[1]);
+	}
+};
+
+TEST_F(EventLoopTest, IsLevelTriggered) {
+	ASSERT_TRUE(loop.Add(sockets[0], &handler, Event::Interest::read));
+	ASSERT_TRUE(loop.RunOnce(0));
+	ASSERT_EQ(handler.reads, 0);
+
+	// The data isn't read, so the socket is reported again.
+	ASSERT_EQ(write(sockets[1], "x", 1), 1);
+	ASSERT_TRUE(loop.RunOnce(1000));
+	ASSERT_EQ(handler.reads, 1);
+	ASSERT_TRUE(loop.RunOnce(1000));
+	ASSERT_EQ(handler.reads, 2);
+
+	loop.Remove(sockets[0]);
+	ASSERT_TRUE(loop.RunOnce(0));
+	ASSERT_EQ(handler.reads, 2);
+}
+
+TEST_F(EventLoopTest, ChangesInterest) {
+	ASSERT_TRUE(loop.Add(sockets[0], &handler, Event::Interest::read));
+	ASSERT_TRUE(loop.Modify(sockets[0], &handler, Event::Interest::write));
+	ASSERT_TRUE(loop.RunOnce(1000));
+	ASSERT_EQ(handler.reads, 0);
+	ASSERT_EQ(handler.writes, 1);
+
+	ASSERT_TRUE(loop.Modify(sockets[0], &handler, Event::Interest::none));
+	ASSERT_TRUE(loop.RunOnce(0));
+	ASSERT_EQ(handler.writes, 1);
+	loop.Remove(sockets[0]);
+}
+
+TEST_F(EventLoopTest, RunsPostedFunctions) {
+	bool called = false;
+	loop.Post([&called] { called = true; });
+	ASSERT_TRUE(loop.RunOnce(1000));
+	ASSERT_TRUE(called);
+}
@@ -0,0 +1,38 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include <gtest/gtest.h>
+
+#include "base/media_type.hpp"
+
+TEST(MediaTypeFinder, DetectsByTheLastExtension) {
+	MediaTypeFinder finder;
+	EXPECT_EQ(finder.DetectMediaType("/var/www/index.html").ContentType(), "text/html;charset=utf-8");
+	EXPECT_EQ(finder.DetectMediaType("/var/www/jquery.min.js").ContentType(), "application/javascript;charset=utf-8");
+	EXPECT_EQ(finder.DetectMediaType("/var/www/font.woff2").ContentType(), "font/woff");
+	EXPECT_EQ(finder.DetectMediaType("/var/www/image.png").Complete(), "image/png");
+}
+
+TEST(MediaTypeFinder, FallsBackToOctetStream) {
+	MediaTypeFinder finder;
+	for (const auto *path : { "/var/www/archive.tar.gz", "/var/www.d/README", "/var/www/html.", "/var/www/.html2",
+							  "/var/www/HTML", "" }) {
+		EXPECT_EQ(finder.DetectMediaType(path).Complete(), "application/octet-stream") << path;
+	}
+}
+
+TEST(MediaType, SplitsTheContentType) {
+	constexpr MediaType type("image/svg+xml");
+	static_assert(type.Type() == "image");
+	static_assert(type.Subtype() == "svg+xml");
+	static_assert(!type.IncludeCharset());
+	static_assert(type.IsCompressible());
+
+	EXPECT_EQ(MediaTypes::HTML.Complete(), "text/html");
+	EXPECT_EQ(MediaTypes::HTML.Subtype(), "html");
+	EXPECT_TRUE(MediaTypes::HTML.IncludeCharset());
+	EXPECT_FALSE(MediaType("font/woff").IsCompressible());
+}
@@ -0,0 +1,101 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "base/media_type.hpp"
+#include "http/configuration.hpp"
+#include "http/metrics.hpp"
+#include "security/policies.hpp"
+#include "security/tls_configuration.hpp"
+
+namespace HTTP {
+
+namespace {
+
+[[nodiscard]] std::string
+Render(const Metrics &metrics) {
+	MediaTypeFinder finder;
+	Security::Policies policies;
+	Security::TLSConfiguration tlsConfiguration;
+	Configuration configuration(finder, policies, tlsConfiguration);
+
+	std::string output;
+	metrics.Render(output, configuration);
+	return output;
+}
+
+[[nodiscard]] bool
+Contains(const std::string &output, const std::string &line) {
+	return output.find(line + "\n") != std::string::npos;
+}
+
+} // namespace
+
+TEST(Metrics, RecordsDurationsInCumulativeBuckets) {
+	Metrics metrics;
+	metrics.Record(Stage::RESOLVE, std::chrono::nanoseconds(500));
+	metrics.Record(Stage::RESOLVE, std::chrono::microseconds(3));
+	metrics.Record(Stage::RESOLVE, std::chrono::microseconds(4));
+	metrics.Record(Stage::RESOLVE, std::chrono::seconds(60));
+
+	const auto output = Render(metrics);
+	EXPECT_TRUE(Contains(output, "# TYPE webserver_stage_duration_seconds histogram"));
+	EXPECT_TRUE(Contains(output, "webserver_stage_duration_seconds_bucket{stage=\"resolve\",le=\"1e-06\"} 1"));
+	EXPECT_TRUE(Contains(output, "webserver_stage_duration_seconds_bucket{stage=\"resolve\",le=\"2e-06\"} 1"));
+	EXPECT_TRUE(Contains(output, "webserver_stage_duration_seconds_bucket{stage=\"resolve\",le=\"4e-06\"} 3"));
+	EXPECT_TRUE(Contains(output, "webserver_stage_duration_seconds_bucket{stage=\"resolve\",le=\"+Inf\"} 4"));
+	EXPECT_TRUE(Contains(output, "webserver_stage_duration_seconds_sum{stage=\"resolve\"} 60.000007500"));
+	EXPECT_TRUE(Contains(output, "webserver_stage_duration_seconds_count{stage=\"resolve\"} 4"));
+	EXPECT_TRUE(Contains(output, "webserver_stage_duration_seconds_count{stage=\"accept\"} 0"));
+}
+
+TEST(Metrics, SumsTheCountersOfAllThreads) {
+	Metrics metrics;
+
+	std::vector<std::thread> threads;
+	for (int thread = 0; thread < 4; thread++) {
+		threads.emplace_back([&metrics] {
+			for (int i = 0; i < 1000; i++) {
+				metrics.Count(ClientError::FILE_NOT_FOUND);
+				metrics.CountFileCacheLookup(i % 4 != 0);
+			}
+		});
+	}
+	for (auto &thread : threads) {
+		thread.join();
+	}
+
+	// The counters of the threads that have exited are kept.
+	const auto output = Render(metrics);
+	EXPECT_TRUE(Contains(output, "webserver_client_errors_total{error=\"FILE_NOT_FOUND\"} 4000"));
+	EXPECT_TRUE(Contains(output, "webserver_client_errors_total{error=\"EMPTY_METHOD\"} 0"));
+	EXPECT_EQ(output.find("NO_ERROR"), std::string::npos);
+	EXPECT_TRUE(Contains(output, "webserver_file_cache_lookups_total{result=\"hit\"} 3000"));
+	EXPECT_TRUE(Contains(output, "webserver_file_cache_lookups_total{result=\"miss\"} 1000"));
+	EXPECT_TRUE(Contains(output, "webserver_compression_cache_lookups_total{result=\"hit\"} 0"));
+}
+
+TEST(Metrics, KeepsInstancesApart) {
+	Metrics first;
+	first.CountCompressionCacheLookup(true);
+	{
+		Metrics second;
+		second.CountCompressionCacheLookup(false);
+		EXPECT_TRUE(Contains(Render(second), "webserver_compression_cache_lookups_total{result=\"hit\"} 0"));
+	}
+
+	Metrics third;
+	EXPECT_TRUE(Contains(Render(third), "webserver_compression_cache_lookups_total{result=\"miss\"} 0"));
+	EXPECT_TRUE(Contains(Render(first), "webserver_compression_cache_lookups_total{result=\"hit\"} 1"));
+}
+
+} // namespace HTTP
@@ -0,0 +1,86 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "base/mpmc_queue.hpp"
+
+TEST(MPMCQueue, RoundsTheCapacityUp) {
+	EXPECT_EQ(base::MPMCQueue<int>(0).Capacity(), 2);
+	EXPECT_EQ(base::MPMCQueue<int>(2).Capacity(), 2);
+	EXPECT_EQ(base::MPMCQueue<int>(5).Capacity(), 8);
+}
+
+TEST(MPMCQueue, KeepsTheOrder) {
+	base::MPMCQueue<std::unique_ptr<int>> queue(4);
+
+	std::unique_ptr<int> value;
+	ASSERT_FALSE(queue.TryPop(value));
+
+	for (int lap = 0; lap < 3; lap++) {
+		for (int i = 0; i < 4; i++) {
+			value = std::make_unique<int>(i);
+			ASSERT_TRUE(queue.TryPush(value));
+			ASSERT_EQ(value, nullptr);
+		}
+		EXPECT_EQ(queue.ApproximateSize(), 4);
+
+		value = std::make_unique<int>(4);
+		ASSERT_FALSE(queue.TryPush(value));
+		ASSERT_NE(value, nullptr);
+
+		for (int i = 0; i < 4; i++) {
+			ASSERT_TRUE(queue.TryPop(value));
+			ASSERT_EQ(*value, i);
+		}
+		ASSERT_FALSE(queue.TryPop(value));
+		EXPECT_EQ(queue.ApproximateSize(), 0);
+	}
+}
+
+TEST(MPMCQueue, PassesEveryValueOnce) {
+	constexpr int threadCount = 4;
+	constexpr int valueCount = 10000;
+
+	base::MPMCQueue<int> queue(64);
+	std::atomic<long> sum{ 0 };
+	std::atomic<int> popped{ 0 };
+
+	std::vector<std::thread> threads;
+	for (int t = 0; t < threadCount; t++) {
+		threads.emplace_back([&, t] {
+			for (int i = t; i < valueCount; i += threadCount) {
+				int value = i;
+				while (!queue.TryPush(value)) {
+					std::this_thread::yield();
+				}
+			}
+		});
+		threads.emplace_back([&] {
+			int value;
+			while (popped.load() < valueCount) {
+				if (queue.TryPop(value)) {
+					sum += value;
+					++popped;
+				} else {
+					std::this_thread::yield();
+				}
+			}
+		});
+	}
+
+	for (auto &thread : threads) {
+		thread.join();
+	}
+
+	EXPECT_EQ(popped.load(), valueCount);
+	EXPECT_EQ(sum.load(), static_cast<long>(valueCount) * (valueCount - 1) / 2);
+}
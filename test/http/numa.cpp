@@ -0,0 +1,57 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "base/numa.hpp"
+
+TEST(Numa, ParseCPUList) {
+	std::vector<int> cpus;
+	ASSERT_TRUE(base::ParseCPUList("0-3,8,10-11\n", cpus));
+	EXPECT_EQ(cpus, (std::vector<int>{ 0, 1, 2, 3, 8, 10, 11 }));
+
+	cpus.clear();
+	ASSERT_TRUE(base::ParseCPUList("\n", cpus));
+	EXPECT_TRUE(cpus.empty());
+
+	for (const char *list : { "a", "1-", "3-1", "1,", ",1", "1;2", "-1" }) {
+		EXPECT_FALSE(base::ParseCPUList(list, cpus)) << list;
+	}
+}
+
+TEST(Numa, Detect) {
+	const auto topology = base::NumaTopology::Detect();
+	ASSERT_FALSE(topology.nodes.empty());
+	for (const auto &cpus : topology.nodes) {
+		EXPECT_FALSE(cpus.empty());
+	}
+}
+
+TEST(Numa, Place) {
+	base::NumaTopology topology;
+	EXPECT_TRUE(topology.Place(4).empty());
+
+	topology.nodes = { { 0, 1 }, { 2, 3, 4 } };
+	const auto placements = topology.Place(7);
+	ASSERT_EQ(placements.size(), 7);
+
+	const std::vector<std::pair<std::size_t, int>> expected{ { 0, 0 }, { 1, 2 }, { 0, 1 }, { 1, 3 },
+															  { 0, 0 }, { 1, 4 }, { 0, 1 } };
+	for (std::size_t i = 0; i < placements.size(); i++) {
+		EXPECT_EQ(placements[i].node, expected[i].first) << i;
+		EXPECT_EQ(placements[i].cpu, expected[i].second) << i;
+	}
+}
+
+TEST(Numa, CurrentNode) {
+	EXPECT_EQ(base::CurrentNumaNode(), 0);
+	base::SetCurrentNumaNode(3);
+	EXPECT_EQ(base::CurrentNumaNode(), 3);
+	base::SetCurrentNumaNode(0);
+}
@@ -0,0 +1,221 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include <array>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include <cstdio>
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include "base/media_type.hpp"
+#include "cgi/exchange.hpp"
+#include "cgi/manager.hpp"
+#include "cgi/proxy.hpp"
+#include "http/body_reader.hpp"
+#include "http/configuration.hpp"
+#include "security/policies.hpp"
+#include "security/tls_configuration.hpp"
+
+using namespace std::string_view_literals;
+
+namespace {
+
+// Feeds [input] to a decoder an octet at a time, which shouldn't matter.
+[[nodiscard]] std::string
+DecodeSplit(std::string_view input, bool headRequest = false) {
+	CGI::ProxyDecoder decoder(headRequest);
+	std::string output;
+	auto status = CGI::ProxyDecoder::Status::INCOMPLETE;
+	for (char character : input) {
+		status = decoder.Feed(std::string_view(&character, 1), output);
+		if (status == CGI::ProxyDecoder::Status::FAILED) {
+			return "FAILED";
+		}
+	}
+
+	if (status != CGI::ProxyDecoder::Status::COMPLETE && decoder.Finish() != CGI::ProxyDecoder::Status::COMPLETE) {
+		return "FAILED";
+	}
+	return output;
+}
+
+} // namespace
+
+TEST(ProxyDecoder, DecodesLengthDelimitedBodies) {
+	CGI::ProxyDecoder decoder(false);
+	std::string output;
+	ASSERT_EQ(decoder.Feed("HTTP/1.1 200 OK\r\nContent-Length: 5\r\nServer: x\r\nKeep-Alive: 5\r\n\r\nhel", output),
+			  CGI::ProxyDecoder::Status::INCOMPLETE);
+	ASSERT_EQ(decoder.Feed("lo", output), CGI::ProxyDecoder::Status::COMPLETE);
+
+	EXPECT_EQ(output, "Status: 200 OK\r\nServer: x\r\nContent-Length: 5\r\n\r\nhello");
+	EXPECT_TRUE(decoder.KeepAlive());
+}
+
+TEST(ProxyDecoder, DecodesChunkedBodies) {
+	const auto output = DecodeSplit("HTTP/1.1 100 Continue\r\n\r\n"
+									"HTTP/1.1 404 Not Found\r\nTransfer-Encoding: chunked\r\n\r\n"
+									"5;name=value\r\nhello\r\n1\r\n!\r\n0\r\nTrailer: x\r\n\r\n");
+	EXPECT_EQ(output, "Status: 404 Not Found\r\n\r\nhello!");
+}
+
+TEST(ProxyDecoder, DecodesCloseDelimitedBodies) {
+	CGI::ProxyDecoder decoder(false);
+	std::string output;
+	ASSERT_EQ(decoder.Feed("HTTP/1.0 200 OK\n\nbody", output), CGI::ProxyDecoder::Status::INCOMPLETE);
+	ASSERT_EQ(decoder.Finish(), CGI::ProxyDecoder::Status::COMPLETE);
+	EXPECT_EQ(output, "Status: 200 OK\r\n\r\nbody");
+	EXPECT_FALSE(decoder.KeepAlive());
+}
+
+TEST(ProxyDecoder, LeavesOutBodiesOfHeadRequests) {
+	CGI::ProxyDecoder decoder(true);
+	std::string output;
+	ASSERT_EQ(decoder.Feed("HTTP/1.1 200 OK\r\nContent-Length: 10\r\nConnection: close\r\n\r\n", output),
+			  CGI::ProxyDecoder::Status::COMPLETE);
+	EXPECT_EQ(output, "Status: 200 OK\r\nContent-Length: 10\r\n\r\n");
+	EXPECT_FALSE(decoder.KeepAlive());
+}
+
+TEST(ProxyDecoder, RejectsMalformedResponses) {
+	for (const auto input : { "HTTP/2 200 OK\r\n\r\n"sv, "HTTP/1.1 20 OK\r\n\r\n"sv,
+							  "HTTP/1.1 200 OK\r\nContent-Length: 1\r\nContent-Length: 2\r\n\r\n"sv,
+							  "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\nz\r\n"sv,
+							  "HTTP/1.1 200 OK\r\nContent-Length: 5\r\n\r\nabc"sv }) {
+		EXPECT_EQ(DecodeSplit(input), "FAILED") << input;
+	}
+}
+
+TEST(ProxyRequest, LeavesOutHopByHopFields) {
+	MediaTypeFinder finder;
+	Security::Policies policies;
+	Security::TLSConfiguration tlsConfiguration;
+	HTTP::Configuration configuration(finder, policies, tlsConfiguration);
+	configuration.hostname = "example.com";
+
+	HTTP::Request request;
+	request.SetMethod("GET");
+	request.path = "/app";
+	request.query = "a=b";
+	ASSERT_TRUE(request.headers.Add({ "Accept", "*/*" }));
+	ASSERT_TRUE(request.headers.Add({ "Connection", "keep-alive, X-Option" }));
+	ASSERT_TRUE(request.headers.Add({ "X-Forwarded-For", "192.0.2.1" }));
+	ASSERT_TRUE(request.headers.Add({ "Keep-Alive", "timeout=5" }));
+	ASSERT_TRUE(request.headers.Add({ "TE", "trailers" }));
+	ASSERT_TRUE(request.headers.Add({ "Upgrade", "h2c" }));
+	ASSERT_TRUE(request.headers.Add({ "x-option", "1" }));
+	ASSERT_TRUE(request.headers.Add({ "X-Other", "2" }));
+
+	EXPECT_EQ(CGI::CreateUpstreamRequest(request, configuration, "127.0.0.1", HTTP::BodyReader{}),
+			  "GET /app?a=b HTTP/1.1\r\n"
+			  "Accept: */*\r\n"
+			  "X-Other: 2\r\n"
+			  "Host: example.com\r\n"
+			  "X-Forwarded-For: 192.0.2.1, 127.0.0.1\r\n"
+			  "X-Forwarded-Proto: http\r\n"
+			  "\r\n");
+}
+
+TEST(ProxyRequest, KeepsTheFramingOfTheBody) {
+	MediaTypeFinder finder;
+	Security::Policies policies;
+	Security::TLSConfiguration tlsConfiguration;
+	HTTP::Configuration configuration(finder, policies, tlsConfiguration);
+
+	HTTP::Request request;
+	request.SetMethod("POST");
+	request.path = "/app";
+	request.versionMinor = 1;
+	ASSERT_TRUE(request.headers.Add({ "Host", "example.com" }));
+	ASSERT_TRUE(request.headers.Add({ "Expect", "100-continue" }));
+	ASSERT_TRUE(request.headers.Add({ "Transfer-Encoding", "chunked" }));
+
+	HTTP::BodyReader body;
+	ASSERT_EQ(body.Start(request, 0), HTTP::ClientError::NO_ERROR);
+	EXPECT_EQ(CGI::CreateUpstreamRequest(request, configuration, {}, body),
+			  "POST /app HTTP/1.1\r\n"
+			  "Host: example.com\r\n"
+			  "X-Forwarded-Proto: http\r\n"
+			  "Transfer-Encoding: chunked\r\n"
+			  "\r\n");
+}
+
+TEST(ProxyManager, PoolsConnectionsAndSkipsDownUpstreams) {
+	const int listener = socket(AF_INET, SOCK_STREAM, 0);
+	struct sockaddr_in address{};
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	ASSERT_EQ(bind(listener, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)), 0);
+	ASSERT_EQ(listen(listener, 4), 0);
+
+	socklen_t length = sizeof(address);
+	ASSERT_EQ(getsockname(listener, reinterpret_cast<struct sockaddr *>(&address), &length), 0);
+	const auto port = std::to_string(ntohs(address.sin_port));
+
+	// Answers three requests, on a single connection.
+	std::thread server([listener] {
+		const int fd = accept(listener, nullptr, nullptr);
+		std::string input;
+		std::array<char, 4096> buffer{};
+		for (int i = 0; i < 3; i++) {
+			while (input.find("\r\n\r\n") == std::string::npos) {
+				const auto result = read(fd, buffer.data(), buffer.size());
+				if (result <= 0) {
+					close(fd);
+					return;
+				}
+				input.append(buffer.data(), static_cast<std::size_t>(result));
+			}
+			input.erase(0, input.find("\r\n\r\n") + 4);
+
+			const std::string_view response("HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nok");
+			static_cast<void>(write(fd, response.data(), response.length()));
+		}
+		close(fd);
+	});
+
+	CGI::Manager manager;
+	CGI::Script script;
+	script.Name = "Test";
+	script.Type = CGI::Protocol::HTTP;
+
+	// Port 1 of the loopback address refuses connections.
+	script.Addresses = { "127.0.0.1:1", "127.0.0.1:" + port };
+	ASSERT_TRUE(manager.Register("/app", script));
+
+	HTTP::Request request;
+	request.path = "/app";
+	const auto *registered = manager.Lookup(request);
+
+	for (int i = 0; i < 3; i++) {
+		std::unique_ptr<CGI::Exchange> exchange;
+		ASSERT_EQ(manager.Forward(*registered, "GET /app HTTP/1.1\r\nHost: a\r\n\r\n", false, HTTP::BodyFraming::NONE, exchange),
+				  CGI::Manager::StartStatus::STARTED);
+
+		std::string output;
+		auto status = CGI::Exchange::Status::DATA;
+		while (status != CGI::Exchange::Status::END && status != CGI::Exchange::Status::FAILED) {
+			status = exchange->Read(output);
+			if (status == CGI::Exchange::Status::WOULD_BLOCK) {
+				ASSERT_TRUE(exchange->Wait());
+			}
+		}
+
+		EXPECT_EQ(status, CGI::Exchange::Status::END);
+		EXPECT_EQ(output, "Status: 200 OK\r\nContent-Length: 2\r\n\r\nok");
+	}
+
+	server.join();
+	close(listener);
+}
@@ -0,0 +1,62 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include <gtest/gtest.h>
+
+#include "http/range.hpp"
+
+namespace HTTP {
+
+TEST(Range, Satisfiable) {
+	ByteRange range{};
+
+	ASSERT_EQ(ParseRange("bytes=0-499", 1000, range), RangeStatus::SATISFIABLE);
+	ASSERT_EQ(range.first, 0);
+	ASSERT_EQ(range.last, 499);
+	ASSERT_EQ(range.Length(), 500);
+
+	ASSERT_EQ(ParseRange("bytes=500-", 1000, range), RangeStatus::SATISFIABLE);
+	ASSERT_EQ(range.first, 500);
+	ASSERT_EQ(range.last, 999);
+
+	ASSERT_EQ(ParseRange("Bytes=900-5000", 1000, range), RangeStatus::SATISFIABLE);
+	ASSERT_EQ(range.first, 900);
+	ASSERT_EQ(range.last, 999);
+
+	ASSERT_EQ(ParseRange("bytes=-100", 1000, range), RangeStatus::SATISFIABLE);
+	ASSERT_EQ(range.first, 900);
+	ASSERT_EQ(range.last, 999);
+
+	ASSERT_EQ(ParseRange("bytes=-5000", 1000, range), RangeStatus::SATISFIABLE);
+	ASSERT_EQ(range.first, 0);
+	ASSERT_EQ(range.last, 999);
+
+	ASSERT_EQ(ParseRange("bytes=10-99999999999999999999999", 1000, range), RangeStatus::SATISFIABLE);
+	ASSERT_EQ(range.last, 999);
+}
+
+TEST(Range, Unsatisfiable) {
+	ByteRange range{};
+
+	ASSERT_EQ(ParseRange("bytes=1000-", 1000, range), RangeStatus::UNSATISFIABLE);
+	ASSERT_EQ(ParseRange("bytes=99999999999999999999999-", 1000, range), RangeStatus::UNSATISFIABLE);
+	ASSERT_EQ(ParseRange("bytes=-0", 1000, range), RangeStatus::UNSATISFIABLE);
+	ASSERT_EQ(ParseRange("bytes=0-", 0, range), RangeStatus::UNSATISFIABLE);
+	ASSERT_EQ(ParseRange("bytes=-10", 0, range), RangeStatus::UNSATISFIABLE);
+}
+
+TEST(Range, Ignored) {
+	ByteRange range{};
+
+	for (const char *value : {
+			"", "bytes", "bytes=", "bytes=-", "items=0-1", "bytes=a-b", "bytes=5-1",
+			"bytes=0-1,5-6", "bytes=0-1 ", "bytes= 0-1", "bytes=--1", "bytes=1",
+		}) {
+		ASSERT_EQ(ParseRange(value, 1000, range), RangeStatus::IGNORED) << value;
+	}
+}
+
+} // namespace HTTP
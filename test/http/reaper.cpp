@@ -0,0 +1,72 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include <chrono>
+#include <thread>
+
+#include <cerrno>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include "connection/reaper.hpp"
+
+using namespace std::chrono_literals;
+
+class ConnectionReaperTest : public ::testing::Test {
+protected:
+	ConnectionReaper reaper;
+	int sockets[2]{ -1, -1 };
+
+	void
+	SetUp() override {
+		ASSERT_TRUE(reaper.Start());
+		ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, sockets), 0);
+		ASSERT_EQ(shutdown(sockets[0], SHUT_WR), 0);
+	}
+
+	void
+	TearDown() override {
+		close(sockets[1]);
+	}
+
+	[[nodiscard]] bool
+	WaitUntilReaped() const noexcept {
+		for (int i = 0; i < 200 && reaper.Count() != 0; i++) {
+			std::this_thread::sleep_for(10ms);
+		}
+		return reaper.Count() == 0;
+	}
+
+	// Whether the adopted socket has been closed, i.e. the peer can't write
+	// anymore.
+	[[nodiscard]] bool
+	IsClosed() const noexcept {
+		return send(sockets[1], "x", 1, MSG_NOSIGNAL) == -1 && errno == EPIPE;
+	}
+};
+
+TEST_F(ConnectionReaperTest, ClosesWhenPeerCloses) {
+	reaper.Adopt(sockets[0], 10s);
+	ASSERT_EQ(reaper.Count(), 1);
+
+	// What the peer sends is discarded, and the socket stays open.
+	ASSERT_EQ(send(sockets[1], "request", 7, MSG_NOSIGNAL), 7);
+	std::this_thread::sleep_for(50ms);
+	ASSERT_EQ(reaper.Count(), 1);
+
+	// The FIN of the peer is seen as the end of the connection.
+	ASSERT_EQ(shutdown(sockets[1], SHUT_WR), 0);
+	ASSERT_TRUE(WaitUntilReaped());
+	ASSERT_TRUE(IsClosed());
+}
+
+TEST_F(ConnectionReaperTest, ClosesAfterDeadline) {
+	reaper.Adopt(sockets[0], 100ms);
+	ASSERT_TRUE(WaitUntilReaped());
+	ASSERT_TRUE(IsClosed());
+}
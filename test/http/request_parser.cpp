@@ -0,0 +1,258 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#define CONNECTION_MEMORY_VARIANT
+
+#include <algorithm>
+#include <cctype>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <gtest/gtest.h>
+
+#define TESTING_VISIBILITY public
+
+#include "base/media_type.hpp"
+#include "cgi/manager.hpp"
+#include "connection/connection.hpp"
+#include "connection/memory_userdata.hpp"
+#include "http/client.hpp"
+#include "http/client_error.hpp"
+#include "http/configuration.hpp"
+#include "http/request.hpp"
+#include "http/request_parser.hpp"
+#include "http/server.hpp"
+#include "security/policies.hpp"
+#include "security/tls_configuration.hpp"
+
+// The views of HTTP::Request don't outlive the parser, so the results are
+// copied. Header names are compared case-insensitively.
+struct ParseResult {
+	HTTP::ClientError error;
+	std::size_t consumed;
+	std::string method;
+	std::string path;
+	std::uint8_t versionMinor;
+	std::vector<std::pair<std::string, std::string>> headers;
+
+	void
+	Store(const HTTP::Request &request) {
+		method = request.method;
+		path = request.path;
+		versionMinor = request.versionMinor;
+		headers.clear();
+		for (const auto &header : request.headers) {
+			std::string name(header.name);
+			std::transform(std::begin(name), std::end(name), std::begin(name),
+						   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+			headers.emplace_back(std::move(name), std::string(header.value));
+		}
+	}
+};
+
+static constexpr std::size_t maxHeadLength = 8192;
+
+class RequestParserTest : public ::testing::Test {
+protected:
+	CGI::Manager cgiManager;
+	MediaTypeFinder finder;
+	Security::Policies policies;
+	Security::TLSConfiguration tlsConfig;
+
+	// Parses [input] with the consumers of HTTP::Client.
+	ParseResult
+	ParseLegacy(const std::string &input) {
+		HTTP::Server server(HTTP::Configuration(finder, policies, tlsConfig), cgiManager);
+		HTTP::Client client(&server);
+		MemoryUserData internalData{};
+		internalData.input.assign(std::crbegin(input), std::crend(input));
+		client.connection = std::make_unique<Connection>(&internalData);
+
+		auto error = HTTP::ClientError::NO_ERROR;
+		for (auto function : { &HTTP::Client::ConsumeMethod, &HTTP::Client::ConsumePath,
+							   &HTTP::Client::ConsumeVersion, &HTTP::Client::ConsumeCRLF,
+							   &HTTP::Client::ConsumeHeaders }) {
+			error = (client.*function)();
+			if (error != HTTP::ClientError::NO_ERROR) {
+				break;
+			}
+		}
+
+		const auto remaining = internalData.input.size() + client.connection->Buffered().length();
+		ParseResult result{ error, input.length() - remaining, {}, {}, 0, {} };
+		result.Store(client.currentRequest);
+		return result;
+	}
+
+	// Parses [input] with the RequestParser, fed in chunks of [chunkSize].
+	ParseResult
+	Parse(const std::string &input, std::size_t chunkSize) {
+		ParseResult result{ HTTP::ClientError::NO_ERROR, 0, {}, {}, 0, {} };
+		HTTP::Request request{};
+		HTTP::RequestParser parser(policies, request, maxHeadLength);
+
+		std::size_t fed = 0;
+		auto status = HTTP::RequestParser::Status::INCOMPLETE;
+		while (fed < input.length() && status == HTTP::RequestParser::Status::INCOMPLETE) {
+			fed = std::min(input.length(), fed + chunkSize);
+			status = parser.Feed({ input.data(), fed });
+		}
+
+		result.error = status == HTTP::RequestParser::Status::INCOMPLETE
+			? parser.EndOfStream() : parser.Error();
+		result.consumed = parser.HeadLength();
+		result.Store(request);
+		return result;
+	}
+
+	void
+	ExpectSameAsLegacy(const std::string &input) {
+		const auto expected = ParseLegacy(input);
+
+		for (std::size_t chunkSize : { 1, 2, 3, 7, 16, 33, 64 }) {
+			const auto result = Parse(input, chunkSize);
+			ASSERT_EQ(result.error, expected.error)
+				<< ClientErrorToString(result.error) << " should be " << ClientErrorToString(expected.error)
+				<< "\nInput: \"" << input << "\" chunk size " << chunkSize;
+			ASSERT_EQ(result.consumed, expected.consumed) << "Input: \"" << input << "\" chunk size " << chunkSize;
+
+			if (expected.error == HTTP::ClientError::NO_ERROR) {
+				ASSERT_EQ(result.method, expected.method);
+				ASSERT_EQ(result.path, expected.path);
+				ASSERT_EQ(result.versionMinor, expected.versionMinor);
+				ASSERT_EQ(result.headers, expected.headers) << "Input: \"" << input << '"';
+			}
+		}
+	}
+};
+
+static const std::vector<std::string> requests = {
+	"GET / HTTP/1.1\r\nHost: localhost\r\n\r\n",
+	"GET /index.html?query=1 HTTP/1.0\r\nHost: localhost:8080\r\nAccept: text/html, */*\r\n\r\n",
+	"UPDATEREDIRECTREF /a/very/long/request/target/that/spans/multiple/vectors HTTP/1.1\r\n"
+		"User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:78.0) Gecko/20100101 Firefox/78.0\r\n"
+		"Accept-Language: en-US,en;q=0.5\r\n"
+		"X-Obs-Text: \x80\xFF\xC3\xA9\r\n"
+		"Connection:keep-alive\r\n\r\n",
+	"GET / HTTP/1.1\r\nHost:    \t  spaced\r\n\r\n",
+	"GET / HTTP/1.1\r\nHost:\r\n\r\n",
+	"GET / HTTP/1.1\r\n:colon\r\n\r\n",
+	" / HTTP/1.1\r\n\r\n",
+	"G(T / HTTP/1.1\r\n\r\n",
+	"GET /\x01 HTTP/1.1\r\n\r\n",
+	"GET / HTTP/2.0\r\n\r\n",
+	"GET / HTTP/1.x\r\n\r\n",
+	"GET / HTTQ/1.1\r\n\r\n",
+	"GET / HTTP/1.1\n\r\n",
+	"GET / HTTP/1.1\r\nHost\x01: x\r\n\r\n",
+	"GET / HTTP/1.1\r\nHost: x\ry\r\n\r\n",
+	"GET / HTTP/1.1\r\nHost: x\x7F\r\n\r\n",
+	"GET / HTTP/1.1\r\n\rx",
+	"GET / HTTP/1.1\r\nHost: localhost\r\n\r\nGET / HTTP/1.1\r\n\r\n",
+	"GET / HTTP/1.1\r\nHost: localhost\r\n",
+	"GET / HTTP/1.1\r\nHost: localhost\r",
+	"GET / HTTP/1.1\r\nHost:   ",
+	"GET / HTTP/1.1\r\nHo",
+	"GET / HTTP/1.1\r",
+	"GET / HTT",
+	"GET /ind",
+	"GE",
+	"",
+};
+
+TEST_F(RequestParserTest, SameAsLegacy) {
+	for (const auto &request : requests) {
+		ExpectSameAsLegacy(request);
+	}
+}
+
+TEST_F(RequestParserTest, SameAsLegacyWithPolicies) {
+	for (std::size_t max : { 1, 2, 3, 5, 17, 33 }) {
+		policies.maxHeaderFieldNameLength = max;
+		policies.maxHeaderFieldValueLength = max;
+		policies.maxMethodLength = max;
+		policies.maxRequestTargetLength = max;
+		policies.maxWhiteSpacesInHeaderField = max;
+
+		for (const auto &request : requests) {
+			ExpectSameAsLegacy(request);
+		}
+	}
+}
+
+TEST_F(RequestParserTest, SameAsLegacyMutated) {
+	std::mt19937 randomGenerator{ 20200 };
+	std::uniform_int_distribution<int> octet(0, 255);
+
+	for (std::size_t i = 0; i < 2000; i++) {
+		std::string input = requests[i % 3];
+		std::uniform_int_distribution<std::size_t> position(0, input.length() - 1);
+
+		for (std::size_t mutations = i % 4 + 1; mutations != 0; mutations--) {
+			input[position(randomGenerator)] = static_cast<char>(octet(randomGenerator));
+		}
+
+		ExpectSameAsLegacy(input);
+	}
+}
+
+TEST_F(RequestParserTest, StopsAfterHead) {
+	const std::string input("GET / HTTP/1.1\r\n\r\nGET /next HTTP/1.1\r\n\r\n");
+	HTTP::Request request{};
+	HTTP::RequestParser parser(policies, request, maxHeadLength);
+
+	ASSERT_EQ(parser.Feed({ input.data(), input.length() }), HTTP::RequestParser::Status::COMPLETE);
+	ASSERT_EQ(parser.HeadLength(), 18);
+	ASSERT_EQ(parser.Feed({ input.data(), input.length() }), HTTP::RequestParser::Status::COMPLETE);
+	ASSERT_EQ(parser.HeadLength(), 18);
+
+	request.Reset();
+	parser.Reset();
+	ASSERT_EQ(parser.Feed({ input.data() + 18, input.length() - 18 }), HTTP::RequestParser::Status::COMPLETE);
+	ASSERT_EQ(parser.HeadLength(), input.length() - 18);
+	ASSERT_EQ(request.path, "/next");
+}
+
+TEST_F(RequestParserTest, TrimsFieldValue) {
+	const std::string input("GET / HTTP/1.1\r\nUser-Agent:  a b \t \r\n\r\n");
+	HTTP::Request request{};
+	HTTP::RequestParser parser(policies, request, maxHeadLength);
+
+	ASSERT_EQ(parser.Feed({ input.data(), input.length() }), HTTP::RequestParser::Status::COMPLETE);
+	const auto *header = request.headers.Find("user-agent");
+	ASSERT_NE(header, nullptr);
+	ASSERT_EQ(header->name, "User-Agent");
+	ASSERT_EQ(header->value, "a b");
+}
+
+TEST_F(RequestParserTest, TooManyHeaders) {
+	policies.maxHeaderCount = 2;
+	const std::string input("GET / HTTP/1.1\r\nA: 1\r\nB: 2\r\nC: 3\r\n\r\n");
+	HTTP::Request request{};
+	HTTP::RequestParser parser(policies, request, maxHeadLength);
+
+	ASSERT_EQ(parser.Feed({ input.data(), input.length() }), HTTP::RequestParser::Status::FAILED);
+	ASSERT_EQ(parser.Error(), HTTP::ClientError::POLICY_TOO_MANY_HEADERS);
+	ASSERT_EQ(ParseLegacy(input).error, HTTP::ClientError::POLICY_TOO_MANY_HEADERS);
+}
+
+TEST_F(RequestParserTest, HeadTooLarge) {
+	const std::string input("GET / HTTP/1.1\r\nHost: localhost\r\n\r\n");
+	HTTP::Request request{};
+	HTTP::RequestParser parser(policies, request, 20);
+
+	ASSERT_EQ(parser.Feed({ input.data(), input.length() }), HTTP::RequestParser::Status::FAILED);
+	ASSERT_EQ(parser.Error(), HTTP::ClientError::REQUEST_HEAD_TOO_LARGE);
+}
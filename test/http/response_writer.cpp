@@ -0,0 +1,77 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#define CONNECTION_MEMORY_VARIANT
+
+#include <string>
+#include <string_view>
+
+#include <gtest/gtest.h>
+
+#include "connection/connection.hpp"
+#include "connection/memory_userdata.hpp"
+#include "http/response_writer.hpp"
+
+namespace HTTP {
+
+class ResponseWriterTest : public ::testing::Test {
+protected:
+	MemoryUserData internalData{};
+	Connection connection{ &internalData };
+	ResponseWriter writer;
+
+	const std::string_view metadata{ "HTTP/1.1 200 OK\r\n\r\n" };
+
+	[[nodiscard]] std::string
+	Output() {
+		std::string output(internalData.output.data(), internalData.output.size());
+		internalData.output.clear();
+		return output;
+	}
+};
+
+TEST_F(ResponseWriterTest, HoldsBackTheMetadata) {
+	writer.Begin(connection, base::String(metadata.data(), metadata.length()), true);
+	EXPECT_TRUE(writer.InProgress());
+	EXPECT_EQ(Output(), "");
+
+	ASSERT_TRUE(writer.Write("hello"));
+	EXPECT_EQ(Output(), std::string(metadata) + "5\r\nhello\r\n");
+
+	// An empty part doesn't end the body.
+	ASSERT_TRUE(writer.Write({}));
+	EXPECT_EQ(Output(), "");
+}
+
+TEST_F(ResponseWriterTest, FlushesTheMetadata) {
+	writer.Begin(connection, base::String(metadata.data(), metadata.length()), true);
+	ASSERT_EQ(writer.Flush(), Connection::Status::COMPLETE);
+	EXPECT_EQ(Output(), metadata);
+
+	ASSERT_TRUE(writer.Write(std::string(300, 'x')));
+	EXPECT_EQ(Output(), "12c\r\n" + std::string(300, 'x') + "\r\n");
+}
+
+TEST_F(ResponseWriterTest, EndsChunkedBodies) {
+	writer.Begin(connection, base::String(metadata.data(), metadata.length()), true);
+	ASSERT_TRUE(writer.End());
+	EXPECT_FALSE(writer.InProgress());
+	EXPECT_EQ(Output(), std::string(metadata) + "0\r\n\r\n");
+
+	writer.Begin(connection, base::String(metadata.data(), metadata.length()), true);
+	ASSERT_TRUE(writer.Write("hello"));
+	ASSERT_TRUE(writer.End(" world"));
+	EXPECT_EQ(Output(), std::string(metadata) + "5\r\nhello\r\n6\r\n world\r\n0\r\n\r\n");
+}
+
+TEST_F(ResponseWriterTest, PassesOtherBodiesThrough) {
+	writer.Begin(connection, base::String(metadata.data(), metadata.length()), false);
+	ASSERT_TRUE(writer.Write("hello"));
+	ASSERT_TRUE(writer.End(" world"));
+	EXPECT_EQ(Output(), std::string(metadata) + "hello world");
+}
+
+} // namespace HTTP
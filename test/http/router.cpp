@@ -0,0 +1,69 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include <array>
+
+#include <gtest/gtest.h>
+
+#include "cgi/router.hpp"
+
+TEST(Router, MatchesExactRoutes) {
+	CGI::Router router;
+	std::array<CGI::Script, 3> scripts{};
+	ASSERT_TRUE(router.Insert("/api", &scripts[0]));
+	ASSERT_TRUE(router.Insert("/app", &scripts[1]));
+	ASSERT_TRUE(router.Insert("/a", &scripts[2]));
+
+	EXPECT_EQ(router.Lookup("/api"), &scripts[0]);
+	EXPECT_EQ(router.Lookup("/app"), &scripts[1]);
+	EXPECT_EQ(router.Lookup("/a"), &scripts[2]);
+	EXPECT_EQ(router.Lookup("/ap"), nullptr);
+	EXPECT_EQ(router.Lookup("/apps"), nullptr);
+	EXPECT_EQ(router.Lookup("/"), nullptr);
+	EXPECT_EQ(router.Lookup(""), nullptr);
+}
+
+TEST(Router, MatchesPrefixRoutes) {
+	CGI::Router router;
+	std::array<CGI::Script, 2> scripts{};
+	ASSERT_TRUE(router.Insert("/app/*", &scripts[0]));
+	ASSERT_TRUE(router.Insert("/app/static", &scripts[1]));
+
+	EXPECT_EQ(router.Lookup("/app"), &scripts[0]);
+	EXPECT_EQ(router.Lookup("/app/"), &scripts[0]);
+	EXPECT_EQ(router.Lookup("/app/a/b"), &scripts[0]);
+	EXPECT_EQ(router.Lookup("/app/static"), &scripts[1]);
+	EXPECT_EQ(router.Lookup("/app/static/x"), &scripts[0]);
+	EXPECT_EQ(router.Lookup("/apps"), nullptr);
+}
+
+TEST(Router, MatchesWildcardSegments) {
+	CGI::Router router;
+	std::array<CGI::Script, 3> scripts{};
+	ASSERT_TRUE(router.Insert("/users/*/profile", &scripts[0]));
+	ASSERT_TRUE(router.Insert("/users/me/profile", &scripts[1]));
+	ASSERT_TRUE(router.Insert("/users/*", &scripts[2]));
+
+	EXPECT_EQ(router.Lookup("/users/42/profile"), &scripts[0]);
+	EXPECT_EQ(router.Lookup("/users/me/profile"), &scripts[1]);
+
+	// The "*" segment isn't empty, so this falls back to the prefix route.
+	EXPECT_EQ(router.Lookup("/users//profile"), &scripts[2]);
+	EXPECT_EQ(router.Lookup("/users/me/settings"), &scripts[2]);
+	EXPECT_EQ(router.Lookup("/users/42/profile/x"), &scripts[2]);
+}
+
+TEST(Router, RejectsMalformedRoutes) {
+	CGI::Router router;
+	CGI::Script script;
+	EXPECT_FALSE(router.Insert("", &script));
+	EXPECT_FALSE(router.Insert("app", &script));
+	EXPECT_FALSE(router.Insert("/app*", &script));
+	EXPECT_FALSE(router.Insert("/*app", &script));
+	EXPECT_FALSE(router.Insert("/a/*b/c", &script));
+	EXPECT_TRUE(router.Insert("/*", &script));
+	EXPECT_EQ(router.Lookup("/anything"), &script);
+}
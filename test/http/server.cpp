@@ -4,11 +4,25 @@
  * See the COPYING file for licensing information.
  */
 
+#include <fstream>
+#include <string>
+#include <string_view>
+
+#include <cstdlib>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include <gtest/gtest.h>
 
 #define TESTING
 
+#include "base/media_type.hpp"
+#include "base/strings.hpp"
+#include "cgi/manager.hpp"
 #include "http/server.hpp"
+#include "io/file_cache.hpp"
+#include "security/policies.hpp"
+#include "security/tls_configuration.hpp"
 
 namespace HTTP {
 
@@ -23,5 +37,256 @@ namespace HTTP {
 // 		ASSERT_EQ(server.internalSocket, -1);
 	}
 
+	TEST(Server, FindsVirtualHosts) {
+		MediaTypeFinder finder;
+		Security::Policies policies;
+		Security::TLSConfiguration tlsConfiguration;
+		Configuration configuration(finder, policies, tlsConfiguration);
+		configuration.hostname = "default.test";
+
+		VirtualHost virtualHost;
+		virtualHost.hostnames = { "Example.com", "www.example.com" };
+		configuration.virtualHosts.push_back(virtualHost);
+		virtualHost.hostnames = { "example.org" };
+		configuration.virtualHosts.push_back(virtualHost);
+
+		CGI::Manager manager;
+		Server server(configuration, manager);
+
+		Request request;
+		ASSERT_EQ(server.FindSite(request).hostname, "default.test");
+
+		ASSERT_TRUE(request.headers.Add({ "Host", "WWW.example.com:8080" }));
+		ASSERT_EQ(server.FindSite(request).hostname, "Example.com");
+
+		request.headers.Clear();
+		ASSERT_TRUE(request.headers.Add({ "Host", "example.org" }));
+		ASSERT_EQ(server.FindSite(request).hostname, "example.org");
+
+		request.headers.Clear();
+		ASSERT_TRUE(request.headers.Add({ "Host", "example.net" }));
+		ASSERT_EQ(server.FindSite(request).hostname, "default.test");
+
+		ASSERT_NE(server.FindVirtualHost("EXAMPLE.COM"), nullptr);
+		ASSERT_EQ(server.FindVirtualHost("example"), nullptr);
+		ASSERT_EQ(server.FindVirtualHost(""), nullptr);
+	}
+
+	TEST(Server, SerializesErrorResponses) {
+		MediaTypeFinder finder;
+		Security::Policies policies;
+		Security::TLSConfiguration tlsConfiguration;
+		Configuration configuration(finder, policies, tlsConfiguration);
+		configuration.hostname = "default.test";
+		configuration.compressionMinimumSize = 300;
+
+		CGI::Manager manager;
+		Server server(configuration, manager);
+		ASSERT_EQ(server.FindErrorResponse(ClientError::NO_ERROR), nullptr);
+		ASSERT_EQ(server.FindErrorResponse(ClientError::UPGRADE_TO_HTTPS), nullptr);
+
+		const auto *notFound = server.FindErrorResponse(ClientError::FILE_NOT_FOUND);
+		ASSERT_NE(notFound, nullptr);
+		ASSERT_FALSE(notFound->closesConnection);
+		ASSERT_FALSE(notFound->compressible);
+		ASSERT_EQ(notFound->Body(), std::string_view(Strings::NotFoundPage.data(), Strings::NotFoundPage.length()));
+
+		const std::string head = "HTTP/1.1 404 Not Found\r\nContent-Length: " + std::to_string(notFound->Body().length()) +
+								 "\r\nConnection: keep-alive" + server.StaticHeaders() +
+								 "\r\nContent-Type: text/html;charset=utf-8\r\n\r\n";
+		ASSERT_EQ(notFound->responses[true].substr(0, notFound->headLengths[true]), head);
+		ASSERT_EQ(notFound->responses[true].substr(notFound->headLengths[true]), notFound->Body());
+		ASSERT_NE(notFound->responses[false].find("\r\nConnection: close\r\n"), std::string::npos);
+
+		// The messages of malformed requests are prefixed, and the connection
+		// is closed.
+		const auto *malformed = server.FindErrorResponse(ClientError::HOST_HEADER_NONE);
+		ASSERT_NE(malformed, nullptr);
+		ASSERT_TRUE(malformed->closesConnection);
+		ASSERT_EQ(malformed->Body(), "Malformed request: no 'Host' header supplied");
+
+		const auto *emptyMethod = server.FindErrorResponse(ClientError::EMPTY_METHOD);
+		ASSERT_NE(emptyMethod, nullptr);
+		ASSERT_TRUE(emptyMethod->compressible);
+		ASSERT_NE(emptyMethod->responses[false].find("\r\nVary: Accept-Encoding\r\n\r\n"), std::string::npos);
+
+		const auto &upgrade = server.UpgradeResponseHead();
+		ASSERT_EQ(upgrade.substr(0, 51), "HTTP/1.1 301 Moved Permanently\r\nContent-Length: 0\r\n");
+		ASSERT_EQ(upgrade.substr(upgrade.length() - 20), "\r\nLocation: https://");
+	}
+
+	TEST(Server, RejectsDuplicateHostnames) {
+		MediaTypeFinder finder;
+		Security::Policies policies;
+		Security::TLSConfiguration tlsConfiguration;
+		Configuration configuration(finder, policies, tlsConfiguration);
+
+		VirtualHost virtualHost;
+		virtualHost.hostnames = { "example.com" };
+		configuration.virtualHosts.push_back(virtualHost);
+		virtualHost.hostnames = { "EXAMPLE.com" };
+		configuration.virtualHosts.push_back(virtualHost);
+
+		CGI::Manager manager;
+		ASSERT_THROW(Server(configuration, manager), ConfigurationException);
+	}
+
+	TEST(Server, SharesTheFileCacheBetweenSites) {
+		char first[] = "/tmp/webserver-site-XXXXXX";
+		char second[] = "/tmp/webserver-site-XXXXXX";
+		ASSERT_NE(mkdtemp(first), nullptr);
+		ASSERT_NE(mkdtemp(second), nullptr);
+		std::ofstream(std::string(first) + "/page.txt") << "first";
+		std::ofstream(std::string(second) + "/page.txt") << "second";
+
+		MediaTypeFinder finder;
+		Security::Policies policies;
+		Security::TLSConfiguration tlsConfiguration;
+		// One entry per shard would let the files evict each other.
+		IO::FileCache fileCache(1024, 1024);
+		static_cast<void>(fileCache.Initialize());
+
+		Configuration configuration(finder, policies, tlsConfiguration);
+		configuration.hostname = "first.test";
+		configuration.rootDirectory = first;
+		configuration.sharedFileCache = &fileCache;
+
+		VirtualHost virtualHost;
+		virtualHost.hostnames = { "second.test" };
+		virtualHost.rootDirectory = second;
+		configuration.virtualHosts.push_back(virtualHost);
+
+		CGI::Manager manager;
+		Server server(configuration, manager);
+		Server other(configuration, manager);
+
+		for (int i = 0; i < 2; i++) {
+			for (auto *instance : { &server, &other }) {
+				Request request;
+				request.path = "/page.txt";
+				IO::FileResolveStatus status;
+
+				auto file = instance->ResolveFile(request, status);
+				ASSERT_EQ(status, IO::FileResolveStatus::OK);
+				ASSERT_EQ(file->contents, "first");
+
+				ASSERT_TRUE(request.headers.Add({ "Host", "second.test" }));
+				file = instance->ResolveFile(request, status);
+				ASSERT_EQ(status, IO::FileResolveStatus::OK);
+				ASSERT_EQ(file->contents, "second");
+			}
+		}
+
+		// Both servers use the cache of the configuration.
+		ASSERT_NE(fileCache.Lookup(std::string(first) + "/page.txt"), nullptr);
+		ASSERT_NE(fileCache.Lookup(std::string(second) + "/page.txt"), nullptr);
+
+		unlink((std::string(first) + "/page.txt").c_str());
+		unlink((std::string(second) + "/page.txt").c_str());
+		rmdir(first);
+		rmdir(second);
+	}
+
+	TEST(Server, ListsDirectoriesWithoutIndex) {
+		char root[] = "/tmp/webserver-site-XXXXXX";
+		ASSERT_NE(mkdtemp(root), nullptr);
+		const std::string directory = std::string(root) + "/files";
+		ASSERT_EQ(mkdir(directory.c_str(), 0755), 0);
+		std::ofstream(directory + "/page.txt") << "page";
+
+		MediaTypeFinder finder;
+		Security::Policies policies;
+		Security::TLSConfiguration tlsConfiguration;
+		Configuration configuration(finder, policies, tlsConfiguration);
+		configuration.hostname = "localhost";
+		configuration.rootDirectory = root;
+
+		CGI::Manager manager;
+		Request request;
+		request.path = "/files/";
+		IO::FileResolveStatus status;
+		std::shared_ptr<const std::string> listing;
+		{
+			Server server(configuration, manager);
+			ASSERT_EQ(server.ResolveFile(request, status, &listing), nullptr);
+			ASSERT_EQ(status, IO::FileResolveStatus::NOT_FOUND);
+			ASSERT_EQ(listing, nullptr);
+		}
+
+		configuration.autoIndex = true;
+		Server server(configuration, manager);
+		ASSERT_EQ(server.ResolveFile(request, status, &listing), nullptr);
+		ASSERT_EQ(status, IO::FileResolveStatus::NOT_FOUND);
+		ASSERT_NE(listing, nullptr);
+		ASSERT_NE(listing->find("<a href=\"/files/page.txt\">page.txt</a>"), std::string::npos);
+
+		unlink((directory + "/page.txt").c_str());
+		rmdir(directory.c_str());
+		rmdir(root);
+	}
+
+	TEST(Server, WarmsTheFileCache) {
+		char root[] = "/tmp/webserver-site-XXXXXX";
+		ASSERT_NE(mkdtemp(root), nullptr);
+		const std::string directory = std::string(root) + "/directory";
+		ASSERT_EQ(mkdir(directory.c_str(), 0755), 0);
+		std::ofstream(directory + "/index.html") << "index";
+		std::ofstream(directory + "/index.html.gz") << "compressed";
+		std::ofstream(std::string(root) + "/page.txt") << "page";
+		const std::string manifestPath = std::string(root) + "/manifest";
+
+		MediaTypeFinder finder;
+		Security::Policies policies;
+		Security::TLSConfiguration tlsConfiguration;
+		Configuration configuration(finder, policies, tlsConfiguration);
+		configuration.hostname = "site.test";
+		configuration.rootDirectory = root;
+		configuration.fileCacheManifest = manifestPath;
+		CGI::Manager manager;
+
+		{
+			IO::FileCache fileCache(1024, 1024);
+			static_cast<void>(fileCache.Initialize());
+			configuration.sharedFileCache = &fileCache;
+
+			// Without a manifest, the root directory is walked.
+			Server server(configuration, manager);
+			server.WarmFileCache();
+			ASSERT_NE(fileCache.Lookup(std::string(root) + "/page.txt"), nullptr);
+			ASSERT_NE(fileCache.Lookup(directory + "/index.html"), nullptr);
+			ASSERT_EQ(fileCache.Lookup(directory + "/index.html.gz"), nullptr);
+
+			const auto index = fileCache.Lookup(directory + '/');
+			ASSERT_NE(index, nullptr);
+			ASSERT_EQ(index->contents, "index");
+			ASSERT_NE(index->encodings[static_cast<std::size_t>(ContentCoding::GZIP)], nullptr);
+
+			// The manifest is saved on destruction, with only this file.
+			fileCache.Clear();
+			Request request;
+			request.path = "/page.txt";
+			IO::FileResolveStatus status;
+			ASSERT_NE(server.ResolveFile(request, status), nullptr);
+		}
+
+		{
+			IO::FileCache fileCache(1024, 1024);
+			static_cast<void>(fileCache.Initialize());
+			configuration.sharedFileCache = &fileCache;
+
+			// Only the files of the manifest are warmed.
+			Server server(configuration, manager);
+			server.WarmFileCache();
+			ASSERT_NE(fileCache.Lookup(std::string(root) + "/page.txt"), nullptr);
+			ASSERT_EQ(fileCache.Lookup(directory + "/index.html"), nullptr);
+		}
+
+		unlink(manifestPath.c_str());
+		unlink((directory + "/index.html").c_str());
+		unlink((directory + "/index.html.gz").c_str());
+		unlink((std::string(root) + "/page.txt").c_str());
+		rmdir(directory.c_str());
+		rmdir(root);
+	}
 
 } // namespace HTTP
@@ -0,0 +1,276 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#define CONNECTION_MEMORY_VARIANT
+
+#include <algorithm>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "base/media_type.hpp"
+#include "cgi/manager.hpp"
+#include "connection/connection.hpp"
+#include "connection/memory_userdata.hpp"
+#include "http/configuration.hpp"
+#include "http/server.hpp"
+#include "http2/frame.hpp"
+#include "http2/hpack.hpp"
+#include "http2/session.hpp"
+#include "security/policies.hpp"
+#include "security/tls_configuration.hpp"
+
+using namespace std::string_literals;
+using namespace std::string_view_literals;
+
+namespace {
+
+struct ReceivedFrame {
+	HTTP2::FrameHeader header;
+	std::string payload;
+};
+
+[[nodiscard]] std::string
+Frame(HTTP2::FrameType type, std::uint8_t flags, std::uint32_t streamID, std::string_view payload) {
+	std::string frame(HTTP2::frameHeaderSize, '\0');
+	HTTP2::WriteFrameHeader(frame.data(), payload.length(), type, flags, streamID);
+	frame.append(payload);
+	return frame;
+}
+
+} // namespace
+
+class SessionTest : public ::testing::Test {
+protected:
+	SessionTest()
+			: server(HTTP::Configuration(finder, secPolicies, tlsConfig), cgiManager),
+			  connection(&internalData), session(server, connection) {
+		// Makes the connection one from localhost, whose names the Host
+		// header field may contain.
+		EXPECT_TRUE(connection.Setup(server.config()));
+	}
+
+	CGI::Manager cgiManager;
+	MediaTypeFinder finder;
+	Security::Policies secPolicies;
+	Security::TLSConfiguration tlsConfig;
+	HTTP::Server server;
+	MemoryUserData internalData{};
+	Connection connection;
+	HTTP2::Session session;
+
+	// Makes [input] the octets received, in the receive buffer.
+	void
+	Feed(std::string_view input) {
+		internalData.input.assign(std::crbegin(input), std::crend(input));
+		ASSERT_TRUE(connection.FillReceiveBuffer());
+	}
+
+	// The :status of the response on [streamID].
+	[[nodiscard]] std::string
+	Status(std::uint32_t streamID) {
+		const auto frames = Sent();
+		const auto headers = std::find_if(std::cbegin(frames), std::cend(frames), [streamID](const ReceivedFrame &frame) {
+			return frame.header.type == HTTP2::FrameType::HEADERS && frame.header.streamID == streamID;
+		});
+		if (headers == std::cend(frames)) {
+			return {};
+		}
+
+		HTTP2::HPACK::Decoder decoder;
+		std::string status;
+		static_cast<void>(decoder.Decode(headers->payload, [&status](HTTP2::HPACK::Field field) {
+			if (field.name == ":status") {
+				status = field.value;
+			}
+			return true;
+		}));
+		return status;
+	}
+
+	[[nodiscard]] std::vector<ReceivedFrame>
+	Sent() {
+		std::vector<ReceivedFrame> frames;
+		const std::string_view output(internalData.output.data(), internalData.output.size());
+
+		std::size_t offset = 0;
+		while (output.length() - offset >= HTTP2::frameHeaderSize) {
+			const auto header = HTTP2::ParseFrameHeader(output.data() + offset);
+			offset += HTTP2::frameHeaderSize;
+			frames.push_back({ header, std::string(output.substr(offset, header.length)) });
+			offset += header.length;
+		}
+
+		return frames;
+	}
+};
+
+TEST_F(SessionTest, RespondsToRequests) {
+	// :method GET, :scheme http, :path, and :authority as literals.
+	const std::string block = "\x82\x86\x04\x0f" "/does-not-exist" "\x01\x09" "localhost"s;
+
+	ASSERT_TRUE(session.Start());
+	Feed(std::string(HTTP2::connectionPreface) +
+		 Frame(HTTP2::FrameType::SETTINGS, 0, 0, {}) +
+		 Frame(HTTP2::FrameType::HEADERS, HTTP2::Flags::END_HEADERS | HTTP2::Flags::END_STREAM, 1, block) +
+		 Frame(HTTP2::FrameType::PING, 0, 0, "12345678"));
+	ASSERT_TRUE(session.Receive());
+	ASSERT_TRUE(session.Send());
+
+	const auto frames = Sent();
+	ASSERT_GE(frames.size(), 5);
+
+	ASSERT_EQ(frames[0].header.type, HTTP2::FrameType::SETTINGS);
+	ASSERT_EQ(frames[0].header.flags, 0);
+	ASSERT_EQ(frames[1].header.type, HTTP2::FrameType::SETTINGS);
+	ASSERT_EQ(frames[1].header.flags, HTTP2::Flags::ACK);
+
+	ASSERT_EQ(frames[2].header.type, HTTP2::FrameType::HEADERS);
+	ASSERT_EQ(frames[2].header.streamID, 1);
+	ASSERT_TRUE(frames[2].header.flags & HTTP2::Flags::END_HEADERS);
+
+	HTTP2::HPACK::Decoder decoder;
+	std::vector<std::string> fields;
+	ASSERT_TRUE(decoder.Decode(frames[2].payload, [&fields](HTTP2::HPACK::Field field) {
+		fields.push_back(std::string(field.name) + ": " + std::string(field.value));
+		return true;
+	}));
+	ASSERT_FALSE(fields.empty());
+	ASSERT_EQ(fields.front(), ":status: 404");
+
+	ASSERT_EQ(frames[3].header.type, HTTP2::FrameType::PING);
+	ASSERT_EQ(frames[3].header.flags, HTTP2::Flags::ACK);
+	ASSERT_EQ(frames[3].payload, "12345678");
+
+	ASSERT_EQ(frames.back().header.type, HTTP2::FrameType::DATA);
+	ASSERT_EQ(frames.back().header.streamID, 1);
+	ASSERT_TRUE(frames.back().header.flags & HTTP2::Flags::END_STREAM);
+}
+
+TEST_F(SessionTest, RejectsMalformedPrefaces) {
+	ASSERT_TRUE(session.Start());
+	Feed("GET / HTTP/1.1\r\n\r\n"sv);
+	ASSERT_FALSE(session.Receive());
+
+	const auto frames = Sent();
+	ASSERT_EQ(frames.back().header.type, HTTP2::FrameType::GOAWAY);
+	ASSERT_EQ(HTTP2::ReadUInt32(frames.back().payload.data() + 4),
+			  static_cast<std::uint32_t>(HTTP2::ErrorCode::PROTOCOL_ERROR));
+}
+
+TEST_F(SessionTest, ResetsMalformedRequests) {
+	// A field name with an uppercase letter.
+	const std::string block = "\x82\x86\x84\x01\x09" "localhost" "\x00\x03" "Bad\x01" "1"s;
+
+	ASSERT_TRUE(session.Start());
+	Feed(std::string(HTTP2::connectionPreface) +
+		 Frame(HTTP2::FrameType::SETTINGS, 0, 0, {}) +
+		 Frame(HTTP2::FrameType::HEADERS, HTTP2::Flags::END_HEADERS | HTTP2::Flags::END_STREAM, 1, block));
+	ASSERT_TRUE(session.Receive());
+
+	const auto frames = Sent();
+	ASSERT_EQ(frames.back().header.type, HTTP2::FrameType::RST_STREAM);
+	ASSERT_EQ(frames.back().header.streamID, 1);
+	ASSERT_EQ(HTTP2::ReadUInt32(frames.back().payload.data()),
+			  static_cast<std::uint32_t>(HTTP2::ErrorCode::PROTOCOL_ERROR));
+}
+
+TEST_F(SessionTest, RejectsHeadersOnClosedStreams) {
+	// :method GET, :scheme http, :path, and :authority as literals.
+	const std::string block = "\x82\x86\x04\x0f" "/does-not-exist" "\x01\x09" "localhost"s;
+
+	ASSERT_TRUE(session.Start());
+	Feed(std::string(HTTP2::connectionPreface) +
+		 Frame(HTTP2::FrameType::SETTINGS, 0, 0, {}) +
+		 Frame(HTTP2::FrameType::HEADERS, HTTP2::Flags::END_HEADERS | HTTP2::Flags::END_STREAM, 1, block));
+	ASSERT_TRUE(session.Receive());
+	ASSERT_TRUE(session.Send());
+
+	// The stream is closed, since the request and the response have ended.
+	Feed(Frame(HTTP2::FrameType::HEADERS, HTTP2::Flags::END_HEADERS | HTTP2::Flags::END_STREAM, 1, block));
+	ASSERT_FALSE(session.Receive());
+
+	const auto frames = Sent();
+	ASSERT_EQ(frames.back().header.type, HTTP2::FrameType::GOAWAY);
+	ASSERT_EQ(HTTP2::ReadUInt32(frames.back().payload.data() + 4),
+			  static_cast<std::uint32_t>(HTTP2::ErrorCode::PROTOCOL_ERROR));
+}
+
+TEST_F(SessionTest, IgnoresHeadersOnResetStreams) {
+	const std::string block = "\x82\x86\x04\x0f" "/does-not-exist" "\x01\x09" "localhost"s;
+
+	// The request doesn't end, so the stream is reset after the response.
+	ASSERT_TRUE(session.Start());
+	Feed(std::string(HTTP2::connectionPreface) +
+		 Frame(HTTP2::FrameType::SETTINGS, 0, 0, {}) +
+		 Frame(HTTP2::FrameType::HEADERS, HTTP2::Flags::END_HEADERS, 1, block));
+	ASSERT_TRUE(session.Receive());
+	ASSERT_TRUE(session.Send());
+	ASSERT_EQ(Sent().back().header.type, HTTP2::FrameType::RST_STREAM);
+
+	// The trailers were sent before the RST_STREAM frame arrived.
+	Feed(Frame(HTTP2::FrameType::HEADERS, HTTP2::Flags::END_HEADERS | HTTP2::Flags::END_STREAM, 1, "\x40\x01" "a\x01" "b"s));
+	ASSERT_TRUE(session.Receive());
+	ASSERT_EQ(Sent().back().header.type, HTTP2::FrameType::RST_STREAM);
+}
+
+TEST_F(SessionTest, ReplenishesTheWindowsOfStreams) {
+	const std::string block = "\x82\x86\x04\x0f" "/does-not-exist" "\x01\x09" "localhost"s;
+	const std::string data(4096, 'a');
+
+	// The response isn't sent yet, so the stream stays open.
+	ASSERT_TRUE(session.Start());
+	Feed(std::string(HTTP2::connectionPreface) +
+		 Frame(HTTP2::FrameType::SETTINGS, 0, 0, {}) +
+		 Frame(HTTP2::FrameType::HEADERS, HTTP2::Flags::END_HEADERS, 1, block));
+	ASSERT_TRUE(session.Receive());
+
+	// The frames are fed one at a time, since they don't fit in the receive
+	// buffer together.
+	for (int i = 0; i < 8; i++) {
+		Feed(Frame(HTTP2::FrameType::DATA, 0, 1, data));
+		ASSERT_TRUE(session.Receive());
+	}
+
+	std::vector<std::uint32_t> updated;
+	for (const auto &frame : Sent()) {
+		if (frame.header.type == HTTP2::FrameType::WINDOW_UPDATE) {
+			ASSERT_EQ(HTTP2::ReadUInt31(frame.payload.data()), 8 * data.length());
+			updated.push_back(frame.header.streamID);
+		}
+	}
+
+	ASSERT_EQ(updated, std::vector<std::uint32_t>({ 1, 0 }));
+}
+
+TEST_F(SessionTest, DoesNotServeRoutedPathsFromTheFileSystem) {
+	CGI::Script script;
+	script.Command = "/bin/true";
+	ASSERT_TRUE(cgiManager.Register("/does-not-exist", script));
+
+	const std::string block = "\x82\x86\x04\x0f" "/does-not-exist" "\x01\x09" "localhost"s;
+
+	ASSERT_TRUE(session.Start());
+	Feed(std::string(HTTP2::connectionPreface) +
+		 Frame(HTTP2::FrameType::SETTINGS, 0, 0, {}) +
+		 Frame(HTTP2::FrameType::HEADERS, HTTP2::Flags::END_HEADERS | HTTP2::Flags::END_STREAM, 1, block));
+	ASSERT_TRUE(session.Receive());
+	ASSERT_EQ(Status(1), "502");
+}
+
+TEST_F(SessionTest, ChecksTheAuthority) {
+	const std::string block = "\x82\x86\x04\x0f" "/does-not-exist" "\x01\x0b" "example.org"s;
+
+	ASSERT_TRUE(session.Start());
+	Feed(std::string(HTTP2::connectionPreface) +
+		 Frame(HTTP2::FrameType::SETTINGS, 0, 0, {}) +
+		 Frame(HTTP2::FrameType::HEADERS, HTTP2::Flags::END_HEADERS | HTTP2::Flags::END_STREAM, 1, block));
+	ASSERT_TRUE(session.Receive());
+	ASSERT_EQ(Status(1), "400");
+}
@@ -0,0 +1,72 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include <array>
+#include <memory>
+
+#include <gtest/gtest.h>
+
+#include "base/slot_map.hpp"
+
+TEST(SlotMap, InsertsAndRemoves) {
+	base::SlotMap<int> map;
+	const auto first = map.Insert(std::make_unique<int>(1));
+	const auto second = map.Insert(std::make_unique<int>(2));
+	ASSERT_EQ(map.Size(), 2);
+
+	ASSERT_NE(map.Find(first), nullptr);
+	ASSERT_EQ(*map.Find(first), 1);
+	ASSERT_EQ(*map.Find(second), 2);
+
+	ASSERT_TRUE(map.Remove(first));
+	ASSERT_FALSE(map.Remove(first));
+	ASSERT_EQ(map.Find(first), nullptr);
+	ASSERT_EQ(*map.Find(second), 2);
+	ASSERT_EQ(map.Size(), 1);
+}
+
+TEST(SlotMap, ReusesSlotsWithNewGeneration) {
+	base::SlotMap<int> map;
+	const auto removed = map.Insert(std::make_unique<int>(1));
+	ASSERT_TRUE(map.Remove(removed));
+
+	const auto reused = map.Insert(std::make_unique<int>(2));
+	ASSERT_EQ(reused.index, removed.index);
+	ASSERT_NE(reused.generation, removed.generation);
+
+	// The stale handle doesn't refer to the new element.
+	ASSERT_EQ(map.Find(removed), nullptr);
+	ASSERT_FALSE(map.Remove(removed));
+	ASSERT_EQ(*map.Find(reused), 2);
+}
+
+TEST(SlotMap, IteratesElements) {
+	base::SlotMap<int> map;
+	std::array<base::SlotHandle, 4> handles;
+	for (int i = 0; i < 4; i++) {
+		handles[i] = map.Insert(std::make_unique<int>(i));
+	}
+	ASSERT_TRUE(map.Remove(handles[1]));
+
+	int sum = 0;
+	map.ForEach([&sum](int value) { sum += value; });
+	ASSERT_EQ(sum, 0 + 2 + 3);
+
+	ASSERT_FALSE(base::SlotHandle{}.IsValid());
+	ASSERT_EQ(map.Find(base::SlotHandle{}), nullptr);
+}
+
+TEST(SlotMap, TakesWithoutDestroying) {
+	base::SlotMap<int> map;
+	const auto handle = map.Insert(std::make_unique<int>(7));
+
+	auto taken = map.Take(handle);
+	ASSERT_NE(taken, nullptr);
+	ASSERT_EQ(*taken, 7);
+	ASSERT_EQ(map.Find(handle), nullptr);
+	ASSERT_EQ(map.Take(handle), nullptr);
+	ASSERT_EQ(map.Size(), 0);
+}
@@ -0,0 +1,63 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "base/thread_pool.hpp"
+
+TEST(ThreadPool, RunsTasks) {
+	base::ThreadPool pool(2, 16);
+	ASSERT_TRUE(pool.Start());
+
+	std::atomic<int> count{ 0 };
+	std::promise<void> done;
+	for (int i = 0; i < 10; i++) {
+		std::function<void()> task = [&] {
+			if (++count == 10) {
+				done.set_value();
+			}
+		};
+		ASSERT_TRUE(pool.TrySubmit(task));
+	}
+
+	ASSERT_EQ(done.get_future().wait_for(std::chrono::seconds(5)), std::future_status::ready);
+}
+
+TEST(ThreadPool, RejectsWhenFull) {
+	base::ThreadPool pool(1, 1);
+
+	std::function<void()> task = [] {};
+	ASSERT_FALSE(pool.TrySubmit(task));
+	ASSERT_TRUE(task);
+
+	ASSERT_TRUE(pool.Start());
+
+	// Occupy the only thread, so the queue fills up.
+	std::promise<void> release;
+	auto released = release.get_future().share();
+	std::promise<void> started;
+	std::function<void()> blocker = [&] {
+		started.set_value();
+		released.wait();
+	};
+	ASSERT_TRUE(pool.TrySubmit(blocker));
+	started.get_future().wait();
+
+	std::function<void()> queued = [] {};
+	ASSERT_TRUE(pool.TrySubmit(queued));
+	ASSERT_FALSE(pool.TrySubmit(task));
+	ASSERT_TRUE(task);
+
+	release.set_value();
+	pool.Stop();
+	ASSERT_FALSE(pool.TrySubmit(task));
+}
@@ -0,0 +1,128 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include <chrono>
+#include <functional>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "event/timer_wheel.hpp"
+
+using namespace std::chrono_literals;
+
+class TestTimer : public Event::Timer {
+public:
+	TestTimer(std::vector<int> &expired, int id) noexcept
+		: expired(expired), id(id) {
+	}
+
+	void
+	OnTimeout() noexcept override {
+		expired.push_back(id);
+		if (onTimeout) {
+			onTimeout();
+		}
+	}
+
+	std::vector<int> &expired;
+	const int id;
+	std::function<void()> onTimeout;
+};
+
+class TimerWheelTest : public ::testing::Test {
+protected:
+	const std::chrono::steady_clock::time_point origin{ std::chrono::steady_clock::now() };
+	Event::TimerWheel wheel{ 10ms, origin };
+	std::vector<int> expired;
+};
+
+TEST_F(TimerWheelTest, ExpiresInOrder) {
+	TestTimer first(expired, 1);
+	TestTimer second(expired, 2);
+	TestTimer third(expired, 3);
+
+	wheel.Schedule(third, 300ms);
+	wheel.Schedule(first, 25ms);
+	wheel.Schedule(second, 40ms);
+	ASSERT_FALSE(wheel.IsEmpty());
+
+	wheel.Advance(origin + 20ms);
+	ASSERT_TRUE(expired.empty());
+
+	wheel.Advance(origin + 30ms);
+	ASSERT_EQ(expired, std::vector<int>({ 1 }));
+	ASSERT_FALSE(first.IsScheduled());
+
+	wheel.Advance(origin + 1s);
+	ASSERT_EQ(expired, std::vector<int>({ 1, 2, 3 }));
+	ASSERT_TRUE(wheel.IsEmpty());
+}
+
+TEST_F(TimerWheelTest, CascadesLongDelays) {
+	// Beyond the first level (64 ticks) and the second (4096 ticks).
+	TestTimer medium(expired, 1);
+	TestTimer large(expired, 2);
+	wheel.Schedule(medium, 1000ms);
+	wheel.Schedule(large, 50000ms);
+
+	wheel.Advance(origin + 990ms);
+	ASSERT_TRUE(expired.empty());
+	wheel.Advance(origin + 1000ms);
+	ASSERT_EQ(expired, std::vector<int>({ 1 }));
+
+	wheel.Advance(origin + 49990ms);
+	ASSERT_EQ(expired, std::vector<int>({ 1 }));
+	wheel.Advance(origin + 50000ms);
+	ASSERT_EQ(expired, std::vector<int>({ 1, 2 }));
+}
+
+TEST_F(TimerWheelTest, CancelsAndReschedules) {
+	TestTimer cancelled(expired, 1);
+	TestTimer rescheduled(expired, 2);
+	wheel.Schedule(cancelled, 50ms);
+	wheel.Schedule(rescheduled, 50ms);
+
+	wheel.Cancel(cancelled);
+	ASSERT_FALSE(cancelled.IsScheduled());
+	wheel.Schedule(rescheduled, 500ms);
+
+	wheel.Advance(origin + 100ms);
+	ASSERT_TRUE(expired.empty());
+
+	wheel.Advance(origin + 500ms);
+	ASSERT_EQ(expired, std::vector<int>({ 2 }));
+	ASSERT_TRUE(wheel.IsEmpty());
+}
+
+TEST_F(TimerWheelTest, CancelsOnDestruction) {
+	{
+		TestTimer timer(expired, 1);
+		wheel.Schedule(timer, 50ms);
+	}
+
+	ASSERT_TRUE(wheel.IsEmpty());
+	wheel.Advance(origin + 100ms);
+	ASSERT_TRUE(expired.empty());
+}
+
+TEST_F(TimerWheelTest, ReschedulesFromTimeout) {
+	TestTimer timer(expired, 1);
+	int remaining = 2;
+	timer.onTimeout = [&] {
+		if (remaining-- != 0) {
+			wheel.Schedule(timer, 0ms);
+		}
+	};
+
+	wheel.Schedule(timer, 0ms);
+	wheel.Advance(origin + 10ms);
+	ASSERT_EQ(expired.size(), 1);
+
+	wheel.Advance(origin + 1s);
+	ASSERT_EQ(expired.size(), 3);
+	ASSERT_FALSE(timer.IsScheduled());
+}
@@ -0,0 +1,82 @@
+/**
+ * Copyright (C) 2020 Tristan. All Rights Reserved.
+ * This file is licensed under the BSD 2-Clause license.
+ * See the COPYING file for licensing information.
+ */
+
+#include <chrono>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "security/tls_session_cache.hpp"
+
+TEST(TLSSessionCache, StoresSessions) {
+	Security::TLSSessionCache cache(64, std::chrono::hours(1));
+
+	cache.Store("id", "session");
+	ASSERT_EQ(cache.Find("id"), "session");
+	ASSERT_EQ(cache.Find("other"), "");
+
+	cache.Store("id", "replaced");
+	ASSERT_EQ(cache.Find("id"), "replaced");
+
+	cache.Remove("id");
+	ASSERT_EQ(cache.Find("id"), "");
+
+	const auto statistics = cache.Statistics();
+	ASSERT_EQ(statistics.cacheHits, 2);
+	ASSERT_EQ(statistics.cacheMisses, 2);
+}
+
+TEST(TLSSessionCache, EvictsOldestSessions) {
+	// A stripe holds a single session.
+	Security::TLSSessionCache cache(1, std::chrono::hours(1));
+
+	for (int i = 0; i < 100; i++) {
+		cache.Store(std::to_string(i), "session");
+	}
+
+	// At most one session per stripe is kept, and the last one is.
+	std::size_t found = 0;
+	for (int i = 0; i < 100; i++) {
+		found += !cache.Find(std::to_string(i)).empty();
+	}
+	ASSERT_LE(found, 16);
+	ASSERT_EQ(cache.Find("99"), "session");
+}
+
+TEST(TLSSessionCache, RotatesTicketKeys) {
+	Security::TLSSessionCache cache(1, std::chrono::seconds(0));
+
+	Security::TLSSessionCache::TicketKey first;
+	ASSERT_TRUE(cache.CurrentTicketKey(first));
+
+	// A lifetime of zero rotates the key every time, and the previous key
+	// expires immediately.
+	Security::TLSSessionCache::TicketKey second;
+	ASSERT_TRUE(cache.CurrentTicketKey(second));
+	ASSERT_NE(first.name, second.name);
+
+	Security::TLSSessionCache::TicketKey found;
+	bool isCurrent;
+	ASSERT_TRUE(cache.FindTicketKey(second.name.data(), found, isCurrent));
+	ASSERT_TRUE(isCurrent);
+	ASSERT_EQ(found.cipherKey, second.cipherKey);
+	ASSERT_FALSE(cache.FindTicketKey(first.name.data(), found, isCurrent));
+}
+
+TEST(TLSSessionCache, RejectsUnknownTicketKeys) {
+	Security::TLSSessionCache cache(1, std::chrono::hours(1));
+
+	Security::TLSSessionCache::TicketKey current;
+	ASSERT_TRUE(cache.CurrentTicketKey(current));
+
+	Security::TLSSessionCache::TicketKey found;
+	bool isCurrent;
+	ASSERT_TRUE(cache.FindTicketKey(current.name.data(), found, isCurrent));
+	ASSERT_TRUE(isCurrent);
+
+	Security::TLSSessionCache::TicketKey unknown{};
+	ASSERT_FALSE(cache.FindTicketKey(unknown.name.data(), found, isCurrent));
+}